@@ -160,6 +160,10 @@ static char **cp_console_completion(const char *text, int start, int end) {
 					matches = rl_completion_matches(text, cp_console_compl_plugingen);
 					rl_attempted_completion_over = 1;
 					break;
+				case CPC_COMPL_COMMAND:
+					matches = rl_completion_matches(text, cp_console_compl_cmdgen);
+					rl_attempted_completion_over = 1;
+					break;
 				default:
 					rl_attempted_completion_over = 1;
 					break;
@@ -31,6 +31,10 @@
 #include <stdarg.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
 #ifdef HAVE_GETTEXT
 #include <locale.h>
 #endif
@@ -50,6 +54,7 @@ static void cmd_register_pcollection(int argc, char *argv[]);
 static void cmd_unregister_pcollection(int argc, char *argv[]);
 static void cmd_unregister_pcollections(int argc, char *argv[]);
 static void cmd_load_plugin(int argc, char *argv[]);
+static void cmd_write_bundle(int argc, char *argv[]);
 static void cmd_scan_plugins(int argc, char *argv[]);
 static void cmd_list_plugins(int argc, char *argv[]);
 static void cmd_show_plugin_info(int argc, char *argv[]);
@@ -59,6 +64,11 @@ static void cmd_set_context_args(int argc, char *argv[]);
 static void cmd_start_plugin(int argc, char *argv[]);
 static void cmd_run_plugins_step(int argc, char *argv[]);
 static void cmd_run_plugins(int argc, char *argv[]);
+static void cmd_set_lock_profiling(int argc, char *argv[]);
+static void cmd_show_lock_stats(int argc, char *argv[]);
+static void cmd_stats(int argc, char *argv[]);
+static void cmd_time(int argc, char *argv[]);
+static void cmd_profile_scan(int argc, char *argv[]);
 static void cmd_stop_plugin(int argc, char *argv[]);
 static void cmd_stop_plugins(int argc, char *argv[]);
 static void cmd_uninstall_plugin(int argc, char *argv[]);
@@ -80,11 +90,18 @@ CP_HIDDEN const command_info_t commands[] = {
 	{ "unregister-collection", N_("unregisters a plug-in collection"), cmd_unregister_pcollection, CPC_COMPL_FILE },
 	{ "unregister-collections", N_("unregisters all plug-in collections"), cmd_unregister_pcollections, CPC_COMPL_NONE },
 	{ "load-plugin", N_("loads and installs a plug-in from the specified path"), cmd_load_plugin, CPC_COMPL_FILE },
+	{ "write-bundle", N_("writes the installed plug-ins into a plug-in bundle"), cmd_write_bundle, CPC_COMPL_FILE },
 	{ "scan-plugins", N_("scans plug-ins in the registered plug-in collections"), cmd_scan_plugins, CPC_COMPL_FLAG },
 	{ "set-context-args", N_("sets context startup arguments"), cmd_set_context_args, CPC_COMPL_FILE },
 	{ "start-plugin", N_("starts a plug-in"), cmd_start_plugin, CPC_COMPL_PLUGIN },
 	{ "run-plugins-step", N_("runs one plug-in run function"), cmd_run_plugins_step, CPC_COMPL_NONE },
 	{ "run-plugins", N_("runs plug-in run functions until all work is done"), cmd_run_plugins, CPC_COMPL_NONE },
+	{ "set-lock-profiling", N_("enables or disables context lock profiling"), cmd_set_lock_profiling, CPC_COMPL_NONE },
+	{ "show-lock-stats", N_("shows context lock contention statistics"), cmd_show_lock_stats, CPC_COMPL_NONE },
+	{ "lock-stats", N_("shows context lock contention statistics"), cmd_show_lock_stats, CPC_COMPL_NONE },
+	{ "stats", N_("shows plug-in timing and memory statistics"), cmd_stats, CPC_COMPL_PLUGIN },
+	{ "time", N_("runs a command and displays the time it took"), cmd_time, CPC_COMPL_COMMAND },
+	{ "profile-scan", N_("scans plug-ins and displays where the time went"), cmd_profile_scan, CPC_COMPL_FLAG },
 	{ "stop-plugin", N_("stops a plug-in"), cmd_stop_plugin, CPC_COMPL_PLUGIN },
 	{ "stop-plugins", N_("stops all plug-ins"), cmd_stop_plugins, CPC_COMPL_NONE },
 	{ "uninstall-plugin", N_("uninstalls a plug-in"), cmd_uninstall_plugin, CPC_COMPL_PLUGIN },
@@ -104,6 +121,8 @@ CP_HIDDEN const flag_info_t load_flags[] = {
 	{ "stop-all-on-upgrade", N_("stops all plug-ins on first upgrade"), CP_SP_STOP_ALL_ON_UPGRADE },
 	{ "stop-all-on-install", N_("stops all plug-ins on first install or upgrade"), CP_SP_STOP_ALL_ON_INSTALL },
 	{ "restart-active", N_("restarts the currently active plug-ins after the scan"), CP_SP_RESTART_ACTIVE },
+	{ "incremental", N_("only loads plug-ins changed since the previous scan"), CP_SP_INCREMENTAL },
+	{ "restart-upgraded", N_("restarts the active plug-ins affected by upgrades after the scan"), CP_SP_RESTART_UPGRADED },
 	{ NULL, NULL, -1 }
 };
 
@@ -158,6 +177,50 @@ static int cmdline_parse(char *cmdline, char **argv[]) {
 	}
 }
 
+/**
+ * Runs the command specified by the first element of the argument table.
+ * 
+ * @param argc the number of command line elements
+ * @param argv the command and its arguments
+ */
+static void run_command(int argc, char *argv[]) {
+	int i;
+	
+	for (i = 0; commands[i].name != NULL; i++) {
+		if (!strcmp(argv[0], commands[i].name)) {
+			commands[i].implementation(argc, argv);
+			return;
+		}
+	}
+	printf(_("Unknown command %s.\n"), argv[0]);
+}
+
+/**
+ * Returns the current monotonic time in microseconds, falling back to
+ * the wall clock time if a monotonic clock is not available.
+ * 
+ * @return the current time in microseconds
+ */
+static unsigned long long now_usecs(void) {
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	
+	if (!clock_gettime(CLOCK_MONOTONIC, &ts)) {
+		return (unsigned long long) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+	}
+#endif
+#if defined(HAVE_GETTIMEOFDAY) && defined(HAVE_SYS_TIME_H)
+	{
+		struct timeval tv;
+		
+		gettimeofday(&tv, NULL);
+		return (unsigned long long) tv.tv_sec * 1000000ULL + tv.tv_usec;
+	}
+#else
+	return (unsigned long long) time(NULL) * 1000000ULL;
+#endif
+}
+
 static void cmd_exit(int argc, char *argv[]) {
 	
 	// Uninitialize input
@@ -324,18 +387,38 @@ static void cmd_load_plugin(int argc, char *argv[]) {
 	}
 }
 
-static void cmd_scan_plugins(int argc, char *argv[]) {
-	int flags = 0;
+static void cmd_write_bundle(int argc, char *argv[]) {
 	cp_status_t status;
+	
+	if (argc != 2) {
+		/* TRANSLATORS: Usage instructions for writing a plug-in bundle */
+		printf(_("Usage: %s <file>\n"), argv[0]);
+	} else if ((status = cp_write_plugin_image(context, argv[1])) != CP_OK) {
+		api_failed("cp_write_plugin_image", status);
+	} else {
+		printf(_("Wrote the installed plug-ins into plug-in bundle %s.\n"), argv[1]);
+	}
+}
+
+/**
+ * Parses scan flags from the command arguments, displaying usage
+ * instructions on an unknown flag.
+ * 
+ * @param argc the number of command line elements
+ * @param argv the command and its arguments
+ * @param flags the parsed flags are stored here
+ * @return whether all flags were known
+ */
+static int parse_load_flags(int argc, char *argv[], int *flags) {
 	int i;
 	
-	// Set flags 
+	*flags = 0;
 	for (i = 1; i < argc; i++) {
 		int j;
 		
 		for (j = 0; load_flags[j].name != NULL; j++) {
 			if (!strcmp(argv[i], load_flags[j].name)) {
-				flags |= load_flags[j].value;
+				*flags |= load_flags[j].value;
 				break;
 			}
 		}
@@ -347,10 +430,19 @@ static void cmd_scan_plugins(int argc, char *argv[]) {
 			for (j = 0; load_flags[j].name != NULL; j++) {
 				printf("  %s - %s\n", load_flags[j].name, _(load_flags[j].description));
 			}
-			return;
+			return 0;
 		}
 	}
+	return 1;
+}
+
+static void cmd_scan_plugins(int argc, char *argv[]) {
+	int flags;
+	cp_status_t status;
 	
+	if (!parse_load_flags(argc, argv, &flags)) {
+		return;
+	}
 	if ((status = cp_scan_plugins(context, flags)) != CP_OK) {
 		api_failed("cp_scan_plugins", status);
 		return;
@@ -377,18 +469,28 @@ static char *state_to_string(cp_plugin_state_t state) {
 	}
 }
 
+static int comp_plugins(const void *p1, const void *p2) {
+	const cp_plugin_info_t *plugin1 = *((cp_plugin_info_t * const *) p1);
+	const cp_plugin_info_t *plugin2 = *((cp_plugin_info_t * const *) p2);
+	
+	return strcmp(plugin1->identifier, plugin2->identifier);
+}
+
 static void cmd_list_plugins(int argc, char *argv[]) {
 	cp_plugin_info_t **plugins;
 	cp_status_t status;
-	int i;
+	int i, n;
 
 	if (argc != 1) {
 		/* TRANSLATORS: Usage instructions for listing plug-ins */
 		printf(_("Usage: %s\n"), argv[0]);
-	} else if ((plugins = cp_get_plugins_info(context, &status, NULL)) == NULL) {
+	} else if ((plugins = cp_get_plugins_info(context, &status, &n)) == NULL) {
 		api_failed("cp_get_plugins_info", status);
 	} else {
 		const char format[] = "  %-24s %-8s %-12s %s\n";
+		
+		// List in a stable order independent of the framework internals
+		qsort(plugins, n, sizeof(cp_plugin_info_t *), comp_plugins);
 		fputs(_("Installed plug-ins:\n"), stdout);
 		printf(format,
 			_("IDENTIFIER"),
@@ -672,18 +774,26 @@ static void cmd_show_plugin_info(int argc, char *argv[]) {
 	}
 }
 
+static int comp_ext_points(const void *p1, const void *p2) {
+	const cp_ext_point_t *ep1 = *((cp_ext_point_t * const *) p1);
+	const cp_ext_point_t *ep2 = *((cp_ext_point_t * const *) p2);
+	
+	return strcmp(ep1->identifier, ep2->identifier);
+}
+
 static void cmd_list_ext_points(int argc, char *argv[]) {
 	cp_ext_point_t **ext_points;
 	cp_status_t status;
-	int i;
+	int i, n;
 
 	if (argc != 1) {
 		/* TRANSLATORS: Usage instructions for listing extension points */
 		printf(_("Usage: %s\n"), argv[0]);
-	} else if ((ext_points = cp_get_ext_points_info(context, &status, NULL)) == NULL) {
+	} else if ((ext_points = cp_get_ext_points_info(context, &status, &n)) == NULL) {
 		api_failed("cp_get_ext_points_info", status);
 	} else {
 		const char format[] = "  %-32s %s\n";
+		qsort(ext_points, n, sizeof(cp_ext_point_t *), comp_ext_points);
 		fputs(_("Installed extension points:\n"), stdout);
 		printf(format,
 			_("IDENTIFIER"),
@@ -697,18 +807,37 @@ static void cmd_list_ext_points(int argc, char *argv[]) {
 	}	
 }
 
+static int comp_extensions(const void *p1, const void *p2) {
+	const cp_extension_t *e1 = *((cp_extension_t * const *) p1);
+	const cp_extension_t *e2 = *((cp_extension_t * const *) p2);
+	int diff;
+	
+	// Anonymous extensions are ordered by plug-in and extension point
+	if ((diff = strcmp(e1->plugin->identifier, e2->plugin->identifier)) != 0) {
+		return diff;
+	} else if (e1->local_id == NULL || e2->local_id == NULL) {
+		if (e1->local_id != e2->local_id) {
+			return e1->local_id == NULL ? -1 : 1;
+		}
+	} else if ((diff = strcmp(e1->local_id, e2->local_id)) != 0) {
+		return diff;
+	}
+	return strcmp(e1->ext_point_id, e2->ext_point_id);
+}
+
 static void cmd_list_extensions(int argc, char *argv[]) {
 	cp_extension_t **extensions;
 	cp_status_t status;
-	int i;
+	int i, n;
 
 	if (argc != 1) {
 		/* TRANSLATORS: Usage instructions for listing extensions */
 		printf(_("Usage: %s\n"), argv[0]);
-	} else if ((extensions = cp_get_extensions_info(context, NULL, &status, NULL)) == NULL) {
+	} else if ((extensions = cp_get_extensions_info(context, NULL, &status, &n)) == NULL) {
 		api_failed("cp_get_extensions_info", status);
 	} else {
 		const char format[] = "  %-32s %s\n";
+		qsort(extensions, n, sizeof(cp_extension_t *), comp_extensions);
 		fputs(_("Installed extensions:\n"), stdout);
 		printf(format,
 			_("IDENTIFIER"),
@@ -804,6 +933,226 @@ static void cmd_run_plugins(int argc, char *argv[]) {
 	}
 }
 
+static void cmd_set_lock_profiling(int argc, char *argv[]) {
+	cp_status_t status;
+	int enabled;
+	
+	if (argc != 2 || (strcmp(argv[1], "on") && strcmp(argv[1], "off"))) {
+		/* TRANSLATORS: Usage instructions for enabling or disabling lock profiling */
+		printf(_("Usage: %s on|off\n"), argv[0]);
+		return;
+	}
+	enabled = !strcmp(argv[1], "on");
+	if ((status = cp_set_lock_profiling(context, enabled)) != CP_OK) {
+		api_failed("cp_set_lock_profiling", status);
+	} else if (enabled) {
+		fputs(_("Lock profiling enabled.\n"), stdout);
+	} else {
+		fputs(_("Lock profiling disabled.\n"), stdout);
+	}
+}
+
+static void print_lock_histogram(const char *label, const unsigned long *histogram) {
+	int i;
+	
+	printf("    %s:", label);
+	for (i = 0; i < CP_LOCK_HISTOGRAM_SIZE; i++) {
+		if (histogram[i] == 0) {
+			continue;
+		}
+		if (i == 0) {
+			printf(" <1us=%lu", histogram[i]);
+		} else if (i == CP_LOCK_HISTOGRAM_SIZE - 1) {
+			printf(" >=%luus=%lu", 1UL << (i - 1), histogram[i]);
+		} else {
+			printf(" <%luus=%lu", 1UL << i, histogram[i]);
+		}
+	}
+	fputs("\n", stdout);
+}
+
+static void cmd_show_lock_stats(int argc, char *argv[]) {
+	cp_lock_stats_t *stats;
+	cp_status_t status;
+	int num;
+	int i;
+	
+	if (argc != 1) {
+		/* TRANSLATORS: Usage instructions for showing lock statistics */
+		printf(_("Usage: %s\n"), argv[0]);
+	} else if ((stats = cp_get_lock_stats(context, &status, &num)) == NULL) {
+		api_failed("cp_get_lock_stats", status);
+	} else {
+		const char format[] = "  %-32s %10s %10s %12s %12s %10s\n";
+		const char rformat[] = "  %-32s %10lu %10lu %12llu %12llu %10llu\n";
+		fputs(_("Context lock statistics (times in microseconds):\n"), stdout);
+		printf(format,
+			_("FUNCTION"),
+			_("ACQUIRED"),
+			_("CONTENDED"),
+			_("WAIT"),
+			_("HOLD"),
+			_("MAX HOLD"));
+		for (i = 0; i < num; i++) {
+			printf(rformat,
+				stats[i].function != NULL ? stats[i].function : _("(other)"),
+				stats[i].acquisitions,
+				stats[i].contended,
+				stats[i].wait_usecs,
+				stats[i].hold_usecs,
+				stats[i].max_hold_usecs);
+			print_lock_histogram(_("wait"), stats[i].wait_histogram);
+			print_lock_histogram(_("hold"), stats[i].hold_histogram);
+		}
+		cp_release_info(context, stats);
+	}
+}
+
+/**
+ * Displays the statistics of the specified installed plug-ins.
+ * 
+ * @param plugins the plug-ins, NULL terminated
+ */
+static void print_plugin_stats(cp_plugin_info_t **plugins) {
+	const char format[] = "  %-24s %9s %9s %9s %9s %9s %9s %6s %8s %10s\n";
+	const char rformat[] = "  %-24s %9llu %9llu %9llu %9llu %9llu %9llu %6lu %8lu %10lu\n";
+	int i;
+	
+	fputs(_("Plug-in statistics (times in microseconds):\n"), stdout);
+	printf(format,
+		_("IDENTIFIER"),
+		_("PARSE"),
+		_("LOAD"),
+		_("CREATE"),
+		_("START"),
+		_("STOP"),
+		_("RUN"),
+		_("STARTS"),
+		_("RUNS"),
+		_("BYTES"));
+	for (i = 0; plugins[i] != NULL; i++) {
+		cp_plugin_stats_t stats;
+		
+		if (cp_get_plugin_stats(context, plugins[i]->identifier, &stats) != CP_OK) {
+			continue;
+		}
+		printf(rformat,
+			plugins[i]->identifier,
+			stats.parse_usecs,
+			stats.load_usecs,
+			stats.create_usecs,
+			stats.start_usecs,
+			stats.stop_usecs,
+			stats.run_usecs,
+			stats.num_starts,
+			stats.run_calls,
+			stats.descriptor_bytes);
+	}
+}
+
+static void cmd_stats(int argc, char *argv[]) {
+	cp_plugin_info_t **plugins;
+	cp_info_usage_t *usage;
+	cp_status_t status;
+	int num;
+	int i;
+	
+	if (argc > 2) {
+		/* TRANSLATORS: Usage instructions for showing plug-in statistics */
+		printf(_("Usage: %s [<plugin>]\n"), argv[0]);
+		return;
+	}
+	
+	// Display statistics of the requested plug-ins
+	if (argc == 2) {
+		cp_plugin_info_t *plugin;
+		cp_plugin_info_t *single[2];
+		
+		if ((plugin = cp_get_plugin_info(context, argv[1], &status)) == NULL) {
+			api_failed("cp_get_plugin_info", status);
+			return;
+		}
+		single[0] = plugin;
+		single[1] = NULL;
+		print_plugin_stats(single);
+		cp_release_info(context, plugin);
+		return;
+	}
+	if ((plugins = cp_get_plugins_info(context, &status, NULL)) == NULL) {
+		api_failed("cp_get_plugins_info", status);
+		return;
+	}
+	print_plugin_stats(plugins);
+	cp_release_info(context, plugins);
+	
+	// Display outstanding information objects
+	if ((usage = cp_get_info_usage(context, &status, &num)) == NULL) {
+		api_failed("cp_get_info_usage", status);
+		return;
+	}
+	fputs(_("Unreleased information objects:\n"), stdout);
+	printf("  %-24s %9s %10s\n", _("OWNER"), _("OBJECTS"), _("BYTES"));
+	for (i = 0; i < num; i++) {
+		printf("  %-24s %9u %10lu\n",
+			usage[i].plugin_id != NULL ? usage[i].plugin_id : _("(main program)"),
+			usage[i].num_infos,
+			usage[i].bytes);
+	}
+	cp_release_info(context, usage);
+}
+
+static void cmd_time(int argc, char *argv[]) {
+	unsigned long long start;
+	
+	if (argc < 2) {
+		/* TRANSLATORS: Usage instructions for timing a command */
+		printf(_("Usage: %s <command> [<argument>...]\n"), argv[0]);
+		return;
+	}
+	start = now_usecs();
+	run_command(argc - 1, argv + 1);
+	printf(_("Command %s took %llu microseconds.\n"), argv[1], now_usecs() - start);
+}
+
+static void cmd_profile_scan(int argc, char *argv[]) {
+	cp_plugin_info_t **plugins;
+	unsigned long long start, elapsed;
+	cp_status_t status;
+	int flags;
+	int profiling;
+	
+	if (!parse_load_flags(argc, argv, &flags)) {
+		return;
+	}
+	
+	// Profile the context lock only if the framework supports it
+	profiling = (cp_set_lock_profiling(context, 1) == CP_OK);
+	start = now_usecs();
+	status = cp_scan_plugins(context, flags);
+	elapsed = now_usecs() - start;
+	if (status != CP_OK) {
+		api_failed("cp_scan_plugins", status);
+	}
+	printf(_("Scanning plug-ins took %llu microseconds.\n"), elapsed);
+	
+	// Display where the time went
+	if ((plugins = cp_get_plugins_info(context, &status, NULL)) == NULL) {
+		api_failed("cp_get_plugins_info", status);
+	} else {
+		print_plugin_stats(plugins);
+		cp_release_info(context, plugins);
+	}
+	if (profiling) {
+		char *largv[1];
+		
+		largv[0] = "lock-stats";
+		cmd_show_lock_stats(1, largv);
+		cp_set_lock_profiling(context, 0);
+	} else {
+		fputs(_("Lock profiling is not available.\n"), stdout);
+	}
+}
+
 static void cmd_stop_plugin(int argc, char *argv[]) {
 	cp_status_t status;
 	
@@ -850,8 +1199,55 @@ static void cmd_uninstall_plugins(int argc, char *argv[]) {
 	}
 }
 
+/**
+ * Reads the next command line from a command file, echoing it after the
+ * prompt so that the output of a script reads like an interactive
+ * session. Empty lines and lines starting with '#' are skipped.
+ * 
+ * @param file the command file
+ * @param prompt the prompt to display before the command
+ * @return the command line, or NULL at the end of the file
+ */
+static char *script_input(FILE *file, const char *prompt) {
+	static char cmdline[256];
+	size_t len;
+	
+	while (fgets(cmdline, sizeof(cmdline), file) != NULL) {
+		char *c;
+		
+		len = strlen(cmdline);
+		if (len == sizeof(cmdline) - 1 && cmdline[len - 1] != '\n') {
+			int ch;
+			
+			do {
+				ch = getc(file);
+			} while (ch != '\n' && ch != EOF);
+			fputs(_("ERROR: Command line is too long.\n"), stderr);
+			continue;
+		}
+		if (len > 0 && cmdline[len - 1] == '\n') {
+			cmdline[--len] = '\0';
+		}
+		for (c = cmdline; isspace((unsigned char) *c); c++);
+		if (*c == '\0' || *c == '#') {
+			continue;
+		}
+		printf("%s%s\n", prompt, cmdline);
+		return cmdline;
+	}
+	return NULL;
+}
+
+static void usage(const char *prog) {
+	/* TRANSLATORS: Usage instructions for cpluff-console */
+	printf(_("Usage: %s [-f <command file>]\n"), prog);
+	fputs(_("  -f <file>  runs the commands in the file and exits\n"), stdout);
+	fputs(_("  -h         displays this help and exits\n"), stdout);
+}
+
 int main(int argc, char *argv[]) {
 	char *prompt;
+	FILE *script = NULL;
 	int i;
 	cp_status_t status;
 
@@ -860,6 +1256,22 @@ int main(int argc, char *argv[]) {
 	setlocale(LC_ALL, "");
 #endif
 
+	// Parse command line options
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-f") && i + 1 < argc && script == NULL) {
+			if ((script = fopen(argv[++i], "r")) == NULL) {
+				fprintf(stderr, _("Could not open command file %s.\n"), argv[i]);
+				exit(1);
+			}
+		} else if (!strcmp(argv[i], "-h")) {
+			usage(argv[0]);
+			exit(0);
+		} else {
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
 	// Initialize C-Pluff library 
 	if ((status = cp_init()) != CP_OK) {
 		api_failed("cp_init", status);
@@ -893,8 +1305,10 @@ int main(int argc, char *argv[]) {
 	printf(_("Using display log level %s (%s).\n"), log_levels[1].name, _(log_levels[1].description));
 
 	// Command line loop 
-	fputs(_("Type \"help\" for help on available commands.\n"), stdout);
-	cmdline_init();
+	if (script == NULL) {
+		fputs(_("Type \"help\" for help on available commands.\n"), stdout);
+		cmdline_init();
+	}
 	
 	/* TRANSLATORS: This is the input prompt for cpluff-console. */
 	prompt = _("C-Pluff Console > ");
@@ -905,9 +1319,15 @@ int main(int argc, char *argv[]) {
 		char **argv;
 		
 		// Get command line 
-		cmdline = cmdline_input(prompt);
+		if (script != NULL) {
+			cmdline = script_input(script, prompt);
+		} else {
+			cmdline = cmdline_input(prompt);
+		}
 		if (cmdline == NULL) {
-			putchar('\n');
+			if (script == NULL) {
+				putchar('\n');
+			}
 			cmdline = "exit";
 		}
 		
@@ -917,15 +1337,7 @@ int main(int argc, char *argv[]) {
 			continue;
 		}
 		
-		// Choose command 
-		for (i = 0; commands[i].name != NULL; i++) {
-			if (!strcmp(argv[0], commands[i].name)) {
-				commands[i].implementation(argc, argv);
-				break;
-			}
-		}
-		if (commands[i].name == NULL) {
-			printf(_("Unknown command %s.\n"), argv[0]);
-		}
+		// Run command 
+		run_command(argc, argv);
 	}
 }
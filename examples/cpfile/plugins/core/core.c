@@ -10,6 +10,20 @@
 #include "core.h"
 
 
+/* ------------------------------------------------------------------------
+ * Constants
+ * ----------------------------------------------------------------------*/
+
+/** The number of files classified by one run task */
+#define BATCH_SIZE 64
+
+/**
+ * The maximum number of batches being classified or waiting to be printed,
+ * which bounds the memory used regardless of the number of files
+ */
+#define MAX_PENDING_BATCHES 32
+
+
 /* ------------------------------------------------------------------------
  * Data types
  * ----------------------------------------------------------------------*/
@@ -20,6 +34,12 @@ typedef struct plugin_data_t plugin_data_t;
 /** Type for registered_classifier_t structure */
 typedef struct registered_classifier_t registered_classifier_t;
 
+/** Type for batch_t structure */
+typedef struct batch_t batch_t;
+
+/** Type for job_t structure */
+typedef struct job_t job_t;
+
 /** Plug-in instance data */
 struct plugin_data_t {
 	
@@ -43,19 +63,173 @@ struct registered_classifier_t {
 	classifier_t *classifier;
 };
 
+/** A batch of files classified by one run task */
+struct batch_t {
+	
+	/** The job this batch belongs to */
+	job_t *job;
+	
+	/** The paths of the files */
+	const char * const *paths;
+	
+	/** The number of files */
+	int num;
+	
+	/** The classification results, one per file */
+	classification_t *results;
+	
+	/**
+	 * Whether the batch has been classified. Set by the classifying task
+	 * before it resumes the output task, which makes the results visible.
+	 */
+	volatile int done;
+};
+
+/**
+ * The classification job for the file arguments. The files are split into
+ * batches which are queued as run tasks, so that the threads executing
+ * run functions classify the batches concurrently, and a single output
+ * task prints the results in argument order as the batches complete.
+ */
+struct job_t {
+	
+	/** The plug-in instance data */
+	plugin_data_t *data;
+	
+	/** The number of batches */
+	int num_batches;
+	
+	/** The next batch to be queued */
+	int next_queued;
+	
+	/** The next batch to be printed */
+	int next_printed;
+	
+	/** The batches */
+	batch_t *batches;
+};
+
 
 /* ------------------------------------------------------------------------
  * Internal functions
  * ----------------------------------------------------------------------*/
 
+static int print_results(void *d, void *task_data);
+
+/**
+ * Classifies a batch of files. The classifiers are tried in order of
+ * descending priority and each classifier only sees the files which are
+ * left unclassified by the classifiers before it.
+ */
+static int classify_batch(void *d, void *task_data) {
+	plugin_data_t *data = d;
+	batch_t *batch = task_data;
+	int i, j;
+
+	for (i = 0; i < data->num_classifiers; i++) {
+		classifier_t *cl = data->classifiers[i].classifier;
+		
+		if (cl->classify_batch != NULL) {
+			cl->classify_batch(cl->data, batch->num, batch->paths, batch->results);
+		} else {
+			for (j = 0; j < batch->num; j++) {
+				if (!batch->results[j].classified) {
+					batch->results[j].classified = cl->classify(cl->data, batch->paths[j], batch->results[j].description);
+				}
+			}
+		}
+	}
+	
+	// Let the output task print the results
+	batch->done = 1;
+	cp_resume_task(data->ctx, print_results, batch->job);
+	return CP_RUN_DONE;
+}
+
+/**
+ * Queues the next batches of the job, keeping the number of pending
+ * batches within the limit.
+ */
+static void queue_batches(job_t *job) {
+	while (job->next_queued < job->num_batches
+		&& job->next_queued - job->next_printed < MAX_PENDING_BATCHES) {
+		batch_t *batch = job->batches + job->next_queued;
+		
+		batch->results = calloc(batch->num, sizeof(classification_t));
+		if (batch->results == NULL
+			|| cp_run_task(job->data->ctx, classify_batch, NULL, batch) != CP_OK) {
+			
+			// Print the files unclassified rather than losing them
+			cp_log(job->data->ctx, CP_LOG_ERROR,
+				"Insufficient memory for classifying files.");
+			free(batch->results);
+			batch->results = NULL;
+			batch->done = 1;
+		}
+		job->next_queued++;
+	}
+}
+
+/**
+ * Releases the job.
+ */
+static void free_job(void *task_data) {
+	job_t *job = task_data;
+	int i;
+	
+	for (i = 0; i < job->num_batches; i++) {
+		free(job->batches[i].results);
+	}
+	free(job->batches);
+	free(job);
+}
+
+/**
+ * Prints the results of the completed batches in argument order and
+ * queues more batches. This task is suspended while waiting for the
+ * next batch to complete. Only this task modifies the job, so the job
+ * needs no locking.
+ */
+static int print_results(void *d, void *task_data) {
+	job_t *job = task_data;
+	
+	queue_batches(job);
+	while (job->next_printed < job->num_batches
+		&& job->batches[job->next_printed].done) {
+		batch_t *batch = job->batches + job->next_printed;
+		int i;
+		
+		for (i = 0; i < batch->num; i++) {
+			if (batch->results != NULL && batch->results[i].classified) {
+				printf("%s: %s\n", batch->paths[i], batch->results[i].description);
+			} else {
+				printf("%s: unknown file type\n", batch->paths[i]);
+			}
+		}
+		free(batch->results);
+		batch->results = NULL;
+		job->next_printed++;
+		queue_batches(job);
+	}
+	
+	// Check if all done
+	if (job->next_printed < job->num_batches) {
+		return CP_RUN_SUSPEND;
+	}
+	free_job(job);
+	return CP_RUN_DONE;
+}
+
 /**
  * A run function for the core plug-in. In this case this function acts as
- * the application main function so there is no need for us to split the
- * execution into small steps. Rather, we execute the whole main loop at
- * once to make it simpler.
+ * the application main function. It splits the file arguments into
+ * batches and queues them to be classified by run tasks, which may be
+ * executed in parallel threads, for example using the -t option of
+ * cpluff-loader.
  */
 static int run(void *d) {
 	plugin_data_t *data = d;
+	job_t *job;
 	char **argv;
 	int argc;
 	int i;
@@ -67,29 +241,34 @@ static int run(void *d) {
 		return 0;
 	}
 
-	// Go through all files listed as command arguments
-	for (i = 1; argv[i] != NULL; i++) {
-		int j;
-		int classified = 0;
-		
-		// Print file name
-		printf("%s: ", argv[i]);
-		
-		// Try classifiers in order of descending priority
-		for (j = 0; !classified && j < data->num_classifiers; j++) {
-			classifier_t *cl
-				= data->classifiers[j].classifier;
-				
-			classified = cl->classify(cl->data, argv[i]);
-		}
+	// Split the files into batches
+	if ((job = malloc(sizeof(job_t))) == NULL
+		|| (job->batches = calloc((argc - 2) / BATCH_SIZE + 1, sizeof(batch_t))) == NULL) {
+		cp_log(data->ctx, CP_LOG_ERROR,
+			"Insufficient memory for classifying files.");
+		free(job);
+		return 0;
+	}
+	job->data = data;
+	job->num_batches = (argc - 2) / BATCH_SIZE + 1;
+	job->next_queued = 0;
+	job->next_printed = 0;
+	for (i = 0; i < job->num_batches; i++) {
+		batch_t *batch = job->batches + i;
 		
-		// Check if unknown file
-		if (!classified) {
-			fputs("unknown file type\n", stdout);
-		}
+		batch->job = job;
+		batch->paths = (const char * const *) argv + 1 + i * BATCH_SIZE;
+		batch->num = (i < job->num_batches - 1 ? BATCH_SIZE : argc - 1 - i * BATCH_SIZE);
+	}
+	
+	// Start the output task which queues the batches
+	if (cp_run_task(data->ctx, print_results, free_job, job) != CP_OK) {
+		cp_log(data->ctx, CP_LOG_ERROR,
+			"Insufficient memory for classifying files.");
+		free_job(job);
 	}
 	
-	// All done
+	// All work is done by the run tasks
 	return 0;
 } 
 
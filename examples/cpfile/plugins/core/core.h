@@ -7,16 +7,52 @@
 #ifndef CORE_H_
 #define CORE_H_
 
+/** The size of the buffer holding a file description */
+#define CLASSIFY_DESC_SIZE 128
+
+/** A short hand typedef for classification_t structure */
+typedef struct classification_t classification_t;
+
+/**
+ * The result of classifying a file.
+ */
+struct classification_t {
+	
+	/** Whether the file has been classified */
+	int classified;
+	
+	/** The description of the file, if classified */
+	char description[CLASSIFY_DESC_SIZE];
+};
+
 /**
  * A function that classifies a file. If the classification succeeds then
- * the function should print file description to standard output and
- * return a non-zero value. Otherwise the function must return zero.
+ * the function should store the file description into the supplied
+ * buffer of CLASSIFY_DESC_SIZE characters and return a non-zero value.
+ * Otherwise the function must return zero. The function is called
+ * concurrently from several threads.
  *
  * @param data classified specific runtime data
  * @param path the file path 
+ * @param desc the buffer for the file description
  * @return whether classification was successful
  */
-typedef int (*classify_func_t)(void *data, const char *path);
+typedef int (*classify_func_t)(void *data, const char *path, char *desc);
+
+/**
+ * A function that classifies a batch of files. The function should skip
+ * the files which have already been classified and fill in the results
+ * of the files it recognizes. Classifiers with a fixed setup cost per
+ * call, such as looking up extensions, should provide this function to
+ * pay the cost once per batch. The function is called concurrently from
+ * several threads.
+ *
+ * @param data classified specific runtime data
+ * @param num the number of files
+ * @param paths the file paths
+ * @param results the classification results, one per file
+ */
+typedef void (*classify_batch_func_t)(void *data, int num, const char * const *paths, classification_t *results);
 
 /** A short hand typedef for classifier_t structure */
 typedef struct classifier_t classifier_t;
@@ -31,6 +67,9 @@ struct classifier_t {
 	
 	/** The classifying function */
 	classify_func_t classify;
+	
+	/** The batch classifying function, or NULL to classify files one at a time */
+	classify_batch_func_t classify_batch;
 }; 
 
 #endif /*CORE_H_*/
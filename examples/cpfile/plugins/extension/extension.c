@@ -12,104 +12,299 @@
 
 
 /* ------------------------------------------------------------------------
- * Internal functions
+ * Data types
  * ----------------------------------------------------------------------*/
 
-static int is_of_type(const char *path, const cp_cfg_element_t *type);
+/** Type for plugin_data_t structure */
+typedef struct plugin_data_t plugin_data_t;
+
+/** Type for trie_node_t structure */
+typedef struct trie_node_t trie_node_t;
 
 /**
- * Classifies a file based on file extension. This classifier uses extensions
- * installed at the file type extension point. Therefore we need pointer to
- * the plug-in context to access the extensions. A plug-in instance initializes
- * the classifier structure with the plug-in context pointer and registers a
- * virtual symbol pointing to the classifier.
+ * A node of the suffix trie. The trie contains the configured file
+ * extensions in reverse, so that the suffixes of a file name are found by
+ * walking the trie from the end of the name. The nodes are stored in an
+ * array and refer to each other by their index.
  */
-static int classify(void *d, const char *path) {
-	cp_context_t *ctx = d;
+struct trie_node_t {
+
+	/** The character leading to this node */
+	unsigned char ch;
+
+	/** The index of the first child, or zero if none */
+	int first_child;
+
+	/** The index of the next sibling, or zero if none */
+	int next_sibling;
+
+	/**
+	 * The index of the first file type having the extension ending at
+	 * this node, or -1 if no extension ends here
+	 */
+	int type;
+};
+
+/**
+ * Plug-in instance data. The classifier is the first member so that the
+ * classifier data pointer can be used as the instance data pointer.
+ */
+struct plugin_data_t {
+
+	/** The classifier registered as a symbol */
+	classifier_t classifier;
+
+	/** The plug-in context */
+	cp_context_t *ctx;
+
+	/** The file type extensions, holding the descriptions */
 	cp_extension_t **exts;
-	const char *type = NULL;
+
+	/** The descriptions of the file types in extension order */
+	const char **types;
+
+	/** The number of file types */
+	int num_types;
+
+	/** The nodes of the suffix trie, the root node first */
+	trie_node_t *nodes;
+
+	/** The number of nodes */
+	int num_nodes;
+
+	/** The number of allocated nodes */
+	int size_nodes;
+};
+
+
+/* ------------------------------------------------------------------------
+ * Internal functions
+ * ----------------------------------------------------------------------*/
+
+/**
+ * Returns the description of the file type matching the file name, or
+ * NULL if none of the file extensions matches. When several extensions
+ * match the one of the file type configured first wins. The cost depends
+ * only on the length of the longest matching extension.
+ */
+static const char *find_type(const plugin_data_t *data, const char *path) {
+	const trie_node_t *nodes = data->nodes;
+	int node = 0;
+	int type = nodes[0].type;
+	size_t i;
+
+	for (i = strlen(path); i > 0; i--) {
+		unsigned char ch = path[i - 1];
+		int child;
+
+		for (child = nodes[node].first_child; child != 0 && nodes[child].ch != ch; child = nodes[child].next_sibling);
+		if (child == 0) {
+			break;
+		}
+		node = child;
+		if (nodes[node].type != -1 && (type == -1 || nodes[node].type < type)) {
+			type = nodes[node].type;
+		}
+	}
+	return (type != -1 ? data->types[type] : NULL);
+}
+
+/**
+ * Stores a file description, truncating it if necessary.
+ */
+static void set_desc(char *desc, const char *type) {
+	strncpy(desc, type, CLASSIFY_DESC_SIZE - 1);
+	desc[CLASSIFY_DESC_SIZE - 1] = '\0';
+}
+
+/**
+ * Classifies a file based on file extension. This classifier uses
+ * extensions installed at the file type extension point, compiled into
+ * a suffix trie when the plug-in is started. A plug-in instance
+ * initializes the classifier structure and registers a virtual symbol
+ * pointing to the classifier.
+ */
+static int classify(void *d, const char *path, char *desc) {
+	const char *type;
+
+	if ((type = find_type(d, path)) != NULL) {
+		set_desc(desc, type);
+	}
+
+	// Tell whether recognized, otherwise other classifiers are tried
+	return (type != NULL);
+}
+
+/**
+ * Classifies a batch of files based on file extension.
+ */
+static void classify_batch(void *d, int num, const char * const *paths, classification_t *results) {
 	int i;
-	
-	// Go through all extensions registered at the extension point
-	exts = cp_get_extensions_info(ctx, "org.c-pluff.examples.cpfile.extension.file-types", NULL, NULL);
-	if (exts == NULL) {
-		cp_log(ctx, CP_LOG_ERROR, "Could not resolve file type extensions.");
-		return 0;
+
+	for (i = 0; i < num; i++) {
+		const char *type;
+
+		if (!results[i].classified && (type = find_type(d, paths[i])) != NULL) {
+			set_desc(results[i].description, type);
+			results[i].classified = 1;
+		}
 	}
-	for (i = 0; type == NULL && exts[i] != NULL; i++) {
-		int j;
-		
-		// Go through all file types provided by the extension
-		for (j = 0; type == NULL && j < exts[i]->configuration->num_children; j++) {
-			cp_cfg_element_t *elem = exts[i]->configuration->children + j;
-			const char *desc = NULL;
-			
-			if (strcmp(elem->name, "file-type") == 0
-				&& (desc = cp_lookup_cfg_value(elem, "@description")) != NULL
-				&& (is_of_type(path, elem))) {
-				type = desc;
+}
+
+/**
+ * Adds a file extension into the suffix trie.
+ *
+ * @return whether successful
+ */
+static int add_extension(plugin_data_t *data, const char *ext, int type) {
+	int node = 0;
+	size_t i;
+
+	for (i = strlen(ext); i > 0; i--) {
+		unsigned char ch = ext[i - 1];
+		int child;
+
+		for (child = data->nodes[node].first_child; child != 0 && data->nodes[child].ch != ch; child = data->nodes[child].next_sibling);
+		if (child == 0) {
+			trie_node_t *nn;
+
+			// Add a new node as the first child
+			if (data->num_nodes == data->size_nodes) {
+				if ((nn = realloc(data->nodes, 2 * data->size_nodes * sizeof(trie_node_t))) == NULL) {
+					return 0;
+				}
+				data->nodes = nn;
+				data->size_nodes *= 2;
 			}
+			child = data->num_nodes++;
+			nn = data->nodes + child;
+			nn->ch = ch;
+			nn->first_child = 0;
+			nn->next_sibling = data->nodes[node].first_child;
+			nn->type = -1;
+			data->nodes[node].first_child = child;
 		}
+		node = child;
 	}
-	
-	// Release extension information
-	cp_release_info(ctx, exts);
-	
-	// Print file type if recognized, otherwise try other classifiers
-	if (type != NULL) {
-		fputs(type, stdout);
-		putchar('\n');
-		return 1;
-	} else {
-		return 0;
+
+	// Types configured earlier take precedence
+	if (data->nodes[node].type == -1) {
+		data->nodes[node].type = type;
 	}
+	return 1;
 }
 
 /**
- * Returns whether the specified file is of the type matching the specified
- * file-type element.
+ * Compiles the file extensions of the configured file types into the
+ * suffix trie.
+ *
+ * @return whether successful
  */
-static int is_of_type(const char *path, const cp_cfg_element_t *type) {
-	int i;
-	int iot = 0;
-	
-	/* Go through all extensions specified for the type */
-	for (i = 0; !iot && i < type->num_children; i++) {
-		cp_cfg_element_t *ee = type->children + i;
-		const char *ext;
-		
-		iot = (strcmp(ee->name, "file-extension") == 0
-			&& (ext = cp_lookup_cfg_value(ee, "@ext")) != NULL
-			&& strlen(path) >= strlen(ext)
-			&& strcmp(path + (strlen(path) - strlen(ext)), ext) == 0);
+static int compile_types(plugin_data_t *data) {
+	int i, num = 0;
+
+	// Count the file types
+	for (i = 0; data->exts[i] != NULL; i++) {
+		num += data->exts[i]->configuration->num_children;
 	}
-	
-	return iot;
+	if ((data->types = malloc((num > 0 ? num : 1) * sizeof(const char *))) == NULL
+		|| (data->nodes = malloc(64 * sizeof(trie_node_t))) == NULL) {
+		return 0;
+	}
+	data->size_nodes = 64;
+	data->num_nodes = 1;
+	data->nodes[0].ch = '\0';
+	data->nodes[0].first_child = 0;
+	data->nodes[0].next_sibling = 0;
+	data->nodes[0].type = -1;
+
+	// Add the extensions of each file type
+	for (i = 0; data->exts[i] != NULL; i++) {
+		unsigned int j;
+
+		for (j = 0; j < data->exts[i]->configuration->num_children; j++) {
+			cp_cfg_element_t *elem = data->exts[i]->configuration->children + j;
+			const char *desc;
+			unsigned int k;
+
+			if (strcmp(elem->name, "file-type") != 0
+				|| (desc = cp_lookup_cfg_value(elem, "@description")) == NULL) {
+				continue;
+			}
+			data->types[data->num_types] = desc;
+			for (k = 0; k < elem->num_children; k++) {
+				cp_cfg_element_t *ee = elem->children + k;
+				const char *ext;
+
+				if (strcmp(ee->name, "file-extension") == 0
+					&& (ext = cp_lookup_cfg_value(ee, "@ext")) != NULL
+					&& !add_extension(data, ext, data->num_types)) {
+					return 0;
+				}
+			}
+			data->num_types++;
+		}
+	}
+	return 1;
 }
 
 /**
- * Creates a new plug-in instance. We use classifier instance as plug-in
- * instance because it includes all the data our plug-in instance needs.
+ * Creates a new plug-in instance. We use classifier instance as the
+ * beginning of the plug-in instance.
  */
 static void *create(cp_context_t *ctx) {
-	classifier_t *cl;
-	
-	cl = malloc(sizeof(classifier_t));
-	if (cl != NULL) {
-		cl->data = ctx;
-		cl->classify = classify;
+	plugin_data_t *data;
+
+	data = malloc(sizeof(plugin_data_t));
+	if (data != NULL) {
+		memset(data, 0, sizeof(plugin_data_t));
+		data->classifier.data = data;
+		data->classifier.classify = classify;
+		data->classifier.classify_batch = classify_batch;
+		data->ctx = ctx;
+	}
+	return data;
+}
+
+/**
+ * Releases the compiled file types.
+ */
+static void stop(void *d) {
+	plugin_data_t *data = d;
+
+	if (data->exts != NULL) {
+		cp_release_info(data->ctx, data->exts);
+		data->exts = NULL;
 	}
-	return cl;
+	free(data->types);
+	data->types = NULL;
+	data->num_types = 0;
+	free(data->nodes);
+	data->nodes = NULL;
+	data->num_nodes = 0;
+	data->size_nodes = 0;
 }
 
 /**
- * Initializes and starts the plug-in.
+ * Initializes and starts the plug-in. The file types registered at the
+ * extension point are compiled once here, so file types installed later
+ * are recognized after the plug-in has been restarted.
  */
 static int start(void *d) {
-	classifier_t *cl = d;
-	cp_context_t *ctx = cl->data;
-	
-	return cp_define_symbol(ctx, "cp_ex_cpfile_extension_classifier", cl);
+	plugin_data_t *data = d;
+	cp_status_t status;
+
+	data->exts = cp_get_extensions_info(data->ctx, "org.c-pluff.examples.cpfile.extension.file-types", &status, NULL);
+	if (data->exts == NULL) {
+		cp_log(data->ctx, CP_LOG_ERROR, "Could not resolve file type extensions.");
+		return status;
+	}
+	if (!compile_types(data)) {
+		cp_log(data->ctx, CP_LOG_ERROR, "Insufficient memory for file types.");
+		stop(data);
+		return CP_ERR_RESOURCE;
+	}
+	return cp_define_symbol(data->ctx, "cp_ex_cpfile_extension_classifier", &(data->classifier));
 }
 
 /**
@@ -133,6 +328,6 @@ static void destroy(void *d) {
 CP_EXPORT cp_plugin_runtime_t cp_ex_cpfile_extension_funcs = {
 	create,
 	start,
-	NULL,
+	stop,
 	destroy
 };
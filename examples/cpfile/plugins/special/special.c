@@ -5,6 +5,8 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <cpluff.h>
@@ -27,15 +29,14 @@
  * we do not need a plug-in instance either as there is no data to be
  * initialized.
  */
-static int classify(void *dummy, const char *path) {
+static int classify(void *dummy, const char *path, char *desc) {
 #ifdef STAT
 	struct stat s;
 	const char *type;
 	
 	// Stat the file
 	if (STAT(path, &s)) {
-		fflush(stdout);
-		perror("stat failed");
+		snprintf(desc, CLASSIFY_DESC_SIZE, "stat failed: %s", strerror(errno));
 		
 		// No point for other classifiers to classify this
 		return 1;
@@ -62,9 +63,8 @@ static int classify(void *dummy, const char *path) {
 		return 0;
 	}
 		
-	// Print recognized file type
-	fputs(type, stdout);
-	putchar('\n');
+	// Return recognized file type
+	strcpy(desc, type);
 	return 1;
 #else
 	return 0;
@@ -76,4 +76,4 @@ static int classify(void *dummy, const char *path) {
  * Exported classifier information
  * ----------------------------------------------------------------------*/
 
-CP_EXPORT classifier_t cp_ex_cpfile_special_classifier = { NULL, classify };
+CP_EXPORT classifier_t cp_ex_cpfile_special_classifier = { NULL, classify, NULL };
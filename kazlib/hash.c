@@ -22,6 +22,15 @@
  * Modified by Johannes Lehtinen in 2006-2007.
  * Included the definition of CP_HIDDEN macro and used it in declarations and
  * definitions to hide Kazlib symbols when building a shared C-Pluff library.
+ *
+ * Later modified to use open addressing instead of separate chaining. The
+ * table holds pointers to the nodes in slots probed linearly, accompanied by
+ * an array of control bytes carrying tags of the hash values. The interface
+ * is unchanged except that nodes are not linked to each other.
+ *
+ * Later modified to resize dynamic tables incrementally, moving the nodes to
+ * the new table a few slots at a time during subsequent insertions, and to
+ * replace the default string hash with one consuming four bytes per step.
  */
 
 #include <stdlib.h>
@@ -45,8 +54,10 @@ static const char rcsid[] = "$Id: hash.c,v 1.36.2.11 2000/11/13 01:36:45 kaz Exp
 #define hkey hash_hkey
 
 #define table hash_table
+#define ctrl hash_ctrl
 #define nchains hash_nchains
 #define nodecount hash_nodecount
+#define deleted hash_deleted
 #define maxcount hash_maxcount
 #define highmark hash_highmark
 #define lowmark hash_lowmark
@@ -57,13 +68,46 @@ static const char rcsid[] = "$Id: hash.c,v 1.36.2.11 2000/11/13 01:36:45 kaz Exp
 #define context hash_context
 #define mask hash_mask
 #define dynamic hash_dynamic
+#define oldtable hash_oldtable
+#define oldsize hash_oldsize
+#define migrated hash_migrated
 
 #define table hash_table
 #define chain hash_chain
 
+/*
+ * Control byte values. Each slot of a table with control bytes has a byte
+ * telling whether the slot is empty, holds a deleted node or holds a node.
+ * For an occupied slot the low seven bits hold a tag derived from the hash
+ * value, so that most mismatching slots are skipped without touching the
+ * node. The control bytes are contiguous so that a probe sequence can be
+ * examined within a cache line or two.
+ */
+
+#define CTRL_EMPTY	0x00
+#define CTRL_DELETED	0x01
+#define CTRL_FULL	0x80
+
+/*
+ * Marker stored in slots of deleted nodes. Deleted slots are skipped by
+ * lookups but may be reused by insertions. They are purged when the table
+ * is rehashed.
+ */
+
+static hnode_t deleted_node;
+#define DELETED (&deleted_node)
+
+/*
+ * The number of slots of the previous table moved to the current table by
+ * each insertion while a table is being resized. The table grows to twice
+ * the size when it is 3/4 full, so the previous table has been emptied long
+ * before the current table reaches its high mark.
+ */
+
+#define MIGRATE_SLOTS	8
+
 static hnode_t *hnode_alloc(void *context);
 static void hnode_free(hnode_t *node, void *context);
-static hash_val_t hash_fun_default(const void *key);
 static int hash_comp_default(const void *key1, const void *key2);
 
 CP_HIDDEN int hash_val_t_bit;
@@ -120,7 +164,33 @@ static hash_val_t compute_mask(hashcount_t size)
 }
 
 /*
- * Initialize the table of pointers to null.
+ * Scramble a hash value before deriving the slot index and the control tag.
+ * Linear probing is sensitive to clustering, and the user supplied hash
+ * functions (such as those hashing pointers) may leave the low bits poorly
+ * distributed. Wider hash values are first folded to 32 bits so that the
+ * slot order, and thus the scan order, is the same for 32-bit hash values
+ * regardless of the width of hash_val_t.
+ */
+
+static hash_val_t mix_hash(hash_val_t hkey)
+{
+    hkey = (hkey ^ (hkey >> 16 >> 16)) & 0xffffffffUL;
+    hkey ^= hkey >> 15;
+    hkey = (hkey * 0x2c1b3c6dUL) & 0xffffffffUL;
+    hkey ^= hkey >> 12;
+    hkey = (hkey * 0x297a2d39UL) & 0xffffffffUL;
+    hkey ^= hkey >> 15;
+    return hkey;
+}
+
+/*
+ * The control byte of an occupied slot for a mixed hash value.
+ */
+
+#define ctrl_tag(mixed) ((unsigned char) (CTRL_FULL | (((mixed) >> 24) & 0x7f)))
+
+/*
+ * Initialize the table of slots to empty.
  */
 
 static void clear_table(hash_t *hash)
@@ -129,139 +199,147 @@ static void clear_table(hash_t *hash)
 
     for (i = 0; i < hash->nchains; i++)
 	hash->table[i] = NULL;
+    if (hash->ctrl)
+	memset(hash->ctrl, CTRL_EMPTY, hash->nchains);
+    hash->deleted = 0;
 }
 
 /*
- * Double the size of a dynamic table. This works as follows. Each chain splits
- * into two adjacent chains.  The shift amount increases by one, exposing an
- * additional bit of each hashed key. For each node in the original chain, the
- * value of this newly exposed bit will decide which of the two new chains will
- * receive the node: if the bit is 1, the chain with the higher index will have
- * the node, otherwise the lower chain will receive the node. In this manner,
- * the hash table will continue to function exactly as before without having to
- * rehash any of the keys.
- * Notes:
- * 1.  Overflow check.
- * 2.  The new number of chains is twice the old number of chains.
- * 3.  The new mask is one bit wider than the previous, revealing a
- *     new bit in all hashed keys.
- * 4.  Allocate a new table of chain pointers that is twice as large as the
- *     previous one.
- * 5.  If the reallocation was successful, we perform the rest of the growth
- *     algorithm, otherwise we do nothing.
- * 6.  The exposed_bit variable holds a mask with which each hashed key can be
- *     AND-ed to test the value of its newly exposed bit.
- * 7.  Now loop over each chain in the table and sort its nodes into two
- *     chains based on the value of each node's newly exposed hash bit.
- * 8.  The low chain replaces the current chain.  The high chain goes
- *     into the corresponding sister chain in the upper half of the table.
- * 9.  We have finished dealing with the chains and nodes. We now update
- *     the various bookeeping fields of the hash structure.
+ * Allocate the slots and the control bytes of a dynamic table as one block.
  */
 
-static void grow_table(hash_t *hash)
+static hnode_t **alloc_slots(hashcount_t size)
 {
-    hnode_t **newtable;
-
-    assert (2 * hash->nchains > hash->nchains);	/* 1 */
+    return malloc((sizeof (hnode_t *) + 1) * size);
+}
 
-    newtable = realloc(hash->table,
-	    sizeof *newtable * hash->nchains * 2);	/* 4 */
+/*
+ * Place a node into the first free slot of its probe sequence. The node must
+ * not be in the table. The table must have at least one free slot.
+ */
 
-    if (newtable) {	/* 5 */
-	hash_val_t mask = (hash->mask << 1) | 1;	/* 3 */
-	hash_val_t exposed_bit = mask ^ hash->mask;	/* 6 */
-	hash_val_t chain;
+static void place_node(hash_t *hash, hnode_t *node)
+{
+    hash_val_t mixed = mix_hash(node->hkey);
+    hash_val_t slot = mixed & hash->mask;
+
+    while (hash->table[slot] != NULL && hash->table[slot] != DELETED)
+	slot = (slot + 1) & hash->mask;
+    if (hash->table[slot] == DELETED)
+	hash->deleted--;
+    hash->table[slot] = node;
+    if (hash->ctrl)
+	hash->ctrl[slot] = ctrl_tag(mixed);
+}
 
-	assert (mask != hash->mask);
+/*
+ * The control bytes of the previous table of a table being resized.
+ */
 
-	for (chain = 0; chain < hash->nchains; chain++) { /* 7 */
-	    hnode_t *low_chain = 0, *high_chain = 0, *hptr, *next;
+#define old_ctrl(hash) ((unsigned char *) ((hash)->oldtable + (hash)->oldsize))
 
-	    for (hptr = newtable[chain]; hptr != 0; hptr = next) {
-		next = hptr->next;
+/*
+ * Move the nodes of up to the given number of slots of the previous table
+ * to the current table, and free the previous table once all of its slots
+ * have been moved.
+ * Notes:
+ * 1. The slot of a moved node is marked deleted rather than empty, so that
+ *    the probe sequences of the nodes not yet moved stay intact.
+ * 2. The full hash value stored in the node is used, so no keys are
+ *    rehashed.
+ */
 
-		if (hptr->hkey & exposed_bit) {
-		    hptr->next = high_chain;
-		    high_chain = hptr;
-		} else {
-		    hptr->next = low_chain;
-		    low_chain = hptr;
-		}
-	    }
+static void migrate_slots(hash_t *hash, hashcount_t count)
+{
+    while (count > 0 && hash->migrated < hash->oldsize) {
+	hnode_t *node = hash->oldtable[hash->migrated];
 
-	    newtable[chain] = low_chain; 	/* 8 */
-	    newtable[chain + hash->nchains] = high_chain;
+	if (node != NULL && node != DELETED) {
+	    hash->oldtable[hash->migrated] = DELETED;	/* 1 */
+	    old_ctrl(hash)[hash->migrated] = CTRL_DELETED;
+	    place_node(hash, node);	/* 2 */
 	}
-
-	hash->table = newtable;			/* 9 */
-	hash->mask = mask;
-	hash->nchains *= 2;
-	hash->lowmark *= 2;
-	hash->highmark *= 2;
+	hash->migrated++;
+	count--;
+    }
+    if (hash->oldtable && hash->migrated == hash->oldsize) {
+	free(hash->oldtable);
+	hash->oldtable = NULL;
+	hash->oldsize = 0;
+	hash->migrated = 0;
     }
-    assert (hash_verify(hash));
 }
 
 /*
- * Cut a table size in half. This is done by folding together adjacent chains
- * and populating the lower half of the table with these chains. The chains are
- * simply spliced together. Once this is done, the whole table is reallocated
- * to a smaller object.
+ * Start rebuilding a dynamic table with the given number of slots, dropping
+ * the deleted slots. Nodes do not move in memory, only their slots change, so
+ * node pointers held by the user stay valid.
  * Notes:
- * 1.  It is illegal to have a hash table with one slot. This would mean that
- *     hash->shift is equal to hash_val_t_bit, an illegal shift value.
- *     Also, other things could go wrong, such as hash->lowmark becoming zero.
- * 2.  Looping over each pair of sister chains, the low_chain is set to
- *     point to the head node of the chain in the lower half of the table, 
- *     and high_chain points to the head node of the sister in the upper half.
- * 3.  The intent here is to compute a pointer to the last node of the
- *     lower chain into the low_tail variable. If this chain is empty,
- *     low_tail ends up with a null value.
- * 4.  If the lower chain is not empty, we simply tack the upper chain onto it.
- *     If the upper chain is a null pointer, nothing happens.
- * 5.  Otherwise if the lower chain is empty but the upper one is not,
- *     If the low chain is empty, but the high chain is not, then the
- *     high chain is simply transferred to the lower half of the table.
- * 6.  Otherwise if both chains are empty, there is nothing to do.
- * 7.  All the chain pointers are in the lower half of the table now, so
- *     we reallocate it to a smaller object. This, of course, invalidates
- *     all pointer-to-pointers which reference into the table from the
- *     first node of each chain.
- * 8.  Though it's unlikely, the reallocation may fail. In this case we
- *     pretend that the table _was_ reallocated to a smaller object.
- * 9.  Finally, update the various table parameters to reflect the new size.
+ * 1. Only one previous table is kept, so a resize still in progress is
+ *    completed first.
+ * 2. Allocate the new slots and control bytes. If this fails, the table is
+ *    left unchanged and zero is returned.
+ * 3. The current table becomes the previous table, and its nodes are moved
+ *    to the new table by subsequent insertions. See migrate_slots().
+ * 4. The high mark keeps the load factor, including the deleted slots,
+ *    at most 3/4, which keeps probe sequences short. The low mark is at
+ *    load factor 1/8.
  */
 
-static void shrink_table(hash_t *hash)
+static int rehash_table(hash_t *hash, hashcount_t size)
 {
-    hash_val_t chain, nchains;
-    hnode_t **newtable, *low_tail, *low_chain, *high_chain;
-
-    assert (hash->nchains >= 2);			/* 1 */
-    nchains = hash->nchains / 2;
-
-    for (chain = 0; chain < nchains; chain++) {
-	low_chain = hash->table[chain];		/* 2 */
-	high_chain = hash->table[chain + nchains];
-	for (low_tail = low_chain; low_tail && low_tail->next; low_tail = low_tail->next)
-	    ;	/* 3 */
-	if (low_chain != 0)				/* 4 */
-	    low_tail->next = high_chain;
-	else if (high_chain != 0)			/* 5 */
-	    hash->table[chain] = high_chain;
-	else
-	    assert (hash->table[chain] == NULL);	/* 6 */
-    }
-    newtable = realloc(hash->table,
-	    sizeof *newtable * nchains);		/* 7 */
-    if (newtable)					/* 8 */
-	hash->table = newtable;
-    hash->mask >>= 1;			/* 9 */
-    hash->nchains = nchains;
-    hash->lowmark /= 2;
-    hash->highmark /= 2;
+    hnode_t **newtable;
+
+    assert (hash->dynamic);
+    assert (is_power_of_two(size));
+    assert (size > hash->nodecount);
+
+    migrate_slots(hash, hash->oldsize);	/* 1 */
+
+    if ((newtable = alloc_slots(size)) == NULL)	/* 2 */
+	return 0;
+
+    hash->oldtable = hash->table;	/* 3 */
+    hash->oldsize = hash->nchains;
+    hash->migrated = 0;
+    hash->table = newtable;
+    hash->ctrl = (unsigned char *) (newtable + size);
+    hash->nchains = size;
+    hash->mask = compute_mask(size);
+    clear_table(hash);
+
+    hash->highmark = size / 4 * 3;	/* 4 */
+    hash->lowmark = size / 8;
     assert (hash_verify(hash));
+    return 1;
+}
+
+/*
+ * Double the size of a dynamic table. If there is a significant number of
+ * deleted slots, the table is only rebuilt at the same size.
+ */
+
+static void grow_table(hash_t *hash)
+{
+    hashcount_t size = hash->nchains;
+
+    assert (2 * hash->nchains > hash->nchains);
+    if (hash->nodecount >= size / 2)
+	size *= 2;
+    rehash_table(hash, size);
+}
+
+/*
+ * Cut a table size in half. If reallocation fails, the table stays as is.
+ * The table is shrunk at a low load factor, so the nodes are moved at once.
+ */
+
+static void shrink_table(hash_t *hash)
+{
+    assert (hash->nchains >= 2);
+    if (hash->nchains / 2 > hash->nodecount
+	    && rehash_table(hash, hash->nchains / 2))
+	migrate_slots(hash, hash->oldsize);
 }
 
 
@@ -277,21 +355,18 @@ static void shrink_table(hash_t *hash)
  * 2. Allocate a hash table control structure.
  * 3. If a hash table control structure is successfully allocated, we
  *    proceed to initialize it. Otherwise we return a null pointer.
- * 4. We try to allocate the table of hash chains.
- * 5. If we were able to allocate the hash chain table, we can finish
- *    initializing the hash structure and the table. Otherwise, we must
- *    backtrack by freeing the hash structure.
- * 6. INIT_SIZE should be a power of two. The high and low marks are always set
- *    to be twice the table size and half the table size respectively. When the
- *    number of nodes in the table grows beyond the high size (beyond load
- *    factor 2), it will double in size to cut the load factor down to about
- *    about 1. If the table shrinks down to or beneath load factor 0.5,
- *    it will shrink, bringing the load up to about 1. However, the table
- *    will never shrink beneath INIT_SIZE even if it's emptied.
+ * 4. We try to allocate the table of slots and control bytes.
+ * 5. If we were able to allocate the slots, we can finish initializing the
+ *    hash structure and the table. Otherwise, we must backtrack by freeing
+ *    the hash structure.
+ * 6. INIT_SIZE should be a power of two. The table grows when the occupied
+ *    and deleted slots exceed 3/4 of the slots and shrinks when the nodes
+ *    occupy 1/8 of the slots or less. However, the table will never shrink
+ *    beneath INIT_SIZE even if it's emptied.
  * 7. This indicates that the table is dynamically allocated and dynamically
  *    resized on the fly. A table that has this value set to zero is
  *    assumed to be statically allocated and will not be resized.
- * 8. The table of chains must be properly reset to all null pointers.
+ * 8. The slots must be properly reset to empty.
  */
 
 CP_HIDDEN hash_t *hash_create(hashcount_t maxcount, hash_comp_t compfun,
@@ -305,20 +380,24 @@ CP_HIDDEN hash_t *hash_create(hashcount_t maxcount, hash_comp_t compfun,
     hash = malloc(sizeof *hash);	/* 2 */
 
     if (hash) {		/* 3 */
-	hash->table = malloc(sizeof *hash->table * INIT_SIZE);	/* 4 */
+	hash->table = alloc_slots(INIT_SIZE);	/* 4 */
 	if (hash->table) {	/* 5 */
+	    hash->ctrl = (unsigned char *) (hash->table + INIT_SIZE);
 	    hash->nchains = INIT_SIZE;		/* 6 */
-	    hash->highmark = INIT_SIZE * 2;
-	    hash->lowmark = INIT_SIZE / 2;
+	    hash->highmark = INIT_SIZE / 4 * 3;
+	    hash->lowmark = INIT_SIZE / 8;
 	    hash->nodecount = 0;
 	    hash->maxcount = maxcount;
 	    hash->compare = compfun ? compfun : hash_comp_default;
-	    hash->function = hashfun ? hashfun : hash_fun_default;
+	    hash->function = hashfun ? hashfun : hash_fun_string;
 	    hash->allocnode = hnode_alloc;
 	    hash->freenode = hnode_free;
 	    hash->context = NULL;
 	    hash->mask = INIT_MASK;
 	    hash->dynamic = 1;			/* 7 */
+	    hash->oldtable = NULL;
+	    hash->oldsize = 0;
+	    hash->migrated = 0;
 	    clear_table(hash);			/* 8 */
 	    assert (hash_verify(hash));
 	    return hash;
@@ -359,6 +438,7 @@ CP_HIDDEN void hash_free_nodes(hash_t *hash)
 	hash->freenode(node, hash->context);
     }
     hash->nodecount = 0;
+    migrate_slots(hash, hash->oldsize);
     clear_table(hash);
 }
 
@@ -384,16 +464,18 @@ CP_HIDDEN void hash_destroy(hash_t *hash)
 {
     assert (hash_val_t_bit != 0);
     assert (hash_isempty(hash));
+    free(hash->oldtable);
     free(hash->table);
     free(hash);
 }
 
 /*
  * Initialize a user supplied hash structure. The user also supplies a table of
- * chains which is assigned to the hash structure. The table is static---it
- * will not grow or shrink.
+ * slots which is assigned to the hash structure. The table is static---it
+ * will not grow or shrink, and it has no control bytes.
  * 1. See note 1. in hash_create().
- * 2. The user supplied array of pointers hopefully contains nchains nodes.
+ * 2. The user supplied array of pointers hopefully contains nchains slots.
+ *    The table can hold at most nchains - 1 nodes.
  * 3. See note 7. in hash_create().
  * 4. We must dynamically compute the mask from the given power of two table
  *    size. 
@@ -411,12 +493,16 @@ CP_HIDDEN hash_t *hash_init(hash_t *hash, hashcount_t maxcount,
     assert (is_power_of_two(nchains));
 
     hash->table = table;	/* 2 */
+    hash->ctrl = NULL;
     hash->nchains = nchains;
     hash->nodecount = 0;
-    hash->maxcount = maxcount;
+    hash->maxcount = maxcount < nchains ? maxcount : nchains - 1;
     hash->compare = compfun ? compfun : hash_comp_default;
-    hash->function = hashfun ? hashfun : hash_fun_default;
+    hash->function = hashfun ? hashfun : hash_fun_string;
     hash->dynamic = 0;		/* 3 */
+    hash->oldtable = NULL;
+    hash->oldsize = 0;
+    hash->migrated = 0;
     hash->mask = compute_mask(nchains);	/* 4 */
     clear_table(hash);		/* 5 */
 
@@ -425,32 +511,54 @@ CP_HIDDEN hash_t *hash_init(hash_t *hash, hashcount_t maxcount,
     return hash;
 }
 
+/*
+ * Find the first occupied slot at or after the given scan index, or return
+ * the total number of slots if there is none. The slots of the previous
+ * table of a table being resized follow those of the current table.
+ */
+
+static hash_val_t scan_slot(hash_t *hash, hash_val_t chain)
+{
+    hnode_t *nptr;
+
+    for (; chain < hash->nchains; chain++) {
+	if ((nptr = hash->table[chain]) != NULL && nptr != DELETED)
+	    return chain;
+    }
+    for (; chain < hash->nchains + hash->oldsize; chain++) {
+	if ((nptr = hash->oldtable[chain - hash->nchains]) != NULL && nptr != DELETED)
+	    return chain;
+    }
+    return chain;
+}
+
+/*
+ * The node in the slot at the given scan index.
+ */
+
+#define scan_node(hash, chain) ((chain) < (hash)->nchains \
+	? (hash)->table[chain] : (hash)->oldtable[(chain) - (hash)->nchains])
+
 /*
  * Reset the hash scanner so that the next element retrieved by
- * hash_scan_next() shall be the first element on the first non-empty chain. 
+ * hash_scan_next() shall be the node in the first occupied slot.
  * Notes:
- * 1. Locate the first non empty chain.
- * 2. If an empty chain is found, remember which one it is and set the next
- *    pointer to refer to its first element.
- * 3. Otherwise if a chain is not found, set the next pointer to NULL
+ * 1. Locate the first occupied slot.
+ * 2. If an occupied slot is found, remember which one it is and set the next
+ *    pointer to refer to its node.
+ * 3. Otherwise if a slot is not found, set the next pointer to NULL
  *    so that hash_scan_next() shall indicate failure.
  */
 
 CP_HIDDEN void hash_scan_begin(hscan_t *scan, hash_t *hash)
 {
-    hash_val_t nchains = hash->nchains;
-    hash_val_t chain;
+    hash_val_t chain = scan_slot(hash, 0);	/* 1 */
 
     scan->table = hash;
 
-    /* 1 */
-
-    for (chain = 0; chain < nchains && hash->table[chain] == 0; chain++)
-	;
-
-    if (chain < nchains) {	/* 2 */
+    if (chain < hash->nchains + hash->oldsize) {	/* 2 */
 	scan->chain = chain;
-	scan->next = hash->table[chain];
+	scan->next = scan_node(hash, chain);
     } else {			/* 3 */
 	scan->next = NULL;
     }
@@ -470,15 +578,13 @@ CP_HIDDEN void hash_scan_begin(hscan_t *scan, hash_t *hash)
  *    allowed to call hash_scan_next() again. We prepare the new next pointer
  *    for that call right now. That way the user is allowed to delete the node
  *    we are about to return, since we will no longer be needing it to locate
- *    the next node.
- * 4. If there is a next node in the chain (next->next), then that becomes the
- *    new next node, otherwise ...
- * 5. We have exhausted the current chain, and must locate the next subsequent
- *    non-empty chain in the table.
- * 6. If a non-empty chain is found, the first element of that chain becomes
- *    the new next node. Otherwise there is no new next node and we set the
- *    pointer to NULL so that the next time hash_scan_next() is called, a null
- *    pointer shall be immediately returned.
+ *    the next node. Deleting a node during a scan only marks its slot as
+ *    deleted, so no other node changes its slot.
+ * 4. Locate the next occupied slot in the table.
+ * 5. If an occupied slot is found, its node becomes the new next node.
+ *    Otherwise there is no new next node and we set the pointer to NULL so
+ *    that the next time hash_scan_next() is called, a null pointer shall be
+ *    immediately returned.
  */
 
 
@@ -486,23 +592,17 @@ CP_HIDDEN hnode_t *hash_scan_next(hscan_t *scan)
 {
     hnode_t *next = scan->next;		/* 1 */
     hash_t *hash = scan->table;
-    hash_val_t chain = scan->chain + 1;
-    hash_val_t nchains = hash->nchains;
 
     assert (hash_val_t_bit != 0);	/* 2 */
 
     if (next) {			/* 3 */
-	if (next->next) {	/* 4 */
-	    scan->next = next->next;
+	hash_val_t chain = scan_slot(hash, scan->chain + 1);	/* 4 */
+
+	if (chain < hash->nchains + hash->oldsize) {	/* 5 */
+	    scan->chain = chain;
+	    scan->next = scan_node(hash, chain);
 	} else {
-	    while (chain < nchains && hash->table[chain] == 0)	/* 5 */
-	    	chain++;
-	    if (chain < nchains) {	/* 6 */
-		scan->chain = chain;
-		scan->next = hash->table[chain];
-	    } else {
-		scan->next = NULL;
-	    }
+	    scan->next = NULL;
 	}
     }
     return next;
@@ -515,121 +615,217 @@ CP_HIDDEN hnode_t *hash_scan_next(hscan_t *scan)
  *    should verify that the hash table is not full before attempting an
  *    insertion.
  * 2. The same key may not be inserted into a table twice.
- * 3. If the table is dynamic and the load factor is already at >= 2,
- *    grow the table.
- * 4. We take the bottom N bits of the hash value to derive the chain index,
- *    where N is the base 2 logarithm of the size of the hash table. 
+ * 3. If the table is dynamic and the nodes and deleted slots reach the
+ *    high mark, grow the table. If growing fails, the insertion can still
+ *    proceed as long as a free slot remains. The nodes of the previous table
+ *    are counted, since they will all end up in the current table.
+ * 4. If the table is being resized, move a few more slots of the previous
+ *    table.
+ * 5. The node goes to the first empty or deleted slot of its probe sequence.
  */
 
 CP_HIDDEN void hash_insert(hash_t *hash, hnode_t *node, const void *key)
 {
-    hash_val_t hkey, chain;
-
     assert (hash_val_t_bit != 0);
     assert (node->next == NULL);
     assert (hash->nodecount < hash->maxcount);	/* 1 */
     assert (hash_lookup(hash, key) == NULL);	/* 2 */
 
-    if (hash->dynamic && hash->nodecount >= hash->highmark)	/* 3 */
+    if (hash->dynamic && hash->nodecount + hash->deleted >= hash->highmark)	/* 3 */
 	grow_table(hash);
-
-    hkey = hash->function(key);
-    chain = hkey & hash->mask;	/* 4 */
+    if (hash->oldtable)
+	migrate_slots(hash, MIGRATE_SLOTS);	/* 4 */
+    assert (hash->nodecount + 1 < hash->nchains);
 
     node->key = key;
-    node->hkey = hkey;
-    node->next = hash->table[chain];
-    hash->table[chain] = node;
+    node->hkey = hash->function(key);
+    place_node(hash, node);	/* 5 */
     hash->nodecount++;
 
     assert (hash_verify(hash));
 }
 
 /*
- * Find a node in the hash table and return a pointer to it.
+ * Find the slot of the given table holding a node with the given key and
+ * hash value, or return the size of the table if there is no such node.
  * Notes:
- * 1. We hash the key and keep the entire hash value. As an optimization, when
- *    we descend down the chain, we can compare hash values first and only if
- *    hash values match do we perform a full key comparison. 
- * 2. To locate the chain from among 2^N chains, we look at the lower N bits of
- *    the hash value by anding them with the current mask.
- * 3. Looping through the chain, we compare the stored hash value inside each
- *    node against our computed hash. If they match, then we do a full
- *    comparison between the unhashed keys. If these match, we have located the
- *    entry.
+ * 1. As an optimization, when we walk the probe sequence, we compare the
+ *    control tags first, then the stored hash values and only if these match
+ *    do we perform a full key comparison.
+ * 2. The probe sequence starts at the slot given by the lower N bits of the
+ *    mixed hash value and ends at the first empty slot. Deleted slots do not
+ *    end the sequence. The probe sequence is bounded by the table size.
  */
 
-CP_HIDDEN hnode_t *hash_lookup(hash_t *hash, const void *key)
+static hash_val_t probe_table(hash_t *hash, hnode_t **table,
+	unsigned char *ctrl, hashcount_t size, const void *key, hash_val_t hkey)
 {
-    hash_val_t hkey, chain;
+    hash_val_t mixed = mix_hash(hkey);
+    hash_val_t mask = size - 1;
+    hash_val_t slot = mixed & mask;
+    hash_val_t probes;
     hnode_t *nptr;
 
-    hkey = hash->function(key);		/* 1 */
-    chain = hkey & hash->mask;		/* 2 */
+    if (ctrl) {		/* 1 */
+	unsigned char tag = ctrl_tag(mixed);
 
-    for (nptr = hash->table[chain]; nptr; nptr = nptr->next) {	/* 3 */
-	if (nptr->hkey == hkey && hash->compare(nptr->key, key) == 0)
-	    return nptr;
+	for (probes = 0; probes < size; probes++) {	/* 2 */
+	    unsigned char c = ctrl[slot];
+
+	    if (c == CTRL_EMPTY)
+		break;
+	    if (c == tag) {
+		nptr = table[slot];
+		if (nptr->hkey == hkey && hash->compare(nptr->key, key) == 0)
+		    return slot;
+	    }
+	    slot = (slot + 1) & mask;
+	}
+    } else {
+	for (probes = 0; probes < size; probes++) {
+	    if ((nptr = table[slot]) == NULL)
+		break;
+	    if (nptr != DELETED && nptr->hkey == hkey
+		    && hash->compare(nptr->key, key) == 0)
+		return slot;
+	    slot = (slot + 1) & mask;
+	}
     }
 
+    return size;
+}
+
+/*
+ * Find the slot of the current table holding a node with the given key and
+ * hash value, or return nchains if there is no such node.
+ */
+
+#define find_slot(hash, key, hkey) \
+	probe_table((hash), (hash)->table, (hash)->ctrl, (hash)->nchains, (key), (hkey))
+
+/*
+ * Find the slot of the previous table holding a node with the given key and
+ * hash value, or return oldsize if there is no such node.
+ */
+
+#define find_old_slot(hash, key, hkey) \
+	probe_table((hash), (hash)->oldtable, old_ctrl(hash), (hash)->oldsize, (key), (hkey))
+
+/*
+ * Find a node in the hash table and return a pointer to it. The previous
+ * table is consulted if the table is being resized.
+ */
+
+CP_HIDDEN hnode_t *hash_lookup(hash_t *hash, const void *key)
+{
+    hash_val_t hkey = hash->function(key);
+    hash_val_t slot = find_slot(hash, key, hkey);
+
+    if (slot < hash->nchains)
+	return hash->table[slot];
+    if (hash->oldtable && (slot = find_old_slot(hash, key, hkey)) < hash->oldsize)
+	return hash->oldtable[slot];
     return NULL;
 }
 
 /*
- * Delete the given node from the hash table.  Since the chains
- * are singly linked, we must locate the start of the node's chain
- * and traverse.
+ * Remove a node from its slot by marking the slot deleted. Nodes never
+ * change their slots as a result of a deletion.
  * Notes:
  * 1. The node must belong to this hash table, and its key must not have
  *    been tampered with.
- * 2. If this deletion will take the node count below the low mark, we
+ * 2. A node not yet moved from the previous table is removed from there.
+ *    The deleted slots of the previous table are not counted.
+ * 3. If the following slot is empty, no probe sequence runs through this
+ *    slot and it can be made empty instead.
+ * 4. Indicate that the node is no longer in a hash table.
+ */
+
+static void remove_node(hash_t *hash, hnode_t *node)
+{
+    hash_val_t slot = find_slot(hash, node->key, node->hkey);
+
+    if (slot == hash->nchains) {	/* 1 */
+	assert (hash->oldtable);
+	slot = find_old_slot(hash, node->key, node->hkey);
+	assert (slot < hash->oldsize && hash->oldtable[slot] == node);
+	hash->oldtable[slot] = DELETED;	/* 2 */
+	old_ctrl(hash)[slot] = CTRL_DELETED;
+    } else if (hash->table[(slot + 1) & hash->mask] == NULL) {	/* 3 */
+	hash->table[slot] = NULL;
+	if (hash->ctrl)
+	    hash->ctrl[slot] = CTRL_EMPTY;
+    } else {
+	hash->table[slot] = DELETED;
+	if (hash->ctrl)
+	    hash->ctrl[slot] = CTRL_DELETED;
+	hash->deleted++;
+    }
+    hash->nodecount--;
+    node->next = NULL;	/* 4 */
+}
+
+/*
+ * Delete the given node from the hash table.
+ * Notes:
+ * 1. The node must belong to this hash table, and its key must not have
+ *    been tampered with.
+ * 2. If this deletion takes the node count below the low mark, we
  *    shrink the table now. 
- * 3. Determine which chain the node belongs to, and fetch the pointer
- *    to the first node in this chain.
- * 4. If the node being deleted is the first node in the chain, then
- *    simply update the chain head pointer.
- * 5. Otherwise advance to the node's predecessor, and splice out
- *    by updating the predecessor's next pointer.
- * 6. Indicate that the node is no longer in a hash table.
  */
 
 CP_HIDDEN hnode_t *hash_delete(hash_t *hash, hnode_t *node)
 {
-    hash_val_t chain;
-    hnode_t *hptr;
-
     assert (hash_lookup(hash, node->key) == node);	/* 1 */
     assert (hash_val_t_bit != 0);
 
+    remove_node(hash, node);
     if (hash->dynamic && hash->nodecount <= hash->lowmark
-	    && hash->nodecount > INIT_SIZE)
+	    && hash->nchains > INIT_SIZE)
 	shrink_table(hash);				/* 2 */
 
-    chain = node->hkey & hash->mask;			/* 3 */
-    hptr = hash->table[chain];
-
-    if (hptr == node) {					/* 4 */
-	hash->table[chain] = node->next;
-    } else {
-	while (hptr->next != node) {			/* 5 */
-	    assert (hptr != 0);
-	    hptr = hptr->next;
-	}
-	assert (hptr->next == node);
-	hptr->next = node->next;
-    }
-	
-    hash->nodecount--;
     assert (hash_verify(hash));
-
-    node->next = NULL;					/* 6 */
     return node;
 }
 
+/*
+ * Make room for a number of additional nodes so that inserting them does
+ * not grow the table again.
+ * Notes:
+ * 1. Static tables and tables which already have room are left as is.
+ * 2. Compute the smallest power of two size keeping the nodes and the
+ *    additional nodes below the high mark. The deleted slots are dropped
+ *    by the rebuild.
+ * 3. Zero is returned if the size would overflow or the new slots could
+ *    not be allocated, in which case the table still grows on demand.
+ */
+
+CP_HIDDEN int hash_reserve(hash_t *hash, hashcount_t count)
+{
+    hashcount_t needed = hash->nodecount + count;
+    hashcount_t size = hash->nchains;
+
+    if (!hash->dynamic || needed + hash->deleted < hash->highmark)	/* 1 */
+	return 1;
+    if (needed < hash->nodecount)
+	return 0;
+    while (size / 4 * 3 <= needed) {	/* 2 */
+	if (2 * size <= size)
+	    return 0;			/* 3 */
+	size *= 2;
+    }
+    return rehash_table(hash, size);
+}
+
 CP_HIDDEN int hash_alloc_insert(hash_t *hash, const void *key, void *data)
 {
-    hnode_t *node = hash->allocnode(hash->context);
+    hnode_t *node;
 
+    if (hash->dynamic && hash->nodecount + hash->deleted >= hash->highmark)
+	grow_table(hash);
+    if (hash->nodecount + 1 >= hash->nchains)
+	return 0;
+    node = hash->allocnode(hash->context);
     if (node) {
 	hnode_init(node, data);
 	hash_insert(hash, node, key);
@@ -651,27 +847,12 @@ CP_HIDDEN void hash_delete_free(hash_t *hash, hnode_t *node)
 
 CP_HIDDEN hnode_t *hash_scan_delete(hash_t *hash, hnode_t *node)
 {
-    hash_val_t chain;
-    hnode_t *hptr;
-
     assert (hash_lookup(hash, node->key) == node);
     assert (hash_val_t_bit != 0);
 
-    chain = node->hkey & hash->mask;
-    hptr = hash->table[chain];
+    remove_node(hash, node);
 
-    if (hptr == node) {
-	hash->table[chain] = node->next;
-    } else {
-	while (hptr->next != node) 
-	    hptr = hptr->next;
-	hptr->next = node->next;
-    }
-	
-    hash->nodecount--;
     assert (hash_verify(hash));
-    node->next = NULL;
-
     return node;
 }
 
@@ -689,35 +870,59 @@ CP_HIDDEN void hash_scan_delfree(hash_t *hash, hnode_t *node)
  * Verify whether the given object is a valid hash table. This means
  * Notes:
  * 1. If the hash table is dynamic, verify whether the high and
- *    low expansion/shrinkage thresholds are powers of two.
- * 2. Count all nodes in the table, and test each hash value
- *    to see whether it is correct for the node's chain.
+ *    low expansion/shrinkage thresholds are sane.
+ * 2. Count all nodes and deleted slots in the table, and test the control
+ *    byte of each slot.
+ * 3. Every node must be found by a lookup of its key, which means that no
+ *    empty slot lies between the start of its probe sequence and its slot.
+ * 4. The nodes of the previous table of a table being resized must not be
+ *    found in the current table, and the slots already moved must be free.
  */
 
 CP_HIDDEN int hash_verify(hash_t *hash)
 {
-    hashcount_t count = 0;
-    hash_val_t chain;
+    hashcount_t count = 0, deleted = 0;
+    hash_val_t slot;
     hnode_t *hptr;
 
     if (hash->dynamic) {	/* 1 */
 	if (hash->lowmark >= hash->highmark)
 	    return 0;
-	if (!is_power_of_two(hash->highmark))
-	    return 0;
-	if (!is_power_of_two(hash->lowmark))
+	if (hash->highmark >= hash->nchains)
 	    return 0;
     }
 
-    for (chain = 0; chain < hash->nchains; chain++) {	/* 2 */
-	for (hptr = hash->table[chain]; hptr != 0; hptr = hptr->next) {
-	    if ((hptr->hkey & hash->mask) != chain)
+    for (slot = 0; slot < hash->nchains; slot++) {	/* 2 */
+	hptr = hash->table[slot];
+	if (hptr == NULL) {
+	    if (hash->ctrl && hash->ctrl[slot] != CTRL_EMPTY)
+		return 0;
+	} else if (hptr == DELETED) {
+	    if (hash->ctrl && hash->ctrl[slot] != CTRL_DELETED)
+		return 0;
+	    deleted++;
+	} else {
+	    if (hash->ctrl && hash->ctrl[slot] != ctrl_tag(mix_hash(hptr->hkey)))
+		return 0;
+	    if (find_slot(hash, hptr->key, hptr->hkey) != slot)	/* 3 */
 		return 0;
 	    count++;
 	}
     }
 
-    if (count != hash->nodecount)
+    for (slot = 0; slot < hash->oldsize; slot++) {	/* 4 */
+	hptr = hash->oldtable[slot];
+	if (hptr == NULL || hptr == DELETED)
+	    continue;
+	if (slot < hash->migrated)
+	    return 0;
+	if (find_old_slot(hash, hptr->key, hptr->hkey) != slot
+		|| find_slot(hash, hptr->key, hptr->hkey) != hash->nchains)
+	    return 0;
+	count++;
+    }
+
+    if (count != hash->nodecount || deleted != hash->deleted)
 	return 0;
 
     return 1;
@@ -820,26 +1025,53 @@ CP_HIDDEN hashcount_t hash_size(hash_t *hash)
     return hash->nchains;
 }
 
-static hash_val_t hash_fun_default(const void *key)
-{
-    static unsigned long randbox[] = {
-	0x49848f1bU, 0xe6255dbaU, 0x36da5bdcU, 0x47bf94e9U,
-	0x8cbcce22U, 0x559fc06aU, 0xd268f536U, 0xe10af79aU,
-	0xc1af4d69U, 0x1d2917b5U, 0xec4c304dU, 0x9ee5016cU,
-	0x69232f74U, 0xfead7bb3U, 0xe9089ab6U, 0xf012f6aeU,
-    };
+/*
+ * The default hash function for null terminated strings. The string is
+ * consumed four bytes at a time, using the block and finalization steps of
+ * the 32-bit MurmurHash3 algorithm. The bytes of a block are combined in
+ * little endian order regardless of the platform so that the hash values,
+ * and thus the scan order of a table, do not depend on the byte order.
+ */
 
+#define rotl32(x, r) ((((x) << (r)) | ((x) >> (32 - (r)))) & 0xffffffffUL)
+
+CP_HIDDEN hash_val_t hash_fun_string(const void *key)
+{
     const unsigned char *str = key;
-    hash_val_t acc = 0;
-
-    while (*str) {
-	acc ^= randbox[(*str + acc) & 0xf];
-	acc = (acc << 1) | (acc >> 31);
-	acc &= 0xffffffffU;
-	acc ^= randbox[((*str++ >> 4) + acc) & 0xf];
-	acc = (acc << 2) | (acc >> 30);
-	acc &= 0xffffffffU;
+    size_t len = strlen(key);
+    unsigned long acc = 0x9747b28cUL ^ (len & 0xffffffffUL);
+    unsigned long k;
+
+    for (; len >= 4; len -= 4, str += 4) {
+	k = (unsigned long) str[0] | (unsigned long) str[1] << 8
+	    | (unsigned long) str[2] << 16 | (unsigned long) str[3] << 24;
+	k = (k * 0xcc9e2d51UL) & 0xffffffffUL;
+	k = rotl32(k, 15);
+	acc ^= (k * 0x1b873593UL) & 0xffffffffUL;
+	acc = rotl32(acc, 13);
+	acc = (acc * 5 + 0xe6546b64UL) & 0xffffffffUL;
     }
+
+    k = 0;
+    switch (len) {
+	case 3:
+	    k ^= (unsigned long) str[2] << 16;
+	    /* fall through */
+	case 2:
+	    k ^= (unsigned long) str[1] << 8;
+	    /* fall through */
+	case 1:
+	    k ^= str[0];
+	    k = (k * 0xcc9e2d51UL) & 0xffffffffUL;
+	    k = rotl32(k, 15);
+	    acc ^= (k * 0x1b873593UL) & 0xffffffffUL;
+    }
+
+    acc ^= acc >> 16;
+    acc = (acc * 0x85ebca6bUL) & 0xffffffffUL;
+    acc ^= acc >> 13;
+    acc = (acc * 0xc2b2ae35UL) & 0xffffffffUL;
+    acc ^= acc >> 16;
     return acc;
 }
 
@@ -22,6 +22,9 @@
  * Modified by Johannes Lehtinen in 2006-2007.
  * Included the definition of CP_HIDDEN macro and used it in declarations and
  * definitions to hide Kazlib symbols when building a shared C-Pluff library.
+ *
+ * Later modified to resize tables incrementally and to export the default
+ * string hash function as hash_fun_string.
  */
 
 #ifndef HASH_H
@@ -55,7 +58,7 @@ CP_HIDDEN extern int hash_val_t_bit;
 #endif
 
 /*
- * Hash chain node structure.
+ * Hash node structure.
  * Notes:
  * 1. This preprocessing directive is for debugging purposes.  The effect is
  *    that if the preprocessor symbol KAZLIB_OPAQUE_DEBUG is defined prior to the
@@ -64,8 +67,8 @@ CP_HIDDEN extern int hash_val_t_bit;
  *    client code to violate the principles of information hiding (by accessing
  *    the structure directly) can be diagnosed at translation time. However,
  *    note the resulting compiled unit is not suitable for linking.
- * 2. This is a pointer to the next node in the chain. In the last node of a
- *    chain, this pointer is null.
+ * 2. This pointer is not used for linking nodes, since the table uses open
+ *    addressing. It is null while the node is in a table.
  * 3. The key is a pointer to some user supplied data that contains a unique
  *    identifier for each hash node in a given table. The interpretation of
  *    the data is up to the user. When creating or initializing a hash table,
@@ -123,19 +126,23 @@ typedef void (*hnode_free_t)(hnode_t *, void *);
  * This is the hash table control structure. It keeps track of information
  * about a hash table, as well as the hash table itself.
  * Notes:
- * 1.  Pointer to the hash table proper. The table is an array of pointers to
- *     hash nodes (of type hnode_t). If the table is empty, every element of
- *     this table is a null pointer. A non-null entry points to the first
- *     element of a chain of nodes.
+ * 1.  Pointer to the hash table proper. The table is an array of slots
+ *     holding pointers to hash nodes (of type hnode_t). An empty slot is a
+ *     null pointer and the slot of a deleted node holds a private marker. A
+ *     node is stored in the first free slot starting from the slot selected by
+ *     its hash value (linear probing). A dynamic table is followed by an array
+ *     of control bytes, one per slot, pointed to by hash_ctrl, which tells
+ *     lookups whether a slot is empty, deleted or holds a node with a matching
+ *     hash tag. Statically allocated tables have no control bytes.
  * 2.  This member keeps track of the size of the hash table---that is, the
- *     number of chain pointers.
+ *     number of slots. The number of deleted slots is kept in hash_deleted.
  * 3.  The count member maintains the number of elements that are presently
  *     in the hash table.
  * 4.  The maximum count is the greatest number of nodes that can populate this
  *     table. If the table contains this many nodes, no more can be inserted,
  *     and the hash_isfull() function returns true.
- * 5.  The high mark is a population threshold, measured as a number of nodes,
- *     which, if exceeded, will trigger a table expansion. Only dynamic hash
+ * 5.  The high mark is a population threshold, measured as a number of nodes
+ *     and deleted slots, which, if exceeded, will trigger a table expansion. Only dynamic hash
  *     tables are subject to this expansion.
  * 6.  The low mark is a minimum population threshold, measured as a number of
  *     nodes. If the table population drops below this value, a table shrinkage
@@ -152,13 +159,22 @@ typedef void (*hnode_free_t)(hnode_t *, void *);
  * 10. A flag which indicates whether the table is to be dynamically resized. It
  *     is set to 1 in dynamically allocated tables, 0 in tables that are
  *     statically allocated.
+ * 11. The previous table of a dynamic table being resized, or a null pointer.
+ *     A resize does not move all nodes at once. Instead, each insertion
+ *     moves the nodes of a few slots of the previous table to the current
+ *     one, and lookups consult both tables until the previous one has been
+ *     emptied and freed. The size of the previous table is kept in
+ *     hash_oldsize and the index of the next slot to be moved in
+ *     hash_migrated. The previous table has control bytes like the current.
  */
 
 typedef struct hash_t {
     #if defined(HASH_IMPLEMENTATION) || !defined(KAZLIB_OPAQUE_DEBUG)
     struct hnode_t **hash_table;		/* 1 */
+    unsigned char *hash_ctrl;
     hashcount_t hash_nchains;			/* 2 */
     hashcount_t hash_nodecount;			/* 3 */
+    hashcount_t hash_deleted;
     hashcount_t hash_maxcount;			/* 4 */
     hashcount_t hash_highmark;			/* 5 */
     hashcount_t hash_lowmark;			/* 6 */
@@ -169,6 +185,9 @@ typedef struct hash_t {
     void *hash_context;
     hash_val_t hash_mask;			/* 9 */
     int hash_dynamic;				/* 10 */
+    struct hnode_t **hash_oldtable;		/* 11 */
+    hashcount_t hash_oldsize;
+    hashcount_t hash_migrated;
     #else
     int hash_dummy;
     #endif
@@ -178,8 +197,9 @@ typedef struct hash_t {
  * Hash scanner structure, used for traversals of the data structure.
  * Notes:
  * 1. Pointer to the hash table that is being traversed.
- * 2. Reference to the current chain in the table being traversed (the chain
- *    that contains the next node that shall be retrieved).
+ * 2. Index of the slot in the table being traversed that contains the next
+ *    node that shall be retrieved. The slots of the previous table of a
+ *    table being resized follow those of the current table.
  * 3. Pointer to the node that will be retrieved by the subsequent call to
  *    hash_scan_next().
  */
@@ -198,6 +218,7 @@ CP_HIDDEN extern hash_t *hash_create(hashcount_t, hash_comp_t, hash_fun_t);
 CP_HIDDEN extern void hash_set_allocator(hash_t *, hnode_alloc_t, hnode_free_t, void *);
 CP_HIDDEN extern void hash_destroy(hash_t *);
 CP_HIDDEN extern void hash_free_nodes(hash_t *);
+CP_HIDDEN extern int hash_reserve(hash_t *, hashcount_t);
 CP_HIDDEN extern void hash_free(hash_t *);
 CP_HIDDEN extern hash_t *hash_init(hash_t *, hashcount_t, hash_comp_t,
 	hash_fun_t, hnode_t **, hashcount_t);
@@ -222,6 +243,7 @@ CP_HIDDEN extern hnode_t *hash_scan_delete(hash_t *, hnode_t *);
 CP_HIDDEN extern void hash_scan_delfree(hash_t *, hnode_t *);
 
 CP_HIDDEN extern int hash_verify(hash_t *);
+CP_HIDDEN extern hash_val_t hash_fun_string(const void *);
 
 CP_HIDDEN extern hnode_t *hnode_create(void *);
 CP_HIDDEN extern hnode_t *hnode_init(hnode_t *, void *);
@@ -0,0 +1,840 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file
+ * Archive plug-in loader
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include "../kazlib/hash.h"
+#include "cpluff.h"
+#include "defines.h"
+#include "util.h"
+#include "internal.h"
+
+
+/* ------------------------------------------------------------------------
+ * Constants
+ * ----------------------------------------------------------------------*/
+
+/// The signature of the end of central directory record
+#define ZIP_END_SIG 0x06054b50UL
+
+/// The signature of a central directory file header
+#define ZIP_CENTRAL_SIG 0x02014b50UL
+
+/// The signature of a local file header
+#define ZIP_LOCAL_SIG 0x04034b50UL
+
+/// The size of the end of central directory record without the comment
+#define ZIP_END_SIZE 22
+
+/// The size of a central directory file header without variable fields
+#define ZIP_CENTRAL_SIZE 46
+
+/// The size of a local file header without variable fields
+#define ZIP_LOCAL_SIZE 30
+
+/// The maximum length of the archive comment
+#define ZIP_MAX_COMMENT 65535
+
+/// The compression method of stored members
+#define ZIP_STORED 0
+
+/// The compression method of deflated members
+#define ZIP_DEFLATED 8
+
+/// The general purpose flag of encrypted members
+#define ZIP_ENCRYPTED 0x0001
+
+
+/* ------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------*/
+
+#ifdef _WIN32
+#define make_dir(path) _mkdir(path)
+#else
+#define make_dir(path) mkdir((path), 0777)
+#endif
+
+#ifdef CP_THREADS
+#define lock_apl(apl) cpi_lock_mutex((apl)->mutex)
+#define unlock_apl(apl) cpi_unlock_mutex((apl)->mutex)
+#else
+#define lock_apl(apl) do {} while (0)
+#define unlock_apl(apl) do {} while (0)
+#endif
+
+
+/* ------------------------------------------------------------------------
+ * Data types
+ * ----------------------------------------------------------------------*/
+
+/// A member of a plug-in archive
+typedef struct apl_member_t {
+
+	/// The name of the member, using '/' as the separator
+	const char *name;
+
+	/// The offset of the local file header
+	unsigned long offset;
+
+	/// The compressed size
+	unsigned long comp_size;
+
+	/// The uncompressed size
+	unsigned long size;
+
+	/// The CRC-32 of the uncompressed data
+	unsigned long crc;
+
+	/// The compression method
+	int method;
+} apl_member_t;
+
+/// Archive plug-in loader data
+typedef struct apl_data_t {
+
+	/// The archive file
+	char *archive;
+
+	/// The directory into which plug-in files are extracted
+	char *extract_dir;
+
+	/// The members of the archive sorted by name
+	apl_member_t *members;
+
+	/// The number of members
+	int num_members;
+
+	/// The names of the members
+	char *names;
+
+	/// The names of the plug-in directories which have been extracted
+	hash_t *extracted;
+
+#ifdef CP_THREADS
+
+	/// Mutex protecting the extracted plug-in directories
+	cpi_mutex_t *mutex;
+
+#endif
+
+	/// The CRC-32 lookup table
+	unsigned long crc_table[256];
+} apl_data_t;
+
+
+/* ------------------------------------------------------------------------
+ * Function definitions
+ * ----------------------------------------------------------------------*/
+
+/**
+ * Returns a little-endian 16-bit value.
+ *
+ * @param p the value
+ * @return the value
+ */
+static unsigned int get_u16(const unsigned char *p) {
+	return p[0] | ((unsigned int) p[1] << 8);
+}
+
+/**
+ * Returns a little-endian 32-bit value.
+ *
+ * @param p the value
+ * @return the value
+ */
+static unsigned long get_u32(const unsigned char *p) {
+	return p[0] | ((unsigned long) p[1] << 8) | ((unsigned long) p[2] << 16) | ((unsigned long) p[3] << 24);
+}
+
+/**
+ * Initializes the CRC-32 lookup table.
+ *
+ * @param table the table
+ */
+static void init_crc_table(unsigned long *table) {
+	unsigned long c;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (j = 0; j < 8; j++) {
+			c = (c & 1 ? 0xedb88320UL ^ (c >> 1) : c >> 1);
+		}
+		table[i] = c;
+	}
+}
+
+/**
+ * Calculates the CRC-32 of the specified data.
+ *
+ * @param table the CRC-32 lookup table
+ * @param data the data
+ * @param len the length of the data
+ * @return the CRC-32
+ */
+static unsigned long calc_crc(const unsigned long *table, const unsigned char *data, unsigned long len) {
+	unsigned long c = 0xffffffffUL;
+	unsigned long i;
+
+	for (i = 0; i < len; i++) {
+		c = table[(c ^ data[i]) & 0xff] ^ (c >> 8);
+	}
+	return c ^ 0xffffffffUL;
+}
+
+/**
+ * Returns whether the specified member name is safe to extract, that is it
+ * is relative and it does not refer to parent directories.
+ *
+ * @param name the member name
+ * @return whether the name is safe
+ */
+static int is_safe_name(const char *name) {
+	const char *c = name;
+
+	if (*name == '/' || strchr(name, '\\') != NULL || strchr(name, ':') != NULL) {
+		return 0;
+	}
+	while (c != NULL) {
+		if (c[0] == '.' && c[1] == '.' && (c[2] == '/' || c[2] == '\0')) {
+			return 0;
+		}
+		if ((c = strchr(c, '/')) != NULL) {
+			c++;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Compares two archive members by name.
+ *
+ * @param m1 the first member
+ * @param m2 the second member
+ * @return less than, equal to or greater than zero
+ */
+static int comp_member(const void *m1, const void *m2) {
+	return strcmp(((const apl_member_t *) m1)->name, ((const apl_member_t *) m2)->name);
+}
+
+/**
+ * Reads the central directory of the archive into the member index.
+ *
+ * @param apl the archive loader data
+ * @return CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t read_index(apl_data_t *apl) {
+	FILE *fh = NULL;
+	unsigned char *tail = NULL;
+	unsigned char *cd = NULL;
+	cp_status_t status = CP_OK;
+
+	do {
+		long size, tail_len, pos;
+		unsigned long cd_size, cd_offset, p;
+		unsigned int num;
+		char *name;
+
+		// Find the end of central directory record
+		if ((fh = fopen(apl->archive, "rb")) == NULL
+			|| fseek(fh, 0, SEEK_END)
+			|| (size = ftell(fh)) < 0) {
+			status = CP_ERR_IO;
+			break;
+		}
+		tail_len = (size < ZIP_END_SIZE + ZIP_MAX_COMMENT ? size : ZIP_END_SIZE + ZIP_MAX_COMMENT);
+		if (tail_len < ZIP_END_SIZE) {
+			status = CP_ERR_MALFORMED;
+			break;
+		}
+		if ((tail = malloc(tail_len)) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		if (fseek(fh, size - tail_len, SEEK_SET)
+			|| fread(tail, 1, tail_len, fh) != (size_t) tail_len) {
+			status = CP_ERR_IO;
+			break;
+		}
+		for (pos = tail_len - ZIP_END_SIZE; pos >= 0 && get_u32(tail + pos) != ZIP_END_SIG; pos--);
+		if (pos < 0) {
+			status = CP_ERR_MALFORMED;
+			break;
+		}
+		num = get_u16(tail + pos + 10);
+		cd_size = get_u32(tail + pos + 12);
+		cd_offset = get_u32(tail + pos + 16);
+		if (cd_offset + cd_size < cd_offset
+			|| cd_offset + cd_size > (unsigned long) (size - tail_len + pos)) {
+			status = CP_ERR_MALFORMED;
+			break;
+		}
+
+		// Read the central directory
+		if ((cd = malloc(cd_size + 1)) == NULL
+			|| (apl->members = malloc((num + 1) * sizeof(apl_member_t))) == NULL
+			|| (apl->names = malloc(cd_size + 1)) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		if (fseek(fh, cd_offset, SEEK_SET)
+			|| fread(cd, 1, cd_size, fh) != cd_size) {
+			status = CP_ERR_IO;
+			break;
+		}
+
+		// Index the members
+		name = apl->names;
+		for (p = 0; apl->num_members < (int) num && status == CP_OK; ) {
+			apl_member_t *m = apl->members + apl->num_members;
+			unsigned int name_len, extra_len, comment_len;
+
+			if (cd_size - p < ZIP_CENTRAL_SIZE || get_u32(cd + p) != ZIP_CENTRAL_SIG) {
+				status = CP_ERR_MALFORMED;
+				break;
+			}
+			name_len = get_u16(cd + p + 28);
+			extra_len = get_u16(cd + p + 30);
+			comment_len = get_u16(cd + p + 32);
+			if (cd_size - p - ZIP_CENTRAL_SIZE < (unsigned long) name_len + extra_len + comment_len) {
+				status = CP_ERR_MALFORMED;
+				break;
+			}
+			m->method = get_u16(cd + p + 10);
+			m->crc = get_u32(cd + p + 16);
+			m->comp_size = get_u32(cd + p + 20);
+			m->size = get_u32(cd + p + 24);
+			m->offset = get_u32(cd + p + 42);
+			memcpy(name, cd + p + ZIP_CENTRAL_SIZE, name_len);
+			name[name_len] = '\0';
+			m->name = name;
+			if (strlen(name) != name_len || !is_safe_name(name)) {
+				status = CP_ERR_MALFORMED;
+				break;
+			}
+
+			// Skip encrypted members and directories
+			if (!(get_u16(cd + p + 8) & ZIP_ENCRYPTED)
+				&& name_len > 0 && name[name_len - 1] != '/') {
+				apl->num_members++;
+				name += name_len + 1;
+			} else {
+				num--;
+			}
+			p += ZIP_CENTRAL_SIZE + name_len + extra_len + comment_len;
+		}
+		if (status != CP_OK) {
+			break;
+		}
+		qsort(apl->members, apl->num_members, sizeof(apl_member_t), comp_member);
+
+	} while (0);
+
+	// Release resources
+	if (fh != NULL) {
+		fclose(fh);
+	}
+	free(tail);
+	free(cd);
+
+	return status;
+}
+
+/**
+ * Reads and uncompresses the data of an archive member.
+ *
+ * @param apl the archive loader data
+ * @param fh the archive file
+ * @param m the member
+ * @param dataptr filled with the data, to be freed by the caller
+ * @return CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t read_member(apl_data_t *apl, FILE *fh, const apl_member_t *m, unsigned char **dataptr) {
+	unsigned char header[ZIP_LOCAL_SIZE];
+	unsigned char *comp = NULL;
+	unsigned char *data = NULL;
+	cp_status_t status = CP_OK;
+
+	do {
+
+		// Locate the member data
+		if (fseek(fh, m->offset, SEEK_SET)
+			|| fread(header, 1, ZIP_LOCAL_SIZE, fh) != ZIP_LOCAL_SIZE) {
+			status = CP_ERR_IO;
+			break;
+		}
+		if (get_u32(header) != ZIP_LOCAL_SIG) {
+			status = CP_ERR_MALFORMED;
+			break;
+		}
+		if (fseek(fh, get_u16(header + 26) + get_u16(header + 28), SEEK_CUR)) {
+			status = CP_ERR_IO;
+			break;
+		}
+
+		// Read the data
+		if ((comp = malloc(m->comp_size + 1)) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		if (fread(comp, 1, m->comp_size, fh) != m->comp_size) {
+			status = CP_ERR_IO;
+			break;
+		}
+		if (m->method == ZIP_STORED) {
+			if (m->size != m->comp_size) {
+				status = CP_ERR_MALFORMED;
+				break;
+			}
+			data = comp;
+			comp = NULL;
+		}
+#ifdef HAVE_ZLIB
+		else if (m->method == ZIP_DEFLATED) {
+			z_stream zs;
+			int zs_status;
+
+			if ((data = malloc(m->size + 1)) == NULL) {
+				status = CP_ERR_RESOURCE;
+				break;
+			}
+			memset(&zs, 0, sizeof(zs));
+			if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+				status = CP_ERR_RESOURCE;
+				break;
+			}
+			zs.next_in = comp;
+			zs.avail_in = m->comp_size;
+			zs.next_out = data;
+			zs.avail_out = m->size;
+			zs_status = inflate(&zs, Z_FINISH);
+			inflateEnd(&zs);
+			if (zs_status != Z_STREAM_END || zs.total_out != m->size) {
+				status = CP_ERR_MALFORMED;
+				break;
+			}
+		}
+#endif
+		else {
+			status = CP_ERR_MALFORMED;
+			break;
+		}
+
+		// Verify the data
+		if (calc_crc(apl->crc_table, data, m->size) != m->crc) {
+			status = CP_ERR_MALFORMED;
+			break;
+		}
+
+	} while (0);
+
+	// Release resources
+	free(comp);
+	if (status != CP_OK) {
+		free(data);
+		data = NULL;
+	}
+	*dataptr = data;
+
+	return status;
+}
+
+/**
+ * Constructs the path at which the specified archive member is extracted.
+ *
+ * @param apl the archive loader data
+ * @param name the member name or a prefix of it
+ * @param name_len the length of the name
+ * @return the path, to be freed by the caller, or NULL if insufficient memory
+ */
+static char *extract_path(apl_data_t *apl, const char *name, size_t name_len) {
+	size_t dir_len = strlen(apl->extract_dir);
+	char *path;
+	size_t i;
+
+	if (dir_len > 0 && apl->extract_dir[dir_len - 1] == CP_FNAMESEP_CHAR) {
+		dir_len--;
+	}
+	if ((path = malloc((dir_len + 1 + name_len + 1) * sizeof(char))) == NULL) {
+		return NULL;
+	}
+	strncpy(path, apl->extract_dir, dir_len);
+	path[dir_len] = CP_FNAMESEP_CHAR;
+	for (i = 0; i < name_len; i++) {
+		path[dir_len + 1 + i] = (name[i] == '/' ? CP_FNAMESEP_CHAR : name[i]);
+	}
+	path[dir_len + 1 + name_len] = '\0';
+	return path;
+}
+
+/**
+ * Extracts an archive member. The parent directories are created as
+ * necessary and the data is written to a temporary file which then
+ * replaces the extracted file.
+ *
+ * @param apl the archive loader data
+ * @param fh the archive file
+ * @param m the member
+ * @return CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t extract_member(apl_data_t *apl, FILE *fh, const apl_member_t *m) {
+	unsigned char *data = NULL;
+	char *path = NULL;
+	char *tmp_path = NULL;
+	FILE *out = NULL;
+	cp_status_t status;
+
+	do {
+		size_t i;
+
+		if ((status = read_member(apl, fh, m, &data)) != CP_OK) {
+			break;
+		}
+		if ((path = extract_path(apl, m->name, strlen(m->name))) == NULL
+			|| (tmp_path = malloc((strlen(path) + 5) * sizeof(char))) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+
+		// Create the parent directories
+		for (i = strlen(path) - strlen(m->name) - 1; path[i] != '\0'; i++) {
+			if (path[i] == CP_FNAMESEP_CHAR && i > 0) {
+				path[i] = '\0';
+				make_dir(path);
+				path[i] = CP_FNAMESEP_CHAR;
+			}
+		}
+
+		// Write to a temporary file and then replace the extracted file
+		strcpy(tmp_path, path);
+		strcat(tmp_path, ".tmp");
+		if ((out = fopen(tmp_path, "wb")) == NULL
+			|| fwrite(data, 1, m->size, out) != m->size) {
+			status = CP_ERR_IO;
+			break;
+		}
+		if (fclose(out)) {
+			out = NULL;
+			status = CP_ERR_IO;
+			break;
+		}
+		out = NULL;
+		remove(path);
+		if (rename(tmp_path, path)) {
+			status = CP_ERR_IO;
+			break;
+		}
+
+	} while (0);
+
+	// Release resources
+	if (out != NULL) {
+		fclose(out);
+	}
+	if (status != CP_OK && tmp_path != NULL) {
+		remove(tmp_path);
+	}
+	free(tmp_path);
+	free(path);
+	free(data);
+
+	return status;
+}
+
+/**
+ * Returns the index of the first member whose name is not less than the
+ * specified name.
+ *
+ * @param apl the archive loader data
+ * @param name the name
+ * @return the index of the member or the number of members if none
+ */
+static int member_lower_bound(apl_data_t *apl, const char *name) {
+	int lo = 0, hi = apl->num_members;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (strcmp(apl->members[mid].name, name) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static cp_plugin_info_t **apl_scan_plugins(void *data, cp_context_t *ctx) {
+	apl_data_t *apl = data;
+	cp_plugin_info_t **plugins;
+	const char *dname;
+	FILE *fh;
+	int num_plugins = 0;
+	int i;
+
+	CHECK_NOT_NULL(data);
+	CHECK_NOT_NULL(ctx);
+
+	if ((plugins = malloc((apl->num_members + 1) * sizeof(cp_plugin_info_t *))) == NULL) {
+		return NULL;
+	}
+	if ((fh = fopen(apl->archive, "rb")) == NULL) {
+		cpi_lock_context(ctx);
+		cpi_errorf(ctx, N_("Could not open plug-in archive %s: %s"), apl->archive, strerror(errno));
+		cpi_unlock_context(ctx);
+		plugins[0] = NULL;
+		return plugins;
+	}
+
+	// Load the descriptors in the top level directories
+	dname = ctx->env->plugin_descriptor_name;
+	for (i = 0; i < apl->num_members; i++) {
+		const apl_member_t *m = apl->members + i;
+		const char *sep = strchr(m->name, '/');
+		unsigned char *buffer = NULL;
+		char *path;
+		cp_plugin_info_t *plugin;
+		cp_status_t status;
+
+		if (sep == NULL || strcmp(sep + 1, dname)) {
+			continue;
+		}
+		if ((path = extract_path(apl, m->name, sep - m->name)) == NULL) {
+			status = CP_ERR_RESOURCE;
+		} else {
+			status = read_member(apl, fh, m, &buffer);
+		}
+		cpi_lock_context(ctx);
+		if (status != CP_OK) {
+			cpi_errorf(ctx, N_("Could not read %s from plug-in archive %s."), m->name, apl->archive);
+		} else if ((plugin = cpi_parse_plugin_descriptor_buffer(ctx, path, (const char *) buffer, m->size, NULL, &status)) != NULL) {
+			cpi_register_plugin_descriptor(ctx, plugin);
+			plugins[num_plugins++] = plugin;
+		}
+		cpi_unlock_context(ctx);
+		free(buffer);
+		free(path);
+	}
+	plugins[num_plugins] = NULL;
+	fclose(fh);
+
+	return plugins;
+}
+
+static int apl_resolve_files(void *data, cp_context_t *ctx, cp_plugin_info_t *plugin) {
+	apl_data_t *apl = data;
+	size_t dir_len = strlen(apl->extract_dir);
+	const char *pdir;
+	char *prefix = NULL;
+	char *key = NULL;
+	FILE *fh = NULL;
+	cp_status_t status = CP_OK;
+
+	CHECK_NOT_NULL(data);
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(plugin);
+
+	// Find the plug-in directory in the archive
+	if (dir_len > 0 && apl->extract_dir[dir_len - 1] == CP_FNAMESEP_CHAR) {
+		dir_len--;
+	}
+	if (strncmp(plugin->plugin_path, apl->extract_dir, dir_len)
+		|| plugin->plugin_path[dir_len] != CP_FNAMESEP_CHAR) {
+		return 0;
+	}
+	pdir = plugin->plugin_path + dir_len + 1;
+
+	lock_apl(apl);
+	do {
+		size_t pdir_len = strlen(pdir);
+		int i;
+
+		// Check if the files have already been extracted
+		if (hash_lookup(apl->extracted, pdir) != NULL) {
+			break;
+		}
+
+		// Extract the members in the plug-in directory
+		if ((prefix = malloc((pdir_len + 2) * sizeof(char))) == NULL
+			|| (key = malloc((pdir_len + 1) * sizeof(char))) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		strcpy(prefix, pdir);
+		prefix[pdir_len] = '/';
+		prefix[pdir_len + 1] = '\0';
+		strcpy(key, pdir);
+		if ((fh = fopen(apl->archive, "rb")) == NULL) {
+			cpi_errorf(ctx, N_("Could not open plug-in archive %s: %s"), apl->archive, strerror(errno));
+			status = CP_ERR_IO;
+			break;
+		}
+		for (i = member_lower_bound(apl, prefix);
+			i < apl->num_members && !strncmp(apl->members[i].name, prefix, pdir_len + 1) && status == CP_OK;
+			i++) {
+			status = extract_member(apl, fh, apl->members + i);
+		}
+		if (status != CP_OK) {
+			cpi_errorf(ctx, N_("Could not extract %s from plug-in archive %s."), apl->members[i - 1].name, apl->archive);
+			break;
+		}
+
+		// Remember the extracted plug-in directory
+		if (!hash_alloc_insert(apl->extracted, key, NULL)) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		key = NULL;
+
+	} while (0);
+	unlock_apl(apl);
+
+	// Release resources
+	if (fh != NULL) {
+		fclose(fh);
+	}
+	free(prefix);
+	free(key);
+
+	return (status == CP_OK);
+}
+
+CP_C_API cp_plugin_loader_t *cp_create_archive_ploader(const char *archive, const char *extract_dir, cp_status_t *error) {
+	cp_plugin_loader_t *loader = NULL;
+	apl_data_t *apl;
+	cp_status_t status = CP_OK;
+
+	CHECK_NOT_NULL(archive);
+	CHECK_NOT_NULL(extract_dir);
+
+	// Allocate and initialize a new archive plug-in loader
+	do {
+
+		// Allocate memory for the loader
+		if ((loader = malloc(sizeof(cp_plugin_loader_t))) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+
+		// Initialize loader
+		memset(loader, 0, sizeof(cp_plugin_loader_t));
+		loader->scan_plugins = apl_scan_plugins;
+		loader->resolve_files = apl_resolve_files;
+		loader->release_plugins = NULL;
+		if ((loader->data = apl = malloc(sizeof(apl_data_t))) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		memset(apl, 0, sizeof(apl_data_t));
+		init_crc_table(apl->crc_table);
+		if ((apl->archive = malloc((strlen(archive) + 1) * sizeof(char))) == NULL
+			|| (apl->extract_dir = malloc((strlen(extract_dir) + 1) * sizeof(char))) == NULL
+			|| (apl->extracted = hash_create(HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		strcpy(apl->archive, archive);
+		strcpy(apl->extract_dir, extract_dir);
+#ifdef CP_THREADS
+		if ((apl->mutex = cpi_create_mutex()) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+#endif
+
+		// Index the archive members
+		status = read_index(apl);
+
+	} while (0);
+
+	// Release resources on failure
+	if (status != CP_OK) {
+		if (loader != NULL) {
+			cp_destroy_archive_ploader(loader);
+		}
+		loader = NULL;
+	}
+
+	// Return the final status
+	if (error != NULL) {
+		*error = status;
+	}
+
+	// Return the loader (or NULL on failure)
+	return loader;
+}
+
+CP_C_API void cp_destroy_archive_ploader(cp_plugin_loader_t *loader) {
+	apl_data_t *apl;
+
+	CHECK_NOT_NULL(loader);
+
+	apl = loader->data;
+	if (apl != NULL) {
+		if (apl->extracted != NULL) {
+			hscan_t hscan;
+			hnode_t *hnode;
+
+			hash_scan_begin(&hscan, apl->extracted);
+			while ((hnode = hash_scan_next(&hscan)) != NULL) {
+				char *key = (char *) hnode_getkey(hnode);
+
+				hash_scan_delfree(apl->extracted, hnode);
+				free(key);
+			}
+			hash_destroy(apl->extracted);
+		}
+#ifdef CP_THREADS
+		if (apl->mutex != NULL) {
+			cpi_destroy_mutex(apl->mutex);
+		}
+#endif
+		free(apl->archive);
+		free(apl->extract_dir);
+		free(apl->members);
+		free(apl->names);
+		free(apl);
+		loader->data = NULL;
+	}
+	free(loader);
+}
@@ -0,0 +1,487 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file
+ * Compact configuration element trees
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../kazlib/hash.h"
+#include "cpluff.h"
+#include "defines.h"
+#include "util.h"
+#include "internal.h"
+
+
+/* ------------------------------------------------------------------------
+ * Constants
+ * ----------------------------------------------------------------------*/
+
+/// The string offset of a missing string
+#define NO_STRING ((unsigned int) -1)
+
+
+/* ------------------------------------------------------------------------
+ * Data types
+ * ----------------------------------------------------------------------*/
+
+/**
+ * A configuration element in a compact tree. The elements are stored in
+ * preorder so that the first child of an element, if any, directly
+ * follows the element and the subtree of an element is a contiguous range.
+ * Strings are referred to by their offset in the string table.
+ */
+typedef struct cfg_tree_node_t {
+
+	/// The name of the element
+	unsigned int name;
+
+	/// The value of the element or NO_STRING
+	unsigned int value;
+
+	/// The parent element or CP_CFG_NONE
+	unsigned int parent;
+
+	/// The element following the subtree of this element
+	unsigned int end;
+
+	/// The first attribute of the element in the attribute array
+	unsigned int atts;
+
+	/// The number of attributes
+	unsigned int num_atts;
+
+	/// The number of children
+	unsigned int num_children;
+
+} cfg_tree_node_t;
+
+/// A compact configuration element tree, followed by its content
+struct cp_cfg_tree_t {
+
+	/// The number of elements
+	unsigned int num_nodes;
+
+	/// The elements in preorder
+	cfg_tree_node_t *nodes;
+
+	/// The alternating attribute name and value string offsets
+	unsigned int *atts;
+
+	/// The string table
+	char *strings;
+
+	/// The arena holding the equivalent element structures, or NULL if not built
+	cpi_arena_t *arena;
+
+	/// The equivalent element structures, or NULL if not built
+	cp_cfg_element_t *element;
+
+};
+
+/// The state of building a compact tree
+typedef struct tree_builder_t {
+
+	/// Maps the distinct strings to their offsets in the string table
+	hash_t *offsets;
+
+	/// Holds the string offsets referred to by the map
+	cpi_arena_t *arena;
+
+	/// The number of elements
+	unsigned int num_nodes;
+
+	/// The number of attributes
+	unsigned int num_atts;
+
+	/// The size of the string table
+	size_t strings_size;
+
+	/// The tree being filled, or NULL while counting
+	cp_cfg_tree_t *tree;
+
+	/// The next free element in the tree
+	unsigned int next_node;
+
+	/// The next free attribute in the tree
+	unsigned int next_att;
+
+	/// Whether building has failed due to insufficient memory
+	int error;
+
+} tree_builder_t;
+
+
+/* ------------------------------------------------------------------------
+ * Function definitions
+ * ----------------------------------------------------------------------*/
+
+// Building trees
+
+/**
+ * Returns the string table offset of a string, allocating it when the
+ * string is first seen while counting.
+ *
+ * @param b the tree builder
+ * @param str the string or NULL
+ * @return the string table offset or NO_STRING
+ */
+static unsigned int put_string(tree_builder_t *b, const char *str) {
+	hnode_t *node;
+	unsigned int *offset;
+
+	if (str == NULL || b->error) {
+		return NO_STRING;
+	}
+	if ((node = hash_lookup(b->offsets, str)) != NULL) {
+		offset = hnode_get(node);
+	} else {
+		size_t len = strlen(str) + 1;
+
+		assert(b->tree == NULL);
+		if (b->strings_size + len >= NO_STRING
+			|| (offset = cpi_arena_alloc(b->arena, sizeof(unsigned int))) == NULL
+			|| !hash_alloc_insert(b->offsets, str, offset)) {
+			b->error = 1;
+			return NO_STRING;
+		}
+		*offset = b->strings_size;
+		b->strings_size += len;
+	}
+	if (b->tree != NULL) {
+		strcpy(b->tree->strings + *offset, str);
+	}
+	return *offset;
+}
+
+/**
+ * Counts the elements, attributes and distinct strings of a configuration
+ * element tree.
+ *
+ * @param b the tree builder
+ * @param ce the configuration element
+ */
+static void count_cfg(tree_builder_t *b, const cp_cfg_element_t *ce) {
+	unsigned int i;
+
+	b->num_nodes++;
+	b->num_atts += ce->num_atts;
+	put_string(b, ce->name);
+	put_string(b, ce->value);
+	for (i = 0; i < 2 * ce->num_atts; i++) {
+		put_string(b, ce->atts[i]);
+	}
+	for (i = 0; i < ce->num_children; i++) {
+		count_cfg(b, ce->children + i);
+	}
+}
+
+/**
+ * Stores a configuration element tree in preorder.
+ *
+ * @param b the tree builder
+ * @param ce the configuration element
+ * @param parent the parent element or CP_CFG_NONE
+ */
+static void fill_cfg(tree_builder_t *b, const cp_cfg_element_t *ce, unsigned int parent) {
+	unsigned int n = b->next_node++;
+	cfg_tree_node_t *node = b->tree->nodes + n;
+	unsigned int i;
+
+	node->name = put_string(b, ce->name);
+	node->value = put_string(b, ce->value);
+	node->parent = parent;
+	node->atts = b->next_att;
+	node->num_atts = ce->num_atts;
+	node->num_children = ce->num_children;
+	for (i = 0; i < 2 * ce->num_atts; i++) {
+		b->tree->atts[b->next_att * 2 + i] = put_string(b, ce->atts[i]);
+	}
+	b->next_att += ce->num_atts;
+	for (i = 0; i < ce->num_children; i++) {
+		fill_cfg(b, ce->children + i, n);
+	}
+	b->tree->nodes[n].end = b->next_node;
+}
+
+CP_C_API cp_cfg_tree_t * cp_compact_cfg(const cp_cfg_element_t *root, cp_status_t *error) {
+	tree_builder_t b;
+	cp_cfg_tree_t *tree = NULL;
+	cp_status_t status = CP_OK;
+
+	CHECK_NOT_NULL(root);
+	memset(&b, 0, sizeof(b));
+	do {
+		size_t size;
+
+		// Count the content and lay out the string table
+		if ((b.offsets = hash_create(HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL
+			|| (b.arena = cpi_create_arena(1024)) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		count_cfg(&b, root);
+		if (b.error || b.num_nodes >= CP_CFG_NONE) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+
+		// Allocate the tree and its content as a single block
+		size = sizeof(cp_cfg_tree_t)
+			+ b.num_nodes * sizeof(cfg_tree_node_t)
+			+ 2 * b.num_atts * sizeof(unsigned int)
+			+ b.strings_size;
+		if ((tree = malloc(size)) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		tree->num_nodes = b.num_nodes;
+		tree->nodes = (cfg_tree_node_t *) (tree + 1);
+		tree->atts = (unsigned int *) (tree->nodes + b.num_nodes);
+		tree->strings = (char *) (tree->atts + 2 * b.num_atts);
+		tree->arena = NULL;
+		tree->element = NULL;
+
+		// Store the elements
+		b.tree = tree;
+		fill_cfg(&b, root, CP_CFG_NONE);
+		assert(!b.error && b.next_node == b.num_nodes && b.next_att == b.num_atts);
+
+	} while (0);
+
+	// Release resources
+	if (b.offsets != NULL) {
+		hash_free_nodes(b.offsets);
+		hash_destroy(b.offsets);
+	}
+	if (b.arena != NULL) {
+		cpi_destroy_arena(b.arena);
+	}
+	if (status != CP_OK && tree != NULL) {
+		free(tree);
+		tree = NULL;
+	}
+
+	if (error != NULL) {
+		*error = status;
+	}
+	return tree;
+}
+
+CP_C_API void cp_free_cfg_tree(cp_cfg_tree_t *tree) {
+	CHECK_NOT_NULL(tree);
+	if (tree->arena != NULL) {
+		cpi_destroy_arena(tree->arena);
+	}
+	free(tree);
+}
+
+
+// Accessing trees
+
+/**
+ * Returns a string of a tree.
+ *
+ * @param tree the tree
+ * @param offset the string table offset or NO_STRING
+ * @return the string or NULL
+ */
+static char *get_string(const cp_cfg_tree_t *tree, unsigned int offset) {
+	return (offset != NO_STRING ? tree->strings + offset : NULL);
+}
+
+/// Checks that a tree element index is valid
+#define CHECK_NODE(tree, node) do { \
+	CHECK_NOT_NULL(tree); \
+	assert((node) < (tree)->num_nodes); \
+} while (0)
+
+CP_C_API unsigned int cp_cfg_tree_size(const cp_cfg_tree_t *tree) {
+	CHECK_NOT_NULL(tree);
+	return tree->num_nodes;
+}
+
+CP_C_API const char * cp_cfg_tree_name(const cp_cfg_tree_t *tree, unsigned int node) {
+	CHECK_NODE(tree, node);
+	return get_string(tree, tree->nodes[node].name);
+}
+
+CP_C_API const char * cp_cfg_tree_value(const cp_cfg_tree_t *tree, unsigned int node) {
+	CHECK_NODE(tree, node);
+	return get_string(tree, tree->nodes[node].value);
+}
+
+CP_C_API unsigned int cp_cfg_tree_parent(const cp_cfg_tree_t *tree, unsigned int node) {
+	CHECK_NODE(tree, node);
+	return tree->nodes[node].parent;
+}
+
+CP_C_API unsigned int cp_cfg_tree_first_child(const cp_cfg_tree_t *tree, unsigned int node) {
+	CHECK_NODE(tree, node);
+	return (tree->nodes[node].num_children > 0 ? node + 1 : CP_CFG_NONE);
+}
+
+CP_C_API unsigned int cp_cfg_tree_next_sibling(const cp_cfg_tree_t *tree, unsigned int node) {
+	unsigned int parent;
+
+	CHECK_NODE(tree, node);
+	if ((parent = tree->nodes[node].parent) == CP_CFG_NONE
+		|| tree->nodes[node].end == tree->nodes[parent].end) {
+		return CP_CFG_NONE;
+	}
+	return tree->nodes[node].end;
+}
+
+CP_C_API unsigned int cp_cfg_tree_num_children(const cp_cfg_tree_t *tree, unsigned int node) {
+	CHECK_NODE(tree, node);
+	return tree->nodes[node].num_children;
+}
+
+CP_C_API const char * cp_cfg_tree_attr(const cp_cfg_tree_t *tree, unsigned int node, const char *name) {
+	const cfg_tree_node_t *n;
+	unsigned int i;
+
+	CHECK_NODE(tree, node);
+	CHECK_NOT_NULL(name);
+	n = tree->nodes + node;
+	for (i = n->atts; i < n->atts + n->num_atts; i++) {
+		if (!strcmp(tree->strings + tree->atts[2 * i], name)) {
+			return get_string(tree, tree->atts[2 * i + 1]);
+		}
+	}
+	return NULL;
+}
+
+CP_C_API unsigned int cp_cfg_tree_lookup(const cp_cfg_tree_t *tree, unsigned int node, const char *path) {
+	size_t start = 0;
+
+	CHECK_NODE(tree, node);
+	CHECK_NOT_NULL(path);
+
+	// Traverse the path as done by cp_lookup_cfg_element
+	while (node != CP_CFG_NONE && path[start] != '\0') {
+		size_t end = start;
+
+		while (path[end] != '\0' && path[end] != '/') {
+			end++;
+		}
+		if (end - start == 2 && !strncmp(path + start, "..", 2)) {
+			node = tree->nodes[node].parent;
+		} else {
+			unsigned int child, stop = tree->nodes[node].end;
+
+			for (child = node + 1; child < stop; child = tree->nodes[child].end) {
+				const char *name = tree->strings + tree->nodes[child].name;
+
+				if (!strncmp(name, path + start, end - start) && name[end - start] == '\0') {
+					break;
+				}
+			}
+			node = (child < stop ? child : CP_CFG_NONE);
+		}
+		start = end;
+		if (path[start] == '/') {
+			start++;
+		}
+	}
+	return node;
+}
+
+
+// Compatibility structures
+
+/**
+ * Fills in the element structure of a tree element, allocating the
+ * structures of the children.
+ *
+ * @param tree the tree
+ * @param node the element index
+ * @param ce the element structure to be filled in
+ * @param parent the parent element structure or NULL
+ * @param index the index of the element among its siblings
+ * @return whether successful
+ */
+static int expand_cfg(cp_cfg_tree_t *tree, unsigned int node, cp_cfg_element_t *ce, cp_cfg_element_t *parent, unsigned int index) {
+	const cfg_tree_node_t *n = tree->nodes + node;
+	unsigned int i, child;
+
+	ce->name = get_string(tree, n->name);
+	ce->value = get_string(tree, n->value);
+	ce->parent = parent;
+	ce->index = index;
+	ce->num_atts = n->num_atts;
+	ce->atts = NULL;
+	ce->num_children = n->num_children;
+	ce->children = NULL;
+	if (n->num_atts > 0) {
+		if ((ce->atts = cpi_alloc_cfg_atts(tree->arena, n->num_atts)) == NULL) {
+			return 0;
+		}
+		for (i = 0; i < 2 * n->num_atts; i++) {
+			ce->atts[i] = get_string(tree, tree->atts[2 * n->atts + i]);
+		}
+	}
+	if (n->num_children > 0) {
+		if ((ce->children = cpi_alloc_cfg_children(tree->arena, n->num_children)) == NULL) {
+			return 0;
+		}
+		for (i = 0, child = node + 1; i < n->num_children; i++, child = tree->nodes[child].end) {
+			if (!expand_cfg(tree, child, ce->children + i, ce, i)) {
+				return 0;
+			}
+		}
+	}
+	cpi_index_cfg_element(tree->arena, ce);
+	return 1;
+}
+
+CP_C_API cp_cfg_element_t * cp_cfg_tree_element(cp_cfg_tree_t *tree, cp_status_t *error) {
+	cp_status_t status = CP_OK;
+
+	CHECK_NOT_NULL(tree);
+	if (tree->element == NULL) {
+		cp_cfg_element_t *root;
+
+		if ((tree->arena = cpi_create_arena(4096)) == NULL
+			|| (root = cpi_arena_alloc(tree->arena, sizeof(cp_cfg_element_t))) == NULL
+			|| !expand_cfg(tree, 0, root, NULL, 0)) {
+			if (tree->arena != NULL) {
+				cpi_destroy_arena(tree->arena);
+				tree->arena = NULL;
+			}
+			status = CP_ERR_RESOURCE;
+		} else {
+			tree->element = root;
+		}
+	}
+	if (error != NULL) {
+		*error = status;
+	}
+	return tree->element;
+}
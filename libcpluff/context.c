@@ -43,12 +43,53 @@
 #include "internal.h"
 
 
+/* ------------------------------------------------------------------------
+ * Data types
+ * ----------------------------------------------------------------------*/
+
+/// Contains information about a registered fork handler
+typedef struct fork_handler_t {
+
+	/// The handler function
+	cp_fork_handler_func_t handler;
+
+	/// The user data pointer
+	void *user_data;
+
+	/// The registering plug-in or NULL for the main program
+	cp_plugin_t *plugin;
+
+} fork_handler_t;
+
+
 /* ------------------------------------------------------------------------
  * Variables
  * ----------------------------------------------------------------------*/
 
-/// Existing contexts
-static list_t *contexts = NULL;
+/// Number of shards in the registry of main program contexts
+#define CONTEXT_SHARDS 16
+
+/// A shard of the registry of main program contexts
+typedef struct context_shard_t {
+
+#ifdef CP_THREADS
+
+	/// Mutex protecting the shard
+	cpi_mutex_t *mutex;
+
+#endif
+
+	/// The contexts registered in the shard
+	list_t contexts;
+
+} context_shard_t;
+
+/**
+ * Existing main program contexts. The contexts are spread over shards by
+ * address so that creating and destroying unrelated contexts concurrently
+ * does not contend for a single mutex.
+ */
+static context_shard_t context_shards[CONTEXT_SHARDS];
 
 
 /* ------------------------------------------------------------------------
@@ -61,16 +102,50 @@ static void free_plugin_env(cp_plugin_env_t *env) {
 	assert(env != NULL);
 	
 	// Free environment data
+	if (env->plugin_listeners != NULL
+		&& env->plisteners_by_id != NULL
+		&& env->prefix_plisteners != NULL) {
+		cpi_unregister_plisteners(env, NULL);
+	}
 	if (env->plugin_listeners != NULL) {
-		cpi_unregister_plisteners(env->plugin_listeners, NULL);
 		list_destroy(env->plugin_listeners);
 		env->plugin_listeners = NULL;
 	}
+	if (env->plisteners_by_id != NULL) {
+		assert(hash_isempty(env->plisteners_by_id));
+		hash_destroy(env->plisteners_by_id);
+		env->plisteners_by_id = NULL;
+	}
+	if (env->prefix_plisteners != NULL) {
+		list_destroy(env->prefix_plisteners);
+		env->prefix_plisteners = NULL;
+	}
+	if (env->batch_listeners != NULL) {
+		assert(list_isempty(env->batch_listeners));
+		list_destroy(env->batch_listeners);
+		env->batch_listeners = NULL;
+	}
+	if (env->fork_handlers != NULL) {
+		assert(list_isempty(env->fork_handlers));
+		list_destroy(env->fork_handlers);
+		env->fork_handlers = NULL;
+	}
+	cpi_free_change_feed(env);
+	assert(env->num_queued_events == 0);
+	free(env->event_queue);
+	free(env->event_batch);
 	if (env->loggers != NULL) {
-		cpi_unregister_loggers(env->loggers, NULL);
+		assert(list_isempty(env->loggers));
 		list_destroy(env->loggers);
 		env->loggers = NULL;
 	}
+	if (env->log_filters != NULL) {
+		assert(hash_isempty(env->log_filters));
+		hash_destroy(env->log_filters);
+		env->log_filters = NULL;
+	}
+	free(env->log_index);
+	assert(env->log_ring == NULL);
 	if (env->local_loader != NULL) {
 		cp_destroy_local_ploader(env->local_loader);
 		env->local_loader = NULL;
@@ -80,19 +155,31 @@ static void free_plugin_env(cp_plugin_env_t *env) {
 		hash_destroy(env->loaders_to_plugins);
 		env->loaders_to_plugins = NULL;
 	}
-	if (env->infos != NULL) {
-		assert(hash_isempty(env->infos));
-		hash_destroy(env->infos);
-		env->infos = NULL;
+	assert(env->infos == NULL);
+	if (env->infos_index != NULL) {
+		assert(hash_isempty(env->infos_index));
+		hash_destroy(env->infos_index);
+		env->infos_index = NULL;
+	}
+#ifdef CP_THREADS
+	if (env->infos_mutex != NULL) {
+		cpi_destroy_mutex(env->infos_mutex);
+	}
+#endif
+	cpi_free_idle_parsers(env);
+#ifdef CP_THREADS
+	if (env->parsers_mutex != NULL) {
+		cpi_destroy_mutex(env->parsers_mutex);
 	}
+#endif
+	free(env->resolve_order);
 	if (env->plugins != NULL) {
 		assert(hash_isempty(env->plugins));
 		hash_destroy(env->plugins);
 		env->plugins = NULL;
 	}
 	if (env->started_plugins != NULL) {
-		assert(list_isempty(env->started_plugins));
-		list_destroy(env->started_plugins);
+		cpi_destroy_ptrset(env->started_plugins);
 		env->started_plugins = NULL;
 	}
 	if (env->ext_points != NULL) {
@@ -103,10 +190,31 @@ static void free_plugin_env(cp_plugin_env_t *env) {
 		assert(hash_isempty(env->extensions));
 		hash_destroy(env->extensions);
 	}
+	assert(env->num_ext_index == 0);
+	free(env->ext_index);
 	if (env->run_funcs != NULL) {
 		assert(list_isempty(env->run_funcs));
 		list_destroy(env->run_funcs);
 	}
+	cpi_release_run_wake(env);
+	assert(env->ext_snapshot == NULL);
+	cpi_release_template_image(env);
+	if (env->retired_snapshots != NULL) {
+		assert(list_isempty(env->retired_snapshots));
+		list_destroy(env->retired_snapshots);
+	}
+#ifdef CP_THREADS
+	if (env->snapshot_mutex != NULL) {
+		cpi_destroy_mutex(env->snapshot_mutex);
+	}
+#endif
+	if (env->strings != NULL) {
+		cpi_destroy_strpool(env->strings);
+	}
+	if (env->nodes != NULL) {
+		cpi_destroy_node_pool(env->nodes);
+	}
+	free(env->descriptor_cache_dir);
 	
 	// Destroy mutex 
 #ifdef CP_THREADS
@@ -120,14 +228,73 @@ static void free_plugin_env(cp_plugin_env_t *env) {
 
 }
 
+/**
+ * Returns the registry shard of a main program context.
+ *
+ * @param context the plug-in context
+ * @return the shard
+ */
+static context_shard_t *get_context_shard(const cp_context_t *context) {
+	size_t addr = (size_t) context;
+
+	// Skip the bits that are always zero due to allocation alignment
+	return context_shards + ((addr >> 4) ^ (addr >> 10)) % CONTEXT_SHARDS;
+}
+
+/**
+ * Locks a shard of the context registry.
+ *
+ * @param shard the shard
+ */
+static void lock_shard(context_shard_t *shard) {
+#ifdef CP_THREADS
+	cpi_lock_mutex(shard->mutex);
+#endif
+}
+
+/**
+ * Unlocks a shard of the context registry.
+ *
+ * @param shard the shard
+ */
+static void unlock_shard(context_shard_t *shard) {
+#ifdef CP_THREADS
+	cpi_unlock_mutex(shard->mutex);
+#endif
+}
+
+CP_HIDDEN cp_status_t cpi_init_context_registry(void) {
+	int i;
+
+	for (i = 0; i < CONTEXT_SHARDS; i++) {
+		list_init(&(context_shards[i].contexts), LISTCOUNT_T_MAX);
+#ifdef CP_THREADS
+		if ((context_shards[i].mutex = cpi_create_mutex()) == NULL) {
+			cpi_release_context_registry();
+			return CP_ERR_RESOURCE;
+		}
+#endif
+	}
+	return CP_OK;
+}
+
+CP_HIDDEN void cpi_release_context_registry(void) {
+	int i;
+
+	for (i = 0; i < CONTEXT_SHARDS; i++) {
+		assert(list_isempty(&(context_shards[i].contexts)));
+#ifdef CP_THREADS
+		if (context_shards[i].mutex != NULL) {
+			cpi_destroy_mutex(context_shards[i].mutex);
+			context_shards[i].mutex = NULL;
+		}
+#endif
+	}
+}
+
 CP_HIDDEN void cpi_free_context(cp_context_t *context) {
 	assert(context != NULL);
 	
-	// Free environment if this is the client program context
-	if (context->plugin == NULL && context->env != NULL) {
-		free_plugin_env(context->env);
-	}
-	
 	// Destroy symbol lists
 	if (context->resolved_symbols != NULL) {
 		assert(hash_isempty(context->resolved_symbols));
@@ -137,6 +304,20 @@ CP_HIDDEN void cpi_free_context(cp_context_t *context) {
 		assert(hash_isempty(context->symbol_providers));
 		hash_destroy(context->symbol_providers);
 	}
+	if (context->symbol_cache != NULL) {
+		assert(hash_isempty(context->symbol_cache));
+		hash_destroy(context->symbol_cache);
+	}
+#ifdef CP_THREADS
+	if (context->symbols_mutex != NULL) {
+		cpi_destroy_mutex(context->symbols_mutex);
+	}
+#endif
+
+	// Free environment if this is the client program context
+	if (context->plugin == NULL && context->env != NULL) {
+		free_plugin_env(context->env);
+	}
 
 	// Free context
 	free(context);	
@@ -162,6 +343,14 @@ CP_HIDDEN cp_context_t * cpi_new_context(cp_plugin_t *plugin, cp_plugin_env_t *e
 		context->env = env;
 		context->resolved_symbols = NULL;
 		context->symbol_providers = NULL;
+		context->symbol_cache = NULL;
+		lnode_init(&(context->registry_node), context);
+#ifdef CP_THREADS
+		if ((context->symbols_mutex = cpi_create_mutex()) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+#endif
 		
 	} while (0);
 	
@@ -178,6 +367,7 @@ CP_HIDDEN cp_context_t * cpi_new_context(cp_plugin_t *plugin, cp_plugin_env_t *e
 CP_C_API cp_context_t * cp_create_context(cp_status_t *error) {
 	cp_plugin_env_t *env = NULL;
 	cp_context_t *context = NULL;
+	context_shard_t *shard;
 	cp_status_t status = CP_OK;
 
 	// Initialize internal state
@@ -198,32 +388,70 @@ CP_C_API cp_context_t * cp_create_context(cp_status_t *error) {
 		env->argv = NULL;
 		env->plugin_descriptor_name = CP_PLUGIN_DESCRIPTOR;
 		env->plugin_descriptor_root_element = CP_PLUGIN_ROOT_ELEMENT;
+		env->descriptor_cache_dir = NULL;
+		env->lazy_ext_cfg = 0;
+		if ((env->nodes = cpi_create_node_pool()) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
 		env->plugin_listeners = list_create(LISTCOUNT_T_MAX);
+		env->plisteners_by_id = cpi_create_pooled_hash(env->nodes, HASHCOUNT_T_MAX, cpi_comp_interned, NULL);
+		env->prefix_plisteners = list_create(LISTCOUNT_T_MAX);
+		env->batch_listeners = list_create(LISTCOUNT_T_MAX);
+		env->fork_handlers = list_create(LISTCOUNT_T_MAX);
 		env->loggers = list_create(LISTCOUNT_T_MAX);
+		env->log_filters = hash_create(HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL);
 		env->log_min_severity = CP_LOG_NONE;
+		env->log_filter_min_severity = CP_LOG_NONE;
 		env->local_loader = NULL;
-		env->loaders_to_plugins = hash_create(LISTCOUNT_T_MAX, cpi_comp_ptr, cpi_hashfunc_ptr);
-		env->infos = hash_create(HASHCOUNT_T_MAX, cpi_comp_ptr, cpi_hashfunc_ptr);
-		env->plugins = hash_create(HASHCOUNT_T_MAX,
-			(int (*)(const void *, const void *)) strcmp, NULL);
-		env->started_plugins = list_create(LISTCOUNT_T_MAX);
-		env->ext_points = hash_create(HASHCOUNT_T_MAX,
-			(int (*)(const void *, const void *)) strcmp, NULL);
-		env->extensions = hash_create(HASHCOUNT_T_MAX,
-			(int (*)(const void *, const void *)) strcmp, NULL);
+		env->loaders_to_plugins = cpi_create_pooled_hash(env->nodes, LISTCOUNT_T_MAX, cpi_comp_ptr, cpi_hashfunc_ptr);
+		env->infos = NULL;
+		env->infos_index = hash_create(HASHCOUNT_T_MAX, cpi_comp_ptr, cpi_hashfunc_ptr);
+#ifdef CP_THREADS
+		env->infos_mutex = cpi_create_mutex();
+		env->parsers_mutex = cpi_create_mutex();
+#endif
+		env->strings = cpi_create_strpool();
+		env->plugins = cpi_create_pooled_hash(env->nodes, HASHCOUNT_T_MAX, cpi_comp_interned, NULL);
+		env->started_plugins = cpi_create_ptrset();
+		env->ext_points = cpi_create_pooled_hash(env->nodes, HASHCOUNT_T_MAX, cpi_comp_interned, NULL);
+		env->extensions = cpi_create_pooled_hash(env->nodes, HASHCOUNT_T_MAX, cpi_comp_interned, NULL);
+		env->ext_index = NULL;
+		env->num_ext_index = 0;
+		env->size_ext_index = 0;
+#ifdef CP_THREADS
+		env->snapshot_mutex = cpi_create_mutex();
+#endif
+		env->ext_snapshot = NULL;
+		env->retired_snapshots = list_create(LISTCOUNT_T_MAX);
+		env->template_image = NULL;
 		env->run_funcs = list_create(LISTCOUNT_T_MAX);
 		env->run_wait = NULL;
 		if (env->plugin_listeners == NULL
+			|| env->plisteners_by_id == NULL
+			|| env->prefix_plisteners == NULL
+			|| env->batch_listeners == NULL
+			|| env->fork_handlers == NULL
 			|| env->loggers == NULL
+			|| env->log_filters == NULL
 #ifdef CP_THREADS
 			|| env->mutex == NULL
 #endif
 			|| env->loaders_to_plugins == NULL
-			|| env->infos == NULL
+			|| env->infos_index == NULL
+#ifdef CP_THREADS
+			|| env->infos_mutex == NULL
+			|| env->parsers_mutex == NULL
+#endif
+			|| env->strings == NULL
 			|| env->plugins == NULL
 			|| env->started_plugins == NULL
 			|| env->ext_points == NULL
 			|| env->extensions == NULL
+#ifdef CP_THREADS
+			|| env->snapshot_mutex == NULL
+#endif
+			|| env->retired_snapshots == NULL
 			|| env->run_funcs == NULL) {
 			status = CP_ERR_RESOURCE;
 			break;
@@ -235,23 +463,11 @@ CP_C_API cp_context_t * cp_create_context(cp_status_t *error) {
 		}
 		env = NULL;
 
-		// Create a context list, if necessary, and add context to the list
-		cpi_lock_framework();
-		if (contexts == NULL) {
-			if ((contexts = list_create(LISTCOUNT_T_MAX)) == NULL) {
-				status = CP_ERR_RESOURCE;
-			}
-		}
-		if (status == CP_OK) {
-			lnode_t *node;
-			
-			if ((node = lnode_create(context)) == NULL) {
-				status = CP_ERR_RESOURCE;
-			} else {
-				list_append(contexts, node);
-			}
-		}
-		cpi_unlock_framework();
+		// Register the context in its shard
+		shard = get_context_shard(context);
+		lock_shard(shard);
+		list_append(&(shard->contexts), &(context->registry_node));
+		unlock_shard(shard);
 		
 	} while (0);
 	
@@ -289,7 +505,112 @@ CP_C_API void cp_set_plugin_descriptor_name(cp_context_t *context, const char *n
 	context->env->plugin_descriptor_name = name;
 }
 
+CP_C_API cp_status_t cp_set_descriptor_cache_dir(cp_context_t *context, const char *dir) {
+	char *d = NULL;
+	
+	CHECK_NOT_NULL(context);
+	if (dir != NULL) {
+		if ((d = malloc((strlen(dir) + 1) * sizeof(char))) == NULL) {
+			return CP_ERR_RESOURCE;
+		}
+		strcpy(d, dir);
+	}
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	free(context->env->descriptor_cache_dir);
+	context->env->descriptor_cache_dir = d;
+	cpi_unlock_context(context);
+	return CP_OK;
+}
+
+CP_C_API void cp_set_lazy_ext_configuration(cp_context_t *context, int lazy) {
+	CHECK_NOT_NULL(context);
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	context->env->lazy_ext_cfg = (lazy != 0);
+	cpi_unlock_context(context);
+}
+
+CP_C_API void cp_set_runtime_preloading(cp_context_t *context, unsigned int num_threads, int prebind) {
+	CHECK_NOT_NULL(context);
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	context->env->preload_threads = num_threads;
+	context->env->preload_prebind = (prebind != 0);
+	cpi_unlock_context(context);
+}
+
+CP_C_API void cp_set_lazy_runtime_loading(cp_context_t *context, int lazy) {
+	CHECK_NOT_NULL(context);
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	context->env->lazy_runtime = (lazy != 0);
+	cpi_unlock_context(context);
+}
+
+CP_C_API void cp_set_runtime_library_unloading(cp_context_t *context, int unload) {
+	CHECK_NOT_NULL(context);
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	context->env->keep_runtime_libs = !unload;
+	cpi_unlock_context(context);
+}
+
+#ifdef CP_THREADS
+static void dealloc_lock_stats(cp_context_t *context, cp_lock_stats_t *stats) {
+	cpi_free_info(stats);
+}
+#endif
+
+CP_C_API cp_status_t cp_set_lock_profiling(cp_context_t *context, int enabled) {
+	cp_status_t status = CP_OK;
+	
+	CHECK_NOT_NULL(context);
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+#ifdef CP_THREADS
+	if (!cpi_set_mutex_profiling(context->env->mutex, enabled)) {
+		cpi_error(context, N_("Lock profiling could not be enabled due to insufficient memory."));
+		status = CP_ERR_RESOURCE;
+	}
+#else
+	if (enabled) {
+		cpi_error(context, N_("Lock profiling is not available without multi-threading support."));
+		status = CP_ERR_RESOURCE;
+	}
+#endif
+	cpi_unlock_context(context);
+	return status;
+}
+
+CP_C_API cp_lock_stats_t *cp_get_lock_stats(cp_context_t *context, cp_status_t *error, int *num) {
+	cp_lock_stats_t *stats = NULL;
+	cp_status_t status = CP_ERR_UNKNOWN;
+	int n = 0;
+	
+	CHECK_NOT_NULL(context);
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+#ifdef CP_THREADS
+	if ((stats = cpi_copy_mutex_profile(context->env->mutex, &n, &status)) != NULL) {
+		cpi_register_info(context, stats, (cpi_dealloc_func_t) dealloc_lock_stats);
+	} else if (status == CP_ERR_RESOURCE) {
+		cpi_error(context, N_("Lock statistics could not be returned due to insufficient memory."));
+	}
+#endif
+	cpi_unlock_context(context);
+	if (error != NULL) {
+		*error = status;
+	}
+	if (num != NULL && status == CP_OK) {
+		*num = n;
+	}
+	return stats;
+}
+
 CP_C_API void cp_destroy_context(cp_context_t *context) {
+	context_shard_t *shard;
+
 	CHECK_NOT_NULL(context);
 	if (context->plugin != NULL) {
 		cpi_fatalf(_("Only the main program can destroy a plug-in context."));
@@ -306,17 +627,21 @@ CP_C_API void cp_destroy_context(cp_context_t *context) {
 	assert(!context->env->locked);
 #endif
 
-	// Remove context from the context list
-	cpi_lock_framework();
-	if (contexts != NULL) {
-		lnode_t *node;
-		
-		if ((node = list_find(contexts, context, cpi_comp_ptr)) != NULL) {
-			list_delete(contexts, node);
-			lnode_destroy(node);
-		}
+	// Remove context from the context registry
+	shard = get_context_shard(context);
+	lock_shard(shard);
+	if (lnode_is_in_a_list(&(context->registry_node))) {
+		list_delete(&(shard->contexts), &(context->registry_node));
 	}
-	cpi_unlock_framework();
+	unlock_shard(shard);
+
+	// Stop scans triggered by directory watches
+	cpi_unwatch_local_ploaders(context);
+
+	// Cancel or complete the pool tasks of the main program
+	cpi_lock_context(context);
+	cpi_drain_tasks(context, NULL);
+	cpi_unlock_context(context);
 
 	// Unload all plug-ins 
 	cp_uninstall_plugins(context);
@@ -329,27 +654,44 @@ CP_C_API void cp_destroy_context(cp_context_t *context) {
 		cp_unregister_ploader(context, context->env->local_loader);
 	}
 
-	// Release remaining information objects
+	// Deliver queued plug-in events and unregister batch listeners
+	cpi_stop_event_dispatcher(context);
+	cpi_lock_context(context);
+	cpi_unregister_batch_plisteners(context, NULL);
+	cpi_unregister_fork_handlers(context, NULL);
+	cpi_unlock_context(context);
+
+	// Release extension snapshots and remaining information objects
+	cpi_lock_context(context);
+	cpi_free_ext_snapshots(context);
+	cpi_unlock_context(context);
 	cpi_release_infos(context);
 	
+	// Deliver queued log messages and unregister loggers
+	cpi_lock_context(context);
+	cpi_stop_log_drainer(context);
+	cpi_unregister_loggers(context, NULL);
+	cpi_unlock_context(context);
+	
 	// Free context
 	cpi_free_context(context);
 }
 
 CP_HIDDEN void cpi_destroy_all_contexts(void) {
-	cpi_lock_framework();
-	if (contexts != NULL) {
+	int i;
+
+	for (i = 0; i < CONTEXT_SHARDS; i++) {
+		context_shard_t *shard = context_shards + i;
 		lnode_t *node;
-		
-		while ((node = list_last(contexts)) != NULL) {
-			cpi_unlock_framework();
+
+		lock_shard(shard);
+		while ((node = list_last(&(shard->contexts))) != NULL) {
+			unlock_shard(shard);
 			cp_destroy_context(lnode_get(node));
-			cpi_lock_framework();
+			lock_shard(shard);
 		}
-		list_destroy(contexts);
-		contexts = NULL;
+		unlock_shard(shard);
 	}
-	cpi_unlock_framework();
 }
 
 
@@ -397,7 +739,7 @@ CP_C_API cp_status_t cp_register_pcollection(cp_context_t *context, const char *
 	if (status != CP_OK) {
 		cpi_errorf(context, N_("The plug-in collection in path %s could not be registered due to insufficient memory."), dir);
 	} else {
-		cpi_debugf(context, N_("The plug-in collection in path %s was registered."), dir);
+		cpi_debugm(context, CP_MSG_COLLECTION_REGISTERED, NULL, dir, NULL, 0);
 	}
 	cpi_unlock_context(context);
 
@@ -413,7 +755,7 @@ CP_C_API void cp_unregister_pcollection(cp_context_t *context, const char *dir)
 	if (context->env->local_loader != NULL) {
 		cp_lpl_unregister_dir(context->env->local_loader, dir);
 	}
-	cpi_debugf(context, N_("The plug-in collection in path %s was unregistered."), dir);
+	cpi_debugm(context, CP_MSG_COLLECTION_UNREGISTERED, NULL, dir, NULL, 0);
 	cpi_unlock_context(context);
 }
 
@@ -424,7 +766,7 @@ CP_C_API void cp_unregister_pcollections(cp_context_t *context) {
 	if (context->env->local_loader != NULL) {
 		cp_lpl_unregister_dirs(context->env->local_loader);
 	}
-	cpi_debug(context, N_("All plug-in collections were unregistered."));
+	cpi_debugm(context, CP_MSG_COLLECTIONS_UNREGISTERED, NULL, NULL, NULL, 0);
 	cpi_unlock_context(context);
 }
 
@@ -441,7 +783,7 @@ CP_C_API cp_status_t cp_register_ploader(cp_context_t *ctx, cp_plugin_loader_t *
 	cpi_lock_context(ctx);
 	cpi_check_invocation(ctx, CPI_CF_ANY, __func__);
 	do {
-		if ((loader_plugins = hash_create(HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL) {
+		if ((loader_plugins = cpi_create_pooled_hash(ctx->env->nodes, HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL) {
 			status = CP_ERR_RESOURCE;
 			break;
 		}
@@ -455,7 +797,7 @@ CP_C_API cp_status_t cp_register_ploader(cp_context_t *ctx, cp_plugin_loader_t *
 	if (status != CP_OK) {
 		cpi_errorf(ctx, N_("The plug-in loader %p could not be registered due to insufficient memory."), (void *) loader);
 	} else {
-		cpi_debugf(ctx, N_("The plug-in loader %p was registered."), (void *) loader);
+		cpi_debugm(ctx, CP_MSG_LOADER_REGISTERED, NULL, NULL, loader, 0);
 	}
 	cpi_unlock_context(ctx);
 	
@@ -478,6 +820,7 @@ CP_C_API void cp_unregister_ploader(cp_context_t *ctx, cp_plugin_loader_t *loade
 
 	cpi_lock_context(ctx);
 	cpi_check_invocation(ctx, CPI_CF_ANY, __func__);
+	cpi_wait_parallel_starts(ctx);
 	hnode = hash_lookup(ctx->env->loaders_to_plugins, loader);
 	if (hnode != NULL) {
 		hash_t *loader_plugins = hnode_get(hnode);
@@ -497,7 +840,7 @@ CP_C_API void cp_unregister_ploader(cp_context_t *ctx, cp_plugin_loader_t *loade
 		hash_delete_free(ctx->env->loaders_to_plugins, hnode);
 		assert(hash_isempty(loader_plugins));
 		hash_destroy(loader_plugins);
-		cpi_debugf(ctx, N_("The plug-in loader %p was unregistered."), (void *) loader);
+		cpi_debugm(ctx, CP_MSG_LOADER_UNREGISTERED, NULL, NULL, loader, 0);
 	}
 	cpi_unlock_context(ctx);
 }
@@ -509,6 +852,7 @@ CP_C_API void cp_unregister_ploaders(cp_context_t *ctx) {
 	
 	cpi_lock_context(ctx);
 	cpi_check_invocation(ctx, CPI_CF_ANY, __func__);
+	cpi_wait_parallel_starts(ctx);
 	do {
 		hscan_t hscan;
 		hnode_t *hnode;
@@ -561,6 +905,119 @@ CP_C_API char **cp_get_context_args(cp_context_t *ctx, int *argc) {
 }
 
 
+// Fork support
+
+CP_C_API cp_status_t cp_register_fork_handler(cp_context_t *ctx, cp_fork_handler_func_t handler, void *user_data) {
+	cp_status_t status = CP_ERR_RESOURCE;
+	fork_handler_t *fh;
+	lnode_t *node;
+
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(handler);
+	cpi_lock_context(ctx);
+	cpi_check_invocation(ctx, CPI_CF_LOGGER | CPI_CF_LISTENER, __func__);
+	if ((fh = malloc(sizeof(fork_handler_t))) != NULL) {
+		fh->handler = handler;
+		fh->user_data = user_data;
+		fh->plugin = ctx->plugin;
+		if ((node = cpi_create_lnode(ctx->env->nodes, fh)) != NULL) {
+			list_append(ctx->env->fork_handlers, node);
+			status = CP_OK;
+		} else {
+			free(fh);
+		}
+	}
+	if (status != CP_OK) {
+		cpi_error(ctx, N_("A fork handler could not be registered due to insufficient memory."));
+	}
+	cpi_unlock_context(ctx);
+	return status;
+}
+
+/**
+ * Unregisters the fork handler of the specified list node.
+ * 
+ * @param context the plug-in context
+ * @param node the node
+ */
+static void unregister_fork_handler(cp_context_t *context, lnode_t *node) {
+	fork_handler_t *fh = lnode_get(node);
+
+	list_delete(context->env->fork_handlers, node);
+	cpi_destroy_lnode(context->env->nodes, node);
+	free(fh);
+}
+
+CP_C_API void cp_unregister_fork_handler(cp_context_t *ctx, cp_fork_handler_func_t handler) {
+	lnode_t *node;
+
+	CHECK_NOT_NULL(ctx);
+	cpi_lock_context(ctx);
+	cpi_check_invocation(ctx, CPI_CF_LOGGER | CPI_CF_LISTENER, __func__);
+	for (node = list_first(ctx->env->fork_handlers);
+		node != NULL;
+		node = list_next(ctx->env->fork_handlers, node)) {
+		if (((fork_handler_t *) lnode_get(node))->handler == handler) {
+			unregister_fork_handler(ctx, node);
+			break;
+		}
+	}
+	cpi_unlock_context(ctx);
+}
+
+CP_HIDDEN void cpi_unregister_fork_handlers(cp_context_t *context, cp_plugin_t *plugin) {
+	lnode_t *node;
+
+	assert(cpi_is_context_locked(context));
+	node = list_first(context->env->fork_handlers);
+	while (node != NULL) {
+		lnode_t *next = list_next(context->env->fork_handlers, node);
+
+		if (plugin == NULL || ((fork_handler_t *) lnode_get(node))->plugin == plugin) {
+			unregister_fork_handler(context, node);
+		}
+		node = next;
+	}
+}
+
+CP_C_API void cp_prepare_fork(cp_context_t *ctx) {
+	CHECK_NOT_NULL(ctx);
+	cpi_lock_context(ctx);
+	cpi_check_invocation(ctx, CPI_CF_ANY, __func__);
+	cpi_unlock_context(ctx);
+
+	// Stop directory watches and the background delivery threads
+	cpi_unwatch_local_ploaders(ctx);
+	cpi_stop_event_dispatcher(ctx);
+	cpi_stop_log_drainer(ctx);
+#ifdef CP_THREADS
+	cpi_quiesce_task_pool();
+#endif
+	cpi_lock_context(ctx);
+	cpi_debug(ctx, N_("The plug-in context was prepared for forking."));
+	cpi_unlock_context(ctx);
+}
+
+CP_C_API void cp_after_fork(cp_context_t *ctx) {
+	lnode_t *node;
+
+	CHECK_NOT_NULL(ctx);
+	cpi_lock_context(ctx);
+	cpi_check_invocation(ctx, CPI_CF_ANY, __func__);
+	ctx->env->in_event_listener_invocation++;
+	for (node = list_first(ctx->env->fork_handlers);
+		node != NULL;
+		node = list_next(ctx->env->fork_handlers, node)) {
+		fork_handler_t *fh = lnode_get(node);
+
+		fh->handler(fh->user_data);
+	}
+	ctx->env->in_event_listener_invocation--;
+	cpi_debug(ctx, N_("Fork handlers were invoked in the new process."));
+	cpi_unlock_context(ctx);
+}
+
+
 // Checking API call invocation
 
 CP_HIDDEN void cpi_check_invocation(cp_context_t *ctx, int funcmask, const char *func) {
@@ -577,7 +1034,8 @@ CP_HIDDEN void cpi_check_invocation(cp_context_t *ctx, int funcmask, const char
 		cpi_fatalf(_("Function %s was called from within an event listener invocation."), func);
 	}
 	if ((funcmask & CPI_CF_START)
-		&& ctx->env->in_start_func_invocation) {
+		&& (ctx->env->in_start_func_invocation
+			|| (ctx->plugin != NULL && ctx->plugin->parallel_start))) {
 		cpi_fatalf(_("Function %s was called from within a plug-in start function invocation."), func);
 	}
 	if ((funcmask & CPI_CF_STOP)
@@ -590,6 +1048,11 @@ CP_HIDDEN void cpi_check_invocation(cp_context_t *ctx, int funcmask, const char
 	if (ctx->env->in_destroy_func_invocation) {
 		cpi_fatalf(_("Function %s was called from within a plug-in destroy function invocation."), func);
 	}
+#ifdef CP_THREADS
+	if (ctx->env->mutex != NULL) {
+		cpi_set_mutex_function(ctx->env->mutex, func);
+	}
+#endif
 }
 
 
@@ -614,6 +1077,28 @@ CP_HIDDEN void cpi_unlock_context(cp_context_t *context) {
 #endif
 }
 
+CP_HIDDEN void cpi_lock_context_shared(cp_context_t *context) {
+#if defined(CP_THREADS)
+	cpi_lock_mutex_shared(context->env->mutex);
+	
+	// Shared operations may log debug messages, which requires exclusion
+	if (cpi_is_logged(context, CP_LOG_DEBUG)) {
+		cpi_upgrade_mutex(context->env->mutex);
+	}
+#elif !defined(NDEBUG)
+	context->env->locked++;
+#endif
+}
+
+CP_HIDDEN void cpi_unlock_context_shared(cp_context_t *context) {
+#if defined(CP_THREADS)
+	cpi_unlock_mutex_shared(context->env->mutex);
+#elif !defined(NDEBUG)
+	assert(context->env->locked > 0);
+	context->env->locked--;
+#endif
+}
+
 CP_HIDDEN void cpi_wait_context(cp_context_t *context) {
 #if defined(CP_THREADS)
 	cpi_wait_mutex(context->env->mutex);
@@ -631,22 +1116,4 @@ CP_HIDDEN void cpi_signal_context(cp_context_t *context) {
 #endif
 }
 
-
-// Debug helpers
-
-CP_HIDDEN char *cpi_context_owner(cp_context_t *ctx, char *name, size_t size) {
-	if (ctx->plugin != NULL) {
-		/* TRANSLATORS: The context owner (when it is a plug-in) used in some strings.
-		   Search for "context owner" to find these strings. */
-		snprintf(name, size, _("Plug-in %s"), ctx->plugin->plugin->identifier);
-	} else {
-		/* TRANSLATORS: The context owner (when it is the main program) used in some strings.
-		   Search for "context owner" to find these strings. */
-		strncpy(name, _("The main program"), size);
-	}
-	assert(size >= 4);
-	strcpy(name + size - 4, "...");
-	return name;
-}
-
 #endif
@@ -99,6 +99,10 @@ CP_HIDDEN void cpi_unlock_framework(void) {
 }
 
 static void reset(void) {
+#ifdef CP_THREADS
+	cpi_release_task_pool();
+#endif
+	cpi_release_context_registry();
 #ifdef CP_THREADS
 	if (framework_mutex != NULL) {
 		cpi_destroy_mutex(framework_mutex);
@@ -119,6 +123,14 @@ CP_C_API cp_status_t cp_init(void) {
 				status = CP_ERR_RESOURCE;
 				break;
 			}
+#endif
+			if ((status = cpi_init_context_registry()) != CP_OK) {
+				break;
+			}
+#ifdef CP_THREADS
+			if ((status = cpi_init_task_pool()) != CP_OK) {
+				break;
+			}
 #endif
 #ifdef DLOPEN_LIBTOOL
 			if (lt_dlinit()) {
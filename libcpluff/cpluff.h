@@ -96,6 +96,137 @@ extern "C" {
  */
 #define CP_SP_RESTART_ACTIVE 0x08
 
+/**
+ * This flag makes the scan incremental. Plug-in loaders supporting
+ * incremental scans only load the plug-ins that are new or have changed
+ * since the previous scan by the same loader, so unchanged plug-in
+ * collections are not parsed again. Other loaders perform a full scan.
+ */
+#define CP_SP_INCREMENTAL 0x10
+
+/**
+ * Setting this flag causes the plug-ins being upgraded and the plug-ins
+ * importing them, directly or indirectly, to be restarted after all
+ * changes to the plug-ins have been made if they were active before the
+ * upgrade. Other plug-ins are not stopped or restarted unless some of the
+ * flags stopping all plug-ins are also set.
+ */
+#define CP_SP_RESTART_UPGRADED 0x20
+
+/*@}*/
+
+
+/**
+ * @defgroup cInstallFlags Flags for bulk installation
+ * @ingroup cDefines
+ *
+ * These constants can be orred together for the flags
+ * parameter of ::cp_install_plugins.
+ */
+/*@{*/
+
+/**
+ * This flag makes the installation atomic. If any of the plug-ins can
+ * not be installed then none of them is installed.
+ */
+#define CP_IP_ALL_OR_NONE 0x01
+
+/*@}*/
+
+
+/**
+ * @defgroup cRunTaskResults Run task results
+ * @ingroup cDefines
+ *
+ * These constants are returned by @ref cp_run_task_func_t "run tasks"
+ * to tell the framework how to proceed with the task.
+ */
+/*@{*/
+
+/** The task has finished and it is unregistered */
+#define CP_RUN_DONE 0
+
+/** The task has more work to do and it is queued to be run again */
+#define CP_RUN_AGAIN 1
+
+/**
+ * The task is waiting for something to happen and it is not run again
+ * until it is resumed using ::cp_resume_task
+ */
+#define CP_RUN_SUSPEND 2
+
+/*@}*/
+
+
+/**
+ * @defgroup cRunPriorities Run priority classes
+ * @ingroup cDefines
+ *
+ * These constants are the priority classes of run functions and run tasks
+ * registered using ::cp_run_function_prio and ::cp_run_task_prio. The
+ * waiting run functions are executed in a weighted fair order so that each
+ * class with waiting run functions receives run time in proportion to
+ * its weight, regardless of which run functions were queued first. Run
+ * functions within a class are executed in FIFO order. The weights of the
+ * batch, normal and interactive classes are 1, 4 and 16, respectively.
+ */
+/*@{*/
+
+/** Background work which may wait behind other run functions */
+#define CP_RUN_PRIO_BATCH 0
+
+/** The default priority class */
+#define CP_RUN_PRIO_NORMAL 1
+
+/** Latency sensitive work */
+#define CP_RUN_PRIO_INTERACTIVE 2
+
+/*@}*/
+
+
+/**
+ * @defgroup cStateMasks Plug-in state masks
+ * @ingroup cDefines
+ *
+ * These macros construct plug-in state masks for
+ * ::cp_register_plistener_filtered. Masks of several states can be
+ * orred together.
+ */
+/*@{*/
+
+/** The mask selecting transitions into the specified plug-in state */
+#define CP_STATE_MASK(state) (1U << (state))
+
+/** The mask selecting transitions into any plug-in state */
+#define CP_STATE_MASK_ALL (~0U)
+
+/*@}*/
+
+
+/**
+ * @defgroup cChangeTypes Change types
+ * @ingroup cDefines
+ *
+ * These constants are the types of the changes returned by
+ * ::cp_get_changes.
+ */
+/*@{*/
+
+/**
+ * Changes have been discarded from the change feed and all the cached
+ * registry information must be considered stale
+ */
+#define CP_CHANGE_RESET 0
+
+/** A plug-in has been installed or uninstalled */
+#define CP_CHANGE_PLUGINS 1
+
+/** The set of extensions contributed to an extension point has changed */
+#define CP_CHANGE_EXTENSIONS 2
+
+/** The state of a plug-in has changed */
+#define CP_CHANGE_PLUGIN_STATE 3
+
 /*@}*/
 
 
@@ -254,6 +385,89 @@ enum cp_log_severity_t {
 	
 };
 
+/**
+ * @ingroup cEnums
+ * An enumeration of the identifiers of framework log messages delivered to
+ * @ref cp_structured_logger_func_t "structured loggers". The arguments of
+ * each message are passed in the typed fields of ::cp_log_record_t.
+ * Messages without a dedicated identifier are delivered as text.
+ */
+enum cp_log_msg_t {
+	
+	/** A message which is only available as text in @a text */
+	CP_MSG_TEXT,
+	
+	/** A plug-in collection at path @a str was registered */
+	CP_MSG_COLLECTION_REGISTERED,
+	
+	/** A plug-in collection at path @a str was unregistered */
+	CP_MSG_COLLECTION_UNREGISTERED,
+	
+	/** All plug-in collections were unregistered */
+	CP_MSG_COLLECTIONS_UNREGISTERED,
+	
+	/** A plug-in loader at @a address was registered */
+	CP_MSG_LOADER_REGISTERED,
+	
+	/** A plug-in loader at @a address was unregistered */
+	CP_MSG_LOADER_UNREGISTERED,
+	
+	/** The activating plug-in or the main program registered a logger */
+	CP_MSG_LOGGER_REGISTERED,
+	
+	/** The activating plug-in or the main program unregistered a logger */
+	CP_MSG_LOGGER_UNREGISTERED,
+	
+	/** The activating plug-in or the main program registered a plug-in listener */
+	CP_MSG_LISTENER_REGISTERED,
+	
+	/** The activating plug-in or the main program unregistered a plug-in listener */
+	CP_MSG_LISTENER_UNREGISTERED,
+	
+	/** The activating plug-in or the main program registered a batch plug-in listener */
+	CP_MSG_BATCH_LISTENER_REGISTERED,
+	
+	/** The activating plug-in or the main program unregistered a batch plug-in listener */
+	CP_MSG_BATCH_LISTENER_UNREGISTERED,
+	
+	/** An information object at @a address was registered */
+	CP_MSG_INFO_REGISTERED,
+	
+	/** The usage count of an information object at @a address increased to @a count */
+	CP_MSG_INFO_USED,
+	
+	/** The usage count of an information object at @a address decreased to @a count */
+	CP_MSG_INFO_RELEASED,
+	
+	/** An information object at @a address was deallocated */
+	CP_MSG_INFO_DEALLOCATED,
+	
+	/** A plug-in scan is starting */
+	CP_MSG_SCAN_STARTED,
+	
+	/** Plug-ins are being scanned using a plug-in loader at @a address */
+	CP_MSG_SCAN_LOADER,
+	
+	/** A plug-in scan completed successfully */
+	CP_MSG_SCAN_COMPLETED,
+	
+	/** The activating plug-in or the main program resolved symbol @a str defined by plug-in @a plugin_id */
+	CP_MSG_SYMBOL_RESOLVED,
+	
+	/** The activating plug-in or the main program released the symbol at @a address defined by plug-in @a plugin_id */
+	CP_MSG_SYMBOL_RELEASED,
+	
+	/** A dynamic dependency was created from the activating plug-in to plug-in @a plugin_id */
+	CP_MSG_DEPENDENCY_ADDED,
+	
+	/** A dynamic dependency from the activating plug-in to plug-in @a plugin_id was removed */
+	CP_MSG_DEPENDENCY_REMOVED,
+	
+	/** Plug-in @a plugin_id changed state from @a old_state to @a new_state */
+	CP_MSG_PLUGIN_STATE
+	
+};
+
 /*@}*/
 
 
@@ -280,6 +494,39 @@ enum cp_log_severity_t {
  */
 typedef struct cp_context_t cp_context_t;
 
+/**
+ * A compiled configuration element path. Compiled paths are created using
+ * ::cp_compile_cfg_path and they can be used to repeatedly look up
+ * configuration elements or values without parsing the path string again.
+ * A compiled path is not bound to any configuration element tree.
+ */
+typedef struct cp_cfg_path_t cp_cfg_path_t;
+
+/**
+ * A compact configuration element tree. A compact tree holds a copy of a
+ * configuration element tree in a single block of memory, with the
+ * elements stored in preorder and referring to their strings by 32-bit
+ * offsets into a table where each distinct string is stored once. The
+ * elements are identified by their index in preorder, the root element
+ * being zero. Compact trees are created using ::cp_compact_cfg.
+ */
+typedef struct cp_cfg_tree_t cp_cfg_tree_t;
+
+/**
+ * An immutable snapshot of the installed extension points and extensions.
+ * A snapshot remains valid and unchanged until it is released, even if
+ * plug-ins are installed or uninstalled meanwhile. Snapshots are obtained
+ * using ::cp_get_ext_snapshot and released using ::cp_release_ext_snapshot.
+ */
+typedef struct cp_ext_snapshot_t cp_ext_snapshot_t;
+
+/**
+ * A task submitted to the shared framework thread pool. A task handle is
+ * obtained from ::cp_submit_task and it is released by waiting for the
+ * task using ::cp_wait_task.
+ */
+typedef struct cp_task_t cp_task_t;
+
 /*@}*/
 
  /**
@@ -307,9 +554,39 @@ typedef struct cp_cfg_element_t cp_cfg_element_t;
 /** A type for cp_plugin_runtime_t structure. */
 typedef struct cp_plugin_runtime_t cp_plugin_runtime_t;
 
+/** A type for cp_builtin_symbol_t structure. */
+typedef struct cp_builtin_symbol_t cp_builtin_symbol_t;
+
+/** A type for cp_symbol_def_t structure. */
+typedef struct cp_symbol_def_t cp_symbol_def_t;
+
 /** A type for cp_plugin_loader_t structure. */
 typedef struct cp_plugin_loader_t cp_plugin_loader_t;
 
+/** A type for cp_plugin_event_t structure. */
+typedef struct cp_plugin_event_t cp_plugin_event_t;
+
+/** A type for cp_log_record_t structure. */
+typedef struct cp_log_record_t cp_log_record_t;
+
+/** A type for cp_extension_iter_t structure. */
+typedef struct cp_extension_iter_t cp_extension_iter_t;
+
+/** A type for cp_plugin_stats_t structure. */
+typedef struct cp_plugin_stats_t cp_plugin_stats_t;
+
+/** A type for cp_lock_stats_t structure. */
+typedef struct cp_lock_stats_t cp_lock_stats_t;
+
+/** A type for cp_info_usage_t structure. */
+typedef struct cp_info_usage_t cp_info_usage_t;
+
+/** A type for cp_change_t structure. */
+typedef struct cp_change_t cp_change_t;
+
+/** A type for cp_plugin_handle_t structure. */
+typedef struct cp_plugin_handle_t cp_plugin_handle_t;
+
 /** A type for cp_status_t enumeration. */
 typedef enum cp_status_t cp_status_t;
 
@@ -319,6 +596,9 @@ typedef enum cp_plugin_state_t cp_plugin_state_t;
 /** A type for cp_log_severity_t enumeration. */
 typedef enum cp_log_severity_t cp_log_severity_t;
 
+/** A type for cp_log_msg_t enumeration. */
+typedef enum cp_log_msg_t cp_log_msg_t;
+
 /*@}*/
 
 /**
@@ -346,6 +626,42 @@ typedef enum cp_log_severity_t cp_log_severity_t;
  */
 typedef void (*cp_plugin_listener_func_t)(const char *plugin_id, cp_plugin_state_t old_state, cp_plugin_state_t new_state, void *user_data);
 
+/**
+ * A function called by a repository plug-in loader to fetch a file from
+ * a remote plug-in repository, for example over HTTP. The function writes
+ * the contents of the file into the specified local file. The repository
+ * index is fetched using the path "index" and no digest. Other files are
+ * fetched using the path and digest listed in the index, and the function
+ * is responsible for verifying the contents against the digest if
+ * required. The function may be called concurrently from several threads
+ * and it must not call plug-in framework functions. Fetch functions are
+ * registered using ::cp_create_repository_ploader.
+ *
+ * @param path the path of the file in the repository
+ * @param digest the digest of the file or NULL for the index
+ * @param file the local file to be written
+ * @param user_data the user data pointer supplied at loader creation
+ * @return non-zero on success or zero on failure
+ */
+typedef int (*cp_fetch_func_t)(const char *path, const char *digest, const char *file, void *user_data);
+
+/**
+ * An incremental scan function of a plug-in loader. It is called instead of
+ * the @a scan_plugins function of the loader when ::cp_scan_plugins is
+ * called with #CP_SP_INCREMENTAL. Loads and returns plug-in descriptors
+ * only for the plug-ins that are new or have changed since the previous
+ * scan of the specified context by the loader, full or incremental.
+ * Plug-ins that have been removed from the collection are not reported.
+ * The returned array is released in the same way as the array returned
+ * by @a scan_plugins. Incremental scan functions are set using
+ * ::cp_set_ploader_scan_changed.
+ *
+ * @param data plug-in loader data
+ * @param ctx the associated plug-in context
+ * @return pointer to a NULL-terminated array of plug-in information pointers, or NULL on failure
+ */
+typedef cp_plugin_info_t **(*cp_scan_changed_func_t)(void *data, cp_context_t *ctx);
+
 /**
  * A logger function called to log selected plug-in framework messages. The
  * messages may be localized. Plug-in framework API functions must not
@@ -360,6 +676,20 @@ typedef void (*cp_plugin_listener_func_t)(const char *plugin_id, cp_plugin_state
  */
 typedef void (*cp_logger_func_t)(cp_log_severity_t severity, const char *msg, const char *apid, void *user_data);
 
+/**
+ * A structured logger function called to log selected plug-in framework
+ * messages without formatting them. The message is identified by
+ * the message identifier of the record and its arguments are passed
+ * in the typed fields of the record. The record is valid only during the
+ * logger invocation. Otherwise the same rules apply as for
+ * @ref cp_logger_func_t "text loggers". Structured logger functions are
+ * registered using ::cp_register_structured_logger.
+ *
+ * @param record the log record
+ * @param user_data the user data pointer given when the logger was registered
+ */
+typedef void (*cp_structured_logger_func_t)(const cp_log_record_t *record, void *user_data);
+
 /**
  * A fatal error handler for handling unrecoverable errors. If the error
  * handler returns then the framework aborts the program. Plug-in framework
@@ -383,6 +713,100 @@ typedef void (*cp_fatal_error_func_t)(const char *msg);
  */
 typedef int (*cp_run_func_t)(void *plugin_data);
 
+/**
+ * A run task registered by a plug-in to perform work. A run task is like
+ * a @ref cp_run_func_t "run function" except that it receives its own task
+ * data pointer and that it may suspend itself until it is explicitly
+ * resumed. A suspended task does not occupy the run queue. Run tasks are
+ * registered using ::cp_run_task.
+ *
+ * @param plugin_data the plug-in instance data pointer
+ * @param task_data the task data pointer supplied at registration
+ * @return one of the @ref cRunTaskResults "run task results"
+ */
+typedef int (*cp_run_task_func_t)(void *plugin_data, void *task_data);
+
+/**
+ * A function called to release the data of an unfinished run task when the
+ * task is discarded because the registering plug-in is being stopped.
+ * The function is called with the plug-in context locked and it must not
+ * call framework functions other than those releasing information or
+ * unregistering listeners.
+ *
+ * @param task_data the task data pointer supplied at registration
+ */
+typedef void (*cp_discard_task_func_t)(void *task_data);
+
+/**
+ * A function executed by a thread of the shared framework thread pool.
+ * Pool tasks are submitted using ::cp_submit_task. A pool task may use
+ * framework functions like any other thread but it must not wait for the
+ * completion of the tasks of its own plug-in using ::cp_wait_tasks, nor
+ * stop its own plug-in.
+ *
+ * @param arg the argument supplied at submission
+ */
+typedef void (*cp_task_func_t)(void *arg);
+
+/**
+ * A fork handler called in a new worker process that was forked from a
+ * process with an initialized plug-in context. Plug-ins use fork handlers
+ * to re-create per-process resources, such as threads, random number
+ * generator state or connections that must not be shared with the parent
+ * process. Fork handlers are called with the plug-in context locked and
+ * the same restrictions as for
+ * @ref cp_plugin_listener_func_t "plug-in listeners" apply. Fork handlers
+ * are registered using ::cp_register_fork_handler.
+ *
+ * @param user_data the user data pointer supplied at registration
+ */
+typedef void (*cp_fork_handler_func_t)(void *user_data);
+
+/**
+ * A listener function called asynchronously to deliver a batch of plug-in
+ * state changes. Batch listeners are invoked by a dedicated event
+ * dispatcher thread without holding the plug-in context lock, so slow
+ * listeners do not delay plug-in management operations. The events of a
+ * batch are in the order the state changes occurred. The event data is
+ * valid only during the listener invocation. Invocations of batch
+ * listeners registered with the same context are serialized.
+ * Batch listeners may call plug-in information functions but the same
+ * restrictions as for @ref cp_plugin_listener_func_t "plug-in listeners"
+ * apply to other framework functions. Batch listener functions are
+ * registered using ::cp_register_batch_plistener.
+ * 
+ * @param events the plug-in events in the order of occurrence
+ * @param num_events the number of events
+ * @param user_data the user data pointer supplied at listener registration
+ */
+typedef void (*cp_batch_plistener_func_t)(const cp_plugin_event_t *events, unsigned int num_events, void *user_data);
+
+/**
+ * A visitor function called for each installed plug-in by
+ * ::cp_for_each_plugin. The function is called while the plug-in context
+ * is locked for reading, so it must return promptly. It may call functions
+ * returning information, such as ::cp_get_plugin_state and
+ * ::cp_get_plugin_info, but it must not call framework functions changing
+ * the same plug-in context. The plug-in information is borrowed and it is
+ * valid only during the invocation.
+ * 
+ * @param plugin the plug-in information
+ * @param user_data the user data pointer supplied to ::cp_for_each_plugin
+ * @return zero to continue the iteration or non-zero to stop it
+ */
+typedef int (*cp_plugin_visitor_func_t)(const cp_plugin_info_t *plugin, void *user_data);
+
+/**
+ * A visitor function called for each installed extension by
+ * ::cp_for_each_extension. The same restrictions as for
+ * @ref cp_plugin_visitor_func_t "plug-in visitors" apply.
+ * 
+ * @param extension the extension information
+ * @param user_data the user data pointer supplied to ::cp_for_each_extension
+ * @return zero to continue the iteration or non-zero to stop it
+ */
+typedef int (*cp_extension_visitor_func_t)(const cp_extension_t *extension, void *user_data);
+
 /*@}*/
 
 
@@ -653,7 +1077,10 @@ struct cp_extension_t {
 	 * Extension configuration starting with the extension element.
 	 * This includes extension configuration information as a tree of
 	 * configuration elements. These correspond to the @a extension
-	 * element and its contents in a plug-in descriptor.
+	 * element and its contents in a plug-in descriptor. If the
+	 * configuration is parsed lazily, see ::cp_set_lazy_ext_configuration,
+	 * this is NULL until the extension is accessed using the extension
+	 * information functions or ::cp_get_ext_configuration.
 	 */
 	cp_cfg_element_t *configuration;
 };
@@ -818,6 +1245,59 @@ struct cp_plugin_runtime_t {
 
 };
 
+/**
+ * @ingroup cStructs
+ * An entry in the static symbol table of a built-in plug-in. Built-in
+ * plug-ins are linked into the executable and they are installed using
+ * ::cp_install_builtin_plugin. The symbols in the table can be resolved
+ * using ::cp_resolve_symbol like the global symbols of a runtime library.
+ * The table is terminated by an entry with a NULL name.
+ */
+struct cp_builtin_symbol_t {
+
+	/** The name of the symbol or NULL for the terminating entry */
+	const char *name;
+
+	/** The address of the symbol */
+	void *symbol;
+
+};
+
+/**
+ * @ingroup cStructs
+ * An entry in a static symbol table defined by a plug-in using
+ * ::cp_define_symbols. The symbols can be resolved using
+ * ::cp_resolve_symbol.
+ *
+ * A table may be laid out as a minimal perfect hash table so that a
+ * symbol is found without searching the table. The C++ helper
+ * cpluff::make_symbol_table in cpluffxx/symbols.h generates such tables
+ * at compile time when compiled as C++14 or later. The hash of a name
+ * with a seed is the 32-bit FNV-1a hash of the four bytes of the seed,
+ * least significant first, followed by the characters of the name. The
+ * name is hashed with seed 0 to select a bucket,
+ * the displacement of the bucket is the disp field of the entry at
+ * that index minus one, and the name is hashed again with the
+ * displacement as the seed to select the entry. In a table that is not
+ * hashed the displacement of every entry is zero and the table is
+ * searched sequentially.
+ */
+struct cp_symbol_def_t {
+
+	/** The name of the symbol */
+	const char *name;
+
+	/** The address of the symbol */
+	void *symbol;
+
+	/**
+	 * The displacement of the hash bucket with the index of this entry plus
+	 * one, or zero for all entries if the table is not hashed
+	 */
+	unsigned int disp;
+
+};
+
 /**
  * @ingroup cStructs
  * A plug-in loader instance. Plug-in loaders are responsible for
@@ -901,58 +1381,265 @@ struct cp_plugin_loader_t {
 
 };
 
-/*@}*/
-
-
-/* ------------------------------------------------------------------------
- * Function declarations
- * ----------------------------------------------------------------------*/
-
 /**
- * @defgroup cFuncs Functions
- *
- * C API functions. The C-Pluff C API functions and
- * any data exposed by them are generally thread-safe if the library has been
- * compiled with multi-threading support. The
- * @ref cFuncsInit "framework initialization functions"
- * are exceptions, they are not thread-safe.
+ * @ingroup cStructs
+ * A log record delivered to
+ * @ref cp_structured_logger_func_t "structured loggers". The fields not
+ * used by the message are zero or NULL.
  */
+struct cp_log_record_t {
+	
+	/** The severity of the message */
+	cp_log_severity_t severity;
+	
+	/** The message identifier */
+	cp_log_msg_t msg_id;
+	
+	/** The identifier of the activating plug-in or NULL for the main program */
+	const char *apid;
+	
+	/** The plug-in identifier argument */
+	const char *plugin_id;
+	
+	/** The string argument */
+	const char *str;
+	
+	/** The address argument */
+	const void *address;
+	
+	/** The count argument */
+	int count;
+	
+	/** The old plug-in state for plug-in state changes */
+	cp_plugin_state_t old_state;
+	
+	/** The new plug-in state for plug-in state changes */
+	cp_plugin_state_t new_state;
+	
+	/** The possibly localized message text for @ref CP_MSG_TEXT, otherwise NULL */
+	const char *text;
+	
+};
 
 /**
- * @defgroup cFuncsFrameworkInfo Framework information
- * @ingroup cFuncs
- *
- * These functions can be used to query runtime information about the
- * linked in C-Pluff implementation. They may be used by the main program or
- * by a plug-in runtime.
+ * @ingroup cStructs
+ * A plug-in state change delivered to
+ * @ref cp_batch_plistener_func_t "batch plug-in listeners".
  */
-/*@{*/
+struct cp_plugin_event_t {
+	
+	/** The identifier of the affected plug-in */
+	const char *plugin_id;
+	
+	/** The old plug-in state */
+	cp_plugin_state_t old_state;
+	
+	/** The new plug-in state */
+	cp_plugin_state_t new_state;
+	
+};
 
 /**
- * Returns the release version string of the linked in C-Pluff
- * implementation.
- * 
- * @return the C-Pluff release version string
+ * @ingroup cStructs
+ * A cursor over the extensions installed for an extension point, used
+ * with ::cp_begin_extensions, ::cp_next_extension and ::cp_end_extensions.
+ * The contents of the structure are private to the framework.
  */
-CP_C_API const char *cp_get_version(void) CP_GCC_PURE;
+struct cp_extension_iter_t {
+	
+	/** @private The plug-in context */
+	cp_context_t *context;
+	
+	/** @private The extensions being iterated, or NULL */
+	void *list;
+	
+	/** @private The index of the next extension slot */
+	int index;
+	
+};
 
 /**
- * Returns the canonical host type associated with the linked in C-Pluff implementation.
- * A multi-platform installation manager could use this information to
- * determine what plug-in versions to install.
- * 
- * @return the canonical host type
+ * @ingroup cStructs
+ * Timing and memory statistics of a plug-in, returned by
+ * ::cp_get_plugin_stats. The times are measured using a monotonic clock,
+ * in microseconds, and they accumulate over the lifetime of the installed
+ * plug-in so that repeated starts and stops add up.
  */
-CP_C_API const char *cp_get_host_type(void) CP_GCC_PURE;
-
-/*@}*/
+struct cp_plugin_stats_t {
+	
+	/** The time taken to load the plug-in descriptor */
+	unsigned long long parse_usecs;
+	
+	/** The time taken to open the plug-in runtime library */
+	unsigned long long load_usecs;
+	
+	/** The time spent in the @ref cp_plugin_runtime_t::create "create" function */
+	unsigned long long create_usecs;
+	
+	/** The time spent in the @ref cp_plugin_runtime_t::start "start" function */
+	unsigned long long start_usecs;
+	
+	/** The time spent in the @ref cp_plugin_runtime_t::stop "stop" function */
+	unsigned long long stop_usecs;
+	
+	/** The time spent in the @ref cp_plugin_runtime_t::destroy "destroy" function */
+	unsigned long long destroy_usecs;
+	
+	/** The time spent in run functions and run tasks */
+	unsigned long long run_usecs;
+	
+	/** The number of times the plug-in has been started */
+	unsigned long num_starts;
+	
+	/** The number of run function and run task invocations */
+	unsigned long run_calls;
+	
+	/**
+	 * The heap memory currently held by the plug-in information, including
+	 * parsed extension configuration, in bytes. Content shared from a
+	 * memory mapped plug-in image is not included.
+	 */
+	unsigned long descriptor_bytes;
+	
+};
 
+/** The number of buckets in the histograms of ::cp_lock_stats_t */
+#define CP_LOCK_HISTOGRAM_SIZE 20
 
 /**
- * @defgroup cFuncsInit Framework initialization
- * @ingroup cFuncs
- *
- * These functions are used for framework initialization.
+ * @ingroup cStructs
+ * Lock statistics of a plug-in context for one API function, returned by
+ * ::cp_get_lock_stats. The times are in microseconds. Histogram bucket 0
+ * counts durations shorter than one microsecond, bucket @a i counts
+ * durations of at least 2^(i-1) but less than 2^i microseconds and the
+ * last bucket counts all the longer durations.
+ */
+struct cp_lock_stats_t {
+	
+	/**
+	 * The name of the API function which acquired the lock, or NULL for
+	 * shared acquisitions and acquisitions not attributed to an API function
+	 */
+	const char *function;
+	
+	/** The number of acquisitions */
+	unsigned long acquisitions;
+	
+	/** The number of acquisitions which had to wait for another thread */
+	unsigned long contended;
+	
+	/** The total time spent waiting for the lock */
+	unsigned long long wait_usecs;
+	
+	/** The total time the lock was held exclusively */
+	unsigned long long hold_usecs;
+	
+	/** The longest time the lock was held exclusively */
+	unsigned long long max_hold_usecs;
+	
+	/** The histogram of the wait times */
+	unsigned long wait_histogram[CP_LOCK_HISTOGRAM_SIZE];
+	
+	/** The histogram of the exclusive hold times */
+	unsigned long hold_histogram[CP_LOCK_HISTOGRAM_SIZE];
+	
+};
+
+/**
+ * @ingroup cStructs
+ * Outstanding reference counted information objects of a plug-in context
+ * registered by one owner, returned by ::cp_get_info_usage. Objects
+ * registered by the main program, or by plug-ins which have since been
+ * uninstalled, have a NULL owner.
+ */
+struct cp_info_usage_t {
+	
+	/**
+	 * The identifier of the plug-in whose calls obtained the objects,
+	 * or NULL for the main program
+	 */
+	char *plugin_id;
+	
+	/** The number of objects not yet released */
+	unsigned int num_infos;
+	
+	/** The heap memory held by the objects, in bytes */
+	unsigned long bytes;
+	
+};
+
+/**
+ * @ingroup cStructs
+ * A change of the plug-in registry, returned by ::cp_get_changes.
+ */
+struct cp_change_t {
+
+	/** The generation of the registry after the change */
+	unsigned long generation;
+
+	/** The @ref cChangeTypes "type of the change" */
+	int type;
+
+	/**
+	 * The identifier of the affected plug-in or extension point, or NULL
+	 * for @ref CP_CHANGE_RESET
+	 */
+	char *id;
+
+};
+
+/*@}*/
+
+
+/* ------------------------------------------------------------------------
+ * Function declarations
+ * ----------------------------------------------------------------------*/
+
+/**
+ * @defgroup cFuncs Functions
+ *
+ * C API functions. The C-Pluff C API functions and
+ * any data exposed by them are generally thread-safe if the library has been
+ * compiled with multi-threading support. The
+ * @ref cFuncsInit "framework initialization functions"
+ * are exceptions, they are not thread-safe.
+ */
+
+/**
+ * @defgroup cFuncsFrameworkInfo Framework information
+ * @ingroup cFuncs
+ *
+ * These functions can be used to query runtime information about the
+ * linked in C-Pluff implementation. They may be used by the main program or
+ * by a plug-in runtime.
+ */
+/*@{*/
+
+/**
+ * Returns the release version string of the linked in C-Pluff
+ * implementation.
+ * 
+ * @return the C-Pluff release version string
+ */
+CP_C_API const char *cp_get_version(void) CP_GCC_PURE;
+
+/**
+ * Returns the canonical host type associated with the linked in C-Pluff implementation.
+ * A multi-platform installation manager could use this information to
+ * determine what plug-in versions to install.
+ * 
+ * @return the canonical host type
+ */
+CP_C_API const char *cp_get_host_type(void) CP_GCC_PURE;
+
+/*@}*/
+
+
+/**
+ * @defgroup cFuncsInit Framework initialization
+ * @ingroup cFuncs
+ *
+ * These functions are used for framework initialization.
  * They are intended to be used by the main program. These functions are
  * not thread safe.
  */
@@ -1032,6 +1719,27 @@ CP_C_API void cp_destroy(void);
  */
 CP_C_API cp_context_t * cp_create_context(cp_status_t *status);
 
+/**
+ * Creates a new plug-in context with the same plug-ins installed as in the
+ * specified template context. The plug-ins installed in the template are
+ * serialized into an image in memory once and the image is shared by all
+ * the contexts created from the template, so creating many identical
+ * contexts requires neither scanning nor parsing descriptors. The image is
+ * rebuilt when the set of plug-ins installed in the template changes.
+ *
+ * The plug-ins are installed into the new context but not started and
+ * they have no associated plug-in loader. The descriptor settings and
+ * the lazy extension configuration setting are copied from the template,
+ * whereas plug-in collections, plug-in loaders, listeners and loggers are
+ * not. The contexts are otherwise independent, so installing, uninstalling
+ * or starting plug-ins in one of them does not affect the others.
+ *
+ * @param tmpl the template context
+ * @param status pointer to the location where status code is to be stored, or NULL
+ * @return the newly created plugin context, or NULL on failure
+ */
+CP_C_API cp_context_t * cp_create_context_from(cp_context_t *tmpl, cp_status_t *status) CP_GCC_NONNULL(1);
+
 /**
  * Changes the file name in the plug-in the plug-in descriptor is loaded from.
  * The default name is "plugin.xml"
@@ -1041,6 +1749,117 @@ CP_C_API cp_context_t * cp_create_context(cp_status_t *status);
  */
 CP_C_API void cp_set_plugin_descriptor_name(cp_context_t *ctx, const char *name);
 
+/**
+ * Enables or disables the persistent plug-in descriptor cache. When enabled,
+ * plug-in descriptors parsed by ::cp_load_plugin_descriptor, and thus by
+ * plug-in scanning, are stored in a compact binary form in the specified
+ * directory. Later loads of the same descriptor file use the cached form
+ * instead of parsing XML as long as the size and modification time of the
+ * descriptor file have not changed. The directory must exist and it should
+ * be writable by the process. Stale or invalid cache files are ignored and
+ * replaced. Changes to a descriptor within the modification time resolution
+ * of the file system may go unnoticed if the size of the descriptor remains
+ * the same. The cache is not used if the framework was built without support
+ * for stat. By default the cache is disabled.
+ *
+ * @param ctx the plug-in context
+ * @param dir the cache directory, or NULL to disable the cache
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if insufficient memory
+ */
+CP_C_API cp_status_t cp_set_descriptor_cache_dir(cp_context_t *ctx, const char *dir) CP_GCC_NONNULL(1);
+
+/**
+ * Enables or disables lazy parsing of extension configuration. When
+ * enabled, plug-in descriptors loaded by ::cp_load_plugin_descriptor, and
+ * thus by plug-in scanning, only record the location of each extension
+ * in the descriptor file and the configuration of an extension is parsed
+ * when it is first accessed using ::cp_get_extensions_info,
+ * ::cp_for_each_extension, ::cp_next_extension,
+ * ::cp_get_snapshot_extensions or ::cp_get_ext_configuration. Until then
+ * the configuration of the extension is NULL in the plug-in information.
+ * This saves memory when most of the extension configuration is never
+ * used. If the descriptor file has been modified in the meantime then
+ * the configuration can not be parsed and it remains NULL. Descriptors
+ * having a document type declaration or a UTF-16 encoding are parsed
+ * eagerly. Lazily parsed descriptors do not use the descriptor cache.
+ * Lazy parsing is not available if the framework was built without
+ * support for stat. By default extension configuration is parsed eagerly.
+ *
+ * @param ctx the plug-in context
+ * @param lazy whether to parse extension configuration lazily
+ */
+CP_C_API void cp_set_lazy_ext_configuration(cp_context_t *ctx, int lazy) CP_GCC_NONNULL(1);
+
+/**
+ * Enables or disables preloading of plug-in runtime libraries. When
+ * enabled, ::cp_resolve_plugins, and thus ::cp_start_plugins_parallel
+ * when starting all plug-ins, first checks the dependencies of all the
+ * plug-ins being resolved and then opens their runtime libraries using
+ * up to the specified number of threads. A runtime library is opened
+ * only after the runtime libraries of the plug-ins it imports have been
+ * opened, so that their global symbols are visible to it. If prebinding
+ * is enabled then the symbols of the runtime libraries are bound when
+ * they are opened, instead of on first use, and the runtime function
+ * symbols are looked up by the preloading threads. The time taken to
+ * open each runtime library is logged as a debug message. Plug-ins
+ * resolved one by one, for example by ::cp_start_plugin, are not
+ * affected. Threads are not used if the framework was built without
+ * multi-threading support. By default preloading is disabled.
+ *
+ * @param ctx the plug-in context
+ * @param num_threads the maximum number of threads opening runtime libraries, or 0 to disable preloading
+ * @param prebind whether to bind the symbols of the runtime libraries when they are opened
+ */
+CP_C_API void cp_set_runtime_preloading(cp_context_t *ctx, unsigned int num_threads, int prebind) CP_GCC_NONNULL(1);
+
+/**
+ * Enables or disables lazy loading of plug-in runtime libraries. When
+ * enabled, plug-ins are resolved by checking only the dependencies and
+ * the C-Pluff version requirement declared in the plug-in descriptor. The
+ * plug-in files are resolved and the runtime library is opened when the
+ * plug-in is started, either explicitly or as a dependency, or when a
+ * symbol is resolved from it using ::cp_resolve_symbol. A plug-in whose
+ * runtime library can not be loaded then remains resolved and fails to
+ * start. Runtime libraries are not preloaded in this mode, see
+ * ::cp_set_runtime_preloading. Plug-ins already resolved keep their
+ * runtime libraries. By default runtime libraries are loaded when the
+ * plug-ins are resolved.
+ *
+ * @param ctx the plug-in context
+ * @param lazy whether to load runtime libraries lazily
+ */
+CP_C_API void cp_set_lazy_runtime_loading(cp_context_t *ctx, int lazy) CP_GCC_NONNULL(1);
+
+/**
+ * Enables or disables closing of plug-in runtime libraries when plug-ins
+ * are unresolved. When disabled, the runtime libraries remain loaded until
+ * the process exits, which saves the cost of running library destructors
+ * and unmapping the libraries when the process is about to exit anyway.
+ * Disabling this is not recommended if plug-ins are upgraded at run time
+ * because a later version of a runtime library with the same path would
+ * not be loaded. By default runtime libraries are closed.
+ *
+ * @param ctx the plug-in context
+ * @param unload whether to close runtime libraries of unresolved plug-ins
+ */
+CP_C_API void cp_set_runtime_library_unloading(cp_context_t *ctx, int unload) CP_GCC_NONNULL(1);
+
+/**
+ * Enables or disables lock profiling for the specified plug-in context.
+ * While enabled, each acquisition of the context lock records the time
+ * waited for the lock and the time it was held, attributed to the API
+ * function which acquired it. The statistics are available using
+ * ::cp_get_lock_stats and they are reset when profiling is enabled.
+ * Profiling is disabled by default and costs little when disabled. The
+ * setting applies to all contexts sharing the plug-in environment.
+ *
+ * @param ctx the plug-in context
+ * @param enabled whether to profile the context lock
+ * @return @ref CP_OK (zero) on success, @ref CP_ERR_RESOURCE if there is
+ * 	not enough memory or if the framework was built without threads
+ */
+CP_C_API cp_status_t cp_set_lock_profiling(cp_context_t *ctx, int enabled) CP_GCC_NONNULL(1);
+
 /**
  * Changes the XML root element's name in plug-in descriptor.
  * This also changes the attribute name to be used in the "import" element.
@@ -1068,6 +1887,11 @@ CP_C_API void cp_destroy_context(cp_context_t *ctx) CP_GCC_NONNULL(1);
  * collection can be unregistered using ::cp_unregister_pcollection or
  * ::cp_unregister_pcollections.
  *
+ * The collection may also be a plug-in bundle, that is a plug-in image
+ * file written using ::cp_write_plugin_image. All the plug-ins of a bundle
+ * are then loaded with a single read of the file and without parsing
+ * any plug-in descriptors.
+ *
  * This is equivalent to having registered a local plug-in loader and
  * registering a plug-in directory with it.
  *
@@ -1138,6 +1962,22 @@ CP_C_API void cp_unregister_ploader(cp_context_t *ctx, cp_plugin_loader_t *loade
  */
 CP_C_API void cp_unregister_ploaders(cp_context_t *ctx) CP_GCC_NONNULL(1);
 
+/**
+ * Sets the @ref cp_scan_changed_func_t "incremental scan function" of a
+ * plug-in loader. It is kept outside the loader structure, so that loaders
+ * written for earlier versions of the framework remain compatible. Loaders
+ * without an incremental scan function are scanned fully on incremental
+ * scans as well. The setting applies to all contexts using the loader.
+ * It must be removed by passing NULL before the loader structure is
+ * deallocated. The plug-in loaders provided by the framework set their
+ * incremental scan functions themselves.
+ *
+ * @param loader the plug-in loader
+ * @param scan_changed the incremental scan function or NULL to remove it
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if insufficient memory
+ */
+CP_C_API cp_status_t cp_set_ploader_scan_changed(cp_plugin_loader_t *loader, cp_scan_changed_func_t scan_changed) CP_GCC_NONNULL(1);
+
 /*@}*/
 
 
@@ -1168,6 +2008,26 @@ CP_C_API void cp_unregister_ploaders(cp_context_t *ctx) CP_GCC_NONNULL(1);
  */
 CP_C_API cp_status_t cp_register_logger(cp_context_t *ctx, cp_logger_func_t logger, void *user_data, cp_log_severity_t min_severity) CP_GCC_NONNULL(1, 2);
 
+/**
+ * Registers a logger which only receives the messages related to the
+ * specified plug-in or updates the settings of a registered logger.
+ * The logger receives the selected messages activated by the plug-in and
+ * the selected framework messages concerning the plug-in, such as its
+ * state changes. Filtered loggers do not make the framework format
+ * messages related to other plug-ins, so debug logging can be enabled for
+ * a single plug-in at little cost. Otherwise this function works like
+ * ::cp_register_logger and an existing registration of the same logger
+ * function is updated to use the filter.
+ *
+ * @param ctx the plug-in context to log
+ * @param logger the logger function to be called
+ * @param user_data the user data pointer passed to the logger
+ * @param min_severity the minimum severity of messages passed to logger
+ * @param plugin_id the identifier of the plug-in whose messages are selected
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if insufficient memory
+ */
+CP_C_API cp_status_t cp_register_plugin_logger(cp_context_t *ctx, cp_logger_func_t logger, void *user_data, cp_log_severity_t min_severity, const char *plugin_id) CP_GCC_NONNULL(1, 2, 5);
+
 /**
  * Removes a logger registration.
  *
@@ -1176,6 +2036,33 @@ CP_C_API cp_status_t cp_register_logger(cp_context_t *ctx, cp_logger_func_t logg
  */
 CP_C_API void cp_unregister_logger(cp_context_t *ctx, cp_logger_func_t logger) CP_GCC_NONNULL(1, 2);
 
+/**
+ * Registers a structured logger with a plug-in context or updates the
+ * settings of a registered structured logger. This function is like
+ * ::cp_register_logger except that the logger receives
+ * @ref cp_log_record_t "log records". Framework messages with a
+ * @ref cp_log_msg_t "message identifier" are passed to structured loggers
+ * without formatting, and their text is only formatted if a text logger
+ * is interested in the message. Other messages are delivered as text.
+ * If asynchronous logging is enabled, all messages are delivered as text.
+ * The logger can be unregistered using ::cp_unregister_structured_logger.
+ *
+ * @param ctx the plug-in context to log
+ * @param logger the structured logger function to be called
+ * @param user_data the user data pointer passed to the logger
+ * @param min_severity the minimum severity of messages passed to logger
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if insufficient memory
+ */
+CP_C_API cp_status_t cp_register_structured_logger(cp_context_t *ctx, cp_structured_logger_func_t logger, void *user_data, cp_log_severity_t min_severity) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Removes a structured logger registration.
+ *
+ * @param ctx the plug-in context
+ * @param logger the structured logger function to be unregistered
+ */
+CP_C_API void cp_unregister_structured_logger(cp_context_t *ctx, cp_structured_logger_func_t logger) CP_GCC_NONNULL(1, 2);
+
 /**
  * Emits a new log message.
  * 
@@ -1194,6 +2081,25 @@ CP_C_API void cp_log(cp_context_t *ctx, cp_log_severity_t severity, const char *
  */
 CP_C_API int cp_is_logged(cp_context_t *ctx, cp_log_severity_t severity) CP_GCC_NONNULL(1);
 
+/**
+ * Enables or disables asynchronous delivery of log messages. When enabled,
+ * log messages are formatted and appended to a bounded queue, truncated
+ * to 255 characters if necessary, and a dedicated thread delivers them to
+ * the registered loggers. Logging then never blocks on slow loggers. If
+ * the queue is full, messages are dropped and the number of dropped
+ * messages is later reported to the loggers as a warning. Logger
+ * invocations remain serialized but they may occur after the logging
+ * function has returned. Setting the queue size to zero delivers the queued
+ * messages and restores synchronous logging. Queued messages are also
+ * delivered when the context is destroyed. If the framework has been built
+ * without multi-threading support, logging stays synchronous.
+ * 
+ * @param ctx the plug-in context
+ * @param queue_size the maximum number of queued messages, or zero for synchronous logging
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if insufficient system resources
+ */
+CP_C_API cp_status_t cp_set_async_logging(cp_context_t *ctx, unsigned int queue_size) CP_GCC_NONNULL(1);
+
 /*@}*/
 
 
@@ -1233,7 +2139,9 @@ CP_C_API cp_plugin_info_t * cp_load_plugin_descriptor(cp_context_t *ctx, const c
  * is invalid then NULL is returned. The caller must release the returned
  * information by calling ::cp_release_info when it does not
  * need the information anymore, typically after installing the plug-in.
- * The returned plug-in information must not be modified.
+ * The returned plug-in information must not be modified. The buffer is
+ * parsed in place without copying it and it is not needed after this
+ * function has returned.
  * 
  * @param ctx the plug-in context
  * @param buffer the buffer containing the plug-in descriptor.
@@ -1261,6 +2169,117 @@ CP_C_API cp_plugin_info_t * cp_load_plugin_descriptor_from_memory(cp_context_t *
  */
 CP_C_API cp_status_t cp_install_plugin(cp_context_t *ctx, cp_plugin_info_t *pi) CP_GCC_NONNULL(1, 2);
 
+/**
+ * Installs a built-in plug-in that is statically linked into the
+ * executable. The plug-in descriptor is parsed from the specified buffer
+ * and the plug-in is installed like using ::cp_install_plugin. A possible
+ * runtime library declared in the descriptor is ignored. Instead, the
+ * plug-in uses the specified runtime functions and static symbol table,
+ * so resolving or starting the plug-in involves no file system access
+ * or dynamic linking. The runtime functions and the symbol table must
+ * remain valid while the plug-in is installed.
+ *
+ * @param ctx the plug-in context
+ * @param buffer the buffer containing the plug-in descriptor
+ * @param buffer_len the length of the buffer
+ * @param runtime the plug-in runtime functions or NULL if the plug-in has no runtime
+ * @param symbols the static symbol table terminated by an entry with a NULL name, or NULL for none
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+CP_C_API cp_status_t cp_install_builtin_plugin(cp_context_t *ctx, const char *buffer, unsigned int buffer_len, cp_plugin_runtime_t *runtime, const cp_builtin_symbol_t *symbols) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Installs several plug-ins to the specified plug-in context at once.
+ * Each plug-in is installed as if using ::cp_install_plugin but conflicts
+ * are checked for all the plug-ins, including conflicts between the
+ * specified plug-ins, before any of them is installed. The plug-in
+ * listeners are notified of the installed plug-ins after all of them have
+ * been installed and the batch listeners receive the installation events
+ * as a single batch. This is considerably faster than installing a large
+ * number of plug-ins one at a time.
+ * 
+ * By default the plug-ins which can not be installed are skipped and the
+ * status of the first failure is returned. If #CP_IP_ALL_OR_NONE is
+ * set then no plug-in is installed unless all of them can be installed.
+ *
+ * @param ctx the plug-in context
+ * @param pis the plug-in information structures
+ * @param num the number of plug-ins
+ * @param flags the bitmask of @ref cInstallFlags "installation flags"
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+CP_C_API cp_status_t cp_install_plugins(cp_context_t *ctx, cp_plugin_info_t * const *pis, int num, int flags) CP_GCC_NONNULL(1);
+
+/**
+ * Writes the information of all the plug-ins installed in the specified
+ * plug-in context into a plug-in image file. A plug-in image can be
+ * installed by other processes using ::cp_install_plugin_image without
+ * parsing the plug-in descriptors. Lazily parsed extension configuration
+ * is parsed before writing the image. The image is written into a
+ * temporary file which then replaces any existing image file, so
+ * processes using the previous image are not affected.
+ * 
+ * The image also records the order in which the currently active
+ * plug-ins were started and the state of the plug-in descriptor files,
+ * so that it can be used as a snapshot of a started plug-in context
+ * with ::cp_restore_plugin_image.
+ * 
+ * A plug-in image is specific to the platform and the build of the
+ * framework that wrote it.
+ *
+ * @param ctx the plug-in context
+ * @param file the image file to be written
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+CP_C_API cp_status_t cp_write_plugin_image(cp_context_t *ctx, const char *file) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Installs the plug-ins contained in a plug-in image written using
+ * ::cp_write_plugin_image. Where supported, the image is mapped into
+ * memory privately and the plug-in information refers to the mapped
+ * image instead of copies of its content. Only the structures containing
+ * pointers are modified when the image is mapped, so the pages holding
+ * strings remain shared by all the processes using the same image.
+ * The image is unmapped when the information of all its plug-ins has
+ * been released. The image file must not be modified in place while it
+ * is in use.
+ * 
+ * Plug-ins are installed as if using ::cp_install_plugin. If some of the
+ * plug-ins can not be installed, the remaining plug-ins are still
+ * installed and the status of the first failure is returned. The
+ * installed plug-ins have no associated plug-in loader.
+ *
+ * @param ctx the plug-in context
+ * @param file the image file
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+CP_C_API cp_status_t cp_install_plugin_image(cp_context_t *ctx, const char *file) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Restores the state of a plug-in context saved using
+ * ::cp_write_plugin_image. If the plug-in collections have not changed
+ * since the image was written, all the plug-ins in the image are
+ * installed and the plug-ins that were active are started in the
+ * recorded order, so that scanning, version selection and descriptor
+ * parsing are skipped and each plug-in finds its imports already active.
+ * A plug-in is considered changed if its descriptor file or the directory
+ * containing the plug-in has been modified, which includes adding new
+ * plug-ins into the same collection. Nothing is installed if any of the
+ * plug-ins has changed or can not be installed, in which case the caller
+ * should fall back to scanning the plug-ins and then write a new image.
+ * 
+ * The installed plug-ins have no associated plug-in loader. If some of
+ * the plug-ins fail to start, the remaining plug-ins are still started
+ * and the status of the first failure is returned.
+ *
+ * @param ctx the plug-in context
+ * @param file the image file
+ * @return @ref CP_OK (zero) on success, @ref CP_ERR_CONFLICT if the
+ *	image is out of date or conflicts with the installed plug-ins, or
+ *	another error code on failure
+ */
+CP_C_API cp_status_t cp_restore_plugin_image(cp_context_t *ctx, const char *file) CP_GCC_NONNULL(1, 2);
+
 /**
  * Scans for plug-ins in the registered plug-in directories, installing
  * new plug-ins and upgrading installed plug-ins. This function can be used to
@@ -1275,6 +2294,16 @@ CP_C_API cp_status_t cp_install_plugin(cp_context_t *ctx, cp_plugin_info_t *pi)
  * all active plug-ins are stopped if any plug-ins are to be installed or
  * upgraded. Finally, if #CP_SP_RESTART_ACTIVE is set all currently active
  * plug-ins will be restarted after the changes (if they were stopped).
+ * Upgrading a plug-in stops only the plug-ins depending on it, so
+ * #CP_SP_RESTART_UPGRADED can be used instead of #CP_SP_RESTART_ACTIVE
+ * to restart only the affected plug-ins without copying the state of all
+ * plug-ins. The affected plug-ins are restarted in their original start
+ * order.
+ * If #CP_SP_INCREMENTAL is set then loaders capable of it, see
+ * ::cp_set_ploader_scan_changed, only load the plug-ins which have changed
+ * since their previous scan. A plug-in that
+ * was uninstalled explicitly is then not installed again unless its
+ * descriptor changes or a full scan is performed.
  * 
  * When removing plug-in files from the plug-in directories, the
  * plug-ins to be removed must be first unloaded. Therefore this function
@@ -1298,8 +2327,53 @@ CP_C_API cp_status_t cp_scan_plugins(cp_context_t *ctx, int flags) CP_GCC_NONNUL
  * @param id identifier of the plug-in to be started
  * @return @ref CP_OK (zero) on success or an error code on failure
  */
+/**
+ * Resolves all the installed plug-ins without starting them. The plug-in
+ * dependencies are resolved in a single pass over all the plug-ins, so
+ * this is considerably faster than resolving a large number of plug-ins
+ * one at a time when starting them. All the static plug-in dependency
+ * loops are reported as info messages. Plug-ins which can not be
+ * resolved, and the plug-ins that depend on them, remain installed but
+ * the others are resolved. The result is cached, so calling this function
+ * again returns immediately until plug-ins are installed or uninstalled.
+ * Starting all the plug-ins using ::cp_start_plugins_parallel resolves
+ * the plug-ins the same way.
+ * 
+ * @param ctx the plug-in context
+ * @return @ref CP_OK (zero) if all the plug-ins were resolved or the status code of the first failure
+ */
+CP_C_API cp_status_t cp_resolve_plugins(cp_context_t *ctx) CP_GCC_NONNULL(1);
+
 CP_C_API cp_status_t cp_start_plugin(cp_context_t *ctx, const char *id) CP_GCC_NONNULL(1, 2);
 
+/**
+ * Starts several plug-ins, executing independent start functions in
+ * parallel. Also starts any imported plug-ins. A plug-in is started only
+ * after the plug-ins it imports have become active, the same as with
+ * ::cp_start_plugin, but the start functions of plug-ins which do not
+ * depend on each other are executed concurrently by up to the specified
+ * number of worker threads. Plug-in instances are created and plug-in
+ * listeners are called by the calling thread, so for each plug-in the
+ * events are delivered in order and imported plug-ins become active before
+ * the importing plug-ins start. If threads are not supported or the number
+ * of threads is zero or one then the plug-ins are started serially.
+ * 
+ * While start functions are being executed, other threads calling plug-in
+ * management functions for the same plug-in context block until all the
+ * start functions have returned. Start functions executed in parallel
+ * should only use symbols from imported plug-ins.
+ * 
+ * Plug-ins which can not be resolved or started, and the plug-ins that
+ * depend on them, are not started but the other plug-ins are.
+ * 
+ * @param ctx the plug-in context
+ * @param ids identifiers of the plug-ins to be started, or NULL for all installed plug-ins
+ * @param num the number of identifiers, ignored if @a ids is NULL
+ * @param num_threads the maximum number of start functions executed concurrently
+ * @return @ref CP_OK (zero) if all the plug-ins were started or the status code of the first failure
+ */
+CP_C_API cp_status_t cp_start_plugins_parallel(cp_context_t *ctx, const char * const *ids, int num, unsigned int num_threads) CP_GCC_NONNULL(1);
+
 /**
  * Stops a plug-in. First stops any dependent plug-ins that are currently
  * active. Then stops the specified plug-in. If the plug-in is already
@@ -1321,6 +2395,24 @@ CP_C_API cp_status_t cp_stop_plugin(cp_context_t *ctx, const char *id) CP_GCC_NO
  */
 CP_C_API void cp_stop_plugins(cp_context_t *ctx) CP_GCC_NONNULL(1);
 
+/**
+ * Stops all active plug-ins using worker threads to execute the stop
+ * functions of independent plug-ins concurrently. The plug-ins are stopped
+ * in waves: a plug-in is stopped once all plug-ins importing it, statically
+ * or dynamically, have been stopped. Plug-ins in dependency loops are
+ * stopped as by ::cp_stop_plugin once no stop functions are running. Plug-in
+ * events and other framework processing are done by the calling thread
+ * which holds the context lock while the stop functions are not running.
+ * Other threads calling framework functions modifying the plug-ins block
+ * until the stop functions executing in parallel have returned. If the
+ * framework was built without multi-threading support, or @a num_threads
+ * is less than two, then the plug-ins are stopped in the calling thread.
+ *
+ * @param ctx the plug-in context
+ * @param num_threads the maximum number of stop functions executed concurrently
+ */
+CP_C_API void cp_stop_plugins_parallel(cp_context_t *ctx, unsigned int num_threads) CP_GCC_NONNULL(1);
+
 /**
  * Uninstalls the specified plug-in. The plug-in is first stopped if it is active.
  * Then uninstalls the plug-in and any dependent plug-ins.
@@ -1411,65 +2503,455 @@ CP_C_API cp_ext_point_t ** cp_get_ext_points_info(cp_context_t *ctx, cp_status_t
 CP_C_API cp_extension_t ** cp_get_extensions_info(cp_context_t *ctx, const char *extpt_id, cp_status_t *status, int *num) CP_GCC_NONNULL(1);
 
 /**
- * Releases a previously obtained reference counted information object. The
- * documentation for functions returning such information refers
- * to this function. The information must not be accessed after it has
- * been released. The framework uses reference counting to deallocate
- * the information when it is not in use anymore.
- * 
+ * Returns static information about the extensions installed at the
+ * extension points whose identifier begins with the specified prefix,
+ * which corresponds to the wildcard pattern <em>prefix</em>*. For example,
+ * the prefix "org.example.codec." matches the extensions of all the
+ * extension points below org.example.codec. The extension point
+ * identifiers are kept in a sorted index, so only the matching extension
+ * points are visited. The extensions are returned in extension point
+ * identifier order and in installation order within an extension point.
+ * The returned information must be released as described for
+ * ::cp_get_extensions_info.
+ *
  * @param ctx the plug-in context
- * @param info the information to be released
+ * @param prefix the extension point identifier prefix, or an empty string for all extensions
+ * @param status a pointer to the location where status code is to be stored, or NULL
+ * @param num a pointer to the location where the number of returned extensions is to be stored, or NULL
+ * @return pointer to a NULL-terminated list of pointers to extension
+ *			information or NULL on failure
  */
-CP_C_API void cp_release_info(cp_context_t *ctx, void *info) CP_GCC_NONNULL(1, 2);
+CP_C_API cp_extension_t ** cp_get_extensions_info_prefix(cp_context_t *ctx, const char *prefix, cp_status_t *status, int *num) CP_GCC_NONNULL(1, 2);
 
 /**
- * Returns the current state of the specified plug-in. Returns
- * #CP_PLUGIN_UNINSTALLED if the specified plug-in identifier is unknown.
+ * Returns the configuration of the specified extension, parsing it first
+ * if it is parsed lazily, see ::cp_set_lazy_ext_configuration. This is
+ * needed for accessing the lazily parsed configuration of extensions
+ * obtained as part of plug-in information. The extension must belong to
+ * plug-in information which the caller is using. The configuration
+ * remains valid as long as the plug-in information.
+ *
+ * @param ctx the plug-in context
+ * @param ext the extension
+ * @param status a pointer to the location where status code is to be stored, or NULL
+ * @return the configuration or NULL on failure
+ */
+CP_C_API cp_cfg_element_t * cp_get_ext_configuration(cp_context_t *ctx, cp_extension_t *ext, cp_status_t *status) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Calls the specified visitor for each installed plug-in without copying
+ * the plug-in information or changing its reference count. The plug-in
+ * context remains locked for reading during the iteration, see
+ * @ref cp_plugin_visitor_func_t "plug-in visitors" for the restrictions.
+ * Use ::cp_get_plugins_info to obtain information which can be used after
+ * the iteration.
  * 
  * @param ctx the plug-in context
- * @param id the plug-in identifier
- * @return the current state of the plug-in
+ * @param visitor the visitor function
+ * @param user_data the user data pointer passed to the visitor
+ * @return the non-zero value returned by the visitor to stop the
+ * 			iteration, or zero if all plug-ins were visited
  */
-CP_C_API cp_plugin_state_t cp_get_plugin_state(cp_context_t *ctx, const char *id) CP_GCC_NONNULL(1, 2);
+CP_C_API int cp_for_each_plugin(cp_context_t *ctx, cp_plugin_visitor_func_t visitor, void *user_data) CP_GCC_NONNULL(1, 2);
 
 /**
- * Registers a plug-in listener with a plug-in context. The listener is called
- * synchronously immediately after a plug-in state change. There can be several
- * listeners registered with the same context. A plug-in listener can be
- * unregistered using ::cp_unregister_plistener and it is automatically
- * unregistered when the registering plug-in is stopped or when the context
- * is destroyed.
+ * Calls the specified visitor for each installed extension of the
+ * specified extension point, or for all installed extensions, without
+ * copying the extension information or changing reference counts. The
+ * extensions of an extension point are visited in installation order. The
+ * plug-in context remains locked for reading during the iteration, see
+ * @ref cp_extension_visitor_func_t "extension visitors" for the
+ * restrictions.
  * 
  * @param ctx the plug-in context
- * @param listener the plug-in listener to be added
- * @param user_data user data pointer supplied to the listener
- * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if out of resources
+ * @param extpt_id the extension point identifier or NULL for all extensions
+ * @param visitor the visitor function
+ * @param user_data the user data pointer passed to the visitor
+ * @return the non-zero value returned by the visitor to stop the
+ * 			iteration, or zero if all extensions were visited
  */
-CP_C_API cp_status_t cp_register_plistener(cp_context_t *ctx, cp_plugin_listener_func_t listener, void *user_data) CP_GCC_NONNULL(1, 2);
+CP_C_API int cp_for_each_extension(cp_context_t *ctx, const char *extpt_id, cp_extension_visitor_func_t visitor, void *user_data) CP_GCC_NONNULL(1, 3);
 
 /**
- * Removes a plug-in listener from a plug-in context. Does nothing if the
- * specified listener was not registered.
+ * Begins an iteration over the extensions installed for the specified
+ * extension point. The plug-in context is locked for reading until the
+ * iteration is ended by calling ::cp_end_extensions, which must be done
+ * by the same thread. Until then the calling thread may call functions
+ * returning information but it must not call framework functions changing
+ * the same plug-in context.
  * 
  * @param ctx the plug-in context
- * @param listener the plug-in listener to be removed
+ * @param extpt_id the extension point identifier
+ * @param iter the iterator to be initialized
  */
-CP_C_API void cp_unregister_plistener(cp_context_t *ctx, cp_plugin_listener_func_t listener) CP_GCC_NONNULL(1, 2);
+CP_C_API void cp_begin_extensions(cp_context_t *ctx, const char *extpt_id, cp_extension_iter_t *iter) CP_GCC_NONNULL(1, 2, 3);
 
 /**
- * Traverses a configuration element tree and returns the specified element.
- * The target element is specified by a base element and a relative path from
- * the base element to the target element. The path includes element names
- * separated by slash '/'. Two dots ".." can be used to designate a parent
- * element. Returns NULL if the specified element does not exist. If there are
- * several subelements with the same name, this function chooses the first one
- * when traversing the tree.
- *
- * @param base the base configuration element
- * @param path the path to the target element
- * @return the target element or NULL if nonexisting
+ * Returns the next extension of an iteration begun using
+ * ::cp_begin_extensions. The returned extension information is borrowed
+ * and it is valid only until the iteration is ended.
+ * 
+ * @param iter the iterator
+ * @return the next extension or NULL if there are no more extensions
  */
-CP_C_API cp_cfg_element_t * cp_lookup_cfg_element(cp_cfg_element_t *base, const char *path) CP_GCC_PURE CP_GCC_NONNULL(1, 2);
+CP_C_API const cp_extension_t * cp_next_extension(cp_extension_iter_t *iter) CP_GCC_NONNULL(1);
+
+/**
+ * Ends an iteration begun using ::cp_begin_extensions and unlocks the
+ * plug-in context.
+ * 
+ * @param iter the iterator
+ */
+CP_C_API void cp_end_extensions(cp_extension_iter_t *iter) CP_GCC_NONNULL(1);
+
+/**
+ * Returns a snapshot of the currently installed extension points and
+ * extensions. As long as the extension registry does not change, this
+ * returns the same published snapshot without acquiring the plug-in context
+ * lock, so it is suitable for frequent use from several threads. After a
+ * change the next call builds and publishes a new snapshot. The caller must
+ * release the snapshot by calling ::cp_release_ext_snapshot when the
+ * snapshot is not needed anymore. The information in the snapshot must not
+ * be modified.
+ *
+ * @param ctx the plug-in context
+ * @param status a pointer to the location where status code is to be stored, or NULL
+ * @return the snapshot or NULL on failure
+ */
+CP_C_API cp_ext_snapshot_t * cp_get_ext_snapshot(cp_context_t *ctx, cp_status_t *status) CP_GCC_NONNULL(1);
+
+/**
+ * Returns the extension points included in an extension snapshot. The
+ * returned array belongs to the snapshot.
+ *
+ * @param snapshot the extension snapshot
+ * @param num a pointer to the location where the number of extension points is to be stored, or NULL
+ * @return pointer to a NULL-terminated list of pointers to extension point information
+ */
+CP_C_API cp_ext_point_t * const * cp_get_snapshot_ext_points(const cp_ext_snapshot_t *snapshot, int *num) CP_GCC_NONNULL(1);
+
+/**
+ * Returns the extensions included in an extension snapshot. The returned
+ * array belongs to the snapshot. The extensions of an extension point are
+ * returned in installation order. When an extension point identifier is
+ * given the returned list is not necessarily NULL-terminated and the
+ * number of extensions must be used to find its end.
+ *
+ * @param snapshot the extension snapshot
+ * @param extpt_id the extension point identifier or NULL for all extensions
+ * @param num a pointer to the location where the number of extensions is to be stored, or NULL
+ * @return pointer to a list of pointers to extension information
+ */
+CP_C_API cp_extension_t * const * cp_get_snapshot_extensions(const cp_ext_snapshot_t *snapshot, const char *extpt_id, int *num) CP_GCC_NONNULL(1);
+
+/**
+ * Releases an extension snapshot obtained using ::cp_get_ext_snapshot.
+ * This function does not acquire the plug-in context lock. The memory of
+ * a released snapshot that is not published anymore is reclaimed when the
+ * extension registry changes next time or when the plug-in context is
+ * destroyed.
+ *
+ * @param snapshot the extension snapshot
+ */
+CP_C_API void cp_release_ext_snapshot(cp_ext_snapshot_t *snapshot) CP_GCC_NONNULL(1);
+
+/**
+ * Releases a previously obtained reference counted information object. The
+ * documentation for functions returning such information refers
+ * to this function. The information must not be accessed after it has
+ * been released. The framework uses reference counting to deallocate
+ * the information when it is not in use anymore. Releasing an unknown
+ * object or an object that has already been released is a fatal error.
+ * 
+ * @param ctx the plug-in context
+ * @param info the information to be released
+ */
+CP_C_API void cp_release_info(cp_context_t *ctx, void *info) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Returns the heap memory held by a reference counted information object,
+ * in bytes. For plug-in information this is the whole descriptor tree
+ * including parsed extension configuration. For arrays returned by the
+ * framework this is the array itself, the plug-in information it refers
+ * to is accounted separately. Querying an unknown object is handled as
+ * described for ::cp_release_info.
+ * 
+ * @param ctx the plug-in context
+ * @param info the information object
+ * @return the size of the object in bytes
+ */
+CP_C_API unsigned long cp_get_info_size(cp_context_t *ctx, const void *info) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Returns the current state of the specified plug-in. Returns
+ * #CP_PLUGIN_UNINSTALLED if the specified plug-in identifier is unknown.
+ * 
+ * @param ctx the plug-in context
+ * @param id the plug-in identifier
+ * @return the current state of the plug-in
+ */
+CP_C_API cp_plugin_state_t cp_get_plugin_state(cp_context_t *ctx, const char *id) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Returns a stable handle to the specified installed plug-in. The handle
+ * can be used to read the plug-in state and information without locking
+ * the plug-in context or looking up the plug-in identifier, which makes it
+ * suitable for frequent state checks. All callers asking for a handle to
+ * the same installed plug-in get the same handle. The handle remains
+ * valid after the plug-in has been uninstalled and it must be released
+ * using ::cp_release_info.
+ * 
+ * @param ctx the plug-in context
+ * @param id the plug-in identifier
+ * @param status a pointer to the location where status code is to be
+ *			stored, or NULL
+ * @return the plug-in handle or NULL on failure (unknown plug-in or
+ *			insufficient memory)
+ */
+CP_C_API cp_plugin_handle_t *cp_get_plugin_handle(cp_context_t *ctx, const char *id, cp_status_t *status) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Returns the current state of the plug-in referred to by the specified
+ * handle. Returns #CP_PLUGIN_UNINSTALLED if the plug-in has been
+ * uninstalled. This function does not lock the plug-in context and it can
+ * be called from any thread, including from within listener invocations.
+ * The returned state reflects the latest state change delivered to the
+ * plug-in listeners.
+ * 
+ * @param handle the plug-in handle
+ * @return the current state of the plug-in
+ */
+CP_C_API cp_plugin_state_t cp_get_handle_state(cp_plugin_handle_t *handle) CP_GCC_NONNULL(1);
+
+/**
+ * Returns the static plug-in information of the plug-in referred to by the
+ * specified handle, or NULL if the plug-in has been uninstalled. The
+ * information is owned by the handle and it remains valid as long as the
+ * handle is being held, so it must not be released separately. This
+ * function does not lock the plug-in context.
+ * 
+ * @param handle the plug-in handle
+ * @return the plug-in information or NULL if the plug-in has been uninstalled
+ */
+CP_C_API cp_plugin_info_t *cp_get_handle_info(cp_plugin_handle_t *handle) CP_GCC_NONNULL(1);
+
+/**
+ * Returns the timing statistics of the specified plug-in. The statistics
+ * are always collected and cover loading the plug-in descriptor, opening
+ * the runtime library, the plug-in runtime functions and the run
+ * functions executed since the plug-in was installed.
+ * 
+ * @param ctx the plug-in context
+ * @param id the plug-in identifier
+ * @param stats a pointer to the location where the statistics are stored
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_UNKNOWN if there is no such plug-in
+ */
+CP_C_API cp_status_t cp_get_plugin_stats(cp_context_t *ctx, const char *id, cp_plugin_stats_t *stats) CP_GCC_NONNULL(1, 2, 3);
+
+/**
+ * Returns the lock statistics collected since lock profiling was enabled
+ * using ::cp_set_lock_profiling, one entry per API function. The
+ * returned array must be released using ::cp_release_info. The
+ * statistics of this call itself are not included.
+ *
+ * @param ctx the plug-in context
+ * @param error filled with an error code, if non-NULL
+ * @param num filled with the number of returned entries, if non-NULL
+ * @return an array of statistics or NULL on failure or if profiling is not enabled
+ */
+CP_C_API cp_lock_stats_t *cp_get_lock_stats(cp_context_t *ctx, cp_status_t *error, int *num) CP_GCC_NONNULL(1);
+
+/**
+ * Returns the number and size of the reference counted information
+ * objects obtained through the plug-in context and not yet released,
+ * one entry per owner. Objects which are never released accumulate here,
+ * so this can be used to find the owners leaking information objects.
+ * The returned array itself is not included. It must be released using
+ * ::cp_release_info.
+ *
+ * @param ctx the plug-in context
+ * @param error filled with an error code, if non-NULL
+ * @param num filled with the number of returned entries, if non-NULL
+ * @return an array of usage entries or NULL on failure
+ */
+CP_C_API cp_info_usage_t *cp_get_info_usage(cp_context_t *ctx, cp_status_t *error, int *num) CP_GCC_NONNULL(1);
+
+/**
+ * Returns the current generation of the plug-in registry. The generation
+ * is a counter which is advanced for every installation, uninstallation,
+ * change to the extensions of an extension point and plug-in state change.
+ * Clients caching registry information can compare generations to tell
+ * whether their caches are stale. The generation functions do not lock
+ * the context and they may be called from any thread.
+ *
+ * @param ctx the plug-in context
+ * @return the current generation
+ */
+CP_C_API unsigned long cp_get_generation(cp_context_t *ctx) CP_GCC_NONNULL(1);
+
+/**
+ * Returns the generation of the latest change to the set of installed
+ * plug-ins, that is the plug-ins returned by ::cp_get_plugins_info.
+ *
+ * @param ctx the plug-in context
+ * @return the generation of the installed plug-ins
+ */
+CP_C_API unsigned long cp_get_plugins_generation(cp_context_t *ctx) CP_GCC_NONNULL(1);
+
+/**
+ * Returns the generation of the latest change to the extensions installed
+ * for the specified extension point, that is the extensions returned by
+ * ::cp_get_extensions_info. The generations are kept in a fixed number of
+ * slots shared by several extension points, so the generation may also
+ * advance when the extensions of another extension point change.
+ *
+ * @param ctx the plug-in context
+ * @param ext_point_id the extension point identifier
+ * @return the generation of the extensions of the extension point
+ */
+CP_C_API unsigned long cp_get_extensions_generation(cp_context_t *ctx, const char *ext_point_id) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Returns the generation of the latest state change of the specified
+ * plug-in. Like for ::cp_get_extensions_generation, the generation may
+ * also advance when the state of another plug-in changes.
+ *
+ * @param ctx the plug-in context
+ * @param id the plug-in identifier
+ * @return the generation of the plug-in state
+ */
+CP_C_API unsigned long cp_get_plugin_generation(cp_context_t *ctx, const char *id) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Returns the changes of the plug-in registry after the specified
+ * generation, in the order they occurred. The context keeps a bounded
+ * feed of recent changes, starting from the first call to this function.
+ * If changes after the specified generation are no longer available, a
+ * single change of type @ref CP_CHANGE_RESET with the current generation
+ * is returned instead and the client should refresh all its cached
+ * information. The returned array is terminated by an entry with zero
+ * generation and it must be released using ::cp_release_info.
+ *
+ * @param ctx the plug-in context
+ * @param since the generation the client is up to date with
+ * @param status a pointer to the location where status code is to be stored, or NULL
+ * @param num filled with the number of returned changes, if non-NULL
+ * @return an array of changes or NULL on failure
+ */
+CP_C_API cp_change_t *cp_get_changes(cp_context_t *ctx, unsigned long since, cp_status_t *status, int *num) CP_GCC_NONNULL(1);
+
+/**
+ * Registers a plug-in listener with a plug-in context. The listener is called
+ * synchronously immediately after a plug-in state change. There can be several
+ * listeners registered with the same context. A plug-in listener can be
+ * unregistered using ::cp_unregister_plistener and it is automatically
+ * unregistered when the registering plug-in is stopped or when the context
+ * is destroyed.
+ * 
+ * @param ctx the plug-in context
+ * @param listener the plug-in listener to be added
+ * @param user_data user data pointer supplied to the listener
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if out of resources
+ */
+CP_C_API cp_status_t cp_register_plistener(cp_context_t *ctx, cp_plugin_listener_func_t listener, void *user_data) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Registers a plug-in listener which is only called for the state changes
+ * of interest. This function is like ::cp_register_plistener except that
+ * the listener is only called for plug-ins with the specified identifier,
+ * or with identifiers starting with the specified prefix, and only for
+ * transitions into states included in the specified
+ * @ref cStateMasks "state mask". The events are matched by the framework
+ * using an index of the registered filters. The order in which listeners
+ * with different filters are called for an event is unspecified.
+ * 
+ * @param ctx the plug-in context
+ * @param listener the plug-in listener to be added
+ * @param user_data user data pointer supplied to the listener
+ * @param plugin_id the plug-in identifier or identifier prefix of interest, or NULL for all plug-ins
+ * @param prefix whether @a plugin_id is an identifier prefix
+ * @param state_mask mask of the new plug-in states of interest
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if out of resources
+ */
+CP_C_API cp_status_t cp_register_plistener_filtered(cp_context_t *ctx, cp_plugin_listener_func_t listener, void *user_data, const char *plugin_id, int prefix, unsigned int state_mask) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Removes a plug-in listener from a plug-in context. Does nothing if the
+ * specified listener was not registered.
+ * 
+ * @param ctx the plug-in context
+ * @param listener the plug-in listener to be removed
+ */
+CP_C_API void cp_unregister_plistener(cp_context_t *ctx, cp_plugin_listener_func_t listener) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Removes a plug-in listener registered with the specified user data
+ * pointer from a plug-in context. This function is like
+ * ::cp_unregister_plistener except that it only matches the registration
+ * with the specified user data. This allows registering the same listener
+ * function several times with different user data and unregistering the
+ * registrations separately. Does nothing if no such registration exists.
+ * 
+ * @param ctx the plug-in context
+ * @param listener the plug-in listener to be removed
+ * @param user_data the user data pointer supplied at registration
+ */
+CP_C_API void cp_unregister_plistener_data(cp_context_t *ctx, cp_plugin_listener_func_t listener, void *user_data) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Registers a batch plug-in listener with a plug-in context. Plug-in state
+ * changes are queued and delivered to batch listeners in batches by an
+ * event dispatcher thread, which is started when the first batch listener
+ * is registered. If the framework has been built without multi-threading
+ * support, or if the dispatcher thread can not be started, then each event
+ * is delivered synchronously as a batch of one event. A batch listener can
+ * be unregistered using ::cp_unregister_batch_plistener and it is
+ * automatically unregistered when the registering plug-in is stopped or
+ * when the context is destroyed. This function must not be called from
+ * within a batch listener invocation.
+ * 
+ * @param ctx the plug-in context
+ * @param listener the batch listener to be added
+ * @param user_data user data pointer supplied to the listener
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if out of resources
+ */
+CP_C_API cp_status_t cp_register_batch_plistener(cp_context_t *ctx, cp_batch_plistener_func_t listener, void *user_data) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Removes a batch plug-in listener from a plug-in context. Waits for an
+ * ongoing batch delivery to complete so that the listener is not called
+ * after this function has returned. Does nothing if the specified listener
+ * was not registered. This function must not be called from within a batch
+ * listener invocation.
+ * 
+ * @param ctx the plug-in context
+ * @param listener the batch listener to be removed
+ */
+CP_C_API void cp_unregister_batch_plistener(cp_context_t *ctx, cp_batch_plistener_func_t listener) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Waits until the plug-in events queued so far have been delivered to the
+ * batch plug-in listeners. This function must not be called from within a
+ * batch listener invocation.
+ * 
+ * @param ctx the plug-in context
+ */
+CP_C_API void cp_flush_plugin_events(cp_context_t *ctx) CP_GCC_NONNULL(1);
+
+/**
+ * Traverses a configuration element tree and returns the specified element.
+ * The target element is specified by a base element and a relative path from
+ * the base element to the target element. The path includes element names
+ * separated by slash '/'. Two dots ".." can be used to designate a parent
+ * element. Returns NULL if the specified element does not exist. If there are
+ * several subelements with the same name, this function chooses the first one
+ * when traversing the tree.
+ *
+ * @param base the base configuration element
+ * @param path the path to the target element
+ * @return the target element or NULL if nonexisting
+ */
+CP_C_API cp_cfg_element_t * cp_lookup_cfg_element(cp_cfg_element_t *base, const char *path) CP_GCC_PURE CP_GCC_NONNULL(1, 2);
 
 /**
  * Traverses a configuration element tree and returns the value of the
@@ -1489,6 +2971,228 @@ CP_C_API cp_cfg_element_t * cp_lookup_cfg_element(cp_cfg_element_t *base, const
  */
 CP_C_API char * cp_lookup_cfg_value(cp_cfg_element_t *base, const char *path) CP_GCC_PURE CP_GCC_NONNULL(1, 2);
 
+/**
+ * Traverses a configuration element tree and returns the value of the
+ * specified element or attribute as an integer. The path is interpreted
+ * as for ::cp_lookup_cfg_value. The value must be a decimal integer, as
+ * parsed by strtol, and it may be surrounded by white space. The location
+ * pointed to by @a value is not modified on failure. The parsed value is
+ * cached with the configuration element so that repeated lookups do not
+ * parse it again.
+ *
+ * @param base the base configuration element
+ * @param path the path to the target element or attribute
+ * @param value filled with the integer value
+ * @return @ref CP_OK (zero) on success, @ref CP_ERR_UNKNOWN if the
+ *	target does not exist or has no value, or @ref CP_ERR_MALFORMED if
+ *	the value is not an integer or is out of range
+ */
+CP_C_API cp_status_t cp_lookup_cfg_int(cp_cfg_element_t *base, const char *path, long *value) CP_GCC_NONNULL(1, 2, 3);
+
+/**
+ * Traverses a configuration element tree and returns the value of the
+ * specified element or attribute as a floating point number. This is the
+ * same as ::cp_lookup_cfg_int except that the value is parsed by strtod.
+ *
+ * @param base the base configuration element
+ * @param path the path to the target element or attribute
+ * @param value filled with the floating point value
+ * @return @ref CP_OK (zero) on success, @ref CP_ERR_UNKNOWN if the
+ *	target does not exist or has no value, or @ref CP_ERR_MALFORMED if
+ *	the value is not a number or is out of range
+ */
+CP_C_API cp_status_t cp_lookup_cfg_double(cp_cfg_element_t *base, const char *path, double *value) CP_GCC_NONNULL(1, 2, 3);
+
+/**
+ * Traverses a configuration element tree and returns the value of the
+ * specified element or attribute as a boolean. This is the same as
+ * ::cp_lookup_cfg_int except that the value must be one of "true",
+ * "false", "yes", "no", "on", "off", "1" or "0". The value is stored
+ * as 1 for true and 0 for false.
+ *
+ * @param base the base configuration element
+ * @param path the path to the target element or attribute
+ * @param value filled with the boolean value
+ * @return @ref CP_OK (zero) on success, @ref CP_ERR_UNKNOWN if the
+ *	target does not exist or has no value, or @ref CP_ERR_MALFORMED if
+ *	the value is not a boolean
+ */
+CP_C_API cp_status_t cp_lookup_cfg_bool(cp_cfg_element_t *base, const char *path, int *value) CP_GCC_NONNULL(1, 2, 3);
+
+/**
+ * Compiles a configuration element path for repeated lookups. The path
+ * syntax is the same as for ::cp_lookup_cfg_value and the path may end with
+ * an attribute selection. The compiled path must be freed using
+ * ::cp_free_cfg_path when it is not needed anymore.
+ *
+ * @param path the path to be compiled
+ * @param status pointer to the location where status code is to be stored, or NULL
+ * @return the compiled path or NULL on failure
+ */
+CP_C_API cp_cfg_path_t * cp_compile_cfg_path(const char *path, cp_status_t *status) CP_GCC_NONNULL(1);
+
+/**
+ * Traverses a configuration element tree and returns the element specified
+ * by a compiled path. This is equivalent to ::cp_lookup_cfg_element except
+ * that a possible attribute selection in the path is ignored.
+ *
+ * @param base the base configuration element
+ * @param path the compiled path to the target element
+ * @return the target element or NULL if nonexisting
+ */
+CP_C_API cp_cfg_element_t * cp_lookup_cfg_compiled(cp_cfg_element_t *base, const cp_cfg_path_t *path) CP_GCC_PURE CP_GCC_NONNULL(1, 2);
+
+/**
+ * Traverses a configuration element tree and returns the value of the
+ * element or attribute specified by a compiled path. This is equivalent to
+ * ::cp_lookup_cfg_value.
+ *
+ * @param base the base configuration element
+ * @param path the compiled path to the target element or attribute
+ * @return the value of the target element or attribute or NULL
+ */
+CP_C_API char * cp_lookup_cfg_value_compiled(cp_cfg_element_t *base, const cp_cfg_path_t *path) CP_GCC_PURE CP_GCC_NONNULL(1, 2);
+
+/**
+ * Frees a compiled configuration element path.
+ *
+ * @param path the compiled path
+ */
+CP_C_API void cp_free_cfg_path(cp_cfg_path_t *path) CP_GCC_NONNULL(1);
+
+/**
+ * The element index returned by the compact tree functions when there is
+ * no such element.
+ */
+#define CP_CFG_NONE ((unsigned int) -1)
+
+/**
+ * Creates a compact copy of a configuration element tree. The compact
+ * tree takes considerably less memory than the original tree for large
+ * configurations and is traversed using the cp_cfg_tree functions, such
+ * as ::cp_cfg_tree_lookup. The compact tree does not refer to the
+ * original tree and it must be freed using ::cp_free_cfg_tree when it is
+ * not needed anymore.
+ *
+ * @param root the root of the configuration element tree
+ * @param status pointer to the location where status code is to be stored, or NULL
+ * @return the compact tree or NULL on failure
+ */
+CP_C_API cp_cfg_tree_t * cp_compact_cfg(const cp_cfg_element_t *root, cp_status_t *status) CP_GCC_NONNULL(1);
+
+/**
+ * Frees a compact configuration element tree, including any element
+ * structures returned by ::cp_cfg_tree_element.
+ *
+ * @param tree the compact tree
+ */
+CP_C_API void cp_free_cfg_tree(cp_cfg_tree_t *tree) CP_GCC_NONNULL(1);
+
+/**
+ * Returns the number of elements in a compact configuration element tree.
+ * The elements are numbered in preorder starting from zero for the root
+ * element, so that the descendants of an element follow the element.
+ *
+ * @param tree the compact tree
+ * @return the number of elements
+ */
+CP_C_API unsigned int cp_cfg_tree_size(const cp_cfg_tree_t *tree) CP_GCC_PURE CP_GCC_NONNULL(1);
+
+/**
+ * Returns the name of an element of a compact configuration element tree.
+ * Equal strings of a tree are shared, so names can also be compared by
+ * pointer within a tree.
+ *
+ * @param tree the compact tree
+ * @param node the element index
+ * @return the name of the element
+ */
+CP_C_API const char * cp_cfg_tree_name(const cp_cfg_tree_t *tree, unsigned int node) CP_GCC_PURE CP_GCC_NONNULL(1);
+
+/**
+ * Returns the value of an element of a compact configuration element tree.
+ *
+ * @param tree the compact tree
+ * @param node the element index
+ * @return the value of the element or NULL if none
+ */
+CP_C_API const char * cp_cfg_tree_value(const cp_cfg_tree_t *tree, unsigned int node) CP_GCC_PURE CP_GCC_NONNULL(1);
+
+/**
+ * Returns the parent of an element of a compact configuration element tree.
+ *
+ * @param tree the compact tree
+ * @param node the element index
+ * @return the parent element index or #CP_CFG_NONE for the root element
+ */
+CP_C_API unsigned int cp_cfg_tree_parent(const cp_cfg_tree_t *tree, unsigned int node) CP_GCC_PURE CP_GCC_NONNULL(1);
+
+/**
+ * Returns the first child of an element of a compact configuration
+ * element tree.
+ *
+ * @param tree the compact tree
+ * @param node the element index
+ * @return the child element index or #CP_CFG_NONE if no children
+ */
+CP_C_API unsigned int cp_cfg_tree_first_child(const cp_cfg_tree_t *tree, unsigned int node) CP_GCC_PURE CP_GCC_NONNULL(1);
+
+/**
+ * Returns the next sibling of an element of a compact configuration
+ * element tree.
+ *
+ * @param tree the compact tree
+ * @param node the element index
+ * @return the sibling element index or #CP_CFG_NONE if this is the last child
+ */
+CP_C_API unsigned int cp_cfg_tree_next_sibling(const cp_cfg_tree_t *tree, unsigned int node) CP_GCC_PURE CP_GCC_NONNULL(1);
+
+/**
+ * Returns the number of children of an element of a compact configuration
+ * element tree.
+ *
+ * @param tree the compact tree
+ * @param node the element index
+ * @return the number of children
+ */
+CP_C_API unsigned int cp_cfg_tree_num_children(const cp_cfg_tree_t *tree, unsigned int node) CP_GCC_PURE CP_GCC_NONNULL(1);
+
+/**
+ * Returns the value of an attribute of an element of a compact
+ * configuration element tree.
+ *
+ * @param tree the compact tree
+ * @param node the element index
+ * @param name the attribute name
+ * @return the attribute value or NULL if there is no such attribute
+ */
+CP_C_API const char * cp_cfg_tree_attr(const cp_cfg_tree_t *tree, unsigned int node, const char *name) CP_GCC_PURE CP_GCC_NONNULL(1, 3);
+
+/**
+ * Traverses a compact configuration element tree and returns the
+ * specified element. The path syntax is the same as for
+ * ::cp_lookup_cfg_element.
+ *
+ * @param tree the compact tree
+ * @param node the base element index
+ * @param path the path to the target element
+ * @return the target element index or #CP_CFG_NONE if nonexisting
+ */
+CP_C_API unsigned int cp_cfg_tree_lookup(const cp_cfg_tree_t *tree, unsigned int node, const char *path) CP_GCC_PURE CP_GCC_NONNULL(1, 3);
+
+/**
+ * Returns a configuration element structure tree equivalent to a compact
+ * configuration element tree, for use with code expecting
+ * @ref cp_cfg_element_t. The structure tree is constructed on the first
+ * call and it remains valid until the compact tree is freed. Concurrent
+ * first calls for the same compact tree must be serialized by the caller.
+ *
+ * @param tree the compact tree
+ * @param status pointer to the location where status code is to be stored, or NULL
+ * @return the root of the structure tree or NULL on failure
+ */
+CP_C_API cp_cfg_element_t * cp_cfg_tree_element(cp_cfg_tree_t *tree, cp_status_t *status) CP_GCC_NONNULL(1);
+
 /*@}*/
 
 
@@ -1532,10 +3236,127 @@ CP_C_API char * cp_lookup_cfg_value(cp_cfg_element_t *base, const char *path) CP
  */
 CP_C_API cp_status_t cp_run_function(cp_context_t *ctx, cp_run_func_t runfunc) CP_GCC_NONNULL(1, 2);
 
+/**
+ * Registers a new run function in the specified priority class. Otherwise
+ * this function is like ::cp_run_function except that the priority class
+ * of an already registered run function is changed.
+ *
+ * @param ctx the plug-in context of the registering plug-in
+ * @param runfunc the run function to be registered
+ * @param priority one of the @ref cRunPriorities "run priority classes"
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+CP_C_API cp_status_t cp_run_function_prio(cp_context_t *ctx, cp_run_func_t runfunc, int priority) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Registers a new run task. The run task is queued like a run function and it
+ * is called with the plug-in instance data pointer and the specified task
+ * data pointer. The return value of the task tells whether it has finished,
+ * whether it should be called again later or whether it should be suspended
+ * until it is resumed using ::cp_resume_task. Unlike run functions, the same
+ * task function can be registered several times with different task data.
+ * Unfinished tasks are discarded when the plug-in is stopped, calling the
+ * optional discard function. Plug-in framework functions stopping the
+ * registering plug-in must not be called from within a run task.
+ *
+ * @param ctx the plug-in context of the registering plug-in
+ * @param taskfunc the run task to be registered
+ * @param discardfunc the function releasing an unfinished task, or NULL
+ * @param task_data the task data pointer passed to the functions
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+CP_C_API cp_status_t cp_run_task(cp_context_t *ctx, cp_run_task_func_t taskfunc, cp_discard_task_func_t discardfunc, void *task_data) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Registers a new run task in the specified priority class. Otherwise
+ * this function is like ::cp_run_task.
+ *
+ * @param ctx the plug-in context of the registering plug-in
+ * @param taskfunc the run task to be registered
+ * @param discardfunc the function releasing an unfinished task, or NULL
+ * @param task_data the task data pointer passed to the functions
+ * @param priority one of the @ref cRunPriorities "run priority classes"
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+CP_C_API cp_status_t cp_run_task_prio(cp_context_t *ctx, cp_run_task_func_t taskfunc, cp_discard_task_func_t discardfunc, void *task_data, int priority) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Resumes a suspended run task so that it is queued to be run again. If the
+ * task is currently being executed then it is queued again even if it
+ * returns @ref CP_RUN_SUSPEND. This function can be called from any thread
+ * and from within plug-in listener invocations. Does nothing if there is no
+ * such task.
+ *
+ * @param ctx the plug-in context of the registering plug-in
+ * @param taskfunc the registered run task
+ * @param task_data the task data pointer supplied at registration
+ */
+CP_C_API void cp_resume_task(cp_context_t *ctx, cp_run_task_func_t taskfunc, void *task_data) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Schedules a run function to be called after the specified delay. The run
+ * function is registered if it is not registered yet. It is not called
+ * before the delay has elapsed, even if it has been queued to be run, and
+ * the calling run function, if scheduling itself, is not called again
+ * until then regardless of its return value, unless it returns zero.
+ * While waiting for scheduled run functions, ::cp_run_plugins and
+ * ::cp_run_plugins_parallel sleep instead of spinning.
+ *
+ * @param ctx the plug-in context of the registering plug-in
+ * @param runfunc the run function to be scheduled
+ * @param delay_ms the delay in milliseconds
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+CP_C_API cp_status_t cp_run_function_at(cp_context_t *ctx, cp_run_func_t runfunc, unsigned long delay_ms) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Schedules a run function to be called when the specified file descriptor
+ * becomes readable. Otherwise this function is like ::cp_run_function_at.
+ * The file descriptor must stay open until the run function is called or
+ * the plug-in is stopped. Waiting for file descriptors requires poll
+ * support and this function fails with @ref CP_ERR_RESOURCE if it is not
+ * available.
+ *
+ * @param ctx the plug-in context of the registering plug-in
+ * @param runfunc the run function to be scheduled
+ * @param fd the file descriptor to wait for
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+CP_C_API cp_status_t cp_run_function_on_fd(cp_context_t *ctx, cp_run_func_t runfunc, int fd) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Resumes a registered run task after the specified delay. This is like
+ * ::cp_resume_task except that the task is parked until the delay has
+ * elapsed. Does nothing if there is no such task.
+ *
+ * @param ctx the plug-in context of the registering plug-in
+ * @param taskfunc the registered run task
+ * @param task_data the task data pointer supplied at registration
+ * @param delay_ms the delay in milliseconds
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+CP_C_API cp_status_t cp_resume_task_at(cp_context_t *ctx, cp_run_task_func_t taskfunc, void *task_data, unsigned long delay_ms) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Resumes a registered run task when the specified file descriptor becomes
+ * readable. This is like ::cp_resume_task_at except that the task waits for
+ * the file descriptor instead of a delay.
+ *
+ * @param ctx the plug-in context of the registering plug-in
+ * @param taskfunc the registered run task
+ * @param task_data the task data pointer supplied at registration
+ * @param fd the file descriptor to wait for
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+CP_C_API cp_status_t cp_resume_task_on_fd(cp_context_t *ctx, cp_run_task_func_t taskfunc, void *task_data, int fd) CP_GCC_NONNULL(1, 2);
+
 /**
  * Runs the started plug-ins as long as there is something to run.
  * This function calls repeatedly run functions registered by started plug-ins
- * until there are no more active run functions. This function is normally
+ * until there are no more active run functions. Suspended run tasks are not
+ * considered active but run functions and tasks waiting for a deadline or
+ * for a file descriptor are, and this function sleeps while waiting for
+ * them. This function is normally
  * called by a thin main proram, a loader, which loads plug-ins, starts some
  * plug-ins and then passes control over to the started plug-ins.
  * 
@@ -1549,13 +3370,127 @@ CP_C_API void cp_run_plugins(cp_context_t *ctx) CP_GCC_NONNULL(1);
  * returns this function also returns and passes control back to the main
  * program. The return value can be used to determine whether there are any
  * active run functions left. This function does nothing if there are no active
- * registered run functions.
+ * registered run functions ready to be run. It never sleeps, so the return
+ * value may be non-zero even if the remaining run functions are waiting
+ * for a deadline or for a file descriptor.
  * 
  * @param ctx the plug-in context containing the plug-ins
- * @return whether there are active run functions waiting to be run
+ * @return whether there are active run functions waiting to be run or scheduled
  */
 CP_C_API int cp_run_plugins_step(cp_context_t *ctx) CP_GCC_NONNULL(1);
 
+/**
+ * Runs registered run functions until there are no more run functions
+ * ready to be run or until the specified time budget has been used. At
+ * least one ready run function is run, if there is any, so a zero budget
+ * makes this function behave like ::cp_run_plugins_step. The run function
+ * in execution when the budget expires is allowed to return normally.
+ * Like ::cp_run_plugins_step this function never sleeps. It is intended
+ * to be called by a main program having its own event loop when the file
+ * descriptor returned by ::cp_get_run_fd becomes readable.
+ * 
+ * @param ctx the plug-in context containing the plug-ins
+ * @param budget_us the time budget in microseconds
+ * @return whether there are run functions still waiting to be run
+ */
+CP_C_API int cp_run_plugins_for(cp_context_t *ctx, unsigned long budget_us) CP_GCC_NONNULL(1);
+
+/**
+ * Returns a file descriptor which is readable while there are run
+ * functions waiting to be run. A main program having its own event loop
+ * can include the file descriptor in the set of file descriptors it waits
+ * for and call ::cp_run_plugins_for when it becomes readable, instead of
+ * dedicating a thread to ::cp_run_plugins. The file descriptor is owned
+ * by the framework and it must not be read or closed by the main program.
+ * It is drained when the run queue becomes empty and it is closed when the
+ * plug-in context is destroyed. The file descriptor might be readable
+ * spuriously if the waiting run functions were executed by other means.
+ * Run functions waiting for a deadline or for a file descriptor do not make
+ * the file descriptor readable. They are queued when the deadline has
+ * passed and ::cp_run_plugins_for is called, or when they are waited for
+ * by ::cp_run_plugins or ::cp_run_plugins_parallel.
+ * This function is not available on platforms without poll(2).
+ * 
+ * @param ctx the plug-in context containing the plug-ins
+ * @return the file descriptor or -1 on failure
+ */
+CP_C_API int cp_get_run_fd(cp_context_t *ctx) CP_GCC_NONNULL(1);
+
+/**
+ * Runs the started plug-ins using several threads as long as there is
+ * something to run. This function is like ::cp_run_plugins except that
+ * the calling thread and up to @a num_threads - 1 additional worker
+ * threads execute the registered run functions in parallel. A run function
+ * is never executed concurrently with itself or with the stopping of its
+ * plug-in. This function returns when there are no more active run
+ * functions. If threads are not supported or @a num_threads is less than
+ * two, this function is equivalent to ::cp_run_plugins.
+ * 
+ * @param ctx the plug-in context containing the plug-ins
+ * @param num_threads the maximum number of threads executing run functions
+ */
+CP_C_API void cp_run_plugins_parallel(cp_context_t *ctx, unsigned int num_threads) CP_GCC_NONNULL(1);
+
+/**
+ * Returns the time a plug-in has spent in its run functions and run tasks
+ * since it was installed. The time is measured using a monotonic clock.
+ *
+ * @param ctx the plug-in context
+ * @param id the identifier of the plug-in
+ * @param usecs a pointer to a location where the time in microseconds is stored, or NULL
+ * @param calls a pointer to a location where the number of invocations is stored, or NULL
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_UNKNOWN if there is no such plug-in
+ */
+CP_C_API cp_status_t cp_get_plugin_run_time(cp_context_t *ctx, const char *id, unsigned long long *usecs, unsigned long *calls) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Submits a task to be executed by the thread pool shared by all the
+ * plug-in contexts of the process. The pool is sized to the number of
+ * processors and it is also used by the framework for parallel scans,
+ * starts and run function execution, so plug-ins should submit short
+ * tasks to the pool instead of starting their own worker threads. Tasks
+ * submitted by a pool thread are executed by that thread first, and idle
+ * pool threads steal tasks queued by other threads. If @a task is NULL
+ * the task is released automatically after it has been executed,
+ * otherwise the caller must release the returned handle using
+ * ::cp_wait_task. When a plug-in is stopped, its queued tasks are
+ * cancelled and the framework waits for its tasks in execution to
+ * complete before the stop and destroy functions are called. Likewise,
+ * the tasks of the main program are cancelled or completed when its
+ * plug-in context is destroyed. If threads are not supported, the task is
+ * executed before this function returns.
+ *
+ * @param ctx the plug-in context of the submitting plug-in or main program
+ * @param func the task function
+ * @param arg the argument passed to the task function
+ * @param task filled with the task handle, or NULL to release the task automatically
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if insufficient resources
+ */
+CP_C_API cp_status_t cp_submit_task(cp_context_t *ctx, cp_task_func_t func, void *arg, cp_task_t **task) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Waits for a submitted task to complete and releases the task handle.
+ * If the task has not been started yet, it is executed by the calling
+ * thread. The calling thread should not be executing a start function or
+ * other framework callback if the task uses framework functions, because
+ * the plug-in context remains locked while waiting.
+ *
+ * @param ctx the plug-in context used to submit the task
+ * @param task the task handle returned by ::cp_submit_task
+ * @return non-zero if the task was executed or zero if it was cancelled
+ */
+CP_C_API int cp_wait_task(cp_context_t *ctx, cp_task_t *task) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Waits until all the tasks submitted using the specified plug-in context
+ * have completed. A plug-in uses its own plug-in context to wait for its
+ * tasks and the main program uses its context to wait for the tasks it
+ * has submitted, including the tasks submitted without a handle.
+ *
+ * @param ctx the plug-in context
+ */
+CP_C_API void cp_wait_tasks(cp_context_t *ctx) CP_GCC_NONNULL(1);
+
 /**
  * Sets startup arguments for the specified plug-in context. Like for usual
  * C main functions, the first argument is expected to be the name of the
@@ -1585,6 +3520,55 @@ CP_C_API void cp_set_context_args(cp_context_t *ctx, char **argv) CP_GCC_NONNULL
  */
 CP_C_API char **cp_get_context_args(cp_context_t *ctx, int *argc) CP_GCC_NONNULL(1);
 
+/**
+ * Registers a fork handler to be called when the process is forked into
+ * worker processes after the plug-ins have been started. This function is
+ * intended to be used by a plug-in runtime, typically in the start
+ * function. Fork handlers are called in the order of registration by
+ * ::cp_after_fork. The handlers registered by a plug-in are unregistered
+ * automatically when the plug-in is stopped.
+ *
+ * @param ctx the plug-in context
+ * @param handler the fork handler
+ * @param user_data the user data pointer passed to the handler
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if insufficient memory
+ */
+CP_C_API cp_status_t cp_register_fork_handler(cp_context_t *ctx, cp_fork_handler_func_t handler, void *user_data) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Unregisters a previously registered fork handler. Does nothing if the
+ * handler has not been registered.
+ *
+ * @param ctx the plug-in context
+ * @param handler the fork handler
+ */
+CP_C_API void cp_unregister_fork_handler(cp_context_t *ctx, cp_fork_handler_func_t handler) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Prepares a plug-in context in the main program for forking worker
+ * processes. The framework threads associated with the context, that
+ * is directory watches, the plug-in event dispatcher and the asynchronous
+ * log drainer, are stopped because threads do not survive a fork. Queued
+ * events and log messages are delivered first and batch listeners and
+ * loggers are invoked synchronously afterwards. The main program should
+ * call this function after the plug-ins have been started and runtime
+ * libraries loaded, for example using ::cp_resolve_plugins, and it must
+ * not use the context from other threads while forking.
+ *
+ * @param ctx the plug-in context
+ */
+CP_C_API void cp_prepare_fork(cp_context_t *ctx) CP_GCC_NONNULL(1);
+
+/**
+ * Invokes the registered fork handlers in a worker process forked from
+ * a process where the context was prepared using ::cp_prepare_fork. The
+ * worker process should call this function once after the fork, before
+ * running the plug-ins.
+ *
+ * @param ctx the plug-in context
+ */
+CP_C_API void cp_after_fork(cp_context_t *ctx) CP_GCC_NONNULL(1);
+
 /*@}*/
 
 
@@ -1612,6 +3596,23 @@ CP_C_API char **cp_get_context_args(cp_context_t *ctx, int *argc) CP_GCC_NONNULL
  */
 CP_C_API cp_status_t cp_define_symbol(cp_context_t *ctx, const char *name, void *ptr) CP_GCC_NONNULL(1, 2, 3);
 
+/**
+ * Defines a table of context specific symbols. This is like calling
+ * ::cp_define_symbol for each entry of the table except that the table is
+ * used in place, so defining it takes constant time and the table must
+ * remain valid until the plug-in is stopped, typically as static constant
+ * data. The names in the table must be unique and they must not be
+ * defined using ::cp_define_symbol. Symbols defined using
+ * ::cp_define_symbol take precedence over the tables and the tables are
+ * searched in the order of definition.
+ *
+ * @param ctx the plug-in context
+ * @param table the symbol table
+ * @param num the number of entries in the table
+ * @return @ref CP_OK (zero) on success, @ref CP_ERR_CONFLICT if the table has already been defined or @ref CP_ERR_RESOURCE if insufficient memory
+ */
+CP_C_API cp_status_t cp_define_symbols(cp_context_t *ctx, const cp_symbol_def_t *table, unsigned int num) CP_GCC_NONNULL(1, 2);
+
 /**
  * Resolves a symbol provided by the specified plug-in. The plug-in is started
  * automatically if it is not already active. The symbol may be context
@@ -1621,6 +3622,8 @@ CP_C_API cp_status_t cp_define_symbol(cp_context_t *ctx, const char *name, void
  * ::cp_release_symbol when it is not needed anymore. Pointers obtained from
  * this function must not be passed on to other plug-ins or the main
  * program.
+ * Resolving a symbol which is already in use by the calling context is
+ * cheap and does not require exclusive access to the plug-in context.
  * 
  * When a plug-in runtime calls this function the plug-in framework creates
  * a dynamic dependency from the symbol using plug-in to the symbol
@@ -1644,6 +3647,23 @@ CP_C_API cp_status_t cp_define_symbol(cp_context_t *ctx, const char *name, void
  */
 CP_C_API void *cp_resolve_symbol(cp_context_t *ctx, const char *id, const char *name, cp_status_t *status) CP_GCC_NONNULL(1, 2, 3);
 
+/**
+ * Resolves several symbols provided by the specified plug-in. This is
+ * equivalent to calling ::cp_resolve_symbol for each name but the plug-in
+ * context is locked only once. Either all the symbols are resolved or none
+ * of them are. On failure the symbols resolved so far are released and
+ * the symbol array is cleared. Each resolved symbol must be released
+ * separately using ::cp_release_symbol.
+ *
+ * @param ctx the plug-in context
+ * @param id the identifier of the symbol defining plug-in
+ * @param names the names of the symbols
+ * @param symbols the array where the symbol pointers are to be stored
+ * @param num the number of symbols
+ * @return @ref CP_OK (zero) on success or a status code on failure
+ */
+CP_C_API cp_status_t cp_resolve_symbols(cp_context_t *ctx, const char *id, const char * const *names, void **symbols, int num) CP_GCC_NONNULL(1, 2, 3, 4);
+
 /**
  * Releases a previously obtained symbol. The pointer must not be used after
  * the symbol has been released. The symbol is released
@@ -1662,9 +3682,9 @@ CP_C_API void cp_release_symbol(cp_context_t *ctx, const void *ptr) CP_GCC_NONNU
  * @defgroup cFuncsLoaders Plug-in loaders
  * @ingroup cFuncs
  *
- * These functions are used to construct standard plug-in loaders. Currently
- * there is a single plug-in loader for loading plug-ins from local plug-in
- * collections. 
+ * These functions are used to construct standard plug-in loaders. There are
+ * plug-in loaders for loading plug-ins from local plug-in collections, from
+ * ZIP archives and from remote plug-in repositories.
  */
 /*@{*/
 
@@ -1694,7 +3714,9 @@ CP_C_API void cp_destroy_local_ploader(cp_plugin_loader_t *loader) CP_GCC_NONNUL
 /**
  * Registers a new directory to be scanned by the specified local
  * plug-in loader. Returns @ref CP_OK if the directory has already been
- * registered.
+ * registered. If the registered path is a file rather than a directory,
+ * it is loaded as a plug-in bundle written using ::cp_write_plugin_image.
+ * An incremental scan only loads a bundle if the file has changed.
  *
  * @param loader the plug-in loader obtained from ::cp_create_local_ploader
  * @param dir the directory to register
@@ -1720,6 +3742,138 @@ CP_C_API void cp_lpl_unregister_dir(cp_plugin_loader_t *loader, const char *dir)
  */
 CP_C_API void cp_lpl_unregister_dirs(cp_plugin_loader_t *loader) CP_GCC_NONNULL(1);
 
+/**
+ * Sets the number of threads the specified local plug-in loader uses for
+ * reading and parsing plug-in descriptors when scanning for plug-ins.
+ * By default, or if the number of threads is zero or one, descriptors are
+ * loaded one at a time by the thread scanning for plug-ins. Otherwise
+ * descriptors are parsed in parallel and the results are merged in the
+ * original scan order, so the set of plug-ins found and the messages logged
+ * are the same regardless of the number of threads. This setting has no
+ * effect if the framework was built without multi-threading support.
+ *
+ * @param loader the plug-in loader obtained from ::cp_create_local_ploader
+ * @param num_threads the number of threads to use, including the scanning thread
+ */
+CP_C_API void cp_lpl_set_scan_threads(cp_plugin_loader_t *loader, unsigned int num_threads) CP_GCC_NONNULL(1);
+
+/**
+ * Starts watching the directories registered with the specified local
+ * plug-in loader for changes. A background thread waits for file system
+ * change notifications and, once no further changes have been reported
+ * during the debounce period, calls ::cp_scan_plugins for the specified
+ * context with the specified @ref cScanFlags "flags" and #CP_SP_INCREMENTAL.
+ * Changes reported continuously postpone the scan by at most four debounce
+ * periods from the first change, so the changes made during that time are
+ * scanned together.
+ * Such scans only check the plug-in directories affected by the changes
+ * instead of all the registered directories. Directories registered or
+ * unregistered while watching are taken into account automatically.
+ *
+ * Watching is supported on systems providing inotify and only when the
+ * framework has been built with multi-threading support. Any previous
+ * watch of the loader is stopped first. The watch is stopped using
+ * ::cp_lpl_unwatch_dirs or when the loader or the context is destroyed.
+ *
+ * @param loader the plug-in loader obtained from ::cp_create_local_ploader
+ * @param ctx the plug-in context to be scanned on changes
+ * @param flags the flags passed to ::cp_scan_plugins
+ * @param debounce_ms the time in milliseconds without changes before scanning
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if watching
+ * 		is not supported or insufficient system resources
+ */
+CP_C_API cp_status_t cp_lpl_watch_dirs(cp_plugin_loader_t *loader, cp_context_t *ctx, int flags, unsigned int debounce_ms) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Stops watching the directories registered with the specified local
+ * plug-in loader. Waits for a scan triggered by the watch to complete.
+ * Therefore this function must not be called while holding the context
+ * lock, that is from within framework callbacks or plug-in runtime
+ * functions. Does nothing if the directories are not being watched.
+ *
+ * @param loader the plug-in loader obtained from ::cp_create_local_ploader
+ */
+CP_C_API void cp_lpl_unwatch_dirs(cp_plugin_loader_t *loader) CP_GCC_NONNULL(1);
+
+/**
+ * Creates and returns a new instance of an archive plug-in loader. The
+ * loader loads plug-ins from a ZIP archive laid out like a local plug-in
+ * collection, that is each top level directory of the archive containing
+ * a plug-in descriptor is a plug-in. The descriptors are read directly from
+ * the archive using its central directory, which is indexed when the loader
+ * is created. The archive must not be modified while the loader exists.
+ * The files of a plug-in are extracted into a same-named directory under
+ * @a extract_dir only when the plug-in runtime library is needed, and the
+ * plug-in path of the loaded plug-ins refers to that directory. Archive
+ * members must be stored or, if the framework was built with zlib,
+ * deflated. The created plug-in loader can be registered with a plug-in
+ * context using ::cp_register_ploader and it is released by calling
+ * ::cp_destroy_archive_ploader.
+ *
+ * @param archive the archive file
+ * @param extract_dir the directory into which plug-in files are extracted
+ * @param status pointer to the location where status code is to be stored, or NULL
+ * @return the new plug-in loader instance, or NULL on failure
+ */
+CP_C_API cp_plugin_loader_t *cp_create_archive_ploader(const char *archive, const char *extract_dir, cp_status_t *status) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Releases the resources allocated by a previously created archive plug-in
+ * loader. The specified loader must have been obtained by a call to
+ * ::cp_create_archive_ploader. The loader to be destroyed must not be
+ * registered with any plug-in context. The extracted files are not removed.
+ *
+ * @param loader the plug-in loader to be destroyed
+ */
+CP_C_API void cp_destroy_archive_ploader(cp_plugin_loader_t *loader) CP_GCC_NONNULL(1);
+
+/**
+ * Creates and returns a new instance of a repository plug-in loader. The
+ * loader loads plug-ins from a remote plug-in repository using the
+ * specified fetch function. Each scan fetches the repository index, a
+ * text file whose lines each hold the digest of a file followed by its
+ * path in the repository. The files are laid out like a local plug-in
+ * collection. Files are stored in a local cache under @a cache_dir keyed by
+ * their digests, and only files whose digest is not cached yet are fetched,
+ * in parallel if so configured using ::cp_rpl_set_fetch_threads. The files
+ * of a plug-in directory are then made available in a local plug-in
+ * directory named after the contents of the directory. An incremental scan
+ * only loads the plug-ins whose files have changed since the previous scan.
+ * If the index can not be fetched, the previously fetched index is used.
+ * The created plug-in loader can be registered with a plug-in context
+ * using ::cp_register_ploader and it is released by calling
+ * ::cp_destroy_repository_ploader.
+ *
+ * @param cache_dir the local cache directory
+ * @param fetch the function fetching files from the repository
+ * @param user_data the user data pointer passed to the fetch function
+ * @param status pointer to the location where status code is to be stored, or NULL
+ * @return the new plug-in loader instance, or NULL on failure
+ */
+CP_C_API cp_plugin_loader_t *cp_create_repository_ploader(const char *cache_dir, cp_fetch_func_t fetch, void *user_data, cp_status_t *status) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Releases the resources allocated by a previously created repository
+ * plug-in loader. The specified loader must have been obtained by a call
+ * to ::cp_create_repository_ploader. The loader to be destroyed must not
+ * be registered with any plug-in context. The local cache is left intact.
+ *
+ * @param loader the plug-in loader to be destroyed
+ */
+CP_C_API void cp_destroy_repository_ploader(cp_plugin_loader_t *loader) CP_GCC_NONNULL(1);
+
+/**
+ * Sets the number of threads the specified repository plug-in loader uses
+ * for fetching files. By default, or if the number of threads is zero or
+ * one, files are fetched one at a time by the thread scanning for plug-ins.
+ * This setting has no effect if the framework was built without
+ * multi-threading support.
+ *
+ * @param loader the plug-in loader obtained from ::cp_create_repository_ploader
+ * @param num_threads the number of threads to use, including the scanning thread
+ */
+CP_C_API void cp_rpl_set_fetch_threads(cp_plugin_loader_t *loader, unsigned int num_threads) CP_GCC_NONNULL(1);
+
 /*@}*/
 
 
@@ -43,6 +43,7 @@
 #include "../kazlib/list.h"
 #include "../kazlib/hash.h"
 #include "cpluff.h"
+#include "util.h"
 #ifdef CP_THREADS
 #include "thread.h"
 #endif
@@ -85,6 +86,12 @@ extern "C" {
 /// Plugin descriptor's default root xml element
 #define CP_PLUGIN_ROOT_ELEMENT "plugin"
 
+/// The number of run priority classes
+#define CPI_RUN_PRIO_CLASSES (CP_RUN_PRIO_INTERACTIVE + 1)
+
+/// The number of slots for extension point and plug-in state generations
+#define CPI_GENERATION_SLOTS 64
+
 
 /* ------------------------------------------------------------------------
  * Macros
@@ -93,12 +100,14 @@ extern "C" {
 #if defined(DLOPEN_POSIX)
 #define DLHANDLE void *
 #define DLOPEN(name) dlopen((name), RTLD_LAZY | RTLD_GLOBAL)
+#define DLOPEN_NOW(name) dlopen((name), RTLD_NOW | RTLD_GLOBAL)
 #define DLSYM(handle, symbol) dlsym((handle), (symbol))
 #define DLCLOSE(handle) dlclose(handle)
 #define DLERROR() dlerror()
 #elif defined(DLOPEN_LIBTOOL)
 #define DLHANDLE lt_dlhandle
 #define DLOPEN(name) lt_dlopen(name)
+#define DLOPEN_NOW(name) lt_dlopen(name)
 #define DLSYM(handle, symbol) lt_dlsym((handle), (symbol))
 #define DLCLOSE(handle) lt_dlclose(handle)
 #define DLERROR() lt_dlerror()
@@ -120,6 +129,11 @@ extern "C" {
 
 typedef struct cp_plugin_t cp_plugin_t;
 typedef struct cp_plugin_env_t cp_plugin_env_t;
+typedef struct cpi_log_record_t cpi_log_record_t;
+typedef struct cpi_logger_t cpi_logger_t;
+typedef struct cpi_info_header_t cpi_info_header_t;
+typedef struct cpi_lazy_cfg_t cpi_lazy_cfg_t;
+typedef struct cpi_plugin_image_t cpi_plugin_image_t;
 
 // Plug-in context
 struct cp_context_t {
@@ -135,6 +149,19 @@ struct cp_context_t {
 
 	/// Information about symbol providing plugins or NULL if not initialized
 	hash_t *symbol_providers;
+
+	/// Maps plug-in and symbol names to currently used symbols or NULL if not initialized
+	hash_t *symbol_cache;
+
+#ifdef CP_THREADS
+
+	/// Mutex protecting symbol usage counts for shared lock holders
+	cpi_mutex_t *symbols_mutex;
+
+#endif
+
+	/// The node of a main program context in its shard of the context registry
+	lnode_t registry_node;
 	
 };
 
@@ -163,42 +190,263 @@ struct cp_plugin_env_t {
 	/// Plugin descriptor's XML root element
 	const char *plugin_descriptor_root_element;
 
-	/// Installed plug-in listeners 
+	/// Directory of the persistent descriptor cache, or NULL if disabled
+	char *descriptor_cache_dir;
+
+	/// Whether extension configuration is parsed on first access
+	int lazy_ext_cfg;
+
+	/// The number of threads preloading runtime libraries, or 0 if disabled
+	unsigned int preload_threads;
+
+	/// Whether preloading binds the runtime libraries immediately
+	int preload_prebind;
+
+	/// Whether runtime libraries are loaded when plug-ins are started
+	int lazy_runtime;
+
+	/// Whether runtime libraries are kept open until the process exits
+	int keep_runtime_libs;
+
+	/// Idle descriptor parsers kept for reuse, or NULL if none
+	struct ploader_context_t *idle_parsers;
+
+	/// The number of idle descriptor parsers
+	unsigned int num_idle_parsers;
+
+#ifdef CP_THREADS
+
+	/// Mutex protecting the idle descriptor parsers
+	cpi_mutex_t *parsers_mutex;
+
+#endif
+
+	/// Installed plug-in listeners not filtering by plug-in identifier
 	list_t *plugin_listeners;
 	
+	/// Maps interned plug-in identifiers to lists of plug-in listeners
+	hash_t *plisteners_by_id;
+	
+	/// Installed plug-in listeners filtering by plug-in identifier prefix
+	list_t *prefix_plisteners;
+
+	/// Installed batch plug-in listeners
+	list_t *batch_listeners;
+
+	/// Registered fork handlers in registration order
+	list_t *fork_handlers;
+
+	/// The registry generation, advanced for every recorded change
+	volatile long generation;
+
+	/// The generation of the latest change to the installed plug-ins
+	volatile long plugins_generation;
+
+	/// Extension generations, indexed by a hash of the extension point identifier
+	volatile long ext_generations[CPI_GENERATION_SLOTS];
+
+	/// Plug-in state generations, indexed by a hash of the plug-in identifier
+	volatile long state_generations[CPI_GENERATION_SLOTS];
+
+	/// The number of pool tasks submitted by the main program and not yet completed
+	int num_tasks;
+
+	/// The number of plug-ins having a plug-in handle
+	int num_plugin_handles;
+
+	/// The change feed ring buffer or NULL if not enabled
+	cp_change_t *changes;
+
+	/// The index of the oldest change in the change feed
+	unsigned int changes_head;
+
+	/// The number of changes in the change feed
+	unsigned int num_changes;
+
+	/// The generation of the latest change discarded from the change feed
+	unsigned long changes_discarded;
+	
+	/// Events queued for batch delivery, or NULL if none allocated
+	cp_plugin_event_t *event_queue;
+	
+	/// The number of queued events
+	unsigned int num_queued_events;
+	
+	/// The capacity of the event queue
+	unsigned int event_queue_size;
+	
+	/// Events being delivered to batch listeners, or NULL if none allocated
+	cp_plugin_event_t *event_batch;
+	
+	/// The capacity of the event batch buffer
+	unsigned int event_batch_size;
+	
+	/// Whether batch listeners are currently being invoked
+	int in_batch_delivery;
+
+#ifdef CP_THREADS
+
+	/// The event dispatcher thread, or NULL if not running
+	cpi_thread_t *event_dispatcher;
+	
+	/// Whether the event dispatcher thread should exit
+	int event_dispatcher_shutdown;
+
+#endif
+	
 	/// Registered loggers
 	list_t *loggers;
 
-	/// Minimum logger selection severity
+	/// Minimum logger selection severity of loggers without a plug-in filter
 	int log_min_severity;
 
+	/// Maps plug-in identifiers to the least severe filtered logger for the plug-in
+	hash_t *log_filters;
+	
+	/// Minimum logger selection severity of loggers with a plug-in filter
+	int log_filter_min_severity;
+	
+	/// Storage for the logger buckets
+	cpi_logger_t **log_index;
+	
+	/// The capacity of the logger bucket storage
+	size_t log_index_size;
+	
+	/// NULL terminated arrays of the loggers interested in each severity
+	cpi_logger_t **log_buckets[CP_LOG_ERROR + 1];
+
+	/// Ring of log records for asynchronous delivery, or NULL if synchronous
+	cpi_log_record_t *log_ring;
+	
+	/// The capacity of the log ring
+	unsigned int log_ring_size;
+	
+	/// Index of the oldest queued log record
+	unsigned int log_ring_head;
+	
+	/// The number of queued log records
+	unsigned int log_ring_count;
+	
+	/// The number of log records dropped since the last delivery
+	unsigned long log_overflows;
+	
+	/// Whether log records are currently being delivered to loggers
+	int in_log_delivery;
+
+#ifdef CP_THREADS
+
+	/// The log drain thread, or NULL if not running
+	cpi_thread_t *log_drainer;
+	
+	/// Whether the log drain thread is being shut down
+	int log_drainer_shutdown;
+
+#endif
+
     /// The implicit local plug-in loader, or NULL if none
     cp_plugin_loader_t *local_loader;
 
 	/// Maps registered plug-in loaders to the lists of plug-in identifiers
 	hash_t *loaders_to_plugins;
 	
-	/// Map of in-use reference counted information objects
-	hash_t *infos;
+	/// List of in-use reference counted information objects
+	cpi_info_header_t *infos;
+
+	/// Index of in-use information objects keyed by address, used to detect unknown objects
+	hash_t *infos_index;
+
+#ifdef CP_THREADS
+
+	/// Mutex protecting the information object list for shared lock holders
+	cpi_mutex_t *infos_mutex;
+
+#endif
+
+	/// Interned identifiers used as keys of the plug-in and extension maps
+	cpi_strpool_t *strings;
 
-	/// Maps plug-in identifiers to plug-in state structures 
+	/// Pool of list and map nodes, used with exclusive access to the contexts
+	cpi_node_pool_t *nodes;
+
+	/// Maps interned plug-in identifiers to plug-in state structures 
 	hash_t *plugins;
 
-	/// List of started plug-ins in the order they were started 
-	list_t *started_plugins;
+	/// Set of started plug-ins in the order they were started 
+	cpi_ptrset_t *started_plugins;
 
-	/// Maps extension point names to installed extension points
+	/// Maps interned extension point names to installed extension points
 	hash_t *ext_points;
 	
-	/// Maps extension point names to installed extensions
+	/// Maps interned extension point names to arrays of installed extensions
 	hash_t *extensions;
+
+	/// The nodes of the extensions map sorted by extension point name, for prefix queries
+	hnode_t **ext_index;
+
+	/// The number of nodes in the extension index
+	int num_ext_index;
+
+	/// The allocated size of the extension index
+	int size_ext_index;
+
+	/// The resolved plug-ins in resolution order, or NULL if not known
+	cp_plugin_t **resolve_order;
+	
+	/// The number of plug-ins in the resolution order
+	int num_resolve_order;
+	
+	/// The status of resolving all plug-ins, valid with the resolution order
+	cp_status_t resolve_status;
+
+#ifdef CP_THREADS
+
+	/// Mutex protecting the extension snapshot pointer and reference counts
+	cpi_mutex_t *snapshot_mutex;
+
+#endif
+
+	/// The published extension snapshot, or NULL if not built
+	cp_ext_snapshot_t *ext_snapshot;
+
+	/// Retired extension snapshots waiting to be released
+	list_t *retired_snapshots;
+
+	/// The installed plug-ins serialized for ::cp_create_context_from, or NULL if not built
+	cpi_plugin_image_t *template_image;
 	
-	/// FIFO queue of run functions, currently running functions at front
+	/// FIFO queue of run functions, currently running and parked functions at front
 	list_t *run_funcs;
 	
 	/// First waiting run function, or NULL if none
 	lnode_t *run_wait;
 
+	/// Number of parked run functions waiting for a deadline or a file descriptor
+	unsigned int num_scheduled_runs;
+
+	/// Whether a thread is waiting for scheduled run functions to become ready
+	int run_polling;
+
+	/// Whether the run wake-up pipe has been created
+	int has_run_wake;
+
+	/// A pipe used to wake up a thread waiting for scheduled run functions
+	int run_wake[2];
+
+	/// Whether the run readiness pipe has been created
+	int has_run_ready;
+
+	/// Whether the run readiness pipe currently holds a readiness byte
+	int run_ready_signaled;
+
+	/// A pipe readable while there are run functions waiting to be run
+	int run_ready[2];
+
+	/// The virtual start time of the most recently dispatched run function
+	unsigned long long run_vtime;
+
+	/// The virtual finish times of the run priority classes
+	unsigned long long run_class_vtime[CPI_RUN_PRIO_CLASSES];
+
 	/// Is logger currently being invoked
 	int in_logger_invocation;
 
@@ -207,6 +455,9 @@ struct cp_plugin_env_t {
 	
 	/// Whether currently in start function invocation
 	int in_start_func_invocation;
+
+	/// Number of start or stop functions being executed by parallel starts or stops
+	int num_parallel_starts;
 	
 	/// Whether currently in stop function invocation
 	int in_stop_func_invocation;
@@ -222,6 +473,17 @@ struct cp_plugin_env_t {
 	
 };
 
+/// A static symbol table
+typedef struct cpi_symbol_table_t {
+
+	/// The table entries, or NULL if none
+	const cp_symbol_def_t *defs;
+
+	/// The number of entries
+	unsigned int num;
+
+} cpi_symbol_table_t;
+
 // Plug-in instance
 struct cp_plugin_t {
 	
@@ -238,10 +500,10 @@ struct cp_plugin_t {
 	cp_plugin_state_t state;
 	
 	/// The set of imported plug-ins, or NULL if not resolved 
-	list_t *imported;
+	cpi_ptrset_t *imported;
 	
 	/// The set of plug-ins importing this plug-in 
-	list_t *importing;
+	cpi_ptrset_t *importing;
 	
 	/// The runtime library handle, or NULL if not resolved 
 	DLHANDLE runtime_lib;
@@ -249,14 +511,57 @@ struct cp_plugin_t {
 	/// Plug-in runtime function information, or NULL if not resolved
 	cp_plugin_runtime_t *runtime_funcs;
 
+	/// Whether the plug-in is a built-in plug-in linked into the executable
+	int builtin;
+
+	/// The runtime functions of a built-in plug-in, or NULL if none
+	cp_plugin_runtime_t *builtin_runtime;
+
+	/// The static symbol table of a built-in plug-in, or NULL if none
+	const cp_builtin_symbol_t *builtin_symbols;
+
 	/// Plug-in instance data or NULL if instance does not exist
 	void *plugin_data;
 	
 	/// Context specific symbols defined by the plug-in
 	hash_t *defined_symbols;
+
+	/// Static symbol tables defined by the plug-in, or NULL if none
+	cpi_symbol_table_t *symbol_tables;
+
+	/// The number of static symbol tables defined by the plug-in
+	int num_symbol_tables;
+	
+	/// The slot indices of the extensions in the extension arrays, or NULL
+	int *ext_slots;
 	
 	/// Used by recursive operations: has this plug-in been processed already
 	int processed;
+
+	/// Whether the start or stop function is being executed by a parallel start or stop
+	int parallel_start;
+	
+	/// The number of run functions of the plug-in currently in execution
+	int num_running_funcs;
+
+	/// The number of pool tasks submitted by the plug-in and not yet completed
+	int num_tasks;
+
+	/// The plug-in handle, or NULL if none has been requested
+	cp_plugin_handle_t *handle;
+
+#ifdef CP_THREADS
+
+	/// Signaled when run functions or pool tasks of the plug-in complete, or NULL if not created
+	cpi_cond_t *idle_cond;
+
+	/// The number of threads waiting for the plug-in to become idle
+	int num_idle_waiters;
+
+#endif
+
+	/// Timing statistics of the plug-in
+	cp_plugin_stats_t stats;
 	
 };
 
@@ -270,6 +575,59 @@ struct cp_plugin_t {
  */
 typedef void (*cpi_dealloc_func_t)(cp_context_t *ctx, void *resource);
 
+/**
+ * The header immediately preceding each reference counted information
+ * object. The reference count is updated atomically so that using and
+ * releasing an object requires neither a look-up nor the context lock
+ * in exclusive mode. Information objects must not require stricter
+ * alignment than pointers.
+ */
+struct cpi_info_header_t {
+	
+	/// The usage count of the object
+	volatile long usage_count;
+	
+	/// The deallocation function, or NULL if not registered
+	cpi_dealloc_func_t dealloc_func;
+	
+	/// The previous registered object, or NULL if first
+	cpi_info_header_t *prev;
+	
+	/// The next registered object, or NULL if last
+	cpi_info_header_t *next;
+	
+	/// The allocated size including the header, or zero for plug-in information
+	size_t size;
+	
+	/// The plug-in whose context registered the object, or NULL
+	cp_plugin_t *owner;
+
+	/// The node of the object in the index of registered objects
+	hnode_t index_node;
+	
+};
+
+/**
+ * Returns the header of the specified information object.
+ * 
+ * @param info the information object
+ * @return the header
+ */
+#define CPI_INFO_HEADER(info) ((cpi_info_header_t *) (info) - 1)
+
+/// A stable plug-in handle, registered as an information object
+struct cp_plugin_handle_t {
+
+	/// The plug-in state, updated atomically at state changes
+	volatile long state;
+
+	/// Whether the plug-in is still installed, updated atomically
+	volatile long installed;
+
+	/// The plug-in information, held by the handle
+	cp_plugin_info_t *plugin;
+};
+
 typedef struct cpi_plugin_event_t cpi_plugin_event_t;
 
 /// Plug-in event information
@@ -322,6 +680,27 @@ CP_HIDDEN void cpi_lock_context(cp_context_t *context) CP_GCC_NONNULL(1);
  */
 CP_HIDDEN void cpi_unlock_context(cp_context_t *context) CP_GCC_NONNULL(1);
 
+/**
+ * Acquires shared read-only access to a plug-in context. Several threads
+ * may hold shared access at the same time. The holder may look up the
+ * plug-in and extension maps and acquire or release information objects
+ * but it must not modify other state nor log messages. The holder may lock
+ * the context again in either mode, but acquiring exclusive access lets
+ * other threads modify the context before it is granted. Falls back to
+ * exclusive access if debug messages are being logged or if the calling
+ * thread already holds exclusive access.
+ * 
+ * @param context the plug-in context
+ */
+CP_HIDDEN void cpi_lock_context_shared(cp_context_t *context) CP_GCC_NONNULL(1);
+
+/**
+ * Releases access acquired using @ref cpi_lock_context_shared.
+ * 
+ * @param context the plug-in context
+ */
+CP_HIDDEN void cpi_unlock_context_shared(cp_context_t *context) CP_GCC_NONNULL(1);
+
 /**
  * Waits until the specified plug-in context is signalled.
  * 
@@ -339,6 +718,8 @@ CP_HIDDEN void cpi_signal_context(cp_context_t *context) CP_GCC_NONNULL(1);
 #else
 #define cpi_lock_context(dummy) do {} while (0)
 #define cpi_unlock_context(dummy) do {} while (0)
+#define cpi_lock_context_shared(dummy) do {} while (0)
+#define cpi_unlock_context_shared(dummy) do {} while (0)
 #define cpi_wait_context(dummy) do {} while (0)
 #define cpi_signal_context(dummy) do {} while (0)
 #define cpi_lock_framework() do {} while(0)
@@ -390,6 +771,44 @@ CP_HIDDEN void cpi_log(cp_context_t *ctx, cp_log_severity_t severity, const char
  */
 CP_HIDDEN void cpi_logf(cp_context_t *ctx, cp_log_severity_t severity, const char *msg, ...) CP_GCC_PRINTF(3, 4) CP_GCC_NONNULL(1, 3);
 
+/**
+ * Logs a structured message. Structured loggers receive the record as is
+ * while the text is formatted only if a text logger is interested in the
+ * message. The activating plug-in is filled in by this function. The
+ * caller must have locked the context.
+ * 
+ * @param ctx the related plug-in context
+ * @param rec the log record
+ */
+CP_HIDDEN void cpi_log_record(cp_context_t *ctx, const cp_log_record_t *rec) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Logs a structured message with the specified arguments. The caller must
+ * have locked the context.
+ * 
+ * @param ctx the related plug-in context
+ * @param severity the severity of the message
+ * @param msg_id the message identifier
+ * @param plugin_id the plug-in identifier argument or NULL
+ * @param str the string argument or NULL
+ * @param address the address argument or NULL
+ * @param count the count argument
+ */
+CP_HIDDEN void cpi_logm(cp_context_t *ctx, cp_log_severity_t severity, cp_log_msg_t msg_id, const char *plugin_id, const char *str, const void *address, int count) CP_GCC_NONNULL(1);
+
+/**
+ * Returns whether a logger with a plug-in filter is interested in messages
+ * of the specified severity activated by the plug-in of the specified
+ * context or concerning the specified plug-in. Use ::cpi_is_logged or
+ * ::cpi_is_logged_about instead of calling this function directly.
+ * 
+ * @param ctx the plug-in context
+ * @param severity the severity
+ * @param plugin_id the identifier of the plug-in concerned or NULL
+ * @return whether the messages are logged by a filtered logger
+ */
+CP_HIDDEN int cpi_is_logged_filtered(cp_context_t *ctx, cp_log_severity_t severity, const char *plugin_id) CP_GCC_NONNULL(1);
+
 /**
  * Returns whether the messages of the specified severity level are
  * being logged for the specified context. The caller must have locked the context.
@@ -398,7 +817,19 @@ CP_HIDDEN void cpi_logf(cp_context_t *ctx, cp_log_severity_t severity, const cha
  * @param severity the severity
  * @return whether the messages of the specified severity level are logged
  */
-#define cpi_is_logged(context, severity) (assert(cpi_is_context_locked(context)), (severity) >= (context)->env->log_min_severity)
+#define cpi_is_logged(context, severity) cpi_is_logged_about((context), (severity), NULL)
+
+/**
+ * Returns whether the messages of the specified severity level concerning
+ * the specified plug-in are being logged for the specified context. The
+ * caller must have locked the context.
+ * 
+ * @param ctx the plug-in context
+ * @param severity the severity
+ * @param plugin_id the identifier of the plug-in concerned or NULL
+ * @return whether the messages of the specified severity level are logged
+ */
+#define cpi_is_logged_about(context, severity, plugin_id) (assert(cpi_is_context_locked(context)), (severity) >= (context)->env->log_min_severity || ((severity) >= (context)->env->log_filter_min_severity && cpi_is_logged_filtered((context), (severity), (plugin_id))))
 
 // Convenience macros for efficient logging
 #define cpi_log_cond(ctx, level, msg) do { if (cpi_is_logged((ctx), (level))) cpi_log((ctx), (level), (msg)); } while (0)
@@ -411,34 +842,172 @@ CP_HIDDEN void cpi_logf(cp_context_t *ctx, cp_log_severity_t severity, const cha
 #define cpi_infof(ctx, msg, ...) cpi_logf_cond((ctx), CP_LOG_INFO, (msg), __VA_ARGS__)
 #define cpi_debug(ctx, msg) cpi_log_cond((ctx), CP_LOG_DEBUG, (msg))
 #define cpi_debugf(ctx, msg, ...) cpi_logf_cond((ctx), CP_LOG_DEBUG, (msg), __VA_ARGS__)
+#define cpi_logm_cond(ctx, level, id, pid, str, addr, count) do { if (cpi_is_logged_about((ctx), (level), (pid))) cpi_logm((ctx), (level), (id), (pid), (str), (addr), (count)); } while (0)
+#define cpi_infom(ctx, id, pid, str, addr, count) cpi_logm_cond((ctx), CP_LOG_INFO, (id), (pid), (str), (addr), (count))
+#define cpi_debugm(ctx, id, pid, str, addr, count) cpi_logm_cond((ctx), CP_LOG_DEBUG, (id), (pid), (str), (addr), (count))
+
+/**
+ * Formats a message and either logs it or appends it to a deferred message
+ * log to be delivered later using ::cpi_flush_deferred_log. Deferring is
+ * intended for worker threads acting on behalf of a thread holding the
+ * context lock. Such worker threads must not invoke loggers directly.
+ * The message is only formatted if the specified severity is being
+ * logged. If @a log is NULL then the message is logged immediately and the
+ * caller must have locked the context.
+ * 
+ * @param ctx the related plug-in context
+ * @param log the deferred message log or NULL to log immediately
+ * @param severity the severity of the message
+ * @param msg the localized message format
+ * @param ... the message parameters
+ */
+CP_HIDDEN void cpi_logf_deferred(cp_context_t *ctx, list_t *log, cp_log_severity_t severity, const char *msg, ...) CP_GCC_PRINTF(4, 5) CP_GCC_NONNULL(1, 4);
 
 /**
- * Unregisters loggers in the specified logger list. Either unregisters all
- * loggers or only loggers installed by the specified plug-in.
+ * Delivers and removes the messages in the specified deferred message log.
+ * The caller must have locked the context.
  * 
- * @param loggers the logger list
+ * @param ctx the related plug-in context
+ * @param log the deferred message log
+ */
+CP_HIDDEN void cpi_flush_deferred_log(cp_context_t *ctx, list_t *log) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Unregisters loggers of the specified context. Either unregisters all
+ * loggers or only loggers installed by the specified plug-in. Waits for an
+ * ongoing asynchronous delivery of log records to complete. The context
+ * must be locked.
+ * 
+ * @param context the plug-in context
  * @param plugin the plug-in whose loggers to unregister or NULL for all
  */
-CP_HIDDEN void cpi_unregister_loggers(list_t *loggers, cp_plugin_t *plugin) CP_GCC_NONNULL(1);
+CP_HIDDEN void cpi_unregister_loggers(cp_context_t *context, cp_plugin_t *plugin) CP_GCC_NONNULL(1);
+
+/**
+ * Delivers the queued log records and stops the log drain thread, if
+ * running. Logging is synchronous afterwards.
+ * 
+ * @param context the plug-in context
+ */
+CP_HIDDEN void cpi_stop_log_drainer(cp_context_t *context) CP_GCC_NONNULL(1);
+
+/**
+ * Unregisters plug-in listeners of the specified plug-in environment. Either
+ * unregisters all listeners or only listeners installed by the specified
+ * plug-in.
+ * 
+ * @param env the plug-in environment
+ * @param plugin the plug-in whose listeners to unregister or NULL for all
+ */
+CP_HIDDEN void cpi_unregister_plisteners(cp_plugin_env_t *env, cp_plugin_t *plugin) CP_GCC_NONNULL(1);
 
 /**
- * Unregisters plug-in listeners in the specified list. Either unregisters all
- * listeners or only listeners installed by the specified plug-in.
+ * Unregisters batch plug-in listeners installed by the specified plug-in
+ * or all batch listeners. Waits for an ongoing batch delivery to complete.
+ * The context must be locked.
  * 
- * @param listeners the listener list
+ * @param context the plug-in context
  * @param plugin the plug-in whose listeners to unregister or NULL for all
  */
-CP_HIDDEN void cpi_unregister_plisteners(list_t *listeners, cp_plugin_t *plugin) CP_GCC_NONNULL(1);
+CP_HIDDEN void cpi_unregister_batch_plisteners(cp_context_t *context, cp_plugin_t *plugin) CP_GCC_NONNULL(1);
+
+#ifdef CP_THREADS
+
+/**
+ * Initializes the shared thread pool. The workers are started on demand.
+ * 
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if insufficient resources
+ */
+CP_HIDDEN cp_status_t cpi_init_task_pool(void);
+
+/**
+ * Waits for the pool tasks to complete, stops the workers and releases
+ * the shared thread pool.
+ */
+CP_HIDDEN void cpi_release_task_pool(void);
+
+/**
+ * Waits for the pool tasks to complete and stops the workers, for example
+ * before forking. New workers are started when tasks are submitted again.
+ */
+CP_HIDDEN void cpi_quiesce_task_pool(void);
+
+/**
+ * Submits a framework executor function to the shared thread pool. Unlike
+ * tasks submitted by plug-ins, an executor is given a worker even if all
+ * the workers are busy, so executors may block waiting for each other.
+ * The task must be joined using ::cpi_join_task.
+ * 
+ * @param func the function to be executed
+ * @param arg the argument passed to the function
+ * @return the task or NULL if no resources available
+ */
+CP_HIDDEN cp_task_t *cpi_spawn_task(void (*func)(void *arg), void *arg) CP_GCC_NONNULL(1);
+
+/**
+ * Waits for an executor task to complete, executing it in the calling
+ * thread if it has not been started yet, and releases the task.
+ * 
+ * @param task the task
+ */
+CP_HIDDEN void cpi_join_task(cp_task_t *task) CP_GCC_NONNULL(1);
+
+#endif
+
+/**
+ * Cancels the queued pool tasks of the specified plug-in, or of the main
+ * program, and waits for its pool tasks in execution to complete. The
+ * context must be locked and it is released while waiting.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in or NULL for the main program
+ */
+CP_HIDDEN void cpi_drain_tasks(cp_context_t *context, cp_plugin_t *plugin) CP_GCC_NONNULL(1);
+
+/**
+ * Records a change of the plug-in registry by advancing the generations
+ * and appending the change to the change feed, if enabled. The context
+ * must be locked.
+ * 
+ * @param context the plug-in context
+ * @param type the @ref cChangeTypes "change type"
+ * @param id the affected plug-in or extension point identifier
+ */
+CP_HIDDEN void cpi_record_change(cp_context_t *context, int type, const char *id) CP_GCC_NONNULL(1, 3);
+
+/**
+ * Records the installation or uninstallation of the specified plug-in,
+ * including the changes to the extension points it contributes to. The
+ * context must be locked.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in information structure
+ */
+CP_HIDDEN void cpi_record_plugin_changes(cp_context_t *context, const cp_plugin_info_t *plugin) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Frees the change feed of the specified plug-in environment.
+ * 
+ * @param env the plug-in environment
+ */
+CP_HIDDEN void cpi_free_change_feed(cp_plugin_env_t *env) CP_GCC_NONNULL(1);
+
+/**
+ * Unregisters fork handlers installed by the specified plug-in or all
+ * fork handlers. The context must be locked.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in whose fork handlers to unregister or NULL for all
+ */
+CP_HIDDEN void cpi_unregister_fork_handlers(cp_context_t *context, cp_plugin_t *plugin) CP_GCC_NONNULL(1);
 
 /**
- * Returns the owner name for a context.
+ * Delivers the queued plug-in events and stops the event dispatcher
+ * thread, if running. The context must not be locked.
  * 
- * @param ctx the context
- * @param name the location where the name of the owner is to be stored
- * @param size maximum size of the owner string, including the terminating zero
- * @return the pointer passed in as @a name
+ * @param context the plug-in context
  */
-CP_HIDDEN char *cpi_context_owner(cp_context_t *ctx, char *name, size_t size) CP_GCC_NONNULL(1);
+CP_HIDDEN void cpi_stop_event_dispatcher(cp_context_t *context) CP_GCC_NONNULL(1);
 
 /**
  * Reports a fatal NULL argument to an API function.
@@ -482,10 +1051,31 @@ CP_HIDDEN cp_context_t * cpi_new_context(cp_plugin_t *plugin, cp_plugin_env_t *e
 CP_HIDDEN void cpi_free_context(cp_context_t *context) CP_GCC_NONNULL(1);
 
 /**
- * Destroys all contexts and releases the context list resources.
+ * Initializes the registry of main program contexts.
+ *
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if insufficient resources
+ */
+CP_HIDDEN cp_status_t cpi_init_context_registry(void);
+
+/**
+ * Releases the resources of the registry of main program contexts. All
+ * the contexts must have been destroyed.
+ */
+CP_HIDDEN void cpi_release_context_registry(void);
+
+/**
+ * Destroys all contexts.
  */
 CP_HIDDEN void cpi_destroy_all_contexts(void);
 
+/**
+ * Stops the directory watches of local plug-in loaders scanning the
+ * specified context. Called before the context is destroyed.
+ * 
+ * @param context the plug-in context
+ */
+CP_HIDDEN void cpi_unwatch_local_ploaders(cp_context_t *context) CP_GCC_NONNULL(1);
+
 
 // Delivering plug-in events 
 
@@ -497,6 +1087,28 @@ CP_HIDDEN void cpi_destroy_all_contexts(void);
  */
 CP_HIDDEN void cpi_deliver_event(cp_context_t *context, const cpi_plugin_event_t *event) CP_GCC_NONNULL(1, 2);
 
+/**
+ * Delivers several plug-in events to registered event listeners. The
+ * plug-in listeners are invoked once per event, in order, while the batch
+ * listeners receive all the events in a single batch.
+ * 
+ * @param context the plug-in context
+ * @param events the plug-in events
+ * @param num_events the number of events
+ */
+CP_HIDDEN void cpi_deliver_events(cp_context_t *context, const cpi_plugin_event_t *events, unsigned int num_events) CP_GCC_NONNULL(1);
+
+/**
+ * Detaches the handle of the specified plug-in, if any, when the plug-in
+ * is being uninstalled. The handle is marked uninstalled and the reference
+ * held by the plug-in is released. The caller must have locked the
+ * context.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in being uninstalled
+ */
+CP_HIDDEN void cpi_detach_plugin_handle(cp_context_t *context, cp_plugin_t *plugin) CP_GCC_NONNULL(1, 2);
+
 
 // Plug-in management
 
@@ -510,6 +1122,68 @@ CP_HIDDEN void cpi_deliver_event(cp_context_t *context, const cpi_plugin_event_t
  */
 CP_HIDDEN cp_status_t cpi_install_plugin(cp_context_t *context, cp_plugin_info_t *plugin, cp_plugin_loader_t *loader) CP_GCC_NONNULL(1, 2);
 
+/**
+ * Installs the specified plug-ins as a single batch. Conflicts are checked
+ * for all the plug-ins before any of them is installed and the installation
+ * events are delivered together after the plug-ins have been installed.
+ *
+ * @param context the plug-in context
+ * @param plugins the plug-in information structures
+ * @param loaders the associated plug-in loaders, or NULL for none
+ * @param num the number of plug-ins
+ * @param flags the @ref cInstallFlags "installation flags"
+ * @param statuses filled with the status of each plug-in, or NULL
+ * @return @ref CP_OK (zero) on success or the status of the first failure
+ */
+CP_HIDDEN cp_status_t cpi_install_plugins(cp_context_t *context, cp_plugin_info_t * const *plugins, cp_plugin_loader_t * const *loaders, int num, int flags, cp_status_t *statuses) CP_GCC_NONNULL(1);
+
+/**
+ * Resolves all the installed plug-ins in a single pass over the plug-in
+ * dependency graph. The resulting resolution order is cached until
+ * plug-ins are installed, uninstalled or unresolved.
+ *
+ * @param context the plug-in context
+ * @return @ref CP_OK (zero) on success or the status of the first failure
+ */
+CP_HIDDEN cp_status_t cpi_resolve_plugins(cp_context_t *context) CP_GCC_NONNULL(1);
+
+/**
+ * Allocates new zero-initialized plug-in information. All the content of
+ * the plug-in information must be allocated from the arena returned by
+ * ::cpi_plugin_arena and it is released by ::cpi_free_plugin.
+ * 
+ * @param size_hint the expected size of the content, in bytes
+ * @return the new plug-in information or NULL if insufficient memory
+ */
+CP_HIDDEN cp_plugin_info_t *cpi_new_plugin_info(size_t size_hint);
+
+/**
+ * Returns the arena holding the content of the specified plug-in information
+ * allocated using ::cpi_new_plugin_info.
+ * 
+ * @param plugin the plug-in information
+ * @return the arena
+ */
+CP_HIDDEN cpi_arena_t *cpi_plugin_arena(const cp_plugin_info_t *plugin) CP_GCC_NONNULL(1) CP_GCC_PURE;
+
+/**
+ * Records the time taken to load the specified plug-in information. The
+ * time is included in the statistics of the installed plug-in.
+ * 
+ * @param plugin the plug-in information
+ * @param usecs the time in microseconds
+ */
+CP_HIDDEN void cpi_set_plugin_parse_time(cp_plugin_info_t *plugin, unsigned long long usecs) CP_GCC_NONNULL(1);
+
+/**
+ * Returns the heap memory held by the specified plug-in information
+ * allocated using ::cpi_new_plugin_info, in bytes.
+ * 
+ * @param plugin the plug-in information
+ * @return the size of the arena holding the information
+ */
+CP_HIDDEN size_t cpi_plugin_info_size(const cp_plugin_info_t *plugin) CP_GCC_NONNULL(1);
+
 /**
  * Frees any resources allocated for a plug-in description.
  * 
@@ -517,6 +1191,198 @@ CP_HIDDEN cp_status_t cpi_install_plugin(cp_context_t *context, cp_plugin_info_t
  */
 CP_HIDDEN void cpi_free_plugin(cp_plugin_info_t *plugin) CP_GCC_NONNULL(1);
 
+/**
+ * Returns the information needed to materialize the lazily parsed
+ * extension configuration of the specified plug-in information.
+ * 
+ * @param plugin the plug-in information
+ * @return the lazy configuration information or NULL if parsed eagerly
+ */
+CP_HIDDEN cpi_lazy_cfg_t *cpi_plugin_lazy_cfg(const cp_plugin_info_t *plugin) CP_GCC_NONNULL(1) CP_GCC_PURE;
+
+/**
+ * Associates lazy configuration information with the specified plug-in
+ * information. The information is released by ::cpi_free_plugin.
+ * 
+ * @param plugin the plug-in information
+ * @param lazy the lazy configuration information allocated from the arena
+ */
+CP_HIDDEN void cpi_set_plugin_lazy_cfg(cp_plugin_info_t *plugin, cpi_lazy_cfg_t *lazy) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Releases the resources held by lazy configuration information other
+ * than the memory allocated from the arena of the plug-in information.
+ * 
+ * @param lazy the lazy configuration information
+ */
+CP_HIDDEN void cpi_destroy_lazy_cfg(cpi_lazy_cfg_t *lazy) CP_GCC_NONNULL(1);
+
+/**
+ * Parses the configuration of an extension of lazily parsed plug-in
+ * information unless it has already been parsed. Does not require the
+ * context lock and does not log messages. A failure is remembered and
+ * the configuration is not parsed again.
+ * 
+ * @param ext the extension
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+CP_HIDDEN cp_status_t cpi_load_ext_cfg(cp_extension_t *ext) CP_GCC_NONNULL(1);
+
+/**
+ * Associates a plug-in image with the specified plug-in information whose
+ * content refers to the image. The caller must have acquired a reference
+ * to the image for the plug-in information and the reference is released
+ * by ::cpi_free_plugin.
+ * 
+ * @param plugin the plug-in information
+ * @param image the plug-in image
+ */
+CP_HIDDEN void cpi_set_plugin_image(cp_plugin_info_t *plugin, cpi_plugin_image_t *image) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Tokenizes the versions of the specified plug-in information allocated
+ * using ::cpi_new_plugin_info so that they can be compared without parsing
+ * the version strings again. Must be called once the information is
+ * complete.
+ *
+ * @param plugin the plug-in information
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if insufficient memory
+ */
+CP_HIDDEN cp_status_t cpi_tokenize_plugin_versions(cp_plugin_info_t *plugin) CP_GCC_NONNULL(1);
+
+/**
+ * Compares the versions of two plug-ins the same way as ::cpi_vercmp,
+ * using the tokenized versions if available.
+ *
+ * @param plugin1 the first plug-in information
+ * @param plugin2 the second plug-in information
+ * @return less than, equal to or greater than zero when the version of @a plugin1 is earlier, equal to or later than the version of @a plugin2
+ */
+CP_HIDDEN int cpi_plugin_vercmp(const cp_plugin_info_t *plugin1, const cp_plugin_info_t *plugin2) CP_GCC_NONNULL(1, 2) CP_GCC_PURE;
+
+/**
+ * Releases a reference to a plug-in image. The image is unmapped when
+ * the last reference has been released.
+ * 
+ * @param image the plug-in image
+ */
+CP_HIDDEN void cpi_release_plugin_image(cpi_plugin_image_t *image) CP_GCC_NONNULL(1);
+
+/**
+ * Returns the position of the first node in the extension index whose
+ * extension point name does not compare less than the specified string.
+ * 
+ * @param env the plug-in environment
+ * @param id the extension point name or prefix
+ * @return the position in the extension index
+ */
+CP_HIDDEN int cpi_ext_index_lower_bound(const cp_plugin_env_t *env, const char *id) CP_GCC_NONNULL(1, 2) CP_GCC_PURE;
+
+/**
+ * Releases the template image of a plug-in environment, if any. Must be
+ * called whenever the set of installed plug-ins changes.
+ * 
+ * @param env the plug-in environment
+ */
+CP_HIDDEN void cpi_release_template_image(cp_plugin_env_t *env) CP_GCC_NONNULL(1);
+
+/**
+ * Loads the plug-ins contained in a plug-in image written using
+ * ::cp_write_plugin_image. The returned plug-in information is registered
+ * as if loaded using ::cp_load_plugin_descriptor. The caller must have
+ * locked the context. Failures are logged but plug-in information that
+ * could be loaded is returned even if the status indicates a failure.
+ * 
+ * @param ctx the plug-in context
+ * @param file the image file
+ * @param status pointer to the location where status code is to be stored
+ * @return a NULL-terminated array of plug-in information to be released by the caller, or NULL on failure
+ */
+CP_HIDDEN cp_plugin_info_t **cpi_load_plugin_image(cp_context_t *ctx, const char *file, cp_status_t *status) CP_GCC_NONNULL(1, 2, 3);
+
+/**
+ * Parses the plug-in descriptor in the specified plug-in directory without
+ * registering the resulting information object. Messages are logged using
+ * ::cpi_logf_deferred and the specified log. Unless @a log is NULL, this
+ * function does not require the context lock and may be called by a worker
+ * thread while it is being held by the thread it is working for.
+ * 
+ * @param ctx the plug-in context
+ * @param path the installation path of the plug-in
+ * @param log the deferred message log or NULL to log immediately
+ * @param status pointer to the location where status code is to be stored
+ * @return the unregistered plug-in information or NULL on failure
+ */
+CP_HIDDEN cp_plugin_info_t *cpi_parse_plugin_descriptor(cp_context_t *ctx, const char *path, list_t *log, cp_status_t *status) CP_GCC_NONNULL(1, 2, 4);
+
+/**
+ * Parses a plug-in descriptor from the specified block of memory without
+ * registering the resulting information object. The plug-in path of the
+ * resulting information is set to the specified installation path. This
+ * function has the same locking requirements as
+ * ::cpi_parse_plugin_descriptor.
+ * 
+ * @param ctx the plug-in context
+ * @param path the installation path of the plug-in
+ * @param buffer the buffer containing the plug-in descriptor
+ * @param buffer_len the length of the buffer
+ * @param log the deferred message log or NULL to log immediately
+ * @param status pointer to the location where status code is to be stored
+ * @return the unregistered plug-in information or NULL on failure
+ */
+CP_HIDDEN cp_plugin_info_t *cpi_parse_plugin_descriptor_buffer(cp_context_t *ctx, const char *path, const char *buffer, unsigned int buffer_len, list_t *log, cp_status_t *status) CP_GCC_NONNULL(1, 2, 3, 6);
+
+/**
+ * Registers plug-in information returned by ::cpi_parse_plugin_descriptor
+ * as a reference counted information object. The caller must have locked
+ * the context.
+ * 
+ * @param ctx the plug-in context
+ * @param plugin the plug-in information
+ */
+CP_HIDDEN void cpi_register_plugin_descriptor(cp_context_t *ctx, cp_plugin_info_t *plugin) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Frees the idle descriptor parsers kept for reuse by subsequent
+ * descriptor loads.
+ * 
+ * @param env the plug-in environment
+ */
+CP_HIDDEN void cpi_free_idle_parsers(cp_plugin_env_t *env) CP_GCC_NONNULL(1);
+
+#ifdef HAVE_STAT
+
+struct stat;
+
+/**
+ * Loads plug-in information from the descriptor cache of the context.
+ * Returns NULL unless there is a valid cache entry for the specified
+ * descriptor file matching the specified file status. The returned
+ * plug-in information has no plug-in path and it is not registered.
+ * 
+ * @param ctx the plug-in context having a descriptor cache directory
+ * @param log the deferred message log or NULL to log immediately
+ * @param file the plug-in descriptor file
+ * @param st the status of the plug-in descriptor file
+ * @return the unregistered plug-in information or NULL
+ */
+CP_HIDDEN cp_plugin_info_t *cpi_load_cached_descriptor(cp_context_t *ctx, list_t *log, const char *file, const struct stat *st) CP_GCC_NONNULL(1, 3, 4);
+
+/**
+ * Stores plug-in information parsed from the specified descriptor file
+ * into the descriptor cache of the context. Failures are logged as
+ * warnings but they are otherwise ignored.
+ * 
+ * @param ctx the plug-in context having a descriptor cache directory
+ * @param log the deferred message log or NULL to log immediately
+ * @param file the plug-in descriptor file
+ * @param st the status of the plug-in descriptor file before it was parsed
+ * @param plugin the parsed plug-in information
+ */
+CP_HIDDEN void cpi_store_cached_descriptor(cp_context_t *ctx, list_t *log, const char *file, const struct stat *st, const cp_plugin_info_t *plugin) CP_GCC_NONNULL(1, 3, 4, 5);
+
+#endif
+
 /**
  * Starts the specified plug-in and its dependencies.
  * 
@@ -526,23 +1392,144 @@ CP_HIDDEN void cpi_free_plugin(cp_plugin_info_t *plugin) CP_GCC_NONNULL(1);
  */
 CP_HIDDEN cp_status_t cpi_start_plugin(cp_context_t *context, cp_plugin_t *plugin) CP_GCC_NONNULL(1, 2);
 
+/**
+ * Waits until no plug-in start or stop functions are being executed by
+ * parallel starts or stops. Returns immediately if called by a plug-in
+ * whose start or stop function is being executed in parallel. The caller must have locked the context
+ * exclusively and the context lock is released while waiting.
+ * 
+ * @param context the plug-in context
+ */
+CP_HIDDEN void cpi_wait_parallel_starts(cp_context_t *context) CP_GCC_NONNULL(1);
+
+
+// Extension snapshots
+
+/**
+ * Retires the published extension snapshot, if any. Must be called
+ * whenever the set of installed extension points or extensions changes.
+ * Also frees those retired snapshots that have been released.
+ * 
+ * @param context the plug-in context
+ */
+CP_HIDDEN void cpi_invalidate_ext_snapshot(cp_context_t *context) CP_GCC_NONNULL(1);
+
+/**
+ * Frees all the extension snapshots, including any unreleased ones.
+ * 
+ * @param context the plug-in context
+ */
+CP_HIDDEN void cpi_free_ext_snapshots(cp_context_t *context) CP_GCC_NONNULL(1);
+
+
+// Configuration elements
+
+/**
+ * Allocates an array of children for a configuration element together
+ * with room for a child name index. All children arrays of configuration
+ * elements must be allocated using this function. The array is not
+ * initialized.
+ * 
+ * @param arena the arena of the plug-in information
+ * @param num the number of children, greater than zero
+ * @return the children array, or NULL if insufficient memory
+ */
+CP_HIDDEN cp_cfg_element_t *cpi_alloc_cfg_children(cpi_arena_t *arena, unsigned int num) CP_GCC_NONNULL(1);
+
+/**
+ * Allocates an array of attribute names and values for a configuration
+ * element together with room for an attribute name index. All attribute
+ * arrays of configuration elements must be allocated using this function.
+ * The array is not initialized.
+ * 
+ * @param arena the arena of the plug-in information
+ * @param num_atts the number of attributes, greater than zero
+ * @return the attribute array, or NULL if insufficient memory
+ */
+CP_HIDDEN char **cpi_alloc_cfg_atts(cpi_arena_t *arena, unsigned int num_atts) CP_GCC_NONNULL(1);
+
+/**
+ * Builds the name indexes of a configuration element having a large
+ * number of children or attributes and reserves room for caching the
+ * values of the children and attributes parsed by typed lookups. Must be
+ * called after the children and attributes have been set up and are not
+ * moved anymore. Failing memory allocation only leaves the element
+ * unindexed or the values uncached.
+ * 
+ * @param arena the arena of the plug-in information
+ * @param ce the configuration element
+ */
+CP_HIDDEN void cpi_index_cfg_element(cpi_arena_t *arena, cp_cfg_element_t *ce) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Returns the offset of a children array from the beginning of the block
+ * allocated for it by ::cpi_alloc_cfg_children. The block begins with the
+ * pointers to the child name index and to the cached parsed values.
+ * 
+ * @return the offset in bytes
+ */
+CP_HIDDEN size_t cpi_cfg_children_offset(void) CP_GCC_CONST;
+
+/**
+ * Returns the offset of an attribute array from the beginning of the block
+ * allocated for it by ::cpi_alloc_cfg_atts. The block begins with the
+ * pointers to the attribute name index and to the cached parsed values.
+ * 
+ * @return the offset in bytes
+ */
+CP_HIDDEN size_t cpi_cfg_atts_offset(void) CP_GCC_CONST;
+
+/**
+ * Returns the child name index of a configuration element.
+ * 
+ * @param ce the configuration element
+ * @return the children sorted by name, or NULL if not indexed
+ */
+CP_HIDDEN cp_cfg_element_t * const *cpi_cfg_children_index(const cp_cfg_element_t *ce) CP_GCC_NONNULL(1) CP_GCC_PURE;
+
+/**
+ * Returns the attribute name index of a configuration element.
+ * 
+ * @param ce the configuration element
+ * @return pointers to the attribute names sorted by name, or NULL if not indexed
+ */
+CP_HIDDEN char ** const *cpi_cfg_atts_index(const cp_cfg_element_t *ce) CP_GCC_NONNULL(1) CP_GCC_PURE;
+
 
 // Dynamic resource management
 
 /**
- * Registers a new reference counted information object.
- * Initializes the reference count to 1. The object is released and
- * deallocated using the specified deallocation function @a df when its
- * reference count becomes zero. Reference count is incresed by
- * ::cpi_use_info and decreased by ::cp_release_info. The caller must have
- * locked the plug-in context.
+ * Allocates memory for a reference counted information object, preceded
+ * by its header. The object must be registered using ::cpi_register_info
+ * and, if it is not registered, it may be freed using ::cpi_free_info.
+ * 
+ * @param size the size of the object, in bytes
+ * @return the object or NULL if insufficient memory
+ */
+CP_HIDDEN void *cpi_alloc_info(size_t size);
+
+/**
+ * Frees an information object allocated using ::cpi_alloc_info. This is
+ * typically called by the deallocation function of the object.
+ * 
+ * @param info the information object
+ */
+CP_HIDDEN void cpi_free_info(void *info) CP_GCC_NONNULL(1);
+
+/**
+ * Registers a new reference counted information object. The object must
+ * be preceded by a zero-initialized header, as allocated by
+ * ::cpi_alloc_info. Initializes the reference count to 1. The object is
+ * released and deallocated using the specified deallocation function
+ * @a df when its reference count becomes zero. Reference count is incresed
+ * by ::cpi_use_info and decreased by ::cp_release_info. The caller must
+ * have locked the plug-in context.
  * 
  * @param ctx the associated plug-in context
  * @param res the resource
  * @param df the deallocation function
- * @return @ref CP_OK (zero) on success or an error code on failure
  */
-CP_HIDDEN cp_status_t cpi_register_info(cp_context_t *ctx, void *res, cpi_dealloc_func_t df) CP_GCC_NONNULL(1, 2, 3);
+CP_HIDDEN void cpi_register_info(cp_context_t *ctx, void *res, cpi_dealloc_func_t df) CP_GCC_NONNULL(1, 2, 3);
 
 /**
  * Increases the reference count for the specified information object.
@@ -563,13 +1550,22 @@ CP_HIDDEN void cpi_use_info(cp_context_t *ctx, void *res) CP_GCC_NONNULL(1, 2);
 CP_HIDDEN void cpi_release_info(cp_context_t *ctx, void *res) CP_GCC_NONNULL(1, 2);
 
 /**
- * Checks for remaining information objects in the specified plug-in context.
- * Does not destroy the infos hash.
+ * Checks for remaining information objects in the specified plug-in context
+ * and forgets them without releasing them.
  * 
  * @param ctx the plug-in context
  */
 CP_HIDDEN void cpi_release_infos(cp_context_t *ctx) CP_GCC_NONNULL(1);
 
+/**
+ * Clears the owner of the information objects registered by the context
+ * of the specified plug-in. This is called before the plug-in is freed.
+ * 
+ * @param ctx the plug-in context
+ * @param plugin the plug-in being freed
+ */
+CP_HIDDEN void cpi_disown_infos(cp_context_t *ctx, cp_plugin_t *plugin) CP_GCC_NONNULL(1, 2);
+
 
 // Serialized execution
 
@@ -582,6 +1578,34 @@ CP_HIDDEN void cpi_release_infos(cp_context_t *ctx) CP_GCC_NONNULL(1);
  */
 CP_HIDDEN void cpi_stop_plugin_run(cp_plugin_t *plugin) CP_GCC_NONNULL(1);
 
+/**
+ * Waits until the specified counter of the plug-in activity, such as the
+ * number of run functions in execution, drops to zero. The context must
+ * be locked and it is released while waiting. The counter must be
+ * protected by the context lock and ::cpi_signal_plugin_idle must be
+ * called when it drops to zero.
+ * 
+ * @param plugin the plug-in
+ * @param counter the activity counter
+ */
+CP_HIDDEN void cpi_wait_plugin_idle(cp_plugin_t *plugin, const int *counter) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Wakes up the threads waiting in ::cpi_wait_plugin_idle for the
+ * specified plug-in. The context must be locked.
+ * 
+ * @param plugin the plug-in
+ */
+CP_HIDDEN void cpi_signal_plugin_idle(cp_plugin_t *plugin) CP_GCC_NONNULL(1);
+
+/**
+ * Releases the resources used for waiting for scheduled run functions and
+ * for signaling waiting run functions to the main program.
+ * 
+ * @param env the plug-in environment being destroyed
+ */
+CP_HIDDEN void cpi_release_run_wake(cp_plugin_env_t *env) CP_GCC_NONNULL(1);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,218 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file
+ * Platform independent collection of lock statistics
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "cpluff.h"
+#include "defines.h"
+#include "util.h"
+#include "internal.h"
+#include "thread.h"
+
+
+/* ------------------------------------------------------------------------
+ * Data types
+ * ----------------------------------------------------------------------*/
+
+/// Lock statistics keyed by the acquiring API function
+struct cpi_lock_profile_t {
+	
+	/// Open addressed table of statistics, unused entries have a NULL function
+	cp_lock_stats_t *table;
+	
+	/// The size of the table, a power of two
+	int size;
+	
+	/// The number of used table entries
+	int num_used;
+	
+	/// The statistics of acquisitions not attributed to an API function
+	cp_lock_stats_t unattributed;
+	
+};
+
+
+/* ------------------------------------------------------------------------
+ * Constants
+ * ----------------------------------------------------------------------*/
+
+/// The initial size of the statistics table
+#define INITIAL_TABLE_SIZE 64
+
+
+/* ------------------------------------------------------------------------
+ * Function definitions
+ * ----------------------------------------------------------------------*/
+
+CP_HIDDEN cpi_lock_profile_t *cpi_create_lock_profile(void) {
+	cpi_lock_profile_t *profile;
+	
+	if ((profile = malloc(sizeof(cpi_lock_profile_t))) == NULL) {
+		return NULL;
+	}
+	memset(profile, 0, sizeof(cpi_lock_profile_t));
+	if ((profile->table = calloc(INITIAL_TABLE_SIZE, sizeof(cp_lock_stats_t))) == NULL) {
+		free(profile);
+		return NULL;
+	}
+	profile->size = INITIAL_TABLE_SIZE;
+	return profile;
+}
+
+CP_HIDDEN void cpi_destroy_lock_profile(cpi_lock_profile_t *profile) {
+	assert(profile != NULL);
+	free(profile->table);
+	free(profile);
+}
+
+/**
+ * Returns the table slot for the specified function, used or unused.
+ * 
+ * @param table the table
+ * @param size the size of the table
+ * @param func the function
+ * @return the slot
+ */
+static cp_lock_stats_t *find_slot(cp_lock_stats_t *table, int size, const char *func) {
+	unsigned long i = (((unsigned long) func) >> 3) & (size - 1);
+	
+	while (table[i].function != NULL && table[i].function != func) {
+		i = (i + 1) & (size - 1);
+	}
+	return table + i;
+}
+
+/**
+ * Doubles the size of the statistics table.
+ * 
+ * @param profile the statistics
+ * @return whether successful
+ */
+static int grow_table(cpi_lock_profile_t *profile) {
+	cp_lock_stats_t *table;
+	int i;
+	
+	if ((table = calloc(profile->size * 2, sizeof(cp_lock_stats_t))) == NULL) {
+		return 0;
+	}
+	for (i = 0; i < profile->size; i++) {
+		if (profile->table[i].function != NULL) {
+			*find_slot(table, profile->size * 2, profile->table[i].function) = profile->table[i];
+		}
+	}
+	free(profile->table);
+	profile->table = table;
+	profile->size *= 2;
+	return 1;
+}
+
+/**
+ * Returns the histogram bucket for the specified duration.
+ * 
+ * @param usecs the duration in microseconds
+ * @return the bucket index
+ */
+static int histogram_bucket(unsigned long long usecs) {
+	int b = 0;
+	
+	while (usecs > 0 && b < CP_LOCK_HISTOGRAM_SIZE - 1) {
+		usecs >>= 1;
+		b++;
+	}
+	return b;
+}
+
+CP_HIDDEN void cpi_record_lock(cpi_lock_profile_t *profile, const char *func, unsigned long long waited, int contended, int exclusive, unsigned long long held) {
+	cp_lock_stats_t *stats = NULL;
+	
+	assert(profile != NULL);
+	
+	// Locate the statistics, attributing to none if out of memory
+	if (func != NULL) {
+		if (profile->num_used * 2 >= profile->size && !grow_table(profile)) {
+			stats = &(profile->unattributed);
+		} else {
+			stats = find_slot(profile->table, profile->size, func);
+			if (stats->function == NULL) {
+				stats->function = func;
+				profile->num_used++;
+			}
+		}
+	} else {
+		stats = &(profile->unattributed);
+	}
+	
+	// Update the statistics
+	stats->acquisitions++;
+	if (contended) {
+		stats->contended++;
+	}
+	stats->wait_usecs += waited;
+	stats->wait_histogram[histogram_bucket(waited)]++;
+	if (exclusive) {
+		stats->hold_usecs += held;
+		if (held > stats->max_hold_usecs) {
+			stats->max_hold_usecs = held;
+		}
+		stats->hold_histogram[histogram_bucket(held)]++;
+	}
+}
+
+CP_HIDDEN void cpi_record_lock_release(cpi_lock_timing_t *timing) {
+	if (timing->profile != NULL && timing->tracked) {
+		cpi_record_lock(timing->profile, timing->func, timing->waited,
+			timing->contended, 1,
+			timing->held + cpi_monotonic_usecs() - timing->acquired);
+	}
+	timing->tracked = 0;
+}
+
+CP_HIDDEN cp_lock_stats_t *cpi_copy_lock_profile(const cpi_lock_profile_t *profile, int *num) {
+	cp_lock_stats_t *stats;
+	int i, n = 0;
+	
+	assert(profile != NULL);
+	assert(num != NULL);
+	if ((stats = cpi_alloc_info((profile->num_used + 1) * sizeof(cp_lock_stats_t))) == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < profile->size; i++) {
+		if (profile->table[i].function != NULL) {
+			stats[n++] = profile->table[i];
+		}
+	}
+	if (profile->unattributed.acquisitions > 0) {
+		stats[n++] = profile->unattributed;
+	}
+	*num = n;
+	return stats;
+}
@@ -45,11 +45,17 @@
  * ----------------------------------------------------------------------*/
 
 /// Contains information about installed loggers
-typedef struct logger_t {
+typedef struct cpi_logger_t logger_t;
+
+/// Contains information about installed loggers
+struct cpi_logger_t {
 	
-	/// Pointer to logger
+	/// Pointer to logger or NULL for a structured logger
 	cp_logger_func_t logger;
 	
+	/// Pointer to structured logger or NULL for a text logger
+	cp_structured_logger_func_t slogger;
+	
 	/// Pointer to registering plug-in or NULL for the main program
 	cp_plugin_t *plugin;
 	
@@ -61,69 +67,623 @@ typedef struct logger_t {
 	
 	/// Selected environment or NULL
 	cp_plugin_env_t *env_selection;
-} logger_t;
+	
+	/// Identifier of the plug-in whose messages are selected or NULL for all
+	char *plugin_id;
+	
+	/// Node in the plug-in filter map, if this is the least severe logger for the plug-in
+	hnode_t filter_node;
+};
+
+/// Contains a log message whose delivery has been deferred
+typedef struct deferred_msg_t {
+	
+	/// The severity of the message
+	cp_log_severity_t severity;
+	
+	/// The formatted message
+	char msg[1];
+} deferred_msg_t;
+
+/// Maximum size of an asynchronously delivered message, including the terminating zero
+#define LOG_RECORD_MSG_SIZE 256
+
+/// A pre-formatted log record waiting for asynchronous delivery
+struct cpi_log_record_t {
+	
+	/// The severity of the message
+	cp_log_severity_t severity;
+	
+	/// The interned identifier of the activating plug-in or NULL
+	const char *apid;
+	
+	/// The formatted message
+	char msg[LOG_RECORD_MSG_SIZE];
+};
 
 
 /* ------------------------------------------------------------------------
  * Function definitions
  * ----------------------------------------------------------------------*/
 
+/// The number of severity levels
+#define NUM_SEVERITIES (CP_LOG_ERROR - CP_LOG_DEBUG + 1)
+
+/**
+ * Empties the plug-in filter map. The map refers to the logger holders so
+ * it must be emptied before a logger holder is changed or released.
+ * 
+ * @param env the plug-in environment
+ */
+static void clear_log_filters(cp_plugin_env_t *env) {
+	hscan_t scan;
+	hnode_t *hnode;
+	
+	hash_scan_begin(&scan, env->log_filters);
+	while ((hnode = hash_scan_next(&scan)) != NULL) {
+		hash_scan_delete(env->log_filters, hnode);
+	}
+}
+
 /**
- * Updates the context logging limits. The caller must have locked the
- * context.
+ * Updates the context logging limits and rebuilds the logger buckets and
+ * the plug-in filter map. Does not allocate memory, the bucket storage
+ * must have been reserved using ::reserve_logger_buckets. The caller must
+ * have locked the context.
  */
 static void update_logging_limits(cp_context_t *context) {
+	cp_plugin_env_t *env = context->env;
+	hnode_t *hnode;
 	lnode_t *node;
 	int nms = CP_LOG_NONE;
+	int fms = CP_LOG_NONE;
+	size_t n = 0;
+	int i;
 	
-	node = list_first(context->env->loggers);
+	assert(env->log_index_size >= (list_count(env->loggers) + 1) * NUM_SEVERITIES || list_isempty(env->loggers));
+	
+	// Rebuild the plug-in filter map
+	clear_log_filters(env);
+	node = list_first(env->loggers);
 	while (node != NULL) {
 		logger_t *lh = lnode_get(node);
-		if (lh->min_severity < nms) {
-			nms = lh->min_severity;
+		if (lh->plugin_id == NULL) {
+			if (lh->min_severity < nms) {
+				nms = lh->min_severity;
+			}
+		} else {
+			if (lh->min_severity < fms) {
+				fms = lh->min_severity;
+			}
+			hnode = hash_lookup(env->log_filters, lh->plugin_id);
+			if (hnode == NULL || ((logger_t *) hnode_get(hnode))->min_severity > lh->min_severity) {
+				if (hnode != NULL) {
+					hash_delete(env->log_filters, hnode);
+				}
+				hash_insert(env->log_filters, hnode_init(&(lh->filter_node), lh), lh->plugin_id);
+			}
+		}
+		node = list_next(env->loggers, node);
+	}
+	env->log_min_severity = nms;
+	env->log_filter_min_severity = fms;
+	
+	// Rebuild the logger buckets, preserving the registration order
+	for (i = CP_LOG_DEBUG; i <= CP_LOG_ERROR; i++) {
+		if (env->log_index == NULL) {
+			env->log_buckets[i] = NULL;
+			continue;
 		}
-		node = list_next(context->env->loggers, node);
+		env->log_buckets[i] = env->log_index + n;
+		node = list_first(env->loggers);
+		while (node != NULL) {
+			logger_t *lh = lnode_get(node);
+			if (lh->min_severity <= i) {
+				env->log_index[n++] = lh;
+			}
+			node = list_next(env->loggers, node);
+		}
+		env->log_index[n++] = NULL;
 	}
-	context->env->log_min_severity = nms;
+}
+
+/**
+ * Reserves storage for the logger buckets so that the specified number of
+ * loggers can be registered. The caller must have locked the context.
+ * 
+ * @param context the plug-in context
+ * @param num_loggers the number of loggers
+ * @return CP_OK (zero) on success or CP_ERR_RESOURCE if insufficient memory
+ */
+static cp_status_t reserve_logger_buckets(cp_context_t *context, size_t num_loggers) {
+	cp_plugin_env_t *env = context->env;
+	size_t size = (num_loggers + 1) * NUM_SEVERITIES;
+	
+	if (size > env->log_index_size) {
+		logger_t **index;
+		
+		if ((index = realloc(env->log_index, size * sizeof(logger_t *))) == NULL) {
+			return CP_ERR_RESOURCE;
+		}
+		env->log_index = index;
+		env->log_index_size = size;
+		
+		// The buckets pointed to the old storage
+		update_logging_limits(context);
+	}
+	return CP_OK;
+}
+
+/**
+ * Returns whether a logger selects messages activated by or concerning
+ * the specified plug-ins.
+ * 
+ * @param lh the logger
+ * @param apid the identifier of the activating plug-in or NULL
+ * @param plugin_id the identifier of the plug-in concerned or NULL
+ * @return whether the logger selects the message
+ */
+static int is_selected(const logger_t *lh, const char *apid, const char *plugin_id) {
+	return lh->plugin_id == NULL
+		|| (apid != NULL && !strcmp(lh->plugin_id, apid))
+		|| (plugin_id != NULL && !strcmp(lh->plugin_id, plugin_id));
+}
+
+/**
+ * Returns whether the filtered logger mapped to the specified plug-in
+ * is interested in messages of the specified severity.
+ * 
+ * @param env the plug-in environment
+ * @param severity the severity
+ * @param plugin_id the identifier of the plug-in
+ * @return whether the messages are logged
+ */
+static int is_filter_logged(cp_plugin_env_t *env, cp_log_severity_t severity, const char *plugin_id) {
+	hnode_t *hnode;
+	
+	return (hnode = hash_lookup(env->log_filters, plugin_id)) != NULL
+		&& severity >= ((logger_t *) hnode_get(hnode))->min_severity;
+}
+
+CP_HIDDEN int cpi_is_logged_filtered(cp_context_t *context, cp_log_severity_t severity, const char *plugin_id) {
+	return (context->plugin != NULL && is_filter_logged(context->env, severity, context->plugin->plugin->identifier))
+		|| (plugin_id != NULL && is_filter_logged(context->env, severity, plugin_id));
 }
 
 static int comp_logger(const void *p1, const void *p2) {
 	const logger_t *l1 = p1;
 	const logger_t *l2 = p2;
-	return l1->logger != l2->logger;
+	return l1->logger != l2->logger || l1->slogger != l2->slogger;
 }
 
-CP_C_API cp_status_t cp_register_logger(cp_context_t *context, cp_logger_func_t logger, void *user_data, cp_log_severity_t min_severity) {
-	logger_t l;
+/**
+ * Formats the owner of the activating context for a log message.
+ * 
+ * @param apid the identifier of the activating plug-in or NULL
+ * @param name the location where the owner is to be stored
+ * @param size maximum size of the owner string, including the terminating zero
+ * @return the pointer passed in as @a name
+ */
+static char *format_owner(const char *apid, char *name, size_t size) {
+	if (apid != NULL) {
+		/* TRANSLATORS: The context owner (when it is a plug-in) used in some strings.
+		   Search for "context owner" to find these strings. */
+		snprintf(name, size, _("Plug-in %s"), apid);
+	} else {
+		/* TRANSLATORS: The context owner (when it is the main program) used in some strings.
+		   Search for "context owner" to find these strings. */
+		strncpy(name, _("The main program"), size);
+	}
+	strcpy(name + size - 4, "...");
+	return name;
+}
+
+/**
+ * Formats the text of a structured log message.
+ * 
+ * @param rec the log record
+ * @param buffer the buffer for the formatted text
+ * @param size the size of the buffer
+ * @return the message text or NULL if none
+ */
+static const char *format_record(const cp_log_record_t *rec, char *buffer, size_t size) {
+	char owner[64];
+	const char *str = NULL;
+	
+	switch (rec->msg_id) {
+		case CP_MSG_TEXT:
+			return rec->text;
+		case CP_MSG_COLLECTION_REGISTERED:
+			snprintf(buffer, size, _("The plug-in collection in path %s was registered."), rec->str);
+			break;
+		case CP_MSG_COLLECTION_UNREGISTERED:
+			snprintf(buffer, size, _("The plug-in collection in path %s was unregistered."), rec->str);
+			break;
+		case CP_MSG_COLLECTIONS_UNREGISTERED:
+			return _("All plug-in collections were unregistered.");
+		case CP_MSG_LOADER_REGISTERED:
+			snprintf(buffer, size, _("The plug-in loader %p was registered."), rec->address);
+			break;
+		case CP_MSG_LOADER_UNREGISTERED:
+			snprintf(buffer, size, _("The plug-in loader %p was unregistered."), rec->address);
+			break;
+		case CP_MSG_LOGGER_REGISTERED:
+			/* TRANSLATORS: %s is the context owner */
+			snprintf(buffer, size, _("%s registered a logger."), format_owner(rec->apid, owner, sizeof(owner)));
+			break;
+		case CP_MSG_LOGGER_UNREGISTERED:
+			/* TRANSLATORS: %s is the context owner */
+			snprintf(buffer, size, _("%s unregistered a logger."), format_owner(rec->apid, owner, sizeof(owner)));
+			break;
+		case CP_MSG_LISTENER_REGISTERED:
+			/* TRANSLATORS: %s is the context owner */
+			snprintf(buffer, size, _("%s registered a plug-in listener."), format_owner(rec->apid, owner, sizeof(owner)));
+			break;
+		case CP_MSG_LISTENER_UNREGISTERED:
+			/* TRANSLATORS: %s is the context owner */
+			snprintf(buffer, size, _("%s unregistered a plug-in listener."), format_owner(rec->apid, owner, sizeof(owner)));
+			break;
+		case CP_MSG_BATCH_LISTENER_REGISTERED:
+			/* TRANSLATORS: %s is the context owner */
+			snprintf(buffer, size, _("%s registered a batch plug-in listener."), format_owner(rec->apid, owner, sizeof(owner)));
+			break;
+		case CP_MSG_BATCH_LISTENER_UNREGISTERED:
+			/* TRANSLATORS: %s is the context owner */
+			snprintf(buffer, size, _("%s unregistered a batch plug-in listener."), format_owner(rec->apid, owner, sizeof(owner)));
+			break;
+		case CP_MSG_INFO_REGISTERED:
+			snprintf(buffer, size, _("Registered a new reference counted object at address %p."), rec->address);
+			break;
+		case CP_MSG_INFO_USED:
+			snprintf(buffer, size, _("Reference count of the object at address %p increased to %d."), rec->address, rec->count);
+			break;
+		case CP_MSG_INFO_RELEASED:
+			snprintf(buffer, size, _("Reference count of the object at address %p decreased to %d."), rec->address, rec->count);
+			break;
+		case CP_MSG_INFO_DEALLOCATED:
+			snprintf(buffer, size, _("Deallocated the reference counted object at address %p."), rec->address);
+			break;
+		case CP_MSG_SCAN_STARTED:
+			return _("Plug-in scan is starting.");
+		case CP_MSG_SCAN_LOADER:
+			snprintf(buffer, size, _("Scanning plug-ins using loader %p."), rec->address);
+			break;
+		case CP_MSG_SCAN_COMPLETED:
+			return _("Plug-in scan has completed successfully.");
+		case CP_MSG_SYMBOL_RESOLVED:
+			/* TRANSLATORS: The first %s is the context owner */
+			snprintf(buffer, size, _("%s resolved symbol %s defined by plug-in %s."), format_owner(rec->apid, owner, sizeof(owner)), rec->str, rec->plugin_id);
+			break;
+		case CP_MSG_SYMBOL_RELEASED:
+			/* TRANSLATORS: The first %s is the context owner */
+			snprintf(buffer, size, _("%s released the symbol at address %p defined by plug-in %s."), format_owner(rec->apid, owner, sizeof(owner)), rec->address, rec->plugin_id);
+			break;
+		case CP_MSG_DEPENDENCY_ADDED:
+			snprintf(buffer, size, _("A dynamic dependency was created from plug-in %s to plug-in %s."), rec->apid, rec->plugin_id);
+			break;
+		case CP_MSG_DEPENDENCY_REMOVED:
+			snprintf(buffer, size, _("A dynamic dependency from plug-in %s to plug-in %s was removed."), rec->apid, rec->plugin_id);
+			break;
+		case CP_MSG_PLUGIN_STATE:
+			switch (rec->new_state) {
+				case CP_PLUGIN_UNINSTALLED:
+					str = _("Plug-in %s has been uninstalled.");
+					break;
+				case CP_PLUGIN_INSTALLED:
+					if (rec->old_state < CP_PLUGIN_INSTALLED) {
+						str = _("Plug-in %s has been installed.");
+					} else {
+						str = _("Plug-in %s runtime library has been unloaded.");
+					}
+					break;
+				case CP_PLUGIN_RESOLVED:
+					if (rec->old_state < CP_PLUGIN_RESOLVED) {
+						str = _("Plug-in %s runtime library has been loaded.");
+					} else {
+						str = _("Plug-in %s has been stopped.");
+					}
+					break;
+				case CP_PLUGIN_STARTING:
+					str = _("Plug-in %s is starting.");
+					break;
+				case CP_PLUGIN_STOPPING:
+					str = _("Plug-in %s is stopping.");
+					break;
+				case CP_PLUGIN_ACTIVE:
+					str = _("Plug-in %s has been started.");
+					break;
+				default:
+					return NULL;
+			}
+			snprintf(buffer, size, str, rec->plugin_id);
+			break;
+		default:
+			return NULL;
+	}
+	strcpy(buffer + size - 4, "...");
+	return buffer;
+}
+
+/**
+ * Invokes the registered loggers interested in a message.
+ * 
+ * @param env the plug-in environment
+ * @param severity the severity of the message
+ * @param msg the message
+ * @param apid the identifier of the activating plug-in or NULL
+ */
+static void invoke_loggers(cp_plugin_env_t *env, cp_log_severity_t severity, const char *msg, const char *apid) {
+	logger_t **lhp;
+	cp_log_record_t rec;
+	
+	if ((lhp = env->log_buckets[severity]) == NULL) {
+		return;
+	}
+	memset(&rec, 0, sizeof(rec));
+	rec.severity = severity;
+	rec.msg_id = CP_MSG_TEXT;
+	rec.apid = apid;
+	rec.text = msg;
+	for (; *lhp != NULL; lhp++) {
+		logger_t *lh = *lhp;
+		if (!is_selected(lh, apid, NULL)) {
+			continue;
+		}
+		if (lh->logger != NULL) {
+			lh->logger(severity, msg, apid, lh->user_data);
+		} else {
+			lh->slogger(&rec, lh->user_data);
+		}
+	}
+}
+
+/**
+ * Invokes the registered loggers interested in a structured message. The
+ * message text is formatted only if a text logger is interested in it.
+ * 
+ * @param env the plug-in environment
+ * @param rec the log record
+ */
+static void invoke_loggers_record(cp_plugin_env_t *env, const cp_log_record_t *rec) {
+	logger_t **lhp;
+	char buffer[256];
+	const char *msg = NULL;
+	int formatted = 0;
+	
+	if ((lhp = env->log_buckets[rec->severity]) == NULL) {
+		return;
+	}
+	for (; *lhp != NULL; lhp++) {
+		logger_t *lh = *lhp;
+		if (!is_selected(lh, rec->apid, rec->plugin_id)) {
+			continue;
+		}
+		if (lh->slogger != NULL) {
+			lh->slogger(rec, lh->user_data);
+		} else {
+			if (!formatted) {
+				msg = format_record(rec, buffer, sizeof(buffer));
+				formatted = 1;
+			}
+			if (msg != NULL) {
+				lh->logger(rec->severity, msg, rec->apid, lh->user_data);
+			}
+		}
+	}
+}
+
+/**
+ * Waits for the asynchronous delivery of log records to loggers to
+ * complete, so that the logger list can be changed. The context must be
+ * locked.
+ * 
+ * @param context the plug-in context
+ */
+static void wait_log_delivery(cp_context_t *context) {
+#ifdef CP_THREADS
+	while (context->env->in_log_delivery) {
+		cpi_wait_context(context);
+	}
+#endif
+}
+
+#ifdef CP_THREADS
+
+/**
+ * Delivers queued log records to the loggers until the drain thread is
+ * shut down and there are no more queued records. Records are delivered
+ * from the ring directly, without the context lock, while new records are
+ * queued into the free part of the ring.
+ * 
+ * @param arg the plug-in environment
+ */
+static void drain_log(void *arg) {
+	cp_plugin_env_t *env = arg;
+	cp_context_t context;
+	
+	memset(&context, 0, sizeof(context));
+	context.env = env;
+	cpi_lock_context(&context);
+	while (env->log_ring_count > 0 || env->log_overflows > 0 || !env->log_drainer_shutdown) {
+		unsigned int head, num;
+		unsigned long overflows;
+		unsigned int i;
+		
+		// Wait for records
+		if (env->log_ring_count == 0 && env->log_overflows == 0) {
+			cpi_wait_context(&context);
+			continue;
+		}
+		head = env->log_ring_head;
+		num = env->log_ring_count;
+		overflows = env->log_overflows;
+		env->log_overflows = 0;
+		env->in_log_delivery = 1;
+		
+		// Deliver the records without the context lock
+		cpi_unlock_context(&context);
+		for (i = 0; i < num; i++) {
+			cpi_log_record_t *rec = env->log_ring + (head + i) % env->log_ring_size;
+			
+			invoke_loggers(env, rec->severity, rec->msg, rec->apid);
+		}
+		if (overflows > 0) {
+			char buffer[128];
+			
+			snprintf(buffer, sizeof(buffer), _("%lu log messages were dropped because the log queue was full."), overflows);
+			invoke_loggers(env, CP_LOG_WARNING, buffer, NULL);
+		}
+		cpi_lock_context(&context);
+		
+		// Free the delivered records
+		for (i = 0; i < num; i++) {
+			cpi_log_record_t *rec = env->log_ring + (head + i) % env->log_ring_size;
+			
+			if (rec->apid != NULL) {
+				cpi_release_string(env->strings, rec->apid);
+			}
+		}
+		env->log_ring_head = (head + num) % env->log_ring_size;
+		env->log_ring_count -= num;
+		env->in_log_delivery = 0;
+		cpi_signal_context(&context);
+	}
+	env->log_drainer_shutdown = 0;
+	cpi_signal_context(&context);
+	cpi_unlock_context(&context);
+}
+
+#endif
+
+/**
+ * Delivers the queued log records and stops the log drain thread, if
+ * running. The context must be locked.
+ * 
+ * @param context the plug-in context
+ */
+static void stop_log_drainer(cp_context_t *context) {
+#ifdef CP_THREADS
+	cp_plugin_env_t *env = context->env;
+	
+	// Wait for a concurrent request to complete
+	while (env->log_drainer_shutdown) {
+		cpi_wait_context(context);
+	}
+	if (env->log_drainer != NULL) {
+		cpi_thread_t *drainer = env->log_drainer;
+		
+		env->log_drainer = NULL;
+		env->log_drainer_shutdown = 1;
+		cpi_signal_context(context);
+		while (env->log_drainer_shutdown) {
+			cpi_wait_context(context);
+		}
+		cpi_join_thread(drainer);
+		assert(env->log_ring_count == 0);
+		free(env->log_ring);
+		env->log_ring = NULL;
+		env->log_ring_size = 0;
+		env->log_ring_head = 0;
+	}
+#endif
+}
+
+CP_HIDDEN void cpi_stop_log_drainer(cp_context_t *context) {
+	cpi_lock_context(context);
+	stop_log_drainer(context);
+	cpi_unlock_context(context);
+}
+
+CP_C_API cp_status_t cp_set_async_logging(cp_context_t *context, unsigned int queue_size) {
+	cp_status_t status = CP_OK;
+	
+	CHECK_NOT_NULL(context);
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+	stop_log_drainer(context);
+#ifdef CP_THREADS
+	if (queue_size > 0 && context->env->log_drainer == NULL) {
+		cp_plugin_env_t *env = context->env;
+		
+		if ((env->log_ring = malloc(queue_size * sizeof(cpi_log_record_t))) == NULL) {
+			status = CP_ERR_RESOURCE;
+		} else {
+			env->log_ring_size = queue_size;
+			env->log_ring_head = 0;
+			env->log_ring_count = 0;
+			env->log_overflows = 0;
+			if ((env->log_drainer = cpi_create_thread(drain_log, env)) == NULL) {
+				free(env->log_ring);
+				env->log_ring = NULL;
+				env->log_ring_size = 0;
+				status = CP_ERR_RESOURCE;
+			}
+		}
+		if (status != CP_OK) {
+			cpi_error(context, N_("Asynchronous logging could not be enabled due to insufficient system resources."));
+		}
+	}
+#endif
+	cpi_unlock_context(context);
+	return status;
+}
+
+/**
+ * Registers a text or structured logger or updates its settings.
+ * 
+ * @param context the plug-in context
+ * @param l the logger to be registered
+ * @param func the name of the API function
+ * @return CP_OK (zero) on success or CP_ERR_RESOURCE if insufficient memory
+ */
+static cp_status_t register_logger(cp_context_t *context, const logger_t *l, const char *func) {
 	logger_t *lh = NULL;
 	lnode_t *node = NULL;
 	cp_status_t status = CP_OK;
 
-	CHECK_NOT_NULL(context);
-	CHECK_NOT_NULL(logger);
 	cpi_lock_context(context);
-	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+	cpi_check_invocation(context, CPI_CF_LOGGER, func);
+	wait_log_delivery(context);
 	do {
+		char *plugin_id = NULL;
+	
+		// Copy the plug-in filter
+		if (l->plugin_id != NULL) {
+			if ((plugin_id = malloc((strlen(l->plugin_id) + 1) * sizeof(char))) == NULL) {
+				status = CP_ERR_RESOURCE;
+				break;
+			}
+			strcpy(plugin_id, l->plugin_id);
+		}
 	
 		// Check if logger already exists and allocate new holder if necessary
-		l.logger = logger;
-		if ((node = list_find(context->env->loggers, &l, comp_logger)) == NULL) {
+		if ((node = list_find(context->env->loggers, l, comp_logger)) == NULL) {
+			if ((status = reserve_logger_buckets(context, list_count(context->env->loggers) + 1)) != CP_OK) {
+				free(plugin_id);
+				break;
+			}
 			lh = malloc(sizeof(logger_t));
-			node = lnode_create(lh);
+			node = cpi_create_lnode(context->env->nodes, lh);
 			if (lh == NULL || node == NULL) {
+				free(plugin_id);
 				status = CP_ERR_RESOURCE;
 				break;
 			}
-			lh->logger = logger;
+			lh->logger = l->logger;
+			lh->slogger = l->slogger;
 			lh->plugin = context->plugin;
+			lh->plugin_id = NULL;
 			list_append(context->env->loggers, node);
 		} else {
 			lh = lnode_get(node);
 		}
 		
 		// Initialize or update the logger holder
-		lh->user_data = user_data;
-		lh->min_severity = min_severity;
+		clear_log_filters(context->env);
+		lh->user_data = l->user_data;
+		lh->min_severity = l->min_severity;
+		free(lh->plugin_id);
+		lh->plugin_id = plugin_id;
 		
 		// Update global limits
 		update_logging_limits(context);
@@ -133,53 +693,143 @@ CP_C_API cp_status_t cp_register_logger(cp_context_t *context, cp_logger_func_t
 	// Report error
 	if (status == CP_ERR_RESOURCE) {
 		cpi_error(context, N_("Logger could not be registered due to insufficient memory."));		
-	} else if (cpi_is_logged(context, CP_LOG_DEBUG)) {
-		char owner[64];
-		/* TRANSLATORS: %s is the context owner */
-		cpi_debugf(context, N_("%s registered a logger."), cpi_context_owner(context, owner, sizeof(owner)));
+	} else {
+		cpi_debugm(context, CP_MSG_LOGGER_REGISTERED, NULL, NULL, NULL, 0);
 	}
-	cpi_unlock_context(context);
 
 	// Release resources on error
 	if (status != CP_OK) {
 		if (node != NULL) {
-			lnode_destroy(node);
+			cpi_destroy_lnode(context->env->nodes, node);
 		}
 		if (lh != NULL) {
 			free(lh);
 		}
 	}
+	cpi_unlock_context(context);
 
 	return status;
 }
 
-CP_C_API void cp_unregister_logger(cp_context_t *context, cp_logger_func_t logger) {
-	logger_t l;
+/**
+ * Unregisters a text or structured logger.
+ * 
+ * @param context the plug-in context
+ * @param l the logger to be unregistered
+ * @param func the name of the API function
+ */
+static void unregister_logger(cp_context_t *context, const logger_t *l, const char *func) {
 	lnode_t *node;
 	
-	CHECK_NOT_NULL(context);
-	CHECK_NOT_NULL(logger);
 	cpi_lock_context(context);
-	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
-	
-	l.logger = logger;
-	if ((node = list_find(context->env->loggers, &l, comp_logger)) != NULL) {
+	cpi_check_invocation(context, CPI_CF_LOGGER, func);
+	wait_log_delivery(context);
+	if ((node = list_find(context->env->loggers, l, comp_logger)) != NULL) {
 		logger_t *lh = lnode_get(node);
+		clear_log_filters(context->env);
 		list_delete(context->env->loggers, node);
-		lnode_destroy(node);
+		cpi_destroy_lnode(context->env->nodes, node);
+		free(lh->plugin_id);
 		free(lh);
 		update_logging_limits(context);
 	}
-	if (cpi_is_logged(context, CP_LOG_DEBUG)) {
-		char owner[64];
-		/* TRANSLATORS: %s is the context owner */
-		cpi_debugf(context, N_("%s unregistered a logger."), cpi_context_owner(context, owner, sizeof(owner)));
-	}
+	cpi_debugm(context, CP_MSG_LOGGER_UNREGISTERED, NULL, NULL, NULL, 0);
 	cpi_unlock_context(context);
 }
 
+CP_C_API cp_status_t cp_register_logger(cp_context_t *context, cp_logger_func_t logger, void *user_data, cp_log_severity_t min_severity) {
+	logger_t l;
+	
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(logger);
+	l.logger = logger;
+	l.slogger = NULL;
+	l.user_data = user_data;
+	l.min_severity = min_severity;
+	l.plugin_id = NULL;
+	return register_logger(context, &l, __func__);
+}
+
+CP_C_API cp_status_t cp_register_plugin_logger(cp_context_t *context, cp_logger_func_t logger, void *user_data, cp_log_severity_t min_severity, const char *plugin_id) {
+	logger_t l;
+	
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(logger);
+	CHECK_NOT_NULL(plugin_id);
+	l.logger = logger;
+	l.slogger = NULL;
+	l.user_data = user_data;
+	l.min_severity = min_severity;
+	l.plugin_id = (char *) plugin_id;
+	return register_logger(context, &l, __func__);
+}
+
+CP_C_API cp_status_t cp_register_structured_logger(cp_context_t *context, cp_structured_logger_func_t logger, void *user_data, cp_log_severity_t min_severity) {
+	logger_t l;
+	
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(logger);
+	l.logger = NULL;
+	l.slogger = logger;
+	l.user_data = user_data;
+	l.min_severity = min_severity;
+	l.plugin_id = NULL;
+	return register_logger(context, &l, __func__);
+}
+
+CP_C_API void cp_unregister_logger(cp_context_t *context, cp_logger_func_t logger) {
+	logger_t l;
+	
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(logger);
+	l.logger = logger;
+	l.slogger = NULL;
+	unregister_logger(context, &l, __func__);
+}
+
+CP_C_API void cp_unregister_structured_logger(cp_context_t *context, cp_structured_logger_func_t logger) {
+	logger_t l;
+	
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(logger);
+	l.logger = NULL;
+	l.slogger = logger;
+	unregister_logger(context, &l, __func__);
+}
+
+/**
+ * Appends a message to the asynchronous log ring. The message is truncated
+ * if necessary. The message is dropped and counted as an overflow if the
+ * ring is full.
+ * 
+ * @param context the plug-in context
+ * @param severity the severity of the message
+ * @param msg the message
+ * @param apid the identifier of the activating plug-in or NULL
+ */
+static void queue_log_record(cp_context_t *context, cp_log_severity_t severity, const char *msg, const char *apid) {
+	cp_plugin_env_t *env = context->env;
+	cpi_log_record_t *rec;
+	size_t len;
+	
+	if (env->log_ring_count == env->log_ring_size) {
+		env->log_overflows++;
+		return;
+	}
+	rec = env->log_ring + (env->log_ring_head + env->log_ring_count) % env->log_ring_size;
+	rec->severity = severity;
+	rec->apid = (apid != NULL ? cpi_intern_string(env->strings, apid) : NULL);
+	if ((len = strlen(msg)) < LOG_RECORD_MSG_SIZE) {
+		memcpy(rec->msg, msg, (len + 1) * sizeof(char));
+	} else {
+		memcpy(rec->msg, msg, (LOG_RECORD_MSG_SIZE - 4) * sizeof(char));
+		strcpy(rec->msg + LOG_RECORD_MSG_SIZE - 4, "...");
+	}
+	env->log_ring_count++;
+	cpi_signal_context(context);
+}
+
 static void do_log(cp_context_t *context, cp_log_severity_t severity, const char *msg) {
-	lnode_t *node;
 	const char *apid = NULL;
 
 	assert(cpi_is_context_locked(context));	
@@ -189,15 +839,12 @@ static void do_log(cp_context_t *context, cp_log_severity_t severity, const char
 	if (context->plugin != NULL) {
 		apid = context->plugin->plugin->identifier;
 	}
-	context->env->in_logger_invocation++;
-	node = list_first(context->env->loggers);
-	while (node != NULL) {
-		logger_t *lh = lnode_get(node);
-		if (severity >= lh->min_severity) {
-			lh->logger(severity, msg, apid, lh->user_data);
-		}
-		node = list_next(context->env->loggers, node);
+	if (context->env->log_ring != NULL) {
+		queue_log_record(context, severity, msg, apid);
+		return;
 	}
+	context->env->in_logger_invocation++;
+	invoke_loggers(context->env, severity, msg, apid);
 	context->env->in_logger_invocation--;
 }
 
@@ -223,17 +870,118 @@ CP_HIDDEN void cpi_logf(cp_context_t *context, cp_log_severity_t severity, const
 	do_log(context, severity, buffer);
 }
 
-static void process_unregister_logger(list_t *list, lnode_t *node, void *plugin) {
-	logger_t *lh = lnode_get(node);
-	if (plugin == NULL || lh->plugin == plugin) {
-		list_delete(list, node);
+CP_HIDDEN void cpi_log_record(cp_context_t *context, const cp_log_record_t *record) {
+	cp_log_record_t rec = *record;
+	
+	assert(cpi_is_context_locked(context));
+	assert(rec.severity >= CP_LOG_DEBUG && rec.severity <= CP_LOG_ERROR);
+	if (context->env->in_logger_invocation) {
+		cpi_fatalf(_("Encountered a recursive logging request within a logger invocation."));
+	}
+	if (context->plugin != NULL) {
+		rec.apid = context->plugin->plugin->identifier;
+	}
+	
+	// Queued records are delivered as text
+	if (context->env->log_ring != NULL) {
+		char buffer[256];
+		const char *msg;
+		
+		if ((msg = format_record(&rec, buffer, sizeof(buffer))) != NULL) {
+			queue_log_record(context, rec.severity, msg, rec.apid);
+		}
+		return;
+	}
+	context->env->in_logger_invocation++;
+	invoke_loggers_record(context->env, &rec);
+	context->env->in_logger_invocation--;
+}
+
+CP_HIDDEN void cpi_logm(cp_context_t *context, cp_log_severity_t severity, cp_log_msg_t msg_id, const char *plugin_id, const char *str, const void *address, int count) {
+	cp_log_record_t rec;
+	
+	memset(&rec, 0, sizeof(rec));
+	rec.severity = severity;
+	rec.msg_id = msg_id;
+	rec.plugin_id = plugin_id;
+	rec.str = str;
+	rec.address = address;
+	rec.count = count;
+	cpi_log_record(context, &rec);
+}
+
+CP_HIDDEN void cpi_logf_deferred(cp_context_t *context, list_t *log, cp_log_severity_t severity, const char *msg, ...) {
+	char buffer[256];
+	va_list va;
+	
+	assert(context != NULL);
+	assert(msg != NULL);
+	assert(severity >= CP_LOG_DEBUG && severity <= CP_LOG_ERROR);
+	if (!cpi_is_logged(context, severity)) {
+		return;
+	}
+	
+	va_start(va, msg);
+	vsnprintf(buffer, sizeof(buffer), _(msg), va);
+	va_end(va);
+	strcpy(buffer + sizeof(buffer)/sizeof(char) - 4, "...");
+	if (log == NULL) {
+		do_log(context, severity, buffer);
+	} else {
+		deferred_msg_t *dm;
+		lnode_t *node;
+		
+		// Messages are silently dropped if there is no memory to hold them
+		if ((dm = malloc(sizeof(deferred_msg_t) + strlen(buffer) * sizeof(char))) == NULL) {
+			return;
+		}
+		if ((node = lnode_create(dm)) == NULL) {
+			free(dm);
+			return;
+		}
+		dm->severity = severity;
+		strcpy(dm->msg, buffer);
+		list_append(log, node);
+	}
+}
+
+CP_HIDDEN void cpi_flush_deferred_log(cp_context_t *context, list_t *log) {
+	lnode_t *node;
+	
+	assert(cpi_is_context_locked(context));
+	while ((node = list_first(log)) != NULL) {
+		deferred_msg_t *dm = lnode_get(node);
+		
+		list_delete(log, node);
 		lnode_destroy(node);
-		free(lh);
+		if (cpi_is_logged(context, dm->severity)) {
+			do_log(context, dm->severity, dm->msg);
+		}
+		free(dm);
 	}
 }
 
-CP_HIDDEN void cpi_unregister_loggers(list_t *loggers, cp_plugin_t *plugin) {
-	list_process(loggers, plugin, process_unregister_logger);
+CP_HIDDEN void cpi_unregister_loggers(cp_context_t *context, cp_plugin_t *plugin) {
+	list_t *loggers = context->env->loggers;
+	lnode_t *node;
+	
+	assert(cpi_is_context_locked(context));
+	wait_log_delivery(context);
+	clear_log_filters(context->env);
+	node = list_first(loggers);
+	while (node != NULL) {
+		lnode_t *next = list_next(loggers, node);
+		logger_t *lh = lnode_get(node);
+		
+		if (plugin == NULL || lh->plugin == plugin) {
+			list_delete(loggers, node);
+			cpi_destroy_lnode(context->env->nodes, node);
+			free(lh->plugin_id);
+			free(lh);
+		}
+		node = next;
+	}
+	update_logging_limits(context);
 }
 
 CP_C_API void cp_log(cp_context_t *context, cp_log_severity_t severity, const char *msg) {
@@ -254,9 +1002,9 @@ CP_C_API int cp_is_logged(cp_context_t *context, cp_log_severity_t severity) {
 	int is_logged;
 	
 	CHECK_NOT_NULL(context);
-	cpi_lock_context(context);
+	cpi_lock_context_shared(context);
 	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
 	is_logged = cpi_is_logged(context, severity);
-	cpi_unlock_context(context);
+	cpi_unlock_context_shared(context);
 	return is_logged;
 }
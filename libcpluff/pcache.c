@@ -0,0 +1,649 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file
+ * Persistent plug-in descriptor cache
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "cpluff.h"
+#include "defines.h"
+#include "util.h"
+#include "internal.h"
+
+
+/* ------------------------------------------------------------------------
+ * Constants
+ * ----------------------------------------------------------------------*/
+
+/// Magic bytes at the beginning of a cache file
+#define CACHE_MAGIC "CPDC"
+
+/// Version of the cache file format
+#define CACHE_FORMAT_VERSION 1
+
+/// Size of the fixed cache file header
+#define CACHE_HEADER_SIZE 32
+
+/// Suffix of cache file names
+#define CACHE_SUFFIX ".cpd"
+
+
+/* ------------------------------------------------------------------------
+ * Data types
+ * ----------------------------------------------------------------------*/
+
+/// A growing buffer for serialized data
+typedef struct cache_writer_t {
+
+	/// The data
+	unsigned char *data;
+
+	/// The allocated size of the data
+	size_t size;
+
+	/// The current length of the data
+	size_t length;
+
+	/// Whether memory allocation has failed
+	int error;
+} cache_writer_t;
+
+/// A cursor for reading serialized data
+typedef struct cache_reader_t {
+
+	/// The next byte to be read
+	const unsigned char *ptr;
+
+	/// The end of the data
+	const unsigned char *end;
+
+	/// Whether the data has been found to be invalid or allocation has failed
+	int error;
+
+	/// The arena of the plug-in information being read
+	cpi_arena_t *arena;
+} cache_reader_t;
+
+
+/* ------------------------------------------------------------------------
+ * Function definitions
+ * ----------------------------------------------------------------------*/
+
+#ifdef HAVE_STAT
+
+/**
+ * Returns the name of the cache file for the specified descriptor file.
+ *
+ * @param dir the cache directory
+ * @param file the descriptor file
+ * @return the newly allocated cache file name or NULL if out of memory
+ */
+static char *cache_file_name(const char *dir, const char *file) {
+	size_t dir_len = strlen(dir);
+	char *name;
+
+	if (dir_len > 0 && dir[dir_len - 1] == CP_FNAMESEP_CHAR) {
+		dir_len--;
+	}
+	if ((name = malloc((dir_len + 1 + 8 + strlen(CACHE_SUFFIX) + 1) * sizeof(char))) == NULL) {
+		return NULL;
+	}
+	strncpy(name, dir, dir_len);
+	sprintf(name + dir_len, "%c%08lx" CACHE_SUFFIX, CP_FNAMESEP_CHAR,
+		cpi_fnv_hash(file, strlen(file), CPI_FNV_INIT));
+	return name;
+}
+
+static void put_bytes(cache_writer_t *w, const void *data, size_t length) {
+	if (w->error) {
+		return;
+	}
+	if (w->length + length > w->size) {
+		size_t ns = (w->size == 0 ? 1024 : w->size);
+		unsigned char *nd;
+
+		while (w->length + length > ns) {
+			ns *= 2;
+		}
+		if ((nd = realloc(w->data, ns)) == NULL) {
+			w->error = 1;
+			return;
+		}
+		w->data = nd;
+		w->size = ns;
+	}
+	memcpy(w->data + w->length, data, length);
+	w->length += length;
+}
+
+static void put_u32(cache_writer_t *w, unsigned long v) {
+	unsigned char b[4];
+
+	b[0] = v & 0xff;
+	b[1] = (v >> 8) & 0xff;
+	b[2] = (v >> 16) & 0xff;
+	b[3] = (v >> 24) & 0xff;
+	put_bytes(w, b, 4);
+}
+
+/**
+ * Writes a string as its length plus one followed by the characters.
+ * A NULL string is written as zero length.
+ */
+static void put_str(cache_writer_t *w, const char *str) {
+	if (str == NULL) {
+		put_u32(w, 0);
+	} else {
+		size_t len = strlen(str);
+
+		put_u32(w, len + 1);
+		put_bytes(w, str, len);
+	}
+}
+
+static void put_cfg_element(cache_writer_t *w, const cp_cfg_element_t *ce) {
+	unsigned int i;
+
+	put_str(w, ce->name);
+	put_u32(w, ce->num_atts);
+	for (i = 0; i < 2 * ce->num_atts; i++) {
+		put_str(w, ce->atts[i]);
+	}
+	put_str(w, ce->value);
+	put_u32(w, ce->num_children);
+	for (i = 0; i < ce->num_children; i++) {
+		put_cfg_element(w, ce->children + i);
+	}
+}
+
+static void put_plugin(cache_writer_t *w, const cp_plugin_info_t *plugin) {
+	unsigned int i;
+
+	put_str(w, plugin->identifier);
+	put_str(w, plugin->name);
+	put_str(w, plugin->version);
+	put_str(w, plugin->provider_name);
+	put_str(w, plugin->abi_bw_compatibility);
+	put_str(w, plugin->api_bw_compatibility);
+	put_str(w, plugin->req_cpluff_version);
+	put_str(w, plugin->runtime_lib_name);
+	put_str(w, plugin->runtime_funcs_symbol);
+	put_u32(w, plugin->num_imports);
+	for (i = 0; i < plugin->num_imports; i++) {
+		put_str(w, plugin->imports[i].plugin_id);
+		put_str(w, plugin->imports[i].version);
+		put_u32(w, plugin->imports[i].optional);
+	}
+	put_u32(w, plugin->num_ext_points);
+	for (i = 0; i < plugin->num_ext_points; i++) {
+		put_str(w, plugin->ext_points[i].local_id);
+		put_str(w, plugin->ext_points[i].identifier);
+		put_str(w, plugin->ext_points[i].name);
+		put_str(w, plugin->ext_points[i].schema_path);
+	}
+	put_u32(w, plugin->num_extensions);
+	for (i = 0; i < plugin->num_extensions; i++) {
+		put_str(w, plugin->extensions[i].ext_point_id);
+		put_str(w, plugin->extensions[i].local_id);
+		put_str(w, plugin->extensions[i].identifier);
+		put_str(w, plugin->extensions[i].name);
+		put_u32(w, plugin->extensions[i].configuration != NULL);
+		if (plugin->extensions[i].configuration != NULL) {
+			put_cfg_element(w, plugin->extensions[i].configuration);
+		}
+	}
+}
+
+static unsigned long get_u32(cache_reader_t *r) {
+	unsigned long v;
+
+	if (r->error || r->end - r->ptr < 4) {
+		r->error = 1;
+		return 0;
+	}
+	v = (unsigned long) r->ptr[0]
+		| ((unsigned long) r->ptr[1] << 8)
+		| ((unsigned long) r->ptr[2] << 16)
+		| ((unsigned long) r->ptr[3] << 24);
+	r->ptr += 4;
+	return v;
+}
+
+/**
+ * Reads a count of items each taking at least four bytes and checks that
+ * the count is plausible for the remaining data.
+ */
+static unsigned int get_count(cache_reader_t *r) {
+	unsigned long n = get_u32(r);
+
+	if (!r->error && n > (unsigned long) (r->end - r->ptr) / 4) {
+		r->error = 1;
+		return 0;
+	}
+	return n;
+}
+
+/**
+ * Reads a string without copying it. Returns the length plus one, or zero
+ * for a NULL string.
+ */
+static size_t get_str_ref(cache_reader_t *r, const char **str) {
+	unsigned long len = get_u32(r);
+
+	*str = NULL;
+	if (r->error || len == 0) {
+		return 0;
+	}
+	if (len - 1 > (unsigned long) (r->end - r->ptr)) {
+		r->error = 1;
+		return 0;
+	}
+	*str = (const char *) r->ptr;
+	r->ptr += len - 1;
+	return len;
+}
+
+/**
+ * Allocates zero-filled memory from the arena of the plug-in information
+ * being read.
+ */
+static void *get_alloc(cache_reader_t *r, size_t size) {
+	void *ptr;
+
+	if ((ptr = cpi_arena_alloc(r->arena, size)) == NULL) {
+		r->error = 1;
+		return NULL;
+	}
+	memset(ptr, 0, size);
+	return ptr;
+}
+
+static char *get_str(cache_reader_t *r) {
+	const char *str;
+	size_t len;
+	char *s;
+
+	if ((len = get_str_ref(r, &str)) == 0) {
+		return NULL;
+	}
+	if ((s = cpi_arena_alloc(r->arena, len * sizeof(char))) == NULL) {
+		r->error = 1;
+		return NULL;
+	}
+	memcpy(s, str, len - 1);
+	s[len - 1] = '\0';
+	return s;
+}
+
+static void get_cfg_element(cache_reader_t *r, cp_cfg_element_t *ce, cp_cfg_element_t *parent, unsigned int index) {
+	unsigned int num_atts;
+	unsigned int i;
+
+	memset(ce, 0, sizeof(cp_cfg_element_t));
+	ce->parent = parent;
+	ce->index = index;
+	ce->name = get_str(r);
+
+	// Attribute names and values share a single data block
+	num_atts = get_count(r);
+	if (num_atts > 0 && !r->error) {
+		const cache_reader_t start = *r;
+		size_t attr_size = 0;
+		char *attr_data;
+
+		for (i = 0; i < 2 * num_atts; i++) {
+			const char *str;
+
+			attr_size += get_str_ref(r, &str);
+			if (str == NULL) {
+				r->error = 1;
+			}
+		}
+		if (r->error
+			|| (ce->atts = cpi_alloc_cfg_atts(r->arena, num_atts)) == NULL
+			|| (attr_data = get_alloc(r, attr_size * sizeof(char))) == NULL) {
+			r->error = 1;
+			return;
+		}
+		*r = start;
+		for (i = 0; i < 2 * num_atts; i++) {
+			const char *str;
+			size_t len = get_str_ref(r, &str);
+
+			memcpy(attr_data, str, len - 1);
+			attr_data[len - 1] = '\0';
+			ce->atts[i] = attr_data;
+			attr_data += len;
+		}
+		ce->num_atts = num_atts;
+	}
+
+	ce->value = get_str(r);
+	ce->num_children = get_count(r);
+	if (ce->num_children > 0 && !r->error) {
+		if ((ce->children = cpi_alloc_cfg_children(r->arena, ce->num_children)) == NULL) {
+			ce->num_children = 0;
+			r->error = 1;
+			return;
+		}
+		for (i = 0; i < ce->num_children && !r->error; i++) {
+			get_cfg_element(r, ce->children + i, ce, i);
+		}
+	} else {
+		ce->num_children = 0;
+	}
+	if (!r->error) {
+		cpi_index_cfg_element(r->arena, ce);
+	}
+}
+
+static cp_plugin_info_t *get_plugin(cache_reader_t *r) {
+	cp_plugin_info_t *plugin;
+	unsigned int n, i;
+
+	if ((plugin = cpi_new_plugin_info(r->end - r->ptr)) == NULL) {
+		return NULL;
+	}
+	r->arena = cpi_plugin_arena(plugin);
+	plugin->identifier = get_str(r);
+	plugin->name = get_str(r);
+	plugin->version = get_str(r);
+	plugin->provider_name = get_str(r);
+	plugin->abi_bw_compatibility = get_str(r);
+	plugin->api_bw_compatibility = get_str(r);
+	plugin->req_cpluff_version = get_str(r);
+	plugin->runtime_lib_name = get_str(r);
+	plugin->runtime_funcs_symbol = get_str(r);
+	do {
+
+		// Imports
+		if ((n = get_count(r)) > 0 && !r->error) {
+			if ((plugin->imports = get_alloc(r, n * sizeof(cp_plugin_import_t))) == NULL) {
+				r->error = 1;
+				break;
+			}
+			plugin->num_imports = n;
+			for (i = 0; i < n; i++) {
+				plugin->imports[i].plugin_id = get_str(r);
+				plugin->imports[i].version = get_str(r);
+				plugin->imports[i].optional = (get_u32(r) != 0);
+			}
+		}
+
+		// Extension points
+		if ((n = get_count(r)) > 0 && !r->error) {
+			if ((plugin->ext_points = get_alloc(r, n * sizeof(cp_ext_point_t))) == NULL) {
+				r->error = 1;
+				break;
+			}
+			plugin->num_ext_points = n;
+			for (i = 0; i < n; i++) {
+				plugin->ext_points[i].plugin = plugin;
+				plugin->ext_points[i].local_id = get_str(r);
+				plugin->ext_points[i].identifier = get_str(r);
+				plugin->ext_points[i].name = get_str(r);
+				plugin->ext_points[i].schema_path = get_str(r);
+			}
+		}
+
+		// Extensions
+		if ((n = get_count(r)) > 0 && !r->error) {
+			if ((plugin->extensions = get_alloc(r, n * sizeof(cp_extension_t))) == NULL) {
+				r->error = 1;
+				break;
+			}
+			plugin->num_extensions = n;
+			for (i = 0; i < n && !r->error; i++) {
+				cp_extension_t *extension = plugin->extensions + i;
+
+				extension->plugin = plugin;
+				extension->ext_point_id = get_str(r);
+				extension->local_id = get_str(r);
+				extension->identifier = get_str(r);
+				extension->name = get_str(r);
+				if (get_u32(r) && !r->error) {
+					if ((extension->configuration = get_alloc(r, sizeof(cp_cfg_element_t))) == NULL) {
+						r->error = 1;
+						break;
+					}
+					get_cfg_element(r, extension->configuration, NULL, 0);
+				}
+			}
+		}
+
+		// Required fields and trailing data
+		if (plugin->identifier == NULL || r->ptr != r->end) {
+			r->error = 1;
+			break;
+		}
+		
+		// Versions are compared without parsing them again
+		if (cpi_tokenize_plugin_versions(plugin) != CP_OK) {
+			r->error = 1;
+		}
+
+	} while (0);
+
+	if (r->error) {
+		cpi_free_plugin(plugin);
+		plugin = NULL;
+	}
+	return plugin;
+}
+
+/**
+ * Writes the header values identifying the descriptor file version.
+ */
+static void put_stamp(cache_writer_t *w, const struct stat *st) {
+	put_u32(w, (unsigned long) (st->st_size & 0xffffffffUL));
+	put_u32(w, (unsigned long) (((st->st_size >> 16) >> 16) & 0xffffffffUL));
+	put_u32(w, (unsigned long) (st->st_mtime & 0xffffffffUL));
+	put_u32(w, (unsigned long) (((st->st_mtime >> 16) >> 16) & 0xffffffffUL));
+}
+
+/**
+ * Reads the whole content of a file into memory.
+ *
+ * @param name the file name
+ * @param length pointer to the location where the length is stored
+ * @return the newly allocated content or NULL on failure
+ */
+static unsigned char *read_file(const char *name, size_t *length) {
+	FILE *fh;
+	unsigned char *data = NULL;
+	struct stat st;
+
+	if (stat(name, &st) || st.st_size < CACHE_HEADER_SIZE) {
+		return NULL;
+	}
+	if ((fh = fopen(name, "rb")) == NULL) {
+		return NULL;
+	}
+	if ((data = malloc(st.st_size)) != NULL
+		&& fread(data, 1, st.st_size, fh) != (size_t) st.st_size) {
+		free(data);
+		data = NULL;
+	}
+	fclose(fh);
+	*length = st.st_size;
+	return data;
+}
+
+CP_HIDDEN cp_plugin_info_t *cpi_load_cached_descriptor(cp_context_t *context, list_t *log, const char *file, const struct stat *st) {
+	const char *dir = context->env->descriptor_cache_dir;
+	const char *root = context->env->plugin_descriptor_root_element;
+	char *name = NULL;
+	unsigned char *data = NULL;
+	cp_plugin_info_t *plugin = NULL;
+
+	assert(dir != NULL);
+	do {
+		cache_writer_t stamp;
+		cache_reader_t r;
+		const char *str;
+		size_t length;
+		unsigned long body_length;
+		unsigned long checksum;
+
+		// Read the cache file, if any
+		if ((name = cache_file_name(dir, file)) == NULL) {
+			break;
+		}
+		if ((data = read_file(name, &length)) == NULL) {
+			break;
+		}
+
+		// Check the header
+		r.ptr = data;
+		r.end = data + length;
+		r.error = 0;
+		if (memcmp(r.ptr, CACHE_MAGIC, 4)) {
+			break;
+		}
+		r.ptr += 4;
+		if (get_u32(&r) != CACHE_FORMAT_VERSION) {
+			break;
+		}
+		body_length = get_u32(&r);
+		checksum = get_u32(&r);
+		memset(&stamp, 0, sizeof(stamp));
+		put_stamp(&stamp, st);
+		if (stamp.error || memcmp(r.ptr, stamp.data, stamp.length)) {
+			free(stamp.data);
+			break;
+		}
+		r.ptr += stamp.length;
+		free(stamp.data);
+		if (body_length != (unsigned long) (r.end - r.ptr)
+			|| checksum != cpi_fnv_hash(r.ptr, body_length, CPI_FNV_INIT)) {
+			break;
+		}
+
+		// Check that the cache file is for this descriptor and root element
+		if (get_str_ref(&r, &str) != strlen(file) + 1 || strncmp(str, file, strlen(file))) {
+			break;
+		}
+		if (get_str_ref(&r, &str) != strlen(root) + 1 || strncmp(str, root, strlen(root))) {
+			break;
+		}
+
+		// Reconstruct the plug-in information
+		if ((plugin = get_plugin(&r)) == NULL) {
+			cpi_logf_deferred(context, log, CP_LOG_WARNING, N_("Ignoring invalid descriptor cache file %s."), name);
+			break;
+		}
+		cpi_logf_deferred(context, log, CP_LOG_DEBUG, N_("Plug-in descriptor %s was loaded from the descriptor cache."), file);
+
+	} while (0);
+
+	free(name);
+	free(data);
+	return plugin;
+}
+
+CP_HIDDEN void cpi_store_cached_descriptor(cp_context_t *context, list_t *log, const char *file, const struct stat *st, const cp_plugin_info_t *plugin) {
+	const char *dir = context->env->descriptor_cache_dir;
+	cache_writer_t w;
+	cache_writer_t body;
+	char *name = NULL;
+	char *tmp_name = NULL;
+	FILE *fh = NULL;
+	int success = 0;
+
+	assert(dir != NULL);
+	memset(&w, 0, sizeof(w));
+	memset(&body, 0, sizeof(body));
+	do {
+
+		// Serialize the plug-in information
+		put_str(&body, file);
+		put_str(&body, context->env->plugin_descriptor_root_element);
+		put_plugin(&body, plugin);
+		put_bytes(&w, CACHE_MAGIC, 4);
+		put_u32(&w, CACHE_FORMAT_VERSION);
+		put_u32(&w, body.length);
+		put_u32(&w, cpi_fnv_hash(body.data, body.length, CPI_FNV_INIT));
+		put_stamp(&w, st);
+		put_bytes(&w, body.data, body.length);
+		if (w.error || body.error) {
+			break;
+		}
+
+		// Write to a temporary file and then replace the cache file
+		if ((name = cache_file_name(dir, file)) == NULL
+			|| (tmp_name = malloc((strlen(name) + 5) * sizeof(char))) == NULL) {
+			break;
+		}
+		strcpy(tmp_name, name);
+		strcat(tmp_name, ".tmp");
+		if ((fh = fopen(tmp_name, "wb")) == NULL) {
+			break;
+		}
+		if (fwrite(w.data, 1, w.length, fh) != w.length) {
+			break;
+		}
+		if (fclose(fh)) {
+			fh = NULL;
+			break;
+		}
+		fh = NULL;
+		remove(name);
+		if (rename(tmp_name, name)) {
+			break;
+		}
+		success = 1;
+
+	} while (0);
+
+	// Report failure, but otherwise carry on without the cache
+	if (!success) {
+		cpi_logf_deferred(context, log, CP_LOG_WARNING, N_("Could not write the descriptor cache file for %s: %s"), file, strerror(errno));
+	}
+
+	// Release resources
+	if (fh != NULL) {
+		fclose(fh);
+	}
+	if (tmp_name != NULL) {
+		if (!success) {
+			remove(tmp_name);
+		}
+		free(tmp_name);
+	}
+	free(name);
+	free(w.data);
+	free(body.data);
+}
+
+#endif //HAVE_STAT
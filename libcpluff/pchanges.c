@@ -0,0 +1,272 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file
+ * Registry generations and the change feed
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "cpluff.h"
+#include "defines.h"
+#include "util.h"
+#include "internal.h"
+
+
+/* ------------------------------------------------------------------------
+ * Constants
+ * ----------------------------------------------------------------------*/
+
+/// The maximum number of changes kept in the change feed
+#define CHANGE_FEED_SIZE 256
+
+
+/* ------------------------------------------------------------------------
+ * Internal functions
+ * ----------------------------------------------------------------------*/
+
+#ifdef CP_THREADS
+#define advance_generation(env) cpi_atomic_increment(&((env)->generation))
+#define load_generation(gen) cpi_atomic_load(&(gen))
+#define store_generation(gen, value) cpi_atomic_store(&(gen), (value))
+#else
+#define advance_generation(env) (++((env)->generation))
+#define load_generation(gen) (gen)
+#define store_generation(gen, value) ((gen) = (value))
+#endif
+
+/**
+ * Returns the generation slot for the specified identifier.
+ * 
+ * @param id the plug-in or extension point identifier
+ * @return the slot index
+ */
+static unsigned int generation_slot(const char *id) {
+	return cpi_fnv_hash(id, strlen(id), CPI_FNV_INIT) % CPI_GENERATION_SLOTS;
+}
+
+/**
+ * Appends a change to the change feed, discarding the oldest change if
+ * the feed is full. Changes are not recorded if the feed has not been
+ * enabled or if there are insufficient resources, in which case the
+ * change is considered discarded.
+ * 
+ * @param env the plug-in environment
+ * @param generation the generation after the change
+ * @param type the change type
+ * @param id the affected identifier
+ */
+static void append_change(cp_plugin_env_t *env, unsigned long generation, int type, const char *id) {
+	cp_change_t *change;
+	char *cid;
+	
+	if (env->changes == NULL) {
+		return;
+	}
+	if ((cid = strdup(id)) == NULL) {
+		env->changes_discarded = generation;
+		return;
+	}
+	if (env->num_changes == CHANGE_FEED_SIZE) {
+		change = env->changes + env->changes_head;
+		env->changes_discarded = change->generation;
+		free(change->id);
+		env->changes_head = (env->changes_head + 1) % CHANGE_FEED_SIZE;
+		env->num_changes--;
+	}
+	change = env->changes + (env->changes_head + env->num_changes) % CHANGE_FEED_SIZE;
+	change->generation = generation;
+	change->type = type;
+	change->id = cid;
+	env->num_changes++;
+}
+
+CP_HIDDEN void cpi_record_change(cp_context_t *context, int type, const char *id) {
+	cp_plugin_env_t *env = context->env;
+	long generation;
+	
+	assert(cpi_is_context_locked(context));
+	assert(type != CP_CHANGE_RESET);
+	generation = advance_generation(env);
+	switch (type) {
+		case CP_CHANGE_PLUGINS:
+			store_generation(env->plugins_generation, generation);
+			break;
+		case CP_CHANGE_EXTENSIONS:
+			store_generation(env->ext_generations[generation_slot(id)], generation);
+			break;
+		case CP_CHANGE_PLUGIN_STATE:
+			store_generation(env->state_generations[generation_slot(id)], generation);
+			break;
+		default:
+			assert(0);
+			break;
+	}
+	append_change(env, (unsigned long) generation, type, id);
+}
+
+CP_HIDDEN void cpi_record_plugin_changes(cp_context_t *context, const cp_plugin_info_t *plugin) {
+	unsigned int i, j;
+	
+	cpi_record_change(context, CP_CHANGE_PLUGINS, plugin->identifier);
+	for (i = 0; i < plugin->num_extensions; i++) {
+		const char *epid = plugin->extensions[i].ext_point_id;
+		
+		for (j = 0; j < i && strcmp(plugin->extensions[j].ext_point_id, epid); j++);
+		if (j == i) {
+			cpi_record_change(context, CP_CHANGE_EXTENSIONS, epid);
+		}
+	}
+}
+
+CP_HIDDEN void cpi_free_change_feed(cp_plugin_env_t *env) {
+	unsigned int i;
+	
+	if (env->changes == NULL) {
+		return;
+	}
+	for (i = 0; i < env->num_changes; i++) {
+		free(env->changes[(env->changes_head + i) % CHANGE_FEED_SIZE].id);
+	}
+	free(env->changes);
+	env->changes = NULL;
+	env->num_changes = 0;
+}
+
+static void dealloc_changes(cp_context_t *context, cp_change_t *changes) {
+	cpi_free_info(changes);
+}
+
+
+/* ------------------------------------------------------------------------
+ * API functions
+ * ----------------------------------------------------------------------*/
+
+CP_C_API unsigned long cp_get_generation(cp_context_t *context) {
+	CHECK_NOT_NULL(context);
+	return (unsigned long) load_generation(context->env->generation);
+}
+
+CP_C_API unsigned long cp_get_plugins_generation(cp_context_t *context) {
+	CHECK_NOT_NULL(context);
+	return (unsigned long) load_generation(context->env->plugins_generation);
+}
+
+CP_C_API unsigned long cp_get_extensions_generation(cp_context_t *context, const char *ext_point_id) {
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(ext_point_id);
+	return (unsigned long) load_generation(context->env->ext_generations[generation_slot(ext_point_id)]);
+}
+
+CP_C_API unsigned long cp_get_plugin_generation(cp_context_t *context, const char *id) {
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(id);
+	return (unsigned long) load_generation(context->env->state_generations[generation_slot(id)]);
+}
+
+CP_C_API cp_change_t * cp_get_changes(cp_context_t *context, unsigned long since, cp_status_t *error, int *num) {
+	cp_plugin_env_t *env;
+	cp_change_t *changes = NULL;
+	cp_status_t status = CP_OK;
+	size_t bytes = 0;
+	unsigned int first, i;
+	int n = 0;
+	
+	CHECK_NOT_NULL(context);
+	env = context->env;
+	
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+	do {
+		char *ids;
+		int reset;
+		
+		// Enable the change feed on first use
+		if (env->changes == NULL) {
+			if ((env->changes = malloc(CHANGE_FEED_SIZE * sizeof(cp_change_t))) == NULL) {
+				status = CP_ERR_RESOURCE;
+				break;
+			}
+			env->changes_head = 0;
+			env->num_changes = 0;
+			env->changes_discarded = (unsigned long) env->generation;
+		}
+		
+		// Find the first change to be returned
+		reset = (since < env->changes_discarded);
+		for (first = 0; !reset && first < env->num_changes
+			&& env->changes[(env->changes_head + first) % CHANGE_FEED_SIZE].generation <= since; first++);
+		if (reset) {
+			n = 1;
+		} else {
+			n = env->num_changes - first;
+			for (i = first; i < env->num_changes; i++) {
+				bytes += strlen(env->changes[(env->changes_head + i) % CHANGE_FEED_SIZE].id) + 1;
+			}
+		}
+		
+		// Allocate space for the entries followed by the identifiers
+		if ((changes = cpi_alloc_info(sizeof(cp_change_t) * (n + 1) + bytes)) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		memset(changes, 0, sizeof(cp_change_t) * (n + 1));
+		ids = (char *) (changes + n + 1);
+		
+		// Copy the changes
+		if (reset) {
+			changes[0].generation = (unsigned long) env->generation;
+			changes[0].type = CP_CHANGE_RESET;
+		} else {
+			for (i = 0; i < (unsigned int) n; i++) {
+				const cp_change_t *c = env->changes + (env->changes_head + first + i) % CHANGE_FEED_SIZE;
+				
+				changes[i].generation = c->generation;
+				changes[i].type = c->type;
+				strcpy(ids, c->id);
+				changes[i].id = ids;
+				ids += strlen(ids) + 1;
+			}
+		}
+		
+	} while (0);
+	
+	// Register the array as an information object
+	if (status == CP_OK) {
+		cpi_register_info(context, changes, (void (*)(cp_context_t *, void *)) dealloc_changes);
+	}
+	cpi_unlock_context(context);
+	
+	if (error != NULL) {
+		*error = status;
+	}
+	if (num != NULL && status == CP_OK) {
+		*num = n;
+	}
+	return changes;
+}
@@ -42,6 +42,310 @@
 #include "internal.h"
 
 
+/* ------------------------------------------------------------------------
+ * Data types
+ * ----------------------------------------------------------------------*/
+
+/// Plug-in information allocated from the arena holding all its content
+typedef struct plugin_info_block_t {
+	
+	/// The reference count header, must immediately precede the information
+	cpi_info_header_t header;
+	
+	/// The plug-in information
+	cp_plugin_info_t info;
+	
+	/// The arena holding the plug-in information
+	cpi_arena_t *arena;
+	
+	/// Information about lazily parsed extension configuration, or NULL
+	cpi_lazy_cfg_t *lazy_cfg;
+	
+	/// The plug-in image holding the content shared with other processes, or NULL
+	cpi_plugin_image_t *image;
+	
+	/// The time taken to load the information in microseconds
+	unsigned long long parse_usecs;
+	
+	/// Whether the versions have been tokenized
+	int versions_tokenized;
+	
+	/// The tokenized plug-in version, or NULL if none
+	cpi_version_t *version;
+	
+	/// The tokenized backwards compatibility version, or NULL if none
+	cpi_version_t *abi_bw_compatibility;
+	
+	/// The tokenized import versions, NULL where none
+	cpi_version_t **import_versions;
+} plugin_info_block_t;
+
+/// States of a plug-in start or stop task
+typedef enum start_task_state_t {
+	
+	/// Waiting for imported plug-ins to become active
+	START_TASK_PENDING,
+	
+	/// Waiting for a worker thread to execute the start function
+	START_TASK_QUEUED,
+	
+	/// The start function is being executed
+	START_TASK_RUNNING,
+	
+	/// The start function has returned but the start is not completed
+	START_TASK_FINISHED,
+	
+	/// The plug-in has been started
+	START_TASK_DONE,
+	
+	/// The plug-in could not be started
+	START_TASK_FAILED
+	
+} start_task_state_t;
+
+typedef struct start_task_t start_task_t;
+
+/// A plug-in to be started as part of a parallel start
+struct start_task_t {
+	
+	/// The plug-in
+	cp_plugin_t *plugin;
+	
+	/// The current state of the task
+	start_task_state_t state;
+	
+	/// The tasks of imported plug-ins which must be started first
+	start_task_t **prereqs;
+	
+	/// The number of prerequisite tasks
+	int num_prereqs;
+	
+	/// The list node for the list of started plug-ins
+	lnode_t *node;
+	
+	/// The value returned by the start function
+	int start_status;
+	
+	/// The status of the start
+	cp_status_t status;
+	
+	/// The next task in the queue
+	start_task_t *next_queued;
+	
+};
+
+/// A parallel start of plug-ins, protected by the context lock
+typedef struct start_batch_t {
+	
+	/// The plug-in context
+	cp_context_t *context;
+	
+	/// The tasks in topological order
+	start_task_t *tasks;
+	
+	/// The number of tasks
+	int num_tasks;
+	
+	/// Maps plug-ins to their tasks
+	hash_t *task_map;
+	
+	/// The first queued task
+	start_task_t *queue_head;
+	
+	/// The last queued task
+	start_task_t *queue_tail;
+	
+	/// The number of start functions queued or being executed
+	int num_running;
+	
+	/// The number of worker threads still running
+	unsigned int num_workers;
+	
+	/// Whether the worker threads should exit
+	int shutdown;
+	
+} start_batch_t;
+
+typedef struct stop_task_t stop_task_t;
+
+/// A plug-in to be stopped as part of a parallel stop
+struct stop_task_t {
+	
+	/// The plug-in
+	cp_plugin_t *plugin;
+	
+	/// The current state of the task
+	start_task_state_t state;
+	
+	/// The next task in the queue
+	stop_task_t *next_queued;
+	
+};
+
+/// A parallel stop of plug-ins, protected by the context lock
+typedef struct stop_batch_t {
+	
+	/// The plug-in context
+	cp_context_t *context;
+	
+	/// The tasks in reverse start order
+	stop_task_t *tasks;
+	
+	/// The number of tasks
+	int num_tasks;
+	
+	/// The head of the stop function queue
+	stop_task_t *queue_head;
+	
+	/// The tail of the stop function queue
+	stop_task_t *queue_tail;
+	
+	/// The number of queued or running stop functions
+	int num_running;
+	
+	/// The number of worker threads
+	unsigned int num_workers;
+	
+	/// Whether the worker threads should exit
+	int shutdown;
+	
+} stop_batch_t;
+
+/// States of preloading a plug-in runtime library
+typedef enum preload_state_t {
+	
+	/// Nothing to be preloaded
+	PRELOAD_NONE,
+	
+	/// Waiting for the runtime libraries of imported plug-ins
+	PRELOAD_PENDING,
+	
+	/// Waiting for a worker thread to open the runtime library
+	PRELOAD_QUEUED,
+	
+	/// The runtime library is being opened
+	PRELOAD_RUNNING,
+	
+	/// The runtime library has been opened
+	PRELOAD_DONE,
+	
+	/// The runtime library could not be opened or was not opened due to a failed import
+	PRELOAD_FAILED
+	
+} preload_state_t;
+
+typedef struct resolve_node_t resolve_node_t;
+
+/// A plug-in being visited when resolving all the plug-ins
+struct resolve_node_t {
+	
+	/// The plug-in
+	cp_plugin_t *plugin;
+	
+	/// The imported plug-ins, NULL for missing optional imports
+	cp_plugin_t **imports;
+	
+	/// The number of imported plug-ins
+	int num_imports;
+	
+	/// The index of the next import to be visited
+	int next_import;
+	
+	/// The visiting order of the plug-in, or -1 if not yet visited
+	int index;
+	
+	/// The smallest visiting order reachable from the plug-in
+	int lowlink;
+	
+	/// Whether the plug-in is on the component stack
+	int on_stack;
+	
+	/// The strongly connected component of the plug-in, or -1 if unknown
+	int component;
+	
+	/// The status of resolving the plug-in
+	cp_status_t status;
+	
+	/// The state of preloading the runtime library
+	preload_state_t load_state;
+	
+	/// The path of the runtime library to be preloaded, or NULL if none
+	char *rlpath;
+	
+	/// The preloaded runtime library, or NULL if none
+	DLHANDLE lib;
+	
+	/// The prebound runtime functions, or NULL if not bound
+	cp_plugin_runtime_t *funcs;
+	
+	/// The error message of a failed preload, or NULL if none
+	char *load_error;
+	
+	/// The time taken to open the runtime library in microseconds
+	unsigned long long load_usecs;
+	
+	/// The next node in the preload queue
+	resolve_node_t *next_queued;
+	
+};
+
+/// Resolving of all the plug-ins, protected by the context lock
+typedef struct resolve_batch_t {
+	
+	/// The plug-in context
+	cp_context_t *context;
+	
+	/// The visited plug-ins
+	resolve_node_t *nodes;
+	
+	/// Maps plug-ins to their nodes
+	hash_t *node_map;
+	
+	/// The resolved plug-ins in resolution order
+	cp_plugin_t **order;
+	
+	/// The number of resolved plug-ins
+	int num_order;
+	
+	/// The events of the newly resolved plug-ins
+	cpi_plugin_event_t *events;
+	
+	/// The number of events
+	int num_events;
+	
+	/// The number of components found so far
+	int num_components;
+	
+	/// The status of the first failure
+	cp_status_t status;
+	
+	/// Whether the runtime libraries are preloaded once all components are found
+	int preload;
+	
+	/// The plug-ins of the components waiting for preloading, in dependency order
+	resolve_node_t **deferred;
+	
+	/// The number of deferred plug-ins
+	int num_deferred;
+	
+	/// The head of the preload queue
+	resolve_node_t *queue_head;
+	
+	/// The tail of the preload queue
+	resolve_node_t *queue_tail;
+	
+	/// The number of queued or running preloads
+	int num_running;
+	
+	/// The number of worker threads
+	unsigned int num_workers;
+	
+	/// Whether the worker threads should exit
+	int shutdown;
+	
+} resolve_batch_t;
+
+
 /* ------------------------------------------------------------------------
  * Function definitions
  * ----------------------------------------------------------------------*/
@@ -63,66 +367,163 @@ static void assert_processed_zero(cp_context_t *context) {
 #define assert_processed_zero(c) assert(1)
 #endif
 
-static void unregister_extensions(cp_context_t *context, cp_plugin_info_t *plugin) {
+/**
+ * Invalidates the cached resolution order of all plug-ins.
+ * 
+ * @param env the plug-in environment
+ */
+static void invalidate_resolve_order(cp_plugin_env_t *env) {
+	free(env->resolve_order);
+	env->resolve_order = NULL;
+	env->num_resolve_order = 0;
+}
+
+CP_HIDDEN int cpi_ext_index_lower_bound(const cp_plugin_env_t *env, const char *id) {
+	int lo = 0, hi = env->num_ext_index;
+	
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		
+		if (strcmp(hnode_getkey(env->ext_index[mid]), id) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/**
+ * Adds a node of the extensions map into the extension index.
+ * 
+ * @param env the plug-in environment
+ * @param hnode the node
+ * @return whether successful
+ */
+static int index_extensions(cp_plugin_env_t *env, hnode_t *hnode) {
+	int pos;
+	
+	if (env->num_ext_index == env->size_ext_index) {
+		int ns = (env->size_ext_index > 0 ? 2 * env->size_ext_index : 16);
+		hnode_t **ni;
+		
+		if ((ni = realloc(env->ext_index, ns * sizeof(hnode_t *))) == NULL) {
+			return 0;
+		}
+		env->ext_index = ni;
+		env->size_ext_index = ns;
+	}
+	pos = cpi_ext_index_lower_bound(env, hnode_getkey(hnode));
+	memmove(env->ext_index + pos + 1, env->ext_index + pos, (env->num_ext_index - pos) * sizeof(hnode_t *));
+	env->ext_index[pos] = hnode;
+	env->num_ext_index++;
+	return 1;
+}
+
+/**
+ * Removes a node of the extensions map from the extension index.
+ * 
+ * @param env the plug-in environment
+ * @param hnode the node
+ */
+static void unindex_extensions(cp_plugin_env_t *env, hnode_t *hnode) {
+	int pos = cpi_ext_index_lower_bound(env, hnode_getkey(hnode));
+	
+	assert(pos < env->num_ext_index && env->ext_index[pos] == hnode);
+	env->num_ext_index--;
+	memmove(env->ext_index + pos, env->ext_index + pos + 1, (env->num_ext_index - pos) * sizeof(hnode_t *));
+}
+
+/**
+ * Unregisters the extension points and extensions of a plug-in. Each
+ * extension is removed from its extension array in constant time using
+ * the slot index recorded at registration.
+ * 
+ * @param context the plug-in context
+ * @param rp the plug-in state
+ */
+static void unregister_extensions(cp_context_t *context, cp_plugin_t *rp) {
+	cp_plugin_info_t *plugin = rp->plugin;
 	int i;
 	
+	cpi_invalidate_ext_snapshot(context);
+	cpi_release_template_image(context->env);
 	for (i = 0; i < plugin->num_ext_points; i++) {
 		cp_ext_point_t *ep = plugin->ext_points + i;
 		hnode_t *hnode;
 		
 		if ((hnode = hash_lookup(context->env->ext_points, ep->identifier)) != NULL
 			&& hnode_get(hnode) == ep) {
+			const char *epid = hnode_getkey(hnode);
 			hash_delete_free(context->env->ext_points, hnode);
+			cpi_release_string(context->env->strings, epid);
 		}
 	}
-	for (i = 0; i < plugin->num_extensions; i++) {
+	for (i = 0; rp->ext_slots != NULL && i < plugin->num_extensions; i++) {
 		cp_extension_t *e = plugin->extensions + i;
 		hnode_t *hnode;
 		
-		if ((hnode = hash_lookup(context->env->extensions, e->ext_point_id)) != NULL) {
-			list_t *el = hnode_get(hnode);
-			lnode_t *lnode = list_first(el);
+		if (rp->ext_slots[i] >= 0
+			&& (hnode = hash_lookup(context->env->extensions, e->ext_point_id)) != NULL) {
+			cpi_ptrvec_t *ev = hnode_get(hnode);
 			
-			while (lnode != NULL) {
-				lnode_t *nn = list_next(el, lnode);
-				if (lnode_get(lnode) == e) {
-					list_delete(el, lnode);
-					lnode_destroy(lnode);
-					break;
-				}
-				lnode = nn;
-			}
-			if (list_isempty(el)) {
-				char *epid = (char *) hnode_getkey(hnode);				
+			assert(ev->ptrs[rp->ext_slots[i]] == e);
+			cpi_ptrvec_remove(ev, rp->ext_slots[i]);
+			rp->ext_slots[i] = -1;
+			if (ev->count == 0) {
+				const char *epid = hnode_getkey(hnode);
+				unindex_extensions(context->env, hnode);
 				hash_delete_free(context->env->extensions, hnode);
-				free(epid);
-				list_destroy(el);
+				cpi_release_string(context->env->strings, epid);
+				cpi_destroy_ptrvec(ev);
 			}
 		}
 	}
+	free(rp->ext_slots);
+	rp->ext_slots = NULL;
 }
 
-CP_HIDDEN cp_status_t cpi_install_plugin(cp_context_t *context, cp_plugin_info_t *plugin, cp_plugin_loader_t *loader) {
+/**
+ * Removes a registered plug-in which has not yet been reported installed.
+ * 
+ * @param context the plug-in context
+ * @param rp the plug-in state
+ */
+static void discard_plugin(cp_context_t *context, cp_plugin_t *rp) {
+	hnode_t *hnode;
+	
+	if ((hnode = hash_lookup(context->env->plugins, rp->plugin->identifier)) != NULL
+		&& hnode_get(hnode) == rp) {
+		const char *pid = hnode_getkey(hnode);
+		hash_delete_free(context->env->plugins, hnode);
+		cpi_release_string(context->env->strings, pid);
+	}
+	unregister_extensions(context, rp);
+	if (rp->importing != NULL) {
+		cpi_destroy_ptrset(rp->importing);
+	}
+	free(rp);
+}
+
+/**
+ * Registers the specified plug-in and its extension points and extensions
+ * without publishing the changes to snapshot readers or delivering the
+ * installation event. Conflicts must have been checked by the caller.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in information structure
+ * @param loader the associated plug-in loader or NULL for none
+ * @param rpp filled with the plug-in state on success
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t register_plugin(cp_context_t *context, cp_plugin_info_t *plugin, cp_plugin_loader_t *loader, cp_plugin_t **rpp) {
 	cp_plugin_t *rp = NULL;
+	const char *pid = NULL;
 	cp_status_t status = CP_OK;
-	cpi_plugin_event_t event;
 	int i;
 
-	assert(cpi_is_context_locked(context));
 	do {
 		
-		// Check that there is no conflicting plug-in already loaded 
-		if (hash_lookup(context->env->plugins, plugin->identifier) != NULL) {
-			cpi_errorf(context,
-				N_("Plug-in %s could not be installed because a plug-in with the same identifier is already installed."), 
-				plugin->identifier);
-			status = CP_ERR_CONFLICT;
-			break;
-		}
-
-		// Increase usage count for the plug-in descriptor
-		cpi_use_info(context, plugin);
-
 		// Allocate space for the plug-in state 
 		if ((rp = malloc(sizeof(cp_plugin_t))) == NULL) {
 			status = CP_ERR_RESOURCE;
@@ -139,12 +540,28 @@ CP_HIDDEN cp_status_t cpi_install_plugin(cp_context_t *context, cp_plugin_info_t
 		rp->runtime_lib = NULL;
 		rp->runtime_funcs = NULL;
 		rp->plugin_data = NULL;
-		rp->importing = list_create(LISTCOUNT_T_MAX);
+		rp->stats.parse_usecs = ((plugin_info_block_t *) ((char *) plugin - offsetof(plugin_info_block_t, info)))->parse_usecs;
+		rp->importing = cpi_create_ptrset();
 		if (rp->importing == NULL) {
 			status = CP_ERR_RESOURCE;
 			break;
 		}
-		if (!hash_alloc_insert(context->env->plugins, plugin->identifier, rp)) {
+		if (plugin->num_extensions > 0) {
+			if ((rp->ext_slots = malloc(plugin->num_extensions * sizeof(int))) == NULL) {
+				status = CP_ERR_RESOURCE;
+				break;
+			}
+			for (i = 0; i < plugin->num_extensions; i++) {
+				rp->ext_slots[i] = -1;
+			}
+		}
+		if ((pid = cpi_intern_string(context->env->strings, plugin->identifier)) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		if (!hash_alloc_insert(context->env->plugins, pid, rp)) {
+			cpi_release_string(context->env->strings, pid);
+			pid = NULL;
 			status = CP_ERR_RESOURCE;
 			break;
 		}
@@ -152,12 +569,13 @@ CP_HIDDEN cp_status_t cpi_install_plugin(cp_context_t *context, cp_plugin_info_t
 		// Register extension points
 		for (i = 0; status == CP_OK && i < plugin->num_ext_points; i++) {
 			cp_ext_point_t *ep = plugin->ext_points + i;
-			hnode_t *hnode;
+			const char *epid;
 			
-			if ((hnode = hash_lookup(context->env->ext_points, ep->identifier)) != NULL) {
-				cpi_errorf(context, N_("Plug-in %s could not be installed because extension point %s conflicts with an already installed extension point."), plugin->identifier, ep->identifier);
-				status = CP_ERR_CONFLICT;
-			} else if (!hash_alloc_insert(context->env->ext_points, ep->identifier, ep)) {
+			assert(hash_lookup(context->env->ext_points, ep->identifier) == NULL);
+			if ((epid = cpi_intern_string(context->env->strings, ep->identifier)) == NULL) {
+				status = CP_ERR_RESOURCE;
+			} else if (!hash_alloc_insert(context->env->ext_points, epid, ep)) {
+				cpi_release_string(context->env->strings, epid);
 				status = CP_ERR_RESOURCE;
 			}
 		}
@@ -166,477 +584,1650 @@ CP_HIDDEN cp_status_t cpi_install_plugin(cp_context_t *context, cp_plugin_info_t
 		for (i = 0; status == CP_OK && i < plugin->num_extensions; i++) {
 			cp_extension_t *e = plugin->extensions + i;
 			hnode_t *hnode;
-			lnode_t *lnode;
-			list_t *el;
+			cpi_ptrvec_t *ev;
 			
 			if ((hnode = hash_lookup(context->env->extensions, e->ext_point_id)) == NULL) {
-				char *epid;
-				if ((el = list_create(LISTCOUNT_T_MAX)) != NULL
-					&& (epid = strdup(e->ext_point_id)) != NULL) {
-					if (!hash_alloc_insert(context->env->extensions, epid, el)) {
-						list_destroy(el);
+				const char *epid;
+				if ((ev = cpi_create_ptrvec()) != NULL
+					&& (epid = cpi_intern_string(context->env->strings, e->ext_point_id)) != NULL) {
+					if (!hash_alloc_insert(context->env->extensions, epid, ev)) {
+						cpi_release_string(context->env->strings, epid);
+						cpi_destroy_ptrvec(ev);
+						status = CP_ERR_RESOURCE;
+						break;
+					}
+					hnode = hash_lookup(context->env->extensions, epid);
+					if (!index_extensions(context->env, hnode)) {
+						hash_delete_free(context->env->extensions, hnode);
+						cpi_release_string(context->env->strings, epid);
+						cpi_destroy_ptrvec(ev);
 						status = CP_ERR_RESOURCE;
 						break;
 					}
 				} else {
-					if (el != NULL) {
-						list_destroy(el);
+					if (ev != NULL) {
+						cpi_destroy_ptrvec(ev);
 					}
 					status = CP_ERR_RESOURCE;
 					break;
 				}
 			} else {
-				el = hnode_get(hnode);
+				ev = hnode_get(hnode);
 			}
-			if ((lnode = lnode_create(e)) != NULL) {
-				list_append(el, lnode);
-			} else {
+			if (!cpi_ptrvec_append(ev, e, rp->ext_slots + i)) {
 				status = CP_ERR_RESOURCE;
 				break;
 			}
 		}
 
-		// Break if previous loops failed
-		if (status != CP_OK) {
-			break;
-		}
-		
-		// Plug-in installed 
-		event.plugin_id = plugin->identifier;
-		event.old_state = CP_PLUGIN_UNINSTALLED;
-		event.new_state = rp->state;
-		cpi_deliver_event(context, &event);
-
 	} while (0);
 
 	// Release resources on failure
 	if (status != CP_OK) {
 		if (rp != NULL) {
-			if (rp->importing != NULL) {
-				list_destroy(rp->importing);
-			}
-			free(rp);
+			discard_plugin(context, rp);
 		}
-		unregister_extensions(context, plugin);
-	}
-
-	// Report possible resource error
-	if (status == CP_ERR_RESOURCE) {
 		cpi_errorf(context,
 			N_("Plug-in %s could not be installed due to insufficient system resources."), plugin->identifier);
+		return status;
 	}
-
-	return status;
-}
-
-CP_C_API cp_status_t cp_install_plugin(cp_context_t *context, cp_plugin_info_t *plugin) {
-	cp_status_t status;
-
-	CHECK_NOT_NULL(context);
-	CHECK_NOT_NULL(plugin);
 	
-	cpi_lock_context(context);
-	cpi_check_invocation(context, CPI_CF_ANY, __func__);
-	status = cpi_install_plugin(context, plugin, NULL);
-	cpi_unlock_context(context);
-
-	return status;
-}
-
-/**
- * Unresolves the plug-in runtime information.
- * 
- * @param plugin the plug-in to unresolve
- */
-static void unresolve_plugin_runtime(cp_plugin_t *plugin) {
-
-	// Destroy the plug-in instance, if necessary
-	if (plugin->context != NULL) {
-		plugin->context->env->in_destroy_func_invocation++;
-		plugin->runtime_funcs->destroy(plugin->plugin_data);
-		plugin->context->env->in_destroy_func_invocation--;
-		plugin->plugin_data = NULL;
-		cpi_free_context(plugin->context);
-		plugin->context = NULL;
-	}
-
-	// Close plug-in runtime library	
-	plugin->runtime_funcs = NULL;
-	if (plugin->runtime_lib != NULL) {
-		DLCLOSE(plugin->runtime_lib);
-		plugin->runtime_lib = NULL;
-	}	
+	// Increase usage count for the plug-in descriptor
+	cpi_use_info(context, plugin);
+	*rpp = rp;
+	return CP_OK;
 }
 
 /**
- * Loads and resolves the plug-in runtime library and initialization functions.
+ * Checks that the specified plug-in does not conflict with the installed
+ * plug-ins or with the plug-ins accepted earlier for the same installation.
+ * The identifiers of an accepted plug-in and its extension points are
+ * added to the specified maps.
  * 
  * @param context the plug-in context
- * @param plugin the plugin
- * @return CP_OK (zero) on success or error code on failure
+ * @param plugin the plug-in information structure
+ * @param pids the identifiers of the accepted plug-ins, or NULL
+ * @param epids the identifiers of the accepted extension points, or NULL
+ * @return @ref CP_OK (zero) on success or an error code on failure
  */
-static int resolve_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
-	char *rlpath = NULL;
-	int rlpath_len;
-	cp_status_t status = CP_OK;
+static cp_status_t check_conflicts(cp_context_t *context, cp_plugin_info_t *plugin, hash_t *pids, hash_t *epids) {
+	int i;
 	
-	assert(plugin->runtime_lib == NULL);
-	if (plugin->plugin->runtime_lib_name == NULL) {
-		return CP_OK;
+	// Check that there is no conflicting plug-in already loaded 
+	if (hash_lookup(context->env->plugins, plugin->identifier) != NULL
+		|| (pids != NULL && hash_lookup(pids, plugin->identifier) != NULL)) {
+		cpi_errorf(context,
+			N_("Plug-in %s could not be installed because a plug-in with the same identifier is already installed."), 
+			plugin->identifier);
+		return CP_ERR_CONFLICT;
 	}
 	
-	do {
-		int ppath_len, lname_len;
-		int cpluff_compatibility = 1;
-	
-		// Check C-Pluff compatibility
-		if (plugin->plugin->req_cpluff_version != NULL) {
-#ifdef CP_ABI_COMPATIBILITY
-			cpluff_compatibility = (
-				cpi_vercmp(plugin->plugin->req_cpluff_version, CP_VERSION) <= 0
-			 	&& cpi_vercmp(plugin->plugin->req_cpluff_version, CP_ABI_COMPATIBILITY) >= 0);
-#else
-			cpluff_compatibility = (cpi_vercmp(plugin->plugin->req_cpluff_version, CP_VERSION) == 0);
-#endif
+	// Check the extension points
+	for (i = 0; i < plugin->num_ext_points; i++) {
+		const char *epid = plugin->ext_points[i].identifier;
+		int j;
+		
+		if (hash_lookup(context->env->ext_points, epid) != NULL
+			|| (epids != NULL && hash_lookup(epids, epid) != NULL)) {
+			cpi_errorf(context, N_("Plug-in %s could not be installed because extension point %s conflicts with an already installed extension point."), plugin->identifier, epid);
+			return CP_ERR_CONFLICT;
 		}
-		if (!cpluff_compatibility) {
-			cpi_errorf(context, N_("Plug-in %s could not be resolved due to version incompatibility with C-Pluff."), plugin->plugin->identifier);
-			status = CP_ERR_DEPENDENCY;
-			break;
+		for (j = 0; j < i; j++) {
+			if (!strcmp(plugin->ext_points[j].identifier, epid)) {
+				cpi_errorf(context, N_("Plug-in %s could not be installed because extension point %s conflicts with an already installed extension point."), plugin->identifier, epid);
+				return CP_ERR_CONFLICT;
+			}
 		}
-		
-		// Resolve files if plug-in loader specified
-		if (plugin->loader != NULL && plugin->loader->resolve_files != NULL) {
-			if (!plugin->loader->resolve_files(plugin->loader->data, context, plugin->plugin)) {
-				cpi_errorf(context, N_("Plug-in %s files could not be resolved with plug-in loader %p."), plugin->plugin->identifier, (void *) plugin->loader);
-				status = CP_ERR_IO;
-				break;
+	}
+	
+	// Accept the plug-in
+	if (pids != NULL) {
+		if (!hash_alloc_insert(pids, plugin->identifier, plugin)) {
+			return CP_ERR_RESOURCE;
+		}
+		for (i = 0; i < plugin->num_ext_points; i++) {
+			if (!hash_alloc_insert(epids, plugin->ext_points[i].identifier, plugin)) {
+				return CP_ERR_RESOURCE;
 			}
 		}
+	}
+	return CP_OK;
+}
 
-		// Construct a path to plug-in runtime library.
-		ppath_len = strlen(plugin->plugin->plugin_path);
-		lname_len = strlen(plugin->plugin->runtime_lib_name);
-		rlpath_len = ppath_len + lname_len + strlen(CP_SHREXT) + 2;
-		if ((rlpath = malloc(rlpath_len * sizeof(char))) == NULL) {
-			cpi_errorf(context, N_("Plug-in %s runtime library could not be loaded due to insufficient memory."), plugin->plugin->identifier);
+CP_HIDDEN cp_status_t cpi_install_plugin(cp_context_t *context, cp_plugin_info_t *plugin, cp_plugin_loader_t *loader) {
+	cp_plugin_t *rp;
+	cp_status_t status;
+	cpi_plugin_event_t event;
+
+	assert(cpi_is_context_locked(context));
+	if ((status = check_conflicts(context, plugin, NULL, NULL)) != CP_OK
+		|| (status = register_plugin(context, plugin, loader, &rp)) != CP_OK) {
+		return status;
+	}
+		
+	// Publish the changed extension registry to snapshot readers
+	cpi_invalidate_ext_snapshot(context);
+	cpi_release_template_image(context->env);
+	invalidate_resolve_order(context->env);
+	cpi_record_plugin_changes(context, plugin);
+	
+	// Plug-in installed 
+	event.plugin_id = plugin->identifier;
+	event.old_state = CP_PLUGIN_UNINSTALLED;
+	event.new_state = rp->state;
+	cpi_deliver_event(context, &event);
+
+	return CP_OK;
+}
+
+CP_HIDDEN cp_status_t cpi_install_plugins(cp_context_t *context, cp_plugin_info_t * const *plugins, cp_plugin_loader_t * const *loaders, int num, int flags, cp_status_t *statuses) {
+	cp_status_t *st = statuses;
+	cp_plugin_t **installed = NULL;
+	cpi_plugin_event_t *events = NULL;
+	hash_t *pids = NULL;
+	hash_t *epids = NULL;
+	cp_status_t status = CP_OK;
+	int num_installed = 0;
+	int aborted = 0;
+	int i;
+
+	assert(cpi_is_context_locked(context));
+	assert(plugins != NULL || num == 0);
+	if (num <= 0) {
+		return CP_OK;
+	}
+	do {
+		unsigned int num_accepted = 0, num_ext_points = 0, num_extensions = 0;
+		
+		// Allocate resources
+		if ((st == NULL && (st = malloc(num * sizeof(cp_status_t))) == NULL)
+			|| (installed = malloc(num * sizeof(cp_plugin_t *))) == NULL
+			|| (events = malloc(num * sizeof(cpi_plugin_event_t))) == NULL
+			|| (pids = hash_create(HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL
+			|| (epids = hash_create(HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL) {
 			status = CP_ERR_RESOURCE;
+			aborted = 1;
 			break;
 		}
-		memset(rlpath, 0, rlpath_len * sizeof(char));
-		strcpy(rlpath, plugin->plugin->plugin_path);
-		rlpath[ppath_len] = CP_FNAMESEP_CHAR;
-		strcpy(rlpath + ppath_len + 1, plugin->plugin->runtime_lib_name);
-		strcpy(rlpath + ppath_len + 1 + lname_len, CP_SHREXT);
 		
-		// Open the plug-in runtime library 
-		plugin->runtime_lib = DLOPEN(rlpath);
-		if (plugin->runtime_lib == NULL) {
-			const char *error = DLERROR();
-			if (error == NULL) {
-				error = _("Unspecified error.");
+		// Check all the conflicts up front
+		for (i = 0; i < num && !aborted; i++) {
+			if ((st[i] = check_conflicts(context, plugins[i], pids, epids)) == CP_OK) {
+				num_accepted++;
+				num_ext_points += plugins[i]->num_ext_points;
+				num_extensions += plugins[i]->num_extensions;
+			} else if (st[i] == CP_ERR_RESOURCE) {
+				status = CP_ERR_RESOURCE;
+				aborted = 1;
+			} else if (status == CP_OK) {
+				status = st[i];
+			}
+		}
+		if (aborted) {
+			break;
+		}
+		if (status != CP_OK && (flags & CP_IP_ALL_OR_NONE)) {
+			for (i = 0; i < num; i++) {
+				st[i] = status;
 			}
-			cpi_errorf(context, N_("Plug-in %s runtime library %s could not be opened: %s"), plugin->plugin->identifier, rlpath, error);
-			status = CP_ERR_RUNTIME;
 			break;
 		}
 		
-		// Resolve plug-in functions
-		if (plugin->plugin->runtime_funcs_symbol != NULL) {
-			plugin->runtime_funcs = (cp_plugin_runtime_t *) DLSYM(plugin->runtime_lib, plugin->plugin->runtime_funcs_symbol);
-			if (plugin->runtime_funcs == NULL) {
-				const char *error = DLERROR();
-				if (error == NULL) {
-					error = _("Unspecified error.");
+		// Make room for the new plug-ins, extension points and extensions
+		hash_reserve(context->env->plugins, num_accepted);
+		hash_reserve(context->env->ext_points, num_ext_points);
+		hash_reserve(context->env->extensions, num_extensions);
+		cpi_reserve_strings(context->env->strings, num_accepted + num_ext_points + num_extensions);
+		
+		// Register the accepted plug-ins
+		for (i = 0; i < num; i++) {
+			if (st[i] != CP_OK) {
+				continue;
+			}
+			if ((st[i] = register_plugin(context, plugins[i], (loaders != NULL ? loaders[i] : NULL), installed + num_installed)) == CP_OK) {
+				num_installed++;
+			} else {
+				if (status == CP_OK) {
+					status = st[i];
+				}
+				if (flags & CP_IP_ALL_OR_NONE) {
+					break;
 				}
-				cpi_errorf(context, N_("Plug-in %s symbol %s containing plug-in runtime information could not be resolved: %s"), plugin->plugin->identifier, plugin->plugin->runtime_funcs_symbol, error);
-				status = CP_ERR_RUNTIME;
-				break;
 			}
-			if (plugin->runtime_funcs->create == NULL
-				|| plugin->runtime_funcs->destroy == NULL) {
-				cpi_errorf(context, N_("Plug-in %s is missing a constructor or destructor function."), plugin->plugin->identifier);
-				status = CP_ERR_RUNTIME;
-				break;
+		}
+		
+		// Roll back a partially completed installation if all or none
+		if (status != CP_OK && (flags & CP_IP_ALL_OR_NONE)) {
+			while (num_installed > 0) {
+				cp_plugin_t *rp = installed[--num_installed];
+				cp_plugin_info_t *plugin = rp->plugin;
+				
+				discard_plugin(context, rp);
+				cpi_release_info(context, plugin);
+			}
+			for (i = 0; i < num; i++) {
+				st[i] = status;
 			}
+			break;
 		}
-
+		
+		// Publish the changes and deliver the events as a single batch
+		if (num_installed > 0) {
+			cpi_invalidate_ext_snapshot(context);
+			cpi_release_template_image(context->env);
+			invalidate_resolve_order(context->env);
+			for (i = 0; i < num_installed; i++) {
+				cpi_record_plugin_changes(context, installed[i]->plugin);
+			}
+			for (i = 0; i < num_installed; i++) {
+				events[i].plugin_id = installed[i]->plugin->identifier;
+				events[i].old_state = CP_PLUGIN_UNINSTALLED;
+				events[i].new_state = installed[i]->state;
+			}
+			cpi_deliver_events(context, events, num_installed);
+		}
+		
 	} while (0);
-	
-	// Release resources 
-	free(rlpath);
-	if (status != CP_OK) {
-		unresolve_plugin_runtime(plugin);
-	}
-	
-	return status;
-}
 
-/**
- * Resolves the specified plug-in import into a plug-in pointer. Does not
- * try to resolve the imported plug-in.
- * 
- * @param context the plug-in context
- * @param plugin the plug-in being resolved
- * @param import the plug-in import to resolve
- * @param ipptr filled with pointer to the resolved plug-in or NULL
- * @return CP_OK on success or error code on failure
- */
-static int resolve_plugin_import(cp_context_t *context, cp_plugin_t *plugin, cp_plugin_import_t *import, cp_plugin_t **ipptr) {
-	cp_plugin_t *ip = NULL;
-	hnode_t *node;
+	// Report insufficient resources
+	if (aborted) {
+		cpi_error(context, N_("Plug-ins could not be installed due to insufficient system resources."));
+		if (st != NULL) {
+			for (i = 0; i < num; i++) {
+				st[i] = CP_ERR_RESOURCE;
+			}
+		}
+	}
 
-	// Lookup the plug-in 
-	node = hash_lookup(context->env->plugins, import->plugin_id);
-	if (node != NULL) {
-		ip = hnode_get(node);
+	// Release resources
+	if (pids != NULL) {
+		hash_free_nodes(pids);
+		hash_destroy(pids);
 	}
-			
-	// Check plug-in version
-	if (ip != NULL
-		&& import->version != NULL
-		&& (ip->plugin->version == NULL
-			|| (ip->plugin->abi_bw_compatibility == NULL
-				&& cpi_vercmp(import->version, ip->plugin->version) != 0)
-			|| (ip->plugin->abi_bw_compatibility != NULL
-				&& (cpi_vercmp(import->version, ip->plugin->version) > 0
-					|| cpi_vercmp(import->version, ip->plugin->abi_bw_compatibility) < 0)))) {
-		cpi_errorf(context,
-			N_("Plug-in %s could not be resolved due to version incompatibility with plug-in %s."),
-			plugin->plugin->identifier,
-			import->plugin_id);
-		*ipptr = NULL;
-		return CP_ERR_DEPENDENCY;
+	if (epids != NULL) {
+		hash_free_nodes(epids);
+		hash_destroy(epids);
 	}
-	
-	// Check if missing mandatory plug-in
-	if (ip == NULL && !import->optional) {
-		cpi_errorf(context,
-			N_("Plug-in %s could not be resolved because it depends on plug-in %s which is not installed."),
-			plugin->plugin->identifier,
-			import->plugin_id);
-		*ipptr = NULL;
-		return CP_ERR_DEPENDENCY;
+	free(events);
+	free(installed);
+	if (st != statuses) {
+		free(st);
 	}
 
-	// Return imported plug-in
-	*ipptr = ip;
-	return CP_OK;
+	return status;
 }
 
-/**
- * Resolves the specified plug-in and its dependencies while leaving plug-ins
- * with circular dependencies in a preliminarily resolved state.
- * 
- * @param context the plug-in context
- * @param plugin the plug-in
- * @return CP_OK (zero) or CP_OK_PRELIMINARY or an error code
- */
-static int resolve_plugin_prel_rec(cp_context_t *context, cp_plugin_t *plugin) {
-	cp_status_t status = CP_OK;
-	int error_reported = 0;
-	lnode_t *node = NULL;
-	int i;
+CP_C_API cp_status_t cp_install_plugin(cp_context_t *context, cp_plugin_info_t *plugin) {
+	cp_status_t status;
 
-	// Check if already resolved
-	if (plugin->state >= CP_PLUGIN_RESOLVED) {
-		return CP_OK;
-	}
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(plugin);
 	
-	// Check for dependency loops
-	if (plugin->processed) {
-		return CP_OK_PRELIMINARY;
-	}
-	plugin->processed = 1;
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	status = cpi_install_plugin(context, plugin, NULL);
+	cpi_unlock_context(context);
 
-	do {
+	return status;
+}
 
-		// Recursively resolve the imported plug-ins
-		assert(plugin->imported == NULL);
-		if ((plugin->imported = list_create(LISTCOUNT_T_MAX)) == NULL) {
-			status = CP_ERR_RESOURCE;
-			break;
-		}
-		for (i = 0; i < plugin->plugin->num_imports; i++) {
-			cp_plugin_t *ip;
-			int s;
-				
-			if ((node = lnode_create(NULL)) == NULL) {
-				status = CP_ERR_RESOURCE;
-				break;
-			}
-			if ((s = resolve_plugin_import(context, plugin, plugin->plugin->imports + i, &ip)) != CP_OK) {
-				error_reported = 1;
-				status = s;
-				break;
-			}
-			if (ip != NULL) {
-				lnode_put(node, ip);
-				list_append(plugin->imported, node);
-				node = NULL;
-				if (!cpi_ptrset_add(ip->importing, plugin)) {
-					status = CP_ERR_RESOURCE;
-					break;
-				} else if ((s = resolve_plugin_prel_rec(context, ip)) != CP_OK && s != CP_OK_PRELIMINARY) {
-					cpi_errorf(context, N_("Plug-in %s could not be resolved because it depends on plug-in %s which could not be resolved."), plugin->plugin->identifier, ip->plugin->identifier);
-					error_reported = 1;
-					status = s;
-					break;
-				}
-			} else {
-				lnode_destroy(node);
-				node = NULL;
-			}
-		}
-		if (status != CP_OK) {
+CP_C_API cp_status_t cp_install_builtin_plugin(cp_context_t *context, const char *buffer, unsigned int buffer_len, cp_plugin_runtime_t *runtime, const cp_builtin_symbol_t *symbols) {
+	cp_plugin_info_t *plugin;
+	cp_status_t status;
+
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(buffer);
+	
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	do {
+		hnode_t *hnode;
+		cp_plugin_t *rp;
+		
+		if (runtime != NULL && (runtime->create == NULL || runtime->destroy == NULL)) {
+			cpi_error(context, N_("A built-in plug-in is missing a constructor or destructor function."));
+			status = CP_ERR_RUNTIME;
 			break;
 		}
-		
-		// Resolve this plug-in
-		assert(plugin->state == CP_PLUGIN_INSTALLED);
-		if ((i = resolve_plugin_runtime(context, plugin)) != CP_OK) {
-			status = i;
-			error_reported = 1;
+		if ((plugin = cpi_parse_plugin_descriptor_buffer(context, "builtin", buffer, buffer_len, NULL, &status)) == NULL) {
 			break;
 		}
-		
-		// Notify event listeners and update state if completely resolved
+		cpi_register_plugin_descriptor(context, plugin);
+		status = cpi_install_plugin(context, plugin, NULL);
 		if (status == CP_OK) {
-			cpi_plugin_event_t event;
-			
-			plugin->processed = 0;
-			event.plugin_id = plugin->plugin->identifier;
-			event.old_state = plugin->state;
-			event.new_state = plugin->state = CP_PLUGIN_RESOLVED;
-			cpi_deliver_event(context, &event);
+			hnode = hash_lookup(context->env->plugins, plugin->identifier);
+			assert(hnode != NULL);
+			rp = hnode_get(hnode);
+			rp->builtin = 1;
+			rp->builtin_runtime = runtime;
+			rp->builtin_symbols = symbols;
 		}
-
+		cpi_release_info(context, plugin);
 	} while (0);
+	cpi_unlock_context(context);
 
-	// Clean up
-	if (node != NULL) {
-		lnode_destroy(node);
-	}
+	return status;
+}
 
-	// Handle errors
-	if (status == CP_ERR_RESOURCE && !error_reported) {
-		cpi_errorf(context, N_("Plug-in %s could not be resolved because of insufficient memory."), plugin->plugin->identifier);
+CP_C_API cp_status_t cp_install_plugins(cp_context_t *context, cp_plugin_info_t * const *plugins, int num, int flags) {
+	cp_status_t status;
+
+	CHECK_NOT_NULL(context);
+	if (num > 0) {
+		CHECK_NOT_NULL(plugins);
 	}
 	
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	status = cpi_install_plugins(context, plugins, NULL, num, flags, NULL);
+	cpi_unlock_context(context);
+
 	return status;
 }
 
 /**
- * Recursively commits the resolving process for the specified plug-in and
- * its dependencies.
+ * Calls the start function of the specified plug-in and adds the time
+ * spent to the specified counter.
  * 
- * @param context the plug-in context
  * @param plugin the plug-in
+ * @param usecs the counter of microseconds to be incremented
+ * @return the value returned by the start function
  */
-static void resolve_plugin_commit_rec(cp_context_t *context, cp_plugin_t *plugin) {
+static int call_start_func(cp_plugin_t *plugin, unsigned long long *usecs) {
+	unsigned long long started = cpi_monotonic_usecs();
+	int s;
 	
-	// Check if already committed
-	if (!plugin->processed) {
-		return;
-	}
-	plugin->processed = 0;
+	s = plugin->runtime_funcs->start(plugin->plugin_data);
+	*usecs += cpi_monotonic_usecs() - started;
+	return s;
+}
+
+/**
+ * Calls the stop function of the specified plug-in and adds the time
+ * spent to the specified counter.
+ * 
+ * @param plugin the plug-in
+ * @param usecs the counter of microseconds to be incremented
+ */
+static void call_stop_func(cp_plugin_t *plugin, unsigned long long *usecs) {
+	unsigned long long started = cpi_monotonic_usecs();
 	
-	// Commit if only preliminarily resolved
-	if (plugin->state < CP_PLUGIN_RESOLVED) {
-			cpi_plugin_event_t event;
-			lnode_t *node;
+	plugin->runtime_funcs->stop(plugin->plugin_data);
+	*usecs += cpi_monotonic_usecs() - started;
+}
 
-			// Recursively commit dependencies
-			node = list_first(plugin->imported);
-			while (node != NULL) {
-				resolve_plugin_commit_rec(context, (cp_plugin_t *) lnode_get(node));
-				node = list_next(plugin->imported, node);
+/**
+ * Calls the destroy function of the specified plug-in and records the
+ * time spent in the plug-in statistics.
+ * 
+ * @param plugin the plug-in
+ */
+static void call_destroy_func(cp_plugin_t *plugin) {
+	unsigned long long started = cpi_monotonic_usecs();
+	
+	plugin->runtime_funcs->destroy(plugin->plugin_data);
+	plugin->stats.destroy_usecs += cpi_monotonic_usecs() - started;
+}
+
+/**
+ * Unresolves the plug-in runtime information.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in to unresolve
+ */
+static void unresolve_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
+
+	// Destroy the plug-in instance, if necessary
+	if (plugin->context != NULL) {
+		plugin->context->env->in_destroy_func_invocation++;
+		call_destroy_func(plugin);
+		plugin->context->env->in_destroy_func_invocation--;
+		plugin->plugin_data = NULL;
+		cpi_free_context(plugin->context);
+		plugin->context = NULL;
+	}
+
+	// Close plug-in runtime library unless kept until process exit
+	plugin->runtime_funcs = NULL;
+	if (plugin->runtime_lib != NULL) {
+		if (!context->env->keep_runtime_libs) {
+			DLCLOSE(plugin->runtime_lib);
+		}
+		plugin->runtime_lib = NULL;
+	}	
+}
+
+/**
+ * Checks that the plug-in runtime is compatible with this version of C-Pluff.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in
+ * @return CP_OK (zero) if compatible or CP_ERR_DEPENDENCY if not
+ */
+static int check_cpluff_compatibility(cp_context_t *context, cp_plugin_t *plugin) {
+	int cpluff_compatibility = 1;
+	
+	if (plugin->plugin->req_cpluff_version != NULL) {
+#ifdef CP_ABI_COMPATIBILITY
+		cpluff_compatibility = (
+			cpi_vercmp(plugin->plugin->req_cpluff_version, CP_VERSION) <= 0
+		 	&& cpi_vercmp(plugin->plugin->req_cpluff_version, CP_ABI_COMPATIBILITY) >= 0);
+#else
+		cpluff_compatibility = (cpi_vercmp(plugin->plugin->req_cpluff_version, CP_VERSION) == 0);
+#endif
+	}
+	if (!cpluff_compatibility) {
+		cpi_errorf(context, N_("Plug-in %s could not be resolved due to version incompatibility with C-Pluff."), plugin->plugin->identifier);
+		return CP_ERR_DEPENDENCY;
+	}
+	return CP_OK;
+}
+
+/**
+ * Checks that the plug-in runtime can be loaded, resolves the plug-in files
+ * and constructs a path to the plug-in runtime library.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plugin
+ * @param rlpathptr filled with the path to the runtime library, to be freed by the caller
+ * @return CP_OK (zero) on success or error code on failure
+ */
+static int prepare_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin, char **rlpathptr) {
+	char *rlpath = NULL;
+	int rlpath_len;
+	int ppath_len, lname_len;
+	cp_status_t status;
+
+	assert(plugin->plugin->runtime_lib_name != NULL);
+	if ((status = check_cpluff_compatibility(context, plugin)) != CP_OK) {
+		return status;
+	}
+	
+	// Resolve files if plug-in loader specified
+	if (plugin->loader != NULL && plugin->loader->resolve_files != NULL) {
+		if (!plugin->loader->resolve_files(plugin->loader->data, context, plugin->plugin)) {
+			cpi_errorf(context, N_("Plug-in %s files could not be resolved with plug-in loader %p."), plugin->plugin->identifier, (void *) plugin->loader);
+			return CP_ERR_IO;
+		}
+	}
+
+	// Construct a path to plug-in runtime library.
+	ppath_len = strlen(plugin->plugin->plugin_path);
+	lname_len = strlen(plugin->plugin->runtime_lib_name);
+	rlpath_len = ppath_len + lname_len + strlen(CP_SHREXT) + 2;
+	if ((rlpath = malloc(rlpath_len * sizeof(char))) == NULL) {
+		cpi_errorf(context, N_("Plug-in %s runtime library could not be loaded due to insufficient memory."), plugin->plugin->identifier);
+		return CP_ERR_RESOURCE;
+	}
+	memset(rlpath, 0, rlpath_len * sizeof(char));
+	strcpy(rlpath, plugin->plugin->plugin_path);
+	rlpath[ppath_len] = CP_FNAMESEP_CHAR;
+	strcpy(rlpath + ppath_len + 1, plugin->plugin->runtime_lib_name);
+	strcpy(rlpath + ppath_len + 1 + lname_len, CP_SHREXT);
+	*rlpathptr = rlpath;
+	return CP_OK;
+}
+
+/**
+ * Reports a failure to open the plug-in runtime library.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in
+ * @param rlpath the path to the runtime library
+ * @param error the error message, or NULL if unspecified
+ */
+static void report_runtime_open_error(cp_context_t *context, cp_plugin_t *plugin, const char *rlpath, const char *error) {
+	if (error == NULL) {
+		error = _("Unspecified error.");
+	}
+	cpi_errorf(context, N_("Plug-in %s runtime library %s could not be opened: %s"), plugin->plugin->identifier, rlpath, error);
+}
+
+/**
+ * Resolves the plug-in initialization functions from the opened runtime
+ * library, unless they have already been bound.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in
+ * @return CP_OK (zero) on success or error code on failure
+ */
+static int bind_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
+	if (plugin->plugin->runtime_funcs_symbol == NULL) {
+		return CP_OK;
+	}
+	if (plugin->runtime_funcs == NULL) {
+		plugin->runtime_funcs = (cp_plugin_runtime_t *) DLSYM(plugin->runtime_lib, plugin->plugin->runtime_funcs_symbol);
+	}
+	if (plugin->runtime_funcs == NULL) {
+		const char *error = DLERROR();
+		if (error == NULL) {
+			error = _("Unspecified error.");
+		}
+		cpi_errorf(context, N_("Plug-in %s symbol %s containing plug-in runtime information could not be resolved: %s"), plugin->plugin->identifier, plugin->plugin->runtime_funcs_symbol, error);
+		return CP_ERR_RUNTIME;
+	}
+	if (plugin->runtime_funcs->create == NULL
+		|| plugin->runtime_funcs->destroy == NULL) {
+		cpi_errorf(context, N_("Plug-in %s is missing a constructor or destructor function."), plugin->plugin->identifier);
+		return CP_ERR_RUNTIME;
+	}
+	return CP_OK;
+}
+
+/**
+ * Binds the runtime functions of a built-in plug-in unless already bound.
+ * 
+ * @param context the plug-in context
+ * @param plugin the built-in plug-in
+ * @return CP_OK (zero) on success or error code on failure
+ */
+static int bind_builtin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
+	cp_status_t status;
+	
+	assert(plugin->builtin);
+	if (plugin->runtime_funcs != NULL || plugin->builtin_runtime == NULL) {
+		return CP_OK;
+	}
+	if ((status = check_cpluff_compatibility(context, plugin)) != CP_OK) {
+		return status;
+	}
+	plugin->runtime_funcs = plugin->builtin_runtime;
+	return CP_OK;
+}
+
+/**
+ * Loads and resolves the plug-in runtime library and initialization
+ * functions unless already loaded.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plugin
+ * @return CP_OK (zero) on success or error code on failure
+ */
+static int load_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
+	char *rlpath = NULL;
+	unsigned long long started;
+	cp_status_t status;
+	
+	if (plugin->builtin) {
+		return bind_builtin_runtime(context, plugin);
+	}
+	if (plugin->runtime_lib != NULL || plugin->plugin->runtime_lib_name == NULL) {
+		return CP_OK;
+	}
+	
+	do {
+		if ((status = prepare_plugin_runtime(context, plugin, &rlpath)) != CP_OK) {
+			break;
+		}
+		
+		// Open the plug-in runtime library 
+		started = cpi_monotonic_usecs();
+		plugin->runtime_lib = DLOPEN(rlpath);
+		plugin->stats.load_usecs += cpi_monotonic_usecs() - started;
+		if (plugin->runtime_lib == NULL) {
+			report_runtime_open_error(context, plugin, rlpath, DLERROR());
+			status = CP_ERR_RUNTIME;
+			break;
+		}
+		
+		// Resolve plug-in functions
+		status = bind_plugin_runtime(context, plugin);
+
+	} while (0);
+	
+	// Release resources 
+	free(rlpath);
+	if (status != CP_OK) {
+		unresolve_plugin_runtime(context, plugin);
+	}
+	
+	return status;
+}
+
+/**
+ * Resolves the plug-in runtime. Loads the plug-in runtime library and
+ * initialization functions unless loading is deferred until the plug-in
+ * is started.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plugin
+ * @return CP_OK (zero) on success or error code on failure
+ */
+static int resolve_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
+	assert(plugin->runtime_lib == NULL);
+	if (plugin->plugin->runtime_lib_name == NULL && plugin->builtin_runtime == NULL) {
+		return CP_OK;
+	}
+	if (context->env->lazy_runtime) {
+		return check_cpluff_compatibility(context, plugin);
+	}
+	return load_plugin_runtime(context, plugin);
+}
+
+/**
+ * Compares the version required by an import to the specified version of
+ * the imported plug-in, using the tokenized versions if available.
+ * 
+ * @param plugin the importing plug-in
+ * @param i the index of the import
+ * @param ip the imported plug-in
+ * @param abi whether to compare to the backwards compatibility version
+ * @return less than, equal to or greater than zero when the required version is earlier, equal to or later than the version of the imported plug-in
+ */
+static int import_vercmp(const cp_plugin_info_t *plugin, int i, const cp_plugin_info_t *ip, int abi) {
+	const plugin_info_block_t *b1 = (const plugin_info_block_t *) ((const char *) plugin - offsetof(plugin_info_block_t, info));
+	const plugin_info_block_t *b2 = (const plugin_info_block_t *) ((const char *) ip - offsetof(plugin_info_block_t, info));
+	
+	if (b1->versions_tokenized && b2->versions_tokenized) {
+		return cpi_vercmp_tokens(b1->import_versions[i], (abi ? b2->abi_bw_compatibility : b2->version));
+	}
+	return cpi_vercmp(plugin->imports[i].version, (abi ? ip->abi_bw_compatibility : ip->version));
+}
+
+/**
+ * Resolves the specified plug-in import into a plug-in pointer. Does not
+ * try to resolve the imported plug-in.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in being resolved
+ * @param import the plug-in import to resolve
+ * @param ipptr filled with pointer to the resolved plug-in or NULL
+ * @return CP_OK on success or error code on failure
+ */
+static int resolve_plugin_import(cp_context_t *context, cp_plugin_t *plugin, cp_plugin_import_t *import, cp_plugin_t **ipptr) {
+	cp_plugin_t *ip = NULL;
+	hnode_t *node;
+	int i;
+
+	// Lookup the plug-in 
+	node = hash_lookup(context->env->plugins, import->plugin_id);
+	if (node != NULL) {
+		ip = hnode_get(node);
+	}
+			
+	// Check plug-in version
+	i = import - plugin->plugin->imports;
+	if (ip != NULL
+		&& import->version != NULL
+		&& (ip->plugin->version == NULL
+			|| (ip->plugin->abi_bw_compatibility == NULL
+				&& import_vercmp(plugin->plugin, i, ip->plugin, 0) != 0)
+			|| (ip->plugin->abi_bw_compatibility != NULL
+				&& (import_vercmp(plugin->plugin, i, ip->plugin, 0) > 0
+					|| import_vercmp(plugin->plugin, i, ip->plugin, 1) < 0)))) {
+		cpi_errorf(context,
+			N_("Plug-in %s could not be resolved due to version incompatibility with plug-in %s."),
+			plugin->plugin->identifier,
+			import->plugin_id);
+		*ipptr = NULL;
+		return CP_ERR_DEPENDENCY;
+	}
+	
+	// Check if missing mandatory plug-in
+	if (ip == NULL && !import->optional) {
+		cpi_errorf(context,
+			N_("Plug-in %s could not be resolved because it depends on plug-in %s which is not installed."),
+			plugin->plugin->identifier,
+			import->plugin_id);
+		*ipptr = NULL;
+		return CP_ERR_DEPENDENCY;
+	}
+
+	// Return imported plug-in
+	*ipptr = ip;
+	return CP_OK;
+}
+
+/**
+ * Resolves the specified plug-in and its dependencies while leaving plug-ins
+ * with circular dependencies in a preliminarily resolved state.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in
+ * @return CP_OK (zero) or CP_OK_PRELIMINARY or an error code
+ */
+static int resolve_plugin_prel_rec(cp_context_t *context, cp_plugin_t *plugin) {
+	cp_status_t status = CP_OK;
+	int error_reported = 0;
+	lnode_t *node = NULL;
+	int i;
+
+	// Check if already resolved
+	if (plugin->state >= CP_PLUGIN_RESOLVED) {
+		return CP_OK;
+	}
+	
+	// Check for dependency loops
+	if (plugin->processed) {
+		return CP_OK_PRELIMINARY;
+	}
+	plugin->processed = 1;
+
+	do {
+
+		// Recursively resolve the imported plug-ins
+		assert(plugin->imported == NULL);
+		if ((plugin->imported = cpi_create_ptrset()) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		for (i = 0; i < plugin->plugin->num_imports; i++) {
+			cp_plugin_t *ip;
+			int s;
+				
+			if ((node = cpi_create_lnode(context->env->nodes, NULL)) == NULL) {
+				status = CP_ERR_RESOURCE;
+				break;
+			}
+			if ((s = resolve_plugin_import(context, plugin, plugin->plugin->imports + i, &ip)) != CP_OK) {
+				error_reported = 1;
+				status = s;
+				break;
+			}
+			if (ip != NULL) {
+				lnode_put(node, ip);
+				if (cpi_ptrset_contains(plugin->imported, ip)) {
+					cpi_destroy_lnode(context->env->nodes, node);
+				} else {
+					cpi_ptrset_append_node(context->env->nodes, plugin->imported, node);
+				}
+				node = NULL;
+				if (!cpi_ptrset_add(context->env->nodes, ip->importing, plugin)) {
+					status = CP_ERR_RESOURCE;
+					break;
+				} else if ((s = resolve_plugin_prel_rec(context, ip)) != CP_OK && s != CP_OK_PRELIMINARY) {
+					cpi_errorf(context, N_("Plug-in %s could not be resolved because it depends on plug-in %s which could not be resolved."), plugin->plugin->identifier, ip->plugin->identifier);
+					error_reported = 1;
+					status = s;
+					break;
+				}
+			} else {
+				cpi_destroy_lnode(context->env->nodes, node);
+				node = NULL;
+			}
+		}
+		if (status != CP_OK) {
+			break;
+		}
+		
+		// Resolve this plug-in
+		assert(plugin->state == CP_PLUGIN_INSTALLED);
+		if ((i = resolve_plugin_runtime(context, plugin)) != CP_OK) {
+			status = i;
+			error_reported = 1;
+			break;
+		}
+		
+		// Notify event listeners and update state if completely resolved
+		if (status == CP_OK) {
+			cpi_plugin_event_t event;
+			
+			plugin->processed = 0;
+			event.plugin_id = plugin->plugin->identifier;
+			event.old_state = plugin->state;
+			event.new_state = plugin->state = CP_PLUGIN_RESOLVED;
+			cpi_deliver_event(context, &event);
+		}
+
+	} while (0);
+
+	// Clean up
+	if (node != NULL) {
+		cpi_destroy_lnode(context->env->nodes, node);
+	}
+
+	// Handle errors
+	if (status == CP_ERR_RESOURCE && !error_reported) {
+		cpi_errorf(context, N_("Plug-in %s could not be resolved because of insufficient memory."), plugin->plugin->identifier);
+	}
+	
+	return status;
+}
+
+/**
+ * Recursively commits the resolving process for the specified plug-in and
+ * its dependencies.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in
+ */
+static void resolve_plugin_commit_rec(cp_context_t *context, cp_plugin_t *plugin) {
+	
+	// Check if already committed
+	if (!plugin->processed) {
+		return;
+	}
+	plugin->processed = 0;
+	
+	// Commit if only preliminarily resolved
+	if (plugin->state < CP_PLUGIN_RESOLVED) {
+			cpi_plugin_event_t event;
+			lnode_t *node;
+
+			// Recursively commit dependencies
+			node = list_first(&plugin->imported->list);
+			while (node != NULL) {
+				resolve_plugin_commit_rec(context, (cp_plugin_t *) lnode_get(node));
+				node = list_next(&plugin->imported->list, node);
+			}
+			
+			// Notify event listeners and update state
+			event.plugin_id = plugin->plugin->identifier;
+			event.old_state = plugin->state;
+			event.new_state = plugin->state = CP_PLUGIN_RESOLVED;
+			cpi_deliver_event(context, &event);		
+	}
+}
+
+/**
+ * Recursively cleans up the specified plug-in and its dependencies after
+ * a failed resolving attempt.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in
+ */
+static void resolve_plugin_failed_rec(cp_context_t *context, cp_plugin_t *plugin) {
+	
+	// Check if already cleaned up
+	if (!plugin->processed) {
+		return;
+	}
+	plugin->processed = 0;
+	
+	// Clean up if only preliminarily resolved
+	if (plugin->state < CP_PLUGIN_RESOLVED) {
+		lnode_t *node;
+
+		// Recursively clean up depedencies
+		while ((node = list_first(&plugin->imported->list)) != NULL) {
+			cp_plugin_t *ip = lnode_get(node);
+			
+			resolve_plugin_failed_rec(context, ip);
+			cpi_ptrset_remove(context->env->nodes, ip->importing, plugin);
+			cpi_ptrset_delete_node(plugin->imported, node);
+			cpi_destroy_lnode(context->env->nodes, node);
+		}
+		cpi_destroy_ptrset(plugin->imported);
+		plugin->imported = NULL;
+	}
+}
+
+/**
+ * Resolves the specified plug-in and its dependencies.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in to be resolved
+ * @return CP_OK (zero) on success or an error code on failure
+ */
+static int resolve_plugin(cp_context_t *context, cp_plugin_t *plugin) {
+	cp_status_t status;
+	
+	if ((status = resolve_plugin_prel_rec(context, plugin)) == CP_OK || status == CP_OK_PRELIMINARY) {
+		status = CP_OK;
+		resolve_plugin_commit_rec(context, plugin);
+	} else {
+		resolve_plugin_failed_rec(context, plugin);
+	}
+	assert_processed_zero(context);
+	return status;
+}
+
+/**
+ * Returns the node of the specified plug-in when resolving all plug-ins.
+ * 
+ * @param batch the resolving of all plug-ins
+ * @param plugin the plug-in
+ * @return the node
+ */
+static resolve_node_t *get_resolve_node(resolve_batch_t *batch, cp_plugin_t *plugin) {
+	hnode_t *hnode = hash_lookup(batch->node_map, plugin);
+	
+	assert(hnode != NULL);
+	return hnode_get(hnode);
+}
+
+/**
+ * Reports a static dependency loop formed by the plug-ins of a strongly
+ * connected component.
+ * 
+ * @param context the plug-in context
+ * @param members the plug-ins of the component
+ * @param num_members the number of plug-ins
+ */
+static void report_component_loop(cp_context_t *context, resolve_node_t **members, int num_members) {
+	char *msg;
+	size_t msgsize = 1;
+	int i;
+	
+	for (i = 0; i < num_members; i++) {
+		msgsize += strlen(members[i]->plugin->plugin->identifier) + 2;
+	}
+	if ((msg = malloc(msgsize * sizeof(char))) != NULL) {
+		msg[0] = '\0';
+		for (i = 0; i < num_members; i++) {
+			strcat(msg, members[i]->plugin->plugin->identifier);
+			strcat(msg, (i < num_members - 1 ? ", " : "."));
+		}
+		cpi_infof(context, N_("Detected a static plug-in dependency loop: %s"), msg);
+		free(msg);
+	} else {
+		cpi_infof(context, N_("Detected a static plug-in dependency loop: %s"), members[0]->plugin->plugin->identifier);
+	}
+}
+
+/**
+ * Returns whether the plug-ins of a strongly connected component form a
+ * static dependency loop.
+ * 
+ * @param members the plug-ins of the component
+ * @param num_members the number of plug-ins
+ * @return whether the component is a dependency loop
+ */
+static int is_component_loop(resolve_node_t **members, int num_members) {
+	int j;
+	
+	if (num_members > 1) {
+		return 1;
+	}
+	for (j = 0; j < members[0]->num_imports; j++) {
+		if (members[0]->imports[j] == members[0]->plugin) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Completes resolving the plug-ins of a strongly connected component whose
+ * imports have been linked and runtimes resolved. If any of the plug-ins
+ * failed then the whole component is rolled back.
+ * 
+ * @param batch the resolving of all plug-ins
+ * @param members the plug-ins of the component
+ * @param num_members the number of plug-ins
+ * @param failed the plug-in which failed, or NULL on success
+ */
+static void complete_component(resolve_batch_t *batch, resolve_node_t **members, int num_members, resolve_node_t *failed) {
+	cp_context_t *context = batch->context;
+	int i;
+	
+	// Roll back on failure
+	if (failed != NULL) {
+		cp_status_t status = failed->status;
+		
+		for (i = 0; i < num_members; i++) {
+			cp_plugin_t *plugin = members[i]->plugin;
+			lnode_t *node;
+			
+			if (plugin->imported != NULL) {
+				while ((node = list_first(&plugin->imported->list)) != NULL) {
+					cp_plugin_t *ip = lnode_get(node);
+					
+					cpi_ptrset_remove(context->env->nodes, ip->importing, plugin);
+					cpi_ptrset_delete_node(plugin->imported, node);
+					cpi_destroy_lnode(context->env->nodes, node);
+				}
+				cpi_destroy_ptrset(plugin->imported);
+				plugin->imported = NULL;
+			}
+			unresolve_plugin_runtime(context, plugin);
+			if (members[i] != failed) {
+				cpi_errorf(context, N_("Plug-in %s could not be resolved because it depends on plug-in %s which could not be resolved."), plugin->plugin->identifier, failed->plugin->plugin->identifier);
+			}
+			members[i]->status = status;
+		}
+		if (batch->status == CP_OK) {
+			batch->status = status;
+		}
+		return;
+	}
+	
+	// Plug-ins resolved
+	for (i = 0; i < num_members; i++) {
+		cp_plugin_t *plugin = members[i]->plugin;
+		cpi_plugin_event_t *event = batch->events + batch->num_events++;
+		
+		event->plugin_id = plugin->plugin->identifier;
+		event->old_state = plugin->state;
+		event->new_state = plugin->state = CP_PLUGIN_RESOLVED;
+		batch->order[batch->num_order++] = plugin;
+	}
+	if (is_component_loop(members, num_members)) {
+		report_component_loop(context, members, num_members);
+	}
+}
+
+/**
+ * Resolves the plug-ins of a strongly connected component, all of whose
+ * imported plug-ins outside the component have already been processed.
+ * The plug-ins of a component depend on each other, so either all or none
+ * of them are resolved. If the runtime libraries are preloaded then the
+ * component is only checked and linked here and it is completed once the
+ * runtime libraries have been opened.
+ * 
+ * @param batch the resolving of all plug-ins
+ * @param members the plug-ins of the component
+ * @param num_members the number of plug-ins
+ */
+static void resolve_component(resolve_batch_t *batch, resolve_node_t **members, int num_members) {
+	cp_context_t *context = batch->context;
+	resolve_node_t *failed = NULL;
+	cp_status_t status = CP_OK;
+	int i, j;
+	
+	for (i = 0; i < num_members; i++) {
+		members[i]->component = batch->num_components;
+		members[i]->on_stack = 0;
+	}
+	batch->num_components++;
+	
+	// Plug-ins resolved earlier only need to be ordered
+	if (members[0]->plugin->state >= CP_PLUGIN_RESOLVED) {
+		for (i = 0; i < num_members; i++) {
+			assert(members[i]->plugin->state >= CP_PLUGIN_RESOLVED);
+			batch->order[batch->num_order++] = members[i]->plugin;
+		}
+		if (is_component_loop(members, num_members)) {
+			report_component_loop(context, members, num_members);
+		}
+		return;
+	}
+	
+	// Check the imports and the plug-ins imported from other components
+	for (i = 0; i < num_members && status == CP_OK; i++) {
+		resolve_node_t *node = members[i];
+		
+		if (node->status != CP_OK) {
+			status = node->status;
+			failed = node;
+			break;
+		}
+		for (j = 0; j < node->num_imports; j++) {
+			cp_plugin_t *ip = node->imports[j];
+			resolve_node_t *in;
+			
+			if (ip == NULL) {
+				continue;
+			}
+			in = get_resolve_node(batch, ip);
+			if (in->component != node->component && in->status != CP_OK) {
+				cpi_errorf(context, N_("Plug-in %s could not be resolved because it depends on plug-in %s which could not be resolved."), node->plugin->plugin->identifier, ip->plugin->identifier);
+				status = node->status = in->status;
+				failed = node;
+				break;
+			}
+		}
+	}
+	
+	// Link the imported plug-ins and resolve the plug-in runtimes
+	for (i = 0; i < num_members && status == CP_OK; i++) {
+		cp_plugin_t *plugin = members[i]->plugin;
+		
+		assert(plugin->state == CP_PLUGIN_INSTALLED && plugin->imported == NULL);
+		if ((plugin->imported = cpi_create_ptrset()) == NULL) {
+			status = CP_ERR_RESOURCE;
+		}
+		for (j = 0; j < members[i]->num_imports && status == CP_OK; j++) {
+			cp_plugin_t *ip = members[i]->imports[j];
+			
+			if (ip == NULL) {
+				continue;
+			}
+			if (!cpi_ptrset_add(context->env->nodes, plugin->imported, ip)
+				|| !cpi_ptrset_add(context->env->nodes, ip->importing, plugin)) {
+				status = CP_ERR_RESOURCE;
+			}
+		}
+		if (status == CP_ERR_RESOURCE) {
+			cpi_errorf(context, N_("Plug-in %s could not be resolved because of insufficient memory."), plugin->plugin->identifier);
+		} else if (!batch->preload) {
+			status = resolve_plugin_runtime(context, plugin);
+		}
+		if (status != CP_OK) {
+			members[i]->status = status;
+			failed = members[i];
+		}
+	}
+	
+	// Defer the runtimes until the runtime libraries have been preloaded
+	if (status == CP_OK && batch->preload) {
+		for (i = 0; i < num_members; i++) {
+			batch->deferred[batch->num_deferred++] = members[i];
+		}
+		return;
+	}
+	
+	complete_component(batch, members, num_members, failed);
+}
+
+/**
+ * Opens a preloaded runtime library and optionally binds the runtime
+ * functions. The context lock is not required because the node is only
+ * accessed by the thread preloading it.
+ * 
+ * @param node the plug-in whose runtime library is to be opened
+ * @param prebind whether to bind the symbols when opening the library
+ */
+static void open_preloaded_runtime(resolve_node_t *node, int prebind) {
+	unsigned long long started = cpi_monotonic_usecs();
+	
+	node->lib = (prebind ? DLOPEN_NOW(node->rlpath) : DLOPEN(node->rlpath));
+	if (node->lib == NULL) {
+		const char *error = DLERROR();
+		
+		if (error != NULL) {
+			node->load_error = strdup(error);
+		}
+	} else if (prebind && node->plugin->plugin->runtime_funcs_symbol != NULL) {
+		node->funcs = (cp_plugin_runtime_t *) DLSYM(node->lib, node->plugin->plugin->runtime_funcs_symbol);
+	}
+	node->load_usecs = cpi_monotonic_usecs() - started;
+}
+
+/**
+ * Launches all the preloads whose imported runtime libraries have been
+ * opened. The preloads are queued for the worker threads or, if there are
+ * none, executed by the calling thread.
+ * 
+ * @param batch the resolving of all plug-ins
+ */
+static void launch_preloads(resolve_batch_t *batch) {
+	cp_context_t *context = batch->context;
+	int queued = 0;
+	int launched;
+	
+	do {
+		int i;
+		
+		launched = 0;
+		for (i = 0; i < batch->num_deferred; i++) {
+			resolve_node_t *node = batch->deferred[i];
+			int j, ready = 1, failed = 0;
+			
+			// Check if the imported runtime libraries have been opened
+			if (node->load_state != PRELOAD_PENDING) {
+				continue;
+			}
+			for (j = 0; j < node->num_imports && ready; j++) {
+				resolve_node_t *in;
+				
+				if (node->imports[j] == NULL) {
+					continue;
+				}
+				in = get_resolve_node(batch, node->imports[j]);
+				if (in->component == node->component) {
+					continue;
+				}
+				if (in->load_state == PRELOAD_FAILED) {
+					failed = 1;
+				} else if (in->load_state != PRELOAD_NONE && in->load_state != PRELOAD_DONE) {
+					ready = 0;
+				}
+			}
+			if (!ready) {
+				continue;
+			}
+			launched = 1;
+			
+			// Imported plug-in failed, the failure is reported when completing
+			if (failed) {
+				node->load_state = PRELOAD_FAILED;
+				continue;
+			}
+			
+			// Queue or execute the preload
+			if (batch->num_workers > 0) {
+				node->load_state = PRELOAD_QUEUED;
+				batch->num_running++;
+				if (batch->queue_tail != NULL) {
+					batch->queue_tail->next_queued = node;
+				} else {
+					batch->queue_head = node;
+				}
+				batch->queue_tail = node;
+				queued = 1;
+				continue;
+			}
+			open_preloaded_runtime(node, context->env->preload_prebind);
+			node->load_state = (node->lib != NULL ? PRELOAD_DONE : PRELOAD_FAILED);
+		}
+	} while (launched);
+	
+	// Wake up the worker threads
+	if (queued) {
+		cpi_signal_context(context);
+	}
+}
+
+#if defined(CP_THREADS) && defined(DLOPEN_POSIX)
+
+/**
+ * Opens queued runtime libraries until the preloading is shut down.
+ * 
+ * @param arg the resolving of all plug-ins
+ */
+static void preload_worker(void *arg) {
+	resolve_batch_t *batch = arg;
+	cp_context_t *context = batch->context;
+	
+	cpi_lock_context(context);
+	while (!batch->shutdown) {
+		resolve_node_t *node;
+		int prebind;
+		
+		// Claim the next queued preload
+		if ((node = batch->queue_head) == NULL) {
+			cpi_wait_context(context);
+			continue;
+		}
+		if ((batch->queue_head = node->next_queued) == NULL) {
+			batch->queue_tail = NULL;
+		}
+		node->load_state = PRELOAD_RUNNING;
+		prebind = context->env->preload_prebind;
+		
+		// Open the runtime library without the context lock
+		cpi_unlock_context(context);
+		open_preloaded_runtime(node, prebind);
+		cpi_lock_context(context);
+		node->load_state = (node->lib != NULL ? PRELOAD_DONE : PRELOAD_FAILED);
+		batch->num_running--;
+		cpi_signal_context(context);
+	}
+	batch->num_workers--;
+	cpi_signal_context(context);
+	cpi_unlock_context(context);
+}
+
+#endif
+
+/**
+ * Attaches the preloaded runtime library to the plug-in and resolves the
+ * initialization functions.
+ * 
+ * @param context the plug-in context
+ * @param node the plug-in
+ * @return CP_OK (zero) on success or error code on failure
+ */
+static int attach_preloaded_runtime(cp_context_t *context, resolve_node_t *node) {
+	cp_plugin_t *plugin = node->plugin;
+	
+	if (node->rlpath == NULL) {
+		return (plugin->builtin ? bind_builtin_runtime(context, plugin) : CP_OK);
+	}
+	if (node->lib == NULL) {
+		report_runtime_open_error(context, plugin, node->rlpath, node->load_error);
+		return CP_ERR_RUNTIME;
+	}
+	cpi_debugf(context, N_("Plug-in %s runtime library %s was opened in %lu microseconds."), plugin->plugin->identifier, node->rlpath, (unsigned long) node->load_usecs);
+	plugin->stats.load_usecs += node->load_usecs;
+	plugin->runtime_lib = node->lib;
+	plugin->runtime_funcs = node->funcs;
+	node->lib = NULL;
+	return bind_plugin_runtime(context, plugin);
+}
+
+/**
+ * Preloads the runtime libraries of the deferred components and then
+ * completes the components in dependency order.
+ * 
+ * @param batch the resolving of all plug-ins
+ */
+static void preload_runtimes(resolve_batch_t *batch) {
+	cp_context_t *context = batch->context;
+	unsigned int num_threads = context->env->preload_threads;
+#if defined(CP_THREADS) && defined(DLOPEN_POSIX)
+	cp_task_t **threads = NULL;
+	unsigned int num_started = 0;
+	int guarded = 0;
+#endif
+	unsigned int num_libs = 0;
+	int i;
+	
+	// Check the runtimes and construct the library paths
+	for (i = 0; i < batch->num_deferred; i++) {
+		resolve_node_t *node = batch->deferred[i];
+		
+		if (node->plugin->plugin->runtime_lib_name == NULL || node->plugin->builtin) {
+			continue;
+		}
+		if ((node->status = prepare_plugin_runtime(context, node->plugin, &(node->rlpath))) != CP_OK) {
+			node->load_state = PRELOAD_FAILED;
+		} else {
+			node->load_state = PRELOAD_PENDING;
+			num_libs++;
+		}
+	}
+	
+	// Start reading the libraries while they wait for their imports
+	if (num_libs > 1) {
+		for (i = 0; i < batch->num_deferred; i++) {
+			if (batch->deferred[i]->load_state == PRELOAD_PENDING) {
+				cpi_prefetch_file(batch->deferred[i]->rlpath);
+			}
+		}
+	}
+	
+	// Start worker threads for opening the libraries
+	if (num_threads > num_libs) {
+		num_threads = num_libs;
+	}
+#if defined(CP_THREADS) && defined(DLOPEN_POSIX)
+	if (num_threads > 1
+		&& (threads = malloc(num_threads * sizeof(cp_task_t *))) != NULL) {
+		while (num_started < num_threads
+			&& (threads[num_started] = cpi_spawn_task(preload_worker, batch)) != NULL) {
+			num_started++;
+			batch->num_workers++;
+		}
+	}
+	
+	// Other threads wait as for a parallel start while the lock is released
+	if (num_started > 0) {
+		context->env->num_parallel_starts++;
+		guarded = 1;
+	}
+#endif
+	
+	// Open the libraries as the libraries they import become available
+	launch_preloads(batch);
+	while (batch->num_running > 0) {
+		cpi_wait_context(context);
+		launch_preloads(batch);
+	}
+	
+	// Shut down the worker threads
+#if defined(CP_THREADS) && defined(DLOPEN_POSIX)
+	batch->shutdown = 1;
+	if (batch->num_workers > 0) {
+		cpi_signal_context(context);
+		while (batch->num_workers > 0) {
+			cpi_wait_context(context);
+		}
+	}
+	while (num_started > 0) {
+		cpi_join_task(threads[--num_started]);
+	}
+	free(threads);
+	if (guarded) {
+		context->env->num_parallel_starts--;
+		cpi_signal_context(context);
+	}
+#endif
+	
+	// Complete the components in dependency order
+	for (i = 0; i < batch->num_deferred; ) {
+		resolve_node_t **members = batch->deferred + i;
+		resolve_node_t *failed = NULL;
+		int n, j, k;
+		
+		for (n = 1; i + n < batch->num_deferred && members[n]->component == members[0]->component; n++);
+		for (j = 0; j < n && failed == NULL; j++) {
+			resolve_node_t *node = members[j];
+			
+			if (node->status != CP_OK) {
+				failed = node;
+				break;
+			}
+			for (k = 0; k < node->num_imports; k++) {
+				resolve_node_t *in;
+				
+				if (node->imports[k] == NULL) {
+					continue;
+				}
+				in = get_resolve_node(batch, node->imports[k]);
+				if (in->component != node->component && in->status != CP_OK) {
+					cpi_errorf(context, N_("Plug-in %s could not be resolved because it depends on plug-in %s which could not be resolved."), node->plugin->plugin->identifier, in->plugin->plugin->identifier);
+					node->status = in->status;
+					failed = node;
+					break;
+				}
+			}
+		}
+		for (j = 0; j < n && failed == NULL; j++) {
+			if ((members[j]->status = attach_preloaded_runtime(context, members[j])) != CP_OK) {
+				failed = members[j];
+			}
+		}
+		complete_component(batch, members, n, failed);
+		i += n;
+	}
+}
+
+CP_HIDDEN cp_status_t cpi_resolve_plugins(cp_context_t *context) {
+	resolve_batch_t batch;
+	resolve_node_t **stack = NULL;
+	resolve_node_t **calls = NULL;
+	cp_plugin_t **imports = NULL;
+	cp_status_t status = CP_OK;
+	int num_nodes = 0;
+	int i;
+	
+	assert(cpi_is_context_locked(context));
+	
+	// Use the cached result if nothing has changed
+	if (context->env->resolve_order != NULL) {
+		return context->env->resolve_status;
+	}
+	
+	memset(&batch, 0, sizeof(batch));
+	batch.context = context;
+	batch.preload = (context->env->preload_threads > 0 && !context->env->lazy_runtime);
+	do {
+		hscan_t scan;
+		hnode_t *hnode;
+		size_t num_plugins = hash_count(context->env->plugins);
+		size_t num_imports = 0;
+		int counter = 0;
+		int sp = 0;
+		
+		// Allocate resources
+		hash_scan_begin(&scan, context->env->plugins);
+		while ((hnode = hash_scan_next(&scan)) != NULL) {
+			cp_plugin_t *plugin = hnode_get(hnode);
+			
+			num_imports += (plugin->state >= CP_PLUGIN_RESOLVED ? list_count(&plugin->imported->list) : (size_t) plugin->plugin->num_imports);
+		}
+		if ((batch.nodes = malloc((num_plugins + 1) * sizeof(resolve_node_t))) == NULL
+			|| (batch.order = malloc((num_plugins + 1) * sizeof(cp_plugin_t *))) == NULL
+			|| (batch.events = malloc((num_plugins + 1) * sizeof(cpi_plugin_event_t))) == NULL
+			|| (stack = malloc((num_plugins + 1) * sizeof(resolve_node_t *))) == NULL
+			|| (calls = malloc((num_plugins + 1) * sizeof(resolve_node_t *))) == NULL
+			|| (imports = malloc((num_imports + 1) * sizeof(cp_plugin_t *))) == NULL
+			|| (batch.preload && (batch.deferred = malloc((num_plugins + 1) * sizeof(resolve_node_t *))) == NULL)
+			|| (batch.node_map = hash_create(HASHCOUNT_T_MAX, cpi_comp_ptr, cpi_hashfunc_ptr)) == NULL
+			|| !hash_reserve(batch.node_map, num_plugins)) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		
+		// Look up the imported plug-ins
+		num_imports = 0;
+		hash_scan_begin(&scan, context->env->plugins);
+		while ((hnode = hash_scan_next(&scan)) != NULL && status == CP_OK) {
+			cp_plugin_t *plugin = hnode_get(hnode);
+			resolve_node_t *node = batch.nodes + num_nodes;
+			
+			memset(node, 0, sizeof(resolve_node_t));
+			node->plugin = plugin;
+			node->imports = imports + num_imports;
+			node->index = -1;
+			node->component = -1;
+			node->status = CP_OK;
+			if (plugin->state >= CP_PLUGIN_RESOLVED) {
+				lnode_t *lnode = list_first(&plugin->imported->list);
+				
+				while (lnode != NULL) {
+					node->imports[node->num_imports++] = lnode_get(lnode);
+					lnode = list_next(&plugin->imported->list, lnode);
+				}
+			} else {
+				for (i = 0; i < plugin->plugin->num_imports; i++) {
+					cp_plugin_t *ip;
+					cp_status_t s;
+					
+					if ((s = resolve_plugin_import(context, plugin, plugin->plugin->imports + i, &ip)) != CP_OK) {
+						node->status = s;
+						break;
+					}
+					node->imports[node->num_imports++] = ip;
+				}
+			}
+			num_imports += node->num_imports;
+			if (!hash_alloc_insert(batch.node_map, plugin, node)) {
+				status = CP_ERR_RESOURCE;
 			}
+			num_nodes++;
+		}
+		if (status != CP_OK) {
+			break;
+		}
+		
+		// Find the strongly connected components in dependency order
+		for (i = 0; i < num_nodes; i++) {
+			int cp = 0;
 			
-			// Notify event listeners and update state
-			event.plugin_id = plugin->plugin->identifier;
-			event.old_state = plugin->state;
-			event.new_state = plugin->state = CP_PLUGIN_RESOLVED;
-			cpi_deliver_event(context, &event);		
-	}
-}
-
-/**
- * Recursively cleans up the specified plug-in and its dependencies after
- * a failed resolving attempt.
- * 
- * @param plugin the plug-in
- */
-static void resolve_plugin_failed_rec(cp_plugin_t *plugin) {
+			if (batch.nodes[i].index >= 0) {
+				continue;
+			}
+			calls[cp++] = batch.nodes + i;
+			batch.nodes[i].index = batch.nodes[i].lowlink = counter++;
+			batch.nodes[i].on_stack = 1;
+			stack[sp++] = batch.nodes + i;
+			while (cp > 0) {
+				resolve_node_t *node = calls[cp - 1];
+				
+				// Visit the next imported plug-in
+				if (node->next_import < node->num_imports) {
+					cp_plugin_t *ip = node->imports[node->next_import++];
+					resolve_node_t *in;
+					
+					if (ip == NULL) {
+						continue;
+					}
+					in = get_resolve_node(&batch, ip);
+					if (in->index < 0) {
+						in->index = in->lowlink = counter++;
+						in->on_stack = 1;
+						stack[sp++] = in;
+						calls[cp++] = in;
+					} else if (in->on_stack && in->index < node->lowlink) {
+						node->lowlink = in->index;
+					}
+					continue;
+				}
+				
+				// All imports visited, resolve the component if complete
+				cp--;
+				if (cp > 0 && node->lowlink < calls[cp - 1]->lowlink) {
+					calls[cp - 1]->lowlink = node->lowlink;
+				}
+				if (node->lowlink == node->index) {
+					int base = sp;
+					
+					do {
+						base--;
+					} while (stack[base] != node);
+					resolve_component(&batch, stack + base, sp - base);
+					sp = base;
+				}
+			}
+		}
+		assert(sp == 0);
+		
+		// Open the runtime libraries of the deferred plug-ins
+		if (batch.num_deferred > 0) {
+			preload_runtimes(&batch);
+		}
+		status = batch.status;
+		
+		// Cache the resolution order unless out of memory
+		if (status != CP_ERR_RESOURCE) {
+			context->env->resolve_order = batch.order;
+			context->env->num_resolve_order = batch.num_order;
+			context->env->resolve_status = status;
+			batch.order = NULL;
+		}
+		
+	} while (0);
 	
-	// Check if already cleaned up
-	if (!plugin->processed) {
-		return;
+	// Deliver the events of the resolved plug-ins as a single batch
+	cpi_deliver_events(context, batch.events, batch.num_events);
+	
+	// Report insufficient memory
+	if (status == CP_ERR_RESOURCE && batch.num_components == 0) {
+		cpi_error(context, N_("Plug-ins could not be resolved due to insufficient memory."));
 	}
-	plugin->processed = 0;
 	
-	// Clean up if only preliminarily resolved
-	if (plugin->state < CP_PLUGIN_RESOLVED) {
-		lnode_t *node;
-
-		// Recursively clean up depedencies
-		while ((node = list_first(plugin->imported)) != NULL) {
-			cp_plugin_t *ip = lnode_get(node);
-			
-			resolve_plugin_failed_rec(ip);
-			cpi_ptrset_remove(ip->importing, plugin);
-			list_delete(plugin->imported, node);
-			lnode_destroy(node);
+	// Release resources
+	for (i = 0; i < num_nodes; i++) {
+		if (batch.nodes[i].lib != NULL) {
+			DLCLOSE(batch.nodes[i].lib);
 		}
-		list_destroy(plugin->imported);
-		plugin->imported = NULL;
+		free(batch.nodes[i].rlpath);
+		free(batch.nodes[i].load_error);
+	}
+	if (batch.node_map != NULL) {
+		hash_free_nodes(batch.node_map);
+		hash_destroy(batch.node_map);
 	}
+	free(batch.nodes);
+	free(batch.order);
+	free(batch.events);
+	free(batch.deferred);
+	free(stack);
+	free(calls);
+	free(imports);
+	
+	return status;
 }
 
-/**
- * Resolves the specified plug-in and its dependencies.
- * 
- * @param context the plug-in context
- * @param plugin the plug-in to be resolved
- * @return CP_OK (zero) on success or an error code on failure
- */
-static int resolve_plugin(cp_context_t *context, cp_plugin_t *plugin) {
+CP_C_API cp_status_t cp_resolve_plugins(cp_context_t *context) {
 	cp_status_t status;
 	
-	if ((status = resolve_plugin_prel_rec(context, plugin)) == CP_OK || status == CP_OK_PRELIMINARY) {
-		status = CP_OK;
-		resolve_plugin_commit_rec(context, plugin);
-	} else {
-		resolve_plugin_failed_rec(plugin);
-	}
-	assert_processed_zero(context);
+	CHECK_NOT_NULL(context);
+	
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	cpi_wait_parallel_starts(context);
+	status = cpi_resolve_plugins(context);
+	cpi_unlock_context(context);
+	
 	return status;
 }
 
 /**
- * Starts the plug-in runtime of the specified plug-in. This function does
- * not consider dependencies and assumes that the plug-in is resolved but
- * not yet started.
+ * Prepares the plug-in runtime of the specified plug-in for starting. Creates
+ * the plug-in instance if necessary and, if the plug-in has a start function,
+ * moves the plug-in into starting state. This function does not consider
+ * dependencies and assumes that the plug-in is resolved but not yet started.
+ * The start is completed using finish_plugin_runtime_start.
  * 
  * @param context the plug-in context
  * @param plugin the plug-in
+ * @param nodeptr filled with the list node for the started plug-ins list, or NULL
  * @return CP_OK (zero) on success or an error code on failure
  */
-static int start_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
+static int begin_plugin_runtime_start(cp_context_t *context, cp_plugin_t *plugin, lnode_t **nodeptr) {
 	cp_status_t status = CP_OK;
 	cpi_plugin_event_t event;
-	lnode_t *node = NULL;
+	unsigned long long started;
 
 	event.plugin_id = plugin->plugin->identifier;
 	do {
 
 		// Allocate space for the list node 
-		node = lnode_create(plugin);
-		if (node == NULL) {
+		*nodeptr = cpi_create_lnode(context->env->nodes, plugin);
+		if (*nodeptr == NULL) {
 			status = CP_ERR_RESOURCE;
 			break;
 		}
 		
+		// Load the plug-in runtime library if loading was deferred
+		if ((status = load_plugin_runtime(context, plugin)) != CP_OK) {
+			break;
+		}
+		
 		// Set up plug-in instance
 		if (plugin->runtime_funcs != NULL) {
 
@@ -645,58 +2236,79 @@ static int start_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
 				if ((plugin->context = cpi_new_context(plugin, context->env, &status)) == NULL) {
 					break;
 				}
+				started = cpi_monotonic_usecs();
 				context->env->in_create_func_invocation++;
 				plugin->plugin_data = plugin->runtime_funcs->create(plugin->context);
 				context->env->in_create_func_invocation--;
+				plugin->stats.create_usecs += cpi_monotonic_usecs() - started;
 				if (plugin->plugin_data == NULL) {
 					status = CP_ERR_RUNTIME;
 					break;
 				}
 			}
 			
-			// Start plug-in
+			// About to start the plug-in 
 			if (plugin->runtime_funcs->start != NULL) {
-				int s;
-			
-				// About to start the plug-in 
 				event.old_state = plugin->state;
 				event.new_state = plugin->state = CP_PLUGIN_STARTING;
 				cpi_deliver_event(context, &event);
+			}
+		}
 		
-				// Start the plug-in
-				context->env->in_start_func_invocation++;
-				s = plugin->runtime_funcs->start(plugin->plugin_data);
-				context->env->in_start_func_invocation--;
+	} while (0);
+	
+	return status;
+}
+
+/**
+ * Completes starting the plug-in runtime of the specified plug-in after the
+ * start function, if any, has been called. Rolls back the plug-in state if
+ * the preparation or the start function failed.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in
+ * @param node the list node created by begin_plugin_runtime_start, or NULL
+ * @param status the status returned by begin_plugin_runtime_start
+ * @param start_status the value returned by the start function, or CP_OK
+ * @return CP_OK (zero) on success or an error code on failure
+ */
+static int finish_plugin_runtime_start(cp_context_t *context, cp_plugin_t *plugin, lnode_t *node, cp_status_t status, int start_status) {
+	cpi_plugin_event_t event;
 
-				if (s != CP_OK) {
+	event.plugin_id = plugin->plugin->identifier;
+	do {
+		
+		if (status != CP_OK) {
+			break;
+		}
+		if (start_status != CP_OK) {
 			
-					// Roll back plug-in state 
-					if (plugin->runtime_funcs->stop != NULL) {
+			// Roll back plug-in state 
+			if (plugin->runtime_funcs->stop != NULL) {
 
-						// Update state					
-						event.old_state = plugin->state;
-						event.new_state = plugin->state = CP_PLUGIN_STOPPING;
-						cpi_deliver_event(context, &event);
-					
-						// Call stop function
-						context->env->in_stop_func_invocation++;
-						plugin->runtime_funcs->stop(plugin->plugin_data);
-						context->env->in_stop_func_invocation--;
-					}
-				
-					// Destroy plug-in object
-					context->env->in_destroy_func_invocation++;
-					plugin->runtime_funcs->destroy(plugin->plugin_data);
-					context->env->in_destroy_func_invocation--;
+				// Update state					
+				event.old_state = plugin->state;
+				event.new_state = plugin->state = CP_PLUGIN_STOPPING;
+				cpi_deliver_event(context, &event);
 			
-					status = CP_ERR_RUNTIME;
-					break;
-				}
+				// Call stop function
+				context->env->in_stop_func_invocation++;
+				call_stop_func(plugin, &plugin->stats.stop_usecs);
+				context->env->in_stop_func_invocation--;
 			}
+		
+			// Destroy plug-in object
+			context->env->in_destroy_func_invocation++;
+			call_destroy_func(plugin);
+			context->env->in_destroy_func_invocation--;
+	
+			status = CP_ERR_RUNTIME;
+			break;
 		}
 		
 		// Plug-in active 
-		list_append(context->env->started_plugins, node);
+		cpi_ptrset_append_node(context->env->nodes, context->env->started_plugins, node);
+		plugin->stats.num_starts++;
 		event.old_state = plugin->state;
 		event.new_state = plugin->state = CP_PLUGIN_ACTIVE;
 		cpi_deliver_event(context, &event);
@@ -706,7 +2318,7 @@ static int start_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
 	// Release resources and roll back plug-in state on failure
 	if (status != CP_OK) {
 		if (node != NULL) {
-			lnode_destroy(node);
+			cpi_destroy_lnode(context->env->nodes, node);
 		}
 		if (plugin->context != NULL) {
 			cpi_free_context(plugin->context);
@@ -739,7 +2351,40 @@ static int start_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
 	return status;
 }
 
-static void warn_dependency_loop(cp_context_t *context, cp_plugin_t *plugin, list_t *importing, int dynamic) {
+/**
+ * Returns whether the specified plug-in has a start function to be called.
+ * 
+ * @param plugin the plug-in
+ * @return whether the plug-in has a start function
+ */
+static int has_start_func(cp_plugin_t *plugin) {
+	return plugin->runtime_funcs != NULL && plugin->runtime_funcs->start != NULL;
+}
+
+/**
+ * Starts the plug-in runtime of the specified plug-in. This function does
+ * not consider dependencies and assumes that the plug-in is resolved but
+ * not yet started.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in
+ * @return CP_OK (zero) on success or an error code on failure
+ */
+static int start_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
+	cp_status_t status;
+	int s = CP_OK;
+	lnode_t *node = NULL;
+
+	status = begin_plugin_runtime_start(context, plugin, &node);
+	if (status == CP_OK && has_start_func(plugin)) {
+		context->env->in_start_func_invocation++;
+		s = call_start_func(plugin, &plugin->stats.start_usecs);
+		context->env->in_start_func_invocation--;
+	}
+	return finish_plugin_runtime_start(context, plugin, node, status, s);
+}
+
+static void warn_dependency_loop(cp_context_t *context, cp_plugin_t *plugin, cpi_ptrset_t *importing, int dynamic) {
 	char *msgbase;
 	char *msg;
 	int msgsize;
@@ -756,7 +2401,7 @@ static void warn_dependency_loop(cp_context_t *context, cp_plugin_t *plugin, lis
 	msgsize = 0;
 	msgsize += strlen(plugin->plugin->identifier);
 	msgsize += 2;
-	node = list_last(importing);
+	node = list_last(&importing->list);
 	while (node != NULL) {
 		cp_plugin_t *p = lnode_get(node);
 		if (p == plugin) {
@@ -764,12 +2409,12 @@ static void warn_dependency_loop(cp_context_t *context, cp_plugin_t *plugin, lis
 		}
 		msgsize += strlen(p->plugin->identifier);
 		msgsize += 2;
-		node = list_prev(importing, node);
+		node = list_prev(&importing->list, node);
 	}
 	msg = malloc(sizeof(char) * msgsize);
 	if (msg != NULL) {
 		strcpy(msg, plugin->plugin->identifier);
-		node = list_last(importing);
+		node = list_last(&importing->list);
 		while (node != NULL) {
 			cp_plugin_t *p = lnode_get(node);
 			if (p == plugin) {
@@ -777,7 +2422,7 @@ static void warn_dependency_loop(cp_context_t *context, cp_plugin_t *plugin, lis
 			}
 			strcat(msg, ", ");
 			strcat(msg, p->plugin->identifier);
-			node = list_prev(importing, node);
+			node = list_prev(&importing->list, node);
 		}
 		strcat(msg, ".");
 		cpi_infof(context, msgbase, msg);
@@ -795,7 +2440,7 @@ static void warn_dependency_loop(cp_context_t *context, cp_plugin_t *plugin, lis
  * @param importing stack of importing plug-ins
  * @return CP_OK (zero) on success or an error code on failure
  */
-static int start_plugin_rec(cp_context_t *context, cp_plugin_t *plugin, list_t *importing) {
+static int start_plugin_rec(cp_context_t *context, cp_plugin_t *plugin, cpi_ptrset_t *importing) {
 	cp_status_t status = CP_OK;
 	lnode_t *node;
 	
@@ -813,7 +2458,7 @@ static int start_plugin_rec(cp_context_t *context, cp_plugin_t *plugin, list_t *
 		warn_dependency_loop(context, plugin, importing, 0);
 		return CP_OK;
 	}
-	if (!cpi_ptrset_add(importing, plugin)) {
+	if (!cpi_ptrset_add(context->env->nodes, importing, plugin)) {
 		cpi_errorf(context,
 			N_("Plug-in %s could not be started due to insufficient memory."),
 			plugin->plugin->identifier);
@@ -821,103 +2466,524 @@ static int start_plugin_rec(cp_context_t *context, cp_plugin_t *plugin, list_t *
 	}
 
 	// Start up dependencies
-	node = list_first(plugin->imported);
+	node = list_first(&plugin->imported->list);
 	while (node != NULL) {
 		cp_plugin_t *ip = lnode_get(node);
 		
 		if ((status = start_plugin_rec(context, ip, importing)) != CP_OK) {
 			break;
 		}
-		node = list_next(plugin->imported, node);
+		node = list_next(&plugin->imported->list, node);
 	}
-	cpi_ptrset_remove(importing, plugin);
+	cpi_ptrset_remove(context->env->nodes, importing, plugin);
 	
 	// Start up this plug-in
 	if (status == CP_OK) {
 		status = start_plugin_runtime(context, plugin);
 	}
 
-	return status;
+	return status;
+}
+
+CP_HIDDEN cp_status_t cpi_start_plugin(cp_context_t *context, cp_plugin_t *plugin) {
+	cp_status_t status;
+	
+	if ((status = resolve_plugin(context, plugin)) == CP_OK) {
+		cpi_ptrset_t *importing = cpi_create_ptrset();
+		if (importing != NULL) {
+			status = start_plugin_rec(context, plugin, importing);
+			cpi_destroy_ptrset(importing);
+		} else {
+			cpi_errorf(context,
+				N_("Plug-in %s could not be started due to insufficient memory."),
+				plugin->plugin->identifier);
+			status = CP_ERR_RESOURCE;
+		}
+	}
+	return status;
+}
+
+CP_C_API cp_status_t cp_start_plugin(cp_context_t *context, const char *id) {
+	hnode_t *node;
+	cp_status_t status = CP_OK;
+
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(id);
+
+	// Look up and start the plug-in 
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	cpi_wait_parallel_starts(context);
+	node = hash_lookup(context->env->plugins, id);
+	if (node != NULL) {
+		status = cpi_start_plugin(context, hnode_get(node));
+	} else {
+		cpi_warnf(context, N_("Unknown plug-in %s could not be started."), id);
+		status = CP_ERR_UNKNOWN;
+	}
+	cpi_unlock_context(context);
+
+	return status;
+}
+
+CP_HIDDEN void cpi_wait_parallel_starts(cp_context_t *context) {
+	assert(cpi_is_context_locked(context));
+	if (context->plugin != NULL && context->plugin->parallel_start) {
+		return;
+	}
+	while (context->env->num_parallel_starts > 0) {
+		cpi_wait_context(context);
+	}
+}
+
+/**
+ * Adds start tasks for the specified plug-in and the imported plug-ins
+ * which are not yet active, imported plug-ins first. Static dependency
+ * loops are broken the same way as when starting plug-ins serially.
+ *
+ * @param batch the parallel start
+ * @param plugin the plug-in
+ * @param importing stack of importing plug-ins
+ * @param taskptr filled with the task for the plug-in or NULL if none
+ * @return CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t add_start_task_rec(start_batch_t *batch, cp_plugin_t *plugin, cpi_ptrset_t *importing, start_task_t **taskptr) {
+	cp_context_t *context = batch->context;
+	cp_status_t status = CP_OK;
+	start_task_t **prereqs = NULL;
+	int num_prereqs = 0;
+	start_task_t *task;
+	hnode_t *hnode;
+	lnode_t *node;
+
+	*taskptr = NULL;
+
+	// Check if already active or included
+	if (plugin->state == CP_PLUGIN_ACTIVE) {
+		return CP_OK;
+	}
+	if ((hnode = hash_lookup(batch->task_map, plugin)) != NULL) {
+		*taskptr = hnode_get(hnode);
+		return CP_OK;
+	}
+	assert(plugin->state == CP_PLUGIN_RESOLVED);
+
+	// Check for dependency loops
+	if (cpi_ptrset_contains(importing, plugin)) {
+		warn_dependency_loop(context, plugin, importing, 0);
+		return CP_OK;
+	}
+	if (!cpi_ptrset_add(context->env->nodes, importing, plugin)) {
+		return CP_ERR_RESOURCE;
+	}
+
+	// Add the tasks of the imported plug-ins
+	if (!list_isempty(&plugin->imported->list)
+		&& (prereqs = malloc(list_count(&plugin->imported->list) * sizeof(start_task_t *))) == NULL) {
+		status = CP_ERR_RESOURCE;
+	}
+	node = list_first(&plugin->imported->list);
+	while (status == CP_OK && node != NULL) {
+		start_task_t *ipt;
+
+		if ((status = add_start_task_rec(batch, lnode_get(node), importing, &ipt)) == CP_OK
+			&& ipt != NULL) {
+			prereqs[num_prereqs++] = ipt;
+		}
+		node = list_next(&plugin->imported->list, node);
+	}
+	cpi_ptrset_remove(context->env->nodes, importing, plugin);
+
+	// Add a task for this plug-in
+	if (status == CP_OK) {
+		task = batch->tasks + batch->num_tasks;
+		memset(task, 0, sizeof(start_task_t));
+		task->plugin = plugin;
+		task->state = START_TASK_PENDING;
+		task->prereqs = prereqs;
+		task->num_prereqs = num_prereqs;
+		task->start_status = CP_OK;
+		task->status = CP_OK;
+		if (!hash_alloc_insert(batch->task_map, plugin, task)) {
+			status = CP_ERR_RESOURCE;
+		} else {
+			batch->num_tasks++;
+			*taskptr = task;
+		}
+	}
+	if (status != CP_OK) {
+		free(prereqs);
+	}
+
+	return status;
+}
+
+/**
+ * Completes a start task after the start function, if any, has returned.
+ *
+ * @param batch the parallel start
+ * @param task the task
+ * @param status the status of preparing the plug-in runtime
+ */
+static void complete_start_task(start_batch_t *batch, start_task_t *task, cp_status_t status) {
+	cp_context_t *context = batch->context;
+
+	if (task->plugin->parallel_start) {
+		task->plugin->parallel_start = 0;
+		context->env->num_parallel_starts--;
+		batch->num_running--;
+	}
+	task->status = finish_plugin_runtime_start(context, task->plugin, task->node, status, task->start_status);
+	task->node = NULL;
+	task->state = (task->status == CP_OK ? START_TASK_DONE : START_TASK_FAILED);
+}
+
+/**
+ * Launches all the start tasks whose imported plug-ins are active. Start
+ * functions are queued for the worker threads or, if there are none,
+ * executed by the calling thread.
+ *
+ * @param batch the parallel start
+ */
+static void launch_start_tasks(start_batch_t *batch) {
+	cp_context_t *context = batch->context;
+	int queued = 0;
+	int launched;
+
+	do {
+		int i;
+
+		launched = 0;
+		for (i = 0; i < batch->num_tasks; i++) {
+			start_task_t *task = batch->tasks + i;
+			cp_status_t status = CP_OK;
+			int j, ready = 1;
+
+			// Check if the imported plug-ins have been started
+			if (task->state != START_TASK_PENDING) {
+				continue;
+			}
+			for (j = 0; j < task->num_prereqs && ready; j++) {
+				if (task->prereqs[j]->state == START_TASK_FAILED) {
+					status = task->prereqs[j]->status;
+				} else if (task->prereqs[j]->state != START_TASK_DONE) {
+					ready = 0;
+				}
+			}
+			if (!ready) {
+				continue;
+			}
+			launched = 1;
+
+			// Imported plug-in failed to start
+			if (status != CP_OK) {
+				task->status = status;
+				task->state = START_TASK_FAILED;
+				continue;
+			}
+
+			// Already started by a dynamic dependency of an earlier start
+			if (task->plugin->state == CP_PLUGIN_ACTIVE) {
+				task->state = START_TASK_DONE;
+				continue;
+			}
+			
+			// Prepare the plug-in and queue or execute the start function
+			status = begin_plugin_runtime_start(context, task->plugin, &(task->node));
+			if (status == CP_OK && has_start_func(task->plugin)) {
+				if (batch->num_workers > 0) {
+					task->plugin->parallel_start = 1;
+					context->env->num_parallel_starts++;
+					batch->num_running++;
+					task->state = START_TASK_QUEUED;
+					if (batch->queue_tail != NULL) {
+						batch->queue_tail->next_queued = task;
+					} else {
+						batch->queue_head = task;
+					}
+					batch->queue_tail = task;
+					queued = 1;
+					continue;
+				}
+				context->env->in_start_func_invocation++;
+				task->start_status = call_start_func(task->plugin, &task->plugin->stats.start_usecs);
+				context->env->in_start_func_invocation--;
+			}
+			complete_start_task(batch, task, status);
+		}
+	} while (launched);
+
+	// Wake up the worker threads
+	if (queued) {
+		cpi_signal_context(context);
+	}
 }
 
-CP_HIDDEN cp_status_t cpi_start_plugin(cp_context_t *context, cp_plugin_t *plugin) {
-	cp_status_t status;
-	
-	if ((status = resolve_plugin(context, plugin)) == CP_OK) {
-		list_t *importing = list_create(LISTCOUNT_T_MAX);
-		if (importing != NULL) {
-			status = start_plugin_rec(context, plugin, importing);
-			assert(list_isempty(importing));
-			list_destroy(importing);
-		} else {
-			cpi_errorf(context,
-				N_("Plug-in %s could not be started due to insufficient memory."),
-				plugin->plugin->identifier);
-			status = CP_ERR_RESOURCE;
+#ifdef CP_THREADS
+
+/**
+ * Executes queued start functions until the parallel start is shut down.
+ *
+ * @param arg the parallel start
+ */
+static void start_worker(void *arg) {
+	start_batch_t *batch = arg;
+	cp_context_t *context = batch->context;
+
+	cpi_lock_context(context);
+	while (!batch->shutdown) {
+		start_task_t *task;
+		unsigned long long usecs = 0;
+		int s;
+
+		// Claim the next queued task
+		if ((task = batch->queue_head) == NULL) {
+			cpi_wait_context(context);
+			continue;
 		}
+		if ((batch->queue_head = task->next_queued) == NULL) {
+			batch->queue_tail = NULL;
+		}
+		task->state = START_TASK_RUNNING;
+
+		// Execute the start function without the context lock
+		cpi_unlock_context(context);
+		s = call_start_func(task->plugin, &usecs);
+		cpi_lock_context(context);
+		task->plugin->stats.start_usecs += usecs;
+		task->start_status = s;
+		task->state = START_TASK_FINISHED;
+		cpi_signal_context(context);
 	}
-	return status;
+	batch->num_workers--;
+	cpi_signal_context(context);
+	cpi_unlock_context(context);
 }
 
-CP_C_API cp_status_t cp_start_plugin(cp_context_t *context, const char *id) {
-	hnode_t *node;
+#endif
+
+CP_C_API cp_status_t cp_start_plugins_parallel(cp_context_t *context, const char * const *ids, int num, unsigned int num_threads) {
+	start_batch_t batch;
+	cpi_ptrset_t *importing = NULL;
+	cp_plugin_t **plugins = NULL;
+#ifdef CP_THREADS
+	cp_task_t **threads = NULL;
+	unsigned int num_started = 0;
+#endif
+	int launched = 0;
 	cp_status_t status = CP_OK;
+	cp_status_t rstatus = CP_OK;
+	int i, n = 0;
 
 	CHECK_NOT_NULL(context);
-	CHECK_NOT_NULL(id);
 
-	// Look up and start the plug-in 
+	memset(&batch, 0, sizeof(batch));
+	batch.context = context;
 	cpi_lock_context(context);
 	cpi_check_invocation(context, CPI_CF_ANY, __func__);
-	node = hash_lookup(context->env->plugins, id);
-	if (node != NULL) {
-		status = cpi_start_plugin(context, hnode_get(node));
-	} else {
-		cpi_warnf(context, N_("Unknown plug-in %s could not be started."), id);
-		status = CP_ERR_UNKNOWN;
+	cpi_wait_parallel_starts(context);
+	do {
+		int num_funcs = 0;
+
+		// Allocate resources
+		n = (ids != NULL ? num : (int) hash_count(context->env->plugins));
+		if ((plugins = malloc((n > 0 ? n : 1) * sizeof(cp_plugin_t *))) == NULL
+			|| (batch.tasks = malloc((hash_count(context->env->plugins) + 1) * sizeof(start_task_t))) == NULL
+			|| (batch.task_map = hash_create(HASHCOUNT_T_MAX, cpi_comp_ptr, cpi_hashfunc_ptr)) == NULL
+			|| (importing = cpi_create_ptrset()) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+
+		// Look up the plug-ins
+		if (ids != NULL) {
+			for (i = 0; i < n; i++) {
+				hnode_t *node;
+
+				if ((node = hash_lookup(context->env->plugins, ids[i])) == NULL) {
+					cpi_warnf(context, N_("Unknown plug-in %s could not be started."), ids[i]);
+					status = CP_ERR_UNKNOWN;
+					break;
+				}
+				plugins[i] = hnode_get(node);
+			}
+			if (status != CP_OK) {
+				break;
+			}
+		} else {
+
+			// Resolve all the plug-ins at once, imports first
+			if ((rstatus = cpi_resolve_plugins(context)) == CP_ERR_RESOURCE) {
+				status = rstatus;
+				break;
+			}
+			n = context->env->num_resolve_order;
+			memcpy(plugins, context->env->resolve_order, n * sizeof(cp_plugin_t *));
+		}
+
+		// Resolve the plug-ins and order them so that imports come first
+		for (i = 0; i < n && status == CP_OK; i++) {
+			start_task_t *task;
+			cp_status_t s;
+
+			if (ids != NULL && (s = resolve_plugin(context, plugins[i])) != CP_OK) {
+				if (rstatus == CP_OK) {
+					rstatus = s;
+				}
+				continue;
+			}
+			status = add_start_task_rec(&batch, plugins[i], importing, &task);
+		}
+		if (status != CP_OK) {
+			break;
+		}
+
+		// Start worker threads for the start functions, counting plug-ins
+		// whose runtime library has not been loaded yet as having one
+		for (i = 0; i < batch.num_tasks; i++) {
+			cp_plugin_t *plugin = batch.tasks[i].plugin;
+			
+			if (has_start_func(plugin)
+				|| (plugin->runtime_lib == NULL && plugin->plugin->runtime_lib_name != NULL && !plugin->builtin)) {
+				num_funcs++;
+			}
+		}
+		if (num_threads > (unsigned int) num_funcs) {
+			num_threads = num_funcs;
+		}
+#ifdef CP_THREADS
+		if (num_threads > 1
+			&& (threads = malloc(num_threads * sizeof(cp_task_t *))) != NULL) {
+			while (num_started < num_threads
+				&& (threads[num_started] = cpi_spawn_task(start_worker, &batch)) != NULL) {
+				num_started++;
+				batch.num_workers++;
+			}
+		}
+#endif
+
+		// Start the plug-ins as their imports become active
+		launched = 1;
+		launch_start_tasks(&batch);
+		while (batch.num_running > 0) {
+			cpi_wait_context(context);
+			for (i = 0; i < batch.num_tasks; i++) {
+				if (batch.tasks[i].state == START_TASK_FINISHED) {
+					complete_start_task(&batch, batch.tasks + i, CP_OK);
+				}
+			}
+			launch_start_tasks(&batch);
+		}
+
+		// Return the status of the first failure
+		for (i = 0; i < batch.num_tasks && status == CP_OK; i++) {
+			status = batch.tasks[i].status;
+		}
+
+	} while (0);
+
+	// Shut down the worker threads
+#ifdef CP_THREADS
+	batch.shutdown = 1;
+	if (batch.num_workers > 0) {
+		cpi_signal_context(context);
+		while (batch.num_workers > 0) {
+			cpi_wait_context(context);
+		}
+	}
+	while (num_started > 0) {
+		cpi_join_task(threads[--num_started]);
+	}
+
+	// Wake up threads waiting for the parallel start to complete
+	cpi_signal_context(context);
+#endif
+
+	// Report insufficient memory error
+	if (status == CP_ERR_RESOURCE && !launched) {
+		cpi_error(context, N_("Plug-ins could not be started due to insufficient memory."));
 	}
 	cpi_unlock_context(context);
 
-	return status;
+	// Release resources
+	for (i = 0; i < batch.num_tasks; i++) {
+		free(batch.tasks[i].prereqs);
+	}
+	free(batch.tasks);
+	if (batch.task_map != NULL) {
+		hash_free_nodes(batch.task_map);
+		hash_destroy(batch.task_map);
+	}
+	if (importing != NULL) {
+		cpi_destroy_ptrset(importing);
+	}
+	free(plugins);
+#ifdef CP_THREADS
+	free(threads);
+#endif
+
+	return (status != CP_OK ? status : rstatus);
 }
 
 /**
- * Stops the plug-in runtime of the specified plug-in. This function does
- * not consider dependencies and assumes that the plug-in is active.
+ * Prepares the plug-in runtime of the specified plug-in for stopping. Waits
+ * for the run functions of the plug-in to stop and, if the plug-in has a
+ * stop function, moves the plug-in into stopping state. This function does
+ * not consider dependencies and assumes that the plug-in is active. The
+ * stop is completed using finish_plugin_runtime_stop.
  * 
  * @param context the plug-in context
  * @param plugin the plug-in
+ * @return whether the stop function should be called
  */
-static void stop_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
+static int begin_plugin_runtime_stop(cp_context_t *context, cp_plugin_t *plugin) {
 	cpi_plugin_event_t event;
 	
-	// Destroy plug-in instance
-	event.plugin_id = plugin->plugin->identifier;
-	if (plugin->context != NULL) {
+	if (plugin->context == NULL) {
+		return 0;
+	}
 	
-		// Wait until possible run functions have stopped
-		cpi_stop_plugin_run(plugin);
-
-		// Stop the plug-in
-		if (plugin->runtime_funcs->stop != NULL) {
+	// Wait until possible run functions and pool tasks have stopped
+	cpi_stop_plugin_run(plugin);
+	cpi_drain_tasks(context, plugin);
+	
+	// About to stop the plug-in
+	if (plugin->runtime_funcs->stop == NULL) {
+		return 0;
+	}
+	event.plugin_id = plugin->plugin->identifier;
+	event.old_state = plugin->state;
+	event.new_state = plugin->state = CP_PLUGIN_STOPPING;
+	cpi_deliver_event(context, &event);
+	return 1;
+}
 
-			// About to stop the plug-in 
-			event.old_state = plugin->state;
-			event.new_state = plugin->state = CP_PLUGIN_STOPPING;
-			cpi_deliver_event(context, &event);
+/**
+ * Completes stopping the plug-in runtime of the specified plug-in after
+ * the stop function, if any, has been called.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in
+ */
+static void finish_plugin_runtime_stop(cp_context_t *context, cp_plugin_t *plugin) {
+	cpi_plugin_event_t event;
 	
-			// Invoke stop function	
-			context->env->in_stop_func_invocation++;
-			plugin->runtime_funcs->stop(plugin->plugin_data);
-			context->env->in_stop_func_invocation--;
+	// Destroy plug-in instance
+	event.plugin_id = plugin->plugin->identifier;
+	if (plugin->context != NULL) {
 
-		}
+		// Drain pool tasks submitted by the stop function
+		cpi_drain_tasks(context, plugin);
 
 		// Unregister all logger functions
-		cpi_unregister_loggers(plugin->context->env->loggers, plugin);
+		cpi_unregister_loggers(plugin->context, plugin);
 
 		// Unregister all plug-in listeners
-		cpi_unregister_plisteners(plugin->context->env->plugin_listeners, plugin);	
+		cpi_unregister_plisteners(plugin->context->env, plugin);	
+		cpi_unregister_batch_plisteners(plugin->context, plugin);
+
+		// Unregister all fork handlers
+		cpi_unregister_fork_handlers(plugin->context, plugin);
 
 		// Release resolved symbols
 		if (plugin->context->resolved_symbols != NULL) {
@@ -929,7 +2995,7 @@ static void stop_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
 				hash_scan_begin(&scan, plugin->context->resolved_symbols);
 				node = hash_scan_next(&scan);
 				ptr = hnode_getkey(node);
-				cp_release_symbol(context, ptr);
+				cp_release_symbol(plugin->context, ptr);
 			}
 			assert(hash_isempty(plugin->context->resolved_symbols));
 		}
@@ -951,16 +3017,37 @@ static void stop_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
 			hash_destroy(plugin->defined_symbols);
 			plugin->defined_symbols = NULL;
 		}
+		free(plugin->symbol_tables);
+		plugin->symbol_tables = NULL;
+		plugin->num_symbol_tables = 0;
 		
 	}
 	
 	// Plug-in stopped 
-	cpi_ptrset_remove(context->env->started_plugins, plugin);
+	cpi_ptrset_remove(context->env->nodes, context->env->started_plugins, plugin);
 	event.old_state = plugin->state;
 	event.new_state = plugin->state = CP_PLUGIN_RESOLVED;
 	cpi_deliver_event(context, &event);
 }
 
+/**
+ * Stops the plug-in runtime of the specified plug-in. This function does
+ * not consider dependencies and assumes that the plug-in is active.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in
+ */
+static void stop_plugin_runtime(cp_context_t *context, cp_plugin_t *plugin) {
+	if (begin_plugin_runtime_stop(context, plugin)) {
+		
+		// Invoke stop function	
+		context->env->in_stop_func_invocation++;
+		call_stop_func(plugin, &plugin->stats.stop_usecs);
+		context->env->in_stop_func_invocation--;
+	}
+	finish_plugin_runtime_stop(context, plugin);
+}
+
 /**
  * Stops the plug-in and all plug-ins depending on it.
  * 
@@ -981,11 +3068,18 @@ static void stop_plugin_rec(cp_context_t *context, cp_plugin_t *plugin) {
 	}
 	plugin->processed = 1;
 	
-	// Stop the depending plug-ins
-	node = list_first(plugin->importing);
+	// Stop the depending plug-ins (stopping a plug-in may release dynamic
+	// dependencies on this plug-in, so the scan restarts after each stop)
+	node = list_first(&plugin->importing->list);
 	while (node != NULL) {
-		stop_plugin_rec(context, lnode_get(node));
-		node = list_next(plugin->importing, node);
+		cp_plugin_t *ip = lnode_get(node);
+		
+		if (ip->state >= CP_PLUGIN_ACTIVE && !ip->processed) {
+			stop_plugin_rec(context, ip);
+			node = list_first(&plugin->importing->list);
+		} else {
+			node = list_next(&plugin->importing->list, node);
+		}
 	}
 
 	// Stop this plug-in
@@ -1013,6 +3107,7 @@ CP_C_API cp_status_t cp_stop_plugin(cp_context_t *context, const char *id) {
 	// Look up and stop the plug-in 
 	cpi_lock_context(context);
 	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	cpi_wait_parallel_starts(context);
 	node = hash_lookup(context->env->plugins, id);
 	if (node != NULL) {
 		plugin = hnode_get(node);
@@ -1034,10 +3129,232 @@ CP_C_API void cp_stop_plugins(cp_context_t *context) {
 	// Stop the active plug-ins in the reverse order they were started 
 	cpi_lock_context(context);
 	cpi_check_invocation(context, CPI_CF_ANY, __func__);
-	while ((node = list_last(context->env->started_plugins)) != NULL) {
+	cpi_wait_parallel_starts(context);
+	while ((node = list_last(&context->env->started_plugins->list)) != NULL) {
+		stop_plugin(context, lnode_get(node));
+	}
+	cpi_unlock_context(context);
+}
+
+/**
+ * Launches all the stop tasks whose importing plug-ins have been stopped.
+ * Stop functions are queued for the worker threads or, if there are none,
+ * executed by the calling thread.
+ *
+ * @param batch the parallel stop
+ */
+static void launch_stop_tasks(stop_batch_t *batch) {
+	cp_context_t *context = batch->context;
+	int queued = 0;
+	int launched;
+	
+	do {
+		int i;
+		
+		launched = 0;
+		for (i = 0; i < batch->num_tasks; i++) {
+			stop_task_t *task = batch->tasks + i;
+			cp_plugin_t *plugin = task->plugin;
+			lnode_t *node;
+			int ready = 1;
+			
+			if (task->state != START_TASK_PENDING) {
+				continue;
+			}
+			
+			// Already stopped as a dependency of a plug-in in a loop
+			if (plugin->state < CP_PLUGIN_ACTIVE) {
+				task->state = START_TASK_DONE;
+				continue;
+			}
+			
+			// Check if the importing plug-ins have been stopped
+			for (node = list_first(&plugin->importing->list); node != NULL && ready; node = list_next(&plugin->importing->list, node)) {
+				if (((cp_plugin_t *) lnode_get(node))->state >= CP_PLUGIN_STARTING) {
+					ready = 0;
+				}
+			}
+			if (!ready) {
+				continue;
+			}
+			launched = 1;
+			
+			// Queue or execute the stop function
+			assert(plugin->state == CP_PLUGIN_ACTIVE);
+			if (begin_plugin_runtime_stop(context, plugin)) {
+				if (batch->num_workers > 0) {
+					plugin->parallel_start = 1;
+					context->env->num_parallel_starts++;
+					batch->num_running++;
+					task->state = START_TASK_QUEUED;
+					if (batch->queue_tail != NULL) {
+						batch->queue_tail->next_queued = task;
+					} else {
+						batch->queue_head = task;
+					}
+					batch->queue_tail = task;
+					queued = 1;
+					continue;
+				}
+				context->env->in_stop_func_invocation++;
+				call_stop_func(plugin, &plugin->stats.stop_usecs);
+				context->env->in_stop_func_invocation--;
+			}
+			finish_plugin_runtime_stop(context, plugin);
+			task->state = START_TASK_DONE;
+		}
+	} while (launched);
+	
+	// Wake up the worker threads
+	if (queued) {
+		cpi_signal_context(context);
+	}
+}
+
+#ifdef CP_THREADS
+
+/**
+ * Executes queued stop functions until the parallel stop is shut down.
+ *
+ * @param arg the parallel stop
+ */
+static void stop_worker(void *arg) {
+	stop_batch_t *batch = arg;
+	cp_context_t *context = batch->context;
+	
+	cpi_lock_context(context);
+	while (!batch->shutdown) {
+		stop_task_t *task;
+		unsigned long long usecs = 0;
+		
+		// Claim the next queued task
+		if ((task = batch->queue_head) == NULL) {
+			cpi_wait_context(context);
+			continue;
+		}
+		if ((batch->queue_head = task->next_queued) == NULL) {
+			batch->queue_tail = NULL;
+		}
+		task->state = START_TASK_RUNNING;
+		
+		// Execute the stop function without the context lock
+		cpi_unlock_context(context);
+		call_stop_func(task->plugin, &usecs);
+		cpi_lock_context(context);
+		task->plugin->stats.stop_usecs += usecs;
+		task->state = START_TASK_FINISHED;
+		cpi_signal_context(context);
+	}
+	batch->num_workers--;
+	cpi_signal_context(context);
+	cpi_unlock_context(context);
+}
+
+#endif
+
+CP_C_API void cp_stop_plugins_parallel(cp_context_t *context, unsigned int num_threads) {
+	stop_batch_t batch;
+	lnode_t *node;
+#ifdef CP_THREADS
+	cp_task_t **threads = NULL;
+	unsigned int num_started = 0;
+#endif
+	int i;
+	
+	CHECK_NOT_NULL(context);
+	
+	memset(&batch, 0, sizeof(batch));
+	batch.context = context;
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	cpi_wait_parallel_starts(context);
+	do {
+		
+		// Create the tasks in reverse start order
+		if ((batch.tasks = malloc((list_count(&context->env->started_plugins->list) + 1) * sizeof(stop_task_t))) == NULL) {
+			break;
+		}
+		for (node = list_last(&context->env->started_plugins->list); node != NULL; node = list_prev(&context->env->started_plugins->list, node)) {
+			stop_task_t *task = batch.tasks + batch.num_tasks++;
+			
+			memset(task, 0, sizeof(stop_task_t));
+			task->plugin = lnode_get(node);
+			task->state = START_TASK_PENDING;
+		}
+		
+		// Start worker threads for the stop functions
+		if (num_threads > (unsigned int) batch.num_tasks) {
+			num_threads = batch.num_tasks;
+		}
+#ifdef CP_THREADS
+		if (num_threads > 1
+			&& (threads = malloc(num_threads * sizeof(cp_task_t *))) != NULL) {
+			while (num_started < num_threads
+				&& (threads[num_started] = cpi_spawn_task(stop_worker, &batch)) != NULL) {
+				num_started++;
+				batch.num_workers++;
+			}
+		}
+#endif
+
+		// Stop the plug-ins in waves as their importers become stopped
+		launch_stop_tasks(&batch);
+		while (1) {
+			if (batch.num_running > 0) {
+				cpi_wait_context(context);
+				for (i = 0; i < batch.num_tasks; i++) {
+					stop_task_t *task = batch.tasks + i;
+					
+					if (task->state == START_TASK_FINISHED) {
+						task->plugin->parallel_start = 0;
+						context->env->num_parallel_starts--;
+						batch.num_running--;
+						finish_plugin_runtime_stop(context, task->plugin);
+						task->state = START_TASK_DONE;
+					}
+				}
+			} else {
+				
+				// Break dependency loops by stopping the last started plug-in
+				for (i = 0; i < batch.num_tasks && batch.tasks[i].state != START_TASK_PENDING; i++);
+				if (i == batch.num_tasks) {
+					break;
+				}
+				if (batch.tasks[i].plugin->state == CP_PLUGIN_ACTIVE) {
+					stop_plugin(context, batch.tasks[i].plugin);
+				}
+				batch.tasks[i].state = START_TASK_DONE;
+			}
+			launch_stop_tasks(&batch);
+		}
+		
+	} while (0);
+	
+	// Shut down the worker threads
+#ifdef CP_THREADS
+	batch.shutdown = 1;
+	if (batch.num_workers > 0) {
+		cpi_signal_context(context);
+		while (batch.num_workers > 0) {
+			cpi_wait_context(context);
+		}
+	}
+	while (num_started > 0) {
+		cpi_join_task(threads[--num_started]);
+	}
+	free(threads);
+
+	// Wake up threads waiting for the parallel stop to complete
+	cpi_signal_context(context);
+#endif
+
+	// Stop any remaining plug-ins serially
+	while ((node = list_last(&context->env->started_plugins->list)) != NULL) {
 		stop_plugin(context, lnode_get(node));
 	}
 	cpi_unlock_context(context);
+	
+	free(batch.tasks);
 }
 
 static void unresolve_plugin_rec(cp_context_t *context, cp_plugin_t *plugin) {
@@ -1049,26 +3366,26 @@ static void unresolve_plugin_rec(cp_context_t *context, cp_plugin_t *plugin) {
 		return;
 	}
 	assert(plugin->state == CP_PLUGIN_RESOLVED);
+	invalidate_resolve_order(context->env);
 	
 	// Clear the list of imported plug-ins (also breaks dependency loops)
-	while ((node = list_first(plugin->imported)) != NULL) {
+	while ((node = list_first(&plugin->imported->list)) != NULL) {
 		cp_plugin_t *ip = lnode_get(node);
 		
-		cpi_ptrset_remove(ip->importing, plugin);
-		list_delete(plugin->imported, node);
-		lnode_destroy(node);
+		cpi_ptrset_remove(context->env->nodes, ip->importing, plugin);
+		cpi_ptrset_delete_node(plugin->imported, node);
+		cpi_destroy_lnode(context->env->nodes, node);
 	}
-	assert(list_isempty(plugin->imported));
-	list_destroy(plugin->imported);
+	cpi_destroy_ptrset(plugin->imported);
 	plugin->imported = NULL;
 
 	// Unresolve depending plugins
-	while ((node = list_first(plugin->importing)) != NULL) {
+	while ((node = list_first(&plugin->importing->list)) != NULL) {
 		unresolve_plugin_rec(context, lnode_get(node));
 	}
 	
 	// Unresolve this plug-in
-	unresolve_plugin_runtime(plugin);
+	unresolve_plugin_runtime(context, plugin);
 	event.plugin_id = plugin->plugin->identifier;
 	event.old_state = plugin->state;
 	event.new_state = plugin->state = CP_PLUGIN_INSTALLED;
@@ -1086,73 +3403,106 @@ static void unresolve_plugin(cp_context_t *context, cp_plugin_t *plugin) {
 	unresolve_plugin_rec(context, plugin);
 }
 
-static void free_plugin_import_content(cp_plugin_import_t *import) {
-	assert(import != NULL);
-	free(import->plugin_id);
-	free(import->version);
+CP_HIDDEN cp_plugin_info_t *cpi_new_plugin_info(size_t size_hint) {
+	cpi_arena_t *arena;
+	plugin_info_block_t *block;
+	
+	if ((arena = cpi_create_arena(size_hint + sizeof(plugin_info_block_t))) == NULL) {
+		return NULL;
+	}
+	if ((block = cpi_arena_alloc(arena, sizeof(plugin_info_block_t))) == NULL) {
+		cpi_destroy_arena(arena);
+		return NULL;
+	}
+	memset(block, 0, sizeof(plugin_info_block_t));
+	assert(CPI_INFO_HEADER(&(block->info)) == &(block->header));
+	block->arena = arena;
+	return &(block->info);
+}
+
+CP_HIDDEN cpi_arena_t *cpi_plugin_arena(const cp_plugin_info_t *plugin) {
+	assert(plugin != NULL);
+	return ((const plugin_info_block_t *) ((const char *) plugin - offsetof(plugin_info_block_t, info)))->arena;
+}
+
+CP_HIDDEN void cpi_set_plugin_parse_time(cp_plugin_info_t *plugin, unsigned long long usecs) {
+	assert(plugin != NULL);
+	((plugin_info_block_t *) ((char *) plugin - offsetof(plugin_info_block_t, info)))->parse_usecs = usecs;
 }
 
-static void free_ext_point_content(cp_ext_point_t *ext_point) {
-	free(ext_point->name);
-	free(ext_point->local_id);
-	free(ext_point->identifier);
-	free(ext_point->schema_path);
+CP_HIDDEN size_t cpi_plugin_info_size(const cp_plugin_info_t *plugin) {
+	assert(plugin != NULL);
+	return cpi_arena_size(cpi_plugin_arena(plugin));
 }
 
-static void free_extension_content(cp_extension_t *extension) {
-	free(extension->name);
-	free(extension->local_id);
-	free(extension->identifier);
-	free(extension->ext_point_id);
+CP_HIDDEN cpi_lazy_cfg_t *cpi_plugin_lazy_cfg(const cp_plugin_info_t *plugin) {
+	assert(plugin != NULL);
+	return ((const plugin_info_block_t *) ((const char *) plugin - offsetof(plugin_info_block_t, info)))->lazy_cfg;
 }
 
-static void free_cfg_element_content(cp_cfg_element_t *ce) {
-	int i;
+CP_HIDDEN void cpi_set_plugin_lazy_cfg(cp_plugin_info_t *plugin, cpi_lazy_cfg_t *lazy) {
+	assert(plugin != NULL);
+	assert(lazy != NULL);
+	((plugin_info_block_t *) ((char *) plugin - offsetof(plugin_info_block_t, info)))->lazy_cfg = lazy;
+}
+
+CP_HIDDEN void cpi_set_plugin_image(cp_plugin_info_t *plugin, cpi_plugin_image_t *image) {
+	assert(plugin != NULL);
+	assert(image != NULL);
+	((plugin_info_block_t *) ((char *) plugin - offsetof(plugin_info_block_t, info)))->image = image;
+}
 
-	assert(ce != NULL);
-	free(ce->name);
-	if (ce->atts != NULL) {
-		free(ce->atts[0]);
-		free(ce->atts);
+CP_HIDDEN cp_status_t cpi_tokenize_plugin_versions(cp_plugin_info_t *plugin) {
+	plugin_info_block_t *block = (plugin_info_block_t *) ((char *) plugin - offsetof(plugin_info_block_t, info));
+	int i;
+	
+	block->versions_tokenized = 0;
+	if (plugin->version != NULL
+		&& (block->version = cpi_tokenize_version(block->arena, plugin->version)) == NULL) {
+		return CP_ERR_RESOURCE;
 	}
-	free(ce->value);
-	for (i = 0; i < ce->num_children; i++) {
-		free_cfg_element_content(ce->children + i);
+	if (plugin->abi_bw_compatibility != NULL
+		&& (block->abi_bw_compatibility = cpi_tokenize_version(block->arena, plugin->abi_bw_compatibility)) == NULL) {
+		return CP_ERR_RESOURCE;
+	}
+	if (plugin->num_imports > 0) {
+		if ((block->import_versions = cpi_arena_alloc(block->arena, plugin->num_imports * sizeof(cpi_version_t *))) == NULL) {
+			return CP_ERR_RESOURCE;
+		}
+		for (i = 0; i < plugin->num_imports; i++) {
+			block->import_versions[i] = NULL;
+			if (plugin->imports[i].version != NULL
+				&& (block->import_versions[i] = cpi_tokenize_version(block->arena, plugin->imports[i].version)) == NULL) {
+				return CP_ERR_RESOURCE;
+			}
+		}
+	}
+	block->versions_tokenized = 1;
+	return CP_OK;
+}
+
+CP_HIDDEN int cpi_plugin_vercmp(const cp_plugin_info_t *plugin1, const cp_plugin_info_t *plugin2) {
+	const plugin_info_block_t *b1 = (const plugin_info_block_t *) ((const char *) plugin1 - offsetof(plugin_info_block_t, info));
+	const plugin_info_block_t *b2 = (const plugin_info_block_t *) ((const char *) plugin2 - offsetof(plugin_info_block_t, info));
+	
+	if (b1->versions_tokenized && b2->versions_tokenized) {
+		return cpi_vercmp_tokens(b1->version, b2->version);
 	}
-	free(ce->children);
+	return cpi_vercmp(plugin1->version, plugin2->version);
 }
 
 CP_HIDDEN void cpi_free_plugin(cp_plugin_info_t *plugin) {
-	int i;
+	plugin_info_block_t *block;
 	
 	assert(plugin != NULL);
-	free(plugin->name);
-	free(plugin->identifier);
-	free(plugin->version);
-	free(plugin->provider_name);
-	free(plugin->plugin_path);
-	free(plugin->abi_bw_compatibility);
-	free(plugin->api_bw_compatibility);
-	free(plugin->req_cpluff_version);
-	for (i = 0; i < plugin->num_imports; i++) {
-		free_plugin_import_content(plugin->imports + i);
-	}
-	free(plugin->imports);
-	free(plugin->runtime_lib_name);
-	free(plugin->runtime_funcs_symbol);
-	for (i = 0; i < plugin->num_ext_points; i++) {
-		free_ext_point_content(plugin->ext_points + i);
+	block = (plugin_info_block_t *) ((char *) plugin - offsetof(plugin_info_block_t, info));
+	if (block->lazy_cfg != NULL) {
+		cpi_destroy_lazy_cfg(block->lazy_cfg);
 	}
-	free(plugin->ext_points);
-	for (i = 0; i < plugin->num_extensions; i++) {
-		free_extension_content(plugin->extensions + i);
-		if (plugin->extensions[i].configuration != NULL) {
-			free_cfg_element_content(plugin->extensions[i].configuration);
-			free(plugin->extensions[i].configuration);
-		}
+	if (block->image != NULL) {
+		cpi_release_plugin_image(block->image);
 	}
-	free(plugin->extensions);
-	free(plugin);
+	cpi_destroy_arena(block->arena);
 }
 
 /**
@@ -1167,13 +3517,19 @@ static void free_registered_plugin(cp_context_t *context, cp_plugin_t *plugin) {
 
 	// Release plug-in information
 	cpi_release_info(context, plugin->plugin);
+	cpi_disown_infos(context, plugin);
 
 	// Release data structures 
 	if (plugin->importing != NULL) {
-		assert(list_isempty(plugin->importing));
-		list_destroy(plugin->importing);
+		cpi_destroy_ptrset(plugin->importing);
 	}
 	assert(plugin->imported == NULL);
+#ifdef CP_THREADS
+	assert(plugin->num_idle_waiters == 0);
+	if (plugin->idle_cond != NULL) {
+		cpi_destroy_cond(plugin->idle_cond);
+	}
+#endif
 
 	free(plugin);
 }
@@ -1186,6 +3542,7 @@ static void free_registered_plugin(cp_context_t *context, cp_plugin_t *plugin) {
  */
 static void uninstall_plugin(cp_context_t *context, hnode_t *node) {
 	cp_plugin_t *plugin;
+	const char *pid;
 	cpi_plugin_event_t event;
 	
 	// Check if already uninstalled 
@@ -1200,16 +3557,21 @@ static void uninstall_plugin(cp_context_t *context, hnode_t *node) {
 	assert(plugin->state == CP_PLUGIN_INSTALLED);
 
 	// Plug-in uninstalled 
+	invalidate_resolve_order(context->env);
 	event.plugin_id = plugin->plugin->identifier;
 	event.old_state = plugin->state;
 	event.new_state = plugin->state = CP_PLUGIN_UNINSTALLED;
 	cpi_deliver_event(context, &event);
+	cpi_detach_plugin_handle(context, plugin);
 	
 	// Unregister extension objects
-	unregister_extensions(context, plugin->plugin);
+	unregister_extensions(context, plugin);
 
 	// Unregister the plug-in 
+	pid = hnode_getkey(node);
 	hash_delete_free(context->env->plugins, node);
+	cpi_release_string(context->env->strings, pid);
+	cpi_record_plugin_changes(context, plugin->plugin);
 	
 	// If the plug-in was loaded using loaders, remove it from loader maps
 	if (plugin->loader != NULL) {
@@ -1237,6 +3599,7 @@ CP_C_API cp_status_t cp_uninstall_plugin(cp_context_t *context, const char *id)
 	// Look up and unload the plug-in 
 	cpi_lock_context(context);
 	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	cpi_wait_parallel_starts(context);
 	node = hash_lookup(context->env->plugins, id);
 	if (node != NULL) {
 		uninstall_plugin(context, node);
@@ -1258,6 +3621,7 @@ CP_C_API void cp_uninstall_plugins(cp_context_t *context) {
 	
 	cpi_lock_context(context);
 	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	cpi_wait_parallel_starts(context);
 	cp_stop_plugins(context);
 	while (1) {
 		hash_scan_begin(&scan, context->env->plugins);
@@ -34,13 +34,18 @@
 #include <string.h>
 #include <assert.h>
 #include <stdarg.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #include <expat.h>
 #include "cpluff.h"
 #include "defines.h"
 #include "util.h"
 #include "internal.h"
+#include "trace.h"
 
 // Use XMLCALL if available
 #ifdef XMLCALL
@@ -49,6 +54,11 @@
 #define CP_XMLCALL
 #endif
 
+// Map plug-in descriptor files into memory if possible
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H) && defined(HAVE_STAT)
+#define CP_MMAP_DESCRIPTORS
+#endif
+
 
 /* ------------------------------------------------------------------------
  * Constants
@@ -60,6 +70,9 @@
 /// Initial configuration element value size 
 #define CP_CFG_ELEMENT_VALUE_INITSIZE 64
 
+/// Maximum number of idle descriptor parsers kept for reuse
+#define CP_MAX_IDLE_PARSERS 8
+
 
 /* ------------------------------------------------------------------------
  * Internal data types
@@ -78,11 +91,60 @@ typedef enum parser_state_t {
 	PARSER_ERROR
 } parser_state_t;
 
+/// Location of a lazily parsed extension in the descriptor file
+typedef struct lazy_span_t {
+	
+	/// Byte offset of the extension element
+	long offset;
+	
+	/// Length of the extension element, in bytes
+	long length;
+	
+	/// The status of a failed materialization or CP_OK
+	cp_status_t status;
+} lazy_span_t;
+
+/// Information needed to parse lazily parsed extension configuration
+struct cpi_lazy_cfg_t {
+
+#ifdef CP_THREADS
+
+	/// Mutex serializing the parsing of the configuration
+	cpi_mutex_t *mutex;
+
+#endif
+
+	/// The plug-in descriptor file
+	char *file;
+	
+	/// The declared encoding of the descriptor, or NULL if none
+	char *encoding;
+
+#ifdef HAVE_STAT
+
+	/// The size of the descriptor when it was parsed
+	off_t size;
+	
+	/// The modification time of the descriptor when it was parsed
+	time_t mtime;
+
+#endif
+
+	/// The locations of the extensions, in the order of the extensions
+	lazy_span_t *spans;
+};
+
 /// Plug-in loader context 
 struct ploader_context_t {
 
-	/// The plug-in context, or NULL if none
+	/// The plug-in context, or NULL if parsing lazily parsed configuration
 	cp_context_t *context;
+	
+	/// The plug-in descriptor root element
+	const char *root_element;
+
+	/// The deferred message log, or NULL to log messages immediately
+	list_t *log;
 
 	/// The XML parser being used 
 	XML_Parser parser;
@@ -92,6 +154,12 @@ struct ploader_context_t {
 	
 	/// The plug-in being constructed 
 	cp_plugin_info_t *plugin;
+
+	/// The arena holding the plug-in being constructed
+	cpi_arena_t *arena;
+
+	/// Interned configuration element and attribute names, or NULL if none
+	hash_t *names;
 	
 	/// The configuration element being constructed 
 	cp_cfg_element_t *configuration;
@@ -110,13 +178,13 @@ struct ploader_context_t {
 	/// The number of skipped configuration elements 
 	unsigned int skippedCEs;
 
-	/// Size of allocated imports table 
+	/// Size of allocated imports table, or zero if not in heap memory
 	size_t imports_size;
 	
-	/// Size of allocated extension points table 
+	/// Size of allocated extension points table, or zero if not in heap memory
 	size_t ext_points_size;
 	
-	/// Size of allocated extensions table 
+	/// Size of allocated extensions table, or zero if not in heap memory
 	size_t extensions_size;
 	
 	/// Buffer for a value being read 
@@ -128,13 +196,45 @@ struct ploader_context_t {
 	/// Current length of value string 
 	size_t value_length;
 	
+	/// Whether to record extension locations instead of configuration
+	int lazy;
+	
+	/// Locations of the extensions when parsing lazily
+	lazy_span_t *spans;
+	
+	/// Size of allocated locations table, or zero if not in heap memory
+	size_t spans_size;
+	
+	/// Location of the extension being parsed lazily, or NULL if none
+	lazy_span_t *span;
+	
+	/// The declared encoding of the descriptor, or NULL if none
+	char *encoding;
+	
+	/// The extension whose configuration is being parsed, or NULL if none
+	cp_extension_t *lazy_target;
+	
+	/// The configuration of the extension being parsed, or NULL if none
+	cp_cfg_element_t *lazy_cfg;
+	
 	/// The number of parsing errors that have occurred 
 	unsigned int error_count;
 	
 	/// The number of resource errors that have occurred 
 	unsigned int resource_error_count;
+	
+	/// The next idle parser while this parser is idle
+	ploader_context_t *next_idle;
 };
 
+#ifdef CP_THREADS
+#define lock_parsers(env) cpi_lock_mutex((env)->parsers_mutex)
+#define unlock_parsers(env) cpi_unlock_mutex((env)->parsers_mutex)
+#else
+#define lock_parsers(env) do {} while (0)
+#define unlock_parsers(env) do {} while (0)
+#endif
+
 
 /* ------------------------------------------------------------------------
  * Function definitions
@@ -154,24 +254,27 @@ static void descriptor_errorf(ploader_context_t *plcontext, int warn,
 	va_list ap;
 	char message[128];
 
-	va_start(ap, error_msg);
-	vsnprintf(message, sizeof(message), error_msg, ap);
-	va_end(ap);
-	message[127] = '\0';
-	if (warn) {
-		cpi_warnf(plcontext->context,
-			N_("Suspicious plug-in descriptor content in %s, line %d, column %d (%s)."),
-		plcontext->file,
-		(int) XML_GetCurrentLineNumber(plcontext->parser),
-		(int) (XML_GetCurrentColumnNumber(plcontext->parser) + 1),
-		message);
-	} else {				
-		cpi_errorf(plcontext->context,
-			N_("Invalid plug-in descriptor content in %s, line %d, column %d (%s)."),
-			plcontext->file,
-			(int) XML_GetCurrentLineNumber(plcontext->parser),
-			(int) (XML_GetCurrentColumnNumber(plcontext->parser) + 1),
-			message);
+	// Lazily parsed configuration is parsed without logging
+	if (plcontext->context != NULL) {
+		va_start(ap, error_msg);
+		vsnprintf(message, sizeof(message), error_msg, ap);
+		va_end(ap);
+		message[127] = '\0';
+		if (warn) {
+			cpi_logf_deferred(plcontext->context, plcontext->log, CP_LOG_WARNING,
+				N_("Suspicious plug-in descriptor content in %s, line %d, column %d (%s)."),
+				plcontext->file,
+				(int) XML_GetCurrentLineNumber(plcontext->parser),
+				(int) (XML_GetCurrentColumnNumber(plcontext->parser) + 1),
+				message);
+		} else {				
+			cpi_logf_deferred(plcontext->context, plcontext->log, CP_LOG_ERROR,
+				N_("Invalid plug-in descriptor content in %s, line %d, column %d (%s)."),
+				plcontext->file,
+				(int) XML_GetCurrentLineNumber(plcontext->parser),
+				(int) (XML_GetCurrentColumnNumber(plcontext->parser) + 1),
+				message);
+		}
 	}
 	if (!warn) {
 		plcontext->error_count++;
@@ -185,8 +288,8 @@ static void descriptor_errorf(ploader_context_t *plcontext, int warn,
  * @param context the parsing context
  */
 static void resource_error(ploader_context_t *plcontext) {
-	if (plcontext->resource_error_count == 0) {
-		cpi_errorf(plcontext->context,
+	if (plcontext->resource_error_count == 0 && plcontext->context != NULL) {
+		cpi_logf_deferred(plcontext->context, plcontext->log, CP_LOG_ERROR,
 			N_("Insufficient system resources to parse plug-in descriptor content in %s, line %d, column %d."),
 			plcontext->file,
 			(int) XML_GetCurrentLineNumber(plcontext->parser),
@@ -290,8 +393,8 @@ static int check_attributes(ploader_context_t *plcontext,
 }
 
 /**
- * Allocates memory using malloc. Reports a resource error if there is not
- * enough available memory.
+ * Allocates memory from the arena of the plug-in being constructed.
+ * Reports a resource error if there is not enough available memory.
  * 
  * @param context the parsing context
  * @param size the number of bytes to allocate
@@ -300,35 +403,150 @@ static int check_attributes(ploader_context_t *plcontext,
 static void *parser_malloc(ploader_context_t *plcontext, size_t size) {
 	void *ptr;
 
-	if ((ptr = malloc(size)) == NULL) {
+	if ((ptr = cpi_arena_alloc(plcontext->arena, size)) == NULL) {
 		resource_error(plcontext);
 	}
 	return ptr;
 }
 
 /**
- * Makes a copy of the specified string. The memory is allocated using malloc.
+ * Copies the specified data to the arena of the plug-in being constructed.
  * Reports a resource error if there is not enough available memory.
  * 
  * @param context the parsing context
+ * @param src the data to be copied
+ * @param size the number of bytes to copy
+ * @return copy of the data, or NULL if memory allocation failed
+ */
+static void *parser_memdup(ploader_context_t *plcontext, const void *src, size_t size) {
+	void *dup;
+
+	if ((dup = cpi_arena_memdup(plcontext->arena, src, size)) == NULL) {
+		resource_error(plcontext);
+	}
+	return dup;
+}
+
+/**
+ * Makes a copy of the specified string. The memory is allocated from the
+ * arena of the plug-in being constructed. Reports a resource error if there
+ * is not enough available memory.
+ * 
+ * @param context the parsing context
  * @param src the source string to be copied
  * @return copy of the string, or NULL if memory allocation failed
  */
 static char *parser_strdup(ploader_context_t *plcontext, const char *src) {
-	char *dup;
+	return parser_memdup(plcontext, src, (strlen(src) + 1) * sizeof(char));
+}
 
-	if ((dup = strdup(src)) == NULL) {
+/**
+ * Returns a shared copy of a configuration element or attribute name.
+ * Each distinct name is stored only once in the arena of the plug-in being
+ * constructed. Reports a resource error if there is not enough available
+ * memory.
+ * 
+ * @param context the parsing context
+ * @param name the name
+ * @return the shared copy of the name, or NULL if memory allocation failed
+ */
+static char *parser_intern(ploader_context_t *plcontext, const char *name) {
+	hnode_t *node;
+	char *dup;
+	
+	if (plcontext->names == NULL
+		&& (plcontext->names = hash_create(HASHCOUNT_T_MAX,
+			(int (*)(const void *, const void *)) strcmp, NULL)) == NULL) {
+		resource_error(plcontext);
+		return NULL;
+	}
+	if ((node = hash_lookup(plcontext->names, name)) != NULL) {
+		return hnode_get(node);
+	}
+	if ((dup = parser_strdup(plcontext, name)) != NULL
+		&& !hash_alloc_insert(plcontext->names, dup, dup)) {
 		resource_error(plcontext);
 	}
 	return dup;
 }
 
 /**
- * Concatenates the specified strings into a new string. The memory for the concatenated
- * string is allocated using malloc. Reports a resource error if there is not
+ * Makes room for at least one more element in an array being constructed.
+ * Arrays being constructed are kept in heap memory until they are moved to
+ * the arena using ::parser_finish_array. An array already moved to the arena
+ * is copied back to heap memory. Reports a resource error if there is not
  * enough available memory.
  * 
  * @param context the parsing context
+ * @param array the array
+ * @param num the number of elements in the array
+ * @param size pointer to the allocated size of the array, in elements, or
+ * 			zero if the array is not in heap memory
+ * @param init_size the initial allocated size, in elements
+ * @param elem_size the size of an element
+ * @return the possibly relocated array, or NULL if memory allocation failed
+ */
+static void *parser_grow_array(ploader_context_t *plcontext, void *array,
+	size_t num, size_t *size, size_t init_size, size_t elem_size) {
+	void *na;
+	size_t ns;
+	
+	if (num < *size) {
+		return array;
+	}
+	ns = (*size == 0 ? init_size : *size * 2);
+	while (ns <= num) {
+		ns *= 2;
+	}
+	if (*size > 0) {
+		na = realloc(array, ns * elem_size);
+	} else if ((na = malloc(ns * elem_size)) != NULL && num > 0) {
+		memcpy(na, array, num * elem_size);
+	}
+	if (na == NULL) {
+		resource_error(plcontext);
+		return NULL;
+	}
+	*size = ns;
+	return na;
+}
+
+/**
+ * Moves an array constructed in heap memory to the arena of the plug-in
+ * being constructed. Does nothing if the array is not in heap memory.
+ * If memory allocation fails then the array is left in heap memory
+ * to be freed with the parsing context and a resource error is reported.
+ * 
+ * @param context the parsing context
+ * @param array the array
+ * @param num the number of elements in the array
+ * @param size pointer to the allocated size of the array, in elements, or
+ * 			zero if the array is not in heap memory
+ * @param elem_size the size of an element
+ * @return the relocated array
+ */
+static void *parser_finish_array(ploader_context_t *plcontext, void *array,
+	size_t num, size_t *size, size_t elem_size) {
+	void *na = NULL;
+	
+	if (*size == 0) {
+		return array;
+	}
+	if (num > 0 && (na = parser_memdup(plcontext, array, num * elem_size)) == NULL) {
+		return array;
+	}
+	free(array);
+	*size = 0;
+	return na;
+}
+
+/**
+ * Concatenates the specified strings into a new string. The memory for the
+ * concatenated string is allocated from the arena of the plug-in being
+ * constructed. Reports a resource error if there is not enough available
+ * memory.
+ * 
+ * @param context the parsing context
  * @param ... the strings to be concatenated, terminated by NULL
  * @return the concatenated string, or NULL if memory allocation failed
  */
@@ -378,8 +596,8 @@ static void unexpected_element(ploader_context_t *plcontext, const XML_Char *ele
 }
 
 /**
- * Creates a copy of the specified attributes. Reports failed memory
- * allocation.
+ * Creates a copy of the specified attributes. Attribute names are shared
+ * using ::parser_intern. Reports failed memory allocation.
  * 
  * @param context the parser context
  * @param src the source attributes to be copied
@@ -396,34 +614,40 @@ static char **parser_attsdup(ploader_context_t *plcontext, const XML_Char * cons
 	
 	// Calculate the number of attributes and the amount of space required 
 	for (num = 0, attr_size = 0; src[num] != NULL; num++) {
-		attr_size += strlen(src[num]) + 1;
+		if (num & 1) {
+			attr_size += strlen(src[num]) + 1;
+		}
 	}
 	assert((num & 1) == 0);
 	
 	// Allocate necessary memory and copy attribute data 
 	if (num > 0) {
-		if ((atts = parser_malloc(plcontext, num * sizeof(char *))) != NULL) {
+		if ((atts = cpi_alloc_cfg_atts(plcontext->arena, num / 2)) == NULL) {
+			resource_error(plcontext);
+		} else {
 			if ((attr_data = parser_malloc(plcontext, attr_size * sizeof(char))) != NULL) {
 				size_t offset;
 			
-				for (i = 0, offset = 0; i < num; i++) {
-					strcpy(attr_data + offset, src[i]);
-					atts[i] = attr_data + offset;
-					offset += strlen(src[i]) + 1;
+				for (i = 0, offset = 0; i < num && attr_data != NULL; i += 2) {
+					if ((atts[i] = parser_intern(plcontext, src[i])) == NULL) {
+						attr_data = NULL;
+						break;
+					}
+					strcpy(attr_data + offset, src[i + 1]);
+					atts[i + 1] = attr_data + offset;
+					offset += strlen(src[i + 1]) + 1;
 				}
 			}
 		}
 	}
 	
-	// If successful then return duplicates, otherwise free any allocations 
+	// If successful then return duplicates 
 	if (num == 0 || (atts != NULL && attr_data != NULL)) {
 		if (num_atts != NULL) {
 			*num_atts = num / 2;
 		}
 		return atts;
 	} else {
-		free(attr_data);
-		free(atts);
 		return NULL;
 	}
 }
@@ -442,7 +666,7 @@ static void init_cfg_element(ploader_context_t *plcontext, cp_cfg_element_t *ce,
 	
 	// Initialize the configuration element 
 	memset(ce, 0, sizeof(cp_cfg_element_t));
-	ce->name = parser_strdup(plcontext, name);
+	ce->name = parser_intern(plcontext, name);
 	ce->atts = parser_attsdup(plcontext, atts, &(ce->num_atts));
 	ce->value = NULL;
 	plcontext->value = NULL;
@@ -522,7 +746,7 @@ static void CP_XMLCALL start_element_handler(
 	static const XML_Char * const opt_bwcompatibility_atts[] = { "abi", "api", NULL };
 	static const XML_Char * const req_cpluff_atts[] = { "version", NULL };
 	static const XML_Char * const opt_cpluff_atts[] = { NULL };
-	const XML_Char * const req_import_atts[] = { plcontext->context->env->plugin_descriptor_root_element, NULL };
+	const XML_Char * const req_import_atts[] = { plcontext->root_element, NULL };
 	static const XML_Char * const opt_import_atts[] = { "version", "optional", NULL };
 	static const XML_Char * const req_runtime_atts[] = { "library", NULL };
 	static const XML_Char * const opt_runtime_atts[] = { "funcs", NULL };
@@ -536,7 +760,7 @@ static void CP_XMLCALL start_element_handler(
 	switch (plcontext->state) {
 
 		case PARSER_BEGIN:
-			if (!strcmp(name, plcontext->context->env->plugin_descriptor_root_element)) {
+			if (!strcmp(name, plcontext->root_element)) {
 				plcontext->state = PARSER_PLUGIN;
 				if (!check_attributes(plcontext, name, atts,
 						req_plugin_atts, opt_plugin_atts)) {
@@ -595,22 +819,15 @@ static void CP_XMLCALL start_element_handler(
 					cp_ext_point_t *ext_point;
 					
 					// Allocate space for extension points, if necessary 
-					if (plcontext->plugin->num_ext_points == plcontext->ext_points_size) {
+					if (plcontext->plugin->num_ext_points >= plcontext->ext_points_size) {
 						cp_ext_point_t *nep;
-						size_t ns;
 						
-						if (plcontext->ext_points_size == 0) {
-							ns = 4;
-						} else {
-							ns = plcontext->ext_points_size * 2;
-						}
-						if ((nep = realloc(plcontext->plugin->ext_points,
-								ns * sizeof(cp_ext_point_t))) == NULL) {
-							resource_error(plcontext);
+						if ((nep = parser_grow_array(plcontext, plcontext->plugin->ext_points,
+								plcontext->plugin->num_ext_points, &(plcontext->ext_points_size),
+								4, sizeof(cp_ext_point_t))) == NULL) {
 							break;
 						}
 						plcontext->plugin->ext_points = nep;
-						plcontext->ext_points_size = ns;
 					}
 					
 					// Parse extension point specification 
@@ -643,27 +860,39 @@ static void CP_XMLCALL start_element_handler(
 			} else if (!(strcmp(name, "extension"))) {
 				plcontext->state = PARSER_EXTENSION;
 				plcontext->depth = 0;
-				if (check_req_attributes(
+				if (plcontext->lazy_target != NULL) {
+					
+					// Parse the configuration of a lazily parsed extension
+					if ((plcontext->configuration = plcontext->lazy_cfg
+						= parser_malloc(plcontext, sizeof(cp_cfg_element_t))) != NULL) {
+						init_cfg_element(plcontext, plcontext->configuration, name, atts, NULL);
+					}
+					XML_SetCharacterDataHandler(plcontext->parser, character_data_handler);
+				} else if (check_req_attributes(
 					plcontext, name, atts, req_extension_atts)) {
 					cp_extension_t *extension;
 				
 					// Allocate space for extensions, if necessary 
-					if (plcontext->plugin->num_extensions == plcontext->extensions_size) {
+					if (plcontext->plugin->num_extensions >= plcontext->extensions_size) {
 						cp_extension_t *ne;
-						size_t ns;
 						
-						if (plcontext->extensions_size == 0) {
-							ns = 16;
-						} else {
-							ns = plcontext->extensions_size * 2;
-						}
-						if ((ne = realloc(plcontext->plugin->extensions,
-								ns * sizeof(cp_extension_t))) == NULL) {
-							resource_error(plcontext);
+						if ((ne = parser_grow_array(plcontext, plcontext->plugin->extensions,
+								plcontext->plugin->num_extensions, &(plcontext->extensions_size),
+								16, sizeof(cp_extension_t))) == NULL) {
 							break;
 						}
 						plcontext->plugin->extensions = ne;
-						plcontext->extensions_size = ns;
+					}
+					if (plcontext->lazy
+						&& plcontext->plugin->num_extensions >= plcontext->spans_size) {
+						lazy_span_t *ns;
+						
+						if ((ns = parser_grow_array(plcontext, plcontext->spans,
+								plcontext->plugin->num_extensions, &(plcontext->spans_size),
+								16, sizeof(lazy_span_t))) == NULL) {
+							break;
+						}
+						plcontext->spans = ns;
 					}
 					
 					// Parse extension attributes 
@@ -693,6 +922,15 @@ static void CP_XMLCALL start_element_handler(
 					}
 					plcontext->plugin->num_extensions++;
 					
+					// Only record the location when parsing lazily
+					if (plcontext->lazy) {
+						plcontext->span = plcontext->spans + plcontext->plugin->num_extensions - 1;
+						plcontext->span->offset = (long) XML_GetCurrentByteIndex(plcontext->parser);
+						plcontext->span->length = XML_GetCurrentByteCount(plcontext->parser);
+						plcontext->span->status = CP_OK;
+						break;
+					}
+					
 					// Initialize configuration parsing 
 					if ((extension->configuration = plcontext->configuration
 						= parser_malloc(plcontext, sizeof(cp_cfg_element_t))) != NULL) {
@@ -721,22 +959,15 @@ static void CP_XMLCALL start_element_handler(
 					cp_plugin_import_t *import = NULL;
 				
 					// Allocate space for imports, if necessary 
-					if (plcontext->plugin->num_imports == plcontext->imports_size) {
+					if (plcontext->plugin->num_imports >= plcontext->imports_size) {
 						cp_plugin_import_t *ni;
-						size_t ns;
 					
-						if (plcontext->imports_size == 0) {
-							ns = 16;
-						} else {
-							ns = plcontext->imports_size * 2;
-						}
-						if ((ni = realloc(plcontext->plugin->imports,
-								ns * sizeof(cp_plugin_import_t))) == NULL) {
-							resource_error(plcontext);
+						if ((ni = parser_grow_array(plcontext, plcontext->plugin->imports,
+								plcontext->plugin->num_imports, &(plcontext->imports_size),
+								16, sizeof(cp_plugin_import_t))) == NULL) {
 							break;
 						}
 						plcontext->plugin->imports = ni;
-						plcontext->imports_size = ns;
 					}
 				
 					// Parse import specification 
@@ -829,33 +1060,18 @@ static void CP_XMLCALL end_element_handler(
 	switch (plcontext->state) {
 
 		case PARSER_PLUGIN:
-			if (!strcmp(name, plcontext->context->env->plugin_descriptor_root_element)) {
+			if (!strcmp(name, plcontext->root_element)) {
 				
-				// Readjust memory allocated for extension points, if necessary 
-				if (plcontext->ext_points_size != plcontext->plugin->num_ext_points) {
-					cp_ext_point_t *nep;
-					
-					if ((nep = realloc(plcontext->plugin->ext_points,
-							plcontext->plugin->num_ext_points *
-								sizeof(cp_ext_point_t))) != NULL
-						|| plcontext->plugin->num_ext_points == 0) {
-						plcontext->plugin->ext_points = nep;
-						plcontext->ext_points_size = plcontext->plugin->num_ext_points;
-					}
-				}
-				
-				// Readjust memory allocated for extensions, if necessary 
-				if (plcontext->extensions_size != plcontext->plugin->num_extensions) {
-					cp_extension_t *ne;
-					
-					if ((ne = realloc(plcontext->plugin->extensions,
-							plcontext->plugin->num_extensions *
-								sizeof(cp_extension_t))) != NULL
-						|| plcontext->plugin->num_extensions == 0) {
-						plcontext->plugin->extensions = ne;
-						plcontext->extensions_size = plcontext->plugin->num_extensions;
-					}					
-				}
+				// Move extension points and extensions to the arena
+				plcontext->plugin->ext_points = parser_finish_array(plcontext,
+					plcontext->plugin->ext_points, plcontext->plugin->num_ext_points,
+					&(plcontext->ext_points_size), sizeof(cp_ext_point_t));
+				plcontext->plugin->extensions = parser_finish_array(plcontext,
+					plcontext->plugin->extensions, plcontext->plugin->num_extensions,
+					&(plcontext->extensions_size), sizeof(cp_extension_t));
+				plcontext->spans = parser_finish_array(plcontext,
+					plcontext->spans, plcontext->plugin->num_extensions,
+					&(plcontext->spans_size), sizeof(lazy_span_t));
 				
 				plcontext->state = PARSER_END;
 			}
@@ -864,18 +1080,10 @@ static void CP_XMLCALL end_element_handler(
 		case PARSER_REQUIRES:
 			if (!strcmp(name, "requires")) {
 				
-				// Readjust memory allocated for imports, if necessary 
-				if (plcontext->imports_size != plcontext->plugin->num_imports) {
-					cp_plugin_import_t *ni;
-					
-					if ((ni = realloc(plcontext->plugin->imports,
-							plcontext->plugin->num_imports *
-								sizeof(cp_plugin_import_t))) != NULL
-						|| plcontext->plugin->num_imports == 0) {
-						plcontext->plugin->imports = ni;
-						plcontext->imports_size = plcontext->plugin->num_imports;
-					}
-				}
+				// Move imports to the arena 
+				plcontext->plugin->imports = parser_finish_array(plcontext,
+					plcontext->plugin->imports, plcontext->plugin->num_imports,
+					&(plcontext->imports_size), sizeof(cp_plugin_import_t));
 				
 				plcontext->state = PARSER_PLUGIN;
 			}
@@ -892,17 +1100,31 @@ static void CP_XMLCALL end_element_handler(
 				plcontext->skippedCEs--;
 			} else if (plcontext->configuration != NULL) {
 				
-				// Readjust memory allocated for children, if necessary 
-				if (plcontext->configuration->index != plcontext->configuration->num_children) {
+				// Move children to the arena 
+				if (plcontext->configuration->children != NULL) {
+					cp_cfg_element_t *ce = plcontext->configuration;
 					cp_cfg_element_t *nce;
+					unsigned int i, j;
 					
-					if ((nce = realloc(plcontext->configuration->children,
-							plcontext->configuration->num_children *
-								sizeof(cp_cfg_element_t))) != NULL
-						|| plcontext->configuration->num_children == 0) {
-						plcontext->configuration->children = nce;
+					if ((nce = cpi_alloc_cfg_children(plcontext->arena, ce->num_children)) != NULL) {
+						memcpy(nce, ce->children, ce->num_children * sizeof(cp_cfg_element_t));
+					} else {
+						resource_error(plcontext);
+					}
+					free(ce->children);
+					ce->children = nce;
+					if (nce == NULL) {
+						ce->num_children = 0;
+					}
+					
+					// Grandchildren still point to the old locations 
+					for (i = 0; i < ce->num_children; i++) {
+						for (j = 0; j < nce[i].num_children; j++) {
+							nce[i].children[j].parent = nce + i;
+						}
 					}
 				}
+				cpi_index_cfg_element(plcontext->arena, plcontext->configuration);
 				
 				if (plcontext->configuration->parent != NULL) {
 					plcontext->configuration->index = plcontext->configuration->parent->num_children - 1;
@@ -928,19 +1150,14 @@ static void CP_XMLCALL end_element_handler(
 						plcontext->value_length = i + 1;
 					}
 				}
+				plcontext->configuration->value = NULL;
 				if (plcontext->value != NULL) {
 					
-					// Readjust memory allocated for value, if necessary 
-					if (plcontext->value_size > plcontext->value_length + 1) {
-						char *nv;
-						
-						if ((nv = realloc(plcontext->value, (plcontext->value_length + 1) * sizeof(char))) != NULL) {
-							plcontext->value = nv;
-						}
-					}
-					
+					// Move value to the arena 
 					plcontext->value[plcontext->value_length] = '\0';
-					plcontext->configuration->value = plcontext->value;
+					plcontext->configuration->value = parser_memdup(plcontext,
+						plcontext->value, (plcontext->value_length + 1) * sizeof(char));
+					free(plcontext->value);
 					plcontext->value = NULL;
 					plcontext->value_size = 0;
 					plcontext->value_length = 0;
@@ -963,6 +1180,17 @@ static void CP_XMLCALL end_element_handler(
 				assert(!strcmp(name, "extension"));
 				plcontext->state = PARSER_PLUGIN;
 				XML_SetCharacterDataHandler(plcontext->parser, NULL);
+				
+				// Record the end of a lazily parsed extension
+				if (plcontext->span != NULL) {
+					long end = (long) XML_GetCurrentByteIndex(plcontext->parser)
+						+ XML_GetCurrentByteCount(plcontext->parser);
+					
+					if (end > plcontext->span->offset + plcontext->span->length) {
+						plcontext->span->length = end - plcontext->span->offset;
+					}
+					plcontext->span = NULL;
+				}
 			}
 			break;
 			
@@ -977,34 +1205,101 @@ static void dealloc_plugin_info(cp_context_t *ctx, cp_plugin_info_t *plugin) {
 	cpi_free_plugin(plugin);
 }
 
-static cp_status_t init_descriptor_parsing(cp_context_t *context, ploader_context_t **plcontextptr, XML_Parser *parserptr, char *file) {
-	XML_Parser parser;
+/**
+ * Releases a parsing context and its XML parser, keeping them for reuse
+ * unless there are enough idle parsers already. The interned names must
+ * have been removed and other scratch data released.
+ * 
+ * @param env the plug-in environment
+ * @param plcontext the parsing context
+ */
+static void release_parser(cp_plugin_env_t *env, ploader_context_t *plcontext) {
+	int kept = 0;
+	
+	if (plcontext->parser != NULL) {
+		lock_parsers(env);
+		if (env->num_idle_parsers < CP_MAX_IDLE_PARSERS) {
+			plcontext->next_idle = env->idle_parsers;
+			env->idle_parsers = plcontext;
+			env->num_idle_parsers++;
+			kept = 1;
+		}
+		unlock_parsers(env);
+	}
+	if (!kept) {
+		if (plcontext->parser != NULL) {
+			XML_ParserFree(plcontext->parser);
+		}
+		if (plcontext->names != NULL) {
+			hash_destroy(plcontext->names);
+		}
+		free(plcontext);
+	}
+}
+
+CP_HIDDEN void cpi_free_idle_parsers(cp_plugin_env_t *env) {
+	ploader_context_t *plcontext;
+	
+	while ((plcontext = env->idle_parsers) != NULL) {
+		env->idle_parsers = plcontext->next_idle;
+		XML_ParserFree(plcontext->parser);
+		if (plcontext->names != NULL) {
+			hash_destroy(plcontext->names);
+		}
+		free(plcontext);
+	}
+	env->num_idle_parsers = 0;
+}
+
+static cp_status_t init_descriptor_parsing(cp_context_t *context, list_t *log, ploader_context_t **plcontextptr, XML_Parser *parserptr, char *file) {
+	cp_plugin_env_t *env = context->env;
+	XML_Parser parser = NULL;
 	ploader_context_t *plcontext;
+	hash_t *names = NULL;
+
+	// Reuse an idle parser, if any, to avoid constructing a new one
+	lock_parsers(env);
+	if ((plcontext = env->idle_parsers) != NULL) {
+		env->idle_parsers = plcontext->next_idle;
+		env->num_idle_parsers--;
+	}
+	unlock_parsers(env);
+	if (plcontext != NULL) {
+		parser = plcontext->parser;
+		names = plcontext->names;
+		if (!XML_ParserReset(parser, NULL)) {
+			XML_ParserFree(parser);
+			parser = NULL;
+		}
+	} else if ((plcontext = malloc(sizeof(ploader_context_t))) == NULL) {
+		return CP_ERR_RESOURCE;
+	}
+	*plcontextptr = plcontext;
+	memset(plcontext, 0, sizeof(ploader_context_t));
+	plcontext->names = names;
 
 	// Initialize the XML parsing 
-	*parserptr = parser = XML_ParserCreate(NULL);
-	if (parser == NULL) {
+	if (parser == NULL && (parser = XML_ParserCreate(NULL)) == NULL) {
 		return CP_ERR_RESOURCE;
 	}
+	*parserptr = parser;
 	XML_SetElementHandler(parser,
 		start_element_handler,
 		end_element_handler);
 		
 	// Initialize the parsing context 
-	if ((*plcontextptr = plcontext = malloc(sizeof(ploader_context_t))) == NULL) {
-		return CP_ERR_RESOURCE;
-	}
-	memset(plcontext, 0, sizeof(ploader_context_t));
-	if ((plcontext->plugin = malloc(sizeof(cp_plugin_info_t))) == NULL) {
+	if ((plcontext->plugin = cpi_new_plugin_info(CP_XML_PARSER_BUFFER_SIZE)) == NULL) {
 		return CP_ERR_RESOURCE;
 	}
+	plcontext->arena = cpi_plugin_arena(plcontext->plugin);
 	plcontext->context = context;
+	plcontext->root_element = context->env->plugin_descriptor_root_element;
+	plcontext->log = log;
 	plcontext->configuration = NULL;
 	plcontext->value = NULL;
 	plcontext->parser = parser;
 	plcontext->file = file;
 	plcontext->state = PARSER_BEGIN;
-	memset(plcontext->plugin, 0, sizeof(cp_plugin_info_t));
 	plcontext->plugin->name = NULL;
 	plcontext->plugin->identifier = NULL;
 	plcontext->plugin->version = NULL;
@@ -1023,20 +1318,36 @@ static cp_status_t init_descriptor_parsing(cp_context_t *context, ploader_contex
 	return CP_OK;
 }
 
-static cp_status_t do_descriptor_parsing(XML_Parser parser, cp_context_t *context, ploader_context_t *plcontext, char *file, unsigned int buffer_len) {
+/**
+ * Parses descriptor data. The data is either in the buffer obtained from
+ * the parser using XML_GetBuffer or in the specified caller buffer which
+ * is then parsed in place without copying it first.
+ * 
+ * @param parser the XML parser
+ * @param context the plug-in context
+ * @param plcontext the parsing context
+ * @param file the file being parsed
+ * @param buffer the data to be parsed or NULL if in the parser buffer
+ * @param buffer_len the length of the data
+ * @param final whether this is the last data
+ * @return @ref CP_OK (zero) on success or CP_ERR_MALFORMED on failure
+ */
+static cp_status_t do_descriptor_parsing(XML_Parser parser, cp_context_t *context, ploader_context_t *plcontext, char *file, const char *buffer, unsigned int buffer_len, int final) {
 	int i;
 
 	// Parse the data 
-	if (!(i = XML_ParseBuffer(parser, buffer_len, buffer_len == 0))
-		&& context != NULL) {
-		cpi_lock_context(context);
-		cpi_errorf(context,
+	if (buffer != NULL) {
+		i = XML_Parse(parser, buffer, buffer_len, final);
+	} else {
+		i = XML_ParseBuffer(parser, buffer_len, final);
+	}
+	if (!i && context != NULL) {
+		cpi_logf_deferred(context, plcontext->log, CP_LOG_ERROR,
 			N_("XML parsing error in %s, line %d, column %d (%s)."),
 			file,
 			(int) XML_GetErrorLineNumber(parser),
 			(int) (XML_GetErrorColumnNumber(parser) + 1),
 			XML_ErrorString(XML_GetErrorCode(parser)));
-		cpi_unlock_context(context);
 	}
 	if (!i || plcontext->state == PARSER_ERROR) {
 		return CP_ERR_MALFORMED;
@@ -1045,7 +1356,7 @@ static cp_status_t do_descriptor_parsing(XML_Parser parser, cp_context_t *contex
 	}
 }
 
-static cp_status_t finish_descriptor_parsing(cp_status_t status, cp_context_t *context, ploader_context_t *plcontext, char **path) {
+static cp_status_t finish_descriptor_parsing(cp_status_t status, ploader_context_t *plcontext, char **path) {
 	if (status == CP_OK) {
 		if (plcontext->state != PARSER_END || plcontext->error_count > 0) {
 			status = CP_ERR_MALFORMED;
@@ -1059,39 +1370,70 @@ static cp_status_t finish_descriptor_parsing(cp_status_t status, cp_context_t *c
 	}
 
 	// Initialize the plug-in path 
-	plcontext->plugin->plugin_path = *path;
+	if ((plcontext->plugin->plugin_path = cpi_arena_memdup(plcontext->arena,
+			*path, (strlen(*path) + 1) * sizeof(char))) == NULL) {
+		return CP_ERR_RESOURCE;
+	}
+	free(*path);
 	*path = NULL;
+	return cpi_tokenize_plugin_versions(plcontext->plugin);
+}
 
-	// Increase plug-in usage count
-	status = cpi_register_info(context, plcontext->plugin, (void (*)(cp_context_t *, void *)) dealloc_plugin_info);
-	return status;
-
+/**
+ * Frees the heap memory still used by a plug-in being constructed after
+ * parsing has been aborted.
+ * 
+ * @param plcontext the parsing context
+ */
+static void free_parser_scratch(ploader_context_t *plcontext) {
+	cp_cfg_element_t *ce;
+	
+	if (plcontext->imports_size > 0) {
+		free(plcontext->plugin->imports);
+	}
+	if (plcontext->ext_points_size > 0) {
+		free(plcontext->plugin->ext_points);
+	}
+	if (plcontext->extensions_size > 0) {
+		free(plcontext->plugin->extensions);
+	}
+	if (plcontext->spans_size > 0) {
+		free(plcontext->spans);
+	}
+	
+	// Children and saved values of open configuration elements are in heap
+	// memory, the value of the innermost element is in plcontext->value 
+	for (ce = plcontext->configuration; ce != NULL; ce = ce->parent) {
+		free(ce->children);
+		if (ce != plcontext->configuration) {
+			free(ce->value);
+		}
+	}
 }
 
-static void check_cleanup_descriptor_parsing(cp_status_t status, cp_context_t *context, ploader_context_t *plcontext, XML_Parser parser, const char *path, char *file, cp_plugin_info_t **plugin) {
+static void check_cleanup_descriptor_parsing(cp_status_t status, cp_context_t *context, list_t *log, ploader_context_t *plcontext, XML_Parser parser, const char *path, char *file, cp_plugin_info_t **plugin) {
 
 	// Report possible errors
 	if (status != CP_OK) {
 		switch (status) {
 			case CP_ERR_MALFORMED:
-				cpi_errorf(context,
+				cpi_logf_deferred(context, log, CP_LOG_ERROR,
 					N_("Plug-in descriptor in %s is invalid."), path);
 				break;
 			case CP_ERR_IO:
-				cpi_errorf(context,
+				cpi_logf_deferred(context, log, CP_LOG_ERROR,
 					N_("An I/O error occurred while loading a plug-in descriptor from %s."), path);
 				break;
 			case CP_ERR_RESOURCE:
-				cpi_errorf(context,
+				cpi_logf_deferred(context, log, CP_LOG_ERROR,
 					N_("Insufficient system resources to load a plug-in descriptor from %s."), path);
 				break;
 			default:
-				cpi_errorf(context,
+				cpi_logf_deferred(context, log, CP_LOG_ERROR,
 					N_("Failed to load a plug-in descriptor from %s."), path);
 				break;
 		}
 	}
-	cpi_unlock_context(context);
 
 	// Release persistently allocated data on failure 
 	if (status != CP_OK) {
@@ -1099,6 +1441,7 @@ static void check_cleanup_descriptor_parsing(cp_status_t status, cp_context_t *c
 			free(file);
 		}
 		if (plcontext != NULL && plcontext->plugin != NULL) {
+			free_parser_scratch(plcontext);
 			cpi_free_plugin(plcontext->plugin);
 			plcontext->plugin = NULL;
 		}
@@ -1109,34 +1452,316 @@ static void check_cleanup_descriptor_parsing(cp_status_t status, cp_context_t *c
 		*plugin = plcontext->plugin;
 	}
 
-	// Release data allocated for parsing 
-	if (parser != NULL) {
-		XML_ParserFree(parser);
-	}
+	// Release data allocated for parsing and keep the parser for reuse
 	if (plcontext != NULL) {
 		if (plcontext->value != NULL) {
 			free(plcontext->value);
 		}
-		free(plcontext);
+		free(plcontext->encoding);
+		if (plcontext->names != NULL) {
+			hash_free_nodes(plcontext->names);
+		}
+		plcontext->parser = parser;
+		release_parser(context->env, plcontext);
 		plcontext = NULL;
+	} else if (parser != NULL) {
+		XML_ParserFree(parser);
 	}
 
 }
 
-CP_C_API cp_plugin_info_t * cp_load_plugin_descriptor(cp_context_t *context, const char *path, cp_status_t *error) {
+/**
+ * Records the declared encoding of a descriptor being parsed lazily.
+ * 
+ * @param userData the parsing context
+ * @param version the XML version
+ * @param encoding the declared encoding or NULL if none
+ * @param standalone the standalone declaration
+ */
+static void CP_XMLCALL xml_decl_handler(void *userData,
+	const XML_Char *version, const XML_Char *encoding, int standalone) {
+	ploader_context_t *plcontext = userData;
+	
+	if (encoding != NULL && plcontext->encoding == NULL) {
+		if ((plcontext->encoding = malloc((strlen(encoding) + 1) * sizeof(char))) != NULL) {
+			strcpy(plcontext->encoding, encoding);
+		} else {
+			resource_error(plcontext);
+		}
+	}
+}
+
+/**
+ * Disables lazy parsing for descriptors having a document type
+ * declaration because extensions might refer to the declared entities.
+ * 
+ * @param userData the parsing context
+ * @param name the document type name
+ * @param sysid the system identifier or NULL if none
+ * @param pubid the public identifier or NULL if none
+ * @param has_internal_subset whether there is an internal subset
+ */
+static void CP_XMLCALL doctype_decl_handler(void *userData,
+	const XML_Char *name, const XML_Char *sysid, const XML_Char *pubid,
+	int has_internal_subset) {
+	ploader_context_t *plcontext = userData;
+	
+	plcontext->lazy = 0;
+}
+
+/**
+ * Disables lazy parsing for UTF-16 documents because their extensions can
+ * not be parsed separately without the byte order mark.
+ * 
+ * @param plcontext the parsing context
+ * @param data the beginning of the descriptor data
+ * @param len the length of the data
+ */
+static void check_lazy_encoding(ploader_context_t *plcontext, const void *data, size_t len) {
+	const unsigned char *b = data;
+	
+	if (plcontext->lazy && len >= 2
+		&& ((b[0] == 0xfe && b[1] == 0xff) || (b[0] == 0xff && b[1] == 0xfe))) {
+		plcontext->lazy = 0;
+	}
+}
+
+/**
+ * Prepares for parsing extension configuration lazily. Only the locations
+ * of the extensions are recorded while the descriptor is being parsed.
+ * 
+ * @param plcontext the parsing context
+ */
+static void init_lazy_parsing(ploader_context_t *plcontext) {
+	plcontext->lazy = 1;
+	XML_SetXmlDeclHandler(plcontext->parser, xml_decl_handler);
+	XML_SetStartDoctypeDeclHandler(plcontext->parser, doctype_decl_handler);
+}
+
+#ifdef HAVE_STAT
+
+/**
+ * Associates the information needed to parse the extension configuration
+ * later with the plug-in being constructed.
+ * 
+ * @param plcontext the parsing context
+ * @param file the descriptor file
+ * @param st the status of the descriptor file before it was parsed
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t finish_lazy_parsing(ploader_context_t *plcontext, const char *file, const struct stat *st) {
+	cpi_lazy_cfg_t *lazy;
+	
+	if (plcontext->spans_size > 0
+		|| (lazy = cpi_arena_alloc(plcontext->arena, sizeof(cpi_lazy_cfg_t))) == NULL) {
+		return CP_ERR_RESOURCE;
+	}
+	memset(lazy, 0, sizeof(cpi_lazy_cfg_t));
+	lazy->spans = plcontext->spans;
+	lazy->size = st->st_size;
+	lazy->mtime = st->st_mtime;
+	if ((lazy->file = cpi_arena_memdup(plcontext->arena, file, (strlen(file) + 1) * sizeof(char))) == NULL
+		|| (plcontext->encoding != NULL
+			&& (lazy->encoding = cpi_arena_memdup(plcontext->arena, plcontext->encoding,
+				(strlen(plcontext->encoding) + 1) * sizeof(char))) == NULL)) {
+		return CP_ERR_RESOURCE;
+	}
+#ifdef CP_THREADS
+	if ((lazy->mutex = cpi_create_mutex()) == NULL) {
+		return CP_ERR_RESOURCE;
+	}
+#endif
+	cpi_set_plugin_lazy_cfg(plcontext->plugin, lazy);
+	return CP_OK;
+}
+
+/**
+ * Parses the configuration of a lazily parsed extension from the
+ * descriptor file. Fails if the descriptor has been modified.
+ * 
+ * @param lazy the lazy configuration information
+ * @param ext the extension
+ * @param span the location of the extension
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t parse_lazy_cfg(cpi_lazy_cfg_t *lazy, cp_extension_t *ext, const lazy_span_t *span) {
+	FILE *fh = NULL;
+	XML_Parser parser = NULL;
+	ploader_context_t *plcontext = NULL;
+	cp_status_t status = CP_OK;
+	struct stat st;
+	
+	do {
+		void *xml_buffer;
+		
+		// Check that the descriptor has not been modified
+		if (stat(lazy->file, &st)
+			|| st.st_size != lazy->size
+			|| st.st_mtime != lazy->mtime
+			|| (fh = fopen(lazy->file, "rb")) == NULL
+			|| fseek(fh, span->offset, SEEK_SET)) {
+			status = CP_ERR_IO;
+			break;
+		}
+		
+		// Initialize parsing of the extension element
+		if ((parser = XML_ParserCreate(lazy->encoding)) == NULL
+			|| (plcontext = malloc(sizeof(ploader_context_t))) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		memset(plcontext, 0, sizeof(ploader_context_t));
+		plcontext->root_element = "";
+		plcontext->parser = parser;
+		plcontext->file = lazy->file;
+		plcontext->plugin = ext->plugin;
+		plcontext->arena = cpi_plugin_arena(ext->plugin);
+		plcontext->state = PARSER_PLUGIN;
+		plcontext->lazy_target = ext;
+		XML_SetElementHandler(parser, start_element_handler, end_element_handler);
+		XML_SetUserData(parser, plcontext);
+		
+		// Read and parse the extension element
+		if ((xml_buffer = XML_GetBuffer(parser, span->length)) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		if (fread(xml_buffer, 1, span->length, fh) != (size_t) span->length) {
+			status = CP_ERR_IO;
+			break;
+		}
+		if (!XML_ParseBuffer(parser, span->length, 1)
+			|| plcontext->state != PARSER_PLUGIN
+			|| plcontext->lazy_cfg == NULL
+			|| plcontext->error_count > 0) {
+			status = CP_ERR_MALFORMED;
+		}
+		if (plcontext->resource_error_count > 0) {
+			status = CP_ERR_RESOURCE;
+		}
+	} while (0);
+	
+	// Publish the configuration
+	if (status == CP_OK) {
+		ext->configuration = plcontext->lazy_cfg;
+	}
+	
+	// Release data allocated for parsing
+	if (plcontext != NULL) {
+		if (status != CP_OK) {
+			free_parser_scratch(plcontext);
+		}
+		free(plcontext->value);
+		if (plcontext->names != NULL) {
+			hash_free_nodes(plcontext->names);
+			hash_destroy(plcontext->names);
+		}
+		free(plcontext);
+	}
+	if (parser != NULL) {
+		XML_ParserFree(parser);
+	}
+	if (fh != NULL) {
+		fclose(fh);
+	}
+	return status;
+}
+
+#endif
+
+#ifdef CP_THREADS
+#define lock_lazy_cfg(lazy) cpi_lock_mutex((lazy)->mutex)
+#define unlock_lazy_cfg(lazy) cpi_unlock_mutex((lazy)->mutex)
+#else
+#define lock_lazy_cfg(lazy) do {} while (0)
+#define unlock_lazy_cfg(lazy) do {} while (0)
+#endif
+
+CP_HIDDEN void cpi_destroy_lazy_cfg(cpi_lazy_cfg_t *lazy) {
+	assert(lazy != NULL);
+#ifdef CP_THREADS
+	if (lazy->mutex != NULL) {
+		cpi_destroy_mutex(lazy->mutex);
+		lazy->mutex = NULL;
+	}
+#endif
+}
+
+CP_HIDDEN cp_status_t cpi_load_ext_cfg(cp_extension_t *ext) {
+	cpi_lazy_cfg_t *lazy;
+	lazy_span_t *span;
+	cp_status_t status;
+	
+	assert(ext != NULL);
+	if ((lazy = cpi_plugin_lazy_cfg(ext->plugin)) == NULL) {
+		return CP_OK;
+	}
+	assert(ext >= ext->plugin->extensions
+		&& ext < ext->plugin->extensions + ext->plugin->num_extensions);
+	span = lazy->spans + (ext - ext->plugin->extensions);
+	lock_lazy_cfg(lazy);
+#ifdef HAVE_STAT
+	if (ext->configuration == NULL && span->status == CP_OK) {
+		span->status = parse_lazy_cfg(lazy, ext, span);
+	}
+#endif
+	status = span->status;
+	unlock_lazy_cfg(lazy);
+	return status;
+}
+
+#ifdef CP_MMAP_DESCRIPTORS
+
+/**
+ * Parses an opened plug-in descriptor file by mapping it into memory and
+ * passing the mapped data directly to the parser. Does nothing if the
+ * file can not be mapped, in which case the caller must read the file.
+ * 
+ * @param plcontext the parsing context
+ * @param fh the opened descriptor file
+ * @param status pointer to the location where status code is to be stored
+ * @return whether the file was mapped and parsed
+ */
+static int parse_mapped_descriptor(ploader_context_t *plcontext, FILE *fh, cp_status_t *status) {
+	struct stat st;
+	void *data;
+	
+	if (fstat(fileno(fh), &st)
+		|| !S_ISREG(st.st_mode)
+		|| st.st_size <= 0
+		|| st.st_size > INT_MAX
+		|| (data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fh), 0)) == MAP_FAILED) {
+		return 0;
+	}
+	check_lazy_encoding(plcontext, data, st.st_size);
+	*status = do_descriptor_parsing(plcontext->parser, plcontext->context, plcontext,
+		plcontext->file, data, st.st_size, 1);
+	munmap(data, st.st_size);
+	return 1;
+}
+
+#endif
+
+CP_HIDDEN cp_plugin_info_t * cpi_parse_plugin_descriptor(cp_context_t *context, const char *path, list_t *log, cp_status_t *error) {
 	char *file = NULL;
 	cp_status_t status = CP_OK;
 	FILE *fh = NULL;
 	XML_Parser parser = NULL;
 	ploader_context_t *plcontext = NULL;
 	cp_plugin_info_t *plugin = NULL;
+	unsigned long long started = cpi_monotonic_usecs();
+#ifdef HAVE_STAT
+	char *cache_file = NULL;
+	struct stat st;
+	int lazy = 0;
+#endif
 
-	CHECK_NOT_NULL(context);
-	CHECK_NOT_NULL(path);
-	cpi_lock_context(context);
-	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	assert(context != NULL);
+	assert(path != NULL);
+	assert(error != NULL);
+	CPI_TRACE1(descriptor__begin, path);
 	do {
-		int path_len;
+		int path_len, mapped, first;
 
 		// Construct the file name for the plug-in descriptor 
 		path_len = strlen(path);
@@ -1156,6 +1781,31 @@ CP_C_API cp_plugin_info_t * cp_load_plugin_descriptor(cp_context_t *context, con
 		file[path_len] = CP_FNAMESEP_CHAR;
 		strcpy(file + path_len + 1, context->env->plugin_descriptor_name);
 
+#ifdef HAVE_STAT
+		// Parse extension configuration lazily, if enabled
+		lazy = (context->env->lazy_ext_cfg && !stat(file, &st));
+		
+		// Use the descriptor cache, if enabled and up to date
+		if (!lazy && context->env->descriptor_cache_dir != NULL && !stat(file, &st)) {
+			if ((plugin = cpi_load_cached_descriptor(context, log, file, &st)) != NULL) {
+				*(file + path_len) = '\0';
+				if ((plugin->plugin_path = cpi_arena_memdup(cpi_plugin_arena(plugin),
+						file, (path_len + 1) * sizeof(char))) == NULL) {
+					cpi_free_plugin(plugin);
+					plugin = NULL;
+					status = CP_ERR_RESOURCE;
+					break;
+				}
+				free(file);
+				file = NULL;
+				break;
+			}
+			if ((cache_file = malloc((strlen(file) + 1) * sizeof(char))) != NULL) {
+				strcpy(cache_file, file);
+			}
+		}
+#endif
+
 		// Open the file 
 		if ((fh = fopen(file, "rb")) == NULL) {
 			status = CP_ERR_IO;
@@ -1163,13 +1813,22 @@ CP_C_API cp_plugin_info_t * cp_load_plugin_descriptor(cp_context_t *context, con
 		}
 
 		// Initialize descriptor parsing
-		status = init_descriptor_parsing(context, &plcontext, &parser, file);
+		status = init_descriptor_parsing(context, log, &plcontext, &parser, file);
 		if (status != CP_OK) {
 			break;
 		}
+#ifdef HAVE_STAT
+		if (lazy) {
+			init_lazy_parsing(plcontext);
+		}
+#endif
 
-		// Parse the plug-in descriptor 
-		while (1) {
+		// Parse the plug-in descriptor, preferably without copying it
+		mapped = 0;
+#ifdef CP_MMAP_DESCRIPTORS
+		mapped = parse_mapped_descriptor(plcontext, fh, &status);
+#endif
+		for (first = 1; !mapped; first = 0) {
 			unsigned int bytes_read;
 			void *xml_buffer;
 			
@@ -1186,25 +1845,81 @@ CP_C_API cp_plugin_info_t * cp_load_plugin_descriptor(cp_context_t *context, con
 				status = CP_ERR_IO;
 				break;
 			}
+			
+			if (first) {
+				check_lazy_encoding(plcontext, xml_buffer, bytes_read);
+			}
 
 			// Parse the data 
-			status = do_descriptor_parsing(parser, context, plcontext, file, bytes_read);
+			status = do_descriptor_parsing(parser, context, plcontext, file, NULL, bytes_read, bytes_read == 0);
 			if (status != CP_OK || bytes_read == 0) {
 				break;
 			}
 		}
 
+#ifdef HAVE_STAT
+		// Record the information needed to parse the configuration later
+		if (status == CP_OK && plcontext->lazy && plcontext->state == PARSER_END
+			&& plcontext->plugin->num_extensions > 0) {
+			status = finish_lazy_parsing(plcontext, file, &st);
+		}
+#endif
+
 		// Finish parsing
 		*(file + path_len) = '\0';
-		status = finish_descriptor_parsing(status, context, plcontext, &file);
+		status = finish_descriptor_parsing(status, plcontext, &file);
 	} while (0);
 
 	// Check and clean up
-	check_cleanup_descriptor_parsing(status, context, plcontext, parser, path, file, &plugin);
+	if (plugin == NULL) {
+		check_cleanup_descriptor_parsing(status, context, log, plcontext, parser, path, file, &plugin);
+	}
 	if (fh != NULL) {
 		fclose(fh);
 	}
 
+#ifdef HAVE_STAT
+	// Store the parsed descriptor into the cache
+	if (cache_file != NULL) {
+		if (plugin != NULL) {
+			cpi_store_cached_descriptor(context, log, cache_file, &st, plugin);
+		}
+		free(cache_file);
+	}
+#endif
+
+	// Record the time taken
+	if (plugin != NULL) {
+		cpi_set_plugin_parse_time(plugin, cpi_monotonic_usecs() - started);
+	}
+	CPI_TRACE2(descriptor__end, path, status);
+
+	// Return error code
+	*error = status;
+
+	return plugin;
+}
+
+CP_HIDDEN void cpi_register_plugin_descriptor(cp_context_t *context, cp_plugin_info_t *plugin) {
+	
+	// Increase plug-in usage count
+	cpi_register_info(context, plugin, (void (*)(cp_context_t *, void *)) dealloc_plugin_info);
+}
+
+CP_C_API cp_plugin_info_t * cp_load_plugin_descriptor(cp_context_t *context, const char *path, cp_status_t *error) {
+	cp_status_t status;
+	cp_plugin_info_t *plugin;
+
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(path);
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	plugin = cpi_parse_plugin_descriptor(context, path, NULL, &status);
+	if (plugin != NULL) {
+		cpi_register_plugin_descriptor(context, plugin);
+	}
+	cpi_unlock_context(context);
+
 	// Return error code
 	if (error != NULL) {
 		*error = status;
@@ -1213,62 +1928,63 @@ CP_C_API cp_plugin_info_t * cp_load_plugin_descriptor(cp_context_t *context, con
 	return plugin;
 }
 
-CP_C_API cp_plugin_info_t * cp_load_plugin_descriptor_from_memory(cp_context_t *context, const char *buffer, unsigned int buffer_len, cp_status_t *error) {
+CP_HIDDEN cp_plugin_info_t * cpi_parse_plugin_descriptor_buffer(cp_context_t *context, const char *path, const char *buffer, unsigned int buffer_len, list_t *log, cp_status_t *error) {
 	char *file = NULL;
-	const char *path = "memory";
 	cp_status_t status = CP_OK;
 	XML_Parser parser = NULL;
 	ploader_context_t *plcontext = NULL;
 	cp_plugin_info_t *plugin = NULL;
+	unsigned long long started = cpi_monotonic_usecs();
 
-	CHECK_NOT_NULL(context);
-	CHECK_NOT_NULL(buffer);
-	cpi_lock_context(context);
-	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	assert(context != NULL);
+	assert(path != NULL);
+	assert(buffer != NULL);
+	CPI_TRACE1(descriptor__begin, path);
 	do {
-		int path_len = 6;
-		file = malloc((path_len + 1) * sizeof(char));
-		if (file == NULL) {
+		if ((file = malloc((strlen(path) + 1) * sizeof(char))) == NULL) {
 			status = CP_ERR_RESOURCE;
 			break;
 		}
 		strcpy(file, path);
 
 		// Initialize descriptor parsing
-		status = init_descriptor_parsing(context, &plcontext, &parser, file);
+		status = init_descriptor_parsing(context, log, &plcontext, &parser, file);
 		if (status != CP_OK) {
 			break;
 		}
 
-		// Parse the plug-in descriptor 
-		do {
-			void *xml_buffer;
-  		
-			// Get buffer from Expat 
-			if ((xml_buffer = XML_GetBuffer(parser, buffer_len))
-					== NULL) {
-				status = CP_ERR_RESOURCE;
-				break;
-			}
-
-			// Read data into buffer
-			memcpy(xml_buffer, buffer, buffer_len);
-
-			// Parse the data 
-			status = do_descriptor_parsing(parser, context, plcontext, file, buffer_len);
-			if (status == CP_OK) {
-				status = do_descriptor_parsing(parser, context, plcontext, file, 0);
-			}
-		} while (0);
+		// Parse the plug-in descriptor in place
+		status = do_descriptor_parsing(parser, context, plcontext, file, buffer, buffer_len, 1);
 
 		// Finish parsing
-		*(file + path_len) = '\0';
-		status = finish_descriptor_parsing(status, context, plcontext, &file);
-		
+		status = finish_descriptor_parsing(status, plcontext, &file);
+
 	} while (0);
 
 	// Check and clean up
-	check_cleanup_descriptor_parsing(status, context, plcontext, parser, path, file, &plugin);
+	check_cleanup_descriptor_parsing(status, context, log, plcontext, parser, path, file, &plugin);
+	if (plugin != NULL) {
+		cpi_set_plugin_parse_time(plugin, cpi_monotonic_usecs() - started);
+	}
+	CPI_TRACE2(descriptor__end, path, status);
+
+	*error = status;
+	return plugin;
+}
+
+CP_C_API cp_plugin_info_t * cp_load_plugin_descriptor_from_memory(cp_context_t *context, const char *buffer, unsigned int buffer_len, cp_status_t *error) {
+	cp_status_t status;
+	cp_plugin_info_t *plugin;
+
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(buffer);
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	plugin = cpi_parse_plugin_descriptor_buffer(context, "memory", buffer, buffer_len, NULL, &status);
+	if (plugin != NULL) {
+		cpi_register_plugin_descriptor(context, plugin);
+	}
+	cpi_unlock_context(context);
 
 	// Return error code
 	if (error != NULL) {
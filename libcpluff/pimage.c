@@ -0,0 +1,1286 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file
+ * Plug-in images shared by several processes
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <assert.h>
+#ifdef HAVE_STAT
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#include "../kazlib/hash.h"
+#include "cpluff.h"
+#include "defines.h"
+#include "util.h"
+#include "internal.h"
+#ifdef CP_THREADS
+#include "thread.h"
+#endif
+
+// Map plug-in images into memory if possible
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H) && defined(HAVE_STAT)
+#define CP_MMAP_IMAGES
+#endif
+
+
+/* ------------------------------------------------------------------------
+ * Constants
+ * ----------------------------------------------------------------------*/
+
+/// Magic bytes at the beginning of a plug-in image
+#define IMAGE_MAGIC "CPRI"
+
+/// Version of the plug-in image format
+#define IMAGE_FORMAT_VERSION 3
+
+/// Value used to detect the byte order of a plug-in image
+#define IMAGE_BYTE_ORDER 0x01020304U
+
+/// Alignment of the structures in a plug-in image
+#define IMAGE_ALIGN (sizeof(void *))
+
+/// Flag of a relocation referring to the string section
+#define RELOC_STRING ((size_t) 1)
+
+/// No parent configuration element
+#define NO_PARENT ((size_t) -1)
+
+/// Flag of a stamp recording the plug-in descriptor file
+#define STAMP_DESCRIPTOR 0x01U
+
+/// Flag of a stamp recording the directory containing the plug-in
+#define STAMP_DIRECTORY 0x02U
+
+/// Flag of a stamp taken during the second it was last modified
+#define STAMP_RACY 0x04U
+
+
+/* ------------------------------------------------------------------------
+ * Data types
+ * ----------------------------------------------------------------------*/
+
+/**
+ * The header of a plug-in image. The image is followed by the structure
+ * section, the relocation table and the string section. Pointers are
+ * stored as offsets from the beginning of the image and the relocation
+ * table lists the offsets of all non-NULL pointers.
+ */
+typedef struct image_header_t {
+
+	/// Magic bytes
+	char magic[4];
+
+	/// Version of the image format
+	unsigned int version;
+
+	/// Byte order check value
+	unsigned int byte_order;
+
+	/// Size of a pointer
+	unsigned int ptr_size;
+
+	/// Size of plug-in information
+	unsigned int info_size;
+
+	/// Size of a configuration element
+	unsigned int cfg_size;
+
+	/// Number of plug-ins
+	unsigned int num_plugins;
+
+	/// Size of the image
+	size_t size;
+
+	/// Offset of the array of plug-in information pointers
+	size_t plugins;
+
+	/// Offset of the relocation table
+	size_t relocs;
+
+	/// Number of relocations
+	size_t num_relocs;
+
+	/// Offset of the string section
+	size_t strings;
+
+	/**
+	 * Number of plug-ins that were active when the image was written,
+	 * stored first in the plug-in array in the order they were started
+	 */
+	unsigned int num_started;
+
+	/// Offset of the stamps of the plug-ins
+	size_t stamps;
+
+} image_header_t;
+
+/**
+ * The state of the files of a plug-in when the image was written,
+ * used to detect changes to the plug-in collection before restoring.
+ */
+typedef struct image_stamp_t {
+
+	/// Flags telling which fields are valid
+	unsigned int flags;
+
+	/// The size of the descriptor file
+	unsigned long long size;
+
+	/// The modification time of the descriptor file
+	long long mtime;
+
+	/// The modification time of the directory containing the plug-in
+	long long dir_mtime;
+
+} image_stamp_t;
+
+/// A plug-in image mapped or read into memory
+struct cpi_plugin_image_t {
+
+	/// The image data
+	char *data;
+
+	/// The size of the image data
+	size_t size;
+
+	/// Whether the image data is mapped
+	int mapped;
+
+	/// The number of references to the image
+	volatile long usage_count;
+};
+
+/// A growing buffer for a section of an image being written
+typedef struct image_buffer_t {
+
+	/// The data
+	char *data;
+
+	/// The allocated size of the data
+	size_t size;
+
+	/// The current length of the data
+	size_t length;
+
+} image_buffer_t;
+
+/// A plug-in image being written
+typedef struct image_writer_t {
+
+	/// The structure section
+	image_buffer_t structs;
+
+	/// The string section
+	image_buffer_t strings;
+
+	/// The relocations as structure section offsets, tagged by RELOC_STRING
+	image_buffer_t relocs;
+
+	/// Maps strings to their string section offsets
+	hash_t *string_offsets;
+
+	/// Arena for the string offsets
+	cpi_arena_t *arena;
+
+	/// Whether memory allocation has failed
+	int error;
+
+} image_writer_t;
+
+#ifdef CP_THREADS
+#define increment_image_usage(image) cpi_atomic_increment(&((image)->usage_count))
+#define decrement_image_usage(image) cpi_atomic_decrement(&((image)->usage_count))
+#else
+#define increment_image_usage(image) (++((image)->usage_count))
+#define decrement_image_usage(image) (--((image)->usage_count))
+#endif
+
+
+/* ------------------------------------------------------------------------
+ * Function definitions
+ * ----------------------------------------------------------------------*/
+
+// Writing images
+
+/**
+ * Appends zero-initialized aligned space to an image buffer.
+ *
+ * @param w the image writer
+ * @param buf the buffer
+ * @param len the number of bytes
+ * @param align the alignment
+ * @return the offset of the space within the buffer
+ */
+static size_t buffer_alloc(image_writer_t *w, image_buffer_t *buf, size_t len, size_t align) {
+	size_t offset;
+
+	if (w->error) {
+		return 0;
+	}
+	offset = (buf->length + align - 1) / align * align;
+	if (offset + len > buf->size) {
+		size_t ns = (buf->size > 0 ? buf->size : 1024);
+		char *nd;
+
+		while (ns < offset + len) {
+			ns *= 2;
+		}
+		if ((nd = realloc(buf->data, ns)) == NULL) {
+			w->error = 1;
+			return 0;
+		}
+		buf->data = nd;
+		buf->size = ns;
+	}
+	memset(buf->data + buf->length, 0, offset + len - buf->length);
+	buf->length = offset + len;
+	return offset;
+}
+
+/**
+ * Allocates a structure in the structure section.
+ *
+ * @param w the image writer
+ * @param size the size of the structure
+ * @return the offset of the structure within the structure section
+ */
+static size_t alloc_struct(image_writer_t *w, size_t size) {
+	return buffer_alloc(w, &(w->structs), size, IMAGE_ALIGN);
+}
+
+/**
+ * Stores data into the structure section.
+ *
+ * @param w the image writer
+ * @param offset the structure section offset
+ * @param src the data
+ * @param len the length of the data
+ */
+static void set_bytes(image_writer_t *w, size_t offset, const void *src, size_t len) {
+	if (!w->error) {
+		memcpy(w->structs.data + offset, src, len);
+	}
+}
+
+/**
+ * Stores a reference into a pointer field in the structure section.
+ *
+ * @param w the image writer
+ * @param field the structure section offset of the pointer field
+ * @param target the section offset of the target
+ * @param flags RELOC_STRING if the target is within the string section
+ */
+static void set_ref(image_writer_t *w, size_t field, size_t target, size_t flags) {
+	size_t off;
+	size_t reloc = field | flags;
+
+	assert(field % IMAGE_ALIGN == 0);
+	off = buffer_alloc(w, &(w->relocs), sizeof(size_t), sizeof(size_t));
+	if (!w->error) {
+		memcpy(w->structs.data + field, &target, sizeof(size_t));
+		memcpy(w->relocs.data + off, &reloc, sizeof(size_t));
+	}
+}
+
+/**
+ * Stores a reference to a string into a pointer field in the structure
+ * section. Each distinct string is stored only once.
+ *
+ * @param w the image writer
+ * @param field the structure section offset of the pointer field
+ * @param str the string or NULL
+ */
+static void set_str(image_writer_t *w, size_t field, const char *str) {
+	hnode_t *node;
+	size_t *offset;
+
+	if (str == NULL || w->error) {
+		return;
+	}
+	if ((node = hash_lookup(w->string_offsets, str)) != NULL) {
+		offset = hnode_get(node);
+	} else {
+		size_t len = strlen(str) + 1;
+
+		if ((offset = cpi_arena_alloc(w->arena, sizeof(size_t))) == NULL
+			|| !hash_alloc_insert(w->string_offsets, str, offset)) {
+			w->error = 1;
+			return;
+		}
+		*offset = buffer_alloc(w, &(w->strings), len, 1);
+		if (w->error) {
+			return;
+		}
+		memcpy(w->strings.data + *offset, str, len);
+	}
+	set_ref(w, field, *offset, RELOC_STRING);
+}
+
+/// Stores an unsigned integer field of a structure in the structure section
+#define set_uint(w, base, type, field, value) do { \
+	unsigned int v_ = (value); \
+	set_bytes((w), (base) + offsetof(type, field), &v_, sizeof(unsigned int)); \
+} while (0)
+
+/**
+ * Writes the content of a configuration element into a configuration
+ * element allocated in the structure section. The children and attribute
+ * arrays are written in the block layout used by ::cpi_alloc_cfg_children
+ * and ::cpi_alloc_cfg_atts, including any name indexes. Values parsed by
+ * typed lookups are not cached for read-only images.
+ *
+ * @param w the image writer
+ * @param ce the configuration element
+ * @param dst the structure section offset of the target element
+ * @param parent the structure section offset of the parent or NO_PARENT
+ */
+static void put_cfg(image_writer_t *w, const cp_cfg_element_t *ce, size_t dst, size_t parent) {
+	unsigned int i;
+
+	set_str(w, dst + offsetof(cp_cfg_element_t, name), ce->name);
+	set_str(w, dst + offsetof(cp_cfg_element_t, value), ce->value);
+	set_uint(w, dst, cp_cfg_element_t, index, ce->index);
+	if (parent != NO_PARENT) {
+		set_ref(w, dst + offsetof(cp_cfg_element_t, parent), parent, 0);
+	}
+
+	// Write the attributes and the attribute name index
+	if (ce->num_atts > 0) {
+		char ** const *sorted = cpi_cfg_atts_index(ce);
+		size_t block, atts;
+
+		block = alloc_struct(w, cpi_cfg_atts_offset() + 2 * ce->num_atts * sizeof(char *));
+		atts = block + cpi_cfg_atts_offset();
+		set_uint(w, dst, cp_cfg_element_t, num_atts, ce->num_atts);
+		set_ref(w, dst + offsetof(cp_cfg_element_t, atts), atts, 0);
+		for (i = 0; i < 2 * ce->num_atts; i++) {
+			set_str(w, atts + i * sizeof(char *), ce->atts[i]);
+		}
+		if (sorted != NULL) {
+			size_t index = alloc_struct(w, ce->num_atts * sizeof(char **));
+
+			for (i = 0; i < ce->num_atts; i++) {
+				set_ref(w, index + i * sizeof(char **), atts + (sorted[i] - ce->atts) * sizeof(char *), 0);
+			}
+			set_ref(w, block, index, 0);
+		}
+	}
+
+	// Write the children and the child name index
+	if (ce->num_children > 0) {
+		cp_cfg_element_t * const *sorted = cpi_cfg_children_index(ce);
+		size_t block, children;
+
+		block = alloc_struct(w, cpi_cfg_children_offset() + ce->num_children * sizeof(cp_cfg_element_t));
+		children = block + cpi_cfg_children_offset();
+		set_uint(w, dst, cp_cfg_element_t, num_children, ce->num_children);
+		set_ref(w, dst + offsetof(cp_cfg_element_t, children), children, 0);
+		for (i = 0; i < ce->num_children; i++) {
+			put_cfg(w, ce->children + i, children + i * sizeof(cp_cfg_element_t), dst);
+		}
+		if (sorted != NULL) {
+			size_t index = alloc_struct(w, ce->num_children * sizeof(cp_cfg_element_t *));
+
+			for (i = 0; i < ce->num_children; i++) {
+				set_ref(w, index + i * sizeof(cp_cfg_element_t *), children + (sorted[i] - ce->children) * sizeof(cp_cfg_element_t), 0);
+			}
+			set_ref(w, block, index, 0);
+		}
+	}
+}
+
+/**
+ * Writes plug-in information into the structure section.
+ *
+ * @param context the plug-in context
+ * @param w the image writer
+ * @param plugin the plug-in information
+ * @return the structure section offset of the plug-in information
+ */
+static size_t put_plugin(cp_context_t *context, image_writer_t *w, cp_plugin_info_t *plugin) {
+	size_t dst, arr;
+	unsigned int i;
+
+	dst = alloc_struct(w, sizeof(cp_plugin_info_t));
+	set_str(w, dst + offsetof(cp_plugin_info_t, identifier), plugin->identifier);
+	set_str(w, dst + offsetof(cp_plugin_info_t, name), plugin->name);
+	set_str(w, dst + offsetof(cp_plugin_info_t, version), plugin->version);
+	set_str(w, dst + offsetof(cp_plugin_info_t, provider_name), plugin->provider_name);
+	set_str(w, dst + offsetof(cp_plugin_info_t, plugin_path), plugin->plugin_path);
+	set_str(w, dst + offsetof(cp_plugin_info_t, abi_bw_compatibility), plugin->abi_bw_compatibility);
+	set_str(w, dst + offsetof(cp_plugin_info_t, api_bw_compatibility), plugin->api_bw_compatibility);
+	set_str(w, dst + offsetof(cp_plugin_info_t, req_cpluff_version), plugin->req_cpluff_version);
+	set_str(w, dst + offsetof(cp_plugin_info_t, runtime_lib_name), plugin->runtime_lib_name);
+	set_str(w, dst + offsetof(cp_plugin_info_t, runtime_funcs_symbol), plugin->runtime_funcs_symbol);
+
+	// Write the imports
+	if (plugin->num_imports > 0) {
+		arr = alloc_struct(w, plugin->num_imports * sizeof(cp_plugin_import_t));
+		set_uint(w, dst, cp_plugin_info_t, num_imports, plugin->num_imports);
+		set_ref(w, dst + offsetof(cp_plugin_info_t, imports), arr, 0);
+		for (i = 0; i < plugin->num_imports; i++) {
+			size_t ip = arr + i * sizeof(cp_plugin_import_t);
+
+			set_str(w, ip + offsetof(cp_plugin_import_t, plugin_id), plugin->imports[i].plugin_id);
+			set_str(w, ip + offsetof(cp_plugin_import_t, version), plugin->imports[i].version);
+			set_uint(w, ip, cp_plugin_import_t, optional, plugin->imports[i].optional);
+		}
+	}
+
+	// Write the extension points
+	if (plugin->num_ext_points > 0) {
+		arr = alloc_struct(w, plugin->num_ext_points * sizeof(cp_ext_point_t));
+		set_uint(w, dst, cp_plugin_info_t, num_ext_points, plugin->num_ext_points);
+		set_ref(w, dst + offsetof(cp_plugin_info_t, ext_points), arr, 0);
+		for (i = 0; i < plugin->num_ext_points; i++) {
+			size_t ep = arr + i * sizeof(cp_ext_point_t);
+
+			set_ref(w, ep + offsetof(cp_ext_point_t, plugin), dst, 0);
+			set_str(w, ep + offsetof(cp_ext_point_t, local_id), plugin->ext_points[i].local_id);
+			set_str(w, ep + offsetof(cp_ext_point_t, identifier), plugin->ext_points[i].identifier);
+			set_str(w, ep + offsetof(cp_ext_point_t, name), plugin->ext_points[i].name);
+			set_str(w, ep + offsetof(cp_ext_point_t, schema_path), plugin->ext_points[i].schema_path);
+		}
+	}
+
+	// Write the extensions, parsing any lazily parsed configuration
+	if (plugin->num_extensions > 0) {
+		arr = alloc_struct(w, plugin->num_extensions * sizeof(cp_extension_t));
+		set_uint(w, dst, cp_plugin_info_t, num_extensions, plugin->num_extensions);
+		set_ref(w, dst + offsetof(cp_plugin_info_t, extensions), arr, 0);
+		for (i = 0; i < plugin->num_extensions; i++) {
+			cp_extension_t *ext = plugin->extensions + i;
+			size_t e = arr + i * sizeof(cp_extension_t);
+
+			set_ref(w, e + offsetof(cp_extension_t, plugin), dst, 0);
+			set_str(w, e + offsetof(cp_extension_t, ext_point_id), ext->ext_point_id);
+			set_str(w, e + offsetof(cp_extension_t, local_id), ext->local_id);
+			set_str(w, e + offsetof(cp_extension_t, identifier), ext->identifier);
+			set_str(w, e + offsetof(cp_extension_t, name), ext->name);
+			if (cpi_load_ext_cfg(ext) != CP_OK) {
+				cpi_warnf(context, N_("Configuration of an extension of plug-in %s could not be loaded from %s."), plugin->identifier, plugin->plugin_path);
+			}
+			if (ext->configuration != NULL) {
+				size_t ce = alloc_struct(w, sizeof(cp_cfg_element_t));
+
+				set_ref(w, e + offsetof(cp_extension_t, configuration), ce, 0);
+				put_cfg(w, ext->configuration, ce, NO_PARENT);
+			}
+		}
+	}
+
+	return dst;
+}
+
+/**
+ * Records the state of the descriptor file of a plug-in and of the
+ * directory containing the plug-in. A plug-in without a path gets an
+ * empty stamp which never goes out of date.
+ *
+ * @param context the plug-in context
+ * @param path the plug-in path or NULL
+ * @param now the current time, used to detect racy modifications
+ * @param stamp the stamp to be filled in
+ * @return @ref CP_OK (zero) on success or @ref CP_ERR_RESOURCE if insufficient memory
+ */
+static cp_status_t get_stamp(cp_context_t *context, const char *path, time_t now, image_stamp_t *stamp) {
+	memset(stamp, 0, sizeof(image_stamp_t));
+#ifdef HAVE_STAT
+	if (path != NULL) {
+		const char *dname = context->env->plugin_descriptor_name;
+		size_t len = strlen(path);
+		struct stat st;
+		char *file;
+
+		if ((file = malloc((len + strlen(dname) + 2) * sizeof(char))) == NULL) {
+			return CP_ERR_RESOURCE;
+		}
+		strcpy(file, path);
+		file[len] = CP_FNAMESEP_CHAR;
+		strcpy(file + len + 1, dname);
+		if (!stat(file, &st)) {
+			stamp->flags |= STAMP_DESCRIPTOR;
+			stamp->size = st.st_size;
+			stamp->mtime = st.st_mtime;
+			if (st.st_mtime >= now) {
+				stamp->flags |= STAMP_RACY;
+			}
+		}
+
+		// New plug-ins in the same collection change the directory
+		while (len > 1 && file[len - 1] == CP_FNAMESEP_CHAR) {
+			len--;
+		}
+		while (len > 0 && file[len - 1] != CP_FNAMESEP_CHAR) {
+			len--;
+		}
+		if (len == 0) {
+			strcpy(file, ".");
+		} else {
+			file[len > 1 ? len - 1 : 1] = '\0';
+		}
+		if (!stat(file, &st)) {
+			stamp->flags |= STAMP_DIRECTORY;
+			stamp->dir_mtime = st.st_mtime;
+			if (st.st_mtime >= now) {
+				stamp->flags |= STAMP_RACY;
+			}
+		}
+		free(file);
+	}
+#endif
+	return CP_OK;
+}
+
+/**
+ * Serializes the installed plug-ins into an image writer, storing the
+ * active ones first in start order, and fills in the image header. The
+ * pointer fields and the relocation table are converted to image offsets.
+ * The context must be locked.
+ *
+ * @param context the plug-in context
+ * @param w the initialized image writer
+ * @param header the header to be filled in
+ * @param with_stamps whether to record the state of the plug-in files
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t serialize_image(cp_context_t *context, image_writer_t *w, image_header_t *header, int with_stamps) {
+	hscan_t scan;
+	hnode_t *node;
+	lnode_t *lnode;
+	size_t plugins, stamps, structs_start;
+	unsigned int i, num_plugins, num_started;
+	image_stamp_t stamp;
+	time_t now = time(NULL);
+
+	assert(cpi_is_context_locked(context));
+	if ((w->string_offsets = hash_create(HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL
+		|| (w->arena = cpi_create_arena(4096)) == NULL) {
+		return CP_ERR_RESOURCE;
+	}
+
+	// Serialize the installed plug-ins, the active ones first in start order
+	memset(&stamp, 0, sizeof(stamp));
+	num_plugins = hash_count(context->env->plugins);
+	num_started = list_count(&(context->env->started_plugins->list));
+	plugins = alloc_struct(w, (num_plugins > 0 ? num_plugins : 1) * sizeof(cp_plugin_info_t *));
+	stamps = alloc_struct(w, (num_plugins > 0 ? num_plugins : 1) * sizeof(image_stamp_t));
+	i = 0;
+	for (lnode = list_first(&(context->env->started_plugins->list));
+		lnode != NULL;
+		lnode = list_next(&(context->env->started_plugins->list), lnode)) {
+		cp_plugin_t *rp = lnode_get(lnode);
+		size_t p = put_plugin(context, w, rp->plugin);
+
+		if (with_stamps && get_stamp(context, rp->plugin->plugin_path, now, &stamp) != CP_OK) {
+			w->error = 1;
+		}
+		set_bytes(w, stamps + i * sizeof(image_stamp_t), &stamp, sizeof(image_stamp_t));
+		set_ref(w, plugins + (i++) * sizeof(cp_plugin_info_t *), p, 0);
+	}
+	hash_scan_begin(&scan, context->env->plugins);
+	while ((node = hash_scan_next(&scan)) != NULL) {
+		cp_plugin_t *rp = hnode_get(node);
+		size_t p;
+
+		if (rp->state == CP_PLUGIN_ACTIVE || rp->state == CP_PLUGIN_STOPPING) {
+			continue;
+		}
+		p = put_plugin(context, w, rp->plugin);
+		if (with_stamps && get_stamp(context, rp->plugin->plugin_path, now, &stamp) != CP_OK) {
+			w->error = 1;
+		}
+		set_bytes(w, stamps + i * sizeof(image_stamp_t), &stamp, sizeof(image_stamp_t));
+		set_ref(w, plugins + (i++) * sizeof(cp_plugin_info_t *), p, 0);
+	}
+	assert(i == num_plugins);
+
+	// Terminate the string section so that it can be validated cheaply
+	buffer_alloc(w, &(w->strings), 1, 1);
+	if (w->error) {
+		return CP_ERR_RESOURCE;
+	}
+
+	// Convert section offsets into image offsets
+	structs_start = sizeof(image_header_t);
+	memset(header, 0, sizeof(image_header_t));
+	memcpy(header->magic, IMAGE_MAGIC, 4);
+	header->version = IMAGE_FORMAT_VERSION;
+	header->byte_order = IMAGE_BYTE_ORDER;
+	header->ptr_size = sizeof(void *);
+	header->info_size = sizeof(cp_plugin_info_t);
+	header->cfg_size = sizeof(cp_cfg_element_t);
+	header->num_plugins = num_plugins;
+	header->plugins = structs_start + plugins;
+	header->num_started = num_started;
+	header->stamps = structs_start + stamps;
+	header->relocs = structs_start + (w->structs.length + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t);
+	header->num_relocs = w->relocs.length / sizeof(size_t);
+	header->strings = header->relocs + w->relocs.length;
+	header->size = header->strings + w->strings.length;
+	for (i = 0; i < header->num_relocs; i++) {
+		size_t reloc, field, value;
+
+		memcpy(&reloc, w->relocs.data + i * sizeof(size_t), sizeof(size_t));
+		field = reloc & ~RELOC_STRING;
+		memcpy(&value, w->structs.data + field, sizeof(size_t));
+		value += ((reloc & RELOC_STRING) ? header->strings : structs_start);
+		memcpy(w->structs.data + field, &value, sizeof(size_t));
+		field += structs_start;
+		memcpy(w->relocs.data + i * sizeof(size_t), &field, sizeof(size_t));
+	}
+	return CP_OK;
+}
+
+/**
+ * Releases the resources held by an image writer.
+ *
+ * @param w the image writer
+ */
+static void free_writer(image_writer_t *w) {
+	if (w->string_offsets != NULL) {
+		hash_free_nodes(w->string_offsets);
+		hash_destroy(w->string_offsets);
+	}
+	if (w->arena != NULL) {
+		cpi_destroy_arena(w->arena);
+	}
+	free(w->structs.data);
+	free(w->strings.data);
+	free(w->relocs.data);
+}
+
+CP_C_API cp_status_t cp_write_plugin_image(cp_context_t *context, const char *file) {
+	image_writer_t w;
+	image_header_t header;
+	char *tmp_name = NULL;
+	FILE *fh = NULL;
+	cp_status_t status = CP_OK;
+
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(file);
+	memset(&w, 0, sizeof(w));
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	do {
+		size_t structs_start = sizeof(image_header_t);
+
+		if ((status = serialize_image(context, &w, &header, 1)) != CP_OK) {
+			break;
+		}
+
+		// Write to a temporary file and then replace the image file
+		if ((tmp_name = malloc((strlen(file) + 5) * sizeof(char))) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		strcpy(tmp_name, file);
+		strcat(tmp_name, ".tmp");
+		status = CP_ERR_IO;
+		if ((fh = fopen(tmp_name, "wb")) == NULL
+			|| fwrite(&header, sizeof(header), 1, fh) != 1
+			|| fwrite(w.structs.data, 1, w.structs.length, fh) != w.structs.length
+			|| fwrite("\0\0\0\0\0\0\0\0", 1, header.relocs - structs_start - w.structs.length, fh) != header.relocs - structs_start - w.structs.length
+			|| fwrite(w.relocs.data, 1, w.relocs.length, fh) != w.relocs.length
+			|| fwrite(w.strings.data, 1, w.strings.length, fh) != w.strings.length) {
+			break;
+		}
+		if (fclose(fh)) {
+			fh = NULL;
+			break;
+		}
+		fh = NULL;
+		remove(file);
+		if (rename(tmp_name, file)) {
+			break;
+		}
+		status = CP_OK;
+
+	} while (0);
+
+	// Report failure
+	if (status == CP_ERR_RESOURCE) {
+		cpi_errorf(context, N_("Plug-in image %s could not be written due to insufficient memory."), file);
+	} else if (status != CP_OK) {
+		cpi_errorf(context, N_("Plug-in image %s could not be written: %s"), file, strerror(errno));
+	}
+	cpi_unlock_context(context);
+
+	// Release resources
+	if (fh != NULL) {
+		fclose(fh);
+	}
+	if (tmp_name != NULL) {
+		if (status != CP_OK) {
+			remove(tmp_name);
+		}
+		free(tmp_name);
+	}
+	free_writer(&w);
+
+	return status;
+}
+
+
+// Installing images
+
+CP_HIDDEN void cpi_release_plugin_image(cpi_plugin_image_t *image) {
+	assert(image != NULL);
+	if (decrement_image_usage(image) > 0) {
+		return;
+	}
+#ifdef CP_MMAP_IMAGES
+	if (image->mapped) {
+		munmap(image->data, image->size);
+	} else
+#endif
+	free(image->data);
+	free(image);
+}
+
+/**
+ * Reads a plug-in image into memory, preferably by mapping the file
+ * privately so that the pages that are not relocated remain shared with
+ * the other processes using the same image.
+ *
+ * @param image the image to be initialized
+ * @param fh the opened image file
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t read_image(cpi_plugin_image_t *image, FILE *fh) {
+	image_header_t header;
+
+#ifdef CP_MMAP_IMAGES
+	{
+		struct stat st;
+		void *data;
+
+		if (!fstat(fileno(fh), &st)
+			&& S_ISREG(st.st_mode)
+			&& st.st_size >= (off_t) sizeof(image_header_t)
+			&& (data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fh), 0)) != MAP_FAILED) {
+			image->data = data;
+			image->size = st.st_size;
+			image->mapped = 1;
+			return CP_OK;
+		}
+	}
+#endif
+
+	// Read the image into allocated memory
+	if (fread(&header, sizeof(header), 1, fh) != 1
+		|| header.size < sizeof(header)) {
+		return CP_ERR_MALFORMED;
+	}
+	if ((image->data = malloc(header.size)) == NULL) {
+		return CP_ERR_RESOURCE;
+	}
+	image->size = header.size;
+	memcpy(image->data, &header, sizeof(header));
+	if (fread(image->data + sizeof(header), 1, header.size - sizeof(header), fh) != header.size - sizeof(header)) {
+		return CP_ERR_MALFORMED;
+	}
+	return CP_OK;
+}
+
+/**
+ * Validates the structure of a plug-in image and relocates the pointers
+ * it contains.
+ *
+ * @param image the image
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t relocate_image(cpi_plugin_image_t *image) {
+	image_header_t *header = (image_header_t *) image->data;
+	size_t i;
+
+	// Check that the image matches this build
+	if (image->size < sizeof(image_header_t)
+		|| memcmp(header->magic, IMAGE_MAGIC, 4)
+		|| header->version != IMAGE_FORMAT_VERSION
+		|| header->byte_order != IMAGE_BYTE_ORDER
+		|| header->ptr_size != sizeof(void *)
+		|| header->info_size != sizeof(cp_plugin_info_t)
+		|| header->cfg_size != sizeof(cp_cfg_element_t)
+		|| header->size != image->size) {
+		return CP_ERR_MALFORMED;
+	}
+
+	// Check the section layout
+	if (header->plugins < sizeof(image_header_t)
+		|| header->plugins % IMAGE_ALIGN != 0
+		|| header->relocs < header->plugins
+		|| (header->relocs - header->plugins) / sizeof(cp_plugin_info_t *) < header->num_plugins
+		|| header->relocs % sizeof(size_t) != 0
+		|| header->strings < header->relocs
+		|| (header->strings - header->relocs) / sizeof(size_t) != header->num_relocs
+		|| header->num_started > header->num_plugins
+		|| header->stamps < sizeof(image_header_t)
+		|| header->stamps % IMAGE_ALIGN != 0
+		|| header->relocs < header->stamps
+		|| (header->relocs - header->stamps) / sizeof(image_stamp_t) < header->num_plugins
+		|| header->strings >= header->size
+		|| image->data[header->size - 1] != '\0') {
+		return CP_ERR_MALFORMED;
+	}
+
+	// Relocate the pointers in the structure section
+	for (i = 0; i < header->num_relocs; i++) {
+		size_t field, value;
+		char *ptr;
+
+		memcpy(&field, image->data + header->relocs + i * sizeof(size_t), sizeof(size_t));
+		if (field < sizeof(image_header_t)
+			|| field % IMAGE_ALIGN != 0
+			|| field > header->relocs - sizeof(char *)) {
+			return CP_ERR_MALFORMED;
+		}
+		memcpy(&value, image->data + field, sizeof(size_t));
+		if (value < sizeof(image_header_t) || value >= header->size) {
+			return CP_ERR_MALFORMED;
+		}
+		ptr = image->data + value;
+		memcpy(image->data + field, &ptr, sizeof(char *));
+	}
+
+#ifdef CP_MMAP_IMAGES
+	if (image->mapped) {
+		mprotect(image->data, image->size, PROT_READ);
+	}
+#endif
+	return CP_OK;
+}
+
+/**
+ * Creates plug-in information referring to the content of a plug-in image.
+ * Only the plug-in information itself and the extension point and
+ * extension arrays, which refer back to the plug-in information, are
+ * copied. The plug-in information holds a reference to the image.
+ *
+ * @param image the image
+ * @param src the plug-in information within the image
+ * @return the unregistered plug-in information or NULL if insufficient memory
+ */
+static cp_plugin_info_t *new_image_plugin(cpi_plugin_image_t *image, const cp_plugin_info_t *src) {
+	cp_plugin_info_t *plugin;
+	cpi_arena_t *arena;
+	unsigned int i;
+
+	if ((plugin = cpi_new_plugin_info(src->num_ext_points * sizeof(cp_ext_point_t) + src->num_extensions * sizeof(cp_extension_t))) == NULL) {
+		return NULL;
+	}
+	arena = cpi_plugin_arena(plugin);
+	memcpy(plugin, src, sizeof(cp_plugin_info_t));
+	if ((src->num_ext_points > 0
+			&& (plugin->ext_points = cpi_arena_memdup(arena, src->ext_points, src->num_ext_points * sizeof(cp_ext_point_t))) == NULL)
+		|| (src->num_extensions > 0
+			&& (plugin->extensions = cpi_arena_memdup(arena, src->extensions, src->num_extensions * sizeof(cp_extension_t))) == NULL)) {
+		cpi_free_plugin(plugin);
+		return NULL;
+	}
+	for (i = 0; i < plugin->num_ext_points; i++) {
+		plugin->ext_points[i].plugin = plugin;
+	}
+	for (i = 0; i < plugin->num_extensions; i++) {
+		plugin->extensions[i].plugin = plugin;
+	}
+	if (cpi_tokenize_plugin_versions(plugin) != CP_OK) {
+		cpi_free_plugin(plugin);
+		return NULL;
+	}
+	increment_image_usage(image);
+	cpi_set_plugin_image(plugin, image);
+	return plugin;
+}
+
+/**
+ * Creates and registers the plug-in information for all the plug-ins
+ * contained in a relocated plug-in image, continuing after failures.
+ *
+ * @param context the plug-in context
+ * @param image the image
+ * @param file the image file for messages, or NULL for a template image
+ * @param error filled with the status code
+ * @return a NULL terminated array of plug-in information or NULL if insufficient memory
+ */
+static cp_plugin_info_t **new_image_plugins(cp_context_t *context, cpi_plugin_image_t *image, const char *file, cp_status_t *error) {
+	const image_header_t *header = (const image_header_t *) image->data;
+	cp_plugin_info_t * const *src = (cp_plugin_info_t * const *) (image->data + header->plugins);
+	cp_plugin_info_t **plugins;
+	unsigned int i, n;
+
+	assert(cpi_is_context_locked(context));
+	*error = CP_OK;
+	if ((plugins = malloc((header->num_plugins + 1) * sizeof(cp_plugin_info_t *))) == NULL) {
+		*error = CP_ERR_RESOURCE;
+		if (file != NULL) {
+			cpi_errorf(context, N_("Plug-in image %s could not be loaded due to insufficient memory."), file);
+		}
+		return NULL;
+	}
+	for (i = 0, n = 0; i < header->num_plugins; i++) {
+		if ((plugins[n] = new_image_plugin(image, src[i])) == NULL) {
+			if (file != NULL) {
+				cpi_errorf(context, N_("Plug-in %s could not be loaded from plug-in image %s due to insufficient memory."), src[i]->identifier, file);
+			} else {
+				cpi_errorf(context, N_("Plug-in %s could not be copied from the template context due to insufficient memory."), src[i]->identifier);
+			}
+			*error = CP_ERR_RESOURCE;
+		} else {
+			cpi_register_plugin_descriptor(context, plugins[n++]);
+		}
+	}
+	plugins[n] = NULL;
+	return plugins;
+}
+
+/**
+ * Loads a plug-in image and registers the plug-in information it
+ * contains, as described for ::cpi_load_plugin_image.
+ *
+ * @param context the plug-in context
+ * @param file the image file
+ * @param image_ref filled with a new reference to the loaded image, if non-NULL
+ * @param error filled with the status code
+ * @return a NULL terminated array of plug-in information or NULL on failure
+ */
+static cp_plugin_info_t **load_image(cp_context_t *context, const char *file, cpi_plugin_image_t **image_ref, cp_status_t *error) {
+	cpi_plugin_image_t *image = NULL;
+	cp_plugin_info_t **plugins = NULL;
+	FILE *fh = NULL;
+	cp_status_t status = CP_OK;
+
+	assert(cpi_is_context_locked(context));
+	do {
+		// Map and relocate the image
+		if ((image = malloc(sizeof(cpi_plugin_image_t))) == NULL) {
+			status = CP_ERR_RESOURCE;
+			cpi_errorf(context, N_("Plug-in image %s could not be loaded due to insufficient memory."), file);
+			break;
+		}
+		memset(image, 0, sizeof(cpi_plugin_image_t));
+		image->usage_count = 1;
+		if ((fh = fopen(file, "rb")) == NULL) {
+			status = CP_ERR_IO;
+			cpi_errorf(context, N_("Plug-in image %s could not be opened: %s"), file, strerror(errno));
+			break;
+		}
+		if ((status = read_image(image, fh)) != CP_OK
+			|| (status = relocate_image(image)) != CP_OK) {
+			if (status == CP_ERR_RESOURCE) {
+				cpi_errorf(context, N_("Plug-in image %s could not be loaded due to insufficient memory."), file);
+			} else {
+				cpi_errorf(context, N_("Plug-in image %s is not a valid plug-in image for this build."), file);
+			}
+			break;
+		}
+
+		// Create the plug-in information, continuing after failures
+		if ((plugins = new_image_plugins(context, image, file, &status)) == NULL) {
+			break;
+		}
+
+		// Pass a reference to the image to the caller, if requested
+		if (image_ref != NULL) {
+			increment_image_usage(image);
+			*image_ref = image;
+		}
+
+	} while (0);
+
+	// Release resources
+	if (fh != NULL) {
+		fclose(fh);
+	}
+	if (image != NULL) {
+		cpi_release_plugin_image(image);
+	}
+
+	*error = status;
+	return plugins;
+}
+
+CP_HIDDEN cp_plugin_info_t **cpi_load_plugin_image(cp_context_t *context, const char *file, cp_status_t *error) {
+	return load_image(context, file, NULL, error);
+}
+
+CP_C_API cp_status_t cp_install_plugin_image(cp_context_t *context, const char *file) {
+	cp_plugin_info_t **plugins;
+	cp_status_t status;
+
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(file);
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	if ((plugins = cpi_load_plugin_image(context, file, &status)) != NULL) {
+		cp_status_t s;
+		int i, n;
+
+		// Install the plug-ins as a single batch, skipping failures
+		for (n = 0; plugins[n] != NULL; n++);
+		if ((s = cpi_install_plugins(context, plugins, NULL, n, 0, NULL)) != CP_OK && status == CP_OK) {
+			status = s;
+		}
+		for (i = 0; i < n; i++) {
+			cpi_release_info(context, plugins[i]);
+		}
+		free(plugins);
+	}
+	cpi_unlock_context(context);
+
+	return status;
+}
+
+CP_C_API cp_status_t cp_restore_plugin_image(cp_context_t *context, const char *file) {
+	cpi_plugin_image_t *image = NULL;
+	cp_plugin_info_t **plugins;
+	cp_status_t status;
+	int i, n = 0;
+
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(file);
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_ANY, __func__);
+	cpi_wait_parallel_starts(context);
+	plugins = load_image(context, file, &image, &status);
+	if (plugins != NULL) {
+		for (n = 0; plugins[n] != NULL; n++);
+	}
+	do {
+		const image_header_t *header;
+		time_t now = time(NULL);
+
+		if (status != CP_OK) {
+			break;
+		}
+		header = (const image_header_t *) image->data;
+		assert((unsigned int) n == header->num_plugins);
+
+		// Check that the plug-in files have not changed
+		for (i = 0; i < n; i++) {
+			image_stamp_t saved, current;
+
+			memcpy(&saved, image->data + header->stamps + i * sizeof(image_stamp_t), sizeof(image_stamp_t));
+			if ((status = get_stamp(context, plugins[i]->plugin_path, now, &current)) != CP_OK) {
+				cpi_errorf(context, N_("Plug-in image %s could not be restored due to insufficient memory."), file);
+				break;
+			}
+			if ((saved.flags & STAMP_RACY)
+				|| saved.flags != (current.flags & ~STAMP_RACY)
+				|| saved.size != current.size
+				|| saved.mtime != current.mtime
+				|| saved.dir_mtime != current.dir_mtime) {
+				cpi_infof(context, N_("Plug-in image %s is out of date because plug-in %s has changed."), file, plugins[i]->identifier);
+				status = CP_ERR_CONFLICT;
+				break;
+			}
+		}
+		if (status != CP_OK) {
+			break;
+		}
+
+		// Install all the plug-ins and start the active ones in order
+		if ((status = cpi_install_plugins(context, plugins, NULL, n, CP_IP_ALL_OR_NONE, NULL)) != CP_OK) {
+			break;
+		}
+		for (i = 0; (unsigned int) i < header->num_started; i++) {
+			hnode_t *node = hash_lookup(context->env->plugins, plugins[i]->identifier);
+			cp_status_t s;
+
+			assert(node != NULL);
+			if ((s = cpi_start_plugin(context, hnode_get(node))) != CP_OK && status == CP_OK) {
+				status = s;
+			}
+		}
+	} while (0);
+
+	// Release resources
+	for (i = 0; i < n; i++) {
+		cpi_release_info(context, plugins[i]);
+	}
+	free(plugins);
+	if (image != NULL) {
+		cpi_release_plugin_image(image);
+	}
+	cpi_unlock_context(context);
+
+	return status;
+}
+
+
+// Context templates
+
+CP_HIDDEN void cpi_release_template_image(cp_plugin_env_t *env) {
+	if (env->template_image != NULL) {
+		cpi_release_plugin_image(env->template_image);
+		env->template_image = NULL;
+	}
+}
+
+/**
+ * Returns the template image of a context, serializing the installed
+ * plug-ins into an image in memory if not already done. The image stays
+ * valid until the set of installed plug-ins changes.
+ *
+ * @param context the plug-in context
+ * @param error filled with the status code
+ * @return the template image or NULL on failure
+ */
+static cpi_plugin_image_t *get_template_image(cp_context_t *context, cp_status_t *error) {
+	cpi_plugin_image_t *image = NULL;
+	image_writer_t w;
+	image_header_t header;
+	cp_status_t status;
+
+	assert(cpi_is_context_locked(context));
+	if (context->env->template_image != NULL) {
+		*error = CP_OK;
+		return context->env->template_image;
+	}
+	memset(&w, 0, sizeof(w));
+	do {
+		char *data;
+		size_t structs_start = sizeof(image_header_t);
+
+		if ((status = serialize_image(context, &w, &header, 0)) != CP_OK) {
+			break;
+		}
+
+		// Lay out the image in memory as it would be written to a file
+		if ((image = malloc(sizeof(cpi_plugin_image_t))) == NULL
+			|| (data = malloc(header.size)) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		memset(image, 0, sizeof(cpi_plugin_image_t));
+		image->data = data;
+		image->size = header.size;
+		image->usage_count = 1;
+		memcpy(data, &header, sizeof(header));
+		memcpy(data + structs_start, w.structs.data, w.structs.length);
+		memset(data + structs_start + w.structs.length, 0, header.relocs - structs_start - w.structs.length);
+		memcpy(data + header.relocs, w.relocs.data, w.relocs.length);
+		memcpy(data + header.strings, w.strings.data, w.strings.length);
+		status = relocate_image(image);
+		assert(status == CP_OK);
+		context->env->template_image = image;
+		image = NULL;
+	} while (0);
+	free_writer(&w);
+	if (image != NULL) {
+		free(image);
+	}
+	if (status != CP_OK) {
+		cpi_error(context, N_("The template context could not be serialized due to insufficient memory."));
+	}
+	*error = status;
+	return context->env->template_image;
+}
+
+CP_C_API cp_context_t * cp_create_context_from(cp_context_t *tmpl, cp_status_t *error) {
+	cp_context_t *context = NULL;
+	cpi_plugin_image_t *image;
+	const char *descriptor_name, *root_element;
+	char *cache_dir = NULL;
+	int lazy_ext_cfg;
+	cp_status_t status = CP_OK;
+
+	CHECK_NOT_NULL(tmpl);
+
+	// Take a reference to the template image and copy the settings
+	cpi_lock_context(tmpl);
+	cpi_check_invocation(tmpl, CPI_CF_ANY, __func__);
+	if ((image = get_template_image(tmpl, &status)) != NULL) {
+		increment_image_usage(image);
+	}
+	descriptor_name = tmpl->env->plugin_descriptor_name;
+	root_element = tmpl->env->plugin_descriptor_root_element;
+	lazy_ext_cfg = tmpl->env->lazy_ext_cfg;
+	if (tmpl->env->descriptor_cache_dir != NULL
+		&& (cache_dir = strdup(tmpl->env->descriptor_cache_dir)) == NULL) {
+		status = CP_ERR_RESOURCE;
+	}
+	cpi_unlock_context(tmpl);
+
+	do {
+		cp_plugin_info_t **plugins;
+		int i, n;
+
+		if (status != CP_OK
+			|| (context = cp_create_context(&status)) == NULL) {
+			break;
+		}
+		cp_set_plugin_descriptor_name(context, descriptor_name);
+		cp_set_plugin_descriptor_root_element(context, root_element);
+		cp_set_lazy_ext_configuration(context, lazy_ext_cfg);
+		if (cache_dir != NULL
+			&& (status = cp_set_descriptor_cache_dir(context, cache_dir)) != CP_OK) {
+			break;
+		}
+
+		// Install the plug-ins referring to the shared image
+		cpi_lock_context(context);
+		if ((plugins = new_image_plugins(context, image, NULL, &status)) != NULL) {
+			for (n = 0; plugins[n] != NULL; n++);
+			if (status == CP_OK) {
+				status = cpi_install_plugins(context, plugins, NULL, n, CP_IP_ALL_OR_NONE, NULL);
+			}
+			for (i = 0; i < n; i++) {
+				cpi_release_info(context, plugins[i]);
+			}
+			free(plugins);
+		}
+		cpi_unlock_context(context);
+
+	} while (0);
+
+	// Release resources
+	if (status != CP_OK && context != NULL) {
+		cp_destroy_context(context);
+		context = NULL;
+	}
+	if (image != NULL) {
+		cpi_release_plugin_image(image);
+	}
+	free(cache_dir);
+
+	if (error != NULL) {
+		*error = status;
+	}
+	return context;
+}
@@ -30,33 +30,23 @@
 #endif
 
 #include <string.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
 #include <assert.h>
 #include "../kazlib/hash.h"
 #include "cpluff.h"
 #include "defines.h"
 #include "util.h"
 #include "internal.h"
+#include "trace.h"
 
 
 /* ------------------------------------------------------------------------
  * Data types
  * ----------------------------------------------------------------------*/
 
-/// Registration of a dynamically allocated information object
-typedef struct info_resource_t {
-
-	/// Pointer to the resource
-	void *resource;	
-
-	/// Usage count for the resource
-	int usage_count;
-	
-	/// Deallocation function
-	cpi_dealloc_func_t dealloc_func;
-	
-} info_resource_t;
-
 /// A plug-in listener registration
 typedef struct el_holder_t {
 	
@@ -69,8 +59,160 @@ typedef struct el_holder_t {
 	/// Associated user data
 	void *user_data;
 	
+	/// Mask of the new plug-in states of interest
+	unsigned int state_mask;
+	
+	/// The plug-in identifier or prefix of interest, or NULL for all
+	const char *plugin_id;
+	
+	/// The length of the identifier prefix, or zero if not a prefix filter
+	size_t prefix_len;
+	
 } el_holder_t;
 
+/// A batch plug-in listener registration
+typedef struct bel_holder_t {
+	
+	/// The batch plug-in listener
+	cp_batch_plistener_func_t listener;
+	
+	/// The registering plug-in or NULL for the client program
+	cp_plugin_t *plugin;
+	
+	/// Associated user data
+	void *user_data;
+	
+} bel_holder_t;
+
+/// Arguments for processing listener lists when unregistering listeners
+typedef struct unregister_args_t {
+	
+	/// The node pool of the listener lists
+	cpi_node_pool_t *nodes;
+	
+	/// The plug-in whose listeners are unregistered or NULL for all
+	cp_plugin_t *plugin;
+	
+} unregister_args_t;
+
+/// A value of a configuration element or attribute parsed by a typed lookup
+typedef struct cfg_typed_t {
+	
+	/// The CFG_TYPED_* flags telling which types have been parsed
+	volatile long state;
+	
+	/// The value parsed as an integer
+	long int_value;
+	
+	/// The value parsed as a floating point number
+	double double_value;
+	
+} cfg_typed_t;
+
+/// The children of a configuration element, preceded by their name index
+typedef struct cfg_children_block_t {
+	
+	/// Pointers to the children sorted by name, or NULL if not indexed
+	cp_cfg_element_t **sorted;
+	
+	/// The parsed values of the children, or NULL if not cached
+	cfg_typed_t *typed;
+	
+	/// The children
+	cp_cfg_element_t children[1];
+	
+} cfg_children_block_t;
+
+/// The attributes of a configuration element, preceded by their name index
+typedef struct cfg_atts_block_t {
+	
+	/// Pointers to the attribute names sorted by name, or NULL if not indexed
+	char ***sorted;
+	
+	/// The parsed values of the attributes, or NULL if not cached
+	cfg_typed_t *typed;
+	
+	/// The alternating attribute names and values
+	char *atts[1];
+	
+} cfg_atts_block_t;
+
+/// A segment of a compiled configuration path
+typedef struct cfg_path_segment_t {
+	
+	/// The element name, or NULL for the parent element
+	const char *name;
+	
+	/// The length of the element name
+	size_t len;
+	
+} cfg_path_segment_t;
+
+struct cp_cfg_path_t {
+	
+	/// The attribute name, or NULL to select the element value
+	const char *attr;
+	
+	/// The number of path segments
+	unsigned int num_segments;
+	
+	/// The path segments, followed by the name data
+	cfg_path_segment_t segments[1];
+	
+};
+
+
+
+/// Minimum number of children or attributes for which a name index is built
+#define CFG_INDEX_THRESHOLD 8
+
+/// The value has been parsed as an integer
+#define CFG_TYPED_INT 0x01L
+
+/// The value is not an integer
+#define CFG_TYPED_INT_BAD 0x02L
+
+/// The value has been parsed as a floating point number
+#define CFG_TYPED_DOUBLE 0x04L
+
+/// The value is not a floating point number
+#define CFG_TYPED_DOUBLE_BAD 0x08L
+
+/// The value has been parsed as boolean false
+#define CFG_TYPED_FALSE 0x10L
+
+/// The value has been parsed as boolean true
+#define CFG_TYPED_TRUE 0x20L
+
+/// The value is not a boolean
+#define CFG_TYPED_BOOL_BAD 0x40L
+
+/// Initial capacity of the batch event queue
+#define EVENT_QUEUE_INITIAL_SIZE 32
+
+#ifdef CP_THREADS
+#define lock_infos(env) cpi_lock_mutex((env)->infos_mutex)
+#define unlock_infos(env) cpi_unlock_mutex((env)->infos_mutex)
+#define increment_usage(header) cpi_atomic_increment(&((header)->usage_count))
+#define decrement_usage(header) cpi_atomic_decrement(&((header)->usage_count))
+#else
+#define lock_infos(env) do {} while (0)
+#define unlock_infos(env) do {} while (0)
+#define increment_usage(header) (++((header)->usage_count))
+#define decrement_usage(header) (--((header)->usage_count))
+#endif
+
+#ifdef CP_THREADS
+#define load_handle(field) cpi_atomic_load(&(field))
+#define store_handle(field, value) cpi_atomic_store(&(field), (value))
+#define load_typed(typed) cpi_atomic_load(&((typed)->state))
+#define store_typed(typed, value) cpi_atomic_store(&((typed)->state), (value))
+#else
+#define load_handle(field) (field)
+#define store_handle(field, value) ((field) = (value))
+#define load_typed(typed) ((typed)->state)
+#define store_typed(typed, value) ((typed)->state = (value))
+#endif
 
 
 /* ------------------------------------------------------------------------
@@ -79,101 +221,255 @@ typedef struct el_holder_t {
 
 // General information object management
 
-CP_HIDDEN cp_status_t cpi_register_info(cp_context_t *context, void *res, cpi_dealloc_func_t df) {
-	cp_status_t status = CP_OK;
-	info_resource_t *ir = NULL;
+/**
+ * Checks that the specified address refers to a registered information
+ * object by looking it up in the address index. This can not be decided
+ * from the header preceding an unknown address, which must not be read.
+ * 
+ * @param context the plug-in context
+ * @param info the information object
+ * @param msg the fatal error message, taking the address as an argument
+ */
+static void check_info_registered(cp_context_t *context, const void *info, const char *msg) {
+	int registered;
+	
+	lock_infos(context->env);
+	registered = (hash_lookup(context->env->infos_index, info) != NULL);
+	unlock_infos(context->env);
+	if (!registered) {
+		cpi_fatalf(msg, info);
+	}
+}
+
+CP_HIDDEN void *cpi_alloc_info(size_t size) {
+	cpi_info_header_t *header;
+	
+	if ((header = malloc(sizeof(cpi_info_header_t) + size)) == NULL) {
+		return NULL;
+	}
+	memset(header, 0, sizeof(cpi_info_header_t));
+	header->size = sizeof(cpi_info_header_t) + size;
+	return header + 1;
+}
+
+/**
+ * Returns the heap memory held by the specified information object.
+ * 
+ * @param header the header of the object
+ * @return the size in bytes
+ */
+static size_t info_size(const cpi_info_header_t *header) {
+	if (header->size != 0) {
+		return header->size;
+	} else {
+		return cpi_plugin_info_size((const cp_plugin_info_t *) (header + 1));
+	}
+}
+
+CP_HIDDEN void cpi_free_info(void *info) {
+	assert(info != NULL);
+	assert(CPI_INFO_HEADER(info)->dealloc_func == NULL);
+	free(CPI_INFO_HEADER(info));
+}
+
+CP_HIDDEN void cpi_register_info(cp_context_t *context, void *res, cpi_dealloc_func_t df) {
+	cpi_info_header_t *header;
 
 	assert(context != NULL);
 	assert(res != NULL);
 	assert(df != NULL);
 	assert(cpi_is_context_locked(context));
-	do {
-		if ((ir = malloc(sizeof(info_resource_t))) == NULL) {
-			status = CP_ERR_RESOURCE;
-			break;
-		}
-		ir->resource = res;
-		ir->usage_count = 1;
-		ir->dealloc_func = df;
-		if (!hash_alloc_insert(context->env->infos, res, ir)) {
-			status = CP_ERR_RESOURCE;
-			break;
-		}
-	} while (0);
-	
-	// Report success
-	if (status == CP_OK) {
-		cpi_debugf(context, N_("Registered a new reference counted object at address %p."), res);
-	}		
-	
-	// Release resources on failure
-	if (status != CP_OK) {
-		if (ir != NULL) {
-			free(ir);
-		}
+	header = CPI_INFO_HEADER(res);
+	assert(header->dealloc_func == NULL);
+	header->usage_count = 1;
+	header->dealloc_func = df;
+	header->owner = context->plugin;
+	header->prev = NULL;
+	lock_infos(context->env);
+	if ((header->next = context->env->infos) != NULL) {
+		header->next->prev = header;
 	}
-	
-	return status;
+	context->env->infos = header;
+	hnode_init(&header->index_node, header);
+	hash_insert(context->env->infos_index, &header->index_node, res);
+	unlock_infos(context->env);
+	cpi_debugm(context, CP_MSG_INFO_REGISTERED, NULL, NULL, res, 0);
 }
 
 CP_HIDDEN void cpi_use_info(cp_context_t *context, void *res) {
-	hnode_t *node;
+	cpi_info_header_t *header;
+	long count;
 	
 	assert(context != NULL);
 	assert(res != NULL);
 	assert(cpi_is_context_locked(context));
-	if ((node = hash_lookup(context->env->infos, res)) != NULL) {
-		info_resource_t *ir = hnode_get(node);
-		ir->usage_count++;
-		cpi_debugf(context, N_("Reference count of the object at address %p increased to %d."), res, ir->usage_count);
-	} else {
-		cpi_fatalf(_("Attempt to increase the reference count of an unknown object at address %p."), res);
-	}
+	check_info_registered(context, res, _("Attempt to increase the reference count of an unknown object at address %p."));
+	header = CPI_INFO_HEADER(res);
+	assert(header->dealloc_func != NULL && header->usage_count > 0);
+	count = increment_usage(header);
+	cpi_debugm(context, CP_MSG_INFO_USED, NULL, NULL, res, (int) count);
 }
 
 CP_HIDDEN void cpi_release_info(cp_context_t *context, void *info) {
-	hnode_t *node;
+	cpi_info_header_t *header;
+	cpi_dealloc_func_t df;
+	long count;
 	
 	assert(context != NULL);
 	assert(info != NULL);
 	assert(cpi_is_context_locked(context));
-	if ((node = hash_lookup(context->env->infos, info)) != NULL) {
-		info_resource_t *ir = hnode_get(node);
-		assert(ir != NULL && info == ir->resource);
-		ir->usage_count--;
-		cpi_debugf(context, N_("Reference count of the object at address %p decreased to %d."), info, ir->usage_count);
-		if (ir->usage_count == 0) {
-			hash_delete_free(context->env->infos, node);
-			ir->dealloc_func(context, info);
-			cpi_debugf(context, N_("Deallocated the reference counted object at address %p."), info);
-			free(ir);
+	check_info_registered(context, info, _("Attempt to release an unknown reference counted object at address %p."));
+	header = CPI_INFO_HEADER(info);
+	assert(header->dealloc_func != NULL && header->usage_count > 0);
+	count = decrement_usage(header);
+	cpi_debugm(context, CP_MSG_INFO_RELEASED, NULL, NULL, info, (int) count);
+	if (count == 0) {
+		
+		// Unlink the object
+		lock_infos(context->env);
+		if (header->prev != NULL) {
+			header->prev->next = header->next;
+		} else {
+			context->env->infos = header->next;
 		}
-	} else {
-		cpi_fatalf(_("Attempt to release an unknown reference counted object at address %p."), info);
+		if (header->next != NULL) {
+			header->next->prev = header->prev;
+		}
+		hash_delete(context->env->infos_index, &header->index_node);
+		unlock_infos(context->env);
+		
+		// Deallocate the object
+		df = header->dealloc_func;
+		header->dealloc_func = NULL;
+		df(context, info);
+		cpi_debugm(context, CP_MSG_INFO_DEALLOCATED, NULL, NULL, info, 0);
 	}
 }
 
 CP_C_API void cp_release_info(cp_context_t *context, void *info) {
 	CHECK_NOT_NULL(context);
 	CHECK_NOT_NULL(info);
-	cpi_lock_context(context);
+	cpi_lock_context_shared(context);
 	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
 	cpi_release_info(context, info);
-	cpi_unlock_context(context);
+	cpi_unlock_context_shared(context);
 }
 
-CP_HIDDEN void cpi_release_infos(cp_context_t *context) {
-	hscan_t scan;
-	hnode_t *node;
+CP_C_API unsigned long cp_get_info_size(cp_context_t *context, const void *info) {
+	const cpi_info_header_t *header;
+	unsigned long size;
+	
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(info);
+	cpi_lock_context_shared(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+	check_info_registered(context, info, _("Attempt to query the size of an unknown reference counted object at address %p."));
+	header = CPI_INFO_HEADER(info);
+	size = info_size(header);
+	cpi_unlock_context_shared(context);
+	return size;
+}
+
+CP_HIDDEN void cpi_disown_infos(cp_context_t *context, cp_plugin_t *plugin) {
+	cpi_info_header_t *header;
+	
+	assert(context != NULL);
+	assert(plugin != NULL);
+	lock_infos(context->env);
+	for (header = context->env->infos; header != NULL; header = header->next) {
+		if (header->owner == plugin) {
+			header->owner = NULL;
+		}
+	}
+	unlock_infos(context->env);
+}
+
+static void dealloc_info_usage(cp_context_t *context, cp_info_usage_t *usage) {
+	cpi_free_info(usage);
+}
+
+CP_C_API cp_info_usage_t * cp_get_info_usage(cp_context_t *context, cp_status_t *error, int *num) {
+	cp_info_usage_t *usage = NULL;
+	const cpi_info_header_t *header;
+	cp_status_t status = CP_OK;
+	size_t bytes = 0;
+	int n = 0, i;
+	
+	CHECK_NOT_NULL(context);
+	
+	cpi_lock_context_shared(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+	lock_infos(context->env);
+	do {
+		char *ids;
+		
+		// Count the distinct owners and the space needed for identifiers
+		for (header = context->env->infos; header != NULL; header = header->next) {
+			const cpi_info_header_t *h;
+			
+			for (h = context->env->infos; h != header && h->owner != header->owner; h = h->next);
+			if (h == header) {
+				n++;
+				if (header->owner != NULL) {
+					bytes += strlen(header->owner->plugin->identifier) + 1;
+				}
+			}
+		}
+		
+		// Allocate space for the entries followed by the identifiers
+		if ((usage = cpi_alloc_info(sizeof(cp_info_usage_t) * (n + 1) + bytes)) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		memset(usage, 0, sizeof(cp_info_usage_t) * (n + 1));
+		ids = (char *) (usage + n + 1);
 		
-	hash_scan_begin(&scan, context->env->infos);
-	while ((node = hash_scan_next(&scan)) != NULL) {
-		info_resource_t *ir = hnode_get(node);			
+		// Accumulate the usage of each owner
+		for (header = context->env->infos; header != NULL; header = header->next) {
+			for (i = 0; i < n && usage[i].num_infos > 0; i++) {
+				if (header->owner == NULL ? usage[i].plugin_id == NULL
+					: (usage[i].plugin_id != NULL && !strcmp(usage[i].plugin_id, header->owner->plugin->identifier))) {
+					break;
+				}
+			}
+			assert(i < n);
+			if (usage[i].num_infos == 0 && header->owner != NULL) {
+				strcpy(ids, header->owner->plugin->identifier);
+				usage[i].plugin_id = ids;
+				ids += strlen(ids) + 1;
+			}
+			usage[i].num_infos++;
+			usage[i].bytes += info_size(header);
+		}
+	} while (0);
+	unlock_infos(context->env);
+	
+	// Register the array as an information object, excluded from the result
+	if (status == CP_OK) {
+		cpi_register_info(context, usage, (void (*)(cp_context_t *, void *)) dealloc_info_usage);
+	}
+	cpi_unlock_context_shared(context);
+	
+	if (error != NULL) {
+		*error = status;
+	}
+	if (num != NULL && status == CP_OK) {
+		*num = n;
+	}
+	return usage;
+}
+
+CP_HIDDEN void cpi_release_infos(cp_context_t *context) {
+	cpi_info_header_t *header;
+	
+	while ((header = context->env->infos) != NULL) {
 		cpi_lock_context(context);
-		cpi_errorf(context, N_("An unreleased information object was encountered at address %p with reference count %d when destroying the associated plug-in context. Not releasing the object."), ir->resource, ir->usage_count);
+		cpi_errorf(context, N_("An unreleased information object was encountered at address %p with reference count %d when destroying the associated plug-in context. Not releasing the object."), (void *) (header + 1), (int) header->usage_count);
 		cpi_unlock_context(context);
-		hash_scan_delfree(context->env->infos, node);
-		free(ir);
+		context->env->infos = header->next;
+		header->prev = NULL;
+		header->next = NULL;
+		hash_delete(context->env->infos_index, &header->index_node);
 	}
 }
 
@@ -191,14 +487,13 @@ CP_C_API cp_plugin_info_t * cp_get_plugin_info(cp_context_t *context, const char
 	}
 
 	// Look up the plug-in and return information 
-	cpi_lock_context(context);
+	cpi_lock_context_shared(context);
 	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
 	do {
 		
 		// Lookup plug-in information
 		if (id != NULL) {
 			if ((node = hash_lookup(context->env->plugins, id)) == NULL) {
-				cpi_warnf(context, N_("Could not return information about unknown plug-in %s."), id);
 				status = CP_ERR_UNKNOWN;
 				break;
 			}
@@ -209,7 +504,14 @@ CP_C_API cp_plugin_info_t * cp_get_plugin_info(cp_context_t *context, const char
 		}
 		cpi_use_info(context, plugin);
 	} while (0);
-	cpi_unlock_context(context);
+	cpi_unlock_context_shared(context);
+
+	// Report error
+	if (status == CP_ERR_UNKNOWN) {
+		cpi_lock_context(context);
+		cpi_warnf(context, N_("Could not return information about unknown plug-in %s."), id);
+		cpi_unlock_context(context);
+	}
 
 	if (error != NULL) {
 		*error = status;
@@ -225,7 +527,7 @@ static void dealloc_plugins_info(cp_context_t *context, cp_plugin_info_t **plugi
 	for (i = 0; plugins[i] != NULL; i++) {
 		cpi_release_info(context, plugins[i]);
 	}
-	free(plugins);
+	cpi_free_info(plugins);
 }
 
 CP_C_API cp_plugin_info_t ** cp_get_plugins_info(cp_context_t *context, cp_status_t *error, int *num) {
@@ -235,7 +537,7 @@ CP_C_API cp_plugin_info_t ** cp_get_plugins_info(cp_context_t *context, cp_statu
 	
 	CHECK_NOT_NULL(context);
 	
-	cpi_lock_context(context);
+	cpi_lock_context_shared(context);
 	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
 	do {
 		hscan_t scan;
@@ -243,7 +545,7 @@ CP_C_API cp_plugin_info_t ** cp_get_plugins_info(cp_context_t *context, cp_statu
 		
 		// Allocate space for pointer array 
 		n = hash_count(context->env->plugins);
-		if ((plugins = malloc(sizeof(cp_plugin_info_t *) * (n + 1))) == NULL) {
+		if ((plugins = cpi_alloc_info(sizeof(cp_plugin_info_t *) * (n + 1))) == NULL) {
 			status = CP_ERR_RESOURCE;
 			break;
 		}
@@ -262,22 +564,17 @@ CP_C_API cp_plugin_info_t ** cp_get_plugins_info(cp_context_t *context, cp_statu
 		plugins[i] = NULL;
 		
 		// Register the array
-		status = cpi_register_info(context, plugins, (void (*)(cp_context_t *, void *)) dealloc_plugins_info);
+		cpi_register_info(context, plugins, (void (*)(cp_context_t *, void *)) dealloc_plugins_info);
 		
 	} while (0);
 
+	cpi_unlock_context_shared(context);
+
 	// Report error
 	if (status != CP_OK) {
+		cpi_lock_context(context);
 		cpi_error(context, N_("Plug-in information could not be returned due to insufficient memory."));
-	}
-	cpi_unlock_context(context);
-
-	// Release resources on error 
-	if (status != CP_OK) {
-		if (plugins != NULL) {
-			dealloc_plugins_info(context, plugins);
-			plugins = NULL;
-		}
+		cpi_unlock_context(context);
 	}
 	
 	assert(status != CP_OK || n == 0 || plugins[n - 1] != NULL);
@@ -298,16 +595,131 @@ CP_C_API cp_plugin_state_t cp_get_plugin_state(cp_context_t *context, const char
 	CHECK_NOT_NULL(id);
 	
 	// Look up the plug-in state 
-	cpi_lock_context(context);
+	cpi_lock_context_shared(context);
 	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
 	if ((hnode = hash_lookup(context->env->plugins, id)) != NULL) {
 		cp_plugin_t *rp = hnode_get(hnode);
 		state = rp->state;
 	}
-	cpi_unlock_context(context);
+	cpi_unlock_context_shared(context);
 	return state;
 }
 
+static void dealloc_plugin_handle(cp_context_t *context, cp_plugin_handle_t *handle) {
+	assert(context != NULL);
+	assert(handle != NULL);
+	cpi_release_info(context, handle->plugin);
+	cpi_free_info(handle);
+}
+
+CP_C_API cp_plugin_handle_t *cp_get_plugin_handle(cp_context_t *context, const char *id, cp_status_t *error) {
+	hnode_t *node;
+	cp_plugin_t *rp;
+	cp_plugin_handle_t *handle = NULL;
+	cp_status_t status = CP_OK;
+
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(id);
+
+	// Look up the plug-in and create its handle on first use
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+	do {
+		if ((node = hash_lookup(context->env->plugins, id)) == NULL) {
+			status = CP_ERR_UNKNOWN;
+			cpi_warnf(context, N_("Could not return a handle to unknown plug-in %s."), id);
+			break;
+		}
+		rp = hnode_get(node);
+		if ((handle = rp->handle) == NULL) {
+			if ((handle = cpi_alloc_info(sizeof(cp_plugin_handle_t))) == NULL) {
+				status = CP_ERR_RESOURCE;
+				cpi_error(context, N_("Plug-in handle could not be returned due to insufficient memory."));
+				break;
+			}
+			handle->state = rp->state;
+			handle->installed = 1;
+			handle->plugin = rp->plugin;
+			cpi_use_info(context, rp->plugin);
+
+			// The initial reference is held by the plug-in until uninstalled
+			cpi_register_info(context, handle, (void (*)(cp_context_t *, void *)) dealloc_plugin_handle);
+			rp->handle = handle;
+			context->env->num_plugin_handles++;
+		}
+		cpi_use_info(context, handle);
+	} while (0);
+	cpi_unlock_context(context);
+
+	if (error != NULL) {
+		*error = status;
+	}
+	return handle;
+}
+
+CP_C_API cp_plugin_state_t cp_get_handle_state(cp_plugin_handle_t *handle) {
+	CHECK_NOT_NULL(handle);
+	return (cp_plugin_state_t) load_handle(handle->state);
+}
+
+CP_C_API cp_plugin_info_t *cp_get_handle_info(cp_plugin_handle_t *handle) {
+	CHECK_NOT_NULL(handle);
+	return load_handle(handle->installed) ? handle->plugin : NULL;
+}
+
+CP_HIDDEN void cpi_detach_plugin_handle(cp_context_t *context, cp_plugin_t *plugin) {
+	cp_plugin_handle_t *handle;
+
+	assert(cpi_is_context_locked(context));
+	if ((handle = plugin->handle) != NULL) {
+		store_handle(handle->state, CP_PLUGIN_UNINSTALLED);
+		store_handle(handle->installed, 0);
+		plugin->handle = NULL;
+		context->env->num_plugin_handles--;
+		cpi_release_info(context, handle);
+	}
+}
+
+/**
+ * Updates the state of the handle of the plug-in affected by the specified
+ * event, if the plug-in has a handle.
+ * 
+ * @param context the plug-in context
+ * @param event the plug-in event
+ */
+static void update_plugin_handle(cp_context_t *context, const cpi_plugin_event_t *event) {
+	hnode_t *node;
+
+	if ((node = hash_lookup(context->env->plugins, event->plugin_id)) != NULL) {
+		cp_plugin_t *rp = hnode_get(node);
+
+		if (rp->handle != NULL) {
+			store_handle(rp->handle->state, event->new_state);
+		}
+	}
+}
+
+CP_C_API cp_status_t cp_get_plugin_stats(cp_context_t *context, const char *id, cp_plugin_stats_t *stats) {
+	cp_status_t status = CP_ERR_UNKNOWN;
+	hnode_t *hnode;
+	
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(id);
+	CHECK_NOT_NULL(stats);
+	
+	// Copy the statistics of the plug-in
+	cpi_lock_context_shared(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+	if ((hnode = hash_lookup(context->env->plugins, id)) != NULL) {
+		cp_plugin_t *rp = hnode_get(hnode);
+		*stats = rp->stats;
+		stats->descriptor_bytes = cpi_plugin_info_size(rp->plugin);
+		status = CP_OK;
+	}
+	cpi_unlock_context_shared(context);
+	return status;
+}
+
 static void dealloc_ext_points_info(cp_context_t *context, cp_ext_point_t **ext_points) {
 	int i;
 	
@@ -316,7 +728,7 @@ static void dealloc_ext_points_info(cp_context_t *context, cp_ext_point_t **ext_
 	for (i = 0; ext_points[i] != NULL; i++) {
 		cpi_release_info(context, ext_points[i]->plugin);
 	}
-	free(ext_points);
+	cpi_free_info(ext_points);
 }
 
 CP_C_API cp_ext_point_t ** cp_get_ext_points_info(cp_context_t *context, cp_status_t *error, int *num) {
@@ -326,7 +738,7 @@ CP_C_API cp_ext_point_t ** cp_get_ext_points_info(cp_context_t *context, cp_stat
 	
 	CHECK_NOT_NULL(context);
 	
-	cpi_lock_context(context);
+	cpi_lock_context_shared(context);
 	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
 	do {
 		hscan_t scan;
@@ -334,7 +746,7 @@ CP_C_API cp_ext_point_t ** cp_get_ext_points_info(cp_context_t *context, cp_stat
 		
 		// Allocate space for pointer array 
 		n = hash_count(context->env->ext_points);
-		if ((ext_points = malloc(sizeof(cp_ext_point_t *) * (n + 1))) == NULL) {
+		if ((ext_points = cpi_alloc_info(sizeof(cp_ext_point_t *) * (n + 1))) == NULL) {
 			status = CP_ERR_RESOURCE;
 			break;
 		}
@@ -353,22 +765,17 @@ CP_C_API cp_ext_point_t ** cp_get_ext_points_info(cp_context_t *context, cp_stat
 		ext_points[i] = NULL;
 		
 		// Register the array
-		status = cpi_register_info(context, ext_points, (void (*)(cp_context_t *, void *)) dealloc_ext_points_info);
+		cpi_register_info(context, ext_points, (void (*)(cp_context_t *, void *)) dealloc_ext_points_info);
 		
 	} while (0);
 	
+	cpi_unlock_context_shared(context);
+
 	// Report error
 	if (status != CP_OK) {
+		cpi_lock_context(context);
 		cpi_error(context, N_("Extension point information could not be returned due to insufficient memory."));
-	}
-	cpi_unlock_context(context);
-	
-	// Release resources on error 
-	if (status != CP_OK) {
-		if (ext_points != NULL) {
-			dealloc_ext_points_info(context, ext_points);
-			ext_points = NULL;
-		}
+		cpi_unlock_context(context);
 	}
 	
 	assert(status != CP_OK || n == 0 || ext_points[n - 1] != NULL);
@@ -389,102 +796,130 @@ static void dealloc_extensions_info(cp_context_t *context, cp_extension_t **exte
 	for (i = 0; extensions[i] != NULL; i++) {
 		cpi_release_info(context, extensions[i]->plugin);
 	}
-	free(extensions);
+	cpi_free_info(extensions);
 }
 
-CP_C_API cp_extension_t ** cp_get_extensions_info(cp_context_t *context, const char *extpt_id, cp_status_t *error, int *num) {
-	cp_extension_t **extensions = NULL;
-	int i, n;
-	cp_status_t status = CP_OK;
+/**
+ * Copies the extensions of an extension array into an information array,
+ * loading their configuration and keeping their plug-in information in
+ * use.
+ * 
+ * @param context the plug-in context
+ * @param ev the extension array
+ * @param extensions the information array
+ * @param i the index of the first information array entry to fill
+ * @param failed the location of the first extension whose configuration failed to load
+ * @return the index following the last filled entry
+ */
+static int copy_extensions(cp_context_t *context, const cpi_ptrvec_t *ev, cp_extension_t **extensions, int i, cp_extension_t **failed) {
+	int j;
 	
-	CHECK_NOT_NULL(context);
+	for (j = 0; j < ev->num_slots; j++) {
+		cp_extension_t *e = ev->ptrs[j];
+		
+		if (e != NULL) {
+			if (cpi_load_ext_cfg(e) != CP_OK && *failed == NULL) {
+				*failed = e;
+			}
+			cpi_use_info(context, e->plugin);
+			extensions[i++] = e;
+		}
+	}
+	return i;
+}
+
+/**
+ * Returns extension information for the extensions installed at the
+ * specified extension point, at the extension points whose identifier
+ * begins with the specified prefix, or at all extension points.
+ * 
+ * @param context the plug-in context
+ * @param extpt_id the extension point identifier or prefix, or NULL for all
+ * @param prefix whether @a extpt_id is a prefix
+ * @param error filled with the status code, if non-NULL
+ * @param num filled with the number of returned extensions, if non-NULL
+ * @param func the name of the calling function
+ * @return a NULL terminated array of extension information or NULL on failure
+ */
+static cp_extension_t **get_extensions_info(cp_context_t *context, const char *extpt_id, int prefix, cp_status_t *error, int *num, const char *func) {
+	cp_extension_t **extensions = NULL;
+	cp_extension_t *failed = NULL;
+	int i, n;
+	cp_status_t status = CP_OK;
 	
-	cpi_lock_context(context);
-	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+	cpi_lock_context_shared(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER, func);
 	do {
+		const cp_plugin_env_t *env = context->env;
 		hscan_t scan;
 		hnode_t *hnode;
+		size_t len = 0;
+		int first = 0, last = 0;
 
 		// Count the number of extensions
-		if (extpt_id != NULL) {
-			if ((hnode = hash_lookup(context->env->extensions, extpt_id)) != NULL) {
-				n = list_count((list_t *) hnode_get(hnode));
-			} else {
-				n = 0;
+		n = 0;
+		if (prefix) {
+			len = strlen(extpt_id);
+			first = cpi_ext_index_lower_bound(env, extpt_id);
+			for (last = first;
+				last < env->num_ext_index && !strncmp(hnode_getkey(env->ext_index[last]), extpt_id, len);
+				last++) {
+				n += ((cpi_ptrvec_t *) hnode_get(env->ext_index[last]))->count;
+			}
+		} else if (extpt_id != NULL) {
+			if ((hnode = hash_lookup(env->extensions, extpt_id)) != NULL) {
+				n = ((cpi_ptrvec_t *) hnode_get(hnode))->count;
 			}
 		} else {
-			hscan_t scan;
-			
-			n = 0;
-			hash_scan_begin(&scan, context->env->extensions);
+			hash_scan_begin(&scan, env->extensions);
 			while ((hnode = hash_scan_next(&scan)) != NULL) {
-				n += list_count((list_t *) hnode_get(hnode));
+				n += ((cpi_ptrvec_t *) hnode_get(hnode))->count;
 			}
 		}
 		
 		// Allocate space for pointer array 
-		if ((extensions = malloc(sizeof(cp_extension_t *) * (n + 1))) == NULL) {
+		if ((extensions = cpi_alloc_info(sizeof(cp_extension_t *) * (n + 1))) == NULL) {
 			status = CP_ERR_RESOURCE;
 			break;
 		}
 		
 		// Get extension information structures
-		if (extpt_id != NULL) {
-			i = 0;
-			if ((hnode = hash_lookup(context->env->extensions, extpt_id)) != NULL) {
-				list_t *el = hnode_get(hnode);
-				lnode_t *lnode;
-				
-				lnode = list_first(el);
-				while (lnode != NULL) {
-					cp_extension_t *e = lnode_get(lnode);
-				
-					assert(i < n);
-					cpi_use_info(context, e->plugin);
-					extensions[i] = e;
-					i++;
-					lnode = list_next(el, lnode);
-				}
+		i = 0;
+		if (prefix) {
+			int j;
+			
+			for (j = first; j < last; j++) {
+				i = copy_extensions(context, hnode_get(env->ext_index[j]), extensions, i, &failed);
+			}
+		} else if (extpt_id != NULL) {
+			if ((hnode = hash_lookup(env->extensions, extpt_id)) != NULL) {
+				i = copy_extensions(context, hnode_get(hnode), extensions, i, &failed);
 			}
-			extensions[i] = NULL;
 		} else { 
-			hash_scan_begin(&scan, context->env->extensions);
-			i = 0;
+			hash_scan_begin(&scan, env->extensions);
 			while ((hnode = hash_scan_next(&scan)) != NULL) {
-				list_t *el = hnode_get(hnode);
-				lnode_t *lnode;
-			
-				lnode = list_first(el);
-				while (lnode != NULL) {
-					cp_extension_t *e = lnode_get(lnode);
-				
-					assert(i < n);
-					cpi_use_info(context, e->plugin);
-					extensions[i] = e;
-					i++;
-					lnode = list_next(el, lnode);
-				}
+				i = copy_extensions(context, hnode_get(hnode), extensions, i, &failed);
 			}
 		}
 		extensions[i] = NULL;
 		
 		// Register the array
-		status = cpi_register_info(context, extensions, (void (*)(cp_context_t *, void *)) dealloc_extensions_info);
+		cpi_register_info(context, extensions, (void (*)(cp_context_t *, void *)) dealloc_extensions_info);
 		
 	} while (0);
 	
+	cpi_unlock_context_shared(context);
+
 	// Report error
 	if (status != CP_OK) {
+		cpi_lock_context(context);
 		cpi_error(context, N_("Extension information could not be returned due to insufficient memory."));
-	}
-	cpi_unlock_context(context);
-	
-	// Release resources on error 
-	if (status != CP_OK) {
-		if (extensions != NULL) {
-			dealloc_extensions_info(context, extensions);
-			extensions = NULL;
-		}
+		cpi_unlock_context(context);
+	} else if (failed != NULL) {
+		cpi_lock_context(context);
+		cpi_errorf(context, N_("Configuration of an extension of plug-in %s could not be loaded from %s."),
+			failed->plugin->identifier, failed->plugin->plugin_path);
+		cpi_unlock_context(context);
 	}
 	
 	assert(status != CP_OK || n == 0 || extensions[n - 1] != NULL);
@@ -497,60 +932,400 @@ CP_C_API cp_extension_t ** cp_get_extensions_info(cp_context_t *context, const c
 	return extensions;
 }
 
+CP_C_API cp_extension_t ** cp_get_extensions_info(cp_context_t *context, const char *extpt_id, cp_status_t *error, int *num) {
+	CHECK_NOT_NULL(context);
+	return get_extensions_info(context, extpt_id, 0, error, num, __func__);
+}
 
-// Plug-in listeners 
+CP_C_API cp_extension_t ** cp_get_extensions_info_prefix(cp_context_t *context, const char *prefix, cp_status_t *error, int *num) {
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(prefix);
+	return get_extensions_info(context, prefix, 1, error, num, __func__);
+}
+
+
+// Borrowed iteration
+
+CP_C_API int cp_for_each_plugin(cp_context_t *context, cp_plugin_visitor_func_t visitor, void *user_data) {
+	hscan_t scan;
+	hnode_t *hnode;
+	int rc = 0;
+	
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(visitor);
+	cpi_lock_context_shared(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+	hash_scan_begin(&scan, context->env->plugins);
+	while (rc == 0 && (hnode = hash_scan_next(&scan)) != NULL) {
+		cp_plugin_t *rp = hnode_get(hnode);
+		
+		rc = visitor(rp->plugin, user_data);
+	}
+	cpi_unlock_context_shared(context);
+	return rc;
+}
 
 /**
- * Compares plug-in listener holders.
+ * Calls a visitor for each extension in the specified extension array.
  * 
- * @param h1 the first holder to be compared
- * @param h2 the second holder to be compared
- * @return zero if the holders point to the same function, otherwise non-zero
+ * @param ev the extension array
+ * @param visitor the visitor function
+ * @param user_data the user data pointer passed to the visitor
+ * @return the non-zero value returned by the visitor or zero
  */
-static int comp_el_holder(const void *h1, const void *h2) {
-	const el_holder_t *plh1 = h1;
-	const el_holder_t *plh2 = h2;
+static int visit_extensions(const cpi_ptrvec_t *ev, cp_extension_visitor_func_t visitor, void *user_data) {
+	int i;
+	int rc = 0;
 	
-	return (plh1->plugin_listener != plh2->plugin_listener);
+	for (i = 0; rc == 0 && i < ev->num_slots; i++) {
+		cp_extension_t *e = ev->ptrs[i];
+		
+		if (e != NULL) {
+			cpi_load_ext_cfg(e);
+			rc = visitor(e, user_data);
+		}
+	}
+	return rc;
+}
+
+CP_C_API int cp_for_each_extension(cp_context_t *context, const char *extpt_id, cp_extension_visitor_func_t visitor, void *user_data) {
+	hnode_t *hnode;
+	int rc = 0;
+	
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(visitor);
+	cpi_lock_context_shared(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+	if (extpt_id != NULL) {
+		if ((hnode = hash_lookup(context->env->extensions, extpt_id)) != NULL) {
+			rc = visit_extensions(hnode_get(hnode), visitor, user_data);
+		}
+	} else {
+		hscan_t scan;
+		
+		hash_scan_begin(&scan, context->env->extensions);
+		while (rc == 0 && (hnode = hash_scan_next(&scan)) != NULL) {
+			rc = visit_extensions(hnode_get(hnode), visitor, user_data);
+		}
+	}
+	cpi_unlock_context_shared(context);
+	return rc;
+}
+
+CP_C_API void cp_begin_extensions(cp_context_t *context, const char *extpt_id, cp_extension_iter_t *iter) {
+	hnode_t *hnode;
+	
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(extpt_id);
+	CHECK_NOT_NULL(iter);
+	cpi_lock_context_shared(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+	iter->context = context;
+	iter->list = NULL;
+	iter->index = 0;
+	if ((hnode = hash_lookup(context->env->extensions, extpt_id)) != NULL) {
+		iter->list = hnode_get(hnode);
+	}
+}
+
+CP_C_API const cp_extension_t * cp_next_extension(cp_extension_iter_t *iter) {
+	const cpi_ptrvec_t *ev;
+	
+	CHECK_NOT_NULL(iter);
+	assert(cpi_is_context_locked(iter->context));
+	if ((ev = iter->list) == NULL) {
+		return NULL;
+	}
+	while (iter->index < ev->num_slots) {
+		cp_extension_t *e = ev->ptrs[iter->index++];
+		
+		if (e != NULL) {
+			cpi_load_ext_cfg(e);
+			return e;
+		}
+	}
+	return NULL;
+}
+
+CP_C_API cp_cfg_element_t * cp_get_ext_configuration(cp_context_t *context, cp_extension_t *ext, cp_status_t *error) {
+	cp_status_t status;
+	
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(ext);
+	if ((status = cpi_load_ext_cfg(ext)) != CP_OK) {
+		cpi_lock_context(context);
+		cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+		cpi_errorf(context, N_("Configuration of an extension of plug-in %s could not be loaded from %s."),
+			ext->plugin->identifier, ext->plugin->plugin_path);
+		cpi_unlock_context(context);
+	}
+	if (error != NULL) {
+		*error = status;
+	}
+	return (status == CP_OK ? ext->configuration : NULL);
+}
+
+CP_C_API void cp_end_extensions(cp_extension_iter_t *iter) {
+	CHECK_NOT_NULL(iter);
+	assert(iter->context != NULL);
+	cpi_unlock_context_shared(iter->context);
+	iter->context = NULL;
+	iter->list = NULL;
+	iter->index = 0;
+}
+
+
+// Batch plug-in listeners
+
+static int comp_bel_holder(const void *h1, const void *h2) {
+	const bel_holder_t *blh1 = h1;
+	const bel_holder_t *blh2 = h2;
+	
+	return (blh1->listener != blh2->listener);
 }
 
 /**
- * Processes a node by delivering the specified event to the associated
- * plug-in listener.
+ * Waits for an ongoing batch delivery to complete. The context must be
+ * locked.
  * 
- * @param list the list being processed
- * @param node the node being processed
- * @param event the event
+ * @param context the plug-in context
  */
-static void process_event(list_t *list, lnode_t *node, void *event) {
-	el_holder_t *h = lnode_get(node);
-	cpi_plugin_event_t *e = event;
-	h->plugin_listener(e->plugin_id, e->old_state, e->new_state, h->user_data);
+static void wait_batch_delivery(cp_context_t *context) {
+#ifdef CP_THREADS
+	while (context->env->in_batch_delivery) {
+		cpi_wait_context(context);
+	}
+#endif
 }
 
 /**
- * Processes a node by unregistering the associated plug-in listener.
+ * Invokes the batch listeners. The context must be locked and the batch
+ * delivery flag must be set to prevent changes to the listener list.
+ * 
+ * @param env the plug-in environment
+ * @param events the events
+ * @param num_events the number of events
+ */
+static void invoke_batch_listeners(cp_plugin_env_t *env, const cp_plugin_event_t *events, unsigned int num_events) {
+	lnode_t *node;
+	
+	assert(env->in_batch_delivery);
+	node = list_first(env->batch_listeners);
+	while (node != NULL) {
+		bel_holder_t *h = lnode_get(node);
+		
+		h->listener(events, num_events, h->user_data);
+		node = list_next(env->batch_listeners, node);
+	}
+}
+
+#ifdef CP_THREADS
+
+/**
+ * Delivers queued events to the batch listeners in batches until the
+ * dispatcher is shut down and there are no more queued events. The queue
+ * and the batch buffers are swapped for each batch so that events can be
+ * queued while the listeners are being invoked without the context lock.
+ * 
+ * @param arg the plug-in environment
+ */
+static void dispatch_events(void *arg) {
+	cp_plugin_env_t *env = arg;
+	cp_context_t context;
+	
+	memset(&context, 0, sizeof(context));
+	context.env = env;
+	cpi_lock_context(&context);
+	while (env->num_queued_events > 0 || !env->event_dispatcher_shutdown) {
+		cp_plugin_event_t *batch;
+		unsigned int num_events, size;
+		unsigned int i;
+		
+		// Wait for events
+		if (env->num_queued_events == 0) {
+			cpi_wait_context(&context);
+			continue;
+		}
+		
+		// Take the queued events as a batch
+		batch = env->event_queue;
+		size = env->event_queue_size;
+		num_events = env->num_queued_events;
+		env->event_queue = env->event_batch;
+		env->event_queue_size = env->event_batch_size;
+		env->num_queued_events = 0;
+		env->event_batch = NULL;
+		env->event_batch_size = 0;
+		env->in_batch_delivery = 1;
+		
+		// Deliver the batch without the context lock
+		cpi_unlock_context(&context);
+		invoke_batch_listeners(env, batch, num_events);
+		cpi_lock_context(&context);
+		
+		// Release the batch and reuse the buffer
+		for (i = 0; i < num_events; i++) {
+			cpi_release_string(env->strings, batch[i].plugin_id);
+		}
+		env->event_batch = batch;
+		env->event_batch_size = size;
+		env->in_batch_delivery = 0;
+		cpi_signal_context(&context);
+	}
+	cpi_unlock_context(&context);
+}
+
+#endif
+
+/**
+ * Queues events for the event dispatcher thread or, if it is not running,
+ * delivers them synchronously to the batch listeners as a single batch.
+ * The context must be locked.
+ * 
+ * @param context the plug-in context
+ * @param events the events
+ * @param num_events the number of events
+ */
+static void queue_batch_events(cp_context_t *context, const cpi_plugin_event_t *events, unsigned int num_events) {
+	cp_plugin_env_t *env = context->env;
+	cp_plugin_event_t e;
+	cp_plugin_event_t *batch;
+	unsigned int i;
+	
+#ifdef CP_THREADS
+	if (env->event_dispatcher != NULL && !env->event_dispatcher_shutdown) {
+		
+		// Enlarge the queue if necessary
+		if (env->num_queued_events + num_events > env->event_queue_size) {
+			cp_plugin_event_t *nq;
+			unsigned int ns;
+			
+			ns = (env->event_queue_size > 0 ? env->event_queue_size : EVENT_QUEUE_INITIAL_SIZE);
+			while (ns < env->num_queued_events + num_events) {
+				ns *= 2;
+			}
+			if ((nq = realloc(env->event_queue, ns * sizeof(cp_plugin_event_t))) == NULL) {
+				cpi_errorf(context, N_("A plug-in event for %s could not be queued due to insufficient memory."), events[0].plugin_id);
+				return;
+			}
+			env->event_queue = nq;
+			env->event_queue_size = ns;
+		}
+		
+		// Append the events, keeping the plug-in identifiers until delivered
+		for (i = 0; i < num_events; i++) {
+			if ((e.plugin_id = cpi_intern_string(env->strings, events[i].plugin_id)) == NULL) {
+				cpi_errorf(context, N_("A plug-in event for %s could not be queued due to insufficient memory."), events[i].plugin_id);
+				continue;
+			}
+			e.old_state = events[i].old_state;
+			e.new_state = events[i].new_state;
+			env->event_queue[env->num_queued_events++] = e;
+		}
+		cpi_signal_context(context);
+		return;
+	}
+#endif
+	
+	// Deliver synchronously, one event at a time if out of memory
+	if (num_events == 1 || (batch = malloc(num_events * sizeof(cp_plugin_event_t))) == NULL) {
+		batch = &e;
+	}
+	env->in_event_listener_invocation++;
+	env->in_batch_delivery = 1;
+	for (i = 0; i < num_events; i++) {
+		cp_plugin_event_t *be = (batch == &e ? &e : batch + i);
+		
+		be->plugin_id = events[i].plugin_id;
+		be->old_state = events[i].old_state;
+		be->new_state = events[i].new_state;
+		if (batch == &e) {
+			invoke_batch_listeners(env, &e, 1);
+		}
+	}
+	if (batch != &e) {
+		invoke_batch_listeners(env, batch, num_events);
+		free(batch);
+	}
+	env->in_batch_delivery = 0;
+	env->in_event_listener_invocation--;
+}
+
+/**
+ * Unregisters the batch listener of the specified list node.
+ * 
+ * @param nodes the node pool of the list
+ * @param list the list
+ * @param node the node
+ */
+static void unregister_batch_plistener(cpi_node_pool_t *nodes, list_t *list, lnode_t *node) {
+	bel_holder_t *h = lnode_get(node);
+	
+	list_delete(list, node);
+	cpi_destroy_lnode(nodes, node);
+	free(h);
+}
+
+/**
+ * Processes a node by unregistering the associated batch listener.
  * 
  * @param list the list being processed
  * @param node the node being processed
- * @param plugin plugin whose listeners are to be unregistered or NULL for all
+ * @param arg the unregistration arguments
  */
-static void process_unregister_plistener(list_t *list, lnode_t *node, void *plugin) {
-	el_holder_t *h = lnode_get(node);
-	if (plugin == NULL || h->plugin == plugin) {
-		list_delete(list, node);
-		lnode_destroy(node);
-		free(h);
+static void process_unregister_batch_plistener(list_t *list, lnode_t *node, void *arg) {
+	const unregister_args_t *args = arg;
+	bel_holder_t *h = lnode_get(node);
+	
+	if (args->plugin == NULL || h->plugin == args->plugin) {
+		unregister_batch_plistener(args->nodes, list, node);
+	}
+}
+
+CP_HIDDEN void cpi_unregister_batch_plisteners(cp_context_t *context, cp_plugin_t *plugin) {
+	unregister_args_t args;
+	lnode_t *node;
+	
+	assert(cpi_is_context_locked(context));
+	
+	// Check if there are listeners to be unregistered
+	node = list_first(context->env->batch_listeners);
+	while (node != NULL
+		&& plugin != NULL
+		&& ((bel_holder_t *) lnode_get(node))->plugin != plugin) {
+		node = list_next(context->env->batch_listeners, node);
 	}
+	if (node == NULL) {
+		return;
+	}
+	
+	wait_batch_delivery(context);
+	args.nodes = context->env->nodes;
+	args.plugin = plugin;
+	list_process(context->env->batch_listeners, &args, process_unregister_batch_plistener);
 }
 
-CP_HIDDEN void cpi_unregister_plisteners(list_t *listeners, cp_plugin_t *plugin) {
-	list_process(listeners, plugin, process_unregister_plistener);
+CP_HIDDEN void cpi_stop_event_dispatcher(cp_context_t *context) {
+#ifdef CP_THREADS
+	cpi_thread_t *dispatcher;
+	
+	cpi_lock_context(context);
+	dispatcher = context->env->event_dispatcher;
+	context->env->event_dispatcher_shutdown = 1;
+	cpi_signal_context(context);
+	cpi_unlock_context(context);
+	if (dispatcher != NULL) {
+		cpi_join_thread(dispatcher);
+		cpi_lock_context(context);
+		context->env->event_dispatcher = NULL;
+		cpi_unlock_context(context);
+	}
+#endif
 }
 
-CP_C_API cp_status_t cp_register_plistener(cp_context_t *context, cp_plugin_listener_func_t listener, void *user_data) {
+CP_C_API cp_status_t cp_register_batch_plistener(cp_context_t *context, cp_batch_plistener_func_t listener, void *user_data) {
 	cp_status_t status = CP_ERR_RESOURCE;
-	el_holder_t *holder;
+	bel_holder_t *holder;
 	lnode_t *node;
 
 	CHECK_NOT_NULL(context);
@@ -558,134 +1333,634 @@ CP_C_API cp_status_t cp_register_plistener(cp_context_t *context, cp_plugin_list
 	
 	cpi_lock_context(context);
 	cpi_check_invocation(context, CPI_CF_LOGGER | CPI_CF_LISTENER, __func__);
-	if ((holder = malloc(sizeof(el_holder_t))) != NULL) {
-		holder->plugin_listener = listener;
+	wait_batch_delivery(context);
+	if ((holder = malloc(sizeof(bel_holder_t))) != NULL) {
+		holder->listener = listener;
 		holder->plugin = context->plugin;
 		holder->user_data = user_data;
-		if ((node = lnode_create(holder)) != NULL) {
-			list_append(context->env->plugin_listeners, node);
+		if ((node = cpi_create_lnode(context->env->nodes, holder)) != NULL) {
+			list_append(context->env->batch_listeners, node);
 			status = CP_OK;
 		} else {
 			free(holder);
 		}
 	}
 	
+	// Start the event dispatcher, falling back to synchronous delivery
+#ifdef CP_THREADS
+	if (status == CP_OK
+		&& context->env->event_dispatcher == NULL
+		&& !context->env->event_dispatcher_shutdown
+		&& (context->env->event_dispatcher = cpi_create_thread(dispatch_events, context->env)) == NULL) {
+		cpi_warn(context, N_("The plug-in event dispatcher thread could not be started; batch listeners are invoked synchronously."));
+	}
+#endif
+	
 	// Report error or success
 	if (status != CP_OK) {
-		cpi_error(context, N_("A plug-in listener could not be registered due to insufficient memory."));
-	} else if (cpi_is_logged(context, CP_LOG_DEBUG)) {
-		char owner[64];
-		/* TRANSLATORS: %s is the context owner */
-		cpi_debugf(context, N_("%s registered a plug-in listener."), cpi_context_owner(context, owner, sizeof(owner)));
+		cpi_error(context, N_("A batch plug-in listener could not be registered due to insufficient memory."));
+	} else {
+		cpi_debugm(context, CP_MSG_BATCH_LISTENER_REGISTERED, NULL, NULL, NULL, 0);
 	}
 	cpi_unlock_context(context);
 	
 	return status;
 }
 
-CP_C_API void cp_unregister_plistener(cp_context_t *context, cp_plugin_listener_func_t listener) {
-	el_holder_t holder;
+CP_C_API void cp_unregister_batch_plistener(cp_context_t *context, cp_batch_plistener_func_t listener) {
+	bel_holder_t holder;
 	lnode_t *node;
 	
 	CHECK_NOT_NULL(context);
-	holder.plugin_listener = listener;
+	holder.listener = listener;
 	cpi_lock_context(context);
 	cpi_check_invocation(context, CPI_CF_LOGGER | CPI_CF_LISTENER, __func__);
-	node = list_find(context->env->plugin_listeners, &holder, comp_el_holder);
+	wait_batch_delivery(context);
+	node = list_find(context->env->batch_listeners, &holder, comp_bel_holder);
 	if (node != NULL) {
-		process_unregister_plistener(context->env->plugin_listeners, node, NULL);
-	}
-	if (cpi_is_logged(context, CP_LOG_DEBUG)) {
-		char owner[64];
-		/* TRANSLATORS: %s is the context owner */
-		cpi_debugf(context, N_("%s unregistered a plug-in listener."), cpi_context_owner(context, owner, sizeof(owner)));
+		unregister_batch_plistener(context->env->nodes, context->env->batch_listeners, node);
 	}
+	cpi_debugm(context, CP_MSG_BATCH_LISTENER_UNREGISTERED, NULL, NULL, NULL, 0);
 	cpi_unlock_context(context);
 }
 
-CP_HIDDEN void cpi_deliver_event(cp_context_t *context, const cpi_plugin_event_t *event) {
-	assert(event != NULL);
-	assert(event->plugin_id != NULL);
+CP_C_API void cp_flush_plugin_events(cp_context_t *context) {
+	CHECK_NOT_NULL(context);
 	cpi_lock_context(context);
-	context->env->in_event_listener_invocation++;
-	list_process(context->env->plugin_listeners, (void *) event, process_event);
-	context->env->in_event_listener_invocation--;
-	cpi_unlock_context(context);
-	if (cpi_is_logged(context, CP_LOG_INFO)) {
-		char *str;
-		switch (event->new_state) {
-			case CP_PLUGIN_UNINSTALLED:
-				str = N_("Plug-in %s has been uninstalled.");
-				break;
-			case CP_PLUGIN_INSTALLED:
-				if (event->old_state < CP_PLUGIN_INSTALLED) {
-					str = N_("Plug-in %s has been installed.");
-				} else {
-					str = N_("Plug-in %s runtime library has been unloaded.");
-				}
-				break;
-			case CP_PLUGIN_RESOLVED:
-				if (event->old_state < CP_PLUGIN_RESOLVED) {
-					str = N_("Plug-in %s runtime library has been loaded.");
-				} else {
-					str = N_("Plug-in %s has been stopped.");
-				}
-				break;
-			case CP_PLUGIN_STARTING:
-				str = N_("Plug-in %s is starting.");
-				break;
-			case CP_PLUGIN_STOPPING:
-				str = N_("Plug-in %s is stopping.");
-				break;
-			case CP_PLUGIN_ACTIVE:
-				str = N_("Plug-in %s has been started.");
-				break;
-			default:
-				str = NULL;
-				break;
-		}
-		if (str != NULL) {
-			cpi_infof(context, str, event->plugin_id);
-		}
+	cpi_check_invocation(context, CPI_CF_LOGGER | CPI_CF_LISTENER, __func__);
+#ifdef CP_THREADS
+	while (context->env->event_dispatcher != NULL
+		&& (context->env->num_queued_events > 0 || context->env->in_batch_delivery)) {
+		cpi_wait_context(context);
 	}
+#endif
+	cpi_unlock_context(context);
 }
 
+// Plug-in listeners 
 
-// Configuration element helpers
-
-static cp_cfg_element_t * lookup_cfg_element(cp_cfg_element_t *base, const char *path, int len) {
-	int start = 0;
-	
-	CHECK_NOT_NULL(base);
-	CHECK_NOT_NULL(path);
+/**
+ * Compares plug-in listener holders.
+ * 
+ * @param h1 the first holder to be compared
+ * @param h2 the second holder to be compared
+ * @return zero if the holders point to the same function, otherwise non-zero
+ */
+static int comp_el_holder(const void *h1, const void *h2) {
+	const el_holder_t *plh1 = h1;
+	const el_holder_t *plh2 = h2;
 	
-	// Traverse the path
-	while (base != NULL && path[start] != '\0' && (len == -1 || start < len)) {
-		int end = start;
-		while (path[end] != '\0' && path[end] != '/' && (len == -1 || end < len))
-			end++;
-		if (end - start == 2 && !strncmp(path + start, "..", 2)) {
-			base = base->parent;
-		} else {
-			int i;
-			int found = 0;
-			
-			for (i = 0; !found && i < base->num_children; i++) {
-				cp_cfg_element_t *e = base->children + i;
-				if (end - start == strlen(e->name)
-					&& !strncmp(path + start, e->name, end - start)) {
-					base = e;
-					found = 1;
-				}
-			}
-			if (!found) {
-				base = NULL;
-			}
-		}
-		start = end;
-		if (path[start] == '/') {
-			start++;
-		}
+	return (plh1->plugin_listener != plh2->plugin_listener);
+}
+
+/**
+ * Compares plug-in listener holders by the listener and the user data.
+ *
+ * @param h1 the first holder to be compared
+ * @param h2 the second holder to be compared
+ * @return zero if the holders point to the same registration, non-zero otherwise
+ */
+static int comp_el_holder_data(const void *h1, const void *h2) {
+	const el_holder_t *plh1 = h1;
+	const el_holder_t *plh2 = h2;
+
+	return (plh1->plugin_listener != plh2->plugin_listener
+		|| plh1->user_data != plh2->user_data);
+}
+
+/**
+ * Processes a node by delivering the specified event to the associated
+ * plug-in listener if the listener is interested in it.
+ * 
+ * @param list the list being processed
+ * @param node the node being processed
+ * @param event the event
+ */
+static void process_event(list_t *list, lnode_t *node, void *event) {
+	el_holder_t *h = lnode_get(node);
+	cpi_plugin_event_t *e = event;
+	if ((h->state_mask & CP_STATE_MASK(e->new_state))
+		&& (h->prefix_len == 0 || !strncmp(e->plugin_id, h->plugin_id, h->prefix_len))) {
+		h->plugin_listener(e->plugin_id, e->old_state, e->new_state, h->user_data);
+	}
+}
+
+/**
+ * Unregisters the plug-in listener of the specified list node.
+ * 
+ * @param nodes the node pool of the list
+ * @param list the list
+ * @param node the node
+ */
+static void unregister_plistener(cpi_node_pool_t *nodes, list_t *list, lnode_t *node) {
+	el_holder_t *h = lnode_get(node);
+	
+	list_delete(list, node);
+	cpi_destroy_lnode(nodes, node);
+	free(h);
+}
+
+/**
+ * Processes a node by unregistering the associated plug-in listener.
+ * 
+ * @param list the list being processed
+ * @param node the node being processed
+ * @param arg the unregistration arguments
+ */
+static void process_unregister_plistener(list_t *list, lnode_t *node, void *arg) {
+	const unregister_args_t *args = arg;
+	el_holder_t *h = lnode_get(node);
+	
+	if (args->plugin == NULL || h->plugin == args->plugin) {
+		unregister_plistener(args->nodes, list, node);
+	}
+}
+
+/**
+ * Removes an emptied listener list from the identifier index while
+ * scanning the index.
+ * 
+ * @param env the plug-in environment
+ * @param hnode the index node
+ */
+static void remove_plistener_index(cp_plugin_env_t *env, hnode_t *hnode) {
+	list_t *list = hnode_get(hnode);
+	const char *id = hnode_getkey(hnode);
+	
+	assert(list_isempty(list));
+	hash_scan_delfree(env->plisteners_by_id, hnode);
+	list_destroy(list);
+	cpi_release_string(env->strings, id);
+}
+
+CP_HIDDEN void cpi_unregister_plisteners(cp_plugin_env_t *env, cp_plugin_t *plugin) {
+	unregister_args_t args;
+	hscan_t scan;
+	hnode_t *hnode;
+	
+	args.nodes = env->nodes;
+	args.plugin = plugin;
+	list_process(env->plugin_listeners, &args, process_unregister_plistener);
+	list_process(env->prefix_plisteners, &args, process_unregister_plistener);
+	hash_scan_begin(&scan, env->plisteners_by_id);
+	while ((hnode = hash_scan_next(&scan)) != NULL) {
+		list_t *list = hnode_get(hnode);
+		
+		list_process(list, &args, process_unregister_plistener);
+		if (list_isempty(list)) {
+			remove_plistener_index(env, hnode);
+		}
+	}
+}
+
+/**
+ * Registers a plug-in listener with the specified filter.
+ * 
+ * @param context the plug-in context
+ * @param listener the plug-in listener
+ * @param user_data user data pointer supplied to the listener
+ * @param plugin_id the plug-in identifier or prefix of interest, or NULL for all
+ * @param prefix whether @a plugin_id is a prefix
+ * @param state_mask mask of the new plug-in states of interest
+ * @param func the name of the API function
+ * @return CP_OK (zero) on success or CP_ERR_RESOURCE if out of resources
+ */
+static cp_status_t register_plistener(cp_context_t *context, cp_plugin_listener_func_t listener, void *user_data, const char *plugin_id, int prefix, unsigned int state_mask, const char *func) {
+	cp_status_t status = CP_ERR_RESOURCE;
+	el_holder_t *holder = NULL;
+	lnode_t *node = NULL;
+	size_t len;
+
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER | CPI_CF_LISTENER, func);
+	len = (plugin_id != NULL && prefix ? strlen(plugin_id) : 0);
+	do {
+		list_t *list;
+		
+		// Allocate the holder, followed by the prefix, if any
+		if ((holder = malloc(sizeof(el_holder_t) + (len > 0 ? len + 1 : 0))) == NULL
+			|| (node = cpi_create_lnode(context->env->nodes, holder)) == NULL) {
+			break;
+		}
+		holder->plugin_listener = listener;
+		holder->plugin = context->plugin;
+		holder->user_data = user_data;
+		holder->state_mask = state_mask;
+		holder->plugin_id = NULL;
+		holder->prefix_len = 0;
+		
+		// Choose the listener list
+		if (plugin_id == NULL || (prefix && len == 0)) {
+			list = context->env->plugin_listeners;
+		} else if (prefix) {
+			char *p = (char *) (holder + 1);
+			
+			memcpy(p, plugin_id, len + 1);
+			holder->plugin_id = p;
+			holder->prefix_len = len;
+			list = context->env->prefix_plisteners;
+		} else {
+			hnode_t *hnode;
+			
+			if ((hnode = hash_lookup(context->env->plisteners_by_id, plugin_id)) != NULL) {
+				list = hnode_get(hnode);
+				holder->plugin_id = hnode_getkey(hnode);
+			} else {
+				const char *id;
+				
+				if ((id = cpi_intern_string(context->env->strings, plugin_id)) == NULL) {
+					break;
+				}
+				if ((list = list_create(LISTCOUNT_T_MAX)) == NULL) {
+					cpi_release_string(context->env->strings, id);
+					break;
+				}
+				if (!hash_alloc_insert(context->env->plisteners_by_id, id, list)) {
+					list_destroy(list);
+					cpi_release_string(context->env->strings, id);
+					break;
+				}
+				holder->plugin_id = id;
+			}
+		}
+		list_append(list, node);
+		status = CP_OK;
+	} while (0);
+	
+	// Report error or success
+	if (status != CP_OK) {
+		cpi_error(context, N_("A plug-in listener could not be registered due to insufficient memory."));
+	} else {
+		cpi_debugm(context, CP_MSG_LISTENER_REGISTERED, NULL, NULL, NULL, 0);
+	}
+	
+	// Release resources on failure
+	if (status != CP_OK) {
+		if (node != NULL) {
+			cpi_destroy_lnode(context->env->nodes, node);
+		}
+		free(holder);
+	}
+	cpi_unlock_context(context);
+	
+	return status;
+}
+
+CP_C_API cp_status_t cp_register_plistener(cp_context_t *context, cp_plugin_listener_func_t listener, void *user_data) {
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(listener);
+	return register_plistener(context, listener, user_data, NULL, 0, CP_STATE_MASK_ALL, __func__);
+}
+
+CP_C_API cp_status_t cp_register_plistener_filtered(cp_context_t *context, cp_plugin_listener_func_t listener, void *user_data, const char *plugin_id, int prefix, unsigned int state_mask) {
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(listener);
+	return register_plistener(context, listener, user_data, plugin_id, prefix, state_mask, __func__);
+}
+
+/**
+ * Removes the first plug-in listener registration matching the specified
+ * holder.
+ *
+ * @param context the plug-in context
+ * @param holder the holder to be matched
+ * @param comp the holder comparison function
+ * @param func the name of the API function
+ */
+static void unregister_matching_plistener(cp_context_t *context, const el_holder_t *holder, int (*comp)(const void *, const void *), const char *func) {
+	lnode_t *node;
+	
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER | CPI_CF_LISTENER, func);
+	if ((node = list_find(context->env->plugin_listeners, holder, comp)) != NULL) {
+		unregister_plistener(context->env->nodes, context->env->plugin_listeners, node);
+	} else if ((node = list_find(context->env->prefix_plisteners, holder, comp)) != NULL) {
+		unregister_plistener(context->env->nodes, context->env->prefix_plisteners, node);
+	} else {
+		hscan_t scan;
+		hnode_t *hnode;
+		
+		// Look for a listener filtering by plug-in identifier
+		hash_scan_begin(&scan, context->env->plisteners_by_id);
+		while ((hnode = hash_scan_next(&scan)) != NULL) {
+			list_t *list = hnode_get(hnode);
+			
+			if ((node = list_find(list, holder, comp)) != NULL) {
+				unregister_plistener(context->env->nodes, list, node);
+				if (list_isempty(list)) {
+					remove_plistener_index(context->env, hnode);
+				}
+				break;
+			}
+		}
+	}
+	cpi_debugm(context, CP_MSG_LISTENER_UNREGISTERED, NULL, NULL, NULL, 0);
+	cpi_unlock_context(context);
+}
+
+CP_C_API void cp_unregister_plistener(cp_context_t *context, cp_plugin_listener_func_t listener) {
+	el_holder_t holder;
+	
+	CHECK_NOT_NULL(context);
+	holder.plugin_listener = listener;
+	unregister_matching_plistener(context, &holder, comp_el_holder, __func__);
+}
+
+CP_C_API void cp_unregister_plistener_data(cp_context_t *context, cp_plugin_listener_func_t listener, void *user_data) {
+	el_holder_t holder;
+	
+	CHECK_NOT_NULL(context);
+	holder.plugin_listener = listener;
+	holder.user_data = user_data;
+	unregister_matching_plistener(context, &holder, comp_el_holder_data, __func__);
+}
+
+CP_HIDDEN void cpi_deliver_event(cp_context_t *context, const cpi_plugin_event_t *event) {
+	cpi_deliver_events(context, event, 1);
+}
+
+CP_HIDDEN void cpi_deliver_events(cp_context_t *context, const cpi_plugin_event_t *events, unsigned int num_events) {
+	unsigned int i;
+	
+	assert(events != NULL || num_events == 0);
+	if (num_events == 0) {
+		return;
+	}
+	cpi_lock_context(context);
+	context->env->in_event_listener_invocation++;
+	for (i = 0; i < num_events; i++) {
+		const cpi_plugin_event_t *event = events + i;
+		
+		assert(event->plugin_id != NULL);
+		CPI_TRACE3(plugin__state, event->plugin_id, event->old_state, event->new_state);
+		cpi_record_change(context, CP_CHANGE_PLUGIN_STATE, event->plugin_id);
+		if (context->env->num_plugin_handles > 0) {
+			update_plugin_handle(context, event);
+		}
+		list_process(context->env->plugin_listeners, (void *) event, process_event);
+		if (!hash_isempty(context->env->plisteners_by_id)) {
+			hnode_t *hnode;
+			
+			if ((hnode = hash_lookup(context->env->plisteners_by_id, event->plugin_id)) != NULL) {
+				list_process(hnode_get(hnode), (void *) event, process_event);
+			}
+		}
+		list_process(context->env->prefix_plisteners, (void *) event, process_event);
+	}
+	context->env->in_event_listener_invocation--;
+	if (!list_isempty(context->env->batch_listeners)) {
+		queue_batch_events(context, events, num_events);
+	}
+	cpi_unlock_context(context);
+	for (i = 0; i < num_events; i++) {
+		if (cpi_is_logged_about(context, CP_LOG_INFO, events[i].plugin_id)) {
+			cp_log_record_t rec;
+			
+			memset(&rec, 0, sizeof(rec));
+			rec.severity = CP_LOG_INFO;
+			rec.msg_id = CP_MSG_PLUGIN_STATE;
+			rec.plugin_id = events[i].plugin_id;
+			rec.old_state = events[i].old_state;
+			rec.new_state = events[i].new_state;
+			cpi_log_record(context, &rec);
+		}
+	}
+}
+
+
+// Configuration element helpers
+
+/// Returns the block containing the specified children array
+#define CHILDREN_BLOCK(ptr) ((cfg_children_block_t *) ((char *) (ptr) - offsetof(cfg_children_block_t, children)))
+
+/// Returns the block containing the specified attribute array
+#define ATTS_BLOCK(ptr) ((cfg_atts_block_t *) ((char *) (ptr) - offsetof(cfg_atts_block_t, atts)))
+
+CP_HIDDEN cp_cfg_element_t *cpi_alloc_cfg_children(cpi_arena_t *arena, unsigned int num) {
+	cfg_children_block_t *block;
+	
+	assert(num > 0);
+	if ((block = cpi_arena_alloc(arena, offsetof(cfg_children_block_t, children) + num * sizeof(cp_cfg_element_t))) == NULL) {
+		return NULL;
+	}
+	block->sorted = NULL;
+	block->typed = NULL;
+	return block->children;
+}
+
+CP_HIDDEN char **cpi_alloc_cfg_atts(cpi_arena_t *arena, unsigned int num_atts) {
+	cfg_atts_block_t *block;
+	
+	assert(num_atts > 0);
+	if ((block = cpi_arena_alloc(arena, offsetof(cfg_atts_block_t, atts) + 2 * num_atts * sizeof(char *))) == NULL) {
+		return NULL;
+	}
+	block->sorted = NULL;
+	block->typed = NULL;
+	return block->atts;
+}
+
+CP_HIDDEN size_t cpi_cfg_children_offset(void) {
+	return offsetof(cfg_children_block_t, children);
+}
+
+CP_HIDDEN size_t cpi_cfg_atts_offset(void) {
+	return offsetof(cfg_atts_block_t, atts);
+}
+
+CP_HIDDEN cp_cfg_element_t * const *cpi_cfg_children_index(const cp_cfg_element_t *ce) {
+	return (ce->num_children > 0 ? CHILDREN_BLOCK(ce->children)->sorted : NULL);
+}
+
+CP_HIDDEN char ** const *cpi_cfg_atts_index(const cp_cfg_element_t *ce) {
+	return (ce->num_atts > 0 ? ATTS_BLOCK(ce->atts)->sorted : NULL);
+}
+
+static int comp_cfg_children(const void *p1, const void *p2) {
+	const cp_cfg_element_t *e1 = *((const cp_cfg_element_t * const *) p1);
+	const cp_cfg_element_t *e2 = *((const cp_cfg_element_t * const *) p2);
+	int c;
+	
+	// Keep elements with the same name in document order
+	if ((c = strcmp(e1->name, e2->name)) == 0) {
+		c = (e1 < e2 ? -1 : (e1 > e2));
+	}
+	return c;
+}
+
+static int comp_cfg_atts(const void *p1, const void *p2) {
+	return strcmp(**((char ** const *) p1), **((char ** const *) p2));
+}
+
+CP_HIDDEN void cpi_index_cfg_element(cpi_arena_t *arena, cp_cfg_element_t *ce) {
+	unsigned int i;
+	
+	// Reserve room for the values parsed by typed lookups
+	if (ce->num_children > 0) {
+		CHILDREN_BLOCK(ce->children)->typed = cpi_arena_alloc(arena, ce->num_children * sizeof(cfg_typed_t));
+		if (CHILDREN_BLOCK(ce->children)->typed != NULL) {
+			memset(CHILDREN_BLOCK(ce->children)->typed, 0, ce->num_children * sizeof(cfg_typed_t));
+		}
+	}
+	if (ce->num_atts > 0) {
+		ATTS_BLOCK(ce->atts)->typed = cpi_arena_alloc(arena, ce->num_atts * sizeof(cfg_typed_t));
+		if (ATTS_BLOCK(ce->atts)->typed != NULL) {
+			memset(ATTS_BLOCK(ce->atts)->typed, 0, ce->num_atts * sizeof(cfg_typed_t));
+		}
+	}
+	
+	if (ce->num_children >= CFG_INDEX_THRESHOLD) {
+		cp_cfg_element_t **sorted;
+
+		if ((sorted = cpi_arena_alloc(arena, ce->num_children * sizeof(cp_cfg_element_t *))) != NULL) {
+			for (i = 0; i < ce->num_children; i++) {
+				sorted[i] = ce->children + i;
+			}
+			qsort(sorted, ce->num_children, sizeof(cp_cfg_element_t *), comp_cfg_children);
+			CHILDREN_BLOCK(ce->children)->sorted = sorted;
+		}
+	}
+	if (ce->num_atts >= CFG_INDEX_THRESHOLD) {
+		char ***sorted;
+		
+		if ((sorted = cpi_arena_alloc(arena, ce->num_atts * sizeof(char **))) != NULL) {
+			for (i = 0; i < ce->num_atts; i++) {
+				sorted[i] = ce->atts + 2 * i;
+			}
+			qsort(sorted, ce->num_atts, sizeof(char **), comp_cfg_atts);
+			ATTS_BLOCK(ce->atts)->sorted = sorted;
+		}
+	}
+}
+
+/**
+ * Compares a name given as a character sequence to a string.
+ * 
+ * @param name the name
+ * @param len the length of the name
+ * @param str the string
+ * @return less than, equal to or greater than zero when the name sorts
+ * 		before, equal to or after the string, correspondingly
+ */
+static int comp_cfg_name(const char *name, size_t len, const char *str) {
+	int c;
+	
+	if ((c = strncmp(name, str, len)) == 0 && str[len] != '\0') {
+		c = -1;
+	}
+	return c;
+}
+
+/**
+ * Returns the first child element having the specified name.
+ * 
+ * @param base the parent element
+ * @param name the name of the child
+ * @param len the length of the name
+ * @return the child element, or NULL if there is no such child
+ */
+static cp_cfg_element_t *find_cfg_child(cp_cfg_element_t *base, const char *name, size_t len) {
+	cp_cfg_element_t **sorted;
+	unsigned int i;
+	
+	if (base->num_children == 0) {
+		return NULL;
+	}
+	
+	// Binary search for the first matching child using the index
+	if ((sorted = CHILDREN_BLOCK(base->children)->sorted) != NULL) {
+		unsigned int low = 0, high = base->num_children;
+		
+		while (low < high) {
+			unsigned int mid = low + (high - low) / 2;
+			
+			if (comp_cfg_name(name, len, sorted[mid]->name) > 0) {
+				low = mid + 1;
+			} else {
+				high = mid;
+			}
+		}
+		if (low < base->num_children && comp_cfg_name(name, len, sorted[low]->name) == 0) {
+			return sorted[low];
+		}
+		return NULL;
+	}
+	
+	// Otherwise scan the children
+	for (i = 0; i < base->num_children; i++) {
+		cp_cfg_element_t *e = base->children + i;
+		
+		if (!comp_cfg_name(name, len, e->name)) {
+			return e;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Returns the specified attribute.
+ * 
+ * @param e the configuration element
+ * @param attr the attribute name
+ * @return the attribute name followed by its value, or NULL if there is no
+ * 		such attribute
+ */
+static char **find_cfg_attr(cp_cfg_element_t *e, const char *attr) {
+	char ***sorted;
+	unsigned int i;
+	
+	if (e->num_atts == 0) {
+		return NULL;
+	}
+	
+	// Binary search using the index
+	if ((sorted = ATTS_BLOCK(e->atts)->sorted) != NULL) {
+		unsigned int low = 0, high = e->num_atts;
+		
+		while (low < high) {
+			unsigned int mid = low + (high - low) / 2;
+			int c = strcmp(attr, *(sorted[mid]));
+			
+			if (c == 0) {
+				return sorted[mid];
+			} else if (c > 0) {
+				low = mid + 1;
+			} else {
+				high = mid;
+			}
+		}
+		return NULL;
+	}
+	
+	// Otherwise scan the attributes
+	for (i = 0; i < e->num_atts; i++) {
+		if (!strcmp(attr, e->atts[2*i])) {
+			return e->atts + 2*i;
+		}
+	}
+	return NULL;
+}
+
+static cp_cfg_element_t * lookup_cfg_element(cp_cfg_element_t *base, const char *path, int len) {
+	int start = 0;
+	
+	CHECK_NOT_NULL(base);
+	CHECK_NOT_NULL(path);
+	
+	// Traverse the path
+	while (base != NULL && path[start] != '\0' && (len == -1 || start < len)) {
+		int end = start;
+		while (path[end] != '\0' && path[end] != '/' && (len == -1 || end < len))
+			end++;
+		if (end - start == 2 && !strncmp(path + start, "..", 2)) {
+			base = base->parent;
+		} else {
+			base = find_cfg_child(base, path + start, end - start);
+		}
+		start = end;
+		if (path[start] == '/') {
+			start++;
+		}
 	}
 	return base;
 }
@@ -694,33 +1969,336 @@ CP_C_API cp_cfg_element_t * cp_lookup_cfg_element(cp_cfg_element_t *base, const
 	return lookup_cfg_element(base, path, -1);
 }
 
-CP_C_API char * cp_lookup_cfg_value(cp_cfg_element_t *base, const char *path) {
+/**
+ * Returns the parsed values cached for the value of the specified element.
+ * 
+ * @param e the configuration element
+ * @return the parsed values, or NULL if not cached
+ */
+static cfg_typed_t *cfg_value_typed(cp_cfg_element_t *e) {
+	cp_cfg_element_t *parent = e->parent;
+	
+	if (parent == NULL
+		|| e->index >= parent->num_children
+		|| parent->children + e->index != e) {
+		return NULL;
+	}
+	if (CHILDREN_BLOCK(parent->children)->typed == NULL) {
+		return NULL;
+	}
+	return CHILDREN_BLOCK(parent->children)->typed + e->index;
+}
+
+/**
+ * Looks up the value of the specified element or attribute together with
+ * the values cached for it.
+ * 
+ * @param base the base configuration element
+ * @param path the path to the target element or attribute
+ * @param typed filled with the parsed values, or NULL if not cached; may be
+ * 		NULL if not needed
+ * @return the value of the target element or attribute or NULL
+ */
+static char *lookup_cfg_value(cp_cfg_element_t *base, const char *path, cfg_typed_t **typed) {
 	cp_cfg_element_t *e;
 	const char *attr;
+	char **a;
 	
-	CHECK_NOT_NULL(base);
-	CHECK_NOT_NULL(path);
-	
+	if (typed != NULL) {
+		*typed = NULL;
+	}
 	if ((attr = strrchr(path, '@')) == NULL) {
 		e = lookup_cfg_element(base, path, -1);
 	} else {
 		e = lookup_cfg_element(base, path, attr - path);
 		attr++;
 	}
-	if (e != NULL) {
-		if (attr == NULL) {
-			return e->value;
-		} else {
-			int i;
-			
-			for (i = 0; i < e->num_atts; i++) {
-				if (!strcmp(attr, e->atts[2*i])) {
-					return e->atts[2*i + 1];
-				}
-			}
-			return NULL;
+	if (e == NULL) {
+		return NULL;
+	} else if (attr == NULL) {
+		if (typed != NULL) {
+			*typed = cfg_value_typed(e);
+		}
+		return e->value;
+	} else if ((a = find_cfg_attr(e, attr)) != NULL) {
+		if (typed != NULL && ATTS_BLOCK(e->atts)->typed != NULL) {
+			*typed = ATTS_BLOCK(e->atts)->typed + (a - e->atts) / 2;
 		}
+		return a[1];
 	} else {
 		return NULL;
 	}
 }
+
+CP_C_API char * cp_lookup_cfg_value(cp_cfg_element_t *base, const char *path) {
+	CHECK_NOT_NULL(base);
+	CHECK_NOT_NULL(path);
+	return lookup_cfg_value(base, path, NULL);
+}
+
+/**
+ * Checks whether the rest of a parsed value is just white space.
+ * 
+ * @param end the first character not consumed by the parser
+ * @return whether the value was completely parsed
+ */
+static int is_value_end(const char *end) {
+	while (isspace((unsigned char) *end)) {
+		end++;
+	}
+	return (*end == '\0');
+}
+
+/**
+ * Records the result of parsing a cached value. Concurrent lookups may
+ * parse the same value and overwrite each other's flags, which only
+ * causes the value to be parsed again later.
+ * 
+ * @param typed the parsed values
+ * @param flag the CFG_TYPED_* flag to be set
+ */
+static void set_cfg_typed(cfg_typed_t *typed, long flag) {
+	store_typed(typed, load_typed(typed) | flag);
+}
+
+CP_C_API cp_status_t cp_lookup_cfg_int(cp_cfg_element_t *base, const char *path, long *value) {
+	cfg_typed_t *typed;
+	const char *str;
+	char *end;
+	long v;
+	
+	CHECK_NOT_NULL(base);
+	CHECK_NOT_NULL(path);
+	CHECK_NOT_NULL(value);
+	if ((str = lookup_cfg_value(base, path, &typed)) == NULL) {
+		return CP_ERR_UNKNOWN;
+	}
+	
+	// Use the cached value if the value has already been parsed
+	if (typed != NULL) {
+		long state = load_typed(typed);
+		
+		if (state & CFG_TYPED_INT) {
+			*value = typed->int_value;
+			return CP_OK;
+		} else if (state & CFG_TYPED_INT_BAD) {
+			return CP_ERR_MALFORMED;
+		}
+	}
+	
+	errno = 0;
+	v = strtol(str, &end, 10);
+	if (end == str || errno == ERANGE || !is_value_end(end)) {
+		if (typed != NULL) {
+			set_cfg_typed(typed, CFG_TYPED_INT_BAD);
+		}
+		return CP_ERR_MALFORMED;
+	}
+	if (typed != NULL) {
+		typed->int_value = v;
+		set_cfg_typed(typed, CFG_TYPED_INT);
+	}
+	*value = v;
+	return CP_OK;
+}
+
+CP_C_API cp_status_t cp_lookup_cfg_double(cp_cfg_element_t *base, const char *path, double *value) {
+	cfg_typed_t *typed;
+	const char *str;
+	char *end;
+	double v;
+	
+	CHECK_NOT_NULL(base);
+	CHECK_NOT_NULL(path);
+	CHECK_NOT_NULL(value);
+	if ((str = lookup_cfg_value(base, path, &typed)) == NULL) {
+		return CP_ERR_UNKNOWN;
+	}
+	
+	// Use the cached value if the value has already been parsed
+	if (typed != NULL) {
+		long state = load_typed(typed);
+		
+		if (state & CFG_TYPED_DOUBLE) {
+			*value = typed->double_value;
+			return CP_OK;
+		} else if (state & CFG_TYPED_DOUBLE_BAD) {
+			return CP_ERR_MALFORMED;
+		}
+	}
+	
+	errno = 0;
+	v = strtod(str, &end);
+	if (end == str || errno == ERANGE || !is_value_end(end)) {
+		if (typed != NULL) {
+			set_cfg_typed(typed, CFG_TYPED_DOUBLE_BAD);
+		}
+		return CP_ERR_MALFORMED;
+	}
+	if (typed != NULL) {
+		typed->double_value = v;
+		set_cfg_typed(typed, CFG_TYPED_DOUBLE);
+	}
+	*value = v;
+	return CP_OK;
+}
+
+CP_C_API cp_status_t cp_lookup_cfg_bool(cp_cfg_element_t *base, const char *path, int *value) {
+	static const char * const names[] = { "false", "true", "0", "1", "no", "yes", "off", "on" };
+	cfg_typed_t *typed;
+	const char *str;
+	size_t len;
+	unsigned int i;
+	
+	CHECK_NOT_NULL(base);
+	CHECK_NOT_NULL(path);
+	CHECK_NOT_NULL(value);
+	if ((str = lookup_cfg_value(base, path, &typed)) == NULL) {
+		return CP_ERR_UNKNOWN;
+	}
+	
+	// Use the cached value if the value has already been parsed
+	if (typed != NULL) {
+		long state = load_typed(typed);
+		
+		if (state & (CFG_TYPED_FALSE | CFG_TYPED_TRUE)) {
+			*value = ((state & CFG_TYPED_TRUE) != 0);
+			return CP_OK;
+		} else if (state & CFG_TYPED_BOOL_BAD) {
+			return CP_ERR_MALFORMED;
+		}
+	}
+	
+	while (isspace((unsigned char) *str)) {
+		str++;
+	}
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		len = strlen(names[i]);
+		if (!strncmp(str, names[i], len) && is_value_end(str + len)) {
+			if (typed != NULL) {
+				set_cfg_typed(typed, i % 2 ? CFG_TYPED_TRUE : CFG_TYPED_FALSE);
+			}
+			*value = i % 2;
+			return CP_OK;
+		}
+	}
+	if (typed != NULL) {
+		set_cfg_typed(typed, CFG_TYPED_BOOL_BAD);
+	}
+	return CP_ERR_MALFORMED;
+}
+
+/**
+ * Splits a configuration path into segments the same way as
+ * ::lookup_cfg_element traverses it.
+ * 
+ * @param path the path
+ * @param len the length of the path, excluding any attribute
+ * @param segments the segments to be initialized, or NULL to only count them
+ * @return the number of segments
+ */
+static unsigned int split_cfg_path(const char *path, size_t len, cfg_path_segment_t *segments) {
+	unsigned int num = 0;
+	size_t start = 0;
+	
+	while (start < len) {
+		size_t end = start;
+		
+		while (end < len && path[end] != '/') {
+			end++;
+		}
+		if (segments != NULL) {
+			if (end - start == 2 && !strncmp(path + start, "..", 2)) {
+				segments[num].name = NULL;
+			} else {
+				segments[num].name = path + start;
+			}
+			segments[num].len = end - start;
+		}
+		num++;
+		start = end;
+		if (start < len && path[start] == '/') {
+			start++;
+		}
+	}
+	return num;
+}
+
+CP_C_API cp_cfg_path_t * cp_compile_cfg_path(const char *path, cp_status_t *error) {
+	cp_cfg_path_t *cpath = NULL;
+	cp_status_t status = CP_OK;
+	const char *attr;
+	unsigned int num_segments;
+	size_t len;
+	char *data;
+	
+	CHECK_NOT_NULL(path);
+	do {
+		
+		// Count the path segments
+		if ((attr = strrchr(path, '@')) != NULL) {
+			len = attr - path;
+		} else {
+			len = strlen(path);
+		}
+		num_segments = split_cfg_path(path, len, NULL);
+		
+		// Allocate the compiled path and a copy of the path data
+		if ((cpath = malloc(offsetof(cp_cfg_path_t, segments)
+				+ (num_segments + 1) * sizeof(cfg_path_segment_t)
+				+ (strlen(path) + 1) * sizeof(char))) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		data = (char *) (cpath->segments + num_segments + 1);
+		strcpy(data, path);
+		cpath->attr = (attr != NULL ? data + (attr - path) + 1 : NULL);
+		
+		// Split the path into segments
+		cpath->num_segments = split_cfg_path(data, len, cpath->segments);
+		assert(cpath->num_segments == num_segments);
+		
+	} while (0);
+	
+	if (error != NULL) {
+		*error = status;
+	}
+	return cpath;
+}
+
+CP_C_API cp_cfg_element_t * cp_lookup_cfg_compiled(cp_cfg_element_t *base, const cp_cfg_path_t *path) {
+	unsigned int i;
+	
+	CHECK_NOT_NULL(base);
+	CHECK_NOT_NULL(path);
+	
+	for (i = 0; base != NULL && i < path->num_segments; i++) {
+		const cfg_path_segment_t *seg = path->segments + i;
+		
+		if (seg->name == NULL) {
+			base = base->parent;
+		} else {
+			base = find_cfg_child(base, seg->name, seg->len);
+		}
+	}
+	return base;
+}
+
+CP_C_API char * cp_lookup_cfg_value_compiled(cp_cfg_element_t *base, const cp_cfg_path_t *path) {
+	cp_cfg_element_t *e;
+	
+	if ((e = cp_lookup_cfg_compiled(base, path)) == NULL) {
+		return NULL;
+	} else if (path->attr == NULL) {
+		return e->value;
+	} else {
+		char **a = find_cfg_attr(e, path->attr);
+		
+		return (a != NULL ? a[1] : NULL);
+	}
+}
+
+CP_C_API void cp_free_cfg_path(cp_cfg_path_t *path) {
+	CHECK_NOT_NULL(path);
+	free(path);
+}
@@ -38,11 +38,180 @@
 #include <fcntl.h>
 #include <dirent.h>
 #include <errno.h>
+#include <time.h>
 #include "cpluff.h"
 #include "defines.h"
 #include "util.h"
 #include "internal.h"
 
+#if defined(CP_THREADS) && defined(HAVE_STAT) && defined(HAVE_SYS_INOTIFY_H) && defined(HAVE_POLL_H)
+#define LPL_WATCH
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+
+/* ------------------------------------------------------------------------
+ * Constants
+ * ----------------------------------------------------------------------*/
+
+/// The longest delay of a scan after the first change, in debounce periods
+#define WATCH_MAX_DELAY_PERIODS 4
+
+
+/* ------------------------------------------------------------------------
+ * Data types
+ * ----------------------------------------------------------------------*/
+
+/// Local plug-in loader data
+typedef struct lpl_data_t {
+	
+	/// The registered plug-in directories
+	list_t *dirs;
+	
+	/// The number of threads used for parsing descriptors (0 or 1 for none)
+	unsigned int num_scan_threads;
+	
+	/// The descriptor stamps of the previous scan, keyed by descriptor file
+	hash_t *stamps;
+	
+	/// The context the descriptor stamps were recorded for
+	cp_context_t *stamps_context;
+	
+	/// The number of scans performed, used to detect removed descriptors
+	unsigned int scan_gen;
+	
+	/// The watch of the registered directories or NULL if not watching
+	struct lpl_watch_t *watch;
+} lpl_data_t;
+
+/// The recorded state of a plug-in descriptor at the time it was scanned
+typedef struct desc_stamp_t {
+	
+	/// The descriptor file, also used as the key
+	char *file;
+	
+	/// The device of the descriptor file
+	dev_t dev;
+	
+	/// The inode of the descriptor file
+	ino_t ino;
+	
+	/// The size of the descriptor file
+	off_t size;
+	
+	/// The modification time of the descriptor file
+	time_t mtime;
+	
+	/**
+	 * Whether the descriptor was modified during the second it was scanned,
+	 * in which case a later modification could go unnoticed
+	 */
+	int racy;
+	
+	/// The scan generation during which the descriptor was last seen
+	unsigned int seen;
+} desc_stamp_t;
+
+#ifdef CP_THREADS
+
+/// A descriptor parsing job of a parallel scan
+typedef struct scan_job_t {
+	
+	/// The plug-in path
+	const char *path;
+	
+	/// The parsed plug-in or NULL on failure
+	cp_plugin_info_t *plugin;
+	
+	/// The messages logged while parsing
+	list_t log;
+	
+	/// Whether the descriptor has been parsed
+	int done;
+} scan_job_t;
+
+/// Shared state of a parallel scan
+typedef struct scan_pool_t {
+	
+	/// The plug-in context
+	cp_context_t *context;
+	
+	/// The mutex protecting the next job index and the completion flags,
+	/// signaled when a job completes
+	cpi_mutex_t *mutex;
+	
+	/// The jobs
+	scan_job_t *jobs;
+	
+	/// The number of jobs
+	size_t num_jobs;
+	
+	/// The index of the next unclaimed job
+	size_t next_job;
+} scan_pool_t;
+
+#endif //CP_THREADS
+
+#ifdef LPL_WATCH
+
+/// A watched directory
+typedef struct watch_entry_t {
+	
+	/// The inotify watch descriptor, also used as the key
+	int wd;
+	
+	/// The path of the directory
+	char *path;
+	
+	/// Whether this is a registered directory rather than a plug-in directory
+	int collection;
+} watch_entry_t;
+
+/**
+ * A watch of the directories registered with a local plug-in loader. The
+ * watched directories are only accessed by the watch thread while the
+ * changed paths and the flags are protected by the framework lock.
+ */
+typedef struct lpl_watch_t {
+	
+	/// The local plug-in loader data
+	lpl_data_t *lpl;
+	
+	/// The plug-in context to be scanned
+	cp_context_t *context;
+	
+	/// The flags for scanning
+	int flags;
+	
+	/// The number of milliseconds without changes before scanning
+	unsigned int debounce_ms;
+	
+	/// The inotify file descriptor
+	int fd;
+	
+	/// A pipe used to wake up the watch thread
+	int wake[2];
+	
+	/// The watch thread
+	cpi_thread_t *thread;
+	
+	/// The watched directories, keyed by watch descriptor
+	hash_t *entries;
+	
+	/// The plug-in paths changed since the previous scan
+	hash_t *changed;
+	
+	/// Whether changes may have been missed since the previous full scan
+	int needs_full;
+	
+	/// Whether some plug-in directories could not be watched
+	int incomplete;
+} lpl_watch_t;
+
+#endif //LPL_WATCH
+
 
 /* ------------------------------------------------------------------------
  * Variables
@@ -57,9 +226,13 @@ static list_t *local_ploaders = NULL;
  * ----------------------------------------------------------------------*/
 
 static cp_plugin_info_t **lpl_scan_plugins(void *data, cp_context_t *ctx);
+static cp_plugin_info_t **lpl_scan_changed_plugins(void *data, cp_context_t *ctx);
+static void clear_stamps(hash_t *stamps);
+static void dirs_changed(lpl_data_t *lpl);
 
 CP_C_API cp_plugin_loader_t *cp_create_local_ploader(cp_status_t *error) {
 	cp_plugin_loader_t *loader = NULL;
+	lpl_data_t *lpl;
 	cp_status_t status = CP_OK;
 	
 	// Allocate and initialize a new local plug-in loader
@@ -73,14 +246,22 @@ CP_C_API cp_plugin_loader_t *cp_create_local_ploader(cp_status_t *error) {
 		
 		// Initialize loader
 		memset(loader, 0, sizeof(cp_plugin_loader_t));
-		loader->data = list_create(LISTCOUNT_T_MAX);
 		loader->scan_plugins = lpl_scan_plugins;
 		loader->resolve_files = NULL;
 		loader->release_plugins = NULL;
-		if (loader->data == NULL) {
+		if ((loader->data = lpl = malloc(sizeof(lpl_data_t))) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		memset(lpl, 0, sizeof(lpl_data_t));
+		if ((lpl->dirs = list_create(LISTCOUNT_T_MAX)) == NULL
+			|| (lpl->stamps = hash_create(HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL) {
 			status = CP_ERR_RESOURCE;
 			break;
 		}
+		if ((status = cp_set_ploader_scan_changed(loader, lpl_scan_changed_plugins)) != CP_OK) {
+			break;
+		}
 	
 		// Create a local loader list, if necessary, and add loader to the list
 		cpi_lock_framework();
@@ -120,14 +301,35 @@ CP_C_API cp_plugin_loader_t *cp_create_local_ploader(cp_status_t *error) {
 }
 
 CP_C_API void cp_destroy_local_ploader(cp_plugin_loader_t *loader) {
-	list_t *dirs;
+	lpl_data_t *lpl;
 	
 	CHECK_NOT_NULL(loader);
+	cp_set_ploader_scan_changed(loader, NULL);
 	
-	dirs = (list_t *) loader->data;
-	if (loader->data != NULL) {
-		list_process(dirs, NULL, cpi_process_free_ptr);
-		list_destroy(dirs);
+	// Remove the loader from the local loader list
+	cpi_lock_framework();
+	if (local_ploaders != NULL) {
+		lnode_t *node;
+		
+		if ((node = list_find(local_ploaders, loader, cpi_comp_ptr)) != NULL) {
+			list_delete(local_ploaders, node);
+			lnode_destroy(node);
+		}
+	}
+	cpi_unlock_framework();
+	
+	lpl = loader->data;
+	if (lpl != NULL) {
+		cp_lpl_unwatch_dirs(loader);
+		if (lpl->dirs != NULL) {
+			list_process(lpl->dirs, NULL, cpi_process_free_ptr);
+			list_destroy(lpl->dirs);
+		}
+		if (lpl->stamps != NULL) {
+			clear_stamps(lpl->stamps);
+			hash_destroy(lpl->stamps);
+		}
+		free(lpl);
 		loader->data = NULL;
 	}
 	free(loader);
@@ -137,16 +339,17 @@ CP_C_API cp_status_t cp_lpl_register_dir(cp_plugin_loader_t *loader, const char
 	char *d = NULL;
 	lnode_t *node = NULL;
 	cp_status_t status = CP_OK;
-	list_t *dirs;
+	lpl_data_t *lpl;
 	
 	CHECK_NOT_NULL(loader);
 	CHECK_NOT_NULL(dir);
 	
-	dirs = (list_t *) loader->data;
+	lpl = loader->data;
+	cpi_lock_framework();
 	do {
 	
 		// Check if directory has already been registered 
-		if (list_find(dirs, dir, (int (*)(const void *, const void *)) strcmp) != NULL) {
+		if (list_find(lpl->dirs, dir, (int (*)(const void *, const void *)) strcmp) != NULL) {
 			break;
 		}
 	
@@ -160,9 +363,11 @@ CP_C_API cp_status_t cp_lpl_register_dir(cp_plugin_loader_t *loader, const char
 	
 		// Register directory 
 		strcpy(d, dir);
-		list_append(dirs, node);
+		list_append(lpl->dirs, node);
+		dirs_changed(lpl);
 		
 	} while (0);
+	cpi_unlock_framework();
 
 	// Release resources on failure 
 	if (status != CP_OK) {	
@@ -180,45 +385,1107 @@ CP_C_API cp_status_t cp_lpl_register_dir(cp_plugin_loader_t *loader, const char
 CP_C_API void cp_lpl_unregister_dir(cp_plugin_loader_t *loader, const char *dir) {
 	char *d;
 	lnode_t *node;
-	list_t *dirs;
+	lpl_data_t *lpl;
 	
 	CHECK_NOT_NULL(loader);
 	CHECK_NOT_NULL(dir);
 	
-	dirs = (list_t *) loader->data;
-	node = list_find(dirs, dir, (int (*)(const void *, const void *)) strcmp);
+	lpl = loader->data;
+	cpi_lock_framework();
+	node = list_find(lpl->dirs, dir, (int (*)(const void *, const void *)) strcmp);
 	if (node != NULL) {
 		d = lnode_get(node);
-		list_delete(dirs, node);
+		list_delete(lpl->dirs, node);
 		lnode_destroy(node);
 		free(d);
+		dirs_changed(lpl);
 	}
+	cpi_unlock_framework();
 }
 
 CP_C_API void cp_lpl_unregister_dirs(cp_plugin_loader_t *loader) {
-	list_t *dirs;
+	lpl_data_t *lpl;
 	
 	CHECK_NOT_NULL(loader);
-	dirs = (list_t *) loader->data;
-	list_process(dirs, NULL, cpi_process_free_ptr);
+	lpl = loader->data;
+	cpi_lock_framework();
+	list_process(lpl->dirs, NULL, cpi_process_free_ptr);
+	dirs_changed(lpl);
+	cpi_unlock_framework();
 }
 
-static cp_plugin_info_t **lpl_scan_plugins(void *data, cp_context_t *ctx) {
+CP_C_API void cp_lpl_set_scan_threads(cp_plugin_loader_t *loader, unsigned int num_threads) {
+	CHECK_NOT_NULL(loader);
+	((lpl_data_t *) loader->data)->num_scan_threads = num_threads;
+}
+
+/**
+ * Appends a copy of a path to a list of paths.
+ * 
+ * @param paths the list of paths
+ * @param path the path
+ * @return non-zero on success or zero if insufficient memory
+ */
+static int append_path(list_t *paths, const char *path) {
+	char *p;
+	lnode_t *node;
+	
+	if ((p = malloc((strlen(path) + 1) * sizeof(char))) == NULL) {
+		return 0;
+	}
+	if ((node = lnode_create(p)) == NULL) {
+		free(p);
+		return 0;
+	}
+	strcpy(p, path);
+	list_append(paths, node);
+	return 1;
+}
+
+/**
+ * Collects the paths of possible plug-in directories in the registered
+ * plug-in directories. The paths are appended to the specified list in
+ * directory order. Registered paths which are files rather than
+ * directories are plug-in bundles and they are appended to the list of
+ * bundles. The registered directories are protected by the framework lock.
+ * 
+ * @param ctx the plug-in context
+ * @param dirs the registered plug-in directories
+ * @param paths the list to which allocated paths are appended
+ * @param bundles the list to which allocated bundle paths are appended
+ */
+static void collect_plugin_paths(cp_context_t *ctx, list_t *dirs, list_t *paths, list_t *bundles) {
+	lnode_t *lnode;
+	
+	cpi_lock_framework();
+	lnode = list_first(dirs);
+	while (lnode != NULL) {			
+		const char *dir_path;
+		DIR *dir;
+		
+		dir_path = lnode_get(lnode);
+		dir = opendir(dir_path);
+		if (dir != NULL) {
+			int dir_path_len;
+			struct dirent *de;
+			
+			dir_path_len = strlen(dir_path);
+			if (dir_path[dir_path_len - 1] == CP_FNAMESEP_CHAR) {
+				dir_path_len--;
+			}
+			errno = 0;
+			while ((de = readdir(dir)) != NULL) {
+				if (de->d_name[0] != '\0' && de->d_name[0] != '.') {
+					char *pdir_path;
+					lnode_t *node = NULL;
+
+					// Construct plug-in descriptor path 
+					pdir_path = malloc((dir_path_len + 1 + strlen(de->d_name) + 1) * sizeof(char));
+					if (pdir_path == NULL || (node = lnode_create(pdir_path)) == NULL) {
+						cpi_errorf(ctx, N_("Could not check possible plug-in location %s%c%s due to insufficient system resources."), dir_path, CP_FNAMESEP_CHAR, de->d_name);
+						free(pdir_path);
+
+						// continue loading plug-ins from other directories 
+						errno = 0;
+						continue;
+					}
+					strncpy(pdir_path, dir_path, dir_path_len);
+					pdir_path[dir_path_len] = CP_FNAMESEP_CHAR;
+					strcpy(pdir_path + dir_path_len + 1, de->d_name);
+					list_append(paths, node);
+				}
+				errno = 0;
+			}
+			if (errno) {
+				cpi_errorf(ctx, N_("Could not read plug-in directory %s: %s"), dir_path, strerror(errno));
+				// continue loading plug-ins from other directories 
+			}
+			closedir(dir);
+		} else if (errno == ENOTDIR) {
+			if (!append_path(bundles, dir_path)) {
+				cpi_errorf(ctx, N_("Could not check possible plug-in location %s due to insufficient system resources."), dir_path);
+			}
+		} else {
+			cpi_errorf(ctx, N_("Could not open plug-in directory %s: %s"), dir_path, strerror(errno));
+			// continue loading plug-ins from other directories 
+		}
+		
+		lnode = list_next(dirs, lnode);
+	}
+	cpi_unlock_framework();
+}
+
+/**
+ * Advises the operating system to start reading the plug-in descriptors
+ * at the specified plug-in paths, so that reading them overlaps instead of
+ * taking place one descriptor at a time while parsing.
+ * 
+ * @param ctx the plug-in context
+ * @param paths the plug-in paths
+ */
+static void prefetch_descriptors(cp_context_t *ctx, list_t *paths) {
+	const char *dname = ctx->env->plugin_descriptor_name;
+	size_t dname_len = strlen(dname);
+	lnode_t *lnode;
+	
+	for (lnode = list_first(paths); lnode != NULL; lnode = list_next(paths, lnode)) {
+		const char *path = lnode_get(lnode);
+		size_t path_len = strlen(path);
+		char *file;
+		
+		if ((file = malloc((path_len + 1 + dname_len + 1) * sizeof(char))) == NULL) {
+			return;
+		}
+		strcpy(file, path);
+		file[path_len] = CP_FNAMESEP_CHAR;
+		strcpy(file + path_len + 1, dname);
+		cpi_prefetch_file(file);
+		free(file);
+	}
+}
+
+/**
+ * Releases all descriptor stamps of a local plug-in loader.
+ * 
+ * @param stamps the descriptor stamps
+ */
+static void clear_stamps(hash_t *stamps) {
+	hscan_t hscan;
+	hnode_t *hnode;
+	
+	hash_scan_begin(&hscan, stamps);
+	while ((hnode = hash_scan_next(&hscan)) != NULL) {
+		desc_stamp_t *stamp = hnode_get(hnode);
+		
+		hash_scan_delfree(stamps, hnode);
+		free(stamp->file);
+		free(stamp);
+	}
+}
+
+#ifdef HAVE_STAT
+
+/**
+ * Records the current state of the descriptors at the specified paths.
+ * For an incremental scan the paths whose descriptor has not changed
+ * since the previous scan, or which do not have a descriptor at all, are
+ * removed from the list. Descriptors modified during the second of the
+ * previous scan are always considered changed because the file system
+ * time stamps can not tell apart modifications made during the same
+ * second.
+ * 
+ * @param lpl the local plug-in loader data
+ * @param paths the paths
+ * @param dname the descriptor name appended to the paths, or NULL if the
+ * 		paths are the descriptor files themselves
+ * @param incremental whether to remove unchanged paths
+ * @param now the current time
+ */
+static void check_changed_stamps(lpl_data_t *lpl, list_t *paths, const char *dname, int incremental, time_t now) {
+	size_t dname_len = (dname != NULL ? strlen(dname) : 0);
+	hnode_t *hnode;
+	lnode_t *lnode;
+	
+	lnode = list_first(paths);
+	while (lnode != NULL) {
+		lnode_t *next = list_next(paths, lnode);
+		const char *path = lnode_get(lnode);
+		size_t path_len = strlen(path);
+		desc_stamp_t *stamp = NULL;
+		struct stat st;
+		char *file;
+		int changed = 1;
+		int exists = 0;
+		
+		// Check the descriptor against the recorded stamp
+		if ((file = malloc((path_len + 1 + dname_len + 1) * sizeof(char))) != NULL) {
+			strcpy(file, path);
+			if (dname != NULL) {
+				file[path_len] = CP_FNAMESEP_CHAR;
+				strcpy(file + path_len + 1, dname);
+			}
+			exists = !stat(file, &st);
+			if ((hnode = hash_lookup(lpl->stamps, file)) != NULL) {
+				stamp = hnode_get(hnode);
+				free(file);
+				if (!exists) {
+					hash_delete_free(lpl->stamps, hnode);
+					free(stamp->file);
+					free(stamp);
+					stamp = NULL;
+				} else {
+					changed = (stamp->racy
+						|| stamp->dev != st.st_dev
+						|| stamp->ino != st.st_ino
+						|| stamp->size != st.st_size
+						|| stamp->mtime != st.st_mtime);
+				}
+			} else if (exists && (stamp = malloc(sizeof(desc_stamp_t))) != NULL) {
+				stamp->file = file;
+				if (!hash_alloc_insert(lpl->stamps, file, stamp)) {
+					free(stamp);
+					stamp = NULL;
+					free(file);
+				}
+			} else {
+				free(file);
+			}
+			if (stamp != NULL) {
+				stamp->dev = st.st_dev;
+				stamp->ino = st.st_ino;
+				stamp->size = st.st_size;
+				stamp->mtime = st.st_mtime;
+				stamp->racy = (st.st_mtime >= now);
+				stamp->seen = lpl->scan_gen;
+			}
+		}
+		
+		// Leave out unchanged plug-ins from an incremental scan
+		if (incremental && (!changed || !exists)) {
+			list_delete(paths, lnode);
+			free(lnode_get(lnode));
+			lnode_destroy(lnode);
+		}
+		lnode = next;
+	}
+}
+
+/**
+ * Records the current state of the descriptors at the specified plug-in
+ * paths and of the specified plug-in bundles and forgets descriptors which
+ * are not there anymore. For an incremental scan the unchanged paths and
+ * bundles are removed from the lists as described for
+ * check_changed_stamps. A targeted scan only covers the specified paths
+ * and leaves the stamps of other descriptors intact.
+ * 
+ * @param ctx the plug-in context
+ * @param lpl the local plug-in loader data
+ * @param paths the plug-in paths
+ * @param bundles the plug-in bundles
+ * @param incremental whether to remove unchanged paths
+ * @param targeted whether the paths only include the changed plug-ins
+ */
+static void check_changed_paths(cp_context_t *ctx, lpl_data_t *lpl, list_t *paths, list_t *bundles, int incremental, int targeted) {
+	hscan_t hscan;
+	hnode_t *hnode;
+	time_t now;
+	
+	cpi_lock_framework();
+	
+	// Stamps recorded for another context do not tell what this one has seen
+	if (lpl->stamps_context != ctx) {
+		clear_stamps(lpl->stamps);
+		lpl->stamps_context = ctx;
+#ifdef LPL_WATCH
+		if (targeted && lpl->watch != NULL) {
+			lpl->watch->needs_full = 1;
+		}
+#endif
+		incremental = 0;
+		targeted = 0;
+	}
+	lpl->scan_gen++;
+	now = time(NULL);
+	check_changed_stamps(lpl, paths, ctx->env->plugin_descriptor_name, incremental, now);
+	check_changed_stamps(lpl, bundles, NULL, incremental, now);
+	
+	// Forget the removed descriptors
+	if (!targeted) {
+		hash_scan_begin(&hscan, lpl->stamps);
+		while ((hnode = hash_scan_next(&hscan)) != NULL) {
+			desc_stamp_t *stamp = hnode_get(hnode);
+			
+			if (stamp->seen != lpl->scan_gen) {
+				hash_scan_delfree(lpl->stamps, hnode);
+				free(stamp->file);
+				free(stamp);
+			}
+		}
+	}
+	
+	cpi_unlock_framework();
+}
+
+#endif //HAVE_STAT
+
+/**
+ * Adds a loaded plug-in to the available plug-ins unless a later version
+ * of the same plug-in is already available. Consumes the reference to the
+ * plug-in information.
+ * 
+ * @param ctx the plug-in context
+ * @param avail_plugins the available plug-ins
+ * @param plugin the loaded plug-in
+ */
+static void add_avail_plugin(cp_context_t *ctx, hash_t *avail_plugins, cp_plugin_info_t *plugin) {
+	hnode_t *hnode;
+	
+	// Insert plug-in to the list of available plug-ins 
+	if ((hnode = hash_lookup(avail_plugins, plugin->identifier)) != NULL) {
+		cp_plugin_info_t *plugin2 = hnode_get(hnode);
+		if (cpi_plugin_vercmp(plugin, plugin2) > 0) {
+			hash_delete_free(avail_plugins, hnode);
+			cp_release_info(ctx, plugin2);
+			hnode = NULL;
+		} else {
+			cp_release_info(ctx, plugin);
+			return;
+		}
+	}
+	if (!hash_alloc_insert(avail_plugins, plugin->identifier, plugin)) {
+		cpi_errorf(ctx, N_("Plug-in %s version %s could not be loaded due to insufficient system resources."), plugin->identifier, plugin->version);
+		cp_release_info(ctx, plugin);
+	}
+}
+
+#ifdef CP_THREADS
+
+/**
+ * Parses the descriptor of a claimed job without the context lock and
+ * marks the job completed. The caller must hold the pool mutex, which is
+ * released while parsing.
+ * 
+ * @param pool the scan pool
+ * @param job the claimed job
+ */
+static void run_scan_job(scan_pool_t *pool, scan_job_t *job) {
+	cp_status_t status;
+	
+	cpi_unlock_mutex(pool->mutex);
+	job->plugin = cpi_parse_plugin_descriptor(pool->context, job->path, &(job->log), &status);
+	cpi_lock_mutex(pool->mutex);
+	job->done = 1;
+	cpi_signal_mutex(pool->mutex);
+}
+
+/**
+ * Parses descriptors until all jobs of a parallel scan have been claimed.
+ * 
+ * @param arg the scan pool
+ */
+static void scan_worker(void *arg) {
+	scan_pool_t *pool = arg;
+	
+	cpi_lock_mutex(pool->mutex);
+	while (pool->next_job < pool->num_jobs) {
+		run_scan_job(pool, pool->jobs + pool->next_job++);
+	}
+	cpi_unlock_mutex(pool->mutex);
+}
+
+/**
+ * Parses the plug-in descriptors in parallel using the specified number of
+ * threads, including the calling thread, and merges the results into the
+ * available plug-ins in the original order. The caller must have locked
+ * the context. Worker threads merely parse descriptors and defer their log
+ * messages. Logging, information registration and version selection all take
+ * place in the calling thread, which merges each result as soon as it and
+ * the results preceding it are available and otherwise parses descriptors
+ * alongside the workers, so that merging overlaps with parsing.
+ * 
+ * @param ctx the plug-in context
+ * @param paths the plug-in paths
+ * @param num_threads the number of threads
+ * @param avail_plugins the available plug-ins
+ * @return whether the descriptors were processed, or zero if resources
+ * 		for a parallel scan could not be allocated
+ */
+static int scan_parallel(cp_context_t *ctx, list_t *paths, unsigned int num_threads, hash_t *avail_plugins) {
+	scan_pool_t pool;
+	cp_task_t **threads = NULL;
+	unsigned int num_started = 0;
+	lnode_t *lnode;
+	size_t i;
+	
+	assert(cpi_is_context_locked(ctx));
+	memset(&pool, 0, sizeof(pool));
+	pool.context = ctx;
+	pool.num_jobs = list_count(paths);
+	if (pool.num_jobs < num_threads) {
+		num_threads = pool.num_jobs;
+	}
+	if ((pool.mutex = cpi_create_mutex()) == NULL
+		|| (pool.jobs = malloc(pool.num_jobs * sizeof(scan_job_t))) == NULL
+		|| (threads = malloc(num_threads * sizeof(cp_task_t *))) == NULL) {
+		if (pool.mutex != NULL) {
+			cpi_destroy_mutex(pool.mutex);
+		}
+		free(pool.jobs);
+		return 0;
+	}
+	for (i = 0, lnode = list_first(paths); lnode != NULL; i++, lnode = list_next(paths, lnode)) {
+		pool.jobs[i].path = lnode_get(lnode);
+		pool.jobs[i].plugin = NULL;
+		list_init(&(pool.jobs[i].log), LISTCOUNT_T_MAX);
+		pool.jobs[i].done = 0;
+	}
+	
+	// Start the worker threads
+	while (num_started + 1 < num_threads
+		&& (threads[num_started] = cpi_spawn_task(scan_worker, &pool)) != NULL) {
+		num_started++;
+	}
+	
+	// Merge the results in the original order as they become available
+	cpi_lock_mutex(pool.mutex);
+	for (i = 0; i < pool.num_jobs; ) {
+		scan_job_t *job = pool.jobs + i;
+		
+		if (job->done) {
+			cpi_unlock_mutex(pool.mutex);
+			cpi_flush_deferred_log(ctx, &(job->log));
+			if (job->plugin != NULL) {
+				cpi_register_plugin_descriptor(ctx, job->plugin);
+				add_avail_plugin(ctx, avail_plugins, job->plugin);
+			}
+			cpi_lock_mutex(pool.mutex);
+			i++;
+		} else if (pool.next_job < pool.num_jobs) {
+			run_scan_job(&pool, pool.jobs + pool.next_job++);
+		} else {
+			cpi_wait_mutex(pool.mutex);
+		}
+	}
+	cpi_unlock_mutex(pool.mutex);
+	while (num_started > 0) {
+		cpi_join_task(threads[--num_started]);
+	}
+	
+	cpi_destroy_mutex(pool.mutex);
+	free(pool.jobs);
+	free(threads);
+	return 1;
+}
+
+#endif //CP_THREADS
+
+#ifdef LPL_WATCH
+
+/**
+ * Compares two watch descriptors.
+ * 
+ * @param wd1 pointer to the first watch descriptor
+ * @param wd2 pointer to the second watch descriptor
+ * @return zero if equal, non-zero otherwise
+ */
+static int comp_wd(const void *wd1, const void *wd2) {
+	return *((const int *) wd1) != *((const int *) wd2);
+}
+
+/**
+ * Returns a hash value for a watch descriptor.
+ * 
+ * @param wd pointer to the watch descriptor
+ * @return the hash value
+ */
+static hash_val_t hash_wd(const void *wd) {
+	return (hash_val_t) *((const int *) wd);
+}
+
+/**
+ * Records a changed plug-in path to be checked by the next scan. The
+ * caller must not hold the framework lock.
+ * 
+ * @param w the watch
+ * @param dir the directory path
+ * @param name the name of the plug-in directory or NULL if @a dir is
+ * 		the plug-in directory itself
+ */
+static void add_changed_path(lpl_watch_t *w, const char *dir, const char *name) {
+	size_t dir_len = strlen(dir);
+	char *path;
+	
+	if ((path = malloc((dir_len + 1 + (name != NULL ? strlen(name) : 0) + 1) * sizeof(char))) != NULL) {
+		strcpy(path, dir);
+		if (name != NULL) {
+			if (dir_len > 0 && path[dir_len - 1] == CP_FNAMESEP_CHAR) {
+				dir_len--;
+			}
+			path[dir_len] = CP_FNAMESEP_CHAR;
+			strcpy(path + dir_len + 1, name);
+		}
+	}
+	cpi_lock_framework();
+	if (path == NULL) {
+		w->needs_full = 1;
+	} else if (hash_lookup(w->changed, path) != NULL) {
+		free(path);
+	} else if (!hash_alloc_insert(w->changed, path, path)) {
+		free(path);
+		w->needs_full = 1;
+	}
+	cpi_unlock_framework();
+}
+
+/**
+ * Starts watching a directory.
+ * 
+ * @param w the watch
+ * @param path the path of the directory
+ * @param collection whether the directory is a registered directory
+ * @return whether the directory is being watched
+ */
+static int add_dir_watch(lpl_watch_t *w, const char *path, int collection) {
+	watch_entry_t *entry;
+	hnode_t *hnode;
+	uint32_t mask;
+	int wd;
+	
+	mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+	if (collection) {
+		mask |= IN_DELETE_SELF | IN_MOVE_SELF;
+	} else {
+		mask |= IN_CLOSE_WRITE | IN_ATTRIB;
+	}
+	if ((wd = inotify_add_watch(w->fd, path, mask)) < 0) {
+		return 0;
+	}
+	
+	// A renamed directory keeps its watch descriptor
+	if ((hnode = hash_lookup(w->entries, &wd)) != NULL) {
+		char *p;
+		
+		entry = hnode_get(hnode);
+		if (strcmp(entry->path, path)
+			&& (p = malloc((strlen(path) + 1) * sizeof(char))) != NULL) {
+			strcpy(p, path);
+			free(entry->path);
+			entry->path = p;
+		}
+		return 1;
+	}
+	if ((entry = malloc(sizeof(watch_entry_t))) == NULL
+		|| (entry->path = malloc((strlen(path) + 1) * sizeof(char))) == NULL) {
+		free(entry);
+		inotify_rm_watch(w->fd, wd);
+		return 0;
+	}
+	entry->wd = wd;
+	strcpy(entry->path, path);
+	entry->collection = collection;
+	if (!hash_alloc_insert(w->entries, &(entry->wd), entry)) {
+		free(entry->path);
+		free(entry);
+		inotify_rm_watch(w->fd, wd);
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Forgets a watched directory.
+ * 
+ * @param w the watch
+ * @param hnode the hash node of the watched directory
+ * @param scan whether the hash is being scanned
+ */
+static void free_dir_watch(lpl_watch_t *w, hnode_t *hnode, int scan) {
+	watch_entry_t *entry = hnode_get(hnode);
+	
+	if (scan) {
+		hash_scan_delfree(w->entries, hnode);
+	} else {
+		hash_delete_free(w->entries, hnode);
+	}
+	free(entry->path);
+	free(entry);
+}
+
+/**
+ * Watches the currently registered directories and the plug-in
+ * directories within them, replacing any previous watches.
+ * 
+ * @param w the watch
+ */
+static void sync_dir_watches(lpl_watch_t *w) {
+	lnode_t *lnode;
+	hscan_t hscan;
+	hnode_t *hnode;
+	int complete = 1;
+	
+	// Remove the previous watches
+	hash_scan_begin(&hscan, w->entries);
+	while ((hnode = hash_scan_next(&hscan)) != NULL) {
+		inotify_rm_watch(w->fd, ((watch_entry_t *) hnode_get(hnode))->wd);
+		free_dir_watch(w, hnode, 1);
+	}
+	
+	// Watch the registered directories and the plug-in directories
+	cpi_lock_framework();
+	for (lnode = list_first(w->lpl->dirs);
+		lnode != NULL && complete;
+		lnode = list_next(w->lpl->dirs, lnode)) {
+		const char *dir_path = lnode_get(lnode);
+		size_t dir_path_len = strlen(dir_path);
+		DIR *dir;
+		struct dirent *de;
+		
+		if (!add_dir_watch(w, dir_path, 1) || (dir = opendir(dir_path)) == NULL) {
+			complete = 0;
+			break;
+		}
+		if (dir_path_len > 0 && dir_path[dir_path_len - 1] == CP_FNAMESEP_CHAR) {
+			dir_path_len--;
+		}
+		while (complete && (de = readdir(dir)) != NULL) {
+			char *pdir_path;
+			
+			if (de->d_name[0] == '\0' || de->d_name[0] == '.') {
+				continue;
+			}
+			if ((pdir_path = malloc((dir_path_len + 1 + strlen(de->d_name) + 1) * sizeof(char))) == NULL) {
+				complete = 0;
+				break;
+			}
+			strncpy(pdir_path, dir_path, dir_path_len);
+			pdir_path[dir_path_len] = CP_FNAMESEP_CHAR;
+			strcpy(pdir_path + dir_path_len + 1, de->d_name);
+			if (!add_dir_watch(w, pdir_path, 0) && errno != ENOTDIR) {
+				complete = 0;
+			}
+			free(pdir_path);
+		}
+		closedir(dir);
+	}
+	cpi_unlock_framework();
+	
+	// Changes may have been missed while not watching
+	cpi_lock_framework();
+	w->incomplete = !complete;
+	w->needs_full = 1;
+	cpi_unlock_framework();
+}
+
+/**
+ * Processes the file system change notifications read from the inotify
+ * file descriptor.
+ * 
+ * @param w the watch
+ * @param buffer the notifications
+ * @param len the length of the notifications in bytes
+ * @return whether the plug-ins should be scanned
+ */
+static int process_notifications(lpl_watch_t *w, const char *buffer, size_t len) {
+	size_t i = 0;
+	int changed = 0;
+	
+	while (i + sizeof(struct inotify_event) <= len) {
+		const struct inotify_event *ev = (const struct inotify_event *) (buffer + i);
+		hnode_t *hnode;
+		
+		i += sizeof(struct inotify_event) + ev->len;
+		
+		// Events may have been lost
+		if (ev->mask & IN_Q_OVERFLOW) {
+			cpi_lock_framework();
+			w->needs_full = 1;
+			cpi_unlock_framework();
+			changed = 1;
+			continue;
+		}
+		
+		if ((hnode = hash_lookup(w->entries, &(ev->wd))) == NULL) {
+			continue;
+		}
+		if (ev->mask & IN_IGNORED) {
+			free_dir_watch(w, hnode, 0);
+			continue;
+		}
+		if (((watch_entry_t *) hnode_get(hnode))->collection) {
+			watch_entry_t *entry = hnode_get(hnode);
+			
+			// A registered directory itself was moved or removed
+			if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+				cpi_lock_framework();
+				w->needs_full = 1;
+				cpi_unlock_framework();
+				changed = 1;
+				continue;
+			}
+			
+			// A plug-in directory was added or removed
+			if (ev->len == 0 || ev->name[0] == '\0' || ev->name[0] == '.') {
+				continue;
+			}
+			if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) && (ev->mask & IN_ISDIR)) {
+				size_t dir_len = strlen(entry->path);
+				char *pdir_path;
+				int ok = 0;
+				
+				if ((pdir_path = malloc((dir_len + 1 + strlen(ev->name) + 1) * sizeof(char))) != NULL) {
+					strcpy(pdir_path, entry->path);
+					if (dir_len > 0 && pdir_path[dir_len - 1] == CP_FNAMESEP_CHAR) {
+						dir_len--;
+					}
+					pdir_path[dir_len] = CP_FNAMESEP_CHAR;
+					strcpy(pdir_path + dir_len + 1, ev->name);
+					ok = add_dir_watch(w, pdir_path, 0);
+					free(pdir_path);
+				}
+				if (!ok) {
+					cpi_lock_framework();
+					w->incomplete = 1;
+					w->needs_full = 1;
+					cpi_unlock_framework();
+				}
+			}
+			add_changed_path(w, entry->path, ev->name);
+		} else {
+			
+			// The contents of a plug-in directory changed
+			add_changed_path(w, ((watch_entry_t *) hnode_get(hnode))->path, NULL);
+		}
+		changed = 1;
+	}
+	return changed;
+}
+
+/**
+ * Waits for file system changes and scans the plug-ins once the changes
+ * have settled, until the watch is stopped.
+ * 
+ * @param arg the watch
+ */
+static void watch_thread(void *arg) {
+	lpl_watch_t *w = arg;
+	union {
+		struct inotify_event ev;
+		char buffer[4096];
+	} events;
+	unsigned long long max_delay = (unsigned long long) w->debounce_ms * WATCH_MAX_DELAY_PERIODS;
+	unsigned long long pending_since = cpi_monotonic_usecs();
+	int pending = 1;
+	int stop = 0;
+	
+	sync_dir_watches(w);
+	while (!stop) {
+		struct pollfd fds[2];
+		int timeout = -1;
+		int n;
+		
+		// Changes keep postponing the scan only up to the maximum delay
+		if (pending) {
+			unsigned long long waited = (cpi_monotonic_usecs() - pending_since) / 1000;
+			
+			timeout = (int) w->debounce_ms;
+			if (waited >= max_delay) {
+				timeout = 0;
+			} else if (max_delay - waited < w->debounce_ms) {
+				timeout = (int) (max_delay - waited);
+			}
+		}
+		
+		fds[0].fd = w->wake[0];
+		fds[0].events = POLLIN;
+		fds[1].fd = w->fd;
+		fds[1].events = POLLIN;
+		if (timeout == 0) {
+			n = 0;
+		} else if ((n = poll(fds, 2, timeout)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		
+		// Scan the plug-ins when the changes have settled
+		if (n == 0) {
+			pending = 0;
+			cp_scan_plugins(w->context, w->flags | CP_SP_INCREMENTAL);
+			continue;
+		}
+		
+		// Process requests to stop or to synchronize the watches
+		if (fds[0].revents & POLLIN) {
+			char c;
+			int sync = 0;
+			
+			while (read(w->wake[0], &c, 1) == 1) {
+				if (c == 'q') {
+					stop = 1;
+				} else {
+					sync = 1;
+				}
+			}
+			if (sync && !stop) {
+				sync_dir_watches(w);
+				if (!pending) {
+					pending = 1;
+					pending_since = cpi_monotonic_usecs();
+				}
+			}
+		}
+		
+		// Process the change notifications
+		if (fds[1].revents & POLLIN) {
+			ssize_t len;
+			
+			while ((len = read(w->fd, events.buffer, sizeof(events.buffer))) > 0) {
+				if (process_notifications(w, events.buffer, len) && !pending) {
+					pending = 1;
+					pending_since = cpi_monotonic_usecs();
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Releases the resources of a watch. The watch thread must not be running.
+ * 
+ * @param w the watch
+ */
+static void destroy_watch(lpl_watch_t *w) {
+	if (w->entries != NULL) {
+		hscan_t hscan;
+		hnode_t *hnode;
+		
+		hash_scan_begin(&hscan, w->entries);
+		while ((hnode = hash_scan_next(&hscan)) != NULL) {
+			free_dir_watch(w, hnode, 1);
+		}
+		hash_destroy(w->entries);
+	}
+	if (w->changed != NULL) {
+		hscan_t hscan;
+		hnode_t *hnode;
+		
+		hash_scan_begin(&hscan, w->changed);
+		while ((hnode = hash_scan_next(&hscan)) != NULL) {
+			char *path = hnode_get(hnode);
+			
+			hash_scan_delfree(w->changed, hnode);
+			free(path);
+		}
+		hash_destroy(w->changed);
+	}
+	if (w->fd >= 0) {
+		close(w->fd);
+	}
+	if (w->wake[0] >= 0) {
+		close(w->wake[0]);
+		close(w->wake[1]);
+	}
+	free(w);
+}
+
+/**
+ * Wakes up the watch thread with the specified request. The caller must
+ * hold the framework lock.
+ * 
+ * @param w the watch
+ * @param c the request character, 'q' to stop and 's' to synchronize
+ */
+static void wake_watch(lpl_watch_t *w, char c) {
+	while (write(w->wake[1], &c, 1) < 0 && errno == EINTR);
+}
+
+/**
+ * Moves the plug-in paths changed since the previous scan into the specified
+ * list if the plug-ins are being watched for the specified context and the
+ * changes are known to be complete. Otherwise the changed paths are
+ * discarded because all the registered directories are going to be scanned.
+ * 
+ * @param ctx the plug-in context
+ * @param lpl the local plug-in loader data
+ * @param paths the list to which the changed paths are appended
+ * @param incremental whether this is an incremental scan
+ * @return whether only the changed paths need to be scanned
+ */
+static int take_changed_paths(cp_context_t *ctx, lpl_data_t *lpl, list_t *paths, int incremental) {
+	lpl_watch_t *w;
+	int targeted = 0;
+	
+	cpi_lock_framework();
+	if ((w = lpl->watch) != NULL && w->context == ctx) {
+		hscan_t hscan;
+		hnode_t *hnode;
+		
+		targeted = (incremental && !w->needs_full && lpl->stamps_context == ctx);
+		hash_scan_begin(&hscan, w->changed);
+		while ((hnode = hash_scan_next(&hscan)) != NULL) {
+			char *path = hnode_get(hnode);
+			lnode_t *lnode = NULL;
+			
+			hash_scan_delfree(w->changed, hnode);
+			if (targeted && (lnode = lnode_create(path)) != NULL) {
+				list_append(paths, lnode);
+			} else {
+				free(path);
+				targeted = 0;
+			}
+		}
+		if (!targeted) {
+			list_process(paths, NULL, cpi_process_free_ptr);
+			w->needs_full = w->incomplete;
+		}
+	}
+	cpi_unlock_framework();
+	return targeted;
+}
+
+#endif //LPL_WATCH
+
+/**
+ * Notifies the watch, if any, that the registered directories have changed.
+ * The caller must hold the framework lock.
+ * 
+ * @param lpl the local plug-in loader data
+ */
+static void dirs_changed(lpl_data_t *lpl) {
+#ifdef LPL_WATCH
+	if (lpl->watch != NULL) {
+		wake_watch(lpl->watch, 's');
+	}
+#endif
+}
+
+CP_HIDDEN void cpi_unwatch_local_ploaders(cp_context_t *context) {
+#ifdef LPL_WATCH
+	cp_plugin_loader_t *loader;
+	
+	do {
+		lnode_t *node;
+		
+		// Find a loader watching for the context
+		loader = NULL;
+		cpi_lock_framework();
+		if (local_ploaders != NULL) {
+			for (node = list_first(local_ploaders);
+				node != NULL && loader == NULL;
+				node = list_next(local_ploaders, node)) {
+				cp_plugin_loader_t *l = lnode_get(node);
+				lpl_data_t *lpl = l->data;
+				
+				if (lpl != NULL && lpl->watch != NULL && lpl->watch->context == context) {
+					loader = l;
+				}
+			}
+		}
+		cpi_unlock_framework();
+		
+		if (loader != NULL) {
+			cp_lpl_unwatch_dirs(loader);
+		}
+	} while (loader != NULL);
+#endif
+}
+
+CP_C_API cp_status_t cp_lpl_watch_dirs(cp_plugin_loader_t *loader, cp_context_t *ctx, int flags, unsigned int debounce_ms) {
+#ifdef LPL_WATCH
+	lpl_data_t *lpl;
+	lpl_watch_t *w = NULL;
+	cp_status_t status = CP_OK;
+	
+	CHECK_NOT_NULL(loader);
+	CHECK_NOT_NULL(ctx);
+	
+	lpl = loader->data;
+	cp_lpl_unwatch_dirs(loader);
+	do {
+		
+		// Allocate resources
+		if ((w = malloc(sizeof(lpl_watch_t))) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		memset(w, 0, sizeof(lpl_watch_t));
+		w->lpl = lpl;
+		w->context = ctx;
+		w->flags = flags & ~CP_SP_INCREMENTAL;
+		w->debounce_ms = debounce_ms;
+		w->fd = -1;
+		w->wake[0] = w->wake[1] = -1;
+		w->needs_full = 1;
+		if ((w->entries = hash_create(HASHCOUNT_T_MAX, comp_wd, hash_wd)) == NULL
+			|| (w->changed = hash_create(HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL
+			|| (w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0
+			|| pipe(w->wake)) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		if (fcntl(w->wake[0], F_SETFL, O_NONBLOCK)
+			|| fcntl(w->wake[1], F_SETFL, O_NONBLOCK)
+			|| fcntl(w->wake[0], F_SETFD, FD_CLOEXEC)
+			|| fcntl(w->wake[1], F_SETFD, FD_CLOEXEC)) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		
+		// Start watching
+		cpi_lock_framework();
+		lpl->watch = w;
+		if ((w->thread = cpi_create_thread(watch_thread, w)) == NULL) {
+			lpl->watch = NULL;
+			status = CP_ERR_RESOURCE;
+		}
+		cpi_unlock_framework();
+		
+	} while (0);
+	
+	// Release resources on failure
+	if (status != CP_OK && w != NULL) {
+		destroy_watch(w);
+	}
+	
+	return status;
+#else
+	CHECK_NOT_NULL(loader);
+	CHECK_NOT_NULL(ctx);
+	return CP_ERR_RESOURCE;
+#endif
+}
+
+CP_C_API void cp_lpl_unwatch_dirs(cp_plugin_loader_t *loader) {
+#ifdef LPL_WATCH
+	lpl_data_t *lpl;
+	lpl_watch_t *w;
+	
+	CHECK_NOT_NULL(loader);
+	
+	lpl = loader->data;
+	cpi_lock_framework();
+	if ((w = lpl->watch) != NULL) {
+		lpl->watch = NULL;
+		wake_watch(w, 'q');
+	}
+	cpi_unlock_framework();
+	if (w != NULL) {
+		cpi_join_thread(w->thread);
+		destroy_watch(w);
+	}
+#else
+	CHECK_NOT_NULL(loader);
+#endif
+}
+
+/**
+ * Scans the registered plug-in directories for plug-ins.
+ * 
+ * @param data the local plug-in loader data
+ * @param ctx the plug-in context
+ * @param incremental whether to only load the descriptors changed since
+ * 		the previous scan
+ * @return pointer to a NULL-terminated array of plug-in information pointers, or NULL on failure
+ */
+static cp_plugin_info_t **scan_local_plugins(void *data, cp_context_t *ctx, int incremental) {
 	hash_t *avail_plugins = NULL;
-	char *pdir_path = NULL;
-	int pdir_path_size = 0;
-	list_t *dirs;
+	list_t *paths = NULL;
+	list_t *bundles = NULL;
+	lpl_data_t *lpl;
 	cp_plugin_info_t **plugins = NULL;
 	
 	CHECK_NOT_NULL(data);
 	CHECK_NOT_NULL(ctx);
 	
-	dirs = (list_t*) data;
+	lpl = data;
 	do {
 		lnode_t *lnode;
 		hscan_t hscan;
 		hnode_t *hnode;
 		int num_avail_plugins;
+		int targeted = 0;
+		int parsed = 0;
 		int i;
 	
 		// Create a hash for available plug-ins 
@@ -226,96 +1493,58 @@ static cp_plugin_info_t **lpl_scan_plugins(void *data, cp_context_t *ctx) {
 			break;
 		}
 	
-		// Scan plug-in loaders for available plug-ins 
-		lnode = list_first(dirs);
-		while (lnode != NULL) {			
-			const char *dir_path;
-			DIR *dir;
+		// Collect possible plug-in locations
+		if ((paths = list_create(LISTCOUNT_T_MAX)) == NULL
+			|| (bundles = list_create(LISTCOUNT_T_MAX)) == NULL) {
+			break;
+		}
+#ifdef LPL_WATCH
+		targeted = take_changed_paths(ctx, lpl, paths, incremental);
+#endif
+		if (!targeted) {
+			collect_plugin_paths(ctx, lpl->dirs, paths, bundles);
+		}
+#ifdef HAVE_STAT
+		check_changed_paths(ctx, lpl, paths, bundles, incremental, targeted);
+#endif
+		if (list_count(paths) > 1) {
+			prefetch_descriptors(ctx, paths);
+		}
+	
+		// Load the plug-in descriptors, in parallel if so configured
+#ifdef CP_THREADS
+		if (lpl->num_scan_threads > 1 && list_count(paths) > 1) {
+			parsed = scan_parallel(ctx, paths, lpl->num_scan_threads, avail_plugins);
+		}
+#endif
+		for (lnode = list_first(paths);
+			!parsed && lnode != NULL;
+			lnode = list_next(paths, lnode)) {
+			cp_plugin_info_t *plugin;
+			cp_status_t s;
+		
+			// Try to load a plug-in 
+			plugin = cp_load_plugin_descriptor(ctx, lnode_get(lnode), &s);
+			if (plugin != NULL) {
+				add_avail_plugin(ctx, avail_plugins, plugin);
+			}
+		}
+		
+		// Load the plug-ins contained in bundles
+		for (lnode = list_first(bundles);
+			lnode != NULL;
+			lnode = list_next(bundles, lnode)) {
+			cp_plugin_info_t **bplugins;
+			cp_status_t s;
 			
-			dir_path = lnode_get(lnode);
-			dir = opendir(dir_path);
-			if (dir != NULL) {
-				int dir_path_len;
-				struct dirent *de;
-				
-				dir_path_len = strlen(dir_path);
-				if (dir_path[dir_path_len - 1] == CP_FNAMESEP_CHAR) {
-					dir_path_len--;
+			cpi_lock_context(ctx);
+			if ((bplugins = cpi_load_plugin_image(ctx, lnode_get(lnode), &s)) != NULL) {
+				for (i = 0; bplugins[i] != NULL; i++) {
+					add_avail_plugin(ctx, avail_plugins, bplugins[i]);
 				}
-				errno = 0;
-				while ((de = readdir(dir)) != NULL) {
-					if (de->d_name[0] != '\0' && de->d_name[0] != '.') {
-						int pdir_path_len = dir_path_len + 1 + strlen(de->d_name) + 1;
-						cp_plugin_info_t *plugin;
-						cp_status_t s;
-						hnode_t *hnode;
-
-						// Allocate memory for plug-in descriptor path 
-						if (pdir_path_size <= pdir_path_len) {
-							char *new_pdir_path;
-						
-							if (pdir_path_size == 0) {
-								pdir_path_size = 128;
-							}
-							while (pdir_path_size <= pdir_path_len) {
-								pdir_path_size *= 2;
-							}
-							new_pdir_path = realloc(pdir_path, pdir_path_size * sizeof(char));
-							if (new_pdir_path == NULL) {
-								cpi_errorf(ctx, N_("Could not check possible plug-in location %s%c%s due to insufficient system resources."), dir_path, CP_FNAMESEP_CHAR, de->d_name);
-
-								// continue loading plug-ins from other directories 
-								continue;
-							}
-							pdir_path = new_pdir_path;
-						}
-					
-						// Construct plug-in descriptor path 
-						strcpy(pdir_path, dir_path);
-						pdir_path[dir_path_len] = CP_FNAMESEP_CHAR;
-						strcpy(pdir_path + dir_path_len + 1, de->d_name);
-							
-						// Try to load a plug-in 
-						plugin = cp_load_plugin_descriptor(ctx, pdir_path, &s);
-						if (plugin == NULL) {
-						
-							// continue loading plug-ins from other directories 
-							continue;
-						}
-					
-						// Insert plug-in to the list of available plug-ins 
-						if ((hnode = hash_lookup(avail_plugins, plugin->identifier)) != NULL) {
-							cp_plugin_info_t *plugin2 = hnode_get(hnode);
-							if (cpi_vercmp(plugin->version, plugin2->version) > 0) {
-								hash_delete_free(avail_plugins, hnode);
-								cp_release_info(ctx, plugin2);
-								hnode = NULL;
-							}
-						}
-						if (hnode == NULL) {
-							if (!hash_alloc_insert(avail_plugins, plugin->identifier, plugin)) {
-								cpi_errorf(ctx, N_("Plug-in %s version %s could not be loaded due to insufficient system resources."), plugin->identifier, plugin->version);
-								cp_release_info(ctx, plugin);
-
-								// continue loading plug-ins from other directories 
-								continue;
-							}
-						}
-						
-					}
-					errno = 0;
-				}
-				if (errno) {
-					cpi_errorf(ctx, N_("Could not read plug-in directory %s: %s"), dir_path, strerror(errno));
-					// continue loading plug-ins from other directories 
-				}
-				closedir(dir);
-			} else {
-				cpi_errorf(ctx, N_("Could not open plug-in directory %s: %s"), dir_path, strerror(errno));
-				// continue loading plug-ins from other directories 
+				free(bplugins);
 			}
-			
-			lnode = list_next(dirs, lnode);
+			cpi_unlock_context(ctx);
 		}
 
 		// Construct an array of plug-ins
@@ -337,8 +1566,13 @@ static cp_plugin_info_t **lpl_scan_plugins(void *data, cp_context_t *ctx) {
 	} while (0);
 	
 	// Release resources 
-	if (pdir_path != NULL) {
-		free(pdir_path);
+	if (paths != NULL) {
+		list_process(paths, NULL, cpi_process_free_ptr);
+		list_destroy(paths);
+	}
+	if (bundles != NULL) {
+		list_process(bundles, NULL, cpi_process_free_ptr);
+		list_destroy(bundles);
 	}
 	if (avail_plugins != NULL) {
 		hscan_t hscan;
@@ -355,3 +1589,11 @@ static cp_plugin_info_t **lpl_scan_plugins(void *data, cp_context_t *ctx) {
 	
 	return plugins;
 }
+
+static cp_plugin_info_t **lpl_scan_plugins(void *data, cp_context_t *ctx) {
+	return scan_local_plugins(data, ctx, 0);
+}
+
+static cp_plugin_info_t **lpl_scan_changed_plugins(void *data, cp_context_t *ctx) {
+	return scan_local_plugins(data, ctx, 1);
+}
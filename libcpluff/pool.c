@@ -0,0 +1,709 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file
+ * The shared framework thread pool
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "cpluff.h"
+#include "defines.h"
+#include "util.h"
+#include "internal.h"
+#ifdef CP_THREADS
+#include "thread.h"
+#endif
+
+
+/* ------------------------------------------------------------------------
+ * Data types
+ * ----------------------------------------------------------------------*/
+
+/// States of a pool task
+typedef enum task_state_t {
+	
+	/// Waiting in a queue to be executed
+	TASK_QUEUED,
+	
+	/// Being executed
+	TASK_RUNNING,
+	
+	/// Executed
+	TASK_DONE,
+	
+	/// Cancelled before it was executed
+	TASK_CANCELLED
+	
+} task_state_t;
+
+typedef struct pool_worker_t pool_worker_t;
+
+/// A pool task
+struct cp_task_t {
+	
+	/// The task function
+	cp_task_func_t func;
+	
+	/// The argument for the task function
+	void *arg;
+	
+	/// The submitting plug-in context or NULL for a framework task
+	cp_context_t *context;
+	
+	/// The submitting plug-in or NULL for the main program or the framework
+	cp_plugin_t *plugin;
+	
+	/// The current state
+	task_state_t state;
+	
+	/// Whether the task is released when completed
+	int detached;
+	
+	/// Whether the task is a framework executor which may block for long
+	int blocking;
+	
+	/// The worker whose queue holds the task, or NULL for the shared queue
+	pool_worker_t *worker;
+	
+	/// The previous task in the queue
+	cp_task_t *prev;
+	
+	/// The next task in the queue
+	cp_task_t *next;
+	
+};
+
+#ifdef CP_THREADS
+
+/// A queue of pool tasks
+typedef struct task_queue_t {
+	
+	/// The first task
+	cp_task_t *head;
+	
+	/// The last task
+	cp_task_t *tail;
+	
+} task_queue_t;
+
+/// A pool worker thread
+struct pool_worker_t {
+	
+	/// The thread
+	cpi_thread_t *thread;
+	
+	/// The tasks submitted by this worker, the latest first
+	task_queue_t queue;
+	
+	/// The next worker in the list
+	pool_worker_t *next;
+	
+};
+
+/// The shared thread pool, protected by its mutex
+typedef struct task_pool_t {
+	
+	/// The mutex, also signaled when tasks complete
+	cpi_mutex_t *mutex;
+	
+	/// Signaled when tasks are queued or the workers are shut down
+	cpi_cond_t *work_cond;
+	
+	/// The number of workers kept for tasks other than framework executors
+	unsigned int size;
+	
+	/// The workers
+	pool_worker_t *workers;
+	
+	/// Workers which have exited but have not been joined
+	pool_worker_t *retired;
+	
+	/// The number of workers
+	unsigned int num_workers;
+	
+	/// The number of workers waiting for tasks
+	unsigned int num_idle;
+	
+	/// The number of blocking tasks in execution
+	unsigned int num_blocking;
+	
+	/// The number of tasks in execution
+	unsigned int num_running;
+	
+	/// The number of queued tasks
+	unsigned int num_queued;
+	
+	/// The tasks submitted by threads other than workers
+	task_queue_t shared;
+	
+	/// Whether the workers are being shut down
+	int shutdown;
+	
+} task_pool_t;
+
+#endif
+
+
+/* ------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------*/
+
+#ifdef CP_THREADS
+
+/// The shared thread pool
+static task_pool_t pool;
+
+#endif
+
+
+/* ------------------------------------------------------------------------
+ * Function definitions
+ * ----------------------------------------------------------------------*/
+
+/**
+ * Returns the activity counter of the owner of the specified task.
+ * 
+ * @param task the task submitted by a plug-in or the main program
+ * @return the counter of uncompleted tasks
+ */
+static int *owner_tasks(cp_task_t *task) {
+	return (task->plugin != NULL ? &(task->plugin->num_tasks) : &(task->context->env->num_tasks));
+}
+
+/**
+ * Records the completion or cancellation of a task submitted by a plug-in
+ * or the main program. The context must be locked.
+ * 
+ * @param task the task
+ */
+static void release_owner(cp_task_t *task) {
+	int *counter = owner_tasks(task);
+	
+	assert(*counter > 0);
+	if (--(*counter) == 0) {
+		if (task->plugin != NULL) {
+			cpi_signal_plugin_idle(task->plugin);
+		} else {
+			cpi_signal_context(task->context);
+		}
+	}
+}
+
+#ifdef CP_THREADS
+
+CP_HIDDEN cp_status_t cpi_init_task_pool(void) {
+	memset(&pool, 0, sizeof(pool));
+	if ((pool.mutex = cpi_create_mutex()) == NULL
+		|| (pool.work_cond = cpi_create_cond()) == NULL) {
+		cpi_release_task_pool();
+		return CP_ERR_RESOURCE;
+	}
+	pool.size = cpi_get_num_processors();
+	return CP_OK;
+}
+
+/**
+ * Joins the workers which have exited. The pool must be locked.
+ */
+static void join_retired_workers(void) {
+	while (pool.retired != NULL) {
+		pool_worker_t *w = pool.retired;
+		
+		pool.retired = w->next;
+		cpi_join_thread(w->thread);
+		free(w);
+	}
+}
+
+CP_HIDDEN void cpi_release_task_pool(void) {
+	if (pool.mutex != NULL) {
+		cpi_quiesce_task_pool();
+		cpi_destroy_mutex(pool.mutex);
+	}
+	if (pool.work_cond != NULL) {
+		cpi_destroy_cond(pool.work_cond);
+	}
+	memset(&pool, 0, sizeof(pool));
+}
+
+/**
+ * Returns the queue holding the specified queued task.
+ * 
+ * @param task the task
+ * @return the queue
+ */
+static task_queue_t *task_queue(cp_task_t *task) {
+	return (task->worker != NULL ? &(task->worker->queue) : &(pool.shared));
+}
+
+/**
+ * Removes a queued task from its queue. The pool must be locked.
+ * 
+ * @param task the queued task
+ */
+static void unlink_task(cp_task_t *task) {
+	task_queue_t *queue = task_queue(task);
+	
+	assert(task->state == TASK_QUEUED);
+	if (task->prev != NULL) {
+		task->prev->next = task->next;
+	} else {
+		queue->head = task->next;
+	}
+	if (task->next != NULL) {
+		task->next->prev = task->prev;
+	} else {
+		queue->tail = task->prev;
+	}
+	task->prev = task->next = NULL;
+	pool.num_queued--;
+}
+
+/**
+ * Returns the worker executing the calling thread, if any. The pool must
+ * be locked.
+ * 
+ * @return the worker or NULL if the calling thread is not a pool worker
+ */
+static pool_worker_t *current_worker(void) {
+	pool_worker_t *w;
+	
+	for (w = pool.workers; w != NULL && !cpi_is_current_thread(w->thread); w = w->next);
+	return w;
+}
+
+static void worker_main(void *arg);
+
+/**
+ * Starts a new worker. The pool must be locked.
+ * 
+ * @return whether successful
+ */
+static int start_worker(void) {
+	pool_worker_t *w;
+	
+	join_retired_workers();
+	if ((w = malloc(sizeof(pool_worker_t))) == NULL) {
+		return 0;
+	}
+	memset(w, 0, sizeof(pool_worker_t));
+	
+	// The worker waits for the pool lock before it uses the structure
+	if ((w->thread = cpi_create_thread(worker_main, w)) == NULL) {
+		free(w);
+		return 0;
+	}
+	w->next = pool.workers;
+	pool.workers = w;
+	pool.num_workers++;
+	return 1;
+}
+
+/**
+ * Queues a task and makes sure there is a worker to execute it. A worker
+ * is started if the queued tasks outnumber the idle workers and the
+ * workers not executing blocking tasks are fewer than the pool size.
+ * Blocking tasks are always given a worker so that framework executors
+ * run concurrently as requested. The pool must be locked.
+ * 
+ * @param task the task to be queued
+ * @return whether successful
+ */
+static int queue_task(cp_task_t *task) {
+	pool_worker_t *w = current_worker();
+	task_queue_t *queue;
+	
+	task->state = TASK_QUEUED;
+	task->worker = w;
+	queue = task_queue(task);
+	if (w != NULL) {
+		task->prev = NULL;
+		task->next = queue->head;
+		if (queue->head != NULL) {
+			queue->head->prev = task;
+		} else {
+			queue->tail = task;
+		}
+		queue->head = task;
+	} else {
+		task->prev = queue->tail;
+		task->next = NULL;
+		if (queue->tail != NULL) {
+			queue->tail->next = task;
+		} else {
+			queue->head = task;
+		}
+		queue->tail = task;
+	}
+	pool.num_queued++;
+	if (pool.num_queued > pool.num_idle
+		&& (task->blocking || pool.num_workers - pool.num_blocking < pool.size)
+		&& !start_worker()
+		&& (task->blocking || pool.num_workers == 0)) {
+		unlink_task(task);
+		return 0;
+	}
+	if (pool.num_idle > 0) {
+		cpi_signal_cond(pool.work_cond);
+	}
+	return 1;
+}
+
+/**
+ * Takes the next task to be executed by the specified worker. The worker
+ * prefers the latest task it has submitted itself, then the oldest task
+ * submitted by other threads and finally steals the oldest task from
+ * another worker. The pool must be locked.
+ * 
+ * @param w the worker
+ * @return the task or NULL if there are no queued tasks
+ */
+static cp_task_t *take_task(pool_worker_t *w) {
+	cp_task_t *task = NULL;
+	
+	if (w->queue.head != NULL) {
+		task = w->queue.head;
+	} else if (pool.shared.head != NULL) {
+		task = pool.shared.head;
+	} else {
+		pool_worker_t *v;
+		
+		for (v = pool.workers; v != NULL && v->queue.tail == NULL; v = v->next);
+		if (v != NULL) {
+			task = v->queue.tail;
+		}
+	}
+	if (task != NULL) {
+		unlink_task(task);
+	}
+	return task;
+}
+
+/**
+ * Executes a task which has been removed from its queue. The pool must be
+ * locked and it is released while the task is executed. A detached task
+ * is released when completed.
+ * 
+ * @param task the task
+ * @param worker whether executed by a worker
+ */
+static void run_task(cp_task_t *task, int worker) {
+	int blocking = (task->blocking && worker);
+	
+	task->state = TASK_RUNNING;
+	pool.num_running++;
+	if (blocking) {
+		pool.num_blocking++;
+	}
+	cpi_unlock_mutex(pool.mutex);
+	task->func(task->arg);
+	if (task->context != NULL) {
+		cpi_lock_context(task->context);
+		release_owner(task);
+		cpi_unlock_context(task->context);
+	}
+	cpi_lock_mutex(pool.mutex);
+	if (blocking) {
+		pool.num_blocking--;
+	}
+	pool.num_running--;
+	task->state = TASK_DONE;
+	if (task->detached) {
+		free(task);
+	} else {
+		cpi_signal_mutex(pool.mutex);
+	}
+}
+
+/**
+ * Executes queued tasks until the pool is shut down. A worker exits when
+ * it has no task to execute and there are more workers than needed, for
+ * example after framework executors have completed.
+ * 
+ * @param arg the worker
+ */
+static void worker_main(void *arg) {
+	pool_worker_t *w = arg;
+	
+	cpi_lock_mutex(pool.mutex);
+	while (1) {
+		cp_task_t *task;
+		
+		if ((task = take_task(w)) != NULL) {
+			run_task(task, 1);
+		} else if (pool.shutdown || pool.num_workers - pool.num_blocking > pool.size) {
+			break;
+		} else {
+			pool.num_idle++;
+			cpi_wait_cond(pool.work_cond, pool.mutex);
+			pool.num_idle--;
+		}
+	}
+	
+	// Retire the worker to be joined by another thread
+	if (!pool.shutdown) {
+		pool_worker_t **wp;
+		
+		assert(w->queue.head == NULL);
+		for (wp = &(pool.workers); *wp != w; wp = &((*wp)->next));
+		*wp = w->next;
+		pool.num_workers--;
+		w->next = pool.retired;
+		pool.retired = w;
+	}
+	cpi_unlock_mutex(pool.mutex);
+}
+
+CP_HIDDEN void cpi_quiesce_task_pool(void) {
+	pool_worker_t *workers;
+	
+	cpi_lock_mutex(pool.mutex);
+	while (pool.num_queued > 0 || pool.num_running > 0) {
+		cpi_wait_mutex(pool.mutex);
+	}
+	pool.shutdown = 1;
+	cpi_signal_cond(pool.work_cond);
+	workers = pool.workers;
+	pool.workers = NULL;
+	cpi_unlock_mutex(pool.mutex);
+	
+	// Join the workers without the lock they need for exiting
+	while (workers != NULL) {
+		pool_worker_t *w = workers;
+		
+		workers = w->next;
+		cpi_join_thread(w->thread);
+		free(w);
+	}
+	cpi_lock_mutex(pool.mutex);
+	join_retired_workers();
+	pool.num_workers = 0;
+	pool.shutdown = 0;
+	cpi_unlock_mutex(pool.mutex);
+}
+
+CP_HIDDEN cp_task_t *cpi_spawn_task(void (*func)(void *arg), void *arg) {
+	cp_task_t *task;
+	
+	assert(func != NULL);
+	if ((task = malloc(sizeof(cp_task_t))) == NULL) {
+		return NULL;
+	}
+	memset(task, 0, sizeof(cp_task_t));
+	task->func = func;
+	task->arg = arg;
+	task->blocking = 1;
+	cpi_lock_mutex(pool.mutex);
+	if (!queue_task(task)) {
+		free(task);
+		task = NULL;
+	}
+	cpi_unlock_mutex(pool.mutex);
+	return task;
+}
+
+/**
+ * Waits for a task to complete, executing it in the calling thread if it
+ * has not been started yet, and releases it.
+ * 
+ * @param task the task
+ * @return whether the task was executed
+ */
+static int join_task(cp_task_t *task) {
+	int executed;
+	
+	cpi_lock_mutex(pool.mutex);
+	if (task->state == TASK_QUEUED) {
+		unlink_task(task);
+		run_task(task, 0);
+	}
+	while (task->state == TASK_RUNNING) {
+		cpi_wait_mutex(pool.mutex);
+	}
+	executed = (task->state == TASK_DONE);
+	cpi_unlock_mutex(pool.mutex);
+	free(task);
+	return executed;
+}
+
+CP_HIDDEN void cpi_join_task(cp_task_t *task) {
+	assert(task != NULL && task->context == NULL);
+	join_task(task);
+}
+
+#endif //CP_THREADS
+
+#ifdef CP_THREADS
+
+/**
+ * Cancels the queued tasks of the specified owner in the specified queue.
+ * The context and the pool must be locked.
+ * 
+ * @param queue the queue
+ * @param context the plug-in context
+ * @param plugin the owning plug-in or NULL for the main program
+ */
+static void cancel_queued_tasks(task_queue_t *queue, cp_context_t *context, cp_plugin_t *plugin) {
+	cp_task_t *task = queue->head;
+	
+	while (task != NULL) {
+		cp_task_t *next = task->next;
+		
+		if (task->context != NULL && task->plugin == plugin
+			&& task->context->env == context->env) {
+			unlink_task(task);
+			task->state = TASK_CANCELLED;
+			release_owner(task);
+			if (task->detached) {
+				free(task);
+			} else {
+				cpi_signal_mutex(pool.mutex);
+			}
+		}
+		task = next;
+	}
+}
+
+#endif
+
+CP_HIDDEN void cpi_drain_tasks(cp_context_t *context, cp_plugin_t *plugin) {
+#ifdef CP_THREADS
+	int *counter = (plugin != NULL ? &(plugin->num_tasks) : &(context->env->num_tasks));
+	
+	assert(cpi_is_context_locked(context));
+	while (*counter > 0) {
+		pool_worker_t *w;
+		
+		// Cancel the queued tasks
+		cpi_lock_mutex(pool.mutex);
+		cancel_queued_tasks(&(pool.shared), context, plugin);
+		for (w = pool.workers; w != NULL; w = w->next) {
+			cancel_queued_tasks(&(w->queue), context, plugin);
+		}
+		cpi_unlock_mutex(pool.mutex);
+		
+		// Wait for the tasks in execution, which may submit more tasks
+		if (*counter > 0) {
+			if (plugin != NULL) {
+				cpi_wait_plugin_idle(plugin, counter);
+			} else {
+				cpi_wait_context(context);
+			}
+		}
+	}
+#endif
+}
+
+CP_C_API cp_status_t cp_submit_task(cp_context_t *ctx, cp_task_func_t func, void *arg, cp_task_t **task) {
+	cp_task_t *t;
+	cp_status_t status = CP_OK;
+	
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(func);
+	if ((t = malloc(sizeof(cp_task_t))) == NULL) {
+		return CP_ERR_RESOURCE;
+	}
+	memset(t, 0, sizeof(cp_task_t));
+	t->func = func;
+	t->arg = arg;
+	t->context = ctx;
+	t->detached = (task == NULL);
+	cpi_lock_context(ctx);
+	cpi_check_invocation(ctx, CPI_CF_LOGGER, __func__);
+	t->plugin = ctx->plugin;
+	(*owner_tasks(t))++;
+	cpi_unlock_context(ctx);
+	if (task != NULL) {
+		*task = t;
+	}
+	
+#ifdef CP_THREADS
+	cpi_lock_mutex(pool.mutex);
+	if (!queue_task(t)) {
+		status = CP_ERR_RESOURCE;
+	}
+	cpi_unlock_mutex(pool.mutex);
+#else
+	t->state = TASK_RUNNING;
+	func(arg);
+	t->state = TASK_DONE;
+#endif
+	
+	// Withdraw the task on failure, or release an executed detached task
+	if (status != CP_OK) {
+		cpi_lock_context(ctx);
+		release_owner(t);
+		cpi_error(ctx, N_("A task could not be submitted due to insufficient system resources."));
+		cpi_unlock_context(ctx);
+		free(t);
+		if (task != NULL) {
+			*task = NULL;
+		}
+	}
+#ifndef CP_THREADS
+	else {
+		cpi_lock_context(ctx);
+		release_owner(t);
+		cpi_unlock_context(ctx);
+		if (t->detached) {
+			free(t);
+		}
+	}
+#endif
+	return status;
+}
+
+CP_C_API int cp_wait_task(cp_context_t *ctx, cp_task_t *task) {
+	int executed;
+	
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(task);
+	assert(!task->detached && task->context == ctx);
+#ifdef CP_THREADS
+	executed = join_task(task);
+#else
+	executed = (task->state == TASK_DONE);
+	free(task);
+#endif
+	return executed;
+}
+
+CP_C_API void cp_wait_tasks(cp_context_t *ctx) {
+	CHECK_NOT_NULL(ctx);
+	cpi_lock_context(ctx);
+	cpi_check_invocation(ctx, CPI_CF_LOGGER | CPI_CF_LISTENER, __func__);
+	if (ctx->plugin != NULL) {
+		cpi_wait_plugin_idle(ctx->plugin, &(ctx->plugin->num_tasks));
+	} else {
+		while (ctx->env->num_tasks > 0) {
+			cpi_wait_context(ctx);
+		}
+	}
+	cpi_unlock_context(ctx);
+}
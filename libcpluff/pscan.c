@@ -35,6 +35,7 @@
 #include "defines.h"
 #include "util.h"
 #include "internal.h"
+#include "trace.h"
 
 
 /* ------------------------------------------------------------------------
@@ -51,15 +52,187 @@ struct available_plugin_t {
 
 };
 
+/// The incremental scan function of a plug-in loader
+typedef struct scan_changed_t {
+	
+	/// The function
+	cp_scan_changed_func_t func;
+	
+} scan_changed_t;
+
+
+/* ------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------*/
+
+/// Incremental scan functions keyed by plug-in loader, or NULL if none
+static hash_t *scan_changed_funcs = NULL;
+
 
 /* ------------------------------------------------------------------------
  * Function definitions
  * ----------------------------------------------------------------------*/
 
+CP_C_API cp_status_t cp_set_ploader_scan_changed(cp_plugin_loader_t *loader, cp_scan_changed_func_t scan_changed) {
+	cp_status_t status = CP_OK;
+	hnode_t *node = NULL;
+	
+	CHECK_NOT_NULL(loader);
+	cpi_lock_framework();
+	if (scan_changed_funcs != NULL) {
+		node = hash_lookup(scan_changed_funcs, loader);
+	}
+	do {
+		scan_changed_t *sc;
+		
+		if (node != NULL && scan_changed != NULL) {
+			((scan_changed_t *) hnode_get(node))->func = scan_changed;
+		} else if (node != NULL) {
+			free(hnode_get(node));
+			hash_delete_free(scan_changed_funcs, node);
+		} else if (scan_changed != NULL) {
+			if (scan_changed_funcs == NULL
+				&& (scan_changed_funcs = hash_create(HASHCOUNT_T_MAX, cpi_comp_ptr, cpi_hashfunc_ptr)) == NULL) {
+				status = CP_ERR_RESOURCE;
+				break;
+			}
+			if ((sc = malloc(sizeof(scan_changed_t))) == NULL) {
+				status = CP_ERR_RESOURCE;
+				break;
+			}
+			sc->func = scan_changed;
+			if (!hash_alloc_insert(scan_changed_funcs, loader, sc)) {
+				free(sc);
+				status = CP_ERR_RESOURCE;
+				break;
+			}
+		}
+	} while (0);
+	
+	// Release the table when it becomes empty
+	if (scan_changed_funcs != NULL && hash_isempty(scan_changed_funcs)) {
+		hash_destroy(scan_changed_funcs);
+		scan_changed_funcs = NULL;
+	}
+	cpi_unlock_framework();
+	return status;
+}
+
+/**
+ * Returns the incremental scan function of the specified plug-in loader.
+ * 
+ * @param loader the plug-in loader
+ * @return the incremental scan function or NULL if none
+ */
+static cp_scan_changed_func_t get_scan_changed(cp_plugin_loader_t *loader) {
+	cp_scan_changed_func_t func = NULL;
+	hnode_t *node;
+	
+	cpi_lock_framework();
+	if (scan_changed_funcs != NULL
+		&& (node = hash_lookup(scan_changed_funcs, loader)) != NULL) {
+		func = ((scan_changed_t *) hnode_get(node))->func;
+	}
+	cpi_unlock_framework();
+	return func;
+}
+
+/**
+ * Adds a plug-in and the plug-ins importing it, directly or indirectly,
+ * to a set of plug-ins.
+ * 
+ * @param context the plug-in context
+ * @param plugin the plug-in
+ * @param closure the set of plug-ins
+ * @return non-zero if successful, zero if insufficient memory
+ */
+static int add_importing_closure(cp_context_t *context, cp_plugin_t *plugin, cpi_ptrset_t *closure) {
+	lnode_t *node;
+	
+	if (cpi_ptrset_contains(closure, plugin)) {
+		return 1;
+	}
+	if (!cpi_ptrset_add(context->env->nodes, closure, plugin)) {
+		return 0;
+	}
+	for (node = list_first(&plugin->importing->list); node != NULL; node = list_next(&plugin->importing->list, node)) {
+		if (!add_importing_closure(context, lnode_get(node), closure)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Lists the identifiers of the started plug-ins which are to be upgraded
+ * or which import a plug-in to be upgraded, directly or indirectly. The
+ * plug-ins are listed in the order they were started.
+ * 
+ * @param context the plug-in context
+ * @param avail_plugins the available plug-ins
+ * @param started_plugins the list where the identifiers are appended
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t list_upgrade_closure(cp_context_t *context, hash_t *avail_plugins, list_t *started_plugins) {
+	cpi_ptrset_t *closure;
+	cp_status_t status = CP_OK;
+	hscan_t hscan;
+	hnode_t *hnode;
+	lnode_t *lnode;
+	
+	if ((closure = cpi_create_ptrset()) == NULL) {
+		return CP_ERR_RESOURCE;
+	}
+	
+	// Collect the plug-ins to be upgraded and the plug-ins importing them
+	hash_scan_begin(&hscan, avail_plugins);
+	while (status == CP_OK && (hnode = hash_scan_next(&hscan)) != NULL) {
+		available_plugin_t *ap = hnode_get(hnode);
+		hnode_t *hn2;
+		
+		if ((hn2 = hash_lookup(context->env->plugins, ap->info->identifier)) != NULL
+			&& cpi_plugin_vercmp(ap->info, ((cp_plugin_t *) hnode_get(hn2))->plugin) > 0
+			&& !add_importing_closure(context, hnode_get(hn2), closure)) {
+			status = CP_ERR_RESOURCE;
+		}
+	}
+	
+	// List the started ones in start order
+	for (lnode = list_first(&context->env->started_plugins->list);
+		status == CP_OK && lnode != NULL;
+		lnode = list_next(&context->env->started_plugins->list, lnode)) {
+		cp_plugin_t *rp = lnode_get(lnode);
+		
+		if (cpi_ptrset_contains(closure, rp)) {
+			char *pid;
+			lnode_t *pnode;
+			
+			if ((pid = strdup(rp->plugin->identifier)) == NULL) {
+				status = CP_ERR_RESOURCE;
+			} else if ((pnode = lnode_create(pid)) == NULL) {
+				free(pid);
+				status = CP_ERR_RESOURCE;
+			} else {
+				list_append(started_plugins, pnode);
+			}
+		}
+	}
+	
+	while ((lnode = list_first(&closure->list)) != NULL) {
+		cpi_ptrset_remove(context->env->nodes, closure, lnode_get(lnode));
+	}
+	cpi_destroy_ptrset(closure);
+	return status;
+}
+
 CP_C_API cp_status_t cp_scan_plugins(cp_context_t *context, int flags) {
 	hash_t *avail_plugins = NULL;
 	list_t *started_plugins = NULL;
 	cp_plugin_info_t **plugins = NULL;
+	cp_plugin_info_t **new_plugins = NULL;
+	cp_plugin_loader_t **new_loaders = NULL;
+	cp_status_t *new_statuses = NULL;
+	int num_new = 0;
 	char *pdir_path = NULL;
 	int plugins_stopped = 0;
 	cp_status_t status = CP_OK;
@@ -68,7 +241,9 @@ CP_C_API cp_status_t cp_scan_plugins(cp_context_t *context, int flags) {
 	
 	cpi_lock_context(context);
 	cpi_check_invocation(context, CPI_CF_ANY, __func__);
-	cpi_debug(context, N_("Plug-in scan is starting."));
+	cpi_wait_parallel_starts(context);
+	cpi_debugm(context, CP_MSG_SCAN_STARTED, NULL, NULL, NULL, 0);
+	CPI_TRACE1(scan__begin, flags);
 	do {
 		lnode_t *lnode;
 		hscan_t hscan;
@@ -122,11 +297,19 @@ CP_C_API cp_status_t cp_scan_plugins(cp_context_t *context, int flags) {
 		while ((hnode = hash_scan_next(&hscan)) != NULL) {
 			cp_plugin_loader_t *loader = (cp_plugin_loader_t *) hnode_getkey(hnode);
 			cp_plugin_info_t **loaded_plugins;
+			cp_scan_changed_func_t scan_changed = NULL;
 			int i;
 			
 			// Scan plug-ins using the loader
-			cpi_debugf(context, N_("Scanning plug-ins using loader %p."), (void *) loader);
-			loaded_plugins = loader->scan_plugins(loader->data, context);
+			cpi_debugm(context, CP_MSG_SCAN_LOADER, NULL, NULL, loader, 0);
+			if (flags & CP_SP_INCREMENTAL) {
+				scan_changed = get_scan_changed(loader);
+			}
+			if (scan_changed != NULL) {
+				loaded_plugins = scan_changed(loader->data, context);
+			} else {
+				loaded_plugins = loader->scan_plugins(loader->data, context);
+			}
 			if (loaded_plugins == NULL) {
 				cpi_errorf(context, N_("Plug-in loader %p failed to scan for plug-ins."), (void *) loader);
 				continue;
@@ -140,7 +323,7 @@ CP_C_API cp_status_t cp_scan_plugins(cp_context_t *context, int flags) {
 				if ((hnode = hash_lookup(avail_plugins, plugin->identifier)) != NULL) {
 					available_plugin_t *ap = hnode_get(hnode);
 					cp_plugin_info_t *plugin2 = ap->info;
-					if (cpi_vercmp(plugin->version, plugin2->version) > 0) {
+					if (cpi_plugin_vercmp(plugin, plugin2) > 0) {
 						
 						// Release plug-in with smaller version number
 						hash_delete_free(avail_plugins, hnode);
@@ -188,7 +371,30 @@ CP_C_API cp_status_t cp_scan_plugins(cp_context_t *context, int flags) {
 			}
 		}
 		
-		// Install/upgrade plug-ins 
+		// Copy the list of started plug-ins affected by upgrades, if necessary
+		if (started_plugins == NULL
+			&& (flags & CP_SP_RESTART_UPGRADED)
+			&& (flags & CP_SP_UPGRADE)) {
+			cp_status_t s;
+			
+			if ((started_plugins = list_create(LISTCOUNT_T_MAX)) == NULL) {
+				status = CP_ERR_RESOURCE;
+				break;
+			}
+			if ((s = list_upgrade_closure(context, avail_plugins, started_plugins)) != CP_OK) {
+				status = s;
+				break;
+			}
+		}
+		
+		// Install/upgrade plug-ins once every loader has been scanned
+		// because any later loader may still supersede a selected version
+		if ((new_plugins = malloc((hash_count(avail_plugins) + 1) * sizeof(cp_plugin_info_t *))) == NULL
+			|| (new_loaders = malloc((hash_count(avail_plugins) + 1) * sizeof(cp_plugin_loader_t *))) == NULL
+			|| (new_statuses = malloc((hash_count(avail_plugins) + 1) * sizeof(cp_status_t))) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
 		hash_scan_begin(&hscan, avail_plugins);
 		while ((hnode = hash_scan_next(&hscan)) != NULL) {
 			available_plugin_t *ap;
@@ -209,10 +415,7 @@ CP_C_API cp_status_t cp_scan_plugins(cp_context_t *context, int flags) {
 			// Unload the installed plug-in if it is to be upgraded 
 			if (ip != NULL
 				&& (flags & CP_SP_UPGRADE)
-				&& ((ip->plugin->version == NULL && plugin->version != NULL)
-					|| (ip->plugin->version != NULL
-						&& plugin->version != NULL
-						&& cpi_vercmp(plugin->version, ip->plugin->version) > 0))) {
+				&& cpi_plugin_vercmp(plugin, ip->plugin) > 0) {
 				if ((flags & (CP_SP_STOP_ALL_ON_UPGRADE | CP_SP_STOP_ALL_ON_INSTALL))
 					&& !plugins_stopped) {
 					plugins_stopped = 1;
@@ -223,9 +426,8 @@ CP_C_API cp_status_t cp_scan_plugins(cp_context_t *context, int flags) {
 				ip = NULL;
 			}
 			
-			// Install the plug-in, if to be installed 
+			// Add the plug-in to the batch, if to be installed 
 			if (ip == NULL) {
-				int hok = 0;
 				hash_t *loader_plugins;
 			
 				// First stop all plug-ins if so specified
@@ -237,26 +439,14 @@ CP_C_API cp_status_t cp_scan_plugins(cp_context_t *context, int flags) {
 				// Add plug-in to loader map
 				loader_plugins = hnode_get(hash_lookup(context->env->loaders_to_plugins, loader));
 				assert(loader_plugins != NULL);
-				if ((hok = hash_alloc_insert(loader_plugins, plugin->identifier, NULL))) {
-					
-					// Install new plug-in
-					s = cpi_install_plugin(context, plugin, loader);
-				}
-				
-				// Release resources and set status code on failure
-				if (!hok || s != CP_OK) {
-					if (hok) {
-						hash_delete_free(
-							loader_plugins,
-							hash_lookup(loader_plugins, plugin->identifier)
-						);
-					}
-					if (hok) {
-						status = s;
-					} else {
-						status = CP_ERR_RESOURCE;
-					}
-					break;
+				if (hash_alloc_insert(loader_plugins, plugin->identifier, NULL)) {
+					new_plugins[num_new] = plugin;
+					new_loaders[num_new] = loader;
+					num_new++;
+					plugin = NULL;
+				} else {
+					cpi_errorf(context, N_("Plug-in %s could not be installed due to insufficient system resources."), plugin->identifier);
+					status = CP_ERR_RESOURCE;
 				}
 				
 			}
@@ -264,7 +454,34 @@ CP_C_API cp_status_t cp_scan_plugins(cp_context_t *context, int flags) {
 			// Remove the plug-in from the hash
 			free(ap);
 			hash_scan_delfree(avail_plugins, hnode);
-			cp_release_info(context, plugin);
+			if (plugin != NULL) {
+				cp_release_info(context, plugin);
+			}
+		}
+		
+		// Install the new plug-ins as a single batch
+		if (num_new > 0) {
+			cp_status_t s;
+			int i;
+			
+			s = cpi_install_plugins(context, new_plugins, new_loaders, num_new, 0, new_statuses);
+			if (status == CP_OK) {
+				status = s;
+			}
+			for (i = 0; i < num_new; i++) {
+				
+				// Remove the failed plug-ins from the loader map
+				if (new_statuses[i] != CP_OK) {
+					hash_t *loader_plugins;
+					
+					loader_plugins = hnode_get(hash_lookup(context->env->loaders_to_plugins, new_loaders[i]));
+					hash_delete_free(
+						loader_plugins,
+						hash_lookup(loader_plugins, new_plugins[i]->identifier)
+					);
+				}
+				cp_release_info(context, new_plugins[i]);
+			}
 		}
 		
 		// Restart stopped plug-ins if necessary 
@@ -288,7 +505,7 @@ CP_C_API cp_status_t cp_scan_plugins(cp_context_t *context, int flags) {
 	// Report error
 	switch (status) {
 		case CP_OK:
-			cpi_debug(context, N_("Plug-in scan has completed successfully."));
+			cpi_debugm(context, CP_MSG_SCAN_COMPLETED, NULL, NULL, NULL, 0);
 			break;
 		case CP_ERR_RESOURCE:
 			cpi_error(context, N_("Could not scan all plug-ins due to insufficient system resources."));
@@ -297,6 +514,7 @@ CP_C_API cp_status_t cp_scan_plugins(cp_context_t *context, int flags) {
 			cpi_error(context, N_("Could not scan all plug-ins."));
 			break;
 	}
+	CPI_TRACE1(scan__end, status);
 	cpi_unlock_context(context);
 	
 	// Release resources 
@@ -309,12 +527,16 @@ CP_C_API cp_status_t cp_scan_plugins(cp_context_t *context, int flags) {
 		
 		hash_scan_begin(&hscan, avail_plugins);
 		while ((hnode = hash_scan_next(&hscan)) != NULL) {
-			cp_plugin_info_t *p = hnode_get(hnode);
+			available_plugin_t *ap = hnode_get(hnode);
 			hash_scan_delfree(avail_plugins, hnode);
-			cp_release_info(context, p);
+			cp_release_info(context, ap->info);
+			free(ap);
 		}
 		hash_destroy(avail_plugins);
 	}
+	free(new_plugins);
+	free(new_loaders);
+	free(new_statuses);
 	if (started_plugins != NULL) {
 		list_process(started_plugins, NULL, cpi_process_free_ptr);
 		list_destroy(started_plugins);
@@ -0,0 +1,423 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file
+ * Published snapshots of the extension registry
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../kazlib/list.h"
+#include "../kazlib/hash.h"
+#include "cpluff.h"
+#include "defines.h"
+#include "util.h"
+#include "internal.h"
+#ifdef CP_THREADS
+#include "thread.h"
+#endif
+
+
+/* ------------------------------------------------------------------------
+ * Data types
+ * ----------------------------------------------------------------------*/
+
+/// Extensions installed for an extension point
+typedef struct snapshot_group_t {
+	
+	/// The extension point identifier
+	const char *ext_point_id;
+	
+	/// Index of the first extension in the extensions array
+	int first;
+	
+	/// The number of extensions
+	int num;
+	
+} snapshot_group_t;
+
+struct cp_ext_snapshot_t {
+	
+	/// The arena holding the snapshot
+	cpi_arena_t *arena;
+	
+	/// The plug-in environment
+	cp_plugin_env_t *env;
+	
+	/// The number of references, including the one held while published
+	int refs;
+	
+	/// The installed extension points
+	cp_ext_point_t **ext_points;
+	
+	/// The number of installed extension points
+	int num_ext_points;
+	
+	/// The installed extensions grouped by extension point
+	cp_extension_t **extensions;
+	
+	/// The number of installed extensions
+	int num_extensions;
+	
+	/// The extension groups sorted by extension point identifier
+	snapshot_group_t *groups;
+	
+	/// The number of extension groups
+	int num_groups;
+	
+	/// The plug-ins whose information is in use by the snapshot
+	cp_plugin_info_t **plugins;
+	
+	/// The number of plug-ins
+	int num_plugins;
+	
+	/// Whether some of the plug-ins have lazily parsed configuration
+	int lazy_cfg;
+	
+};
+
+
+/* ------------------------------------------------------------------------
+ * Function definitions
+ * ----------------------------------------------------------------------*/
+
+#ifdef CP_THREADS
+#define lock_snapshots(env) cpi_lock_mutex((env)->snapshot_mutex)
+#define unlock_snapshots(env) cpi_unlock_mutex((env)->snapshot_mutex)
+#else
+#define lock_snapshots(env) do {} while (0)
+#define unlock_snapshots(env) do {} while (0)
+#endif
+
+static int comp_ext_nodes(const void *n1, const void *n2) {
+	return strcmp(hnode_getkey(*((hnode_t * const *) n1)),
+		hnode_getkey(*((hnode_t * const *) n2)));
+}
+
+/**
+ * Builds a new snapshot of the extension registry. The snapshot uses the
+ * information of all the installed plug-ins.
+ * 
+ * @param context the plug-in context
+ * @return the snapshot, or NULL if insufficient memory
+ */
+static cp_ext_snapshot_t *build_snapshot(cp_context_t *context) {
+	cp_plugin_env_t *env = context->env;
+	cp_ext_snapshot_t *snapshot = NULL;
+	cpi_arena_t *arena;
+	hnode_t **nodes = NULL;
+	hscan_t scan;
+	hnode_t *hnode;
+	int i, n;
+	
+	assert(cpi_is_context_locked(context));
+	if ((arena = cpi_create_arena(sizeof(cp_ext_snapshot_t)
+			+ (hash_count(env->ext_points) + hash_count(env->plugins)) * sizeof(void *)
+			+ hash_count(env->extensions) * (sizeof(snapshot_group_t) + 4 * sizeof(void *)))) == NULL) {
+		return NULL;
+	}
+	do {
+		if ((snapshot = cpi_arena_alloc(arena, sizeof(cp_ext_snapshot_t))) == NULL) {
+			break;
+		}
+		memset(snapshot, 0, sizeof(cp_ext_snapshot_t));
+		snapshot->arena = arena;
+		snapshot->env = env;
+		snapshot->num_ext_points = hash_count(env->ext_points);
+		snapshot->num_groups = hash_count(env->extensions);
+		snapshot->num_plugins = hash_count(env->plugins);
+		n = 0;
+		hash_scan_begin(&scan, env->extensions);
+		while ((hnode = hash_scan_next(&scan)) != NULL) {
+			n += ((cpi_ptrvec_t *) hnode_get(hnode))->count;
+		}
+		snapshot->num_extensions = n;
+		if ((snapshot->ext_points = cpi_arena_alloc(arena, (snapshot->num_ext_points + 1) * sizeof(cp_ext_point_t *))) == NULL
+			|| (snapshot->extensions = cpi_arena_alloc(arena, (snapshot->num_extensions + 1) * sizeof(cp_extension_t *))) == NULL
+			|| (snapshot->groups = cpi_arena_alloc(arena, (snapshot->num_groups + 1) * sizeof(snapshot_group_t))) == NULL
+			|| (snapshot->plugins = cpi_arena_alloc(arena, (snapshot->num_plugins + 1) * sizeof(cp_plugin_info_t *))) == NULL
+			|| (nodes = cpi_arena_alloc(arena, (snapshot->num_groups + 1) * sizeof(hnode_t *))) == NULL) {
+			snapshot = NULL;
+			break;
+		}
+		
+		// Copy extension points
+		i = 0;
+		hash_scan_begin(&scan, env->ext_points);
+		while ((hnode = hash_scan_next(&scan)) != NULL) {
+			snapshot->ext_points[i++] = hnode_get(hnode);
+		}
+		snapshot->ext_points[i] = NULL;
+		
+		// Copy extensions sorted by extension point, in installation order
+		i = 0;
+		hash_scan_begin(&scan, env->extensions);
+		while ((hnode = hash_scan_next(&scan)) != NULL) {
+			nodes[i++] = hnode;
+		}
+		qsort(nodes, snapshot->num_groups, sizeof(hnode_t *), comp_ext_nodes);
+		for (i = 0, n = 0; i < snapshot->num_groups; i++) {
+			cpi_ptrvec_t *ev = hnode_get(nodes[i]);
+			int j;
+			
+			snapshot->groups[i].first = n;
+			snapshot->groups[i].num = ev->count;
+			for (j = 0; j < ev->num_slots; j++) {
+				if (ev->ptrs[j] != NULL) {
+					snapshot->extensions[n++] = ev->ptrs[j];
+				}
+			}
+			
+			// Use a key owned by the snapshot plug-ins, not the interned key
+			snapshot->groups[i].ext_point_id = snapshot->extensions[snapshot->groups[i].first]->ext_point_id;
+		}
+		snapshot->extensions[n] = NULL;
+		
+		// Keep the information of the installed plug-ins in use
+		i = 0;
+		hash_scan_begin(&scan, env->plugins);
+		while ((hnode = hash_scan_next(&scan)) != NULL) {
+			cp_plugin_t *rp = hnode_get(hnode);
+			
+			cpi_use_info(context, rp->plugin);
+			snapshot->plugins[i++] = rp->plugin;
+			if (cpi_plugin_lazy_cfg(rp->plugin) != NULL) {
+				snapshot->lazy_cfg = 1;
+			}
+		}
+		snapshot->plugins[i] = NULL;
+		
+	} while (0);
+	if (snapshot == NULL) {
+		cpi_destroy_arena(arena);
+	}
+	return snapshot;
+}
+
+/**
+ * Frees a snapshot and releases the plug-in information used by it.
+ * 
+ * @param context the plug-in context
+ * @param snapshot the snapshot
+ */
+static void free_snapshot(cp_context_t *context, cp_ext_snapshot_t *snapshot) {
+	int i;
+	
+	assert(cpi_is_context_locked(context));
+	for (i = 0; i < snapshot->num_plugins; i++) {
+		cpi_release_info(context, snapshot->plugins[i]);
+	}
+	cpi_destroy_arena(snapshot->arena);
+}
+
+/**
+ * Frees those retired snapshots that are not referenced anymore.
+ * 
+ * @param context the plug-in context
+ * @param force whether to free all retired snapshots
+ */
+static void sweep_snapshots(cp_context_t *context, int force) {
+	cp_plugin_env_t *env = context->env;
+	lnode_t *lnode;
+	
+	assert(cpi_is_context_locked(context));
+	lock_snapshots(env);
+	lnode = list_first(env->retired_snapshots);
+	while (lnode != NULL) {
+		lnode_t *next = list_next(env->retired_snapshots, lnode);
+		cp_ext_snapshot_t *snapshot = lnode_get(lnode);
+		
+		if (snapshot->refs == 0 || force) {
+			if (snapshot->refs > 0) {
+				cpi_errorf(context, N_("An unreleased extension snapshot was encountered at address %p with reference count %d when destroying the associated plug-in context. Releasing the object."), (void *) snapshot, snapshot->refs);
+			}
+			list_delete(env->retired_snapshots, lnode);
+			cpi_destroy_lnode(env->nodes, lnode);
+			unlock_snapshots(env);
+			free_snapshot(context, snapshot);
+			lock_snapshots(env);
+		}
+		lnode = next;
+	}
+	unlock_snapshots(env);
+}
+
+CP_HIDDEN void cpi_invalidate_ext_snapshot(cp_context_t *context) {
+	cp_plugin_env_t *env = context->env;
+	cp_ext_snapshot_t *snapshot;
+	lnode_t *lnode = NULL;
+	
+	assert(cpi_is_context_locked(context));
+	if (env->ext_snapshot == NULL && list_isempty(env->retired_snapshots)) {
+		return;
+	}
+	
+	// Retire the published snapshot 
+	lock_snapshots(env);
+	snapshot = env->ext_snapshot;
+	if (snapshot != NULL) {
+		env->ext_snapshot = NULL;
+		snapshot->refs--;
+		if ((lnode = cpi_create_lnode(env->nodes, snapshot)) != NULL) {
+			list_append(env->retired_snapshots, lnode);
+		}
+	}
+	unlock_snapshots(env);
+	
+	// Free the snapshot right away if retiring it failed
+	if (snapshot != NULL && lnode == NULL) {
+		assert(snapshot->refs == 0);
+		free_snapshot(context, snapshot);
+	}
+	
+	sweep_snapshots(context, 0);
+}
+
+CP_HIDDEN void cpi_free_ext_snapshots(cp_context_t *context) {
+	cpi_invalidate_ext_snapshot(context);
+	sweep_snapshots(context, 1);
+}
+
+CP_C_API cp_ext_snapshot_t * cp_get_ext_snapshot(cp_context_t *context, cp_status_t *error) {
+	cp_plugin_env_t *env;
+	cp_ext_snapshot_t *snapshot;
+	cp_status_t status = CP_OK;
+	
+	CHECK_NOT_NULL(context);
+	env = context->env;
+	
+	// Use the published snapshot, if any
+	lock_snapshots(env);
+	if ((snapshot = env->ext_snapshot) != NULL) {
+		snapshot->refs++;
+	}
+	unlock_snapshots(env);
+	
+	// Otherwise build and publish a new snapshot
+	if (snapshot == NULL) {
+		cpi_lock_context(context);
+		cpi_check_invocation(context, CPI_CF_LOGGER, __func__);
+		lock_snapshots(env);
+		if ((snapshot = env->ext_snapshot) != NULL) {
+			snapshot->refs++;
+		}
+		unlock_snapshots(env);
+		if (snapshot == NULL) {
+			if ((snapshot = build_snapshot(context)) != NULL) {
+				snapshot->refs = 2;
+				lock_snapshots(env);
+				env->ext_snapshot = snapshot;
+				unlock_snapshots(env);
+			} else {
+				cpi_error(context, N_("Extension snapshot could not be created due to insufficient memory."));
+				status = CP_ERR_RESOURCE;
+			}
+			sweep_snapshots(context, 0);
+		}
+		cpi_unlock_context(context);
+	}
+	
+	if (error != NULL) {
+		*error = status;
+	}
+	return snapshot;
+}
+
+CP_C_API cp_ext_point_t * const * cp_get_snapshot_ext_points(const cp_ext_snapshot_t *snapshot, int *num) {
+	CHECK_NOT_NULL(snapshot);
+	if (num != NULL) {
+		*num = snapshot->num_ext_points;
+	}
+	return snapshot->ext_points;
+}
+
+/**
+ * Parses the lazily parsed configuration of the specified extensions.
+ * 
+ * @param snapshot the extension snapshot
+ * @param extensions the extensions
+ * @param num the number of extensions
+ */
+static void load_snapshot_cfg(const cp_ext_snapshot_t *snapshot, cp_extension_t * const *extensions, int num) {
+	int i;
+	
+	if (snapshot->lazy_cfg) {
+		for (i = 0; i < num; i++) {
+			cpi_load_ext_cfg(extensions[i]);
+		}
+	}
+}
+
+CP_C_API cp_extension_t * const * cp_get_snapshot_extensions(const cp_ext_snapshot_t *snapshot, const char *extpt_id, int *num) {
+	int low, high;
+	
+	CHECK_NOT_NULL(snapshot);
+	if (extpt_id == NULL) {
+		load_snapshot_cfg(snapshot, snapshot->extensions, snapshot->num_extensions);
+		if (num != NULL) {
+			*num = snapshot->num_extensions;
+		}
+		return snapshot->extensions;
+	}
+	
+	// Binary search for the extension point
+	low = 0;
+	high = snapshot->num_groups;
+	while (low < high) {
+		int mid = low + (high - low) / 2;
+		int c = strcmp(extpt_id, snapshot->groups[mid].ext_point_id);
+		
+		if (c == 0) {
+			load_snapshot_cfg(snapshot, snapshot->extensions + snapshot->groups[mid].first,
+				snapshot->groups[mid].num);
+			if (num != NULL) {
+				*num = snapshot->groups[mid].num;
+			}
+			return snapshot->extensions + snapshot->groups[mid].first;
+		} else if (c > 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	if (num != NULL) {
+		*num = 0;
+	}
+	return snapshot->extensions + snapshot->num_extensions;
+}
+
+CP_C_API void cp_release_ext_snapshot(cp_ext_snapshot_t *snapshot) {
+	cp_plugin_env_t *env;
+	
+	CHECK_NOT_NULL(snapshot);
+	env = snapshot->env;
+	lock_snapshots(env);
+	assert(snapshot->refs > 0);
+	snapshot->refs--;
+	unlock_snapshots(env);
+}
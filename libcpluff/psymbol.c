@@ -37,6 +37,7 @@
 #include "defines.h"
 #include "internal.h"
 #include "util.h"
+#include "trace.h"
 
 
 /* ------------------------------------------------------------------------
@@ -57,6 +58,8 @@ typedef struct symbol_provider_info_t {
 	
 } symbol_provider_info_t;
 
+typedef struct symbol_cache_entry_t symbol_cache_entry_t;
+
 /// Information about used symbol
 typedef struct symbol_info_t {
 
@@ -66,8 +69,39 @@ typedef struct symbol_info_t {
 	// Information about providing plug-in
 	symbol_provider_info_t *provider_info;
 	
+	// The symbol pointer
+	void *symbol;
+	
+	// Symbol cache entries resolving to this symbol
+	symbol_cache_entry_t *cache_entries;
+	
 } symbol_info_t;
 
+/// Symbol cache key
+typedef struct symbol_key_t {
+	
+	// The identifier of the symbol defining plug-in
+	const char *plugin_id;
+	
+	// The symbol name
+	const char *name;
+	
+} symbol_key_t;
+
+/// A cached resolution of a currently used symbol
+struct symbol_cache_entry_t {
+	
+	// The key, pointing to the data following the entry
+	symbol_key_t key;
+	
+	// The used symbol
+	symbol_info_t *symbol_info;
+	
+	// The next cache entry resolving to the same symbol
+	symbol_cache_entry_t *next;
+	
+};
+
 
 /* ------------------------------------------------------------------------
  * Function definitions
@@ -90,7 +124,7 @@ CP_C_API cp_status_t cp_define_symbol(cp_context_t *context, const char *name, v
 		
 		// Create a symbol hash if necessary
 		if (context->plugin->defined_symbols == NULL) {
-			if ((context->plugin->defined_symbols = hash_create(HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL) {
+			if ((context->plugin->defined_symbols = cpi_create_pooled_hash(context->env->nodes, HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL) {
 				status = CP_ERR_RESOURCE;
 				break;
 			}
@@ -130,7 +164,243 @@ CP_C_API cp_status_t cp_define_symbol(cp_context_t *context, const char *name, v
 	return status;
 }
 
-CP_C_API void * cp_resolve_symbol(cp_context_t *context, const char *id, const char *name, cp_status_t *error) {
+CP_C_API cp_status_t cp_define_symbols(cp_context_t *context, const cp_symbol_def_t *table, unsigned int num) {
+	cp_status_t status = CP_OK;
+	cp_plugin_t *plugin;
+	int i;
+	
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(table);
+	if ((plugin = context->plugin) == NULL) {
+		cpi_fatalf(_("Only plug-ins can define context specific symbols."));
+	}
+	
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER | CPI_CF_LISTENER, __func__);
+	do {
+		cpi_symbol_table_t *tables;
+		
+		// Check for a previously defined table
+		for (i = 0; i < plugin->num_symbol_tables; i++) {
+			if (plugin->symbol_tables[i].defs == table) {
+				status = CP_ERR_CONFLICT;
+				break;
+			}
+		}
+		if (status != CP_OK) {
+			break;
+		}
+		
+		// Append the table, growing the array in powers of two
+		if ((plugin->num_symbol_tables & (plugin->num_symbol_tables - 1)) == 0) {
+			int size = (plugin->num_symbol_tables > 0 ? plugin->num_symbol_tables * 2 : 1);
+			
+			if ((tables = realloc(plugin->symbol_tables, size * sizeof(cpi_symbol_table_t))) == NULL) {
+				status = CP_ERR_RESOURCE;
+				break;
+			}
+			plugin->symbol_tables = tables;
+		}
+		plugin->symbol_tables[plugin->num_symbol_tables].defs = table;
+		plugin->symbol_tables[plugin->num_symbol_tables].num = num;
+		plugin->num_symbol_tables++;
+		
+	} while (0);
+	
+	// Report error
+	if (status == CP_ERR_RESOURCE) {
+		cpi_errorf(context, N_("Plug-in %s could not define a symbol table due to insufficient memory."), plugin->plugin->identifier);
+	} else if (status == CP_ERR_CONFLICT) {
+		cpi_errorf(context, N_("Plug-in %s tried to redefine a symbol table."), plugin->plugin->identifier);
+	}
+	cpi_unlock_context(context);
+	
+	return status;
+}
+
+/**
+ * Returns the 32-bit FNV-1a hash of a symbol name with the specified seed,
+ * as documented for ::cp_symbol_def_t.
+ * 
+ * @param name the symbol name
+ * @param seed the seed
+ * @return the hash value
+ */
+static unsigned long symbol_hash(const char *name, unsigned long seed) {
+	unsigned char s[4];
+	int i;
+	
+	for (i = 0; i < 4; i++) {
+		s[i] = (unsigned char) ((seed >> (8 * i)) & 0xff);
+	}
+	return cpi_fnv_hash(name, strlen(name), cpi_fnv_hash(s, 4, CPI_FNV_INIT));
+}
+
+/**
+ * Looks up a symbol in a static symbol table. Hashed tables are probed
+ * directly and other tables are searched sequentially.
+ * 
+ * @param table the symbol table
+ * @param name the symbol name
+ * @return the symbol or NULL if not found
+ */
+static void *lookup_symbol_table(const cpi_symbol_table_t *table, const char *name) {
+	unsigned int i;
+	
+	if (table->num == 0) {
+		return NULL;
+	}
+	if (table->defs[0].disp != 0) {
+		const cp_symbol_def_t *def;
+		
+		i = symbol_hash(name, 0) % table->num;
+		def = table->defs + symbol_hash(name, table->defs[i].disp - 1) % table->num;
+		return (!strcmp(def->name, name) ? def->symbol : NULL);
+	}
+	for (i = 0; i < table->num; i++) {
+		if (!strcmp(table->defs[i].name, name)) {
+			return table->defs[i].symbol;
+		}
+	}
+	return NULL;
+}
+
+#ifdef CP_THREADS
+#define lock_symbols(ctx) cpi_lock_mutex((ctx)->symbols_mutex)
+#define unlock_symbols(ctx) cpi_unlock_mutex((ctx)->symbols_mutex)
+#else
+#define lock_symbols(ctx) do {} while (0)
+#define unlock_symbols(ctx) do {} while (0)
+#endif
+
+static int comp_symbol_key(const void *k1, const void *k2) {
+	const symbol_key_t *key1 = k1;
+	const symbol_key_t *key2 = k2;
+	int diff;
+
+	if ((diff = strcmp(key1->name, key2->name)) != 0) {
+		return diff;
+	}
+	return strcmp(key1->plugin_id, key2->plugin_id);
+}
+
+static hash_val_t hash_symbol_key(const void *k) {
+	const symbol_key_t *key = k;
+
+	return hash_fun_string(key->plugin_id) * 31 + hash_fun_string(key->name);
+}
+
+/**
+ * Looks up a symbol currently used by the specified context and increases
+ * its usage count. This is the fast path of symbol resolution and it
+ * requires only shared access to the context.
+ *
+ * @param context the plug-in context
+ * @param id the identifier of the symbol defining plug-in
+ * @param name the name of the symbol
+ * @return the symbol or NULL if not currently used
+ */
+static void *use_cached_symbol(cp_context_t *context, const char *id, const char *name) {
+	void *symbol = NULL;
+
+	assert(cpi_is_context_locked(context));
+	if (context->symbol_cache != NULL) {
+		symbol_key_t key;
+		hnode_t *node;
+
+		key.plugin_id = id;
+		key.name = name;
+		lock_symbols(context);
+		if ((node = hash_lookup(context->symbol_cache, &key)) != NULL) {
+			symbol_cache_entry_t *entry = hnode_get(node);
+
+			assert(entry->symbol_info->usage_count > 0);
+			entry->symbol_info->usage_count++;
+			entry->symbol_info->provider_info->usage_count++;
+			symbol = entry->symbol_info->symbol;
+		}
+		unlock_symbols(context);
+	}
+	if (symbol != NULL) {
+		cpi_debugm(context, CP_MSG_SYMBOL_RESOLVED, id, name, NULL, 0);
+	}
+	return symbol;
+}
+
+/**
+ * Adds a resolution of a used symbol to the symbol cache of the specified
+ * context. Failure to allocate memory is ignored, the symbol just remains
+ * uncached. The caller must have exclusive access to the context.
+ *
+ * @param context the plug-in context
+ * @param symbol_info the used symbol
+ * @param id the identifier of the symbol defining plug-in
+ * @param name the name of the symbol
+ */
+static void cache_symbol(cp_context_t *context, symbol_info_t *symbol_info, const char *id, const char *name) {
+	symbol_cache_entry_t *entry;
+	size_t id_len, name_len;
+	char *data;
+
+	// Create the cache if necessary
+	if (context->symbol_cache == NULL) {
+		if ((context->symbol_cache = cpi_create_pooled_hash(context->env->nodes, HASHCOUNT_T_MAX, comp_symbol_key, hash_symbol_key)) == NULL) {
+			return;
+		}
+	}
+
+	// Allocate an entry with space for copies of the key strings
+	id_len = strlen(id) + 1;
+	name_len = strlen(name) + 1;
+	if ((entry = malloc(sizeof(symbol_cache_entry_t) + id_len + name_len)) == NULL) {
+		return;
+	}
+	data = (char *) (entry + 1);
+	memcpy(data, id, id_len);
+	memcpy(data + id_len, name, name_len);
+	entry->key.plugin_id = data;
+	entry->key.name = data + id_len;
+	entry->symbol_info = symbol_info;
+	if (!hash_alloc_insert(context->symbol_cache, &(entry->key), entry)) {
+		free(entry);
+		return;
+	}
+	entry->next = symbol_info->cache_entries;
+	symbol_info->cache_entries = entry;
+}
+
+/**
+ * Frees the information about a symbol which is not used anymore,
+ * including the associated symbol cache entries. The caller must have
+ * exclusive access to the context.
+ *
+ * @param context the plug-in context
+ * @param symbol_info the symbol information
+ */
+static void free_symbol_info(cp_context_t *context, symbol_info_t *symbol_info) {
+	while (symbol_info->cache_entries != NULL) {
+		symbol_cache_entry_t *entry = symbol_info->cache_entries;
+		hnode_t *node;
+
+		symbol_info->cache_entries = entry->next;
+		node = hash_lookup(context->symbol_cache, &(entry->key));
+		assert(node != NULL);
+		hash_delete_free(context->symbol_cache, node);
+		free(entry);
+	}
+	free(symbol_info);
+}
+
+/**
+ * Resolves a symbol. The caller must have exclusive access to the context.
+ *
+ * @param context the plug-in context
+ * @param id the identifier of the symbol defining plug-in
+ * @param name the name of the symbol
+ * @param error filled with the status code
+ * @return the symbol or NULL on failure
+ */
+static void *resolve_symbol(cp_context_t *context, const char *id, const char *name, cp_status_t *error) {
 	cp_status_t status = CP_OK;
 	int error_reported = 1;
 	hnode_t *node;
@@ -138,22 +408,22 @@ CP_C_API void * cp_resolve_symbol(cp_context_t *context, const char *id, const c
 	symbol_info_t *symbol_info = NULL;
 	symbol_provider_info_t *provider_info = NULL;
 	cp_plugin_t *pp = NULL;
+	int i;
 
-	CHECK_NOT_NULL(context);
-	CHECK_NOT_NULL(id);
-	CHECK_NOT_NULL(name);
-	
 	// Resolve the symbol
-	cpi_lock_context(context);
-	cpi_check_invocation(context, CPI_CF_LOGGER | CPI_CF_LISTENER | CPI_CF_STOP, __func__);
 	do {
 
+		// Use a cached resolution, if any
+		if ((symbol = use_cached_symbol(context, id, name)) != NULL) {
+			break;
+		}
+
 		// Allocate space for symbol hashes, if necessary
 		if (context->resolved_symbols == NULL) {
-			context->resolved_symbols = hash_create(HASHCOUNT_T_MAX, cpi_comp_ptr, cpi_hashfunc_ptr);
+			context->resolved_symbols = cpi_create_pooled_hash(context->env->nodes, HASHCOUNT_T_MAX, cpi_comp_ptr, cpi_hashfunc_ptr);
 		}
 		if (context->symbol_providers == NULL) {
-			context->symbol_providers = hash_create(HASHCOUNT_T_MAX, cpi_comp_ptr, cpi_hashfunc_ptr);
+			context->symbol_providers = cpi_create_pooled_hash(context->env->nodes, HASHCOUNT_T_MAX, cpi_comp_ptr, cpi_hashfunc_ptr);
 		}
 		if (context->resolved_symbols == NULL
 			|| context->symbol_providers == NULL) {
@@ -181,11 +451,25 @@ CP_C_API void * cp_resolve_symbol(cp_context_t *context, const char *id, const c
 		if (pp->defined_symbols != NULL && (node = hash_lookup(pp->defined_symbols, name)) != NULL) {
 			symbol = hnode_get(node);
 		}
+		for (i = 0; symbol == NULL && i < pp->num_symbol_tables; i++) {
+			symbol = lookup_symbol_table(pp->symbol_tables + i, name);
+		}
 
 		// Fall back to global symbols, if necessary
 		if (symbol == NULL && pp->runtime_lib != NULL) {
 			symbol = DLSYM(pp->runtime_lib, name);
 		}
+
+		// Built-in plug-ins use a static symbol table instead
+		if (symbol == NULL && pp->builtin_symbols != NULL) {
+			const cp_builtin_symbol_t *bs;
+			
+			for (bs = pp->builtin_symbols; bs->name != NULL && symbol == NULL; bs++) {
+				if (!strcmp(bs->name, name)) {
+					symbol = bs->symbol;
+				}
+			}
+		}
 		if (symbol == NULL) {
 			const char *error = DLERROR();
 			if (error == NULL) {
@@ -212,7 +496,7 @@ CP_C_API void * cp_resolve_symbol(cp_context_t *context, const char *id, const c
 				break;
 			}
 		}
-		
+
 		// Lookup or initialize symbol information
 		if ((node = hash_lookup(context->resolved_symbols, symbol)) != NULL) {
 			symbol_info = hnode_get(node);
@@ -223,37 +507,37 @@ CP_C_API void * cp_resolve_symbol(cp_context_t *context, const char *id, const c
 			}
 			memset(symbol_info, 0, sizeof(symbol_info_t));
 			symbol_info->provider_info = provider_info;
+			symbol_info->symbol = symbol;
 			if (!hash_alloc_insert(context->resolved_symbols, symbol, symbol_info)) {
 				status = CP_ERR_RESOURCE;
 				break;
 			}
 		}
-		
+
 		// Add dependencies (for plug-in)
 		if (provider_info != NULL
 			&& !provider_info->imported
 			&& provider_info->usage_count == 0) {
-			if (!cpi_ptrset_add(context->plugin->imported, pp)) {
+			if (!cpi_ptrset_add(context->env->nodes, context->plugin->imported, pp)) {
 				status = CP_ERR_RESOURCE;
 				break;
 			}
-			if (!cpi_ptrset_add(pp->importing, context->plugin)) {
-				cpi_ptrset_remove(context->plugin->imported, pp);
+			if (!cpi_ptrset_add(context->env->nodes, pp->importing, context->plugin)) {
+				cpi_ptrset_remove(context->env->nodes, context->plugin->imported, pp);
 				status = CP_ERR_RESOURCE;
 				break;
 			}
-			cpi_debugf(context, N_("A dynamic dependency was created from plug-in %s to plug-in %s."), context->plugin->plugin->identifier, pp->plugin->identifier);
+			cpi_debugm(context, CP_MSG_DEPENDENCY_ADDED, pp->plugin->identifier, NULL, NULL, 0);
 		}
-		
+
 		// Increase usage counts
 		symbol_info->usage_count++;
 		provider_info->usage_count++;
 
-		if (cpi_is_logged(context, CP_LOG_DEBUG)) {
-			char owner[64];
-			/* TRANSLATORS: First %s is the context owner */
-			cpi_debugf(context, N_("%s resolved symbol %s defined by plug-in %s."), cpi_context_owner(context, owner, sizeof(owner)), name, id);
-		}
+		// Cache the resolution for subsequent calls
+		cache_symbol(context, symbol_info, id, name);
+
+		cpi_debugm(context, CP_MSG_SYMBOL_RESOLVED, id, name, NULL, 0);
 	} while (0);
 
 	// Clean up
@@ -261,7 +545,7 @@ CP_C_API void * cp_resolve_symbol(cp_context_t *context, const char *id, const c
 		if ((node = hash_lookup(context->resolved_symbols, symbol)) != NULL) {
 			hash_delete_free(context->resolved_symbols, node);
 		}
-		free(symbol_info);
+		free_symbol_info(context, symbol_info);
 	}
 	if (provider_info != NULL && provider_info->usage_count == 0) {
 		if ((node = hash_lookup(context->symbol_providers, pp)) != NULL) {
@@ -274,67 +558,164 @@ CP_C_API void * cp_resolve_symbol(cp_context_t *context, const char *id, const c
 	if (status == CP_ERR_RESOURCE && !error_reported) {
 		cpi_errorf(context, N_("Symbol %s in plug-in %s could not be resolved due to insufficient memory."), name, id);
 	}
-	cpi_unlock_context(context);
 
-	// Return error code
-	if (error != NULL) {
-		*error = status;
+	// Return error code and symbol
+	*error = status;
+	if (status != CP_OK) {
+		symbol = NULL;
 	}
-	
-	// Return symbol
 	return symbol;
 }
 
-CP_C_API void cp_release_symbol(cp_context_t *context, const void *ptr) {
+/**
+ * Releases a used symbol. The caller must have exclusive access to the
+ * context.
+ *
+ * @param context the plug-in context
+ * @param ptr the pointer associated with the symbol
+ */
+static void release_symbol(cp_context_t *context, const void *ptr) {
 	hnode_t *node;
 	symbol_info_t *symbol_info;
 	symbol_provider_info_t *provider_info;
-	
-	CHECK_NOT_NULL(context);
-	CHECK_NOT_NULL(ptr);
 
-	cpi_lock_context(context);
-	cpi_check_invocation(context, CPI_CF_LOGGER | CPI_CF_LISTENER, __func__);
 	do {
 
 		// Look up the symbol
-		if ((node = hash_lookup(context->resolved_symbols, ptr)) == NULL) {
+		if (context->resolved_symbols == NULL
+			|| (node = hash_lookup(context->resolved_symbols, ptr)) == NULL) {
 			cpi_errorf(context, N_("Could not release unknown symbol at address %p."), ptr);
 			break;
 		}
 		symbol_info = hnode_get(node);
 		provider_info = symbol_info->provider_info;
-	
+
 		// Decrease usage count
 		assert(symbol_info->usage_count > 0);
 		symbol_info->usage_count--;
 		assert(provider_info->usage_count > 0);
 		provider_info->usage_count--;
-	
+
 		// Check if the symbol is not being used anymore
 		if (symbol_info->usage_count == 0) {
 			hash_delete_free(context->resolved_symbols, node);
-			free(symbol_info);
-			if (cpi_is_logged(context, CP_LOG_DEBUG)) {
-				char owner[64];
-				/* TRANSLATORS: First %s is the context owner */
-				cpi_debugf(context, N_("%s released the symbol at address %p defined by plug-in %s."), cpi_context_owner(context, owner, sizeof(owner)), ptr, provider_info->plugin->plugin->identifier);
-			}
+			free_symbol_info(context, symbol_info);
+			cpi_debugm(context, CP_MSG_SYMBOL_RELEASED, provider_info->plugin->plugin->identifier, NULL, ptr, 0);
 		}
-	
+
 		// Check if the symbol providing plug-in is not being used anymore
 		if (provider_info->usage_count == 0) {
 			node = hash_lookup(context->symbol_providers, provider_info->plugin);
 			assert(node != NULL);
 			hash_delete_free(context->symbol_providers, node);
 			if (!provider_info->imported) {
-				cpi_ptrset_remove(context->plugin->imported, provider_info->plugin);
-				cpi_ptrset_remove(provider_info->plugin->importing, context->plugin);
-				cpi_debugf(context, N_("A dynamic dependency from plug-in %s to plug-in %s was removed."), context->plugin->plugin->identifier, provider_info->plugin->plugin->identifier);
+				cpi_ptrset_remove(context->env->nodes, context->plugin->imported, provider_info->plugin);
+				cpi_ptrset_remove(context->env->nodes, provider_info->plugin->importing, context->plugin);
+				cpi_debugm(context, CP_MSG_DEPENDENCY_REMOVED, provider_info->plugin->plugin->identifier, NULL, NULL, 0);
 			}
 			free(provider_info);
 		}
-		
+
 	} while (0);
+}
+
+CP_C_API void * cp_resolve_symbol(cp_context_t *context, const char *id, const char *name, cp_status_t *error) {
+	cp_status_t status = CP_OK;
+	void *symbol;
+
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(id);
+	CHECK_NOT_NULL(name);
+
+	// Try symbols already used by this context first
+	cpi_lock_context_shared(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER | CPI_CF_LISTENER | CPI_CF_STOP, __func__);
+	symbol = use_cached_symbol(context, id, name);
+	cpi_unlock_context_shared(context);
+
+	// Otherwise resolve the symbol
+	if (symbol == NULL) {
+		cpi_lock_context(context);
+		cpi_check_invocation(context, CPI_CF_LOGGER | CPI_CF_LISTENER | CPI_CF_STOP, __func__);
+		cpi_wait_parallel_starts(context);
+		symbol = resolve_symbol(context, id, name, &status);
+		cpi_unlock_context(context);
+	}
+	CPI_TRACE4(symbol__resolve, id, name, symbol, status);
+
+	// Return error code
+	if (error != NULL) {
+		*error = status;
+	}
+
+	// Return symbol
+	return symbol;
+}
+
+CP_C_API cp_status_t cp_resolve_symbols(cp_context_t *context, const char *id, const char * const *names, void **symbols, int num) {
+	cp_status_t status = CP_OK;
+	int i;
+
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(id);
+	CHECK_NOT_NULL(names);
+	CHECK_NOT_NULL(symbols);
+
+	cpi_lock_context(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER | CPI_CF_LISTENER | CPI_CF_STOP, __func__);
+	cpi_wait_parallel_starts(context);
+	for (i = 0; i < num && status == CP_OK; i++) {
+		symbols[i] = resolve_symbol(context, id, names[i], &status);
+		CPI_TRACE4(symbol__resolve, id, names[i], symbols[i], status);
+	}
+
+	// Release already resolved symbols on failure
+	if (status != CP_OK) {
+		for (i--; i > 0; i--) {
+			release_symbol(context, symbols[i - 1]);
+		}
+		for (i = 0; i < num; i++) {
+			symbols[i] = NULL;
+		}
+	}
 	cpi_unlock_context(context);
+
+	return status;
+}
+
+CP_C_API void cp_release_symbol(cp_context_t *context, const void *ptr) {
+	int released = 0;
+
+	CHECK_NOT_NULL(context);
+	CHECK_NOT_NULL(ptr);
+	CPI_TRACE1(symbol__release, ptr);
+
+	// Symbols remaining in use can be released with shared access
+	cpi_lock_context_shared(context);
+	cpi_check_invocation(context, CPI_CF_LOGGER | CPI_CF_LISTENER, __func__);
+	if (context->resolved_symbols != NULL) {
+		hnode_t *node;
+
+		lock_symbols(context);
+		if ((node = hash_lookup(context->resolved_symbols, ptr)) != NULL) {
+			symbol_info_t *symbol_info = hnode_get(node);
+
+			if (symbol_info->usage_count > 1
+				&& symbol_info->provider_info->usage_count > 1) {
+				symbol_info->usage_count--;
+				symbol_info->provider_info->usage_count--;
+				released = 1;
+			}
+		}
+		unlock_symbols(context);
+	}
+	cpi_unlock_context_shared(context);
+
+	// Otherwise release the symbol with exclusive access
+	if (!released) {
+		cpi_lock_context(context);
+		cpi_check_invocation(context, CPI_CF_LOGGER | CPI_CF_LISTENER, __func__);
+		release_symbol(context, ptr);
+		cpi_unlock_context(context);
+	}
 }
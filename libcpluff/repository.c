@@ -0,0 +1,958 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file
+ * Repository plug-in loader
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+#if defined(HAVE_LINK) && defined(HAVE_UNISTD_H)
+#include <unistd.h>
+#endif
+#include "../kazlib/hash.h"
+#include "cpluff.h"
+#include "defines.h"
+#include "util.h"
+#include "internal.h"
+
+
+/* ------------------------------------------------------------------------
+ * Constants
+ * ----------------------------------------------------------------------*/
+
+/// The repository path of the index
+#define INDEX_PATH "index"
+
+/// The maximum length of an index line
+#define MAX_INDEX_LINE 4096
+
+
+/* ------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------*/
+
+#ifdef _WIN32
+#define make_dir(path) _mkdir(path)
+#else
+#define make_dir(path) mkdir((path), 0777)
+#endif
+
+
+/* ------------------------------------------------------------------------
+ * Data types
+ * ----------------------------------------------------------------------*/
+
+/// A file listed in the repository index
+typedef struct rpl_entry_t {
+
+	/// The path of the file in the repository, using '/' as the separator
+	char *path;
+
+	/// The digest of the file contents
+	char *digest;
+
+	/// Whether fetching the file failed
+	int failed;
+} rpl_entry_t;
+
+/// Repository plug-in loader data
+typedef struct rpl_data_t {
+
+	/// The local cache directory
+	char *cache_dir;
+
+	/// The function fetching files from the repository
+	cp_fetch_func_t fetch;
+
+	/// The user data pointer passed to the fetch function
+	void *user_data;
+
+	/// The number of threads used for fetching files (0 or 1 for none)
+	unsigned int num_fetch_threads;
+
+	/**
+	 * The keys of the plug-in directories returned by the previous scan,
+	 * protected by the framework lock
+	 */
+	hash_t *seen;
+
+	/// The context the seen plug-in directories were recorded for
+	cp_context_t *seen_context;
+} rpl_data_t;
+
+/// Shared state of fetching files
+typedef struct fetch_pool_t {
+
+	/// The loader data
+	rpl_data_t *rpl;
+
+#ifdef CP_THREADS
+	/// The mutex protecting the next job index or NULL if not fetching in parallel
+	cpi_mutex_t *mutex;
+#endif
+
+	/// The files to be fetched
+	rpl_entry_t **jobs;
+
+	/// The number of files to be fetched
+	int num_jobs;
+
+	/// The index of the next file to be fetched
+	int next_job;
+} fetch_pool_t;
+
+
+/* ------------------------------------------------------------------------
+ * Function definitions
+ * ----------------------------------------------------------------------*/
+
+/**
+ * Constructs a local path by appending a repository path to a directory.
+ * The separators of the repository path are converted to the local
+ * file name separator.
+ *
+ * @param dir the directory
+ * @param path the repository path or a prefix of it
+ * @param path_len the length of the repository path
+ * @return the path, to be freed by the caller, or NULL if insufficient memory
+ */
+static char *local_path(const char *dir, const char *path, size_t path_len) {
+	size_t dir_len = strlen(dir);
+	char *p;
+	size_t i;
+
+	if (dir_len > 0 && dir[dir_len - 1] == CP_FNAMESEP_CHAR) {
+		dir_len--;
+	}
+	if ((p = malloc((dir_len + 1 + path_len + 1) * sizeof(char))) == NULL) {
+		return NULL;
+	}
+	strncpy(p, dir, dir_len);
+	p[dir_len] = CP_FNAMESEP_CHAR;
+	for (i = 0; i < path_len; i++) {
+		p[dir_len + 1 + i] = (path[i] == '/' ? CP_FNAMESEP_CHAR : path[i]);
+	}
+	p[dir_len + 1 + path_len] = '\0';
+	return p;
+}
+
+/**
+ * Returns whether the specified file exists.
+ *
+ * @param file the file
+ * @return whether the file exists
+ */
+static int file_exists(const char *file) {
+	FILE *fh;
+
+	if ((fh = fopen(file, "rb")) == NULL) {
+		return 0;
+	}
+	fclose(fh);
+	return 1;
+}
+
+/**
+ * Creates the parent directories of the specified file as necessary,
+ * starting from the specified position.
+ *
+ * @param file the file
+ * @param start the position from which to start creating directories
+ */
+static void make_parent_dirs(char *file, size_t start) {
+	size_t i;
+
+	for (i = start; file[i] != '\0'; i++) {
+		if (file[i] == CP_FNAMESEP_CHAR && i > 0) {
+			file[i] = '\0';
+			make_dir(file);
+			file[i] = CP_FNAMESEP_CHAR;
+		}
+	}
+}
+
+/**
+ * Constructs the name of the temporary file used while writing a file.
+ *
+ * @param file the file
+ * @return the temporary file name, to be freed by the caller, or NULL if insufficient memory
+ */
+static char *tmp_name(const char *file) {
+	char *tmp;
+
+	if ((tmp = malloc((strlen(file) + 5) * sizeof(char))) != NULL) {
+		strcpy(tmp, file);
+		strcat(tmp, ".tmp");
+	}
+	return tmp;
+}
+
+/**
+ * Fetches a file from the repository to a temporary file which then
+ * replaces the specified local file.
+ *
+ * @param rpl the loader data
+ * @param path the repository path
+ * @param digest the digest of the file or NULL for the index
+ * @param file the local file
+ * @return non-zero on success or zero on failure
+ */
+static int fetch_file(rpl_data_t *rpl, const char *path, const char *digest, const char *file) {
+	char *tmp;
+	int success = 0;
+
+	if ((tmp = tmp_name(file)) == NULL) {
+		return 0;
+	}
+	if (rpl->fetch(path, digest, tmp, rpl->user_data)) {
+		remove(file);
+		success = !rename(tmp, file);
+	}
+	if (!success) {
+		remove(tmp);
+	}
+	free(tmp);
+	return success;
+}
+
+/**
+ * Makes a cached object available at the specified path, using a hard
+ * link if possible and a copy otherwise.
+ *
+ * @param object the cached object
+ * @param file the file to create
+ * @return non-zero on success or zero on failure
+ */
+static int link_object(const char *object, const char *file) {
+	FILE *in = NULL, *out = NULL;
+	char *tmp = NULL;
+	char buffer[4096];
+	size_t n;
+	int success = 0;
+
+#if defined(HAVE_LINK) && defined(HAVE_UNISTD_H)
+	if (!link(object, file)) {
+		return 1;
+	}
+#endif
+	do {
+		if ((tmp = tmp_name(file)) == NULL
+			|| (in = fopen(object, "rb")) == NULL
+			|| (out = fopen(tmp, "wb")) == NULL) {
+			break;
+		}
+		while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+			if (fwrite(buffer, 1, n, out) != n) {
+				break;
+			}
+		}
+		if (ferror(in) || ferror(out)) {
+			break;
+		}
+		if (fclose(out)) {
+			out = NULL;
+			break;
+		}
+		out = NULL;
+		success = !rename(tmp, file);
+	} while (0);
+	if (in != NULL) {
+		fclose(in);
+	}
+	if (out != NULL) {
+		fclose(out);
+	}
+	if (tmp != NULL) {
+		if (!success) {
+			remove(tmp);
+		}
+		free(tmp);
+	}
+	return success;
+}
+
+/**
+ * Returns whether the specified repository path is a safe relative path
+ * within a plug-in directory.
+ *
+ * @param path the repository path
+ * @return whether the path is safe
+ */
+static int is_safe_path(const char *path) {
+	const char *c = path;
+
+	if (*path == '/' || strchr(path, '/') == NULL
+		|| strchr(path, '\\') != NULL || strchr(path, ':') != NULL) {
+		return 0;
+	}
+	while (c != NULL) {
+		if (c[0] == '\0' || c[0] == '/' || (c[0] == '.' && (c[1] == '/' || c[1] == '\0'))
+			|| (c[0] == '.' && c[1] == '.' && (c[2] == '/' || c[2] == '\0'))) {
+			return 0;
+		}
+		if ((c = strchr(c, '/')) != NULL) {
+			c++;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Returns whether the specified digest can be used as a file name.
+ *
+ * @param digest the digest
+ * @return whether the digest is valid
+ */
+static int is_valid_digest(const char *digest) {
+	const char *c;
+
+	for (c = digest; *c != '\0'; c++) {
+		if (!isalnum((unsigned char) *c) && *c != '-' && *c != '_') {
+			return 0;
+		}
+	}
+	return c != digest;
+}
+
+/**
+ * Compares two index entries by path.
+ *
+ * @param e1 the first entry
+ * @param e2 the second entry
+ * @return less than, equal to or greater than zero
+ */
+static int comp_entry_path(const void *e1, const void *e2) {
+	return strcmp(((const rpl_entry_t *) e1)->path, ((const rpl_entry_t *) e2)->path);
+}
+
+/**
+ * Compares two index entry pointers by digest.
+ *
+ * @param e1 the first entry pointer
+ * @param e2 the second entry pointer
+ * @return less than, equal to or greater than zero
+ */
+static int comp_entry_digest(const void *e1, const void *e2) {
+	return strcmp((*(rpl_entry_t * const *) e1)->digest, (*(rpl_entry_t * const *) e2)->digest);
+}
+
+/**
+ * Releases index entries.
+ *
+ * @param entries the entries
+ * @param num_entries the number of entries
+ */
+static void free_entries(rpl_entry_t *entries, int num_entries) {
+	int i;
+
+	for (i = 0; i < num_entries; i++) {
+		free(entries[i].path);
+	}
+	free(entries);
+}
+
+/**
+ * Fetches the repository index and reads the listed files. Falls back to
+ * the previously fetched index if the index can not be fetched. Each line
+ * of the index holds the digest of a file followed by its path in the
+ * repository. Empty lines and lines starting with '#' are ignored. The
+ * entries are sorted by path.
+ *
+ * @param ctx the plug-in context
+ * @param rpl the loader data
+ * @param entriesptr filled with the entries, to be freed using free_entries
+ * @param numptr filled with the number of entries
+ * @return CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t read_index(cp_context_t *ctx, rpl_data_t *rpl, rpl_entry_t **entriesptr, int *numptr) {
+	char *file = NULL;
+	char *line = NULL;
+	FILE *fh = NULL;
+	rpl_entry_t *entries = NULL;
+	int num_entries = 0, size_entries = 0;
+	cp_status_t status = CP_OK;
+
+	do {
+		if ((file = local_path(rpl->cache_dir, INDEX_PATH, strlen(INDEX_PATH))) == NULL
+			|| (line = malloc(MAX_INDEX_LINE)) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+
+		// Fetch the index
+		make_dir(rpl->cache_dir);
+		if (!fetch_file(rpl, INDEX_PATH, NULL, file)) {
+			cpi_lock_context(ctx);
+			cpi_warnf(ctx, N_("Could not fetch the plug-in repository index into %s, using the cached index."), rpl->cache_dir);
+			cpi_unlock_context(ctx);
+		}
+		if ((fh = fopen(file, "r")) == NULL) {
+			status = CP_ERR_IO;
+			break;
+		}
+
+		// Read the entries
+		while (fgets(line, MAX_INDEX_LINE, fh) != NULL) {
+			size_t len = strlen(line);
+			char *digest, *path, *c;
+
+			if (len > 0 && line[len - 1] != '\n' && !feof(fh)) {
+				status = CP_ERR_MALFORMED;
+				break;
+			}
+			while (len > 0 && isspace((unsigned char) line[len - 1])) {
+				line[--len] = '\0';
+			}
+			for (digest = line; isspace((unsigned char) *digest); digest++);
+			if (*digest == '\0' || *digest == '#') {
+				continue;
+			}
+			for (c = digest; *c != '\0' && !isspace((unsigned char) *c); c++);
+			for (path = c; isspace((unsigned char) *path); path++);
+			*c = '\0';
+			if (!is_valid_digest(digest) || !is_safe_path(path)) {
+				status = CP_ERR_MALFORMED;
+				break;
+			}
+			if (num_entries == size_entries) {
+				int ns = (size_entries > 0 ? 2 * size_entries : 16);
+				rpl_entry_t *ne;
+
+				if ((ne = realloc(entries, ns * sizeof(rpl_entry_t))) == NULL) {
+					status = CP_ERR_RESOURCE;
+					break;
+				}
+				entries = ne;
+				size_entries = ns;
+			}
+			if ((entries[num_entries].path = malloc(strlen(path) + 1 + strlen(digest) + 1)) == NULL) {
+				status = CP_ERR_RESOURCE;
+				break;
+			}
+			strcpy(entries[num_entries].path, path);
+			entries[num_entries].digest = entries[num_entries].path + strlen(path) + 1;
+			strcpy(entries[num_entries].digest, digest);
+			entries[num_entries].failed = 0;
+			num_entries++;
+		}
+		if (status == CP_OK && ferror(fh)) {
+			status = CP_ERR_IO;
+		}
+		if (status != CP_OK) {
+			break;
+		}
+		qsort(entries, num_entries, sizeof(rpl_entry_t), comp_entry_path);
+
+	} while (0);
+
+	// Report failure
+	if (status != CP_OK) {
+		cpi_lock_context(ctx);
+		cpi_errorf(ctx, N_("Could not read the plug-in repository index cached in %s."), rpl->cache_dir);
+		cpi_unlock_context(ctx);
+		free_entries(entries, num_entries);
+		entries = NULL;
+		num_entries = 0;
+	}
+
+	// Release resources
+	if (fh != NULL) {
+		fclose(fh);
+	}
+	free(file);
+	free(line);
+
+	*entriesptr = entries;
+	*numptr = num_entries;
+	return status;
+}
+
+/**
+ * Constructs the path of the cached object with the specified digest.
+ *
+ * @param rpl the loader data
+ * @param digest the digest
+ * @return the path, to be freed by the caller, or NULL if insufficient memory
+ */
+static char *object_path(rpl_data_t *rpl, const char *digest) {
+	size_t digest_len = strlen(digest);
+	char *name, *path;
+
+	if ((name = malloc((8 + digest_len + 1) * sizeof(char))) == NULL) {
+		return NULL;
+	}
+	strcpy(name, "objects/");
+	strcpy(name + 8, digest);
+	path = local_path(rpl->cache_dir, name, 8 + digest_len);
+	free(name);
+	return path;
+}
+
+/**
+ * Fetches files until all files of the pool have been claimed.
+ *
+ * @param arg the fetch pool
+ */
+static void fetch_worker(void *arg) {
+	fetch_pool_t *pool = arg;
+
+	while (1) {
+		rpl_entry_t *job;
+		char *object;
+
+		// Claim the next file
+#ifdef CP_THREADS
+		if (pool->mutex != NULL) {
+			cpi_lock_mutex(pool->mutex);
+		}
+#endif
+		job = (pool->next_job < pool->num_jobs ? pool->jobs[pool->next_job++] : NULL);
+#ifdef CP_THREADS
+		if (pool->mutex != NULL) {
+			cpi_unlock_mutex(pool->mutex);
+		}
+#endif
+		if (job == NULL) {
+			break;
+		}
+
+		// Fetch the file into the object cache
+		if ((object = object_path(pool->rpl, job->digest)) == NULL
+			|| !fetch_file(pool->rpl, job->path, job->digest, object)) {
+			job->failed = 1;
+		}
+		free(object);
+	}
+}
+
+/**
+ * Fetches the listed files which are not in the object cache, using the
+ * configured number of threads including the calling thread.
+ *
+ * @param ctx the plug-in context
+ * @param rpl the loader data
+ * @param entries the entries
+ * @param num_entries the number of entries
+ * @return CP_OK (zero) on success or CP_ERR_RESOURCE if insufficient memory
+ */
+static cp_status_t fetch_objects(cp_context_t *ctx, rpl_data_t *rpl, rpl_entry_t *entries, int num_entries) {
+	fetch_pool_t pool;
+	rpl_entry_t **sorted;
+	char *dir;
+	int i;
+#ifdef CP_THREADS
+	cp_task_t **threads = NULL;
+	unsigned int num_threads = rpl->num_fetch_threads;
+	unsigned int num_started = 0;
+#endif
+
+	memset(&pool, 0, sizeof(pool));
+	pool.rpl = rpl;
+	sorted = malloc((num_entries + 1) * sizeof(rpl_entry_t *));
+	pool.jobs = malloc((num_entries + 1) * sizeof(rpl_entry_t *));
+	if (sorted == NULL || pool.jobs == NULL
+		|| (dir = local_path(rpl->cache_dir, "objects", 7)) == NULL) {
+		free(sorted);
+		free(pool.jobs);
+		return CP_ERR_RESOURCE;
+	}
+	make_dir(dir);
+	free(dir);
+
+	// Collect the distinct missing objects
+	for (i = 0; i < num_entries; i++) {
+		sorted[i] = entries + i;
+	}
+	qsort(sorted, num_entries, sizeof(rpl_entry_t *), comp_entry_digest);
+	for (i = 0; i < num_entries; i++) {
+		char *object;
+
+		if (i > 0 && !strcmp(sorted[i - 1]->digest, sorted[i]->digest)) {
+			continue;
+		}
+		if ((object = object_path(rpl, sorted[i]->digest)) == NULL) {
+			free(sorted);
+			free(pool.jobs);
+			return CP_ERR_RESOURCE;
+		}
+		if (!file_exists(object)) {
+			pool.jobs[pool.num_jobs++] = sorted[i];
+		}
+		free(object);
+	}
+
+	// Fetch the objects, in parallel if so configured
+#ifdef CP_THREADS
+	if (num_threads > (unsigned int) pool.num_jobs) {
+		num_threads = pool.num_jobs;
+	}
+	if (num_threads > 1
+		&& (pool.mutex = cpi_create_mutex()) != NULL
+		&& (threads = malloc(num_threads * sizeof(cp_task_t *))) != NULL) {
+		while (num_started + 1 < num_threads
+			&& (threads[num_started] = cpi_spawn_task(fetch_worker, &pool)) != NULL) {
+			num_started++;
+		}
+	}
+	fetch_worker(&pool);
+	while (num_started > 0) {
+		cpi_join_task(threads[--num_started]);
+	}
+	free(threads);
+	if (pool.mutex != NULL) {
+		cpi_destroy_mutex(pool.mutex);
+	}
+#else
+	fetch_worker(&pool);
+#endif
+
+	// Report failures and mark all entries of failed objects
+	cpi_lock_context(ctx);
+	for (i = 0; i < pool.num_jobs; i++) {
+		if (pool.jobs[i]->failed) {
+			cpi_errorf(ctx, N_("Could not fetch %s from the plug-in repository cached in %s."), pool.jobs[i]->path, rpl->cache_dir);
+		}
+	}
+	cpi_unlock_context(ctx);
+	for (i = 1; i < num_entries; i++) {
+		if (!strcmp(sorted[i]->digest, sorted[i - 1]->digest) && sorted[i - 1]->failed) {
+			sorted[i]->failed = 1;
+		}
+	}
+
+	free(sorted);
+	free(pool.jobs);
+	return CP_OK;
+}
+
+/**
+ * Constructs the key identifying the contents of a plug-in directory. The
+ * key is the name of the directory followed by a hash of the paths and
+ * digests of the files in it, so that the key changes whenever any of the
+ * files changes.
+ *
+ * @param entries the entries of the directory
+ * @param num the number of entries
+ * @param name_len the length of the directory name
+ * @return the key, to be freed by the caller, or NULL if insufficient memory
+ */
+static char *dir_key(const rpl_entry_t *entries, int num, size_t name_len) {
+	unsigned long hash = CPI_FNV_INIT;
+	char *key;
+	int i;
+
+	// Hash the terminating characters, too, to separate the strings
+	for (i = 0; i < num; i++) {
+		hash = cpi_fnv_hash(entries[i].path, strlen(entries[i].path) + 1, hash);
+		hash = cpi_fnv_hash(entries[i].digest, strlen(entries[i].digest) + 1, hash);
+	}
+	if ((key = malloc((name_len + 10) * sizeof(char))) == NULL) {
+		return NULL;
+	}
+	strncpy(key, entries[0].path, name_len);
+	sprintf(key + name_len, "-%08lx", hash);
+	return key;
+}
+
+/**
+ * Makes the files of a plug-in directory available in the local plug-in
+ * directory.
+ *
+ * @param rpl the loader data
+ * @param entries the entries of the directory
+ * @param num the number of entries
+ * @param pdir the local plug-in directory
+ * @param name_len the length of the directory name in the repository
+ * @return non-zero on success or zero on failure
+ */
+static int link_plugin_files(rpl_data_t *rpl, const rpl_entry_t *entries, int num, const char *pdir, size_t name_len) {
+	int i;
+
+	for (i = 0; i < num; i++) {
+		const char *rel = entries[i].path + name_len + 1;
+		char *file, *object;
+		int success;
+
+		if (entries[i].failed) {
+			return 0;
+		}
+		if ((file = local_path(pdir, rel, strlen(rel))) == NULL) {
+			return 0;
+		}
+		if (file_exists(file)) {
+			free(file);
+			continue;
+		}
+		make_parent_dirs(file, strlen(rpl->cache_dir));
+		success = ((object = object_path(rpl, entries[i].digest)) != NULL
+			&& link_object(object, file));
+		free(object);
+		free(file);
+		if (!success) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Releases a set of plug-in directory keys.
+ *
+ * @param keys the keys
+ */
+static void free_keys(hash_t *keys) {
+	hscan_t hscan;
+	hnode_t *hnode;
+
+	hash_scan_begin(&hscan, keys);
+	while ((hnode = hash_scan_next(&hscan)) != NULL) {
+		char *key = (char *) hnode_getkey(hnode);
+
+		hash_scan_delfree(keys, hnode);
+		free(key);
+	}
+	hash_destroy(keys);
+}
+
+/**
+ * Scans the repository for plug-ins.
+ *
+ * @param data the repository plug-in loader data
+ * @param ctx the plug-in context
+ * @param incremental whether to only load the plug-ins changed since the
+ * 		previous scan
+ * @return pointer to a NULL-terminated array of plug-in information pointers, or NULL on failure
+ */
+static cp_plugin_info_t **scan_repository(void *data, cp_context_t *ctx, int incremental) {
+	rpl_data_t *rpl = data;
+	rpl_entry_t *entries = NULL;
+	hash_t *seen = NULL;
+	cp_plugin_info_t **plugins = NULL;
+	const char *dname;
+	int num_entries = 0, num_plugins = 0;
+	int i, n;
+
+	CHECK_NOT_NULL(data);
+	CHECK_NOT_NULL(ctx);
+
+	do {
+
+		// Fetch the index and the changed files
+		if (read_index(ctx, rpl, &entries, &num_entries) != CP_OK
+			|| fetch_objects(ctx, rpl, entries, num_entries) != CP_OK) {
+			break;
+		}
+		if ((plugins = malloc((num_entries + 1) * sizeof(cp_plugin_info_t *))) == NULL
+			|| (seen = hash_create(HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL) {
+			free(plugins);
+			plugins = NULL;
+			break;
+		}
+
+		// Earlier scans of another context do not tell what this one has seen
+		cpi_lock_framework();
+		if (rpl->seen_context != ctx) {
+			incremental = 0;
+		}
+		cpi_unlock_framework();
+
+		// Load the plug-ins in the plug-in directories
+		dname = ctx->env->plugin_descriptor_name;
+		for (i = 0; i < num_entries; i += n) {
+			size_t name_len = strchr(entries[i].path, '/') - entries[i].path;
+			char *key = NULL, *pdir = NULL, *pdirs = NULL;
+			int has_descriptor = 0;
+			int changed = 1;
+
+			// Find the files in the directory
+			for (n = 0; i + n < num_entries
+				&& !strncmp(entries[i + n].path, entries[i].path, name_len + 1); n++) {
+				if (!strcmp(entries[i + n].path + name_len + 1, dname)) {
+					has_descriptor = 1;
+				}
+			}
+			if (!has_descriptor) {
+				continue;
+			}
+
+			// Check if the directory has changed
+			if ((key = dir_key(entries + i, n, name_len)) == NULL) {
+				continue;
+			}
+			cpi_lock_framework();
+			if (incremental && hash_lookup(rpl->seen, key) != NULL) {
+				changed = 0;
+			}
+			cpi_unlock_framework();
+			if (!hash_alloc_insert(seen, key, NULL)) {
+				free(key);
+				continue;
+			}
+
+			// Make the files available and load the descriptor
+			if (changed) {
+				cp_plugin_info_t *plugin;
+				cp_status_t s;
+
+				if ((pdirs = local_path(rpl->cache_dir, "plugins", 7)) == NULL
+					|| (pdir = local_path(pdirs, key, strlen(key))) == NULL) {
+					free(pdirs);
+					continue;
+				}
+				if (!link_plugin_files(rpl, entries + i, n, pdir, name_len)) {
+					cpi_lock_context(ctx);
+					cpi_errorf(ctx, N_("Could not make the files of plug-in repository directory %s available locally."), key);
+					cpi_unlock_context(ctx);
+				} else if ((plugin = cp_load_plugin_descriptor(ctx, pdir, &s)) != NULL) {
+					plugins[num_plugins++] = plugin;
+				}
+				free(pdir);
+				free(pdirs);
+			}
+		}
+		plugins[num_plugins] = NULL;
+
+		// Remember the plug-in directories seen by this scan
+		cpi_lock_framework();
+		{
+			hash_t *old = rpl->seen;
+
+			rpl->seen = seen;
+			rpl->seen_context = ctx;
+			seen = old;
+		}
+		cpi_unlock_framework();
+
+	} while (0);
+
+	// Release resources
+	if (seen != NULL) {
+		free_keys(seen);
+	}
+	free_entries(entries, num_entries);
+
+	return plugins;
+}
+
+static cp_plugin_info_t **rpl_scan_plugins(void *data, cp_context_t *ctx) {
+	return scan_repository(data, ctx, 0);
+}
+
+static cp_plugin_info_t **rpl_scan_changed_plugins(void *data, cp_context_t *ctx) {
+	return scan_repository(data, ctx, 1);
+}
+
+CP_C_API cp_plugin_loader_t *cp_create_repository_ploader(const char *cache_dir, cp_fetch_func_t fetch, void *user_data, cp_status_t *error) {
+	cp_plugin_loader_t *loader = NULL;
+	rpl_data_t *rpl;
+	cp_status_t status = CP_OK;
+
+	CHECK_NOT_NULL(cache_dir);
+	CHECK_NOT_NULL(fetch);
+
+	// Allocate and initialize a new repository plug-in loader
+	do {
+
+		// Allocate memory for the loader
+		if ((loader = malloc(sizeof(cp_plugin_loader_t))) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+
+		// Initialize loader
+		memset(loader, 0, sizeof(cp_plugin_loader_t));
+		loader->scan_plugins = rpl_scan_plugins;
+		loader->resolve_files = NULL;
+		loader->release_plugins = NULL;
+		if ((loader->data = rpl = malloc(sizeof(rpl_data_t))) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		memset(rpl, 0, sizeof(rpl_data_t));
+		rpl->fetch = fetch;
+		rpl->user_data = user_data;
+		if ((rpl->cache_dir = malloc((strlen(cache_dir) + 1) * sizeof(char))) == NULL
+			|| (rpl->seen = hash_create(HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL) {
+			status = CP_ERR_RESOURCE;
+			break;
+		}
+		strcpy(rpl->cache_dir, cache_dir);
+		if ((status = cp_set_ploader_scan_changed(loader, rpl_scan_changed_plugins)) != CP_OK) {
+			break;
+		}
+
+	} while (0);
+
+	// Release resources on failure
+	if (status != CP_OK) {
+		if (loader != NULL) {
+			cp_destroy_repository_ploader(loader);
+		}
+		loader = NULL;
+	}
+
+	// Return the final status
+	if (error != NULL) {
+		*error = status;
+	}
+
+	// Return the loader (or NULL on failure)
+	return loader;
+}
+
+CP_C_API void cp_destroy_repository_ploader(cp_plugin_loader_t *loader) {
+	rpl_data_t *rpl;
+
+	CHECK_NOT_NULL(loader);
+	cp_set_ploader_scan_changed(loader, NULL);
+
+	rpl = loader->data;
+	if (rpl != NULL) {
+		if (rpl->seen != NULL) {
+			free_keys(rpl->seen);
+		}
+		free(rpl->cache_dir);
+		free(rpl);
+		loader->data = NULL;
+	}
+	free(loader);
+}
+
+CP_C_API void cp_rpl_set_fetch_threads(cp_plugin_loader_t *loader, unsigned int num_threads) {
+	CHECK_NOT_NULL(loader);
+	((rpl_data_t *) loader->data)->num_fetch_threads = num_threads;
+}
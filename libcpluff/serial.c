@@ -31,35 +31,311 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <assert.h>
 #include "cpluff.h"
 #include "internal.h"
+#include "trace.h"
+
+#if defined(HAVE_POLL_H) && !defined(_WIN32)
+#define RUN_POLL
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#endif
 
 
 /* ------------------------------------------------------------------------
  * Data types
  * ----------------------------------------------------------------------*/
 
-/// A holder structure for a run function.
+/// A holder structure for a run function or a run task.
 typedef struct run_func_t {
 	
-	/// The run function
+	/// The run function or NULL for a run task
 	cp_run_func_t runfunc;
 	
+	/// The run task or NULL for a run function
+	cp_run_task_func_t taskfunc;
+	
+	/// The function discarding an unfinished run task or NULL
+	cp_discard_task_func_t discardfunc;
+	
+	/// The task data pointer
+	void *task_data;
+	
 	/// The registering plug-in instance
 	cp_plugin_t *plugin;
 	
+	/// The run priority class
+	int priority;
+	
 	/// Whether currently in execution
 	int in_execution;
 	
+	/// Whether parked until resumed, until a deadline or until a file descriptor is readable
+	int suspended;
+	
+	/// Whether the run task was resumed while in execution
+	int resumed;
+	
+	/// Whether waiting for a deadline
+	int timed;
+	
+	/// The deadline in monotonic microseconds, if timed
+	unsigned long long deadline;
+	
+	/// The file descriptor to wait for or -1 if none
+	int fd;
+	
 } run_func_t;
 
-CP_C_API cp_status_t cp_run_function(cp_context_t *ctx, cp_run_func_t runfunc) {
+/// A parallel run of the registered run functions
+typedef struct run_executor_t {
+	
+	/// The plug-in context
+	cp_context_t *context;
+	
+	/// The number of run functions currently executed by this run
+	int num_executing;
+	
+} run_executor_t;
+
+
+/* ------------------------------------------------------------------------
+ * Constants
+ * ----------------------------------------------------------------------*/
+
+/// The weights of the run priority classes
+static const unsigned int run_class_weights[CPI_RUN_PRIO_CLASSES] = { 1, 4, 16 };
+
+/// The virtual time charged per microsecond for a class of weight one
+#define RUN_VTIME_SCALE 16
+
+
+/* ------------------------------------------------------------------------
+ * Function definitions
+ * ----------------------------------------------------------------------*/
+
+/**
+ * Returns whether the specified run function waits for a deadline or for
+ * a file descriptor.
+ * 
+ * @param rf the run function
+ * @return whether the run function is scheduled
+ */
+static int is_scheduled(const run_func_t *rf) {
+	return rf->timed || rf->fd >= 0;
+}
+
+#ifdef RUN_POLL
+/**
+ * Creates a non-blocking pipe which is closed on exec.
+ * 
+ * @param fds the location where the pipe file descriptors are stored
+ * @return whether successful
+ */
+static int open_run_pipe(int fds[2]) {
+	if (pipe(fds)) {
+		fds[0] = fds[1] = -1;
+		return 0;
+	}
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	return 1;
+}
+#endif
+
+/**
+ * Makes the run readiness pipe readable, if it has been requested by the
+ * main program. The context must be locked.
+ * 
+ * @param ctx the plug-in context
+ */
+static void signal_run_ready(cp_context_t *ctx) {
+#ifdef RUN_POLL
+	if (ctx->env->has_run_ready && !ctx->env->run_ready_signaled) {
+		char c = 'r';
+		
+		if (write(ctx->env->run_ready[1], &c, 1) == 1) {
+			ctx->env->run_ready_signaled = 1;
+		}
+	}
+#endif
+}
+
+/**
+ * Drains the run readiness pipe if there are no run functions waiting to
+ * be run anymore. The context must be locked.
+ * 
+ * @param ctx the plug-in context
+ */
+static void clear_run_ready(cp_context_t *ctx) {
+#ifdef RUN_POLL
+	if (ctx->env->run_ready_signaled && ctx->env->run_wait == NULL) {
+		char buffer[16];
+		
+		while (read(ctx->env->run_ready[0], buffer, sizeof(buffer)) > 0);
+		ctx->env->run_ready_signaled = 0;
+	}
+#endif
+}
+
+/**
+ * Wakes up a thread waiting for scheduled run functions so that it
+ * reconsiders the run queue. The context must be locked.
+ * 
+ * @param ctx the plug-in context
+ */
+static void wake_run_poller(cp_context_t *ctx) {
+#ifdef RUN_POLL
+	if (ctx->env->run_polling && ctx->env->has_run_wake) {
+		char c = 'w';
+		
+		// The pipe is non-blocking and a full pipe already wakes the poller
+		if (write(ctx->env->run_wake[1], &c, 1) < 0) {
+			assert(errno == EAGAIN || errno == EINTR);
+		}
+	}
+#endif
+}
+
+/**
+ * Queues a run function node to be run. The context must be locked.
+ * 
+ * @param ctx the plug-in context
+ * @param node the node not currently in the run function list
+ */
+static void queue_run_func(cp_context_t *ctx, lnode_t *node) {
+	list_append(ctx->env->run_funcs, node);
+	if (ctx->env->run_wait == NULL) {
+		ctx->env->run_wait = node;
+		signal_run_ready(ctx);
+	}
+	wake_run_poller(ctx);
+}
+
+/**
+ * Parks a run function node until it is resumed or until its deadline or
+ * file descriptor makes it ready. Parked nodes are kept before the waiting
+ * run functions. The context must be locked.
+ * 
+ * @param ctx the plug-in context
+ * @param node the node not currently in the run function list
+ */
+static void park_run_func(cp_context_t *ctx, lnode_t *node) {
+	run_func_t *rf = lnode_get(node);
+	
+	rf->suspended = 1;
+	if (is_scheduled(rf)) {
+		ctx->env->num_scheduled_runs++;
+		wake_run_poller(ctx);
+	}
+	if (ctx->env->run_wait != NULL) {
+		list_ins_before(ctx->env->run_funcs, node, ctx->env->run_wait);
+	} else {
+		list_append(ctx->env->run_funcs, node);
+	}
+}
+
+/**
+ * Queues a parked run function node to be run. The context must be locked.
+ * 
+ * @param ctx the plug-in context
+ * @param node the parked node
+ */
+static void unpark_run_func(cp_context_t *ctx, lnode_t *node) {
+	run_func_t *rf = lnode_get(node);
+	
+	assert(rf->suspended);
+	if (is_scheduled(rf)) {
+		assert(ctx->env->num_scheduled_runs > 0);
+		ctx->env->num_scheduled_runs--;
+	}
+	rf->suspended = 0;
+	rf->timed = 0;
+	rf->fd = -1;
+	list_delete(ctx->env->run_funcs, node);
+	queue_run_func(ctx, node);
+	cpi_signal_context(ctx);
+}
+
+/**
+ * Queues the parked run functions whose deadline has passed. The context
+ * must be locked.
+ * 
+ * @param ctx the plug-in context
+ */
+static void queue_due_run_funcs(cp_context_t *ctx) {
+	unsigned long long now;
+	lnode_t *node;
+	
+	if (ctx->env->num_scheduled_runs == 0) {
+		return;
+	}
+	now = cpi_monotonic_usecs();
+	node = list_first(ctx->env->run_funcs);
+	while (node != NULL && node != ctx->env->run_wait) {
+		run_func_t *rf = lnode_get(node);
+		lnode_t *next = list_next(ctx->env->run_funcs, node);
+		
+		if (rf->suspended && rf->timed && rf->deadline <= now) {
+			unpark_run_func(ctx, node);
+		}
+		node = next;
+	}
+}
+
+/**
+ * Locates a registered run function or run task.
+ * 
+ * @param ctx the plug-in context
+ * @param runfunc the run function or NULL for a run task
+ * @param taskfunc the run task or NULL for a run function
+ * @param task_data the task data pointer for a run task
+ * @return the node of the registration or NULL if not registered
+ */
+static lnode_t *find_run_func(cp_context_t *ctx, cp_run_func_t runfunc, cp_run_task_func_t taskfunc, void *task_data) {
+	lnode_t *node;
+	
+	node = list_first(ctx->env->run_funcs);
+	while (node != NULL) {
+		run_func_t *rf = lnode_get(node);
+		
+		if (runfunc != NULL
+			? (rf->runfunc == runfunc && rf->plugin == ctx->plugin)
+			: (rf->taskfunc == taskfunc && rf->task_data == task_data)) {
+			return node;
+		}
+		node = list_next(ctx->env->run_funcs, node);
+	}
+	return NULL;
+}
+
+/**
+ * Registers a new run function or run task. Run functions are registered
+ * only once per plug-in instance while run tasks may be registered several
+ * times.
+ * 
+ * @param ctx the plug-in context of the registering plug-in
+ * @param runfunc the run function or NULL for a run task
+ * @param taskfunc the run task or NULL for a run function
+ * @param discardfunc the function discarding an unfinished task or NULL
+ * @param task_data the task data pointer
+ * @param priority the run priority class or -1 to keep the class of an existing registration
+ * @param func the name of the API function
+ * @return CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t register_run_func(cp_context_t *ctx, cp_run_func_t runfunc, cp_run_task_func_t taskfunc, cp_discard_task_func_t discardfunc, void *task_data, int priority, const char *func) {
 	lnode_t *node = NULL;
 	run_func_t *rf = NULL;
 	cp_status_t status = CP_OK;
 	
-	CHECK_NOT_NULL(ctx);
-	CHECK_NOT_NULL(runfunc);
+	if (priority < -1 || priority >= CPI_RUN_PRIO_CLASSES) {
+		cpi_fatalf(_("Unknown run priority class %d."), priority);
+	}
 	if (ctx->plugin == NULL) {
 		cpi_fatalf(_("Only plug-ins can register run functions."));
 	}
@@ -69,21 +345,15 @@ CP_C_API cp_status_t cp_run_function(cp_context_t *ctx, cp_run_func_t runfunc) {
 	}
 	
 	cpi_lock_context(ctx);
-	cpi_check_invocation(ctx, CPI_CF_STOP | CPI_CF_LOGGER, __func__);
+	cpi_check_invocation(ctx, CPI_CF_STOP | CPI_CF_LOGGER, func);
 	do {
-		int found = 0;
-		lnode_t *n;
 	
 		// Check if already registered
-		n = list_first(ctx->env->run_funcs);
-		while (n != NULL && !found) {
-			run_func_t *r = lnode_get(n);
-			if (runfunc == r->runfunc && ctx->plugin == r->plugin) {
-				found = 1;
+		if (runfunc != NULL && (node = find_run_func(ctx, runfunc, NULL, NULL)) != NULL) {
+			if (priority >= 0) {
+				((run_func_t *) lnode_get(node))->priority = priority;
 			}
-			n = list_next(ctx->env->run_funcs, n);
-		}
-		if (found) {
+			node = NULL;
 			break;
 		}
 
@@ -92,7 +362,7 @@ CP_C_API cp_status_t cp_run_function(cp_context_t *ctx, cp_run_func_t runfunc) {
 			status = CP_ERR_RESOURCE;
 			break;
 		}
-		if ((node = lnode_create(rf)) == NULL) {
+		if ((node = cpi_create_lnode(ctx->env->nodes, rf)) == NULL) {
 			status = CP_ERR_RESOURCE;
 			break;
 		}
@@ -100,13 +370,16 @@ CP_C_API cp_status_t cp_run_function(cp_context_t *ctx, cp_run_func_t runfunc) {
 		// Initialize run function entry
 		memset(rf, 0, sizeof(run_func_t));
 		rf->runfunc = runfunc;
+		rf->taskfunc = taskfunc;
+		rf->discardfunc = discardfunc;
+		rf->task_data = task_data;
 		rf->plugin = ctx->plugin;
+		rf->priority = (priority >= 0 ? priority : CP_RUN_PRIO_NORMAL);
+		rf->fd = -1;
 		
 		// Append the run function to queue
-		list_append(ctx->env->run_funcs, node);
-		if (ctx->env->run_wait == NULL) {
-			ctx->env->run_wait = node;
-		}
+		queue_run_func(ctx, node);
+		cpi_signal_context(ctx);
 
 	} while (0);
 
@@ -114,23 +387,461 @@ CP_C_API cp_status_t cp_run_function(cp_context_t *ctx, cp_run_func_t runfunc) {
 	if (status == CP_ERR_RESOURCE) {
 		cpi_error(ctx, N_("Could not register a run function due to insufficient memory."));
 	}	
-	cpi_unlock_context(ctx);
 	
 	// Free resources on error
 	if (status != CP_OK) {
 		if (node != NULL) {
-			lnode_destroy(node);
+			cpi_destroy_lnode(ctx->env->nodes, node);
 		}
 		if (rf != NULL) {
 			free(rf);
 		}
 	}
+	cpi_unlock_context(ctx);
 	
 	return status;
 }
 
+/**
+ * Schedules a registered run function or run task to be run after a
+ * deadline or when a file descriptor becomes readable. A run function or
+ * task in execution is scheduled when it returns, unless it has finished.
+ * 
+ * @param ctx the plug-in context
+ * @param runfunc the run function or NULL for a run task
+ * @param taskfunc the run task or NULL for a run function
+ * @param task_data the task data pointer for a run task
+ * @param delay_ms the delay in milliseconds, if @a fd is negative
+ * @param fd the file descriptor to wait for or -1 to wait for the delay
+ * @param func the name of the API function
+ * @return CP_OK (zero) on success or an error code on failure
+ */
+static cp_status_t schedule_run_func(cp_context_t *ctx, cp_run_func_t runfunc, cp_run_task_func_t taskfunc, void *task_data, unsigned long delay_ms, int fd, const char *func) {
+	cp_status_t status = CP_OK;
+	lnode_t *node;
+	
+#ifndef RUN_POLL
+	if (fd >= 0) {
+		cpi_error(ctx, N_("Run functions can not wait for file descriptors on this platform."));
+		return CP_ERR_RESOURCE;
+	}
+#endif
+	cpi_lock_context(ctx);
+	cpi_check_invocation(ctx, CPI_CF_LOGGER, func);
+	do {
+		run_func_t *rf;
+		
+		// Register a new run function, if necessary
+		if ((node = find_run_func(ctx, runfunc, taskfunc, task_data)) == NULL) {
+			if (runfunc == NULL
+				|| (status = register_run_func(ctx, runfunc, NULL, NULL, NULL, -1, func)) != CP_OK) {
+				break;
+			}
+			node = find_run_func(ctx, runfunc, NULL, NULL);
+			assert(node != NULL);
+		}
+		rf = lnode_get(node);
+		
+		// Detach the run function from its current position
+		if (rf->suspended) {
+			if (is_scheduled(rf)) {
+				ctx->env->num_scheduled_runs--;
+			}
+			list_delete(ctx->env->run_funcs, node);
+		} else if (!rf->in_execution) {
+			if (ctx->env->run_wait == node) {
+				ctx->env->run_wait = list_next(ctx->env->run_funcs, node);
+			}
+			list_delete(ctx->env->run_funcs, node);
+		}
+		
+		// Set the schedule
+		if (fd >= 0) {
+			rf->timed = 0;
+			rf->fd = fd;
+		} else {
+			rf->timed = 1;
+			rf->deadline = cpi_monotonic_usecs() + (unsigned long long) delay_ms * 1000ULL;
+			rf->fd = -1;
+		}
+		rf->resumed = 0;
+		
+		// Park the run function unless it is in execution
+		if (!rf->in_execution) {
+			park_run_func(ctx, node);
+		}
+		
+	} while (0);
+	cpi_unlock_context(ctx);
+	return status;
+}
+
+CP_C_API cp_status_t cp_run_function(cp_context_t *ctx, cp_run_func_t runfunc) {
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(runfunc);
+	return register_run_func(ctx, runfunc, NULL, NULL, NULL, -1, __func__);
+}
+
+CP_C_API cp_status_t cp_run_function_prio(cp_context_t *ctx, cp_run_func_t runfunc, int priority) {
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(runfunc);
+	return register_run_func(ctx, runfunc, NULL, NULL, NULL, priority, __func__);
+}
+
+CP_C_API cp_status_t cp_run_function_at(cp_context_t *ctx, cp_run_func_t runfunc, unsigned long delay_ms) {
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(runfunc);
+	return schedule_run_func(ctx, runfunc, NULL, NULL, delay_ms, -1, __func__);
+}
+
+CP_C_API cp_status_t cp_run_function_on_fd(cp_context_t *ctx, cp_run_func_t runfunc, int fd) {
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(runfunc);
+	assert(fd >= 0);
+	return schedule_run_func(ctx, runfunc, NULL, NULL, 0, fd, __func__);
+}
+
+CP_C_API cp_status_t cp_run_task(cp_context_t *ctx, cp_run_task_func_t taskfunc, cp_discard_task_func_t discardfunc, void *task_data) {
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(taskfunc);
+	return register_run_func(ctx, NULL, taskfunc, discardfunc, task_data, -1, __func__);
+}
+
+CP_C_API cp_status_t cp_run_task_prio(cp_context_t *ctx, cp_run_task_func_t taskfunc, cp_discard_task_func_t discardfunc, void *task_data, int priority) {
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(taskfunc);
+	return register_run_func(ctx, NULL, taskfunc, discardfunc, task_data, priority, __func__);
+}
+
+CP_C_API void cp_resume_task(cp_context_t *ctx, cp_run_task_func_t taskfunc, void *task_data) {
+	lnode_t *node;
+	
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(taskfunc);
+	cpi_lock_context(ctx);
+	cpi_check_invocation(ctx, CPI_CF_LOGGER, __func__);
+	if ((node = find_run_func(ctx, NULL, taskfunc, task_data)) != NULL) {
+		run_func_t *rf = lnode_get(node);
+		
+		if (rf->in_execution) {
+			rf->resumed = 1;
+		} else if (rf->suspended) {
+			unpark_run_func(ctx, node);
+		}
+	}
+	cpi_unlock_context(ctx);
+}
+
+CP_C_API cp_status_t cp_resume_task_at(cp_context_t *ctx, cp_run_task_func_t taskfunc, void *task_data, unsigned long delay_ms) {
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(taskfunc);
+	return schedule_run_func(ctx, NULL, taskfunc, task_data, delay_ms, -1, __func__);
+}
+
+CP_C_API cp_status_t cp_resume_task_on_fd(cp_context_t *ctx, cp_run_task_func_t taskfunc, void *task_data, int fd) {
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(taskfunc);
+	assert(fd >= 0);
+	return schedule_run_func(ctx, NULL, taskfunc, task_data, 0, fd, __func__);
+}
+
+/**
+ * Moves the waiting run function to be executed next to the head of the
+ * waiting run functions. The priority class with the smallest virtual
+ * finish time is selected and its oldest waiting run function is chosen.
+ * A class that has been idle is first brought up to the current virtual
+ * time so that it can not claim the run time it did not use. The context
+ * must be locked and there must be a waiting run function.
+ * 
+ * @param ctx the plug-in context
+ */
+static void select_next(cp_context_t *ctx) {
+	cp_plugin_env_t *env = ctx->env;
+	lnode_t *best = NULL;
+	unsigned long long best_vtime = 0;
+	int seen = 0;
+	int num_seen = 0;
+	lnode_t *node;
+	
+	for (node = env->run_wait;
+		node != NULL && num_seen < CPI_RUN_PRIO_CLASSES;
+		node = list_next(env->run_funcs, node)) {
+		run_func_t *rf = lnode_get(node);
+		unsigned long long vtime;
+		
+		// Only the oldest run function of each class is a candidate
+		if (seen & (1 << rf->priority)) {
+			continue;
+		}
+		seen |= 1 << rf->priority;
+		num_seen++;
+		vtime = env->run_class_vtime[rf->priority];
+		if (vtime < env->run_vtime) {
+			vtime = env->run_vtime;
+		}
+		if (best == NULL || vtime < best_vtime) {
+			best = node;
+			best_vtime = vtime;
+		}
+	}
+	assert(best != NULL);
+	env->run_vtime = best_vtime;
+	env->run_class_vtime[((run_func_t *) lnode_get(best))->priority] = best_vtime;
+	if (best != env->run_wait) {
+		list_delete(env->run_funcs, best);
+		list_ins_before(env->run_funcs, best, env->run_wait);
+		env->run_wait = best;
+	}
+}
+
+/**
+ * Records the completion of a run function of the specified plug-in and
+ * wakes up the threads stopping the plug-in if it was the last one in
+ * execution. The context must be locked.
+ * 
+ * @param plugin the plug-in
+ */
+static void finish_plugin_run(cp_plugin_t *plugin) {
+	assert(plugin->num_running_funcs > 0);
+	if (--plugin->num_running_funcs == 0) {
+		cpi_signal_plugin_idle(plugin);
+	}
+}
+
+CP_HIDDEN void cpi_wait_plugin_idle(cp_plugin_t *plugin, const int *counter) {
+	cp_context_t *ctx = plugin->context;
+	
+	assert(cpi_is_context_locked(ctx));
+#ifdef CP_THREADS
+	
+	// Fall back to waiting for any context signal if out of resources
+	if (plugin->idle_cond == NULL) {
+		plugin->idle_cond = cpi_create_cond();
+	}
+	plugin->num_idle_waiters++;
+	while (*counter > 0) {
+		if (plugin->idle_cond != NULL) {
+			cpi_wait_cond(plugin->idle_cond, ctx->env->mutex);
+		} else {
+			cpi_wait_context(ctx);
+		}
+	}
+	plugin->num_idle_waiters--;
+#else
+	while (*counter > 0) {
+		cpi_wait_context(ctx);
+	}
+#endif
+}
+
+CP_HIDDEN void cpi_signal_plugin_idle(cp_plugin_t *plugin) {
+#ifdef CP_THREADS
+	if (plugin->num_idle_waiters > 0) {
+		if (plugin->idle_cond != NULL) {
+			cpi_signal_cond(plugin->idle_cond);
+		} else {
+			cpi_signal_context(plugin->context);
+		}
+	}
+#endif
+}
+
+/**
+ * Executes the next waiting run function. The run function is executed
+ * without holding the context lock. The time spent is charged to the
+ * priority class of the run function and to the registering plug-in. The
+ * context must be locked and there must be a waiting run function.
+ * 
+ * @param ctx the plug-in context
+ */
+static void run_next(cp_context_t *ctx) {
+	lnode_t *node;
+	run_func_t *rf;
+	unsigned long long started, elapsed;
+	int rerun;
+	
+	assert(cpi_is_context_locked(ctx));
+	assert(ctx->env->run_wait != NULL);
+	select_next(ctx);
+	node = ctx->env->run_wait;
+	rf = lnode_get(node);
+	ctx->env->run_wait = list_next(ctx->env->run_funcs, node);
+	rf->in_execution = 1;
+	rf->resumed = 0;
+	rf->plugin->num_running_funcs++;
+	cpi_unlock_context(ctx);
+	started = cpi_monotonic_usecs();
+	if (rf->taskfunc != NULL) {
+		CPI_TRACE2(run__begin, rf->plugin->plugin->identifier, (unsigned long) rf->taskfunc);
+		rerun = rf->taskfunc(rf->plugin->plugin_data, rf->task_data);
+		CPI_TRACE3(run__end, rf->plugin->plugin->identifier, (unsigned long) rf->taskfunc, rerun);
+	} else {
+		CPI_TRACE2(run__begin, rf->plugin->plugin->identifier, (unsigned long) rf->runfunc);
+		rerun = (rf->runfunc(rf->plugin->plugin_data) ? CP_RUN_AGAIN : CP_RUN_DONE);
+		CPI_TRACE3(run__end, rf->plugin->plugin->identifier, (unsigned long) rf->runfunc, rerun);
+	}
+	elapsed = cpi_monotonic_usecs() - started;
+	cpi_lock_context(ctx);
+	ctx->env->run_class_vtime[rf->priority] +=
+		(elapsed + 1) * RUN_VTIME_SCALE / run_class_weights[rf->priority];
+	rf->plugin->stats.run_usecs += elapsed;
+	rf->plugin->stats.run_calls++;
+	rf->in_execution = 0;
+	finish_plugin_run(rf->plugin);
+	list_delete(ctx->env->run_funcs, node);
+	if (rerun == CP_RUN_DONE) {
+		cpi_destroy_lnode(ctx->env->nodes, node);
+		free(rf);
+	} else if (rf->resumed) {
+		rf->timed = 0;
+		rf->fd = -1;
+		queue_run_func(ctx, node);
+	} else if (rerun == CP_RUN_SUSPEND || is_scheduled(rf)) {
+		park_run_func(ctx, node);
+	} else {
+		queue_run_func(ctx, node);
+	}
+	clear_run_ready(ctx);
+	cpi_signal_context(ctx);
+}
+
+/**
+ * Waits until a scheduled run function may have become ready. Only one
+ * thread at a time waits for the deadlines and file descriptors while
+ * other threads wait for the context to be signaled. The context must be
+ * locked and there must be no waiting run functions.
+ * 
+ * @param ctx the plug-in context
+ */
+static void wait_run_funcs(cp_context_t *ctx) {
+#ifdef RUN_POLL
+	cp_plugin_env_t *env = ctx->env;
+	struct pollfd *fds = NULL;
+	unsigned long long deadline = 0;
+	int timeout = -1;
+	unsigned int nfds = 1;
+	int has_deadline = 0;
+	lnode_t *node;
+	
+	assert(env->run_wait == NULL);
+	if (env->run_polling || env->num_scheduled_runs == 0) {
+		cpi_wait_context(ctx);
+		return;
+	}
+	
+	// Create the wake-up pipe on first use
+	if (!env->has_run_wake) {
+		env->has_run_wake = open_run_pipe(env->run_wake);
+	}
+	
+	// Collect the file descriptors and the earliest deadline
+	for (node = list_first(env->run_funcs); node != NULL; node = list_next(env->run_funcs, node)) {
+		run_func_t *rf = lnode_get(node);
+		
+		if (rf->suspended && rf->fd >= 0) {
+			nfds++;
+		} else if (rf->suspended && rf->timed && (!has_deadline || rf->deadline < deadline)) {
+			deadline = rf->deadline;
+			has_deadline = 1;
+		}
+	}
+	if ((fds = malloc(nfds * sizeof(struct pollfd))) == NULL) {
+		nfds = 1;
+	}
+	nfds = 1;
+	if (fds != NULL) {
+		fds[0].fd = env->run_wake[0];
+		fds[0].events = POLLIN;
+		for (node = list_first(env->run_funcs); node != NULL; node = list_next(env->run_funcs, node)) {
+			run_func_t *rf = lnode_get(node);
+			
+			if (rf->suspended && rf->fd >= 0) {
+				fds[nfds].fd = rf->fd;
+				fds[nfds].events = POLLIN;
+				fds[nfds].revents = 0;
+				nfds++;
+			}
+		}
+	}
+	if (has_deadline) {
+		unsigned long long now = cpi_monotonic_usecs();
+		
+		timeout = (deadline > now ? (int) ((deadline - now + 999) / 1000) : 0);
+	}
+	
+	// Without a wake-up pipe or memory, poll again after a while
+	if (fds == NULL || !env->has_run_wake) {
+		if (timeout < 0 || timeout > 10) {
+			timeout = 10;
+		}
+	}
+	
+	// Wait without holding the lock
+	env->run_polling = 1;
+	cpi_unlock_context(ctx);
+	if (fds != NULL) {
+		if (poll(env->has_run_wake ? fds : fds + 1, env->has_run_wake ? nfds : nfds - 1, timeout) < 0) {
+			assert(errno == EINTR);
+		}
+	} else {
+		poll(NULL, 0, timeout);
+	}
+	cpi_lock_context(ctx);
+	env->run_polling = 0;
+	
+	// Consume wake-ups and queue the run functions that became ready
+	if (env->has_run_wake) {
+		char buffer[64];
+		
+		while (read(env->run_wake[0], buffer, sizeof(buffer)) > 0);
+	}
+	if (fds != NULL) {
+		unsigned int i;
+		
+		for (i = 1; i < nfds; i++) {
+			if (fds[i].revents) {
+				node = list_first(env->run_funcs);
+				while (node != NULL && node != env->run_wait) {
+					run_func_t *rf = lnode_get(node);
+					lnode_t *next = list_next(env->run_funcs, node);
+					
+					if (rf->suspended && rf->fd == fds[i].fd) {
+						unpark_run_func(ctx, node);
+					}
+					node = next;
+				}
+			}
+		}
+		free(fds);
+	}
+	queue_due_run_funcs(ctx);
+	cpi_signal_context(ctx);
+#else
+	
+	// Without poll the deadlines are checked again after giving up the lock
+	assert(ctx->env->run_wait == NULL);
+	if (ctx->env->num_scheduled_runs == 0) {
+		cpi_wait_context(ctx);
+		return;
+	}
+	cpi_unlock_context(ctx);
+	cpi_lock_context(ctx);
+	queue_due_run_funcs(ctx);
+#endif
+}
+
 CP_C_API void cp_run_plugins(cp_context_t *ctx) {
-	while (cp_run_plugins_step(ctx));
+	CHECK_NOT_NULL(ctx);
+	cpi_lock_context(ctx);
+	while (ctx->env->run_wait != NULL || ctx->env->num_scheduled_runs > 0) {
+		queue_due_run_funcs(ctx);
+		if (ctx->env->run_wait != NULL) {
+			run_next(ctx);
+		} else {
+			wait_run_funcs(ctx);
+		}
+	}
+	cpi_unlock_context(ctx);
 }
 
 CP_C_API int cp_run_plugins_step(cp_context_t *ctx) {
@@ -138,32 +849,121 @@ CP_C_API int cp_run_plugins_step(cp_context_t *ctx) {
 	
 	CHECK_NOT_NULL(ctx);
 	cpi_lock_context(ctx);
+	queue_due_run_funcs(ctx);
 	if (ctx->env->run_wait != NULL) {
-		lnode_t *node = ctx->env->run_wait;
-		run_func_t *rf = lnode_get(node);
-		int rerun;
-		
-		ctx->env->run_wait = list_next(ctx->env->run_funcs, node);
-		rf->in_execution = 1;
-		cpi_unlock_context(ctx);
-		rerun = rf->runfunc(rf->plugin->plugin_data);
-		cpi_lock_context(ctx);
-		rf->in_execution = 0;
-		list_delete(ctx->env->run_funcs, node);
-		if (rerun) {
-			list_append(ctx->env->run_funcs, node);
-			if (ctx->env->run_wait == NULL) {
-				ctx->env->run_wait = node;
-			}
+		run_next(ctx);
+	}
+	runnables = (ctx->env->run_wait != NULL || ctx->env->num_scheduled_runs > 0);
+	cpi_unlock_context(ctx);
+	return runnables;
+}
+
+CP_C_API int cp_run_plugins_for(cp_context_t *ctx, unsigned long budget_us) {
+	unsigned long long started;
+	int waiting;
+	
+	CHECK_NOT_NULL(ctx);
+	cpi_lock_context(ctx);
+	started = cpi_monotonic_usecs();
+	do {
+		queue_due_run_funcs(ctx);
+		if (ctx->env->run_wait == NULL) {
+			break;
+		}
+		run_next(ctx);
+	} while (cpi_monotonic_usecs() - started < budget_us);
+	clear_run_ready(ctx);
+	waiting = (ctx->env->run_wait != NULL);
+	cpi_unlock_context(ctx);
+	return waiting;
+}
+
+CP_C_API int cp_get_run_fd(cp_context_t *ctx) {
+	int fd = -1;
+	
+	CHECK_NOT_NULL(ctx);
+#ifdef RUN_POLL
+	cpi_lock_context(ctx);
+	cpi_check_invocation(ctx, CPI_CF_LOGGER, __func__);
+	if (!ctx->env->has_run_ready) {
+		ctx->env->has_run_ready = open_run_pipe(ctx->env->run_ready);
+		if (!ctx->env->has_run_ready) {
+			cpi_error(ctx, N_("Could not create a run readiness file descriptor."));
+		} else if (ctx->env->run_wait != NULL) {
+			signal_run_ready(ctx);
+		}
+	}
+	if (ctx->env->has_run_ready) {
+		fd = ctx->env->run_ready[0];
+	}
+	cpi_unlock_context(ctx);
+#else
+	cpi_error(ctx, N_("Run readiness file descriptors are not supported on this platform."));
+#endif
+	return fd;
+}
+
+/**
+ * Executes waiting run functions until there are no waiting or scheduled
+ * run functions and none of the run functions executed by the parallel run
+ * is in execution anymore.
+ * 
+ * @param arg the parallel run
+ */
+static void run_worker(void *arg) {
+	run_executor_t *ex = arg;
+	cp_context_t *ctx = ex->context;
+	
+	cpi_lock_context(ctx);
+	while (ctx->env->run_wait != NULL || ex->num_executing > 0
+		|| ctx->env->num_scheduled_runs > 0) {
+		queue_due_run_funcs(ctx);
+		if (ctx->env->run_wait != NULL) {
+			ex->num_executing++;
+			run_next(ctx);
+			ex->num_executing--;
 		} else {
-			lnode_destroy(node);
-			free(rf);
+			
+			// Wait for run functions to be rescheduled, to become ready or to finish
+			wait_run_funcs(ctx);
 		}
-		cpi_signal_context(ctx);
 	}
-	runnables = (ctx->env->run_wait != NULL);
+	cpi_signal_context(ctx);
 	cpi_unlock_context(ctx);
-	return runnables;
+}
+CP_C_API void cp_run_plugins_parallel(cp_context_t *ctx, unsigned int num_threads) {
+#ifdef CP_THREADS
+	run_executor_t ex;
+	cp_task_t **threads = NULL;
+	unsigned int num_started = 0;
+	
+	CHECK_NOT_NULL(ctx);
+	
+	// Fall back to serial execution if there are no additional threads
+	if (num_threads <= 1
+		|| (threads = malloc((num_threads - 1) * sizeof(cp_task_t *))) == NULL) {
+		cp_run_plugins(ctx);
+		return;
+	}
+	
+	// Start the additional worker threads
+	memset(&ex, 0, sizeof(ex));
+	ex.context = ctx;
+	while (num_started < num_threads - 1
+		&& (threads[num_started] = cpi_spawn_task(run_worker, &ex)) != NULL) {
+		num_started++;
+	}
+	
+	// Participate in execution and wait for the worker threads
+	run_worker(&ex);
+	while (num_started > 0) {
+		cpi_join_task(threads[--num_started]);
+	}
+	free(threads);
+#else
+	CHECK_NOT_NULL(ctx);
+	cp_run_plugins(ctx);
+#endif
 }
 
 CP_HIDDEN void cpi_stop_plugin_run(cp_plugin_t *plugin) {
@@ -189,8 +989,15 @@ CP_HIDDEN void cpi_stop_plugin_run(cp_plugin_t *plugin) {
 					if (ctx->env->run_wait == node) {
 						ctx->env->run_wait = list_next(ctx->env->run_funcs, node);
 					}
+					if (rf->suspended && is_scheduled(rf)) {
+						ctx->env->num_scheduled_runs--;
+						wake_run_poller(ctx);
+					}
 					list_delete(ctx->env->run_funcs, node);
-					lnode_destroy(node);
+					cpi_destroy_lnode(ctx->env->nodes, node);
+					if (rf->discardfunc != NULL) {
+						rf->discardfunc(rf->task_data);
+					}
 					free(rf);
 				}
 			}
@@ -199,7 +1006,45 @@ CP_HIDDEN void cpi_stop_plugin_run(cp_plugin_t *plugin) {
 		
 		// If some run functions were in execution, wait for them to finish
 		if (!stopped) {
-			cpi_wait_context(ctx);
+			cpi_wait_plugin_idle(plugin, &(plugin->num_running_funcs));
+		}
+	}
+}
+
+CP_C_API cp_status_t cp_get_plugin_run_time(cp_context_t *ctx, const char *id, unsigned long long *usecs, unsigned long *calls) {
+	cp_status_t status = CP_ERR_UNKNOWN;
+	hnode_t *hnode;
+	
+	CHECK_NOT_NULL(ctx);
+	CHECK_NOT_NULL(id);
+	cpi_lock_context(ctx);
+	cpi_check_invocation(ctx, CPI_CF_LOGGER, __func__);
+	if ((hnode = hash_lookup(ctx->env->plugins, id)) != NULL) {
+		cp_plugin_t *rp = hnode_get(hnode);
+		
+		if (usecs != NULL) {
+			*usecs = rp->stats.run_usecs;
+		}
+		if (calls != NULL) {
+			*calls = rp->stats.run_calls;
 		}
+		status = CP_OK;
+	}
+	cpi_unlock_context(ctx);
+	return status;
+}
+
+CP_HIDDEN void cpi_release_run_wake(cp_plugin_env_t *env) {
+#ifdef RUN_POLL
+	if (env->has_run_wake) {
+		close(env->run_wake[0]);
+		close(env->run_wake[1]);
+		env->has_run_wake = 0;
 	}
+	if (env->has_run_ready) {
+		close(env->run_ready[0]);
+		close(env->run_ready[1]);
+		env->has_run_ready = 0;
+	}
+#endif
 }
@@ -30,6 +30,7 @@
 #ifdef CP_THREADS
 
 #include "defines.h"
+#include "cpluff.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -43,6 +44,43 @@ extern "C" {
 // A generic mutex implementation 
 typedef struct cpi_mutex_t cpi_mutex_t;
 
+// A generic condition variable implementation
+typedef struct cpi_cond_t cpi_cond_t;
+
+// A generic thread implementation
+typedef struct cpi_thread_t cpi_thread_t;
+
+// Collected lock statistics of a mutex
+typedef struct cpi_lock_profile_t cpi_lock_profile_t;
+
+// The timing of the current exclusive acquisition of a profiled mutex
+typedef struct cpi_lock_timing_t cpi_lock_timing_t;
+
+struct cpi_lock_timing_t {
+	
+	/// The collected statistics, or NULL if the mutex is not profiled
+	cpi_lock_profile_t *profile;
+	
+	/// Whether the current acquisition is being timed
+	int tracked;
+	
+	/// The API function which acquired the mutex, or NULL if unknown
+	const char *func;
+	
+	/// The time the mutex was acquired or last reacquired after waiting
+	unsigned long long acquired;
+	
+	/// The time the mutex was held before it was last reacquired
+	unsigned long long held;
+	
+	/// The time waited for the mutex
+	unsigned long long waited;
+	
+	/// Whether the acquisition had to wait for another thread
+	int contended;
+	
+};
+
 
 /* ------------------------------------------------------------------------
  * Function declarations
@@ -83,6 +121,41 @@ CP_HIDDEN void cpi_lock_mutex(cpi_mutex_t *mutex);
  */
 CP_HIDDEN void cpi_unlock_mutex(cpi_mutex_t *mutex);
 
+/**
+ * Waits for the specified mutex to become available for shared access
+ * and locks it in shared mode. Any number of threads may hold a shared
+ * lock at the same time but not while some thread holds an exclusive
+ * lock. Threads waiting for an exclusive lock are given preference over
+ * threads not yet holding the mutex. If the calling thread already holds
+ * an exclusive lock then this is equivalent to cpi_lock_mutex. A thread
+ * already holding a shared lock gets another one without waiting for
+ * writers. If a thread holding only shared locks calls cpi_lock_mutex, its
+ * shared locks are released while it waits for exclusive access and they
+ * are then held as exclusive locks until released.
+ * 
+ * @param mutex the mutex
+ */
+CP_HIDDEN void cpi_lock_mutex_shared(cpi_mutex_t *mutex);
+
+/**
+ * Converts a shared lock into an exclusive lock if it is the only lock
+ * the calling thread holds. The mutex is released while waiting for
+ * exclusive access. Does nothing if the calling thread holds the mutex
+ * exclusively or holds several shared locks, so that outer shared holders
+ * keep a consistent view. The lock is released using
+ * cpi_unlock_mutex_shared.
+ * 
+ * @param mutex the mutex
+ */
+CP_HIDDEN void cpi_upgrade_mutex(cpi_mutex_t *mutex);
+
+/**
+ * Releases a lock obtained using cpi_lock_mutex_shared.
+ * 
+ * @param mutex the mutex
+ */
+CP_HIDDEN void cpi_unlock_mutex_shared(cpi_mutex_t *mutex);
+
 /**
  * Waits on the specified mutex until it is signaled. The calling thread
  * must hold the mutex. The mutex is released on call to this function and
@@ -101,6 +174,41 @@ CP_HIDDEN void cpi_wait_mutex(cpi_mutex_t *mutex);
  */
 CP_HIDDEN void cpi_signal_mutex(cpi_mutex_t *mutex);
 
+/**
+ * Creates a condition variable used for waiting on a mutex without
+ * being woken by signals to the mutex itself.
+ * 
+ * @return the created condition variable or NULL if no resources available
+ */
+CP_HIDDEN cpi_cond_t * cpi_create_cond(void);
+
+/**
+ * Destroys the specified condition variable. There must be no waiting
+ * threads.
+ * 
+ * @param cond the condition variable
+ */
+CP_HIDDEN void cpi_destroy_cond(cpi_cond_t *cond);
+
+/**
+ * Waits on the specified condition variable until it is signaled. The
+ * calling thread must hold the mutex which is released like for
+ * ::cpi_wait_mutex and reacquired before the function returns.
+ * 
+ * @param cond the condition variable to wait on
+ * @param mutex the mutex held by the calling thread
+ */
+CP_HIDDEN void cpi_wait_cond(cpi_cond_t *cond, cpi_mutex_t *mutex);
+
+/**
+ * Signals the specified condition variable waking all the threads
+ * currently waiting on it. The calling thread must hold the mutex the
+ * waiters are waiting on.
+ * 
+ * @param cond the condition variable to be signaled
+ */
+CP_HIDDEN void cpi_signal_cond(cpi_cond_t *cond);
+
 #if !defined(NDEBUG)
 
 /**
@@ -112,6 +220,152 @@ CP_HIDDEN int cpi_is_mutex_locked(cpi_mutex_t *mutex);
 
 #endif
 
+/**
+ * Enables or disables profiling of the specified mutex. The calling
+ * thread must hold the mutex exclusively. Enabling profiling resets the
+ * statistics.
+ * 
+ * @param mutex the mutex
+ * @param enabled whether to profile the mutex
+ * @return whether successful
+ */
+CP_HIDDEN int cpi_set_mutex_profiling(cpi_mutex_t *mutex, int enabled);
+
+/**
+ * Attributes the current exclusive acquisition of the specified mutex to
+ * the specified API function, unless already attributed. Does nothing if
+ * the mutex is not profiled or if the calling thread holds it shared.
+ * 
+ * @param mutex the mutex held by the calling thread
+ * @param func the name of the API function
+ */
+CP_HIDDEN void cpi_set_mutex_function(cpi_mutex_t *mutex, const char *func);
+
+/**
+ * Returns a copy of the statistics of the specified mutex. The calling
+ * thread must hold the mutex exclusively.
+ * 
+ * @param mutex the mutex
+ * @param num filled with the number of entries
+ * @param error filled with CP_OK, or CP_ERR_UNKNOWN if the mutex is not profiled or CP_ERR_RESOURCE if out of memory
+ * @return the statistics allocated using ::cpi_alloc_info, or NULL on failure
+ */
+CP_HIDDEN cp_lock_stats_t *cpi_copy_mutex_profile(cpi_mutex_t *mutex, int *num, cp_status_t *error);
+
+// Lock profiling helpers for the mutex implementations
+
+/**
+ * Creates empty lock statistics.
+ * 
+ * @return the statistics or NULL if insufficient memory
+ */
+CP_HIDDEN cpi_lock_profile_t *cpi_create_lock_profile(void);
+
+/**
+ * Destroys lock statistics.
+ * 
+ * @param profile the statistics
+ */
+CP_HIDDEN void cpi_destroy_lock_profile(cpi_lock_profile_t *profile);
+
+/**
+ * Records an acquisition of a profiled mutex.
+ * 
+ * @param profile the statistics
+ * @param func the acquiring API function, or NULL if unknown
+ * @param waited the time waited in microseconds
+ * @param contended whether the acquisition had to wait for another thread
+ * @param exclusive whether the lock was held exclusively
+ * @param held the time the lock was held in microseconds, if exclusive
+ */
+CP_HIDDEN void cpi_record_lock(cpi_lock_profile_t *profile, const char *func, unsigned long long waited, int contended, int exclusive, unsigned long long held);
+
+/**
+ * Records the end of the timed exclusive acquisition, if any, and stops
+ * timing.
+ * 
+ * @param timing the timing of the mutex
+ */
+CP_HIDDEN void cpi_record_lock_release(cpi_lock_timing_t *timing);
+
+/**
+ * Returns a copy of the collected statistics.
+ * 
+ * @param profile the statistics
+ * @param num filled with the number of entries
+ * @return the statistics allocated using ::cpi_alloc_info, or NULL if insufficient memory
+ */
+CP_HIDDEN cp_lock_stats_t *cpi_copy_lock_profile(const cpi_lock_profile_t *profile, int *num);
+
+// Thread functions
+
+/**
+ * Creates and starts a new thread executing the specified function.
+ * 
+ * @param func the function to be executed
+ * @param arg the argument passed to the function
+ * @return the created thread or NULL if no resources available
+ */
+CP_HIDDEN cpi_thread_t * cpi_create_thread(void (*func)(void *arg), void *arg);
+
+/**
+ * Waits for the specified thread to finish and releases the resources
+ * associated with it.
+ * 
+ * @param thread the thread to be joined
+ */
+CP_HIDDEN void cpi_join_thread(cpi_thread_t *thread);
+
+/**
+ * Returns whether the specified thread is the calling thread.
+ * 
+ * @param thread the thread
+ * @return whether the thread is the calling thread
+ */
+CP_HIDDEN int cpi_is_current_thread(cpi_thread_t *thread);
+
+/**
+ * Returns the number of processors currently online, or one if the
+ * number can not be determined.
+ * 
+ * @return the number of processors
+ */
+CP_HIDDEN unsigned int cpi_get_num_processors(void);
+
+// Atomic counter functions
+
+/**
+ * Atomically increments the specified counter.
+ * 
+ * @param counter the counter
+ * @return the incremented value
+ */
+CP_HIDDEN long cpi_atomic_increment(volatile long *counter);
+
+/**
+ * Atomically decrements the specified counter.
+ * 
+ * @param counter the counter
+ * @return the decremented value
+ */
+CP_HIDDEN long cpi_atomic_decrement(volatile long *counter);
+
+/**
+ * Atomically reads the specified value with acquire semantics.
+ * 
+ * @param value the value
+ * @return the current value
+ */
+CP_HIDDEN long cpi_atomic_load(volatile long *value);
+
+/**
+ * Atomically replaces the specified value with release semantics.
+ * 
+ * @param value the value
+ * @param new_value the new value
+ */
+CP_HIDDEN void cpi_atomic_store(volatile long *value, long new_value);
+
 #ifdef __cplusplus
 }
 #endif //__cplusplus 
@@ -34,6 +34,9 @@
 #include <string.h>
 #include <assert.h>
 #include <pthread.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 #include "cpluff.h"
 #include "defines.h"
 #include "util.h"
@@ -45,12 +48,35 @@
  * Data types
  * ----------------------------------------------------------------------*/
 
-// A generic recursive mutex implementation 
+/// A thread holding a mutex in shared mode
+typedef struct shared_holder_t {
+	
+	/// The holding thread
+	pthread_t os_thread;
+	
+	/// The number of shared locks held by the thread
+	int lock_count;
+	
+} shared_holder_t;
+
+// A generic recursive mutex implementation with shared locking
 struct cpi_mutex_t {
 
 	/// The current lock count 
 	int lock_count;
 	
+	/// The number of threads currently holding a shared lock
+	int shared_count;
+	
+	/// The threads holding a shared lock, shared_count entries
+	shared_holder_t *shared_holders;
+	
+	/// The capacity of the shared holder array
+	int shared_size;
+	
+	/// The number of threads waiting for an exclusive lock
+	int num_wait_writers;
+	
 	/// The underlying operating system mutex 
 	pthread_mutex_t os_mutex;
 	
@@ -63,6 +89,31 @@ struct cpi_mutex_t {
 	/// The locking thread if currently locked 
 	pthread_t os_thread;
 	
+	/// The profiling state of the current exclusive acquisition
+	cpi_lock_timing_t timing;
+	
+};
+
+// A generic condition variable implementation
+struct cpi_cond_t {
+	
+	/// The underlying condition variable
+	pthread_cond_t os_cond;
+	
+};
+
+// A generic thread implementation
+struct cpi_thread_t {
+
+	/// The function to be executed
+	void (*func)(void *arg);
+	
+	/// The argument for the function
+	void *arg;
+	
+	/// The underlying operating system thread
+	pthread_t os_thread;
+	
 };
 
 
@@ -102,6 +153,11 @@ CP_HIDDEN void cpi_destroy_mutex(cpi_mutex_t *mutex) {
 	
 	assert(mutex != NULL);
 	assert(mutex->lock_count == 0);
+	assert(mutex->shared_count == 0);
+	if (mutex->timing.profile != NULL) {
+		cpi_destroy_lock_profile(mutex->timing.profile);
+	}
+	free(mutex->shared_holders);
 	ec = pthread_mutex_destroy(&(mutex->os_mutex));
 	assert(!ec);
 	ec = pthread_cond_destroy(&(mutex->os_cond_lock));
@@ -127,25 +183,132 @@ static void unlock_mutex(pthread_mutex_t *mutex) {
 	}
 }
 
-static void lock_mutex_holding(cpi_mutex_t *mutex) {
-	pthread_t self = pthread_self();
+static void wait_lock_available(cpi_mutex_t *mutex) {
+	int ec;
 	
-	while (mutex->lock_count != 0
-			&& !pthread_equal(self, mutex->os_thread)) {
-		int ec;
+	if ((ec = pthread_cond_wait(&(mutex->os_cond_lock), &(mutex->os_mutex)))) {
+		cpi_fatalf(_("Could not wait for a condition variable due to error %d."), ec);
+	}
+}
+
+static void signal_lock_available(cpi_mutex_t *mutex) {
+	int ec;
+	
+	// Both readers and writers wait on the same condition variable
+	if ((ec = pthread_cond_broadcast(&(mutex->os_cond_lock)))) {
+		cpi_fatalf(_("Could not broadcast a condition variable due to error %d."), ec);
+	}
+}
+
+/**
+ * Returns the index of the shared holder entry of the specified thread.
+ * 
+ * @param mutex the mutex
+ * @param thread the thread
+ * @return the index of the entry or -1 if the thread holds no shared lock
+ */
+static int find_shared_holder(cpi_mutex_t *mutex, pthread_t thread) {
+	int i;
+	
+	for (i = 0; i < mutex->shared_count; i++) {
+		if (pthread_equal(mutex->shared_holders[i].os_thread, thread)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Registers the calling thread as a new shared holder of the mutex.
+ * 
+ * @param mutex the mutex
+ */
+static void add_shared_holder(cpi_mutex_t *mutex) {
+	if (mutex->shared_count == mutex->shared_size) {
+		int ns = (mutex->shared_size != 0 ? mutex->shared_size * 2 : 4);
+		shared_holder_t *nh;
 		
-		if ((ec = pthread_cond_wait(&(mutex->os_cond_lock), &(mutex->os_mutex)))) {
-			cpi_fatalf(_("Could not wait for a condition variable due to error %d."), ec);
+		if ((nh = realloc(mutex->shared_holders, ns * sizeof(shared_holder_t))) == NULL) {
+			cpi_fatalf(_("Could not lock a mutex due to insufficient memory."));
 		}
+		mutex->shared_holders = nh;
+		mutex->shared_size = ns;
+	}
+	mutex->shared_holders[mutex->shared_count].os_thread = pthread_self();
+	mutex->shared_holders[mutex->shared_count].lock_count = 1;
+	mutex->shared_count++;
+}
+
+/**
+ * Removes a shared holder entry and signals waiting writers if it was the
+ * last one.
+ * 
+ * @param mutex the mutex
+ * @param i the index of the entry
+ */
+static void remove_shared_holder(cpi_mutex_t *mutex, int i) {
+	mutex->shared_holders[i] = mutex->shared_holders[--mutex->shared_count];
+	if (mutex->shared_count == 0 && mutex->num_wait_writers != 0) {
+		signal_lock_available(mutex);
+	}
+}
+
+static void lock_mutex_holding(cpi_mutex_t *mutex) {
+	pthread_t self = pthread_self();
+	int shared_locks = 0;
+	int i;
+	
+	// A shared holder upgrades by giving up its shared locks while waiting
+	if (mutex->lock_count == 0
+		&& (i = find_shared_holder(mutex, self)) != -1) {
+		shared_locks = mutex->shared_holders[i].lock_count;
+		remove_shared_holder(mutex, i);
+	}
+	while ((mutex->lock_count != 0
+			&& !pthread_equal(self, mutex->os_thread))
+			|| (mutex->lock_count == 0 && mutex->shared_count != 0)) {
+		mutex->num_wait_writers++;
+		wait_lock_available(mutex);
+		mutex->num_wait_writers--;
 	}
 	mutex->os_thread = self;
-	mutex->lock_count++;
+	mutex->lock_count += 1 + shared_locks;
+}
+
+/**
+ * Acquires the mutex like lock_mutex_holding and starts timing a new
+ * exclusive acquisition of a profiled mutex.
+ * 
+ * @param mutex the profiled mutex
+ */
+static void lock_mutex_profiled(cpi_mutex_t *mutex) {
+	unsigned long long started = 0;
+	int contended;
+	
+	if (mutex->lock_count != 0 && pthread_equal(pthread_self(), mutex->os_thread)) {
+		mutex->lock_count++;
+		return;
+	}
+	if ((contended = (mutex->lock_count != 0 || mutex->shared_count != 0))) {
+		started = cpi_monotonic_usecs();
+	}
+	lock_mutex_holding(mutex);
+	mutex->timing.acquired = cpi_monotonic_usecs();
+	mutex->timing.waited = (contended ? mutex->timing.acquired - started : 0);
+	mutex->timing.contended = contended;
+	mutex->timing.held = 0;
+	mutex->timing.func = NULL;
+	mutex->timing.tracked = 1;
 }
 
 CP_HIDDEN void cpi_lock_mutex(cpi_mutex_t *mutex) {
 	assert(mutex != NULL);
 	lock_mutex(&(mutex->os_mutex));
-	lock_mutex_holding(mutex);
+	if (mutex->timing.profile != NULL) {
+		lock_mutex_profiled(mutex);
+	} else {
+		lock_mutex_holding(mutex);
+	}
 	unlock_mutex(&(mutex->os_mutex));
 }
 
@@ -157,11 +320,8 @@ CP_HIDDEN void cpi_unlock_mutex(cpi_mutex_t *mutex) {
 	if (mutex->lock_count > 0
 		&& pthread_equal(self, mutex->os_thread)) {
 		if (--mutex->lock_count == 0) {
-			int ec;
-			
-			if ((ec = pthread_cond_signal(&(mutex->os_cond_lock)))) {
-				cpi_fatalf(_("Could not signal a condition variable due to error %d."), ec);
-			}
+			cpi_record_lock_release(&(mutex->timing));
+			signal_lock_available(mutex);
 		}
 	} else {
 		cpi_fatalf(_("Internal C-Pluff error: Unauthorized attempt at unlocking a mutex."));
@@ -169,7 +329,94 @@ CP_HIDDEN void cpi_unlock_mutex(cpi_mutex_t *mutex) {
 	unlock_mutex(&(mutex->os_mutex));
 }
 
-CP_HIDDEN void cpi_wait_mutex(cpi_mutex_t *mutex) {
+CP_HIDDEN void cpi_lock_mutex_shared(cpi_mutex_t *mutex) {
+	pthread_t self = pthread_self();
+	int i;
+	
+	assert(mutex != NULL);
+	lock_mutex(&(mutex->os_mutex));
+	if (mutex->lock_count != 0
+		&& pthread_equal(self, mutex->os_thread)) {
+		
+		// Exclusive holder, treat as a recursive exclusive lock
+		mutex->lock_count++;
+		
+	} else if ((i = find_shared_holder(mutex, self)) != -1) {
+		
+		// Recursive shared lock, waiting writers would wait for this thread
+		mutex->shared_holders[i].lock_count++;
+		
+	} else {
+		unsigned long long started = 0;
+		int contended = (mutex->lock_count != 0 || mutex->num_wait_writers != 0);
+		
+		if (contended && mutex->timing.profile != NULL) {
+			started = cpi_monotonic_usecs();
+		}
+		
+		// Writers are preferred to avoid starving them
+		while (mutex->lock_count != 0 || mutex->num_wait_writers != 0) {
+			wait_lock_available(mutex);
+		}
+		add_shared_holder(mutex);
+		
+		// Shared holds overlap, so only the wait is recorded
+		if (mutex->timing.profile != NULL) {
+			cpi_record_lock(mutex->timing.profile, NULL,
+				contended ? cpi_monotonic_usecs() - started : 0, contended, 0, 0);
+		}
+		
+	}
+	unlock_mutex(&(mutex->os_mutex));
+}
+
+CP_HIDDEN void cpi_unlock_mutex_shared(cpi_mutex_t *mutex) {
+	pthread_t self = pthread_self();
+	int i;
+	
+	assert(mutex != NULL);
+	lock_mutex(&(mutex->os_mutex));
+	if (mutex->lock_count != 0
+		&& pthread_equal(self, mutex->os_thread)) {
+		if (--mutex->lock_count == 0) {
+			cpi_record_lock_release(&(mutex->timing));
+			signal_lock_available(mutex);
+		}
+	} else if ((i = find_shared_holder(mutex, self)) != -1) {
+		if (--mutex->shared_holders[i].lock_count == 0) {
+			remove_shared_holder(mutex, i);
+		}
+	} else {
+		cpi_fatalf(_("Internal C-Pluff error: Unauthorized attempt at unlocking a mutex."));
+	}
+	unlock_mutex(&(mutex->os_mutex));
+}
+
+CP_HIDDEN void cpi_upgrade_mutex(cpi_mutex_t *mutex) {
+	int i;
+	
+	assert(mutex != NULL);
+	lock_mutex(&(mutex->os_mutex));
+	if ((i = find_shared_holder(mutex, pthread_self())) != -1
+		&& mutex->shared_holders[i].lock_count == 1) {
+		remove_shared_holder(mutex, i);
+		if (mutex->timing.profile != NULL) {
+			lock_mutex_profiled(mutex);
+		} else {
+			lock_mutex_holding(mutex);
+		}
+	}
+	unlock_mutex(&(mutex->os_mutex));
+}
+
+/**
+ * Releases the mutex held by the calling thread, waits on the specified
+ * condition variable and reacquires the mutex with the original lock count.
+ * 
+ * @param mutex the mutex held by the calling thread
+ * @param cond the condition variable
+ */
+static void wait_mutex_on(cpi_mutex_t *mutex, pthread_cond_t *cond) {
 	pthread_t self = pthread_self();
 	
 	assert(mutex != NULL);
@@ -178,21 +425,28 @@ CP_HIDDEN void cpi_wait_mutex(cpi_mutex_t *mutex) {
 		&& pthread_equal(self, mutex->os_thread)) {
 		int ec;
 		int lc = mutex->lock_count;
+		cpi_lock_timing_t timing = mutex->timing;
 		
-		// Release mutex
-		mutex->lock_count = 0;
-		if ((ec = pthread_cond_signal(&(mutex->os_cond_lock)))) {
-			cpi_fatalf(_("Could not signal a condition variable due to error %d."), ec);
+		// Release mutex, the time spent waiting is not part of the hold time
+		if (timing.tracked) {
+			timing.held += cpi_monotonic_usecs() - timing.acquired;
 		}
+		mutex->timing.tracked = 0;
+		mutex->lock_count = 0;
+		signal_lock_available(mutex);
 		
 		// Wait for signal
-		if ((ec = pthread_cond_wait(&(mutex->os_cond_wake), &(mutex->os_mutex)))) {
+		if ((ec = pthread_cond_wait(cond, &(mutex->os_mutex)))) {
 			cpi_fatalf(_("Could not wait for a condition variable due to error %d."), ec);
 		}
 		
 		// Re-acquire mutex and restore lock count for this thread
 		lock_mutex_holding(mutex);
 		mutex->lock_count = lc;
+		if (timing.tracked && mutex->timing.profile == timing.profile) {
+			timing.acquired = cpi_monotonic_usecs();
+			mutex->timing = timing;
+		}
 		
 	} else {
 		cpi_fatalf(_("Internal C-Pluff error: Unauthorized attempt at waiting on a mutex."));
@@ -200,6 +454,11 @@ CP_HIDDEN void cpi_wait_mutex(cpi_mutex_t *mutex) {
 	unlock_mutex(&(mutex->os_mutex));
 }
 
+CP_HIDDEN void cpi_wait_mutex(cpi_mutex_t *mutex) {
+	assert(mutex != NULL);
+	wait_mutex_on(mutex, &(mutex->os_cond_wake));
+}
+
 CP_HIDDEN void cpi_signal_mutex(cpi_mutex_t *mutex) {
 	pthread_t self = pthread_self();
 	
@@ -220,13 +479,205 @@ CP_HIDDEN void cpi_signal_mutex(cpi_mutex_t *mutex) {
 	unlock_mutex(&(mutex->os_mutex));
 }
 
+CP_HIDDEN cpi_cond_t * cpi_create_cond(void) {
+	cpi_cond_t *cond;
+	
+	if ((cond = malloc(sizeof(cpi_cond_t))) == NULL) {
+		return NULL;
+	}
+	if (pthread_cond_init(&(cond->os_cond), NULL)) {
+		free(cond);
+		return NULL;
+	}
+	return cond;
+}
+
+CP_HIDDEN void cpi_destroy_cond(cpi_cond_t *cond) {
+	int ec;
+	
+	assert(cond != NULL);
+	ec = pthread_cond_destroy(&(cond->os_cond));
+	assert(!ec);
+	free(cond);
+}
+
+CP_HIDDEN void cpi_wait_cond(cpi_cond_t *cond, cpi_mutex_t *mutex) {
+	assert(cond != NULL);
+	wait_mutex_on(mutex, &(cond->os_cond));
+}
+
+CP_HIDDEN void cpi_signal_cond(cpi_cond_t *cond) {
+	int ec;
+	
+	assert(cond != NULL);
+	if ((ec = pthread_cond_broadcast(&(cond->os_cond)))) {
+		cpi_fatalf(_("Could not broadcast a condition variable due to error %d."), ec);
+	}
+}
+
+CP_HIDDEN int cpi_set_mutex_profiling(cpi_mutex_t *mutex, int enabled) {
+	cpi_lock_profile_t *profile = NULL;
+	int success = 1;
+	
+	assert(mutex != NULL);
+	lock_mutex(&(mutex->os_mutex));
+	assert(mutex->lock_count > 0 && pthread_equal(pthread_self(), mutex->os_thread));
+	if (enabled && (profile = cpi_create_lock_profile()) == NULL) {
+		success = 0;
+	} else {
+		if (mutex->timing.profile != NULL) {
+			cpi_destroy_lock_profile(mutex->timing.profile);
+		}
+		mutex->timing.profile = profile;
+		mutex->timing.tracked = 0;
+	}
+	unlock_mutex(&(mutex->os_mutex));
+	return success;
+}
+
+CP_HIDDEN void cpi_set_mutex_function(cpi_mutex_t *mutex, const char *func) {
+	
+	// Only the holder changes the profile, so this is stable
+	if (mutex->timing.profile == NULL) {
+		return;
+	}
+	lock_mutex(&(mutex->os_mutex));
+	if (mutex->timing.tracked && mutex->timing.func == NULL
+		&& mutex->lock_count != 0 && pthread_equal(pthread_self(), mutex->os_thread)) {
+		mutex->timing.func = func;
+	}
+	unlock_mutex(&(mutex->os_mutex));
+}
+
+CP_HIDDEN cp_lock_stats_t *cpi_copy_mutex_profile(cpi_mutex_t *mutex, int *num, cp_status_t *error) {
+	cp_lock_stats_t *stats = NULL;
+	
+	assert(mutex != NULL);
+	lock_mutex(&(mutex->os_mutex));
+	if (mutex->timing.profile == NULL) {
+		*error = CP_ERR_UNKNOWN;
+	} else if ((stats = cpi_copy_lock_profile(mutex->timing.profile, num)) == NULL) {
+		*error = CP_ERR_RESOURCE;
+	} else {
+		*error = CP_OK;
+	}
+	unlock_mutex(&(mutex->os_mutex));
+	return stats;
+}
+
 #if !defined(NDEBUG)
 CP_HIDDEN int cpi_is_mutex_locked(cpi_mutex_t *mutex) {
 	int locked;
 	
 	lock_mutex(&(mutex->os_mutex));
-	locked = (mutex->lock_count != 0);
+	locked = (mutex->lock_count != 0 || mutex->shared_count != 0);
 	unlock_mutex(&(mutex->os_mutex));
 	return locked;
 }
 #endif
+
+static void *thread_main(void *arg) {
+	cpi_thread_t *thread = arg;
+	
+	thread->func(thread->arg);
+	return NULL;
+}
+
+CP_HIDDEN cpi_thread_t * cpi_create_thread(void (*func)(void *arg), void *arg) {
+	cpi_thread_t *thread;
+	
+	assert(func != NULL);
+	if ((thread = malloc(sizeof(cpi_thread_t))) == NULL) {
+		return NULL;
+	}
+	thread->func = func;
+	thread->arg = arg;
+	if (pthread_create(&(thread->os_thread), NULL, thread_main, thread)) {
+		free(thread);
+		return NULL;
+	}
+	return thread;
+}
+
+CP_HIDDEN void cpi_join_thread(cpi_thread_t *thread) {
+	int ec;
+	
+	assert(thread != NULL);
+	if ((ec = pthread_join(thread->os_thread, NULL))) {
+		cpi_fatalf(_("Could not join a thread due to error %d."), ec);
+	}
+	free(thread);
+}
+
+#ifndef __GNUC__
+
+/// Mutex protecting atomic counters on compilers without atomic builtins
+static pthread_mutex_t atomic_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#endif
+
+CP_HIDDEN int cpi_is_current_thread(cpi_thread_t *thread) {
+	assert(thread != NULL);
+	return pthread_equal(pthread_self(), thread->os_thread);
+}
+
+CP_HIDDEN unsigned int cpi_get_num_processors(void) {
+#if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	
+	if (n > 0) {
+		return (unsigned int) n;
+	}
+#endif
+	return 1;
+}
+
+CP_HIDDEN long cpi_atomic_increment(volatile long *counter) {
+#ifdef __GNUC__
+	return __sync_add_and_fetch(counter, 1);
+#else
+	long value;
+	
+	lock_mutex(&atomic_mutex);
+	value = ++(*counter);
+	unlock_mutex(&atomic_mutex);
+	return value;
+#endif
+}
+
+CP_HIDDEN long cpi_atomic_decrement(volatile long *counter) {
+#ifdef __GNUC__
+	return __sync_sub_and_fetch(counter, 1);
+#else
+	long value;
+	
+	lock_mutex(&atomic_mutex);
+	value = --(*counter);
+	unlock_mutex(&atomic_mutex);
+	return value;
+#endif
+}
+
+CP_HIDDEN long cpi_atomic_load(volatile long *value) {
+#ifdef __GNUC__
+	return __sync_fetch_and_add(value, 0);
+#else
+	long v;
+	
+	lock_mutex(&atomic_mutex);
+	v = *value;
+	unlock_mutex(&atomic_mutex);
+	return v;
+#endif
+}
+
+CP_HIDDEN void cpi_atomic_store(volatile long *value, long new_value) {
+#ifdef __GNUC__
+	__sync_synchronize();
+	__sync_lock_test_and_set(value, new_value);
+#else
+	lock_mutex(&atomic_mutex);
+	*value = new_value;
+	unlock_mutex(&atomic_mutex);
+#endif
+}
@@ -22,13 +22,20 @@
  *-----------------------------------------------------------------------*/
 
 /** @file
- * Windows implementation for generic mutex functions
+ * Windows implementation for generic mutex functions, based on slim
+ * reader/writer locks and condition variables (Windows Vista or later)
  */
 
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
 
+// Slim reader/writer locks and condition variables require Windows Vista
+#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0600
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,27 +52,75 @@
  * Data types
  * ----------------------------------------------------------------------*/
 
-// A generic recursive mutex implementation 
+/// A thread holding a mutex in shared mode
+typedef struct shared_holder_t {
+	
+	/// The holding thread
+	DWORD os_thread;
+	
+	/// The number of shared locks held by the thread
+	int lock_count;
+	
+} shared_holder_t;
+
+// A generic recursive mutex implementation with shared locking
 struct cpi_mutex_t {
 
 	/// The current lock count 
 	int lock_count;
 	
-	/// The underlying operating system mutex 
-	HANDLE os_mutex;
+	/// The number of threads currently holding a shared lock
+	int shared_count;
+	
+	/// The threads holding a shared lock, shared_count entries
+	shared_holder_t *shared_holders;
+	
+	/// The capacity of the shared holder array
+	int shared_size;
+	
+	/// The number of threads waiting for an exclusive lock
+	int num_wait_writers;
+	
+	/// The underlying slim lock, always acquired in exclusive mode
+	SRWLOCK os_mutex;
 	
 	/// The condition variable for signaling availability 
-	HANDLE os_cond_lock;
+	CONDITION_VARIABLE os_cond_lock;
 	
-	/// The condition variable for signaling a wake request
-	HANDLE os_cond_wake;
-
-	/// Number of threads currently waiting on this mutex
-	int num_wait_threads;
+	/// The condition variable for broadcasting a wake request
+	CONDITION_VARIABLE os_cond_wake;
 
 	/// The locking thread if currently locked 
 	DWORD os_thread;
 	
+	/// The profiling state of the current exclusive acquisition
+	cpi_lock_timing_t timing;
+	
+};
+
+// A generic condition variable implementation
+struct cpi_cond_t {
+	
+	/// The underlying condition variable
+	CONDITION_VARIABLE os_cond;
+	
+};
+
+// A generic thread implementation
+struct cpi_thread_t {
+
+	/// The function to be executed
+	void (*func)(void *arg);
+	
+	/// The argument for the function
+	void *arg;
+	
+	/// The underlying operating system thread
+	HANDLE os_thread;
+	
+	/// The identifier of the thread
+	DWORD os_thread_id;
+	
 };
 
 
@@ -80,37 +135,22 @@ CP_HIDDEN cpi_mutex_t * cpi_create_mutex(void) {
 		return NULL;
 	}
 	memset(mutex, 0, sizeof(cpi_mutex_t));
-	if ((mutex->os_mutex = CreateMutex(NULL, FALSE, NULL)) == NULL) {
-		return NULL;
-	} else if ((mutex->os_cond_lock = CreateEvent(NULL, FALSE, FALSE, NULL)) == NULL) {
-		int ec;
-		
-		ec = CloseHandle(mutex->os_mutex);
-		assert(ec);
-		return NULL;
-	} else if ((mutex->os_cond_wake = CreateEvent(NULL, TRUE, FALSE, NULL)) == NULL) {
-		int ec;
-		
-		ec = CloseHandle(mutex->os_mutex);
-		assert(ec);
-		ec = CloseHandle(mutex->os_cond_lock);
-		assert(ec);
-		return NULL;
-	}
+	
+	// Slim locks and condition variables need no resources
+	InitializeSRWLock(&(mutex->os_mutex));
+	InitializeConditionVariable(&(mutex->os_cond_lock));
+	InitializeConditionVariable(&(mutex->os_cond_wake));
 	return mutex;
 }
 
 CP_HIDDEN void cpi_destroy_mutex(cpi_mutex_t *mutex) {
-	int ec;
-	
 	assert(mutex != NULL);
 	assert(mutex->lock_count == 0);
-	ec = CloseHandle(mutex->os_mutex);
-	assert(ec);
-	ec = CloseHandle(mutex->os_cond_lock);
-	assert(ec);
-	ec = CloseHandle(mutex->os_cond_wake);
-	assert(ec);
+	assert(mutex->shared_count == 0);
+	if (mutex->timing.profile != NULL) {
+		cpi_destroy_lock_profile(mutex->timing.profile);
+	}
+	free(mutex->shared_holders);
 	free(mutex);
 }
 
@@ -129,144 +169,458 @@ static char *get_win_errormsg(DWORD error, char *buffer, size_t size) {
 	return buffer;
 }
 
-static void lock_mutex(HANDLE mutex) {
-	DWORD ec;
-	
-	if ((ec = WaitForSingleObject(mutex, INFINITE)) != WAIT_OBJECT_0) {
-		char buffer[256];
-		ec = GetLastError();
-		cpi_fatalf(_("Could not lock a mutex due to error %ld: %s"),
-			(long) ec, get_win_errormsg(ec, buffer, sizeof(buffer)));
-	}
+static void lock_mutex(SRWLOCK *mutex) {
+	AcquireSRWLockExclusive(mutex);
 }
 
-static void unlock_mutex(HANDLE mutex) {
-	if (!ReleaseMutex(mutex)) {
+static void unlock_mutex(SRWLOCK *mutex) {
+	ReleaseSRWLockExclusive(mutex);
+}
+
+static void wait_condition(CONDITION_VARIABLE *cond, SRWLOCK *mutex) {
+	if (!SleepConditionVariableSRW(cond, mutex, INFINITE, 0)) {
 		char buffer[256];
 		DWORD ec = GetLastError();
-		cpi_fatalf(_("Could not release a mutex due to error %ld: %s"),
+		cpi_fatalf(_("Could not wait for a condition variable due to error %ld: %s"),
 			(long) ec, get_win_errormsg(ec, buffer, sizeof(buffer)));
 	}
 }
 
-static void wait_for_event(HANDLE event) {
-	if (WaitForSingleObject(event, INFINITE) != WAIT_OBJECT_0) {
+static void wait_lock_available(cpi_mutex_t *mutex) {
+	wait_condition(&(mutex->os_cond_lock), &(mutex->os_mutex));
+}
+
+static void signal_lock_available(cpi_mutex_t *mutex) {
+	
+	// Both readers and writers wait on the same condition variable
+	WakeAllConditionVariable(&(mutex->os_cond_lock));
+}
+
+static void wait_for_object(HANDLE object) {
+	if (WaitForSingleObject(object, INFINITE) != WAIT_OBJECT_0) {
 		char buffer[256];
 		DWORD ec = GetLastError();
-		cpi_fatalf(_("Could not wait for an event due to error %ld: %s"),
+		cpi_fatalf(_("Could not wait for an object due to error %ld: %s"),
 			(long) ec, get_win_errormsg(ec, buffer, sizeof(buffer)));
 	}
 }
 
-static void set_event(HANDLE event) {
-	if (!SetEvent(event)) {
-		char buffer[256];
-		DWORD ec = GetLastError();
-		cpi_fatalf(_("Could not set an event due to error %ld: %s"),
-			(long) ec, get_win_errormsg(ec, buffer, sizeof(buffer)));
+/**
+ * Returns the index of the shared holder entry of the specified thread.
+ * 
+ * @param mutex the mutex
+ * @param thread the thread
+ * @return the index of the entry or -1 if the thread holds no shared lock
+ */
+static int find_shared_holder(cpi_mutex_t *mutex, DWORD thread) {
+	int i;
+	
+	for (i = 0; i < mutex->shared_count; i++) {
+		if (mutex->shared_holders[i].os_thread == thread) {
+			return i;
+		}
 	}
+	return -1;
 }
 
-static void reset_event(HANDLE event) {
-	if (!ResetEvent(event)) {
-		char buffer[256];
-		DWORD ec = GetLastError();
-		cpi_fatalf(_("Could not reset an event due to error %ld: %s"),
-			(long) ec, get_win_errormsg(ec, buffer, sizeof(buffer)));
+/**
+ * Registers the calling thread as a new shared holder of the mutex.
+ * 
+ * @param mutex the mutex
+ */
+static void add_shared_holder(cpi_mutex_t *mutex) {
+	if (mutex->shared_count == mutex->shared_size) {
+		int ns = (mutex->shared_size != 0 ? mutex->shared_size * 2 : 4);
+		shared_holder_t *nh;
+		
+		if ((nh = realloc(mutex->shared_holders, ns * sizeof(shared_holder_t))) == NULL) {
+			cpi_fatalf(_("Could not lock a mutex due to insufficient memory."));
+		}
+		mutex->shared_holders = nh;
+		mutex->shared_size = ns;
+	}
+	mutex->shared_holders[mutex->shared_count].os_thread = GetCurrentThreadId();
+	mutex->shared_holders[mutex->shared_count].lock_count = 1;
+	mutex->shared_count++;
+}
+
+/**
+ * Removes a shared holder entry and signals waiting writers if it was the
+ * last one.
+ * 
+ * @param mutex the mutex
+ * @param i the index of the entry
+ */
+static void remove_shared_holder(cpi_mutex_t *mutex, int i) {
+	mutex->shared_holders[i] = mutex->shared_holders[--mutex->shared_count];
+	if (mutex->shared_count == 0 && mutex->num_wait_writers != 0) {
+		signal_lock_available(mutex);
 	}
 }
 
 static void lock_mutex_holding(cpi_mutex_t *mutex) {
 	DWORD self = GetCurrentThreadId();
+	int shared_locks = 0;
+	int i;
 	
-	while (mutex->lock_count != 0
-			&& self != mutex->os_thread) {
-		unlock_mutex(mutex->os_mutex);
-		wait_for_event(mutex->os_cond_lock);
-		lock_mutex(mutex->os_mutex);
+	// A shared holder upgrades by giving up its shared locks while waiting
+	if (mutex->lock_count == 0
+		&& (i = find_shared_holder(mutex, self)) != -1) {
+		shared_locks = mutex->shared_holders[i].lock_count;
+		remove_shared_holder(mutex, i);
+	}
+	while ((mutex->lock_count != 0
+			&& self != mutex->os_thread)
+			|| (mutex->lock_count == 0 && mutex->shared_count != 0)) {
+		mutex->num_wait_writers++;
+		wait_lock_available(mutex);
+		mutex->num_wait_writers--;
 	}
 	mutex->os_thread = self;
-	mutex->lock_count++;
+	mutex->lock_count += 1 + shared_locks;
+}
+
+/**
+ * Acquires the mutex like lock_mutex_holding and starts timing a new
+ * exclusive acquisition of a profiled mutex.
+ * 
+ * @param mutex the profiled mutex
+ */
+static void lock_mutex_profiled(cpi_mutex_t *mutex) {
+	unsigned long long started = 0;
+	int contended;
+	
+	if (mutex->lock_count != 0 && GetCurrentThreadId() == mutex->os_thread) {
+		mutex->lock_count++;
+		return;
+	}
+	if ((contended = (mutex->lock_count != 0 || mutex->shared_count != 0))) {
+		started = cpi_monotonic_usecs();
+	}
+	lock_mutex_holding(mutex);
+	mutex->timing.acquired = cpi_monotonic_usecs();
+	mutex->timing.waited = (contended ? mutex->timing.acquired - started : 0);
+	mutex->timing.contended = contended;
+	mutex->timing.held = 0;
+	mutex->timing.func = NULL;
+	mutex->timing.tracked = 1;
 }
 
 CP_HIDDEN void cpi_lock_mutex(cpi_mutex_t *mutex) {
 	assert(mutex != NULL);
-	lock_mutex(mutex->os_mutex);
-	lock_mutex_holding(mutex);
-	unlock_mutex(mutex->os_mutex);
+	lock_mutex(&(mutex->os_mutex));
+	if (mutex->timing.profile != NULL) {
+		lock_mutex_profiled(mutex);
+	} else {
+		lock_mutex_holding(mutex);
+	}
+	unlock_mutex(&(mutex->os_mutex));
 }
 
 CP_HIDDEN void cpi_unlock_mutex(cpi_mutex_t *mutex) {
 	DWORD self = GetCurrentThreadId();
 	
 	assert(mutex != NULL);
-	lock_mutex(mutex->os_mutex);
+	lock_mutex(&(mutex->os_mutex));
 	if (mutex->lock_count > 0
 		&& self == mutex->os_thread) {
 		if (--mutex->lock_count == 0) {
-			set_event(mutex->os_cond_lock);
+			cpi_record_lock_release(&(mutex->timing));
+			signal_lock_available(mutex);
 		}
 	} else {
 		cpi_fatalf(_("Internal C-Pluff error: Unauthorized attempt at unlocking a mutex."));
 	}
-	unlock_mutex(mutex->os_mutex);
+	unlock_mutex(&(mutex->os_mutex));
 }
 
-CP_HIDDEN void cpi_wait_mutex(cpi_mutex_t *mutex) {
+CP_HIDDEN void cpi_lock_mutex_shared(cpi_mutex_t *mutex) {
+	DWORD self = GetCurrentThreadId();
+	int i;
+	
+	assert(mutex != NULL);
+	lock_mutex(&(mutex->os_mutex));
+	if (mutex->lock_count != 0
+		&& self == mutex->os_thread) {
+		
+		// Exclusive holder, treat as a recursive exclusive lock
+		mutex->lock_count++;
+		
+	} else if ((i = find_shared_holder(mutex, self)) != -1) {
+		
+		// Recursive shared lock, waiting writers would wait for this thread
+		mutex->shared_holders[i].lock_count++;
+		
+	} else {
+		unsigned long long started = 0;
+		int contended = (mutex->lock_count != 0 || mutex->num_wait_writers != 0);
+		
+		if (contended && mutex->timing.profile != NULL) {
+			started = cpi_monotonic_usecs();
+		}
+		
+		// Writers are preferred to avoid starving them
+		while (mutex->lock_count != 0 || mutex->num_wait_writers != 0) {
+			wait_lock_available(mutex);
+		}
+		add_shared_holder(mutex);
+		
+		// Shared holds overlap, so only the wait is recorded
+		if (mutex->timing.profile != NULL) {
+			cpi_record_lock(mutex->timing.profile, NULL,
+				contended ? cpi_monotonic_usecs() - started : 0, contended, 0, 0);
+		}
+		
+	}
+	unlock_mutex(&(mutex->os_mutex));
+}
+
+CP_HIDDEN void cpi_unlock_mutex_shared(cpi_mutex_t *mutex) {
 	DWORD self = GetCurrentThreadId();
+	int i;
+	
+	assert(mutex != NULL);
+	lock_mutex(&(mutex->os_mutex));
+	if (mutex->lock_count != 0
+		&& self == mutex->os_thread) {
+		if (--mutex->lock_count == 0) {
+			cpi_record_lock_release(&(mutex->timing));
+			signal_lock_available(mutex);
+		}
+	} else if ((i = find_shared_holder(mutex, self)) != -1) {
+		if (--mutex->shared_holders[i].lock_count == 0) {
+			remove_shared_holder(mutex, i);
+		}
+	} else {
+		cpi_fatalf(_("Internal C-Pluff error: Unauthorized attempt at unlocking a mutex."));
+	}
+	unlock_mutex(&(mutex->os_mutex));
+}
+
+CP_HIDDEN void cpi_upgrade_mutex(cpi_mutex_t *mutex) {
+	int i;
 	
 	assert(mutex != NULL);
-	lock_mutex(mutex->os_mutex);
+	lock_mutex(&(mutex->os_mutex));
+	if ((i = find_shared_holder(mutex, GetCurrentThreadId())) != -1
+		&& mutex->shared_holders[i].lock_count == 1) {
+		remove_shared_holder(mutex, i);
+		if (mutex->timing.profile != NULL) {
+			lock_mutex_profiled(mutex);
+		} else {
+			lock_mutex_holding(mutex);
+		}
+	}
+	unlock_mutex(&(mutex->os_mutex));
+}
+
+/**
+ * Releases the mutex held by the calling thread, waits on the specified
+ * condition variable and reacquires the mutex with the original lock count.
+ * 
+ * @param mutex the mutex held by the calling thread
+ * @param cond the condition variable
+ */
+static void wait_mutex_on(cpi_mutex_t *mutex, CONDITION_VARIABLE *cond) {
+	DWORD self = GetCurrentThreadId();
+	
+	assert(mutex != NULL);
+	lock_mutex(&(mutex->os_mutex));
 	if (mutex->lock_count > 0
 		&& self == mutex->os_thread) {
 		int lc = mutex->lock_count;
+		cpi_lock_timing_t timing = mutex->timing;
 		
-		// Release mutex
+		// Release mutex, the time spent waiting is not part of the hold time
+		if (timing.tracked) {
+			timing.held += cpi_monotonic_usecs() - timing.acquired;
+		}
+		mutex->timing.tracked = 0;
 		mutex->lock_count = 0;
-		mutex->num_wait_threads++;
-		set_event(mutex->os_cond_lock);
-		unlock_mutex(mutex->os_mutex);
+		signal_lock_available(mutex);
 		
 		// Wait for signal
-		wait_for_event(mutex->os_cond_wake);
-		
-		// Reset wake signal if last one waking up
-		lock_mutex(mutex->os_mutex);
-		if (--mutex->num_wait_threads == 0) {
-			reset_event(mutex->os_cond_wake);
-		}
+		wait_condition(cond, &(mutex->os_mutex));
 		
 		// Re-acquire mutex and restore lock count for this thread
 		lock_mutex_holding(mutex);
-		mutex->lock_count = lc;		
+		mutex->lock_count = lc;
+		if (timing.tracked && mutex->timing.profile == timing.profile) {
+			timing.acquired = cpi_monotonic_usecs();
+			mutex->timing = timing;
+		}
 		
 	} else {
 		cpi_fatalf(_("Internal C-Pluff error: Unauthorized attempt at waiting on a mutex."));
 	}
-	unlock_mutex(mutex->os_mutex);
+	unlock_mutex(&(mutex->os_mutex));
+}
+
+CP_HIDDEN void cpi_wait_mutex(cpi_mutex_t *mutex) {
+	assert(mutex != NULL);
+	wait_mutex_on(mutex, &(mutex->os_cond_wake));
 }
 
 CP_HIDDEN void cpi_signal_mutex(cpi_mutex_t *mutex) {
 	DWORD self = GetCurrentThreadId();
 	
 	assert(mutex != NULL);
-	lock_mutex(mutex->os_mutex);
+	lock_mutex(&(mutex->os_mutex));
 	if (mutex->lock_count > 0
 		&& self == mutex->os_thread) {
-		set_event(mutex->os_cond_wake);
+		
+		// Signal the mutex
+		WakeAllConditionVariable(&(mutex->os_cond_wake));
+		
 	} else {
 		cpi_fatalf(_("Internal C-Pluff error: Unauthorized attempt at signaling a mutex."));
 	}
-	unlock_mutex(mutex->os_mutex);	
+	unlock_mutex(&(mutex->os_mutex));	
+}
+
+CP_HIDDEN cpi_cond_t * cpi_create_cond(void) {
+	cpi_cond_t *cond;
+	
+	if ((cond = malloc(sizeof(cpi_cond_t))) == NULL) {
+		return NULL;
+	}
+	InitializeConditionVariable(&(cond->os_cond));
+	return cond;
+}
+
+CP_HIDDEN void cpi_destroy_cond(cpi_cond_t *cond) {
+	assert(cond != NULL);
+	free(cond);
+}
+
+CP_HIDDEN void cpi_wait_cond(cpi_cond_t *cond, cpi_mutex_t *mutex) {
+	assert(cond != NULL);
+	wait_mutex_on(mutex, &(cond->os_cond));
+}
+
+CP_HIDDEN void cpi_signal_cond(cpi_cond_t *cond) {
+	assert(cond != NULL);
+	WakeAllConditionVariable(&(cond->os_cond));
+}
+
+CP_HIDDEN int cpi_set_mutex_profiling(cpi_mutex_t *mutex, int enabled) {
+	cpi_lock_profile_t *profile = NULL;
+	int success = 1;
+	
+	assert(mutex != NULL);
+	lock_mutex(&(mutex->os_mutex));
+	assert(mutex->lock_count > 0 && GetCurrentThreadId() == mutex->os_thread);
+	if (enabled && (profile = cpi_create_lock_profile()) == NULL) {
+		success = 0;
+	} else {
+		if (mutex->timing.profile != NULL) {
+			cpi_destroy_lock_profile(mutex->timing.profile);
+		}
+		mutex->timing.profile = profile;
+		mutex->timing.tracked = 0;
+	}
+	unlock_mutex(&(mutex->os_mutex));
+	return success;
+}
+
+CP_HIDDEN void cpi_set_mutex_function(cpi_mutex_t *mutex, const char *func) {
+	
+	// Only the holder changes the profile, so this is stable
+	if (mutex->timing.profile == NULL) {
+		return;
+	}
+	lock_mutex(&(mutex->os_mutex));
+	if (mutex->timing.tracked && mutex->timing.func == NULL
+		&& mutex->lock_count != 0 && GetCurrentThreadId() == mutex->os_thread) {
+		mutex->timing.func = func;
+	}
+	unlock_mutex(&(mutex->os_mutex));
+}
+
+CP_HIDDEN cp_lock_stats_t *cpi_copy_mutex_profile(cpi_mutex_t *mutex, int *num, cp_status_t *error) {
+	cp_lock_stats_t *stats = NULL;
+	
+	assert(mutex != NULL);
+	lock_mutex(&(mutex->os_mutex));
+	if (mutex->timing.profile == NULL) {
+		*error = CP_ERR_UNKNOWN;
+	} else if ((stats = cpi_copy_lock_profile(mutex->timing.profile, num)) == NULL) {
+		*error = CP_ERR_RESOURCE;
+	} else {
+		*error = CP_OK;
+	}
+	unlock_mutex(&(mutex->os_mutex));
+	return stats;
 }
 
 #if !defined(NDEBUG)
 CP_HIDDEN int cpi_is_mutex_locked(cpi_mutex_t *mutex) {
 	int locked;
 	
-	lock_mutex(mutex->os_mutex);
-	locked = (mutex->lock_count != 0);
-	unlock_mutex(mutex->os_mutex);
+	lock_mutex(&(mutex->os_mutex));
+	locked = (mutex->lock_count != 0 || mutex->shared_count != 0);
+	unlock_mutex(&(mutex->os_mutex));
 	return locked;
 }
 #endif
+
+static DWORD WINAPI thread_main(LPVOID arg) {
+	cpi_thread_t *thread = arg;
+	
+	thread->func(thread->arg);
+	return 0;
+}
+
+CP_HIDDEN cpi_thread_t * cpi_create_thread(void (*func)(void *arg), void *arg) {
+	cpi_thread_t *thread;
+	
+	assert(func != NULL);
+	if ((thread = malloc(sizeof(cpi_thread_t))) == NULL) {
+		return NULL;
+	}
+	thread->func = func;
+	thread->arg = arg;
+	if ((thread->os_thread = CreateThread(NULL, 0, thread_main, thread, 0, &(thread->os_thread_id))) == NULL) {
+		free(thread);
+		return NULL;
+	}
+	return thread;
+}
+
+CP_HIDDEN void cpi_join_thread(cpi_thread_t *thread) {
+	int ec;
+	
+	assert(thread != NULL);
+	wait_for_object(thread->os_thread);
+	ec = CloseHandle(thread->os_thread);
+	assert(ec);
+	free(thread);
+}
+
+CP_HIDDEN int cpi_is_current_thread(cpi_thread_t *thread) {
+	assert(thread != NULL);
+	return GetCurrentThreadId() == thread->os_thread_id;
+}
+
+CP_HIDDEN unsigned int cpi_get_num_processors(void) {
+	SYSTEM_INFO info;
+	
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors > 0 ? (unsigned int) info.dwNumberOfProcessors : 1);
+}
+
+CP_HIDDEN long cpi_atomic_increment(volatile long *counter) {
+	return InterlockedIncrement((LONG volatile *) counter);
+}
+
+CP_HIDDEN long cpi_atomic_decrement(volatile long *counter) {
+	return InterlockedDecrement((LONG volatile *) counter);
+}
+
+CP_HIDDEN long cpi_atomic_load(volatile long *value) {
+	return InterlockedCompareExchange((LONG volatile *) value, 0, 0);
+}
+
+CP_HIDDEN void cpi_atomic_store(volatile long *value, long new_value) {
+	InterlockedExchange((LONG volatile *) value, new_value);
+}
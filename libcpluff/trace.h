@@ -0,0 +1,72 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file
+ * Static tracepoints. When the framework is built with <sys/sdt.h>
+ * available these expand to USDT probes in provider @a cpluff that can
+ * be attached to using perf, bpftrace, SystemTap or LTTng. A probe that
+ * is not attached to is a single no-op instruction and its arguments
+ * are only evaluated into registers. Without USDT support the macros
+ * expand to nothing and the arguments are not evaluated.
+ *
+ * The following probes are defined.
+ *
+ * - plugin__state(plugin_id, old_state, new_state): a plug-in state
+ *   transition being delivered to plug-in listeners
+ * - scan__begin(flags) and scan__end(status): plug-in scanning
+ * - descriptor__begin(path) and descriptor__end(path, status): parsing of
+ *   a plug-in descriptor, path being NULL for descriptors parsed
+ *   from memory
+ * - symbol__resolve(plugin_id, name, ptr, status) and
+ *   symbol__release(ptr): symbol resolution by a client
+ * - run__begin(plugin_id, func) and run__end(plugin_id, func, rerun): a
+ *   run function or task invocation, func being the function address and
+ *   rerun the @ref cRunTaskResults "run task result"
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#endif
+
+
+/* ------------------------------------------------------------------------
+ * Defines
+ * ----------------------------------------------------------------------*/
+
+#ifdef HAVE_SYS_SDT_H
+#define CPI_TRACE1(name, a1) DTRACE_PROBE1(cpluff, name, a1)
+#define CPI_TRACE2(name, a1, a2) DTRACE_PROBE2(cpluff, name, a1, a2)
+#define CPI_TRACE3(name, a1, a2, a3) DTRACE_PROBE3(cpluff, name, a1, a2, a3)
+#define CPI_TRACE4(name, a1, a2, a3, a4) DTRACE_PROBE4(cpluff, name, a1, a2, a3, a4)
+#else
+#define CPI_TRACE1(name, a1) do {} while (0)
+#define CPI_TRACE2(name, a1, a2) do {} while (0)
+#define CPI_TRACE3(name, a1, a2, a3) do {} while (0)
+#define CPI_TRACE4(name, a1, a2, a3, a4) do {} while (0)
+#endif
+
+
+#endif //TRACE_H_
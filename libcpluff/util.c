@@ -33,13 +33,134 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <stddef.h>
 #include <assert.h>
+#include <time.h>
+#if defined(HAVE_GETTIMEOFDAY) && defined(HAVE_SYS_TIME_H)
+#include <sys/time.h>
+#endif
+#if defined(HAVE_POSIX_FADVISE) && defined(HAVE_FCNTL_H) && defined(HAVE_UNISTD_H)
+#define CP_PREFETCH
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include "../kazlib/list.h"
+#include "../kazlib/hash.h"
 #include "cpluff.h"
 #include "defines.h"
 #include "util.h"
 
 
+/* ------------------------------------------------------------------------
+ * Data types
+ * ----------------------------------------------------------------------*/
+
+/// A type having the strictest alignment requirement of the basic types
+typedef union arena_align_t {
+	void *p;
+	long l;
+	double d;
+	void (*f)(void);
+} arena_align_t;
+
+/// A chunk of memory owned by an arena, followed by the data
+typedef struct arena_chunk_t arena_chunk_t;
+struct arena_chunk_t {
+	
+	/// The previously allocated chunk, or NULL if none
+	arena_chunk_t *next;
+	
+	/// The number of bytes of data in this chunk
+	size_t size;
+	
+	/// The number of bytes of data used
+	size_t used;
+	
+	/// Forces the alignment of the data following the header
+	arena_align_t align[1];
+};
+
+struct cpi_arena_t {
+	
+	/// The chunk being allocated from, linked to the previous chunks
+	arena_chunk_t *chunks;
+	
+	/// The size of the next chunk to be allocated
+	size_t next_size;
+};
+
+/// A list or hash node of a node pool, or a link between free nodes
+typedef union node_cell_t node_cell_t;
+union node_cell_t {
+	
+	/// A list node
+	lnode_t lnode;
+	
+	/// A hash node
+	hnode_t hnode;
+	
+	/// The next free cell
+	node_cell_t *next_free;
+};
+
+/// A block of cells allocated by a node pool
+typedef struct node_slab_t node_slab_t;
+struct node_slab_t {
+	
+	/// The previously allocated slab, or NULL if none
+	node_slab_t *next;
+	
+	/// The cells
+	node_cell_t cells[1];
+};
+
+struct cpi_node_pool_t {
+	
+	/// The slabs allocated by the pool
+	node_slab_t *slabs;
+	
+	/// The free cells
+	node_cell_t *free_cells;
+	
+	/// The number of cells in the next slab
+	unsigned int next_cells;
+	
+	/// The number of cells in use
+	unsigned long used;
+};
+
+/// An interned string
+typedef struct strpool_entry_t {
+	
+	/// The number of references to the string
+	unsigned int refs;
+	
+	/// The string data
+	char str[1];
+} strpool_entry_t;
+
+struct cpi_strpool_t {
+	
+	/// Maps strings to entries
+	hash_t *strings;
+};
+
+/// The size of the header of a chunk
+#define ARENA_CHUNK_HEADER offsetof(arena_chunk_t, align)
+
+/// The largest chunk size used for small allocations
+#define ARENA_MAX_CHUNK_SIZE 65536
+
+/// The number of cells in the first slab of a node pool
+#define NODE_POOL_INIT_CELLS 32
+
+/// The largest number of cells in a slab of a node pool
+#define NODE_POOL_MAX_CELLS 1024
+
+/// The size above which a pointer set is indexed
+#define PTRSET_INDEX_THRESHOLD 8
+
+
 /* ------------------------------------------------------------------------
  * Function definitions
  * ----------------------------------------------------------------------*/
@@ -52,42 +173,294 @@ CP_HIDDEN hash_val_t cpi_hashfunc_ptr(const void *ptr) {
 	return (hash_val_t) ptr;
 }
 
-CP_HIDDEN int cpi_ptrset_add(list_t *set, void *ptr) {
+CP_HIDDEN cpi_node_pool_t *cpi_create_node_pool(void) {
+	cpi_node_pool_t *pool;
 	
+	if ((pool = malloc(sizeof(cpi_node_pool_t))) == NULL) {
+		return NULL;
+	}
+	pool->slabs = NULL;
+	pool->free_cells = NULL;
+	pool->next_cells = NODE_POOL_INIT_CELLS;
+	pool->used = 0;
+	return pool;
+}
 
-	// Only add the pointer if it is not already included 
-	if (cpi_ptrset_contains(set, ptr)) {
-		return 1;
+/**
+ * Takes a free cell from a node pool, allocating a new slab of cells if
+ * there are no free cells.
+ * 
+ * @param pool the node pool
+ * @return the cell or NULL if insufficient memory
+ */
+static node_cell_t *alloc_cell(cpi_node_pool_t *pool) {
+	node_cell_t *cell;
+	
+	if (pool->free_cells == NULL) {
+		node_slab_t *slab;
+		unsigned int i;
+		
+		if ((slab = malloc(offsetof(node_slab_t, cells) + pool->next_cells * sizeof(node_cell_t))) == NULL) {
+			return NULL;
+		}
+		slab->next = pool->slabs;
+		pool->slabs = slab;
+		for (i = pool->next_cells; i > 0; i--) {
+			slab->cells[i - 1].next_free = pool->free_cells;
+			pool->free_cells = slab->cells + i - 1;
+		}
+		if (pool->next_cells < NODE_POOL_MAX_CELLS) {
+			pool->next_cells *= 2;
+		}
+	}
+	cell = pool->free_cells;
+	pool->free_cells = cell->next_free;
+	pool->used++;
+	return cell;
+}
+
+/**
+ * Returns a cell to the free cells of a node pool.
+ * 
+ * @param pool the node pool
+ * @param cell the cell
+ */
+static void free_cell(cpi_node_pool_t *pool, node_cell_t *cell) {
+	assert(pool->used > 0);
+	cell->next_free = pool->free_cells;
+	pool->free_cells = cell;
+	pool->used--;
+}
+
+CP_HIDDEN lnode_t *cpi_create_lnode(cpi_node_pool_t *pool, void *data) {
+	node_cell_t *cell;
+	
+	if (pool == NULL) {
+		return lnode_create(data);
+	}
+	if ((cell = alloc_cell(pool)) == NULL) {
+		return NULL;
+	}
+	return lnode_init(&(cell->lnode), data);
+}
+
+CP_HIDDEN void cpi_destroy_lnode(cpi_node_pool_t *pool, lnode_t *node) {
+	if (pool == NULL) {
+		lnode_destroy(node);
 	} else {
-		lnode_t *node;
+		assert(!lnode_is_in_a_list(node));
+		free_cell(pool, (node_cell_t *) node);
+	}
+}
 
-		/* Add the pointer to the list */		
-		node = lnode_create(ptr);
-		if (node == NULL) {
-			return 0;
+CP_HIDDEN hnode_t *cpi_alloc_hnode(void *pool) {
+	node_cell_t *cell;
+	
+	if ((cell = alloc_cell(pool)) == NULL) {
+		return NULL;
+	}
+	return &(cell->hnode);
+}
+
+CP_HIDDEN void cpi_free_hnode(hnode_t *node, void *pool) {
+	free_cell(pool, (node_cell_t *) node);
+}
+
+CP_HIDDEN hash_t *cpi_create_pooled_hash(cpi_node_pool_t *pool, hashcount_t maxcount, hash_comp_t compfun, hash_fun_t hashfun) {
+	hash_t *hash;
+	
+	if ((hash = hash_create(maxcount, compfun, hashfun)) != NULL && pool != NULL) {
+		hash_set_allocator(hash, cpi_alloc_hnode, cpi_free_hnode, pool);
+	}
+	return hash;
+}
+
+CP_HIDDEN void cpi_destroy_node_pool(cpi_node_pool_t *pool) {
+	node_slab_t *slab = pool->slabs;
+	
+	assert(pool->used == 0);
+	while (slab != NULL) {
+		node_slab_t *next = slab->next;
+		free(slab);
+		slab = next;
+	}
+	free(pool);
+}
+
+CP_HIDDEN cpi_ptrset_t *cpi_create_ptrset(void) {
+	cpi_ptrset_t *set;
+	
+	if ((set = malloc(sizeof(cpi_ptrset_t))) == NULL) {
+		return NULL;
+	}
+	list_init(&(set->list), LISTCOUNT_T_MAX);
+	set->index = NULL;
+	return set;
+}
+
+CP_HIDDEN void cpi_destroy_ptrset(cpi_ptrset_t *set) {
+	assert(list_isempty(&(set->list)));
+	if (set->index != NULL) {
+		hash_destroy(set->index);
+	}
+	free(set);
+}
+
+/**
+ * Discards the index of a pointer set.
+ * 
+ * @param set the set
+ */
+static void discard_ptrset_index(cpi_ptrset_t *set) {
+	hash_free_nodes(set->index);
+	hash_destroy(set->index);
+	set->index = NULL;
+}
+
+CP_HIDDEN void cpi_ptrset_append_node(cpi_node_pool_t *pool, cpi_ptrset_t *set, lnode_t *node) {
+	list_append(&(set->list), node);
+	
+	// Update the index, or build it once the set is no longer small
+	if (set->index != NULL) {
+		if (!hash_alloc_insert(set->index, lnode_get(node), node)) {
+			discard_ptrset_index(set);
+		}
+	} else if (list_count(&(set->list)) > PTRSET_INDEX_THRESHOLD
+		&& (set->index = cpi_create_pooled_hash(pool, HASHCOUNT_T_MAX, cpi_comp_ptr, cpi_hashfunc_ptr)) != NULL) {
+		lnode_t *n;
+		
+		for (n = list_first(&(set->list)); n != NULL; n = list_next(&(set->list), n)) {
+			if (!hash_alloc_insert(set->index, lnode_get(n), n)) {
+				discard_ptrset_index(set);
+				break;
+			}
 		}
-		list_append(set, node);
+	}
+}
+
+CP_HIDDEN void cpi_ptrset_delete_node(cpi_ptrset_t *set, lnode_t *node) {
+	if (set->index != NULL) {
+		hnode_t *hnode = hash_lookup(set->index, lnode_get(node));
+		
+		assert(hnode != NULL && hnode_get(hnode) == node);
+		hash_delete_free(set->index, hnode);
+	}
+	list_delete(&(set->list), node);
+}
+
+/**
+ * Returns the list node of a pointer in a pointer set.
+ * 
+ * @param set the set
+ * @param ptr the pointer
+ * @return the list node or NULL if not included
+ */
+static lnode_t *find_ptrset_node(cpi_ptrset_t *set, const void *ptr) {
+	if (set->index != NULL) {
+		hnode_t *hnode = hash_lookup(set->index, ptr);
+		
+		return (hnode != NULL ? hnode_get(hnode) : NULL);
+	}
+	return list_find(&(set->list), ptr, cpi_comp_ptr);
+}
+
+CP_HIDDEN int cpi_ptrset_add(cpi_node_pool_t *pool, cpi_ptrset_t *set, void *ptr) {
+	lnode_t *node;
+	
+	// Only add the pointer if it is not already included 
+	if (find_ptrset_node(set, ptr) != NULL) {
 		return 1;
 	}
 	
+	// Add the pointer to the set
+	if ((node = cpi_create_lnode(pool, ptr)) == NULL) {
+		return 0;
+	}
+	cpi_ptrset_append_node(pool, set, node);
+	return 1;
 }
 
-CP_HIDDEN int cpi_ptrset_remove(list_t *set, const void *ptr) {
+CP_HIDDEN int cpi_ptrset_remove(cpi_node_pool_t *pool, cpi_ptrset_t *set, const void *ptr) {
 	lnode_t *node;
 	
 	// Find the pointer if it is in the set 
-	node = list_find(set, ptr, cpi_comp_ptr);
-	if (node != NULL) {
-		list_delete(set, node);
-		lnode_destroy(node);
-		return 1;
-	} else {
+	if ((node = find_ptrset_node(set, ptr)) == NULL) {
 		return 0;
 	}
+	cpi_ptrset_delete_node(set, node);
+	cpi_destroy_lnode(pool, node);
+	return 1;
+}
+
+CP_HIDDEN int cpi_ptrset_contains(cpi_ptrset_t *set, const void *ptr) {
+	return find_ptrset_node(set, ptr) != NULL;
+}
+
+CP_HIDDEN cpi_ptrvec_t *cpi_create_ptrvec(void) {
+	cpi_ptrvec_t *vec;
+	
+	if ((vec = malloc(sizeof(cpi_ptrvec_t))) != NULL) {
+		memset(vec, 0, sizeof(cpi_ptrvec_t));
+	}
+	return vec;
+}
+
+CP_HIDDEN void cpi_destroy_ptrvec(cpi_ptrvec_t *vec) {
+	free(vec->ptrs);
+	free(vec->slot_refs);
+	free(vec);
+}
+
+CP_HIDDEN int cpi_ptrvec_append(cpi_ptrvec_t *vec, void *ptr, int *slot_ref) {
+	if (vec->num_slots == vec->size) {
+		int size = (vec->size > 0 ? vec->size * 2 : 4);
+		void **ptrs;
+		int **slot_refs;
+		
+		if ((ptrs = realloc(vec->ptrs, size * sizeof(void *))) == NULL) {
+			return 0;
+		}
+		vec->ptrs = ptrs;
+		if ((slot_refs = realloc(vec->slot_refs, size * sizeof(int *))) == NULL) {
+			return 0;
+		}
+		vec->slot_refs = slot_refs;
+		vec->size = size;
+	}
+	vec->ptrs[vec->num_slots] = ptr;
+	vec->slot_refs[vec->num_slots] = slot_ref;
+	*slot_ref = vec->num_slots;
+	vec->num_slots++;
+	vec->count++;
+	return 1;
 }
 
-CP_HIDDEN int cpi_ptrset_contains(list_t *set, const void *ptr) {
-	return list_find(set, ptr, cpi_comp_ptr) != NULL;
+CP_HIDDEN void cpi_ptrvec_remove(cpi_ptrvec_t *vec, int slot) {
+	assert(slot >= 0 && slot < vec->num_slots);
+	assert(vec->ptrs[slot] != NULL);
+	vec->ptrs[slot] = NULL;
+	vec->slot_refs[slot] = NULL;
+	vec->count--;
+	
+	// Drop trailing empty slots right away
+	while (vec->num_slots > 0 && vec->ptrs[vec->num_slots - 1] == NULL) {
+		vec->num_slots--;
+	}
+	
+	// Compact the array once more than half of the slots are empty
+	if (vec->count * 2 < vec->num_slots) {
+		int i, n;
+		
+		for (i = 0, n = 0; i < vec->num_slots; i++) {
+			if (vec->ptrs[i] != NULL) {
+				vec->ptrs[n] = vec->ptrs[i];
+				vec->slot_refs[n] = vec->slot_refs[i];
+				*(vec->slot_refs[n]) = n;
+				n++;
+			}
+		}
+		vec->num_slots = n;
+	}
 }
 
 CP_HIDDEN void cpi_process_free_ptr(list_t *list, lnode_t *node, void *dummy) {
@@ -97,6 +470,185 @@ CP_HIDDEN void cpi_process_free_ptr(list_t *list, lnode_t *node, void *dummy) {
 	free(ptr);
 }
 
+static arena_chunk_t *arena_add_chunk(cpi_arena_t *arena, size_t size) {
+	arena_chunk_t *chunk;
+	
+	if ((chunk = malloc(ARENA_CHUNK_HEADER + size)) == NULL) {
+		return NULL;
+	}
+	chunk->size = size;
+	chunk->used = 0;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	return chunk;
+}
+
+CP_HIDDEN cpi_arena_t *cpi_create_arena(size_t chunk_size) {
+	cpi_arena_t tmp;
+	cpi_arena_t *arena;
+	
+	if (chunk_size < 2 * sizeof(cpi_arena_t)) {
+		chunk_size = 2 * sizeof(cpi_arena_t);
+	}
+	tmp.chunks = NULL;
+	tmp.next_size = chunk_size;
+	if (arena_add_chunk(&tmp, chunk_size) == NULL) {
+		return NULL;
+	}
+	if ((arena = cpi_arena_alloc(&tmp, sizeof(cpi_arena_t))) == NULL) {
+		free(tmp.chunks);
+		return NULL;
+	}
+	*arena = tmp;
+	return arena;
+}
+
+CP_HIDDEN void *cpi_arena_alloc(cpi_arena_t *arena, size_t size) {
+	arena_chunk_t *chunk = arena->chunks;
+	void *ptr;
+	
+	// Round up to keep the following allocations aligned
+	size = (size + sizeof(arena_align_t) - 1) / sizeof(arena_align_t) * sizeof(arena_align_t);
+	
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		
+		// Large allocations get a chunk of their own behind the current one
+		if (size > arena->next_size / 2) {
+			arena_chunk_t *large;
+			
+			if ((large = malloc(ARENA_CHUNK_HEADER + size)) == NULL) {
+				return NULL;
+			}
+			large->size = size;
+			large->used = size;
+			if (chunk != NULL) {
+				large->next = chunk->next;
+				chunk->next = large;
+			} else {
+				large->next = NULL;
+				arena->chunks = large;
+			}
+			return ((char *) large) + ARENA_CHUNK_HEADER;
+		}
+		
+		if (arena->next_size < ARENA_MAX_CHUNK_SIZE) {
+			arena->next_size *= 2;
+		}
+		if ((chunk = arena_add_chunk(arena, arena->next_size)) == NULL) {
+			return NULL;
+		}
+	}
+	ptr = ((char *) chunk) + ARENA_CHUNK_HEADER + chunk->used;
+	chunk->used += size;
+	return ptr;
+}
+
+CP_HIDDEN void *cpi_arena_memdup(cpi_arena_t *arena, const void *src, size_t size) {
+	void *ptr;
+	
+	if ((ptr = cpi_arena_alloc(arena, size)) != NULL) {
+		memcpy(ptr, src, size);
+	}
+	return ptr;
+}
+
+CP_HIDDEN void cpi_destroy_arena(cpi_arena_t *arena) {
+	arena_chunk_t *chunk = arena->chunks;
+	
+	// The arena itself lives in the last chunk of the list
+	while (chunk != NULL) {
+		arena_chunk_t *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+}
+
+CP_HIDDEN size_t cpi_arena_size(const cpi_arena_t *arena) {
+	const arena_chunk_t *chunk;
+	size_t size = 0;
+	
+	for (chunk = arena->chunks; chunk != NULL; chunk = chunk->next) {
+		size += ARENA_CHUNK_HEADER + chunk->size;
+	}
+	return size;
+}
+
+CP_HIDDEN cpi_strpool_t *cpi_create_strpool(void) {
+	cpi_strpool_t *pool;
+	
+	if ((pool = malloc(sizeof(cpi_strpool_t))) == NULL) {
+		return NULL;
+	}
+	if ((pool->strings = hash_create(HASHCOUNT_T_MAX, (int (*)(const void *, const void *)) strcmp, NULL)) == NULL) {
+		free(pool);
+		return NULL;
+	}
+	return pool;
+}
+
+CP_HIDDEN const char *cpi_intern_string(cpi_strpool_t *pool, const char *str) {
+	hnode_t *node;
+	strpool_entry_t *entry;
+	
+	if ((node = hash_lookup(pool->strings, str)) != NULL) {
+		entry = hnode_get(node);
+	} else {
+		if ((entry = malloc(offsetof(strpool_entry_t, str) + (strlen(str) + 1) * sizeof(char))) == NULL) {
+			return NULL;
+		}
+		strcpy(entry->str, str);
+		entry->refs = 0;
+		if (!hash_alloc_insert(pool->strings, entry->str, entry)) {
+			free(entry);
+			return NULL;
+		}
+	}
+	entry->refs++;
+	return entry->str;
+}
+
+CP_HIDDEN int cpi_comp_interned(const void *str1, const void *str2) {
+	return str1 != str2 && strcmp(str1, str2);
+}
+
+CP_HIDDEN void cpi_release_string(cpi_strpool_t *pool, const char *str) {
+	hnode_t *node;
+	strpool_entry_t *entry;
+	
+	node = hash_lookup(pool->strings, str);
+	assert(node != NULL && hnode_getkey(node) == str);
+	entry = hnode_get(node);
+	assert(entry->refs > 0);
+	if (--entry->refs == 0) {
+		hash_delete_free(pool->strings, node);
+		free(entry);
+	}
+}
+
+CP_HIDDEN void cpi_reserve_strings(cpi_strpool_t *pool, unsigned int count) {
+	hash_reserve(pool->strings, count);
+}
+
+CP_HIDDEN void cpi_destroy_strpool(cpi_strpool_t *pool) {
+	assert(hash_isempty(pool->strings));
+	hash_destroy(pool->strings);
+	free(pool);
+}
+
+/**
+ * A version string split into components. Each component consists of the
+ * length of its non-digit prefix, the values of the non-digit characters
+ * and the numerical value of the following digits.
+ */
+struct cpi_version_t {
+	
+	/// The number of values
+	int num_values;
+	
+	/// The values of the components
+	int values[1];
+};
+
 static const char *vercmp_nondigit_end(const char *v) {
 	while (*v != '\0' && (*v < '0' || *v > '9')) {
 		v++;
@@ -213,3 +765,127 @@ CP_HIDDEN int cpi_vercmp(const char *v1, const char *v2) {
 	}
 	return 0;
 }
+
+CP_HIDDEN cpi_version_t *cpi_tokenize_version(cpi_arena_t *arena, const char *v) {
+	cpi_version_t *version;
+	const char *vn;
+	const char *p;
+	int n = 0;
+	
+	// Count the values
+	for (p = v; *p != '\0'; p = vercmp_digit_end(vn)) {
+		vn = vercmp_nondigit_end(p);
+		n += (vn - p) + 2;
+	}
+	if ((version = cpi_arena_alloc(arena, offsetof(cpi_version_t, values) + (n > 0 ? n : 1) * sizeof(int))) == NULL) {
+		return NULL;
+	}
+	
+	// Store the components
+	version->num_values = 0;
+	for (p = v; *p != '\0'; p = vn) {
+		vn = vercmp_nondigit_end(p);
+		version->values[version->num_values++] = vn - p;
+		while (p < vn) {
+			version->values[version->num_values++] = vercmp_char_value(*p++);
+		}
+		vn = vercmp_digit_end(p);
+		version->values[version->num_values++] = vercmp_num_value(p, vn);
+	}
+	assert(version->num_values == n);
+	return version;
+}
+
+CP_HIDDEN int cpi_vercmp_tokens(const cpi_version_t *v1, const cpi_version_t *v2) {
+	int i1 = 0, i2 = 0;
+	
+	// Check for NULL versions
+	if (v1 == NULL || v2 == NULL) {
+		return (v1 != NULL) - (v2 != NULL);
+	}
+	
+	// Component comparison loop, missing components are empty
+	while (i1 < v1->num_values || i2 < v2->num_values) {
+		int l1 = 0, l2 = 0, n1 = 0, n2 = 0;
+		const int *c1, *c2;
+		int i, diff;
+		
+		if (i1 < v1->num_values) {
+			l1 = v1->values[i1++];
+			c1 = v1->values + i1;
+			i1 += l1;
+			n1 = v1->values[i1++];
+		} else {
+			c1 = NULL;
+		}
+		if (i2 < v2->num_values) {
+			l2 = v2->values[i2++];
+			c2 = v2->values + i2;
+			i2 += l2;
+			n2 = v2->values[i2++];
+		} else {
+			c2 = NULL;
+		}
+		
+		// Compare the non-digit strings and then the numbers
+		for (i = 0; i < l1 || i < l2; i++) {
+			if ((diff = (i < l1 ? c1[i] : 0) - (i < l2 ? c2[i] : 0)) != 0) {
+				return diff;
+			}
+		}
+		if ((diff = n1 - n2) != 0) {
+			return diff;
+		}
+	}
+	return 0;
+}
+
+
+// Hashing
+
+CP_HIDDEN unsigned long cpi_fnv_hash(const void *data, size_t length, unsigned long hash) {
+	const unsigned char *c = data;
+	size_t i;
+
+	for (i = 0; i < length; i++) {
+		hash = ((hash ^ c[i]) * 16777619UL) & 0xffffffffUL;
+	}
+	return hash;
+}
+
+
+// Time
+
+CP_HIDDEN unsigned long long cpi_monotonic_usecs(void) {
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	
+	if (!clock_gettime(CLOCK_MONOTONIC, &ts)) {
+		return (unsigned long long) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+	}
+#endif
+#if defined(HAVE_GETTIMEOFDAY) && defined(HAVE_SYS_TIME_H)
+	{
+		struct timeval tv;
+		
+		gettimeofday(&tv, NULL);
+		return (unsigned long long) tv.tv_sec * 1000000ULL + tv.tv_usec;
+	}
+#else
+	return (unsigned long long) time(NULL) * 1000000ULL;
+#endif
+}
+
+
+// Files
+
+CP_HIDDEN void cpi_prefetch_file(const char *path) {
+#ifdef CP_PREFETCH
+	int fd;
+	
+	if ((fd = open(path, O_RDONLY)) >= 0) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+		close(fd);
+	}
+#endif
+}
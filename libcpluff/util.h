@@ -42,7 +42,76 @@ extern "C" {
  * Function declarations
  * ----------------------------------------------------------------------*/
 
-// For operating on smallish pointer sets implemented as lists 
+// Node pools
+
+/// A pool of list and hash nodes, reusing the memory of released nodes
+typedef struct cpi_node_pool_t cpi_node_pool_t;
+
+/**
+ * Creates a new, empty node pool. The pool is not thread-safe, so the
+ * nodes of a pool must be allocated and released under the same lock.
+ * 
+ * @return the created pool or NULL if insufficient memory
+ */
+CP_HIDDEN cpi_node_pool_t *cpi_create_node_pool(void);
+
+/**
+ * Creates a list node from the specified pool.
+ * 
+ * @param pool the node pool, or NULL to allocate from the heap
+ * @param data the data of the node
+ * @return the created node or NULL if insufficient memory
+ */
+CP_HIDDEN lnode_t *cpi_create_lnode(cpi_node_pool_t *pool, void *data);
+
+/**
+ * Returns a list node created using ::cpi_create_lnode to its pool. The
+ * node must not be in a list.
+ * 
+ * @param pool the node pool the node was created from, or NULL
+ * @param node the node
+ */
+CP_HIDDEN void cpi_destroy_lnode(cpi_node_pool_t *pool, lnode_t *node) CP_GCC_NONNULL(2);
+
+/**
+ * Allocates a hash node from a node pool. This function and
+ * ::cpi_free_hnode are used as the node allocator of hash tables
+ * created using ::cpi_create_pooled_hash.
+ * 
+ * @param pool the node pool
+ * @return the allocated node or NULL if insufficient memory
+ */
+CP_HIDDEN hnode_t *cpi_alloc_hnode(void *pool) CP_GCC_NONNULL(1);
+
+/**
+ * Returns a hash node allocated using ::cpi_alloc_hnode to its pool.
+ * 
+ * @param node the node
+ * @param pool the node pool
+ */
+CP_HIDDEN void cpi_free_hnode(hnode_t *node, void *pool) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Creates a dynamic hash table allocating its nodes from the specified
+ * pool. The arguments are as for hash_create.
+ * 
+ * @param pool the node pool, or NULL to allocate nodes from the heap
+ * @param maxcount the maximum number of nodes
+ * @param compfun the key comparison function
+ * @param hashfun the hash function, or NULL for string keys
+ * @return the created hash table or NULL if insufficient memory
+ */
+CP_HIDDEN hash_t *cpi_create_pooled_hash(cpi_node_pool_t *pool, hashcount_t maxcount, hash_comp_t compfun, hash_fun_t hashfun);
+
+/**
+ * Destroys the specified node pool. All the nodes must have been returned.
+ * 
+ * @param pool the node pool
+ */
+CP_HIDDEN void cpi_destroy_node_pool(cpi_node_pool_t *pool) CP_GCC_NONNULL(1);
+
+
+// Pointer sets keeping insertion order
 
 /**
  * Compares pointers.
@@ -61,23 +130,70 @@ CP_HIDDEN int cpi_comp_ptr(const void *ptr1, const void *ptr2) CP_GCC_CONST;
  */
 CP_HIDDEN hash_val_t cpi_hashfunc_ptr(const void *ptr) CP_GCC_CONST;
 
+/// A set of pointers keeping insertion order
+typedef struct cpi_ptrset_t {
+	
+	/// The pointers in insertion order, as list node data
+	list_t list;
+	
+	/// Maps pointers to their list nodes, or NULL while the set is small
+	hash_t *index;
+	
+} cpi_ptrset_t;
+
+/**
+ * Creates a new, empty pointer set.
+ * 
+ * @return the created set or NULL if insufficient memory
+ */
+CP_HIDDEN cpi_ptrset_t *cpi_create_ptrset(void);
+
+/**
+ * Destroys an empty pointer set.
+ * 
+ * @param set the set to be destroyed
+ */
+CP_HIDDEN void cpi_destroy_ptrset(cpi_ptrset_t *set) CP_GCC_NONNULL(1);
+
+/**
+ * Appends a list node to a pointer set. The data of the node must not be
+ * included in the set yet. This function never fails. If the index can
+ * not be updated due to insufficient memory then it is discarded and
+ * membership checks fall back to searching the list.
+ * 
+ * @param pool the node pool of the set, or NULL
+ * @param set the set being operated on
+ * @param node the node being appended
+ */
+CP_HIDDEN void cpi_ptrset_append_node(cpi_node_pool_t *pool, cpi_ptrset_t *set, lnode_t *node) CP_GCC_NONNULL(2, 3);
+
 /**
- * Adds a new pointer to a list if the pointer is not yet included.
+ * Deletes a list node from a pointer set without destroying it.
  * 
  * @param set the set being operated on
+ * @param node the node being deleted
+ */
+CP_HIDDEN void cpi_ptrset_delete_node(cpi_ptrset_t *set, lnode_t *node) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Adds a new pointer to a set if the pointer is not yet included.
+ * 
+ * @param pool the node pool of the set, or NULL
+ * @param set the set being operated on
  * @param ptr the pointer being added
  * @return non-zero if the operation was successful, zero if allocation failed
  */
-CP_HIDDEN int cpi_ptrset_add(list_t *set, void *ptr);
+CP_HIDDEN int cpi_ptrset_add(cpi_node_pool_t *pool, cpi_ptrset_t *set, void *ptr);
 
 /**
  * Removes a pointer from a pointer set, if it is included.
  * 
+ * @param pool the node pool of the set, or NULL
  * @param set the set being operated on
  * @param ptr the pointer being removed
  * @return whether the pointer was contained in the set
  */
-CP_HIDDEN int cpi_ptrset_remove(list_t *set, const void *ptr);
+CP_HIDDEN int cpi_ptrset_remove(cpi_node_pool_t *pool, cpi_ptrset_t *set, const void *ptr);
 
 /**
  * Returns whether a pointer is included in a pointer set.
@@ -86,7 +202,65 @@ CP_HIDDEN int cpi_ptrset_remove(list_t *set, const void *ptr);
  * @param ptr the pointer
  * @return non-zero if the pointer is included, zero otherwise
  */
-CP_HIDDEN int cpi_ptrset_contains(list_t *set, const void *ptr) CP_GCC_PURE;
+CP_HIDDEN int cpi_ptrset_contains(cpi_ptrset_t *set, const void *ptr) CP_GCC_PURE;
+
+
+/// A contiguous array of pointers keeping insertion order
+typedef struct cpi_ptrvec_t {
+	
+	/// The pointers in insertion order, NULL for removed pointers
+	void **ptrs;
+	
+	/// For each slot, the location where the slot index is maintained
+	int **slot_refs;
+	
+	/// The number of used slots, including the removed pointers
+	int num_slots;
+	
+	/// The number of allocated slots
+	int size;
+	
+	/// The number of pointers
+	int count;
+	
+} cpi_ptrvec_t;
+
+/**
+ * Creates a new, empty pointer array.
+ * 
+ * @return the created array or NULL if insufficient memory
+ */
+CP_HIDDEN cpi_ptrvec_t *cpi_create_ptrvec(void);
+
+/**
+ * Destroys a pointer array.
+ * 
+ * @param vec the array to be destroyed
+ */
+CP_HIDDEN void cpi_destroy_ptrvec(cpi_ptrvec_t *vec) CP_GCC_NONNULL(1);
+
+/**
+ * Appends a pointer to a pointer array. The slot index of the pointer is
+ * stored into the specified location and it is kept up to date when the
+ * array is compacted, so the location must remain valid until the
+ * pointer is removed.
+ * 
+ * @param vec the array being operated on
+ * @param ptr the non-NULL pointer being appended
+ * @param slot_ref the location where the slot index is maintained
+ * @return non-zero if the operation was successful, zero if allocation failed
+ */
+CP_HIDDEN int cpi_ptrvec_append(cpi_ptrvec_t *vec, void *ptr, int *slot_ref) CP_GCC_NONNULL(1, 2, 3);
+
+/**
+ * Removes the pointer at the specified slot in constant amortized time.
+ * The removed slot is left empty and the array is compacted once most of
+ * the slots are empty, so the order of the remaining pointers is kept.
+ * 
+ * @param vec the array being operated on
+ * @param slot the slot index of the pointer being removed
+ */
+CP_HIDDEN void cpi_ptrvec_remove(cpi_ptrvec_t *vec, int slot) CP_GCC_NONNULL(1);
 
 
 // Other list processing utility functions 
@@ -102,6 +276,124 @@ CP_HIDDEN int cpi_ptrset_contains(list_t *set, const void *ptr) CP_GCC_PURE;
 CP_HIDDEN void cpi_process_free_ptr(list_t *list, lnode_t *node, void *dummy);
 
 
+// Memory arenas
+
+/// A memory arena releasing all its allocations at once
+typedef struct cpi_arena_t cpi_arena_t;
+
+/**
+ * Creates a new memory arena. The arena itself is allocated from its first
+ * chunk of memory.
+ * 
+ * @param chunk_size the size of the first chunk of memory, in bytes
+ * @return the created arena or NULL if insufficient memory
+ */
+CP_HIDDEN cpi_arena_t *cpi_create_arena(size_t chunk_size);
+
+/**
+ * Allocates memory from the specified arena. The returned memory is
+ * suitably aligned for any type and it is not initialized. The memory is
+ * released when the arena is destroyed.
+ * 
+ * @param arena the arena
+ * @param size the number of bytes to allocate
+ * @return pointer to the allocated memory, or NULL if insufficient memory
+ */
+CP_HIDDEN void *cpi_arena_alloc(cpi_arena_t *arena, size_t size) CP_GCC_NONNULL(1);
+
+/**
+ * Allocates a copy of the specified memory block from the specified arena.
+ * 
+ * @param arena the arena
+ * @param src the data to be copied
+ * @param size the number of bytes to copy
+ * @return pointer to the copy, or NULL if insufficient memory
+ */
+CP_HIDDEN void *cpi_arena_memdup(cpi_arena_t *arena, const void *src, size_t size) CP_GCC_NONNULL(1);
+
+/**
+ * Destroys the specified arena and releases all memory allocated from it.
+ * 
+ * @param arena the arena
+ */
+CP_HIDDEN void cpi_destroy_arena(cpi_arena_t *arena) CP_GCC_NONNULL(1);
+
+/**
+ * Returns the memory allocated for the specified arena, in bytes,
+ * including the unused space of its chunks.
+ * 
+ * @param arena the arena
+ * @return the allocated size
+ */
+CP_HIDDEN size_t cpi_arena_size(const cpi_arena_t *arena) CP_GCC_NONNULL(1);
+
+
+// String pools
+
+/// A reference counted pool of interned strings
+typedef struct cpi_strpool_t cpi_strpool_t;
+
+/**
+ * Creates a new, empty string pool.
+ * 
+ * @return the created pool or NULL if insufficient memory
+ */
+CP_HIDDEN cpi_strpool_t *cpi_create_strpool(void);
+
+/**
+ * Returns the interned copy of the specified string and increases its
+ * reference count. The string is added to the pool if not already present.
+ * Identical interned strings of the same pool are the same pointer and can
+ * be compared using ::cpi_comp_ptr.
+ * 
+ * @param pool the string pool
+ * @param str the string to be interned
+ * @return the interned string, or NULL if insufficient memory
+ */
+CP_HIDDEN const char *cpi_intern_string(cpi_strpool_t *pool, const char *str) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Compares a key of a map keyed by interned strings with a lookup key,
+ * which need not be interned. Interned keys equal to the lookup key by
+ * pointer are matched without comparing the contents. Maps keyed by
+ * interned strings use this comparison function together with the default
+ * string hash function, so that looking up a key takes one hash lookup.
+ * 
+ * @param str1 the first string
+ * @param str2 the second string
+ * @return zero if the strings are equal, non-zero otherwise
+ */
+CP_HIDDEN int cpi_comp_interned(const void *str1, const void *str2) CP_GCC_PURE;
+
+/**
+ * Decreases the reference count of an interned string obtained using
+ * ::cpi_intern_string and removes the string from the pool when the
+ * count drops to zero.
+ * 
+ * @param pool the string pool
+ * @param str the interned string
+ */
+CP_HIDDEN void cpi_release_string(cpi_strpool_t *pool, const char *str) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Makes room for the specified number of additional strings so that
+ * interning them does not grow the pool. Failure to make room is not an
+ * error because the pool still grows on demand.
+ * 
+ * @param pool the string pool
+ * @param count the number of strings to be interned
+ */
+CP_HIDDEN void cpi_reserve_strings(cpi_strpool_t *pool, unsigned int count) CP_GCC_NONNULL(1);
+
+/**
+ * Destroys the specified string pool. All the strings must have been
+ * released.
+ * 
+ * @param pool the string pool
+ */
+CP_HIDDEN void cpi_destroy_strpool(cpi_strpool_t *pool) CP_GCC_NONNULL(1);
+
+
 // Version strings
 
 /**
@@ -123,6 +415,74 @@ CP_HIDDEN void cpi_process_free_ptr(list_t *list, lnode_t *node, void *dummy);
  */
 CP_HIDDEN int cpi_vercmp(const char *v1, const char *v2) CP_GCC_PURE;
 
+/// A version string split into comparable components
+typedef struct cpi_version_t cpi_version_t;
+
+/**
+ * Splits a version string into the components compared by ::cpi_vercmp
+ * so that the version can be compared repeatedly without parsing it
+ * again. The tokenized version is allocated from the specified arena.
+ * 
+ * @param arena the arena
+ * @param v the version string
+ * @return the tokenized version, or NULL if insufficient memory
+ */
+CP_HIDDEN cpi_version_t *cpi_tokenize_version(cpi_arena_t *arena, const char *v) CP_GCC_NONNULL(1, 2);
+
+/**
+ * Compares two tokenized versions. The result equals the result of
+ * ::cpi_vercmp for the original version strings.
+ * 
+ * @param v1 the first tokenized version to compare or NULL
+ * @param v2 the second tokenized version to compare or NULL
+ * @return less than, equal to or greater than zero when @a v1 < @a v2, @a v1 == @a v2 or @a v1 > @a v2, correspondingly
+ */
+CP_HIDDEN int cpi_vercmp_tokens(const cpi_version_t *v1, const cpi_version_t *v2) CP_GCC_PURE;
+
+
+// Hashing
+
+/// The initial value of an FNV-1a hash
+#define CPI_FNV_INIT 2166136261UL
+
+/**
+ * Continues the 32-bit FNV-1a hash of a byte sequence with the specified
+ * data. The hash of a sequence is computed by passing ::CPI_FNV_INIT as
+ * the initial value and the result of each call to the next. Unlike the
+ * default string hash of the hash tables, FNV-1a values are stable across
+ * releases as required by persisted and documented hash values.
+ * 
+ * @param data the data
+ * @param length the length of the data in bytes
+ * @param hash the hash value so far
+ * @return the hash value
+ */
+CP_HIDDEN unsigned long cpi_fnv_hash(const void *data, size_t length, unsigned long hash) CP_GCC_PURE;
+
+
+// Time
+
+/**
+ * Returns the current time of a monotonic clock in microseconds. Falls back
+ * to the real time clock if no monotonic clock is available. The returned
+ * values are only useful for measuring intervals.
+ * 
+ * @return the current time in microseconds
+ */
+CP_HIDDEN unsigned long long cpi_monotonic_usecs(void);
+
+
+// Files
+
+/**
+ * Advises the operating system that the specified file is about to be
+ * read so that reading it may start in the background. Does nothing if
+ * the file can not be opened or if advising is not supported.
+ * 
+ * @param path the path of the file
+ */
+CP_HIDDEN void cpi_prefetch_file(const char *path) CP_GCC_NONNULL(1);
+
 
 #ifdef __cplusplus
 }
@@ -40,6 +40,7 @@
 #include <cpluffxx/enums.h>
 #include <cpluffxx/callbacks.h>
 #include <cpluffxx/info.h>
+#include <cpluffxx/registry.h>
 
 
 /* ------------------------------------------------------------------------
@@ -214,6 +215,16 @@ public:
 	 */
 	virtual void register_plugin_collection(const char* dir) throw (api_error) = 0;
 
+	/**
+	 * Registers a plug-in collection with this container without throwing
+	 * exceptions. This is like @ref register_plugin_collection but returns
+	 * false on failure.
+	 *
+	 * @param dir the directory
+	 * @return whether the collection was registered
+	 */
+	virtual bool try_register_plugin_collection(const char* dir) throw () = 0;
+
 	/**
 	 * Unregisters a plug-in collection previously registered with this
 	 * plug-in container. Plug-ins already loaded from the collection are not
@@ -246,6 +257,28 @@ public:
 	 */
 	virtual shared_ptr<plugin_info> load_plugin_descriptor(const char* path) throw (api_error) = 0;
 
+	/**
+	 * Loads a plug-in descriptor like @ref load_plugin_descriptor but returns
+	 * the plug-in information handle by value instead of allocating a
+	 * shared pointer for it. The plug-in information is automatically
+	 * released when there are no more copies of the returned handle left.
+	 * 
+	 * @param path the installation path of the plug-in
+	 * @return the plug-in information
+	 * @throw cp_api_error if loading fails or the plug-in descriptor is malformed
+	 */
+	virtual plugin_info load_plugin_info(const char* path) throw (api_error) = 0;
+
+	/**
+	 * Loads a plug-in descriptor without throwing exceptions. This is
+	 * like @ref load_plugin_descriptor but a failure is reported as part of
+	 * the returned result.
+	 *
+	 * @param path the installation path of the plug-in
+	 * @return the plug-in information or the error which made loading fail
+	 */
+	virtual result<plugin_info> try_load_plugin_descriptor(const char* path) throw () = 0;
+
 protected:
 
 	/** @internal */
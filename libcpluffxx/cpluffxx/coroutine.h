@@ -0,0 +1,381 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file 
+ * Declares support for running C++20 coroutines as plug-in run tasks.
+ * This header is not included by cpluffxx.h and it is only effective when
+ * compiled as C++20 or later with coroutine support. The declarations are
+ * header-only so plug-ins do not need a C++20 build of the C++ library.
+ */
+
+#ifndef CPLUFFXX_COROUTINE_H_
+#define CPLUFFXX_COROUTINE_H_
+
+#if defined(__cpp_impl_coroutine) && __cplusplus >= 202002L
+
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <cpluff.h>
+
+namespace cpluff {
+
+/**
+ * The return type of a coroutine to be run as a plug-in run task. The
+ * coroutine does not start executing until it is scheduled using
+ * run_coroutine and it is then executed by the run functions of the
+ * plug-in context, one step at a time. A step lasts until the coroutine
+ * awaits next_step, plugin_state, sleep_for or readable, or until it
+ * finishes. Exceptions must
+ * not escape the coroutine.
+ */
+class run_task {
+public:
+
+	/** @internal The coroutine promise */
+	class promise_type {
+	public:
+
+		/** @internal What to do after the current step */
+		int next;
+
+		inline run_task get_return_object() noexcept {
+			return run_task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		inline std::suspend_always initial_suspend() noexcept {
+			return std::suspend_always();
+		}
+
+		inline std::suspend_always final_suspend() noexcept {
+			return std::suspend_always();
+		}
+
+		inline void return_void() noexcept {}
+
+		inline void unhandled_exception() noexcept {
+			std::terminate();
+		}
+	};
+
+	/** @internal The coroutine handle type */
+	typedef std::coroutine_handle<promise_type> handle_type;
+
+	inline run_task(run_task&& task) noexcept: handle(task.handle) {
+		task.handle = handle_type();
+	}
+
+	inline run_task& operator=(run_task&& task) noexcept {
+		if (this != &task) {
+			if (handle) {
+				handle.destroy();
+			}
+			handle = task.handle;
+			task.handle = handle_type();
+		}
+		return *this;
+	}
+
+	run_task(const run_task&) = delete;
+	run_task& operator=(const run_task&) = delete;
+
+	/**
+	 * Destroys the coroutine if it has not been scheduled.
+	 */
+	inline ~run_task() {
+		if (handle) {
+			handle.destroy();
+		}
+	}
+
+	/**
+	 * @internal
+	 * Releases the ownership of the coroutine.
+	 *
+	 * @return the coroutine handle
+	 */
+	inline handle_type release() noexcept {
+		handle_type h = handle;
+		handle = handle_type();
+		return h;
+	}
+
+	/**
+	 * @internal
+	 * Executes one step of a coroutine.
+	 *
+	 * @param plugin_data the plug-in instance data pointer
+	 * @param task_data the coroutine handle address
+	 * @return the run task result
+	 */
+	static int step(void* plugin_data, void* task_data) {
+		handle_type h = handle_type::from_address(task_data);
+
+		h.promise().next = CP_RUN_AGAIN;
+		h.resume();
+		if (h.done()) {
+			h.destroy();
+			return CP_RUN_DONE;
+		}
+		return h.promise().next;
+	}
+
+	/**
+	 * @internal
+	 * Destroys a coroutine discarded due to the plug-in being stopped.
+	 *
+	 * @param task_data the coroutine handle address
+	 */
+	static void discard(void* task_data) {
+		handle_type::from_address(task_data).destroy();
+	}
+
+private:
+
+	inline explicit run_task(handle_type handle) noexcept: handle(handle) {}
+
+	/** @internal The owned coroutine or an empty handle */
+	handle_type handle;
+};
+
+/**
+ * Schedules a coroutine to be run as a run task of the calling plug-in.
+ * The coroutine is destroyed when it finishes or when the plug-in is
+ * stopped. Run tasks are executed by ::cp_run_plugins and related
+ * functions.
+ *
+ * @param ctx the plug-in context of the calling plug-in
+ * @param task the coroutine to be scheduled
+ * @return @ref CP_OK (zero) on success or an error code on failure
+ */
+inline cp_status_t run_coroutine(cp_context_t* ctx, run_task task) noexcept {
+	run_task::handle_type h = task.release();
+	cp_status_t status = cp_run_task(ctx, run_task::step, run_task::discard, h.address());
+
+	if (status != CP_OK) {
+		h.destroy();
+	}
+	return status;
+}
+
+/**
+ * An awaitable ending the current step of a run task coroutine. The
+ * coroutine is queued again and it continues when its turn comes.
+ */
+class next_step {
+public:
+
+	inline bool await_ready() const noexcept {
+		return false;
+	}
+
+	inline void await_suspend(run_task::handle_type h) const noexcept {
+		h.promise().next = CP_RUN_AGAIN;
+	}
+
+	inline void await_resume() const noexcept {}
+};
+
+/**
+ * An awaitable suspending a run task coroutine for the specified delay.
+ * The coroutine does not occupy the run queue while sleeping. The result
+ * of awaiting tells whether the coroutine actually slept; it is false if
+ * the wait could not be scheduled.
+ */
+class sleep_for {
+public:
+
+	/**
+	 * Constructs a new awaitable.
+	 *
+	 * @param ctx the plug-in context of the calling plug-in
+	 * @param delay_ms the delay in milliseconds
+	 */
+	inline sleep_for(cp_context_t* ctx, unsigned long delay_ms) noexcept:
+	ctx(ctx), delay_ms(delay_ms), scheduled(false) {}
+
+	inline bool await_ready() const noexcept {
+		return false;
+	}
+
+	inline bool await_suspend(run_task::handle_type h) noexcept {
+		if (cp_resume_task_at(ctx, run_task::step, h.address(), delay_ms) != CP_OK) {
+			return false;
+		}
+		scheduled = true;
+		h.promise().next = CP_RUN_SUSPEND;
+		return true;
+	}
+
+	inline bool await_resume() const noexcept {
+		return scheduled;
+	}
+
+private:
+
+	/** @internal The plug-in context */
+	cp_context_t* ctx;
+
+	/** @internal The delay in milliseconds */
+	unsigned long delay_ms;
+
+	/** @internal Whether the wake-up was scheduled */
+	bool scheduled;
+};
+
+/**
+ * An awaitable suspending a run task coroutine until a file descriptor
+ * becomes readable. The coroutine does not occupy the run queue while
+ * waiting. The result of awaiting tells whether the coroutine actually
+ * waited; it is false if waiting for file descriptors is not supported.
+ */
+class readable {
+public:
+
+	/**
+	 * Constructs a new awaitable.
+	 *
+	 * @param ctx the plug-in context of the calling plug-in
+	 * @param fd the file descriptor to wait for
+	 */
+	inline readable(cp_context_t* ctx, int fd) noexcept:
+	ctx(ctx), fd(fd), scheduled(false) {}
+
+	inline bool await_ready() const noexcept {
+		return false;
+	}
+
+	inline bool await_suspend(run_task::handle_type h) noexcept {
+		if (cp_resume_task_on_fd(ctx, run_task::step, h.address(), fd) != CP_OK) {
+			return false;
+		}
+		scheduled = true;
+		h.promise().next = CP_RUN_SUSPEND;
+		return true;
+	}
+
+	inline bool await_resume() const noexcept {
+		return scheduled;
+	}
+
+private:
+
+	/** @internal The plug-in context */
+	cp_context_t* ctx;
+
+	/** @internal The file descriptor */
+	int fd;
+
+	/** @internal Whether the wake-up was scheduled */
+	bool scheduled;
+};
+
+/**
+ * An awaitable suspending a run task coroutine until a plug-in enters the
+ * specified state. The coroutine does not occupy the run queue while
+ * waiting. Awaiting completes immediately if the plug-in already is in the
+ * specified state. The result of awaiting tells whether the plug-in is in
+ * the specified state; it is false if the wait could not be set up due to
+ * insufficient resources.
+ */
+class plugin_state {
+public:
+
+	/**
+	 * Constructs a new awaitable.
+	 *
+	 * @param ctx the plug-in context of the calling plug-in
+	 * @param plugin_id the identifier of the plug-in
+	 * @param state the plug-in state to wait for
+	 */
+	inline plugin_state(cp_context_t* ctx, const char* plugin_id, cp_plugin_state_t state):
+	ctx(ctx), plugin_id(plugin_id), state(state), registered(false) {}
+
+	plugin_state(const plugin_state&) = delete;
+	plugin_state& operator=(const plugin_state&) = delete;
+
+	inline ~plugin_state() {
+		unregister();
+	}
+
+	inline bool await_ready() const noexcept {
+		return cp_get_plugin_state(ctx, plugin_id.c_str()) == state;
+	}
+
+	inline bool await_suspend(run_task::handle_type h) noexcept {
+		handle = h;
+		if (cp_register_plistener_filtered(ctx, listener, this, plugin_id.c_str(), 0, CP_STATE_MASK(state)) != CP_OK) {
+			return false;
+		}
+		registered = true;
+
+		// The state may have changed before the listener was registered
+		if (await_ready()) {
+			unregister();
+			return false;
+		}
+		h.promise().next = CP_RUN_SUSPEND;
+		return true;
+	}
+
+	inline bool await_resume() noexcept {
+		unregister();
+		return await_ready();
+	}
+
+private:
+
+	/** @internal The plug-in context */
+	cp_context_t* ctx;
+
+	/** @internal The identifier of the plug-in */
+	std::string plugin_id;
+
+	/** @internal The state being waited for */
+	cp_plugin_state_t state;
+
+	/** @internal Whether the listener is registered */
+	bool registered;
+
+	/** @internal The waiting coroutine */
+	run_task::handle_type handle;
+
+	inline void unregister() noexcept {
+		if (registered) {
+			cp_unregister_plistener_data(ctx, listener, this);
+			registered = false;
+		}
+	}
+
+	static void listener(const char* plugin_id, cp_plugin_state_t old_state, cp_plugin_state_t new_state, void* user_data) {
+		plugin_state* self = static_cast<plugin_state*>(user_data);
+
+		cp_resume_task(self->ctx, run_task::step, self->handle.address());
+	}
+};
+
+}
+
+#endif
+
+#endif /*CPLUFFXX_COROUTINE_H_*/
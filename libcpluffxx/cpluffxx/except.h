@@ -28,6 +28,7 @@
 #ifndef CPLUFFXX_EXCEPT_H_
 #define CPLUFFXX_EXCEPT_H_
 
+#include <cstddef>
 #include <cpluffxx/defines.h>
 
 namespace cpluff {
@@ -107,6 +108,77 @@ protected:
 	const char* error_message;
 };
 
+/**
+ * Holds either the result of a non-throwing API call or the error which
+ * made it fail. Non-throwing variants of API functions return results
+ * instead of throwing api_error so that callers on performance sensitive
+ * paths can check for failures without exception handling. This class is
+ * not intended to be subclassed by the client program.
+ */
+template <class T> class result {
+public:
+
+	/**
+	 * @internal
+	 * Constructs a successful result.
+	 *
+	 * @param value the result value
+	 */
+	inline result(const T& value):
+	val(value), failed(false), error_code(api_error::RESOURCE), error_message(NULL) {}
+
+	/**
+	 * @internal
+	 * Constructs a failed result.
+	 *
+	 * @param error the error which made the call fail
+	 */
+	inline result(const api_error& error):
+	val(), failed(true), error_code(error.reason()), error_message(error.message()) {}
+
+	/**
+	 * Returns whether the call succeeded.
+	 *
+	 * @return whether the call succeeded
+	 */
+	inline bool ok() const {
+		return !failed;
+	}
+
+	/**
+	 * Returns the result value. Must only be called if ok() returns true.
+	 *
+	 * @return the result value
+	 */
+	inline const T& value() const {
+		return val;
+	}
+
+	/**
+	 * Returns the error which made the call fail. Must only be called if
+	 * ok() returns false.
+	 *
+	 * @return the error which made the call fail
+	 */
+	inline api_error error() const {
+		return api_error(error_code, error_message);
+	}
+
+protected:
+
+	/** @internal The result value */
+	T val;
+
+	/** @internal Whether the call failed */
+	bool failed;
+
+	/** @internal The error code if failed */
+	api_error::code error_code;
+
+	/** @internal The error message if failed */
+	const char* error_message;
+};
+
 }
 
 #endif /*CPLUFFXX_EXCEPT_H_*/
@@ -22,38 +22,143 @@
  *-----------------------------------------------------------------------*/
 
 /** @file 
- * Declares container classes for static plug-in information.
+ * Declares view classes for static plug-in information. The views refer
+ * directly to the C API information structures and do not copy them;
+ * only plugin_info holds a (shared) reference to the underlying plug-in
+ * information which keeps the other views valid.
  */
 
 #ifndef CPLUFFXX_INFO_H_
 #define CPLUFFXX_INFO_H_
 
+#include <cstddef>
 #include <cstring>
-#include <vector>
-#include <map>
+#include <iterator>
 #include <cpluff.h>
 #include <cpluffxx/sharedptr.h>
 
 namespace cpluff {
 
 /**
- * Provides a comparison function for string pointer content.
- * This class is not intended to be used by the client program except as
- * part of C-Pluff containers using it.
+ * A lightweight, non-owning random access range over a C API information
+ * array. The elements are presented as view objects of type @a V which are
+ * constructed on the fly from pointers to the C structures of type @a C.
+ * No memory is allocated when iterating. The range is only valid as long as
+ * the plugin_info it was obtained from, or a copy of it, exists. This class
+ * is not intended to be instantiated or subclassed by the client program.
  */
-class less_str {
+template <class V, class C> class info_range {
 public:
 
-	/*
-	 * Returns whether the first string comes before the second string.
-	 * 
-	 * @param s1 the first string to compare
-	 * @param s2 the second string to compare
-	 * @return whether the first string comes before the second string
+	/**
+	 * A random access iterator over the range. Dereferencing yields a
+	 * view object by value.
+	 */
+	class iterator {
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef V value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const V* pointer;
+		typedef V reference;
+
+		inline iterator(): ptr(NULL), current(NULL) {}
+		inline explicit iterator(const C* ptr): ptr(ptr), current(ptr) {}
+
+		inline V operator*() const { return V(ptr); }
+		inline const V* operator->() const { current = V(ptr); return &current; }
+		inline V operator[](difference_type n) const { return V(ptr + n); }
+
+		inline iterator& operator++() { ++ptr; return *this; }
+		inline iterator operator++(int) { iterator i(*this); ++ptr; return i; }
+		inline iterator& operator--() { --ptr; return *this; }
+		inline iterator operator--(int) { iterator i(*this); --ptr; return i; }
+		inline iterator& operator+=(difference_type n) { ptr += n; return *this; }
+		inline iterator& operator-=(difference_type n) { ptr -= n; return *this; }
+		inline iterator operator+(difference_type n) const { return iterator(ptr + n); }
+		inline iterator operator-(difference_type n) const { return iterator(ptr - n); }
+		inline difference_type operator-(const iterator& i) const { return ptr - i.ptr; }
+
+		inline bool operator==(const iterator& i) const { return ptr == i.ptr; }
+		inline bool operator!=(const iterator& i) const { return ptr != i.ptr; }
+		inline bool operator<(const iterator& i) const { return ptr < i.ptr; }
+		inline bool operator>(const iterator& i) const { return ptr > i.ptr; }
+		inline bool operator<=(const iterator& i) const { return ptr <= i.ptr; }
+		inline bool operator>=(const iterator& i) const { return ptr >= i.ptr; }
+
+	private:
+		const C* ptr;
+		mutable V current;
+	};
+
+	typedef iterator const_iterator;
+	typedef V value_type;
+	typedef std::size_t size_type;
+
+	/**
+	 * @internal
+	 * Constructs a range over a C API array.
+	 *
+	 * @param first pointer to the first element or NULL if empty
+	 * @param n the number of elements
+	 */
+	inline info_range(const C* first, unsigned int n):
+	first(first), n(n) {}
+
+	/**
+	 * Returns an iterator to the first element.
+	 *
+	 * @return an iterator to the first element
 	 */
-	inline bool operator()(const char* const& s1, const char* const& s2) {
-		return strcmp(s1, s2) < 0;
+	inline iterator begin() const {
+		return iterator(first);
 	}
+
+	/**
+	 * Returns an iterator past the last element.
+	 *
+	 * @return an iterator past the last element
+	 */
+	inline iterator end() const {
+		return iterator(first + n);
+	}
+
+	/**
+	 * Returns the number of elements in the range.
+	 *
+	 * @return the number of elements
+	 */
+	inline size_type size() const {
+		return n;
+	}
+
+	/**
+	 * Returns whether the range is empty.
+	 *
+	 * @return whether the range is empty
+	 */
+	inline bool empty() const {
+		return n == 0;
+	}
+
+	/**
+	 * Returns the element at the specified index. The index is not
+	 * checked.
+	 *
+	 * @param i the index of the element
+	 * @return the element at the specified index
+	 */
+	inline V operator[](size_type i) const {
+		return V(first + i);
+	}
+
+private:
+
+	/** @internal The first element */
+	const C* first;
+
+	/** @internal The number of elements */
+	unsigned int n;
 };
 
 /**
@@ -193,35 +298,29 @@ protected:
 
 /**
  * Contains configuration information for an extension. The root configuration
- * element is available from extension_info::getConfiguration and
+ * element is available from extension_info::configuration and
  * descendant elements can be accessed via their ancestors. The actual
  * semantics of the configuration information are defined by the associated
- * extension point. This class is not intended to be subclassed by the client
- * program.
+ * extension point. A configuration element is a lightweight view to the
+ * C API configuration element and it is only valid as long as the
+ * containing plugin_info exists. This class is not intended to be
+ * subclassed by the client program.
  */
 class cfg_element {
 public:
 
-	/**
-	 * @internal
-	 * Constructs a new root configuration element associated with a
-	 * C API configuration element structure.
-	 * 
-	 * @param cfge the associated C API configuration element
-	 */
-	inline cfg_element(const cp_cfg_element_t* cfge) {
-	 	cfg_element(NULL, cfge);
-	 }
+	/** Children elements of a configuration element */
+	typedef info_range<cfg_element, cp_cfg_element_t> children_range;
 
 	/**
 	 * @internal
-	 * Constructs a new configuration element associated with a 
-	 * parent element and a C API configuration element structure.
+	 * Constructs a new configuration element view associated with a
+	 * C API configuration element structure.
 	 * 
-	 * @param parent the parent element or NULL if none
 	 * @param cfge the associated C API configuration element
 	 */
-	cfg_element(cfg_element* parent, const cp_cfg_element_t* cfge);
+	inline cfg_element(const cp_cfg_element_t* cfge):
+	cfge(cfge) {}
 
 	/**
 	 * Returns the name of the configuration element. This corresponds to the
@@ -234,53 +333,109 @@ public:
 	}
 
 	/**
-	 * Returns the attribute name, value map for this element. This corresponds
-	 * to the attributes of the element.
-	 * 
-	 * @return the attribute map for this element
+	 * Returns the value of the configuration element or NULL if the
+	 * element has no value. This corresponds to the text contents of
+	 * the element in a plug-in descriptor.
+	 *
+	 * @return the value of the configuration element or NULL
 	 */
-	inline const std::map<const char*, const char*, less_str>& attributes() const {
-		return attr_map;
+	inline const char* value() const {
+		return cfge->value;
 	}
 
 	/**
-	 * Returns a pointer to the parent element or NULL if this is the root
-	 * element.
+	 * Returns the number of attributes of this element.
+	 *
+	 * @return the number of attributes
+	 */
+	inline unsigned int num_attributes() const {
+		return cfge->num_atts;
+	}
+
+	/**
+	 * Returns the name of the attribute at the specified index.
+	 *
+	 * @param i the index of the attribute, less than num_attributes()
+	 * @return the name of the attribute
+	 */
+	inline const char* attribute_name(unsigned int i) const {
+		return cfge->atts[2 * i];
+	}
+
+	/**
+	 * Returns the value of the attribute at the specified index.
+	 *
+	 * @param i the index of the attribute, less than num_attributes()
+	 * @return the value of the attribute
+	 */
+	inline const char* attribute_value(unsigned int i) const {
+		return cfge->atts[2 * i + 1];
+	}
+
+	/**
+	 * Returns the value of the named attribute or NULL if this element
+	 * has no such attribute. Elements typically have only a few
+	 * attributes so they are scanned linearly.
+	 *
+	 * @param name the name of the attribute
+	 * @return the value of the attribute or NULL
+	 */
+	inline const char* attribute(const char* name) const {
+		for (unsigned int i = 0; i < cfge->num_atts; i++) {
+			if (!strcmp(cfge->atts[2 * i], name)) {
+				return cfge->atts[2 * i + 1];
+			}
+		}
+		return NULL;
+	}
+
+	/**
+	 * Returns whether this element has a parent element.
+	 *
+	 * @return whether this element has a parent element
+	 */
+	inline bool has_parent() const {
+		return cfge->parent != NULL;
+	}
+
+	/**
+	 * Returns the parent element. Must only be called if has_parent()
+	 * returns true.
 	 * 
-	 * @return a pointer to the parent element or NULL if root
+	 * @return the parent element
 	 */
-	inline const cfg_element* parent() const {
-		return cfg_parent;
+	inline cfg_element parent() const {
+		return cfg_element(cfge->parent);
 	}
 	
 	/**
-	 * Returns the children of this configuration element as a vector.
+	 * Returns the children of this configuration element.
 	 * 
-	 * @return the children of this configuration element as a vector
+	 * @return the children of this configuration element
+	 */
+	inline children_range children() const {
+		return children_range(cfge->children, cfge->num_children);
+	}
+
+	/**
+	 * Returns the associated C API configuration element.
+	 *
+	 * @return the associated C API configuration element
 	 */
-	inline const std::vector<const cfg_element*>& children() const {
-		return cfg_children;
+	inline const cp_cfg_element_t* c_element() const {
+		return cfge;
 	}
 
 protected:
 
 	/** @internal The associated C API configuration element */
 	const cp_cfg_element_t* cfge;
-	
-	/** @internal The attribute map */
-	std::map<const char*, const char*, less_str> attr_map;
-	
-	/** @internal The parent element or NULL */
-	cfg_element* cfg_parent;
-	
-	/** @internal Children elements */
-	std::vector<const cfg_element*> cfg_children;
 
 };
 
 /**
  * Describes an extension attached to an extension point. Extension information
- * can be obtained by using plugin_info::getExtensions. This class is not
+ * can be obtained by using plugin_info::extensions. This class is not
  * intended to be instantiated or subclassed by the client program.
  */
 class extension_info {
@@ -294,7 +449,7 @@ public:
 	 * @param ext the associated C API extension
 	 */
 	inline extension_info(const cp_extension_t* ext):
-	ext(ext), cfg_root(ext->configuration) {}
+	ext(ext) {}
 
 	/**
 	 * Returns the unique identifier of the extension point this extension is
@@ -351,40 +506,56 @@ public:
 	 * 
 	 * @return extension configuration starting with the extension element
 	 */
-	inline const cfg_element& configuration() const {
-		return cfg_root;
+	inline cfg_element configuration() const {
+		return cfg_element(ext->configuration);
 	}
 
 protected:
 
 	/** @internal The associated C APi extension */
 	const cp_extension_t* ext;
-	
-	/** @internal The root configuration element */
-	cfg_element cfg_root;
 };
 
 /**
  * Contains static plug-in information.
  * This information can be loaded from a plug-in descriptor file using
- * CPPluginContext::loadPluginDescriptor. Corresponding information about
- * installed plug-ins can be obtained by using CPPluginContext::getPlugin
- * and CPPluginContext::getPlugins. This class corresponds to the top level
- * @a plugin element in a plug-in descriptor file. This class is not intended
- * to be instantiated or subclassed by the client program.
+ * plugin_container::load_plugin_info. This class corresponds to the
+ * top level @a plugin element in a plug-in descriptor file. A plug-in
+ * information object is a reference counted handle to the C API plug-in
+ * information and copying it is cheap. The C API information is released
+ * when the last copy is destroyed. The import, extension point, extension
+ * and configuration element views obtained from a plug-in information
+ * object remain valid as long as any copy of it exists.
  */
 class plugin_info {
 public:
 
+	/** Plug-in imports */
+	typedef info_range<plugin_import, cp_plugin_import_t> imports_range;
+
+	/** Extension points */
+	typedef info_range<ext_point_info, cp_ext_point_t> ext_points_range;
+
+	/** Extensions */
+	typedef info_range<extension_info, cp_extension_t> extensions_range;
+
 	/**
 	 * @internal
-	 * Constructs a new plug-in descriptor and associates it with a C API
-	 * plug-in descriptor.
+	 * Constructs a new plug-in information handle and associates it with
+	 * a C API plug-in descriptor. The handle takes over the caller's
+	 * reference to the descriptor.
 	 * 
 	 * @param context the associated C API plug-in context handle
 	 * @param pinfo the associated C API plug-in descriptor
 	 */
-	plugin_info(cp_context_t* context, cp_plugin_info_t* pinfo);
+	inline plugin_info(cp_context_t* context, cp_plugin_info_t* pinfo):
+	handle(pinfo, releaser(context)), pinfo(pinfo) {}
+
+	/**
+	 * Constructs an empty plug-in information handle. The accessors
+	 * must not be used until a plug-in information has been assigned.
+	 */
+	inline plugin_info(): pinfo(NULL) {}
 	
 	/**
 	 * Returns the unique identifier of the plugin. A recommended way
@@ -490,12 +661,12 @@ public:
 	}
 
 	/**
-	 * Returns plug-in imports as a vector.
+	 * Returns plug-in imports.
 	 * 
-	 * @return plug-in imports as a vector
+	 * @return plug-in imports
 	 */
-	inline const std::vector<plugin_import>& imports() const {
-		return imports_vec;
+	inline imports_range imports() const {
+		return imports_range(pinfo->imports, pinfo->num_imports);
 	}
 
     /**
@@ -529,8 +700,8 @@ public:
 	 * 
 	 * @return extension points provided by this plug-in
 	 */
-	inline const std::vector<ext_point_info> ext_points() const {
-		return ext_points_vec;
+	inline ext_points_range ext_points() const {
+		return ext_points_range(pinfo->ext_points, pinfo->num_ext_points);
 	}
 	
 	/**
@@ -538,28 +709,37 @@ public:
 	 * 
 	 * @return extensions provided by this plug-in
 	 */
-	inline const std::vector<extension_info> extensions() const {
-		return extensions_vec;
+	inline extensions_range extensions() const {
+		return extensions_range(pinfo->extensions, pinfo->num_extensions);
 	}
 
-	~plugin_info();
+	/**
+	 * Returns the associated C API plug-in descriptor.
+	 *
+	 * @return the associated C API plug-in descriptor
+	 */
+	inline const cp_plugin_info_t* c_info() const {
+		return pinfo;
+	}
 
 protected:
 
-	/** @internal The C API plug-in context handle */
-	cp_context_t* context;
+	/** @internal Releases the C API plug-in descriptor */
+	class releaser {
+	public:
+		inline releaser(cp_context_t* context): context(context) {}
+		inline void operator()(cp_plugin_info_t* pinfo) const {
+			cp_release_info(context, pinfo);
+		}
+	private:
+		cp_context_t* context;
+	};
+
+	/** @internal The shared reference to the C API plug-in descriptor */
+	shared_ptr<cp_plugin_info_t> handle;
 	
 	/** @internal The C API plug-in descriptor pointer */
-	cp_plugin_info_t* pinfo;
-	
-	/** @internal The plug-in import objects */
-	std::vector<plugin_import> imports_vec;
-	
-	/** @internal The extension point objects */
-	std::vector<ext_point_info> ext_points_vec;
-	
-	/** @internal The extension objects */
-	std::vector<extension_info> extensions_vec;
+	const cp_plugin_info_t* pinfo;
 
 };
 
@@ -0,0 +1,272 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file 
+ * Declares a registry for typed extension information.
+ */
+
+#ifndef CPLUFFXX_REGISTRY_H_
+#define CPLUFFXX_REGISTRY_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <cpluff.h>
+#include <cpluffxx/except.h>
+#include <cpluffxx/info.h>
+
+namespace cpluff {
+
+/**
+ * @internal
+ * The type independent part of an extension registry. This class
+ * tracks the plug-ins owning the registered extensions and reacts to
+ * plug-in installation and uninstallation. It is not intended to be used
+ * directly by the client program.
+ */
+class extension_registry_base {
+public:
+
+	/**
+	 * Returns the identifier of the extension point.
+	 *
+	 * @return the identifier of the extension point
+	 */
+	inline const char* ext_point_id() const {
+		return extpt_id.c_str();
+	}
+
+	/**
+	 * Returns the identifier of the plug-in which provided the extension
+	 * at the specified index.
+	 *
+	 * @param i the index of the extension
+	 * @return the identifier of the providing plug-in
+	 */
+	inline const char* plugin_id(std::size_t i) const {
+		return owners[i].c_str();
+	}
+
+protected:
+
+	/**
+	 * @internal
+	 * Constructs a new registry base and registers a plug-in listener.
+	 * The extensions are not loaded until @ref load is called.
+	 *
+	 * @param context the C API plug-in context handle
+	 * @param ext_point_id the unique identifier of the extension point
+	 * @throw api_error if there are not enough system resources
+	 */
+	extension_registry_base(cp_context_t* context, const char* ext_point_id);
+
+	/**
+	 * @internal
+	 * Unregisters the plug-in listener, if still registered.
+	 */
+	virtual ~extension_registry_base();
+
+	/**
+	 * @internal
+	 * Decodes the extensions currently attached to the extension point.
+	 *
+	 * @throw api_error if there are not enough system resources
+	 */
+	void load();
+
+	/**
+	 * @internal
+	 * Unregisters the plug-in listener. Must be called by the destructor
+	 * of the most derived class so that the listener does not see a
+	 * partially destroyed registry.
+	 */
+	void close();
+
+	/**
+	 * @internal
+	 * Decodes an extension configuration and appends the decoded value.
+	 *
+	 * @param cfg the extension configuration
+	 * @return whether a value was appended
+	 */
+	virtual bool append_value(const cfg_element& cfg) = 0;
+
+	/**
+	 * @internal
+	 * Removes the values at the indices for which @a keep is false,
+	 * preserving the order of the remaining values.
+	 *
+	 * @param keep the indices to be kept
+	 */
+	virtual void compact_values(const std::vector<bool>& keep) = 0;
+
+private:
+
+	/** @internal The C API plug-in context handle */
+	cp_context_t* context;
+
+	/** @internal The identifier of the extension point */
+	std::string extpt_id;
+
+	/** @internal The providing plug-in of each value */
+	std::vector<std::string> owners;
+
+	/** @internal Whether the plug-in listener is registered */
+	bool listening;
+
+	/** @internal Decodes an extension of the specified plug-in */
+	void add_extension(const char* plugin_id, const cp_extension_t* ext);
+
+	/** @internal Removes the values provided by the specified plug-in */
+	void remove_plugin(const char* plugin_id);
+
+	/** @internal Adds the values provided by the specified plug-in */
+	void add_plugin(const char* plugin_id);
+
+	/** @internal Delivers plug-in events to the registry */
+	static void plugin_listener(const char* plugin_id, cp_plugin_state_t old_state, cp_plugin_state_t new_state, void* user_data);
+};
+
+/**
+ * Keeps the extensions attached to an extension point decoded into typed
+ * values. Each extension is decoded once, when the registry is created or
+ * when the providing plug-in is installed, and the decoded values are kept
+ * in a contiguous array. Values are removed when the providing plug-in is
+ * uninstalled. Accessing the values does not involve any string parsing.
+ * 
+ * The type @a T must be default constructible and copyable and it must
+ * declare how to decode an extension configuration by providing a static
+ * member function
+ * @code static bool decode(const cpluff::cfg_element& cfg, T& value) @endcode
+ * which returns false if the configuration is not valid, in which case the
+ * extension is skipped.
+ *
+ * The registry is updated from within plug-in listener invocations. Access
+ * to the values must be synchronized with plug-in installation and
+ * uninstallation by the client program. The registry must be destroyed
+ * before the associated plug-in context.
+ */
+template <class T> class extension_registry : public extension_registry_base {
+public:
+
+	/** The iterator type for the decoded values */
+	typedef typename std::vector<T>::const_iterator const_iterator;
+
+	/**
+	 * Creates a new registry for the specified extension point and
+	 * decodes the extensions currently attached to it.
+	 *
+	 * @param context the C API plug-in context handle
+	 * @param ext_point_id the unique identifier of the extension point
+	 * @throw api_error if there are not enough system resources
+	 */
+	inline extension_registry(cp_context_t* context, const char* ext_point_id):
+	extension_registry_base(context, ext_point_id) {
+		load();
+	}
+
+	inline ~extension_registry() {
+		close();
+	}
+
+	/**
+	 * Returns the number of decoded values.
+	 *
+	 * @return the number of decoded values
+	 */
+	inline std::size_t size() const {
+		return values.size();
+	}
+
+	/**
+	 * Returns whether there are no decoded values.
+	 *
+	 * @return whether there are no decoded values
+	 */
+	inline bool empty() const {
+		return values.empty();
+	}
+
+	/**
+	 * Returns the decoded value at the specified index.
+	 *
+	 * @param i the index of the value
+	 * @return the decoded value
+	 */
+	inline const T& operator[](std::size_t i) const {
+		return values[i];
+	}
+
+	/**
+	 * Returns an iterator to the first decoded value.
+	 *
+	 * @return an iterator to the first decoded value
+	 */
+	inline const_iterator begin() const {
+		return values.begin();
+	}
+
+	/**
+	 * Returns an iterator past the last decoded value.
+	 *
+	 * @return an iterator past the last decoded value
+	 */
+	inline const_iterator end() const {
+		return values.end();
+	}
+
+protected:
+
+	inline bool append_value(const cfg_element& cfg) {
+		T value;
+
+		if (!T::decode(cfg, value)) {
+			return false;
+		}
+		values.push_back(value);
+		return true;
+	}
+
+	inline void compact_values(const std::vector<bool>& keep) {
+		std::size_t n = 0;
+
+		for (std::size_t i = 0; i < values.size(); i++) {
+			if (keep[i]) {
+				if (n != i) {
+					values[n] = values[i];
+				}
+				n++;
+			}
+		}
+		values.resize(n);
+	}
+
+private:
+
+	/** @internal The decoded values */
+	std::vector<T> values;
+};
+
+}
+
+#endif /*CPLUFFXX_REGISTRY_H_*/
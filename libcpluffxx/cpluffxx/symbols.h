@@ -0,0 +1,219 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file
+ * Declares compile-time generation of static symbol tables laid out as
+ * minimal perfect hash tables, see ::cp_define_symbols. This header is not
+ * included by cpluffxx.h. Tables are generated at compile time when
+ * compiled as C++14 or later and at run time otherwise. The declarations
+ * are header-only so plug-ins do not need a C++14 build of the C++ library.
+ */
+
+#ifndef CPLUFFXX_SYMBOLS_H_
+#define CPLUFFXX_SYMBOLS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <cpluff.h>
+
+/**
+ * @internal
+ * Marks the functions generating symbol tables constexpr if the
+ * compiler supports the relaxed constexpr rules of C++14.
+ */
+#if __cplusplus >= 201402L
+#define CPLUFFXX_SYMBOLS_CONSTEXPR constexpr
+#else
+#define CPLUFFXX_SYMBOLS_CONSTEXPR
+#endif
+
+namespace cpluff {
+
+/**
+ * A static symbol table laid out as a minimal perfect hash table. Tables
+ * are created using make_symbol_table.
+ */
+template <std::size_t N>
+class symbol_table {
+public:
+
+	/** The table entries */
+	cp_symbol_def_t defs[N];
+
+	/**
+	 * Returns the table entries.
+	 *
+	 * @return the table entries
+	 */
+	constexpr const cp_symbol_def_t* data() const noexcept {
+		return defs;
+	}
+
+	/**
+	 * Returns the number of entries.
+	 *
+	 * @return the number of entries
+	 */
+	static constexpr unsigned int size() noexcept {
+		return N;
+	}
+
+	/**
+	 * Defines the symbols of the table for the plug-in using
+	 * ::cp_define_symbols. The table must remain valid until the plug-in
+	 * is stopped, so it should have static storage duration.
+	 *
+	 * @param ctx the plug-in context
+	 * @return @ref CP_OK (zero) on success or a status code on failure
+	 */
+	inline cp_status_t define(cp_context_t* ctx) const noexcept {
+		return cp_define_symbols(ctx, defs, N);
+	}
+};
+
+/**
+ * Returns a symbol table entry for the specified object.
+ *
+ * @param name the name of the symbol
+ * @param ptr the address of the object
+ * @return the symbol table entry
+ */
+template <typename T>
+constexpr cp_symbol_def_t symbol(const char* name, T* ptr) noexcept {
+	return cp_symbol_def_t { name, ptr, 0 };
+}
+
+/** @internal Internal helpers for symbol tables */
+namespace symbols_internal {
+
+	/** @internal Returns the hash of a name as documented for ::cp_symbol_def_t */
+	CPLUFFXX_SYMBOLS_CONSTEXPR std::uint32_t hash(const char* name, std::uint32_t seed) noexcept {
+		std::uint32_t h = 2166136261u;
+
+		for (int i = 0; i < 4; i++) {
+			h = (h ^ ((seed >> (8 * i)) & 0xffu)) * 16777619u;
+		}
+		for (; *name != '\0'; name++) {
+			h = (h ^ static_cast<unsigned char>(*name)) * 16777619u;
+		}
+		return h;
+	}
+
+	/** @internal Returns whether two names are equal */
+	CPLUFFXX_SYMBOLS_CONSTEXPR bool equal(const char* n1, const char* n2) noexcept {
+		while (*n1 != '\0' && *n1 == *n2) {
+			n1++;
+			n2++;
+		}
+		return *n1 == *n2;
+	}
+
+}
+
+/**
+ * Creates a symbol table laid out as a minimal perfect hash table. The
+ * entries are created using symbol and they must have unique names. When
+ * evaluated at compile time, for example to initialize a static constexpr
+ * table, the table is generated by the compiler and defining it using
+ * symbol_table::define takes constant time. Compile time evaluation
+ * requires C++14; with earlier standards the same table is generated
+ * when the function is called.
+ *
+ * @param entries the symbol table entries
+ * @return the symbol table
+ * @throw std::invalid_argument if names are not unique
+ */
+template <typename... Entries>
+CPLUFFXX_SYMBOLS_CONSTEXPR symbol_table<sizeof...(Entries)> make_symbol_table(Entries... entries) {
+	constexpr std::size_t n = sizeof...(Entries);
+	static_assert(n > 0, "a symbol table must not be empty");
+	const cp_symbol_def_t in[n] = { entries... };
+	symbol_table<n> table {};
+	std::size_t buckets[n] = {};
+	std::size_t counts[n] = {};
+	std::uint32_t disps[n] = {};
+	bool used[n] = {};
+
+	// Assign the names to buckets
+	for (std::size_t i = 0; i < n; i++) {
+		for (std::size_t j = 0; j < i; j++) {
+			if (symbols_internal::equal(in[i].name, in[j].name)) {
+				throw std::invalid_argument("symbol names must be unique");
+			}
+		}
+		buckets[i] = symbols_internal::hash(in[i].name, 0) % n;
+		counts[buckets[i]]++;
+	}
+
+	// Place the largest buckets first by finding a displacement for each
+	for (std::size_t size = n; size > 0; size--) {
+		for (std::size_t b = 0; b < n; b++) {
+			std::size_t slots[n] = {};
+			std::uint32_t d = 0;
+			bool placed = false;
+
+			if (counts[b] != size) {
+				continue;
+			}
+			while (!placed) {
+				std::size_t k = 0;
+
+				placed = true;
+				for (std::size_t i = 0; i < n && placed; i++) {
+					if (buckets[i] != b) {
+						continue;
+					}
+					slots[k] = symbols_internal::hash(in[i].name, d) % n;
+					placed = !used[slots[k]];
+					for (std::size_t j = 0; j < k && placed; j++) {
+						placed = (slots[j] != slots[k]);
+					}
+					k++;
+				}
+				if (!placed) {
+					d++;
+				}
+			}
+			for (std::size_t i = 0, k = 0; i < n; i++) {
+				if (buckets[i] == b) {
+					used[slots[k]] = true;
+					table.defs[slots[k]].name = in[i].name;
+					table.defs[slots[k]].symbol = in[i].symbol;
+					k++;
+				}
+			}
+			disps[b] = d;
+		}
+	}
+
+	// Store the displacements, offset by one to mark the table as hashed
+	for (std::size_t b = 0; b < n; b++) {
+		table.defs[b].disp = disps[b] + 1;
+	}
+	return table;
+}
+
+}
+
+#endif /*CPLUFFXX_SYMBOLS_H_*/
@@ -28,8 +28,8 @@
 #ifndef INTERNALXX_H_
 #define INTERNALXX_H_
 
-#include <set>
-#include <map>
+#include <utility>
+#include <vector>
 #include <cpluff.h>
 #include <cpluffxx.h>
 #include "../libcpluff/defines.h"
@@ -147,9 +147,16 @@ protected:
 private:
 
 	/**
-	 * The registered loggers and their minimum logging severity.
+	 * A logger registration.
 	 */
-	std::map<logger*, logger::severity> loggers;
+	typedef std::pair<logger*, logger::severity> logger_registration;
+
+	/**
+	 * The registered loggers and their minimum logging severity, sorted by
+	 * the logger pointer. A flat vector keeps message delivery a linear
+	 * walk over contiguous memory.
+	 */
+	std::vector<logger_registration> loggers;
 
 	/**
 	 * The minimum logging severity for registered loggers.
@@ -168,9 +175,12 @@ private:
 	CP_HIDDEN static void deliver_log_message(cp_log_severity_t severity, const char* msg, const char* apid, void* user_data) throw ();
 
 	/**
-	 * Updates the aggregate minimum severity for installed loggers.
+	 * Updates the aggregate minimum severity for installed loggers and
+	 * the C API logger registration accordingly.
+	 *
+	 * @return CP_OK (zero) on success or CP_ERR_RESOURCE if insufficient memory
 	 */
-	CP_HIDDEN void update_min_logger_severity() throw (); 
+	CP_HIDDEN cp_status_t update_min_logger_severity() throw (); 
 };
 
 class plugin_container_impl : public plugin_container, public plugin_context_impl {
@@ -180,15 +190,27 @@ public:
 	 * Constructs a new plug-in container.
 	 */
 	CP_HIDDEN plugin_container_impl(shared_ptr<framework> fw);
+
+	/**
+	 * Destroys the plug-in container. The C API plug-in context is
+	 * destroyed before the reference to the framework is released.
+	 */
+	CP_HIDDEN ~plugin_container_impl() throw ();
 	
 	CP_HIDDEN void register_plugin_collection(const char* dir) throw (api_error);
 
+	CP_HIDDEN bool try_register_plugin_collection(const char* dir) throw ();
+
 	CP_HIDDEN void unregister_plugin_collection(const char* dir) throw ();
 
 	CP_HIDDEN void unregister_plugin_collections() throw ();
 
 	CP_HIDDEN shared_ptr<plugin_info> load_plugin_descriptor(const char* path) throw (api_error);
 
+	CP_HIDDEN plugin_info load_plugin_info(const char* path) throw (api_error);
+
+	CP_HIDDEN result<plugin_info> try_load_plugin_descriptor(const char* path) throw ();
+
 private:
 
 	shared_ptr<framework> fw;
@@ -17,10 +17,19 @@ CP_HIDDEN plugin_container_impl::plugin_container_impl(shared_ptr<framework> fw)
 	this->context = context;
 }
 
+CP_HIDDEN plugin_container_impl::~plugin_container_impl() throw () {
+	cp_destroy_context(context);
+	context = NULL;
+}
+
 CP_HIDDEN void plugin_container_impl::register_plugin_collection(const char* dir) throw (api_error) {
 	check_cp_status(cp_register_pcollection(context, dir));
 }
 
+CP_HIDDEN bool plugin_container_impl::try_register_plugin_collection(const char* dir) throw () {
+	return cp_register_pcollection(context, dir) == CP_OK;
+}
+
 CP_HIDDEN void plugin_container_impl::unregister_plugin_collection(const char* dir) throw () {
 	cp_unregister_pcollection(context, dir);
 }
@@ -30,11 +39,29 @@ CP_HIDDEN void plugin_container_impl::unregister_plugin_collections() throw () {
 }
 
 CP_HIDDEN shared_ptr<plugin_info> plugin_container_impl::load_plugin_descriptor(const char* path) throw (api_error) {
+	shared_ptr<plugin_info> ptr(new plugin_info(load_plugin_info(path)));
+	return ptr;
+}
+
+CP_HIDDEN plugin_info plugin_container_impl::load_plugin_info(const char* path) throw (api_error) {
 	cp_status_t status;
 	cp_plugin_info_t *pinfo = cp_load_plugin_descriptor(context, path, &status);
 	check_cp_status(status);
-	shared_ptr<plugin_info> ptr(new plugin_info(context, pinfo));
-	return ptr;
+	return plugin_info(context, pinfo);
+}
+
+CP_HIDDEN result<plugin_info> plugin_container_impl::try_load_plugin_descriptor(const char* path) throw () {
+	cp_status_t status;
+	cp_plugin_info_t *pinfo = cp_load_plugin_descriptor(context, path, &status);
+	if (status != CP_OK) {
+		return result<plugin_info>(status_error(status));
+	}
+	try {
+		return result<plugin_info>(plugin_info(context, pinfo));
+	} catch (...) {
+		cp_release_info(context, pinfo);
+		return result<plugin_info>(status_error(CP_ERR_RESOURCE));
+	}
 }
 
 }
@@ -32,6 +32,7 @@
 #include <cstdarg>
 #include <cstdio>
 #include <cassert>
+#include <algorithm>
 #include <cpluff.h>
 #include "internalxx.h"
 
@@ -42,24 +43,54 @@ CP_HIDDEN plugin_context_impl::plugin_context_impl(cp_context_t *context)
 : context(context),
   min_logger_severity(static_cast<logger::severity>(logger::ERROR + 1)) {}
 
-CP_HIDDEN plugin_context_impl::plugin_context_impl() {
-	plugin_context_impl(NULL);
-}
+CP_HIDDEN plugin_context_impl::plugin_context_impl()
+: context(NULL),
+  min_logger_severity(static_cast<logger::severity>(logger::ERROR + 1)) {}
 
 CP_HIDDEN plugin_context_impl::~plugin_context_impl() throw () {
-	cp_destroy_context(context);
+	if (context != NULL) {
+		cp_destroy_context(context);
+	}
+}
+
+/**
+ * Orders logger registrations by the logger pointer.
+ */
+static bool less_logger(const std::pair<logger*, logger::severity>& r, logger* l) {
+	return r.first < l;
 }
 
 CP_HIDDEN void plugin_context_impl::register_logger(logger* logger, logger::severity minseverity) throw (api_error) {
 	// TODO synchronization
-	loggers[logger] = minseverity;
-	update_min_logger_severity();
+	std::vector<logger_registration>::iterator iter =
+		std::lower_bound(loggers.begin(), loggers.end(), logger, less_logger);
+	bool inserted = false;
+	if (iter != loggers.end() && iter->first == logger) {
+		iter->second = minseverity;
+	} else {
+		try {
+			iter = loggers.insert(iter, logger_registration(logger, minseverity));
+			inserted = true;
+		} catch (...) {
+			check_cp_status(CP_ERR_RESOURCE);
+		}
+	}
+	cp_status_t status = update_min_logger_severity();
+	if (status != CP_OK && inserted) {
+		loggers.erase(iter);
+		update_min_logger_severity();
+	}
+	check_cp_status(status);
 }
 
 CP_HIDDEN void plugin_context_impl::unregister_logger(logger* logger) throw () {
 	// TODO synchronization
-	loggers.erase(logger);
-	update_min_logger_severity();
+	std::vector<logger_registration>::iterator iter =
+		std::lower_bound(loggers.begin(), loggers.end(), logger, less_logger);
+	if (iter != loggers.end() && iter->first == logger) {
+		loggers.erase(iter);
+		update_min_logger_severity();
+	}
 }
 
 CP_HIDDEN void plugin_context_impl::log(logger::severity severity, const char* msg) throw () {
@@ -88,27 +119,32 @@ CP_HIDDEN void plugin_context_impl::logf(logger::severity severity, const char*
 
 CP_HIDDEN void plugin_context_impl::deliver_log_message(cp_log_severity_t sev, const char* msg, const char* apid, void* user_data) throw () {
 	plugin_context_impl* context = static_cast<plugin_context_impl*>(user_data);
-	std::map<logger*, logger::severity>::iterator iter;
+	logger::severity severity = static_cast<logger::severity>(sev);
 	// TODO synchronization
-	for (iter = context->loggers.begin(); iter != context->loggers.end(); iter++) {
-		std::pair<logger* const, logger::severity>& p = *iter;
-		logger::severity severity = static_cast<logger::severity>(sev);
-		if (severity >= p.second) { 
-			(p.first)->log(severity, msg, apid);
+	for (std::vector<logger_registration>::size_type i = 0; i < context->loggers.size(); i++) {
+		const logger_registration& r = context->loggers[i];
+		if (severity >= r.second) { 
+			(r.first)->log(severity, msg, apid);
 		}
 	}
 }
 
-CP_HIDDEN void plugin_context_impl::update_min_logger_severity() throw () {
+CP_HIDDEN cp_status_t plugin_context_impl::update_min_logger_severity() throw () {
 	min_logger_severity = static_cast<logger::severity>(logger::ERROR + 1);
-	std::map<logger*, logger::severity>::iterator iter;
 	// TODO synchronization
-	for (iter = loggers.begin(); iter != loggers.end(); iter++) {
-		std::pair<logger* const, logger::severity>& p = *iter;
-		if (p.second < min_logger_severity) {
-			min_logger_severity = p.second;
+	for (std::vector<logger_registration>::size_type i = 0; i < loggers.size(); i++) {
+		if (loggers[i].second < min_logger_severity) {
+			min_logger_severity = loggers[i].second;
 		}
 	}
+	if (context == NULL) {
+		return CP_OK;
+	} else if (loggers.empty()) {
+		cp_unregister_logger(context, deliver_log_message);
+		return CP_OK;
+	} else {
+		return cp_register_logger(context, deliver_log_message, this, static_cast<cp_log_severity_t>(min_logger_severity));
+	}
 } 
 
 }
@@ -0,0 +1,139 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file 
+ * Implements the type independent part of extension registries.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <cstring>
+#include "internalxx.h"
+
+namespace cpluff {
+
+extension_registry_base::extension_registry_base(cp_context_t* context, const char* ext_point_id):
+context(context), extpt_id(ext_point_id), listening(false) {
+	check_cp_status(cp_register_plistener_filtered(
+		context, plugin_listener, this, NULL, 0,
+		CP_STATE_MASK(::CP_PLUGIN_INSTALLED) | CP_STATE_MASK(::CP_PLUGIN_UNINSTALLED)
+	));
+	listening = true;
+}
+
+extension_registry_base::~extension_registry_base() {
+	close();
+}
+
+void extension_registry_base::close() {
+	if (listening) {
+		cp_unregister_plistener_data(context, plugin_listener, this);
+		listening = false;
+	}
+}
+
+void extension_registry_base::load() {
+	cp_extension_t **exts;
+	cp_status_t status;
+	int num;
+
+	exts = cp_get_extensions_info(context, extpt_id.c_str(), &status, &num);
+	check_cp_status(status);
+	try {
+		for (int i = 0; i < num; i++) {
+			add_extension(exts[i]->plugin->identifier, exts[i]);
+		}
+	} catch (...) {
+		cp_release_info(context, exts);
+		close();
+		throw api_error(api_error::RESOURCE, _("Insufficient system resources for the operation."));
+	}
+	cp_release_info(context, exts);
+}
+
+CP_HIDDEN void extension_registry_base::add_extension(const char* plugin_id, const cp_extension_t* ext) {
+	if (append_value(cfg_element(ext->configuration))) {
+		try {
+			owners.push_back(plugin_id);
+		} catch (...) {
+			std::vector<bool> keep(owners.size() + 1, true);
+			keep[owners.size()] = false;
+			compact_values(keep);
+			throw;
+		}
+	}
+}
+
+CP_HIDDEN void extension_registry_base::remove_plugin(const char* plugin_id) {
+	std::vector<bool> keep(owners.size());
+	std::size_t n = 0;
+
+	for (std::size_t i = 0; i < owners.size(); i++) {
+		if ((keep[i] = (owners[i] != plugin_id))) {
+			if (n != i) {
+				owners[n] = owners[i];
+			}
+			n++;
+		}
+	}
+	if (n != owners.size()) {
+		compact_values(keep);
+		owners.resize(n);
+	}
+}
+
+CP_HIDDEN void extension_registry_base::add_plugin(const char* plugin_id) {
+	cp_plugin_info_t *pinfo;
+	cp_status_t status;
+
+	if ((pinfo = cp_get_plugin_info(context, plugin_id, &status)) == NULL) {
+		return;
+	}
+
+	// The information is released when the handle goes out of scope
+	plugin_info info(context, pinfo);
+	for (unsigned int i = 0; i < pinfo->num_extensions; i++) {
+		if (!strcmp(pinfo->extensions[i].ext_point_id, extpt_id.c_str())) {
+			add_extension(plugin_id, pinfo->extensions + i);
+		}
+	}
+}
+
+CP_HIDDEN void extension_registry_base::plugin_listener(const char* plugin_id, cp_plugin_state_t old_state, cp_plugin_state_t new_state, void* user_data) {
+	extension_registry_base* registry = static_cast<extension_registry_base*>(user_data);
+
+	try {
+		if (new_state == ::CP_PLUGIN_UNINSTALLED) {
+			registry->remove_plugin(plugin_id);
+		} else if (old_state == ::CP_PLUGIN_UNINSTALLED) {
+			registry->add_plugin(plugin_id);
+		}
+	} catch (...) {
+		
+		// Extensions that could not be decoded are left out
+	}
+}
+
+}
@@ -60,12 +60,16 @@ static const char* status_to_cs_string(cp_status_t status) throw() {
 	}	
 }
 
+CP_HIDDEN api_error status_error(cp_status_t status) throw () {
+	return api_error(
+		(api_error::code) status,
+		status_to_cs_string(status)
+	);
+}
+
 CP_HIDDEN void check_cp_status(cp_status_t status) throw (api_error) {
 	if (status != CP_OK) {
-		throw api_error(
-			(api_error::code) status,
-			status_to_cs_string(status)
-		);
+		throw status_error(status);
 	}
 }
 
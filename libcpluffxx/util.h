@@ -44,6 +44,16 @@ namespace cpluff {
  */
 CP_HIDDEN void check_cp_status(cp_status_t status) throw (api_error);
 
+/**
+ * @internal
+ * Returns a generic exception matching the specified status code
+ * without throwing it.
+ *
+ * @param status the status code from C API, other than CP_OK
+ * @return the matching exception
+ */
+CP_HIDDEN api_error status_error(cp_status_t status) throw ();
+
 }
 
 #endif /*UTIL_H_*/
@@ -29,6 +29,9 @@
 #include <stdarg.h>
 #include <string.h>
 #include <unistd.h>
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
 #ifdef HAVE_GETTEXT
 #include <libintl.h>
 #include <locale.h>
@@ -61,6 +64,11 @@
 #endif
 #endif
 
+// Pre-forked workers are supported if processes can be forked and waited for
+#if defined(HAVE_FORK) && defined(HAVE_WAITPID) && defined(HAVE_SYS_WAIT_H)
+#define LOADER_WORKERS
+#endif
+
 // Initializer for empty list
 #define STR_LIST_INITIALIZER { NULL, NULL }
 
@@ -197,6 +205,12 @@ static void print_help(void) {
 		"  -c DIR   add plug-in collection in directory DIR\n"
 		"  -p DIR   add plug-in in directory DIR\n"
 		"  -s PID   start plug-in PID\n"
+		"  -i FILE  restore the started plug-ins from snapshot FILE if it is\n"
+		"           up to date, otherwise write it after starting plug-ins\n"
+		"  -t NUM   execute run functions in NUM threads\n"
+#ifdef LOADER_WORKERS
+		"  -w NUM   fork NUM worker processes running the started plug-ins\n"
+#endif
 		"  -v       be more verbose (repeat for increased verbosity)\n"
 		"  -q       be quiet\n"
 		"  -V       print C-Pluff version number and exit\n"
@@ -244,6 +258,81 @@ static void logger(cp_log_severity_t severity, const char *msg, const char *apid
 	} 
 }
 
+/**
+ * Runs the plug-ins in the current process.
+ * 
+ * @param context the plug-in context
+ * @param run_threads the number of run function threads
+ */
+static void run_plugins(cp_context_t *context, unsigned long run_threads) {
+	if (run_threads > 1) {
+		cp_run_plugins_parallel(context, (unsigned int) run_threads);
+	} else {
+		cp_run_plugins(context);
+	}
+}
+
+#ifdef LOADER_WORKERS
+
+/**
+ * Forks the specified number of worker processes that inherit the plug-in
+ * context and run the plug-ins, and waits for them to exit. Runtime
+ * libraries are loaded before forking so that the workers share them.
+ * Does not return in the workers.
+ * 
+ * @param context the plug-in context
+ * @param run_threads the number of run function threads in each worker
+ * @param num_workers the number of worker processes
+ * @return whether all the workers exited successfully
+ */
+static int run_workers(cp_context_t *context, unsigned long run_threads, unsigned long num_workers) {
+	unsigned long i;
+	unsigned long num_started = 0;
+	int success = 1;
+	
+	// Load the runtime libraries once, failures are logged
+	cp_resolve_plugins(context);
+	cp_prepare_fork(context);
+	
+	// Fork the workers
+	fflush(NULL);
+	for (i = 0; i < num_workers; i++) {
+		pid_t pid = fork();
+		
+		if (pid == 0) {
+			cp_after_fork(context);
+			run_plugins(context, run_threads);
+			cp_destroy();
+			exit(0);
+		} else if (pid < 0) {
+			if (verbosity >= 1) {
+				/* TRANSLATORS: A formatting string for loader error messages. */
+				fprintf(stderr, _("C-Pluff Loader: ERROR: %s\n"), _("Failed to fork a worker process."));
+			}
+			success = 0;
+			break;
+		}
+		num_started++;
+	}
+	
+	// Wait for the workers to exit
+	while (num_started > 0) {
+		int wstatus;
+		
+		if (waitpid(-1, &wstatus, 0) < 0) {
+			success = 0;
+			break;
+		}
+		if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+			success = 0;
+		}
+		num_started--;
+	}
+	return success;
+}
+
+#endif
+
 /// The main function
 int main(int argc, char *argv[]) {
 	int i;
@@ -253,6 +342,13 @@ int main(int argc, char *argv[]) {
 	cp_context_t *context;
 	char **ctx_argv;
 	str_list_entry_t *entry;
+	unsigned long run_threads = 1;
+#ifdef LOADER_WORKERS
+	unsigned long num_workers = 0;
+#endif
+	int success = 1;
+	const char *snapshot = NULL;
+	int restored = 0;
 
 	// Set locale
 #ifdef HAVE_GETTEXT
@@ -270,7 +366,7 @@ int main(int argc, char *argv[]) {
 #endif
 
 	// Parse arguments
-	while ((i = getopt(argc, argv, "hc:p:s:vqV")) != -1) {
+	while ((i = getopt(argc, argv, "hc:p:s:i:t:w:vqV")) != -1) {
 		switch (i) {
 			
 			// Display help and exit
@@ -293,6 +389,37 @@ int main(int argc, char *argv[]) {
 				str_list_append(&lst_start, optarg);
 				break;
 
+			// Use a snapshot of the started plug-ins
+			case 'i':
+				snapshot = optarg;
+				break;
+
+			// Set the number of run function threads
+			case 't': {
+				char *end;
+				
+				run_threads = strtoul(optarg, &end, 10);
+				if (*optarg == '\0' || *end != '\0' || run_threads == 0) {
+					error(_("Invalid number of threads. Try option -h for help."));
+				}
+				break;
+			}
+
+#ifdef LOADER_WORKERS
+
+			// Set the number of worker processes
+			case 'w': {
+				char *end;
+				
+				num_workers = strtoul(optarg, &end, 10);
+				if (*optarg == '\0' || *end != '\0' || num_workers == 0) {
+					error(_("Invalid number of worker processes. Try option -h for help."));
+				}
+				break;
+			}
+
+#endif
+
 			// Be more verbose
 			case 'v':
 				if (verbosity < 1) {
@@ -369,8 +496,16 @@ int main(int argc, char *argv[]) {
 	ctx_argv[argc - optind + 1] = NULL;
 	cp_set_context_args(context, ctx_argv);
 
+	// Restore the plug-ins from an up to date snapshot
+	if (snapshot != NULL) {
+		restored = (cp_restore_plugin_image(context, snapshot) == CP_OK);
+		if (!restored) {
+			cp_uninstall_plugins(context);
+		}
+	}
+
 	// Load individual plug-ins
-	for (entry = lst_plugin_dirs.first; entry != NULL; entry = entry->next) {
+	for (entry = lst_plugin_dirs.first; entry != NULL && !restored; entry = entry->next) {
 		cp_plugin_info_t *pi = cp_load_plugin_descriptor(context, entry->str, NULL);
 		if (pi == NULL) {
 			errorf(_("Failed to load a plug-in from path %s."), entry->str);
@@ -388,22 +523,35 @@ int main(int argc, char *argv[]) {
 			errorf(_("Failed to register a plug-in collection at path %s."), entry->str); 
 		}
 	}
-	if (lst_plugin_collections.first != NULL
+	if (lst_plugin_collections.first != NULL && !restored
 		&& cp_scan_plugins(context, 0) != CP_OK) {
 		error(_("Failed to load and install plug-ins from plug-in collections."));
 	}
 	str_list_clear(&lst_plugin_collections);
 	
 	// Start plug-ins
-	for (entry = lst_start.first; entry != NULL; entry = entry->next) {
+	for (entry = lst_start.first; entry != NULL && !restored; entry = entry->next) {
 		if (cp_start_plugin(context, entry->str) != CP_OK) {
 			errorf(_("Failed to start plug-in %s."), entry->str);
 		}
 	}
 	str_list_clear(&lst_start);
+	
+	// Save the started plug-ins for the next startup, failures are logged
+	if (snapshot != NULL && !restored) {
+		cp_write_plugin_image(context, snapshot);
+	}
 
-	// Run plug-ins
-	cp_run_plugins(context);
+	// Run plug-ins, possibly in pre-forked worker processes
+#ifdef LOADER_WORKERS
+	if (num_workers > 0) {
+		success = run_workers(context, run_threads, num_workers);
+	} else {
+		run_plugins(context, run_threads);
+	}
+#else
+	run_plugins(context, run_threads);
+#endif
 
 	// Destroy framework
 	cp_destroy();
@@ -412,5 +560,5 @@ int main(int argc, char *argv[]) {
 	free(ctx_argv);
 
 	// Return from the main program
-	return 0;
+	return (success ? 0 : 1);
 }
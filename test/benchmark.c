@@ -0,0 +1,598 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/** @file
+ * Benchmarks for the framework hot paths.
+ *
+ * Generates synthetic plug-in collections and measures the throughput
+ * of scanning, descriptor loading, starting, symbol resolution and
+ * extension queries. Results are written as tab separated lines, one
+ * line per measurement, so that they can be compared between builds.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#if defined(CP_THREADS) && !defined(_WIN32)
+#include <pthread.h>
+#endif
+#include <cpluff.h>
+
+
+/* ------------------------------------------------------------------------
+ * Constants
+ * ----------------------------------------------------------------------*/
+
+/// Default collection sizes
+static const char default_sizes[] = "10,100,1000,10000";
+
+/// The identifier of the extension point the generated extensions use
+static const char bench_extpt[] = "bp0.items";
+
+
+/* ------------------------------------------------------------------------
+ * Data types
+ * ----------------------------------------------------------------------*/
+
+/// Benchmark parameters
+typedef struct bench_params_t {
+
+	/// The number of dependencies each generated plug-in imports
+	int fanout;
+
+	/// The number of configuration elements in each extension
+	int cfg_size;
+
+	/// The number of threads used by multi-threaded measurements
+	int threads;
+
+	/// The number of iterations of each query per thread
+	int iterations;
+
+	/// The directory where collections are generated
+	const char *dir;
+
+	/// The directory containing the installed test plug-ins or NULL
+	const char *plugins_dir;
+
+	/// The output stream
+	FILE *out;
+
+} bench_params_t;
+
+/// Query benchmarks executed concurrently by several threads
+typedef enum bench_query_t {
+	BENCH_EXTENSIONS_INFO,
+	BENCH_LOOKUP_CFG_VALUE,
+	BENCH_RESOLVE_SYMBOL
+} bench_query_t;
+
+/// Data for a query worker
+typedef struct bench_worker_t {
+	cp_context_t *ctx;
+	bench_query_t query;
+	int iterations;
+	cp_extension_t **extensions;
+	int num_extensions;
+	const char *cfg_path;
+	unsigned long failures;
+} bench_worker_t;
+
+
+/* ------------------------------------------------------------------------
+ * Function definitions
+ * ----------------------------------------------------------------------*/
+
+static void error(const char *msg) {
+	fprintf(stderr, "benchmark: ERROR: %s\n", msg);
+	exit(1);
+}
+
+static unsigned long long now_usecs(void) {
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	if (!clock_gettime(CLOCK_MONOTONIC, &ts)) {
+		return (unsigned long long) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+	}
+#endif
+#if defined(HAVE_GETTIMEOFDAY) && defined(HAVE_SYS_TIME_H)
+	{
+		struct timeval tv;
+
+		gettimeofday(&tv, NULL);
+		return (unsigned long long) tv.tv_sec * 1000000ULL + tv.tv_usec;
+	}
+#else
+	return (unsigned long long) time(NULL) * 1000000ULL;
+#endif
+}
+
+static void make_dir(const char *path) {
+	int rc;
+
+#ifdef _WIN32
+	rc = _mkdir(path);
+#else
+	rc = mkdir(path, 0777);
+#endif
+	if (rc != 0) {
+		struct stat st;
+
+		if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+			fprintf(stderr, "benchmark: ERROR: Could not create directory %s.\n", path);
+			exit(1);
+		}
+	}
+}
+
+/**
+ * Writes one measurement to the output stream.
+ *
+ * @param params the benchmark parameters
+ * @param name the name of the measurement
+ * @param plugins the size of the plug-in collection
+ * @param threads the number of threads used
+ * @param ops the number of operations performed
+ * @param usecs the elapsed wall clock time in microseconds
+ */
+static void report(const bench_params_t *params, const char *name, int plugins, int threads, unsigned long ops, unsigned long long usecs) {
+	double rate = (usecs > 0 ? (double) ops * 1000000.0 / (double) usecs : 0.0);
+
+	fprintf(params->out, "%s\t%d\t%d\t%d\t%d\t%lu\t%llu\t%.1f\n",
+		name, plugins, params->fanout, params->cfg_size, threads,
+		ops, usecs, rate);
+	fflush(params->out);
+}
+
+/**
+ * Generates a collection of synthetic plug-ins. Plug-in bp0 declares the
+ * extension point used by the extensions of all plug-ins and the
+ * plug-ins form a tree where each plug-in imports the next @a fanout
+ * plug-ins so that starting bp0 starts the whole collection.
+ *
+ * @param params the benchmark parameters
+ * @param coll the collection directory
+ * @param num the number of plug-ins
+ */
+static void generate_collection(const bench_params_t *params, const char *coll, int num) {
+	char path[1024];
+	int i, j;
+
+	make_dir(coll);
+	for (i = 0; i < num; i++) {
+		FILE *f;
+
+		snprintf(path, sizeof(path), "%s" CP_FNAMESEP_STR "bp%d", coll, i);
+		make_dir(path);
+		snprintf(path, sizeof(path), "%s" CP_FNAMESEP_STR "bp%d" CP_FNAMESEP_STR "plugin.xml", coll, i);
+		if ((f = fopen(path, "w")) == NULL) {
+			error("Could not write a plug-in descriptor.");
+		}
+		fprintf(f, "<?xml version=\"1.0\"?>\n<plugin id=\"bp%d\" name=\"Benchmark plug-in %d\" version=\"1.0\">\n", i, i);
+		if (params->fanout > 0 && (long) i * params->fanout + 1 < num) {
+			fputs("\t<requires>\n", f);
+			for (j = 1; j <= params->fanout && (long) i * params->fanout + j < num; j++) {
+				fprintf(f, "\t\t<import plugin=\"bp%d\"/>\n", i * params->fanout + j);
+			}
+			fputs("\t</requires>\n", f);
+		}
+		if (i == 0) {
+			fputs("\t<extension-point id=\"items\"/>\n", f);
+		}
+		fprintf(f, "\t<extension point=\"%s\" id=\"item\">\n", bench_extpt);
+		for (j = 0; j < params->cfg_size; j++) {
+			fprintf(f, "\t\t<c%d value=\"v%d\">text %d</c%d>\n", j, j, j, j);
+		}
+		fputs("\t</extension>\n</plugin>\n", f);
+		if (fclose(f) != 0) {
+			error("Could not write a plug-in descriptor.");
+		}
+	}
+}
+
+static cp_context_t *create_context(void) {
+	cp_context_t *ctx;
+	cp_status_t status;
+
+	if ((ctx = cp_create_context(&status)) == NULL) {
+		error("Could not create a plug-in context.");
+	}
+	return ctx;
+}
+
+static void install_descriptor(cp_context_t *ctx, const char *path) {
+	cp_plugin_info_t *pi;
+	cp_status_t status;
+
+	if ((pi = cp_load_plugin_descriptor(ctx, path, &status)) == NULL) {
+		fprintf(stderr, "benchmark: ERROR: Could not load plug-in descriptor %s.\n", path);
+		exit(1);
+	}
+	if (cp_install_plugin(ctx, pi) != CP_OK) {
+		error("Could not install a plug-in.");
+	}
+	cp_release_info(ctx, pi);
+}
+
+static void run_query(bench_worker_t *w) {
+	int i;
+
+	for (i = 0; i < w->iterations; i++) {
+		switch (w->query) {
+			case BENCH_EXTENSIONS_INFO: {
+				cp_extension_t **exts;
+				cp_status_t status;
+
+				if ((exts = cp_get_extensions_info(w->ctx, bench_extpt, &status, NULL)) == NULL) {
+					w->failures++;
+				} else {
+					cp_release_info(w->ctx, exts);
+				}
+				break;
+			}
+			case BENCH_LOOKUP_CFG_VALUE: {
+				cp_extension_t *ext = w->extensions[i % w->num_extensions];
+
+				if (cp_lookup_cfg_value(ext->configuration, w->cfg_path) == NULL) {
+					w->failures++;
+				}
+				break;
+			}
+			case BENCH_RESOLVE_SYMBOL: {
+				void *sym;
+
+				if ((sym = cp_resolve_symbol(w->ctx, "symuser", "used_string", NULL)) == NULL) {
+					w->failures++;
+				} else {
+					cp_release_symbol(w->ctx, sym);
+				}
+				break;
+			}
+		}
+	}
+}
+
+#if defined(CP_THREADS) && defined(_WIN32)
+static DWORD WINAPI query_worker(LPVOID arg) {
+	run_query(arg);
+	return 0;
+}
+#elif defined(CP_THREADS)
+static void *query_worker(void *arg) {
+	run_query(arg);
+	return NULL;
+}
+#endif
+
+/**
+ * Executes a query benchmark using the specified number of threads and
+ * reports the aggregate throughput.
+ *
+ * @param params the benchmark parameters
+ * @param name the name of the measurement
+ * @param plugins the size of the plug-in collection
+ * @param proto the worker data copied for each thread
+ * @param threads the number of threads
+ */
+static void bench_query(const bench_params_t *params, const char *name, int plugins, const bench_worker_t *proto, int threads) {
+	bench_worker_t *workers;
+	unsigned long long start;
+	unsigned long failures = 0;
+	int i;
+
+	if ((workers = malloc(threads * sizeof(bench_worker_t))) == NULL) {
+		error("Insufficient memory.");
+	}
+	for (i = 0; i < threads; i++) {
+		workers[i] = *proto;
+		workers[i].failures = 0;
+	}
+	start = now_usecs();
+	if (threads == 1) {
+		run_query(workers);
+	} else {
+#if defined(CP_THREADS) && defined(_WIN32)
+		HANDLE *handles;
+
+		if ((handles = malloc(threads * sizeof(HANDLE))) == NULL) {
+			error("Insufficient memory.");
+		}
+		for (i = 0; i < threads; i++) {
+			if ((handles[i] = CreateThread(NULL, 0, query_worker, workers + i, 0, NULL)) == NULL) {
+				error("Could not create a thread.");
+			}
+		}
+		for (i = 0; i < threads; i++) {
+			WaitForSingleObject(handles[i], INFINITE);
+			CloseHandle(handles[i]);
+		}
+		free(handles);
+#elif defined(CP_THREADS)
+		pthread_t *handles;
+
+		if ((handles = malloc(threads * sizeof(pthread_t))) == NULL) {
+			error("Insufficient memory.");
+		}
+		for (i = 0; i < threads; i++) {
+			if (pthread_create(handles + i, NULL, query_worker, workers + i)) {
+				error("Could not create a thread.");
+			}
+		}
+		for (i = 0; i < threads; i++) {
+			pthread_join(handles[i], NULL);
+		}
+		free(handles);
+#endif
+	}
+	report(params, name, plugins, threads, (unsigned long) threads * proto->iterations, now_usecs() - start);
+	for (i = 0; i < threads; i++) {
+		failures += workers[i].failures;
+	}
+	free(workers);
+	if (failures > 0) {
+		fprintf(stderr, "benchmark: ERROR: %s failed %lu times.\n", name, failures);
+		exit(1);
+	}
+}
+
+/**
+ * Executes the benchmarks for a collection of the specified size.
+ *
+ * @param params the benchmark parameters
+ * @param num the number of plug-ins in the collection
+ */
+static void bench_collection(const bench_params_t *params, int num) {
+	char coll[1024];
+	char path[1024];
+	char cfg_path[32];
+	cp_context_t *ctx;
+	bench_worker_t proto;
+	unsigned long long start;
+	int threads[2];
+	int num_threads;
+	int i, t;
+
+	snprintf(coll, sizeof(coll), "%s" CP_FNAMESEP_STR "bench%d", params->dir, num);
+	generate_collection(params, coll, num);
+	threads[0] = 1;
+	threads[1] = params->threads;
+	num_threads = 1;
+#ifdef CP_THREADS
+	if (params->threads > 1) {
+		num_threads = 2;
+	}
+#endif
+
+	// Descriptor loading
+	ctx = create_context();
+	start = now_usecs();
+	for (i = 0; i < num; i++) {
+		cp_plugin_info_t *pi;
+		cp_status_t status;
+
+		snprintf(path, sizeof(path), "%s" CP_FNAMESEP_STR "bp%d", coll, i);
+		if ((pi = cp_load_plugin_descriptor(ctx, path, &status)) == NULL) {
+			error("Could not load a plug-in descriptor.");
+		}
+		cp_release_info(ctx, pi);
+	}
+	report(params, "load_plugin_descriptor", num, 1, num, now_usecs() - start);
+	cp_destroy_context(ctx);
+
+	// Scanning and starting
+	for (t = 0; t < num_threads; t++) {
+		ctx = create_context();
+		if (cp_register_pcollection(ctx, coll) != CP_OK) {
+			error("Could not register the plug-in collection.");
+		}
+		if (t == 0) {
+			start = now_usecs();
+			if (cp_scan_plugins(ctx, 0) != CP_OK) {
+				error("Could not scan plug-ins.");
+			}
+			report(params, "scan_plugins", num, 1, num, now_usecs() - start);
+			start = now_usecs();
+			if (cp_start_plugin(ctx, "bp0") != CP_OK) {
+				error("Could not start plug-ins.");
+			}
+			report(params, "start_plugin_chain", num, 1, num, now_usecs() - start);
+		} else {
+			if (cp_scan_plugins(ctx, 0) != CP_OK) {
+				error("Could not scan plug-ins.");
+			}
+			start = now_usecs();
+			if (cp_start_plugins_parallel(ctx, NULL, 0, threads[t]) != CP_OK) {
+				error("Could not start plug-ins.");
+			}
+			report(params, "start_plugins_parallel", num, threads[t], num, now_usecs() - start);
+		}
+		start = now_usecs();
+		cp_stop_plugins(ctx);
+		report(params, "stop_plugins", num, 1, num, now_usecs() - start);
+		cp_destroy_context(ctx);
+	}
+
+	// Queries on an installed collection
+	ctx = create_context();
+	if (cp_register_pcollection(ctx, coll) != CP_OK
+		|| cp_scan_plugins(ctx, 0) != CP_OK) {
+		error("Could not scan plug-ins.");
+	}
+	memset(&proto, 0, sizeof(proto));
+	proto.ctx = ctx;
+	proto.iterations = params->iterations;
+	if ((proto.extensions = cp_get_extensions_info(ctx, bench_extpt, NULL, &(proto.num_extensions))) == NULL
+		|| proto.num_extensions != num) {
+		error("Could not get extensions.");
+	}
+	snprintf(cfg_path, sizeof(cfg_path), "c%d/@value", params->cfg_size - 1);
+	proto.cfg_path = cfg_path;
+	for (t = 0; t < num_threads; t++) {
+		proto.query = BENCH_EXTENSIONS_INFO;
+		bench_query(params, "get_extensions_info", num, &proto, threads[t]);
+		if (params->cfg_size > 0) {
+			proto.query = BENCH_LOOKUP_CFG_VALUE;
+			bench_query(params, "lookup_cfg_value", num, &proto, threads[t]);
+		}
+	}
+	if (params->plugins_dir != NULL) {
+		snprintf(path, sizeof(path), "%s" CP_FNAMESEP_STR "symuser", params->plugins_dir);
+		install_descriptor(ctx, path);
+		snprintf(path, sizeof(path), "%s" CP_FNAMESEP_STR "symprovider", params->plugins_dir);
+		install_descriptor(ctx, path);
+		if (cp_start_plugin(ctx, "symuser") != CP_OK) {
+			error("Could not start the symbol user plug-in.");
+		}
+		for (t = 0; t < num_threads; t++) {
+			proto.query = BENCH_RESOLVE_SYMBOL;
+			bench_query(params, "resolve_symbol", num, &proto, threads[t]);
+		}
+	}
+	cp_release_info(ctx, proto.extensions);
+	cp_destroy_context(ctx);
+}
+
+static void print_usage(void) {
+	fputs("Usage: benchmark [options]\n"
+		"  -s SIZES    comma separated collection sizes (default 10,100,1000,10000)\n"
+		"  -f FANOUT   dependencies imported by each plug-in (default 2)\n"
+		"  -c SIZE     configuration elements in each extension (default 8)\n"
+		"  -t THREADS  threads for multi-threaded measurements (default 4)\n"
+		"  -i COUNT    iterations of each query per thread (default 10000)\n"
+		"  -d DIR      directory for generated collections (default tmp/bench)\n"
+		"  -p DIR      directory of the installed test plug-ins (default tmp/install/plugins)\n"
+		"  -o FILE     write results to FILE instead of standard output\n"
+		"  -h          display this help\n", stdout);
+}
+
+static int parse_int(const char *arg, int min) {
+	char *end;
+	long v = strtol(arg, &end, 10);
+
+	if (*arg == '\0' || *end != '\0' || v < min || v > 1000000000L) {
+		fprintf(stderr, "benchmark: ERROR: Invalid numeric argument %s.\n", arg);
+		exit(1);
+	}
+	return (int) v;
+}
+
+int main(int argc, char *argv[]) {
+	bench_params_t params;
+	const char *sizes = default_sizes;
+	const char *output = NULL;
+	struct stat st;
+	char *s, *tok;
+	int i;
+
+	params.fanout = 2;
+	params.cfg_size = 8;
+	params.threads = 4;
+	params.iterations = 10000;
+	params.dir = "tmp" CP_FNAMESEP_STR "bench";
+	params.plugins_dir = "tmp" CP_FNAMESEP_STR "install" CP_FNAMESEP_STR "plugins";
+	params.out = stdout;
+	for (i = 1; i < argc; i++) {
+		const char *opt = argv[i];
+
+		if (!strcmp(opt, "-h")) {
+			print_usage();
+			exit(0);
+		}
+		if (opt[0] != '-' || opt[1] == '\0' || opt[2] != '\0' || i + 1 >= argc) {
+			print_usage();
+			exit(1);
+		}
+		i++;
+		switch (opt[1]) {
+			case 's':
+				sizes = argv[i];
+				break;
+			case 'f':
+				params.fanout = parse_int(argv[i], 1);
+				break;
+			case 'c':
+				params.cfg_size = parse_int(argv[i], 0);
+				break;
+			case 't':
+				params.threads = parse_int(argv[i], 1);
+				break;
+			case 'i':
+				params.iterations = parse_int(argv[i], 1);
+				break;
+			case 'd':
+				params.dir = argv[i];
+				break;
+			case 'p':
+				params.plugins_dir = argv[i];
+				break;
+			case 'o':
+				output = argv[i];
+				break;
+			default:
+				print_usage();
+				exit(1);
+		}
+	}
+	if (stat(params.plugins_dir, &st) != 0) {
+		fprintf(stderr, "benchmark: WARNING: %s not found, skipping symbol resolution.\n", params.plugins_dir);
+		params.plugins_dir = NULL;
+	}
+	if (output != NULL && (params.out = fopen(output, "w")) == NULL) {
+		error("Could not open the output file.");
+	}
+
+	if (cp_init() != CP_OK) {
+		error("The C-Pluff initialization failed.");
+	}
+	make_dir(params.dir);
+	fprintf(params.out, "# C-Pluff %s benchmark on %s\n", cp_get_version(), cp_get_host_type());
+	fputs("# benchmark\tplugins\tfanout\tcfg_size\tthreads\toperations\tusecs\tops_per_sec\n", params.out);
+	if ((s = strdup(sizes)) == NULL) {
+		error("Insufficient memory.");
+	}
+	for (tok = strtok(s, ","); tok != NULL; tok = strtok(NULL, ",")) {
+		bench_collection(&params, parse_int(tok, 1));
+	}
+	free(s);
+	cp_destroy();
+	if (output != NULL && fclose(params.out) != 0) {
+		error("Could not write the output file.");
+	}
+	return 0;
+}
@@ -0,0 +1,112 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/*
+ * This file does not include cpluffxx.h because the C++ API does not
+ * compile as C++20. The coroutine support is header-only and uses the
+ * C API directly.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <cstdlib>
+#include <cpluffxx/coroutine.h>
+#include "test.h"
+
+#if defined(__cpp_impl_coroutine) && __cplusplus >= 202002L
+
+static cp_context_t *coroutine_ctx;
+
+static int coroutine_steps;
+
+static int coroutine_destroyed;
+
+/* Counts the destruction of a coroutine frame */
+struct frame_guard {
+	~frame_guard() {
+		coroutine_destroyed++;
+	}
+};
+
+static cpluff::run_task count_steps(int steps) {
+	frame_guard guard;
+
+	for (int i = 0; i < steps; i++) {
+		coroutine_steps++;
+		co_await cpluff::next_step();
+	}
+}
+
+static void *coroutine_create(cp_context_t *ctx) {
+	coroutine_ctx = ctx;
+	return &coroutine_steps;
+}
+
+static int coroutine_start(void *data) {
+	return cpluff::run_coroutine(coroutine_ctx, count_steps(3)) == CP_OK
+		&& cpluff::run_coroutine(coroutine_ctx, count_steps(100)) == CP_OK
+		? CP_OK : CP_ERR_RUNTIME;
+}
+
+static void coroutine_destroy(void *data) {
+}
+
+#endif
+
+extern "C" void coroutinetask_cxx(void) {
+#if defined(__cpp_impl_coroutine) && __cplusplus >= 202002L
+	static const char descriptor[] = "<plugin id=\"coroutines\"/>";
+	static cp_plugin_runtime_t runtime = { coroutine_create, coroutine_start, NULL, coroutine_destroy };
+	cp_context_t *ctx;
+	int errors;
+
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_install_builtin_plugin(ctx, descriptor, sizeof(descriptor) - 1, &runtime, NULL) == CP_OK);
+	check(cp_start_plugin(ctx, "coroutines") == CP_OK);
+
+	// Coroutines do not run before they are scheduled by the run functions
+	check(coroutine_steps == 0);
+
+	// Each run step resumes a coroutine until its next suspension point
+	check(cp_run_plugins_step(ctx));
+	check(coroutine_steps == 1);
+	check(cp_run_plugins_step(ctx));
+	check(coroutine_steps == 2);
+	while (coroutine_destroyed == 0) {
+		check(cp_run_plugins_step(ctx));
+	}
+
+	// The finished coroutine completed all of its steps
+	check(coroutine_steps == 3 + 3);
+
+	// The unfinished coroutine is destroyed when the plug-in stops
+	check(cp_stop_plugin(ctx, "coroutines") == CP_OK);
+	check(coroutine_destroyed == 2);
+	check(!cp_run_plugins_step(ctx));
+	cp_destroy();
+	check(errors == 0);
+#else
+	exit(77);
+#endif
+}
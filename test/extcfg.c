@@ -21,7 +21,12 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *-----------------------------------------------------------------------*/
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "test.h"
 
 void extcfgutils(void) {
@@ -65,3 +70,327 @@ void extcfgutils(void) {
 	cp_destroy_context(ctx);
 	check(errors == 0); 
 }
+
+static char *lookup_compiled_value(cp_cfg_element_t *base, const char *path) {
+	cp_cfg_path_t *cpath;
+	cp_status_t status;
+	char *value;
+	
+	check((cpath = cp_compile_cfg_path(path, &status)) != NULL && status == CP_OK);
+	value = cp_lookup_cfg_value_compiled(base, cpath);
+	check(value == cp_lookup_cfg_value(base, path));
+	cp_free_cfg_path(cpath);
+	return value;
+}
+
+static cp_cfg_element_t *lookup_compiled(cp_cfg_element_t *base, const char *path) {
+	cp_cfg_path_t *cpath;
+	cp_status_t status;
+	cp_cfg_element_t *ce;
+	
+	check((cpath = cp_compile_cfg_path(path, &status)) != NULL && status == CP_OK);
+	ce = cp_lookup_cfg_compiled(base, cpath);
+	check(ce == cp_lookup_cfg_element(base, path));
+	cp_free_cfg_path(cpath);
+	return ce;
+}
+
+void extcfgcompiled(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_extension_t *ext;
+	cp_cfg_element_t *ce, *cebase;
+	const char *str;
+	int errors;
+	cp_status_t status;
+	int i;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	for (i = 0, ext = NULL; ext == NULL && i < plugin->num_extensions; i++) {
+		cp_extension_t *e = plugin->extensions + i;
+		if (e->identifier != NULL && !strcmp(e->local_id, "ext1")) {
+			ext = e;
+		}
+	}
+	check(ext != NULL);
+	
+	// Look up using forward and reverse paths
+	check((ce = cebase = lookup_compiled(ext->configuration, "structure/deeper/struct/is")) != NULL && strcmp(ce->value, "here") == 0);
+	check((str = lookup_compiled_value(ext->configuration, "structure/parameter")) != NULL && strcmp(str, "parameter") == 0);
+	check((str = lookup_compiled_value(ext->configuration, "@name")) != NULL && strcmp(str, "Extension 1") == 0);
+	check((ce = lookup_compiled(cebase, "../../../parameter/../deeper")) != NULL && strcmp(ce->name, "deeper") == 0);
+	check((str = lookup_compiled_value(cebase, "../../../../@name")) != NULL && strcmp(str, "Extension 1") == 0);
+	check(lookup_compiled(ext->configuration, "") == ext->configuration);
+	
+	// Look up nonexisting components
+	check(lookup_compiled(ext->configuration, "non/existing") == NULL);
+	check(lookup_compiled(ext->configuration, "structure/../..") == NULL);
+	check(lookup_compiled(ext->configuration, "structure//parameter") == NULL);
+	check(lookup_compiled_value(ext->configuration, "structure@nonexisting") == NULL);
+
+	cp_release_info(ctx, plugin);
+	cp_destroy_context(ctx);
+	check(errors == 0); 
+}
+
+void extcfgtyped(void) {
+	static const char descriptor[] =
+		"<plugin id=\"typed\"><extension point=\"typed.extpt\">"
+		"<limits count=\" 42 \" ratio=\"0.25\" huge=\"99999999999999999999\" bad=\"12abc\" enabled=\"yes\" off=\"0\">"
+		"<size>\n\t\t-7\n\t</size><flag>\n\t\tfalse\n\t</flag><name>limits</name></limits>"
+		"</extension></plugin>";
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_cfg_element_t *ce;
+	long l = 1;
+	double d = 1.0;
+	int b = -1;
+	int errors;
+	cp_status_t status;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((plugin = cp_load_plugin_descriptor_from_memory(ctx, descriptor, sizeof(descriptor) - 1, &status)) != NULL && status == CP_OK);
+	check(plugin->num_extensions == 1);
+	ce = plugin->extensions[0].configuration;
+	
+	// Values of attributes and elements, surrounded by white space
+	check(cp_lookup_cfg_int(ce, "limits@count", &l) == CP_OK && l == 42);
+	check(cp_lookup_cfg_int(ce, "limits/size", &l) == CP_OK && l == -7);
+	check(cp_lookup_cfg_double(ce, "limits@ratio", &d) == CP_OK && d == 0.25);
+	check(cp_lookup_cfg_double(ce, "limits@count", &d) == CP_OK && d == 42.0);
+	check(cp_lookup_cfg_bool(ce, "limits@enabled", &b) == CP_OK && b == 1);
+	check(cp_lookup_cfg_bool(ce, "limits@off", &b) == CP_OK && b == 0);
+	check(cp_lookup_cfg_bool(ce, "limits/flag", &b) == CP_OK && b == 0);
+	
+	// Missing and malformed values leave the result untouched
+	l = 5;
+	check(cp_lookup_cfg_int(ce, "limits@nonexisting", &l) == CP_ERR_UNKNOWN && l == 5);
+	check(cp_lookup_cfg_int(ce, "limits", &l) == CP_ERR_UNKNOWN && l == 5);
+	check(cp_lookup_cfg_int(ce, "limits@bad", &l) == CP_ERR_MALFORMED && l == 5);
+	check(cp_lookup_cfg_int(ce, "limits@huge", &l) == CP_ERR_MALFORMED && l == 5);
+	check(cp_lookup_cfg_int(ce, "limits@ratio", &l) == CP_ERR_MALFORMED && l == 5);
+	check(cp_lookup_cfg_double(ce, "limits/name", &d) == CP_ERR_MALFORMED && d == 42.0);
+	check(cp_lookup_cfg_bool(ce, "limits@count", &b) == CP_ERR_MALFORMED && b == 0);
+	
+	// Repeated lookups return the cached results
+	check(cp_lookup_cfg_int(ce, "limits@count", &l) == CP_OK && l == 42);
+	check(cp_lookup_cfg_int(ce, "limits/size", &l) == CP_OK && l == -7);
+	check(cp_lookup_cfg_double(ce, "limits@count", &d) == CP_OK && d == 42.0);
+	check(cp_lookup_cfg_bool(ce, "limits/flag", &b) == CP_OK && b == 0);
+	check(cp_lookup_cfg_bool(ce, "limits@enabled", &b) == CP_OK && b == 1);
+	l = 5;
+	check(cp_lookup_cfg_int(ce, "limits@bad", &l) == CP_ERR_MALFORMED && l == 5);
+	check(cp_lookup_cfg_int(ce, "limits@ratio", &l) == CP_ERR_MALFORMED && l == 5);
+	check(cp_lookup_cfg_bool(ce, "limits@count", &b) == CP_ERR_MALFORMED && b == 1);
+	check(!strcmp(cp_lookup_cfg_value(ce, "limits@count"), " 42 "));
+	
+	cp_release_info(ctx, plugin);
+	cp_destroy_context(ctx);
+	check(errors == 0);
+}
+
+void extcfgcompact(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_extension_t *ext;
+	cp_cfg_tree_t *tree;
+	cp_cfg_element_t *ce;
+	const char *str;
+	unsigned int node, deeper, child;
+	int errors;
+	cp_status_t status;
+	int i;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	for (i = 0, ext = NULL; ext == NULL && i < plugin->num_extensions; i++) {
+		cp_extension_t *e = plugin->extensions + i;
+		if (e->identifier != NULL && !strcmp(e->local_id, "ext1")) {
+			ext = e;
+		}
+	}
+	check(ext != NULL);
+	check((tree = cp_compact_cfg(ext->configuration, &status)) != NULL && status == CP_OK);
+	cp_release_info(ctx, plugin);
+	
+	// The elements are stored in preorder
+	check(cp_cfg_tree_size(tree) == 8);
+	check(!strcmp(cp_cfg_tree_name(tree, 0), "extension"));
+	check(cp_cfg_tree_parent(tree, 0) == CP_CFG_NONE);
+	check((str = cp_cfg_tree_attr(tree, 0, "name")) != NULL && !strcmp(str, "Extension 1"));
+	check(cp_cfg_tree_attr(tree, 0, "nonexisting") == NULL);
+	check(cp_cfg_tree_first_child(tree, 0) == 1 && cp_cfg_tree_num_children(tree, 0) == 1);
+	check(cp_cfg_tree_next_sibling(tree, 1) == CP_CFG_NONE);
+	check(cp_cfg_tree_num_children(tree, 1) == 4);
+	check(cp_cfg_tree_next_sibling(tree, 2) == 3 && cp_cfg_tree_next_sibling(tree, 4) == 5);
+	check(cp_cfg_tree_first_child(tree, 2) == CP_CFG_NONE);
+	check(cp_cfg_tree_name(tree, 2) == cp_cfg_tree_name(tree, 3));
+	
+	// Look up using forward and reverse paths
+	check((node = cp_cfg_tree_lookup(tree, 0, "structure/deeper/struct/is")) != CP_CFG_NONE);
+	check(!strcmp(cp_cfg_tree_value(tree, node), "here"));
+	check((deeper = cp_cfg_tree_lookup(tree, node, "../../../parameter/../deeper")) == 5);
+	check((child = cp_cfg_tree_lookup(tree, 0, "structure/parameter")) == 2 && !strcmp(cp_cfg_tree_value(tree, child), "parameter"));
+	check(!strcmp(cp_cfg_tree_value(tree, cp_cfg_tree_lookup(tree, 0, "structure/assertion")), "1<2"));
+	check(cp_cfg_tree_value(tree, deeper) == NULL);
+	check(cp_cfg_tree_lookup(tree, 0, "") == 0);
+	check(cp_cfg_tree_lookup(tree, 0, "structure/../..") == CP_CFG_NONE);
+	check(cp_cfg_tree_lookup(tree, 0, "non/existing") == CP_CFG_NONE);
+	
+	// The element structures are constructed on demand
+	check((ce = cp_cfg_tree_element(tree, &status)) != NULL && status == CP_OK);
+	check(cp_cfg_tree_element(tree, NULL) == ce);
+	check(ce->parent == NULL && ce->num_children == 1 && !strcmp(ce->name, "extension"));
+	check((ce = cp_lookup_cfg_element(ce, "structure/deeper/struct/is")) != NULL && !strcmp(ce->value, "here"));
+	check((str = cp_lookup_cfg_value(ce, "../../../../@name")) != NULL && !strcmp(str, "Extension 1"));
+	check((ce = cp_lookup_cfg_element(ce, "../../../parameter")) != NULL && ce->index == 0);
+	check(ce->parent->children[1].index == 1 && !strcmp(ce->parent->children[1].value, "param2"));
+	
+	cp_free_cfg_tree(tree);
+	cp_destroy_context(ctx);
+	check(errors == 0);
+}
+
+void extcfgindexed(void) {
+	static const char * const names[] = { "m", "b", "x", "a", "b", "zz", "c", "b", "z", "d" };
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_cfg_element_t *cfg, *ce;
+	char buffer[2048];
+	char path[16];
+	const char *str;
+	int errors;
+	cp_status_t status;
+	int i, len;
+	
+	// Construct a descriptor with many children and attributes
+	len = sprintf(buffer, "<plugin id=\"indexed\"><extension point=\"indexed.extpt\" id=\"ext\"><config");
+	for (i = 0; i < 12; i++) {
+		len += sprintf(buffer + len, " att%d=\"%d\"", 11 - i, 11 - i);
+	}
+	len += sprintf(buffer + len, ">");
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		len += sprintf(buffer + len, "<%s>%d</%s>", names[i], i, names[i]);
+	}
+	len += sprintf(buffer + len, "</config></extension></plugin>");
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((plugin = cp_load_plugin_descriptor_from_memory(ctx, buffer, len, &status)) != NULL && status == CP_OK);
+	check(plugin->num_extensions == 1);
+	check((cfg = cp_lookup_cfg_element(plugin->extensions[0].configuration, "config")) != NULL);
+	check(cfg->num_children == sizeof(names) / sizeof(names[0]));
+	
+	// The first child of the same name is found
+	for (i = 0; i < cfg->num_children; i++) {
+		int first;
+		
+		for (first = 0; strcmp(names[first], names[i]); first++);
+		check((ce = lookup_compiled(cfg, names[i])) != NULL && ce == cfg->children + first);
+	}
+	check((str = cp_lookup_cfg_value(cfg, "b")) != NULL && !strcmp(str, "1"));
+	check(lookup_compiled(cfg, "") == cfg);
+	check(lookup_compiled(cfg, "zzz") == NULL);
+	check(lookup_compiled(cfg, "0") == NULL);
+	check(lookup_compiled(cfg, "~") == NULL);
+	check((ce = lookup_compiled(cfg, "x/../z")) != NULL && ce->index == 8);
+	
+	// Attributes are found by name
+	for (i = 0; i < 12; i++) {
+		sprintf(path, "@att%d", i);
+		check((str = lookup_compiled_value(cfg, path)) != NULL && atoi(str) == i);
+	}
+	check(lookup_compiled_value(cfg, "@att") == NULL);
+	check(lookup_compiled_value(cfg, "@att12") == NULL);
+	check(lookup_compiled_value(cfg, "@b") == NULL);
+	
+	cp_release_info(ctx, plugin);
+	cp_destroy_context(ctx);
+	check(errors == 0);
+}
+
+void extcfglazy(void) {
+	static const char descriptor[] =
+		"<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n"
+		"<plugin id=\"lazy\">\n"
+		"\t<extension-point id=\"extpt\"/>\n"
+		"\t<extension point=\"lazy.extpt\" id=\"ext1\"><a x=\"1\">\xe4<b>2</b></a></extension>\n"
+		"\t<extension point=\"lazy.extpt\" id=\"ext2\" name=\"Extension 2\"/>\n"
+		"\t<extension point=\"lazy.extpt\" id=\"ext3\"><c>3</c></extension>\n"
+		"</plugin>\n";
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_extension_t **exts;
+	cp_extension_t *ext;
+	cp_cfg_element_t *ce;
+	const char *str;
+	FILE *f;
+	int errors;
+	cp_status_t status;
+	int i, n;
+	
+	// Configuration is not parsed until accessed
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	cp_set_lazy_ext_configuration(ctx, 1);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	for (i = 0, ext = NULL; i < plugin->num_extensions; i++) {
+		cp_extension_t *e = plugin->extensions + i;
+		check(e->configuration == NULL);
+		if (e->identifier != NULL && !strcmp(e->local_id, "ext1")) {
+			ext = e;
+		}
+	}
+	check(ext != NULL);
+	
+	// Configuration is parsed on first access
+	check((ce = cp_get_ext_configuration(ctx, ext, &status)) != NULL && status == CP_OK);
+	check(ce == ext->configuration && !strcmp(ce->name, "extension"));
+	check((ce = cp_lookup_cfg_element(ce, "structure/deeper/struct/is")) != NULL && ce->value != NULL && strcmp(ce->value, "here") == 0);
+	check((str = cp_lookup_cfg_value(ext->configuration, "structure/parameter")) != NULL && strcmp(str, "parameter") == 0);
+	check((str = cp_lookup_cfg_value(ext->configuration, "@name")) != NULL && strcmp(str, "Extension 1") == 0);
+	check(cp_get_ext_configuration(ctx, ext, NULL) == ext->configuration);
+	for (i = 0; i < plugin->num_extensions; i++) {
+		check(plugin->extensions + i == ext || plugin->extensions[i].configuration == NULL);
+	}
+	cp_release_info(ctx, plugin);
+	
+	// Create a descriptor with a declared encoding
+	remove("tmp/lazy/plugin.xml");
+	rmdir("tmp/lazy");
+	check(mkdir("tmp/lazy", 0777) == 0);
+	check((f = fopen("tmp/lazy/plugin.xml", "w")) != NULL);
+	check(fputs(descriptor, f) >= 0);
+	check(fclose(f) == 0);
+	
+	// Extension information functions parse the configuration
+	check((plugin = cp_load_plugin_descriptor(ctx, "tmp/lazy", &status)) != NULL && status == CP_OK);
+	check(plugin->num_extensions == 3 && plugin->extensions[0].configuration == NULL);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	check((exts = cp_get_extensions_info(ctx, "lazy.extpt", &status, &n)) != NULL && status == CP_OK && n == 3);
+	for (i = 0; i < n; i++) {
+		check(exts[i]->configuration != NULL && !strcmp(exts[i]->configuration->name, "extension"));
+	}
+	check((str = cp_lookup_cfg_value(plugin->extensions[0].configuration, "a")) != NULL && !strcmp(str, "\xc3\xa4"));
+	check((str = cp_lookup_cfg_value(plugin->extensions[0].configuration, "a/@x")) != NULL && !strcmp(str, "1"));
+	check((str = cp_lookup_cfg_value(plugin->extensions[0].configuration, "a/b")) != NULL && !strcmp(str, "2"));
+	check((str = cp_lookup_cfg_value(plugin->extensions[1].configuration, "@name")) != NULL && !strcmp(str, "Extension 2"));
+	check(plugin->extensions[1].configuration->num_children == 0);
+	check((str = cp_lookup_cfg_value(plugin->extensions[2].configuration, "c")) != NULL && !strcmp(str, "3"));
+	cp_release_info(ctx, exts);
+	cp_release_info(ctx, plugin);
+	check(errors == 0);
+	
+	// Configuration is not parsed from a modified descriptor
+	check((plugin = cp_load_plugin_descriptor(ctx, "tmp/lazy", &status)) != NULL && status == CP_OK);
+	check((f = fopen("tmp/lazy/plugin.xml", "a")) != NULL);
+	check(fputs("<!-- modified -->\n", f) >= 0);
+	check(fclose(f) == 0);
+	check(cp_get_ext_configuration(ctx, plugin->extensions + 2, &status) == NULL && status == CP_ERR_IO);
+	check(plugin->extensions[2].configuration == NULL);
+	check(errors == 1);
+	cp_release_info(ctx, plugin);
+	
+	cp_destroy_context(ctx);
+	remove("tmp/lazy/plugin.xml");
+	rmdir("tmp/lazy");
+}
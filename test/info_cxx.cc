@@ -0,0 +1,152 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+#include <cstring>
+#include <iterator>
+#include "test_cxx.h"
+
+static int count_elements(const cpluff::cfg_element& ce) {
+	int n = 1;
+	cpluff::cfg_element::children_range children = ce.children();
+	for (cpluff::cfg_element::children_range::iterator i = children.begin(); i != children.end(); ++i) {
+		check(i->has_parent() && i->parent().c_element() == ce.c_element());
+		n += count_elements(*i);
+	}
+	return n;
+}
+
+extern "C" void infoviews_cxx(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *pi;
+	cp_status_t status;
+	int errors;
+
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((pi = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	do {
+		cpluff::plugin_info info(ctx, pi);
+		cpluff::plugin_info copy = info;
+
+		// Views refer to the C API information without copying it
+		check(copy.c_info() == pi);
+		check(!strcmp(info.identifier(), "maximal"));
+		check(!strcmp(info.version(), "1.0.0.max"));
+
+		cpluff::plugin_info::imports_range imports = info.imports();
+		check(imports.size() == 4);
+		check(!strcmp(imports[1].plugin_id(), "dependency2"));
+		check(imports[0].optional() && !imports[1].optional());
+		check(imports.begin()->version() != NULL);
+		check(std::distance(imports.begin(), imports.end()) == 4);
+
+		cpluff::plugin_info::ext_points_range ext_points = info.ext_points();
+		check(ext_points.size() == 4);
+		check(!strcmp(ext_points[0].identifier(), "maximal.extpt1"));
+		check(ext_points[3].schema_path() == NULL);
+
+		cpluff::plugin_info::extensions_range exts = info.extensions();
+		check(exts.size() == 4 && !exts.empty());
+		cpluff::cfg_element root = exts[0].configuration();
+		check(!strcmp(root.name(), "extension"));
+		check(!root.has_parent());
+		check(!strcmp(root.attribute("id"), "ext1"));
+		check(!strcmp(root.attribute("point"), "nonexisting.extptA"));
+		check(root.attribute("nonexisting") == NULL);
+		check(root.num_attributes() == 3);
+		check(count_elements(root) == 8);
+
+		cpluff::cfg_element structure = root.children()[0];
+		check(!strcmp(structure.name(), "structure"));
+		check(!strcmp(structure.children()[1].value(), "param2"));
+		check(!strcmp(structure.children()[2].value(), "1<2"));
+
+		// Information stays valid while any copy of the handle exists
+		info = copy;
+	} while (0);
+	cp_destroy();
+	check(errors == 0);
+}
+
+struct ext_name {
+	const char* name;
+
+	static bool decode(const cpluff::cfg_element& cfg, ext_name& value) {
+		return (value.name = cfg.attribute("name")) != NULL;
+	}
+};
+
+extern "C" void extregistry_cxx(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *pi;
+	cp_status_t status;
+	int errors;
+
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((pi = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	do {
+		cpluff::extension_registry<ext_name> *r1 = new cpluff::extension_registry<ext_name>(ctx, "maximal.extpt1");
+		cpluff::extension_registry<ext_name> r2(ctx, "maximal.extpt1");
+		cpluff::extension_registry<ext_name> unnamed(ctx, "nonexisting.extptB");
+		check(r1->empty() && r2.empty());
+
+		// Extensions are decoded on installation
+		check(cp_install_plugin(ctx, pi) == CP_OK);
+		check(r1->size() == 1 && r2.size() == 1);
+		check(!strcmp(r2[0].name, "Extension 3"));
+		check(!strcmp(r2.plugin_id(0), "maximal"));
+		check(unnamed.empty());
+
+		// A registry created later sees the installed extensions
+		do {
+			cpluff::extension_registry<ext_name> r3(ctx, "maximal.extpt1");
+			check(r3.size() == 1 && !strcmp(r3.begin()->name, "Extension 3"));
+		} while (0);
+
+		// Destroying a registry does not affect the others
+		delete r1;
+		check(cp_uninstall_plugin(ctx, "maximal") == CP_OK);
+		check(r2.empty());
+	} while (0);
+	cp_release_info(ctx, pi);
+	cp_destroy();
+	check(errors == 0);
+}
+
+extern "C" void loadnothrow_cxx(void) {
+	int errors;
+
+	do {
+		shared_ptr<cpluff::plugin_container> pc = init_container_cxx(cpluff::logger::ERROR, &errors);
+		cpluff::result<cpluff::plugin_info> r = pc.get()->try_load_plugin_descriptor(plugindir("minimal"));
+		check(r.ok() && !strcmp(r.value().identifier(), "minimal"));
+		check(!strcmp(pc.get()->load_plugin_info(plugindir("minimal")).identifier(), "minimal"));
+		check(errors == 0);
+
+		// Failures are returned and logged via the registered logger
+		r = pc.get()->try_load_plugin_descriptor(plugindir("nonexisting"));
+		check(!r.ok() && r.error().reason() == cpluff::api_error::IO);
+		check(r.error().message() != NULL);
+		check(pc.get()->try_register_plugin_collection(plugindir("")));
+	} while (0);
+	check(errors > 0);
+}
@@ -22,6 +22,7 @@
  *-----------------------------------------------------------------------*/
 
 #include <stdio.h>
+#include <string.h>
 #include "test.h"
 #include <cpluff.h>
 
@@ -123,3 +124,39 @@ void initstartdestroyboth(void) {
 		check(errors == 0);
 	}
 }
+
+void initlockprofile(void) {
+	cp_context_t *ctx;
+	cp_lock_stats_t *stats;
+	cp_status_t status;
+	int errors;
+	int num;
+	int i;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_get_lock_stats(ctx, &status, NULL) == NULL && status == CP_ERR_UNKNOWN);
+#ifdef CP_THREADS
+	check(cp_set_lock_profiling(ctx, 1) == CP_OK);
+	check(cp_register_pcollection(ctx, "tmp/install/plugins") == CP_OK);
+	cp_unregister_pcollections(ctx);
+	check((stats = cp_get_lock_stats(ctx, &status, &num)) != NULL && status == CP_OK);
+	for (i = 0; i < num; i++) {
+		if (stats[i].function != NULL && !strcmp(stats[i].function, "cp_register_pcollection")) {
+			break;
+		}
+	}
+	check(i < num);
+	check(stats[i].acquisitions >= 1);
+	check(stats[i].contended <= stats[i].acquisitions);
+	check(stats[i].max_hold_usecs <= stats[i].hold_usecs);
+	cp_release_info(ctx, stats);
+	check(cp_set_lock_profiling(ctx, 0) == CP_OK);
+	check(cp_get_lock_stats(ctx, &status, NULL) == NULL && status == CP_ERR_UNKNOWN);
+#else
+	(void) stats;
+	(void) num;
+	(void) i;
+#endif
+	cp_destroy();
+	check(errors == 0);
+}
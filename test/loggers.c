@@ -245,3 +245,185 @@ void islogged(void) {
 	islogged_sev(ctx, CP_LOG_ERROR);
 	cp_destroy();
 }
+
+void sharedlookuplogger(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_status_t status;
+	struct log_count_t lcw = { CP_LOG_WARNING, 0, 0 };
+	struct log_count_t lcd = { CP_LOG_DEBUG, 0, 0 };
+
+	// Warnings are reported after releasing shared access
+	ctx = init_context(CP_LOG_ERROR, NULL);
+	check(cp_register_logger(ctx, counting_logger, &lcw, CP_LOG_WARNING) == CP_OK);
+	check(cp_get_plugin_info(ctx, "nonexisting", &status) == NULL && status == CP_ERR_UNKNOWN);
+	check(lcw.count_max > 0 && lcw.count_above_max == 0);
+	check(cp_get_plugin_state(ctx, "nonexisting") == CP_PLUGIN_UNINSTALLED);
+	check(!cp_is_logged(ctx, CP_LOG_INFO));
+	
+	// Debug messages are logged when falling back to exclusive access
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check(cp_register_logger(ctx, counting_logger, &lcd, CP_LOG_DEBUG) == CP_OK);
+	check((plugin = cp_get_plugin_info(ctx, "minimal", &status)) != NULL && status == CP_OK);
+	check(lcd.count_max > 0);
+	cp_release_info(ctx, plugin);
+	cp_destroy();
+}
+
+struct async_log_t {
+	int received;
+	int last;
+	int in_order;
+	unsigned long dropped;
+};
+
+static void async_logger(cp_log_severity_t severity, const char *msg, const char *apid, void *user_data) {
+	struct async_log_t *al = user_data;
+	unsigned long dropped;
+	int n;
+	
+	if (sscanf(msg, "message %d", &n) == 1) {
+		al->received++;
+		if (n <= al->last) {
+			al->in_order = 0;
+		}
+		al->last = n;
+	} else if (severity == CP_LOG_WARNING && sscanf(msg, "%lu", &dropped) == 1) {
+		al->dropped += dropped;
+	}
+}
+
+void asynclogger(void) {
+	cp_context_t *ctx;
+	struct async_log_t al = { 0, 0, 1, 0 };
+	int errors;
+	int i;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_logger(ctx, async_logger, &al, CP_LOG_INFO) == CP_OK);
+	check(cp_set_async_logging(ctx, 4) == CP_OK);
+	for (i = 1; i <= 100; i++) {
+		char msg[32];
+		
+		sprintf(msg, "message %d", i);
+		cp_log(ctx, CP_LOG_INFO, msg);
+	}
+	
+	// Disabling asynchronous logging delivers the queued messages
+	check(cp_set_async_logging(ctx, 0) == CP_OK);
+	check(al.in_order);
+	check(al.received > 0);
+	check(al.received + al.dropped == 100);
+	
+	// Messages are delivered synchronously again
+	cp_log(ctx, CP_LOG_INFO, "message 101");
+	check(al.last == 101);
+	
+	// Queued messages are delivered on destruction
+	check(cp_set_async_logging(ctx, 16) == CP_OK);
+	cp_log(ctx, CP_LOG_INFO, "message 102");
+	cp_destroy();
+	check(al.last == 102);
+	check(errors == 0);
+}
+
+struct structured_log_t {
+	int logger_registered;
+	int installed;
+	int text;
+};
+
+static void structured_logger(const cp_log_record_t *rec, void *user_data) {
+	struct structured_log_t *sl = user_data;
+	
+	switch (rec->msg_id) {
+		case CP_MSG_LOGGER_REGISTERED:
+			if (rec->apid == NULL) {
+				sl->logger_registered++;
+			}
+			break;
+		case CP_MSG_PLUGIN_STATE:
+			if (rec->plugin_id != NULL && !strcmp(rec->plugin_id, "minimal")
+				&& rec->old_state == CP_PLUGIN_UNINSTALLED
+				&& rec->new_state == CP_PLUGIN_INSTALLED) {
+				sl->installed++;
+			}
+			break;
+		case CP_MSG_TEXT:
+			if (rec->text != NULL && !strcmp(rec->text, "structured text")) {
+				sl->text++;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+void structuredlogger(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *pi;
+	cp_status_t status;
+	struct structured_log_t sl = { 0, 0, 0 };
+	int errors;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_structured_logger(ctx, structured_logger, &sl, CP_LOG_DEBUG) == CP_OK);
+	check((pi = cp_load_plugin_descriptor(ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, pi) == CP_OK);
+	cp_release_info(ctx, pi);
+	cp_log(ctx, CP_LOG_INFO, "structured text");
+	cp_unregister_structured_logger(ctx, structured_logger);
+	cp_log(ctx, CP_LOG_INFO, "structured text");
+	cp_destroy();
+	check(sl.logger_registered == 1);
+	check(sl.installed == 1);
+	check(sl.text == 1);
+	check(errors == 0);
+}
+
+struct plugin_log_t {
+	int selected;
+	int other;
+};
+
+static void plugin_logger(cp_log_severity_t severity, const char *msg, const char *apid, void *user_data) {
+	struct plugin_log_t *pl = user_data;
+	
+	if (strstr(msg, "minimal") != NULL) {
+		pl->selected++;
+	} else {
+		pl->other++;
+	}
+}
+
+void pluginlogger(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_status_t status;
+	struct plugin_log_t pl = { 0, 0 };
+	int errors;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_plugin_logger(ctx, plugin_logger, &pl, CP_LOG_DEBUG, "minimal") == CP_OK);
+	
+	// Filtered loggers do not select messages unrelated to the plug-in
+	check(!cp_is_logged(ctx, CP_LOG_DEBUG));
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check(pl.selected > 0);
+	check(pl.other == 0);
+	
+	// Unfiltered registration of the same logger selects all messages
+	check(cp_register_logger(ctx, plugin_logger, &pl, CP_LOG_DEBUG) == CP_OK);
+	check(cp_is_logged(ctx, CP_LOG_DEBUG));
+	cp_log(ctx, CP_LOG_DEBUG, "unfiltered");
+	check(pl.other > 0);
+	cp_destroy();
+	check(errors == 0);
+}
@@ -26,6 +26,10 @@
 #include <string.h>
 #include "plugins-source/callbackcounter/callbackcounter.h"
 #include "test.h"
+#ifdef HAVE_POLL_H
+#include <unistd.h>
+#include <poll.h>
+#endif
 
 static char *argv[] = { "testarg0", NULL };
 
@@ -117,3 +121,406 @@ void plugincallbacks(void) {
 	/* Free the counter data that was intentionally leaked by the plug-in */
 	free(counters);
 }
+
+void pluginrunparallel(void) {
+	cp_context_t *ctx;
+	cp_status_t status;
+	cp_plugin_info_t *plugin;
+	int errors;
+	cbc_counters_t *counters;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((plugin = cp_load_plugin_descriptor(ctx, "tmp/install/plugins/callbackcounter", &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check((counters = cp_resolve_symbol(ctx, "callbackcounter", "cbc_counters", &status)) != NULL && status == CP_OK);
+	check(counters->run == 0);
+
+	// Run run function until no more work to be done using several threads
+	cp_run_plugins_parallel(ctx, 4);
+	check(counters->run == 3);
+	check(!cp_run_plugins_step(ctx));
+	cp_release_symbol(ctx, counters);
+
+	// Stop plug-in
+	check(cp_stop_plugin(ctx, "callbackcounter") == CP_OK);
+	check(counters->stop == 1);
+	check(counters->run == 3);
+	
+	cp_destroy();
+	check(errors == 0);
+	
+	/* Free the counter data that was intentionally leaked by the plug-in */
+	free(counters);
+}
+
+void pluginruntask(void) {
+	cp_context_t *ctx;
+	cp_status_t status;
+	cp_plugin_info_t *plugin;
+	int errors;
+	cbc_counters_t *counters;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((plugin = cp_load_plugin_descriptor(ctx, "tmp/install/plugins/callbackcounter", &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check((counters = cp_resolve_symbol(ctx, "callbackcounter", "cbc_counters", &status)) != NULL && status == CP_OK);
+
+	// The task suspends itself and does not keep the run queue busy
+	cp_run_plugins(ctx);
+	check(counters->run == 3);
+	check(counters->task == 1);
+	check(!cp_run_plugins_step(ctx));
+	check(counters->task == 1);
+
+	// The plug-in listener resumes the task on a plug-in event
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check(!cp_run_plugins_step(ctx));
+	check(counters->task == 2);
+	check(counters->discard == 0);
+	cp_release_symbol(ctx, counters);
+
+	// The unfinished task is discarded when the plug-in stops
+	check(cp_stop_plugin(ctx, "callbackcounter") == CP_OK);
+	check(counters->discard == 1);
+	check(counters->task == 2);
+	
+	cp_destroy();
+	check(errors == 0);
+	
+	/* Free the counter data that was intentionally leaked by the plug-in */
+	free(counters);
+}
+
+void pluginruntimed(void) {
+	static char *timed_argv[] = { "testarg0", "timed", NULL };
+	cp_context_t *ctx;
+	cp_status_t status;
+	cp_plugin_info_t *plugin;
+	int errors;
+	cbc_counters_t *counters;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	cp_set_context_args(ctx, timed_argv);
+	check((plugin = cp_load_plugin_descriptor(ctx, "tmp/install/plugins/callbackcounter", &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check((counters = cp_resolve_symbol(ctx, "callbackcounter", "cbc_counters", &status)) != NULL && status == CP_OK);
+
+	// The timed run function is not due yet but keeps the run queue active
+	while (counters->run < 3) {
+		check(cp_run_plugins_step(ctx));
+	}
+	check(counters->timed == 0);
+	
+	// The run loop sleeps until the timed run function has run three times
+	cp_run_plugins(ctx);
+	check(counters->timed == 3);
+	check(!cp_run_plugins_step(ctx));
+	cp_release_symbol(ctx, counters);
+	
+	cp_destroy();
+	check(errors == 0);
+	
+	/* Free the counter data that was intentionally leaked by the plug-in */
+	free(counters);
+}
+
+void pluginrunfd(void) {
+#ifdef HAVE_POLL_H
+	static char fdarg[16];
+	static char *fd_argv[] = { "testarg0", fdarg, NULL };
+	cp_context_t *ctx;
+	cp_status_t status;
+	cp_plugin_info_t *plugin;
+	int errors;
+	cbc_counters_t *counters;
+	int fds[2];
+	
+	check(pipe(fds) == 0);
+	snprintf(fdarg, sizeof(fdarg), "%d", fds[0]);
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	cp_set_context_args(ctx, fd_argv);
+	check((plugin = cp_load_plugin_descriptor(ctx, "tmp/install/plugins/callbackcounter", &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check((counters = cp_resolve_symbol(ctx, "callbackcounter", "cbc_counters", &status)) != NULL && status == CP_OK);
+	
+	// The run function waits for the file descriptor
+	while (counters->run < 3) {
+		check(cp_run_plugins_step(ctx));
+	}
+	check(cp_run_plugins_step(ctx));
+	check(counters->fdrun == 0);
+	
+	// Readable data makes the run function run to completion
+	check(write(fds[1], "x", 1) == 1);
+	cp_run_plugins(ctx);
+	check(counters->fdrun == 1);
+	check(!cp_run_plugins_step(ctx));
+	cp_release_symbol(ctx, counters);
+	
+	cp_destroy();
+	check(errors == 0);
+	close(fds[0]);
+	close(fds[1]);
+	
+	/* Free the counter data that was intentionally leaked by the plug-in */
+	free(counters);
+#endif
+}
+
+#ifdef HAVE_POLL_H
+static int is_readable(int fd) {
+	struct pollfd pfd;
+	
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+#endif
+
+void pluginrunready(void) {
+#ifdef HAVE_POLL_H
+	cp_context_t *ctx;
+	cp_status_t status;
+	cp_plugin_info_t *plugin;
+	int errors;
+	cbc_counters_t *counters;
+	int fd;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((plugin = cp_load_plugin_descriptor(ctx, "tmp/install/plugins/callbackcounter", &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check((counters = cp_resolve_symbol(ctx, "callbackcounter", "cbc_counters", &status)) != NULL && status == CP_OK);
+	
+	// The descriptor is readable while run functions are waiting
+	check((fd = cp_get_run_fd(ctx)) >= 0);
+	check(cp_get_run_fd(ctx) == fd);
+	check(is_readable(fd));
+	check(cp_run_plugins_for(ctx, 0));
+	check(counters->run == 1);
+	check(is_readable(fd));
+	check(!cp_run_plugins_for(ctx, 1000000));
+	check(counters->run == 3);
+	check(counters->task == 1);
+	check(!is_readable(fd));
+	
+	// A resumed task makes the descriptor readable again
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check(is_readable(fd));
+	check(!cp_run_plugins_for(ctx, 1000000));
+	check(counters->task == 2);
+	check(!is_readable(fd));
+	cp_release_symbol(ctx, counters);
+	
+	cp_destroy();
+	check(errors == 0);
+	
+	/* Free the counter data that was intentionally leaked by the plug-in */
+	free(counters);
+#endif
+}
+
+void pluginrunprio(void) {
+	static char *prio_argv[] = { "testarg0", "prio", NULL };
+	cp_context_t *ctx;
+	cp_status_t status;
+	cp_plugin_info_t *plugin;
+	int errors;
+	cbc_counters_t *counters;
+	unsigned long long usecs;
+	unsigned long calls;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	cp_set_context_args(ctx, prio_argv);
+	check((plugin = cp_load_plugin_descriptor(ctx, "tmp/install/plugins/callbackcounter", &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check((counters = cp_resolve_symbol(ctx, "callbackcounter", "cbc_counters", &status)) != NULL && status == CP_OK);
+	
+	// The interactive run function gets most of the run time even though queued last
+	while (counters->batch < 2) {
+		check(cp_run_plugins_step(ctx));
+	}
+	check(counters->interactive >= 5);
+	cp_run_plugins(ctx);
+	check(counters->batch == 10);
+	check(counters->interactive == 10);
+	
+	// The run time is accounted per plug-in
+	check(cp_get_plugin_run_time(ctx, "callbackcounter", &usecs, &calls) == CP_OK);
+	check(calls == (unsigned long) (counters->run + counters->task + counters->batch + counters->interactive));
+	check(cp_get_plugin_run_time(ctx, "nonexisting", NULL, NULL) == CP_ERR_UNKNOWN);
+	cp_release_symbol(ctx, counters);
+	
+	cp_destroy();
+	check(errors == 0);
+	
+	/* Free the counter data that was intentionally leaked by the plug-in */
+	free(counters);
+}
+
+void pluginstats(void) {
+	cp_context_t *ctx;
+	cp_status_t status;
+	cp_plugin_info_t *plugin;
+	cp_plugin_stats_t stats;
+	int errors;
+	cbc_counters_t *counters;
+	unsigned long long usecs;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((plugin = cp_load_plugin_descriptor(ctx, "tmp/install/plugins/callbackcounter", &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check(cp_get_plugin_stats(ctx, "callbackcounter", &stats) == CP_OK);
+	check(stats.num_starts == 0);
+	check(stats.run_calls == 0);
+	check(stats.create_usecs == 0 && stats.start_usecs == 0);
+	
+	// Starts and run functions are accounted
+	check((counters = cp_resolve_symbol(ctx, "callbackcounter", "cbc_counters", &status)) != NULL && status == CP_OK);
+	cp_run_plugins(ctx);
+	check(cp_get_plugin_stats(ctx, "callbackcounter", &stats) == CP_OK);
+	check(stats.num_starts == 1);
+	check(stats.run_calls == (unsigned long) (counters->run + counters->task));
+	check(cp_get_plugin_run_time(ctx, "callbackcounter", &usecs, NULL) == CP_OK);
+	check(usecs == stats.run_usecs);
+	cp_release_symbol(ctx, counters);
+	
+	// Statistics accumulate over restarts
+	check(cp_stop_plugin(ctx, "callbackcounter") == CP_OK);
+	check(cp_start_plugin(ctx, "callbackcounter") == CP_OK);
+	check(cp_get_plugin_stats(ctx, "callbackcounter", &stats) == CP_OK);
+	check(stats.num_starts == 2);
+	check(cp_get_plugin_stats(ctx, "nonexisting", &stats) == CP_ERR_UNKNOWN);
+	
+	cp_destroy();
+	check(errors == 0);
+	
+	/* Free the counter data that was intentionally leaked by the plug-in */
+	free(counters);
+}
+
+static void main_forked(void *user_data) {
+	int *calls = user_data;
+	
+	(*calls)++;
+}
+
+void pluginfork(void) {
+	cp_context_t *ctx;
+	cp_status_t status;
+	cp_plugin_info_t *plugin;
+	int errors;
+	cbc_counters_t *counters;
+	int calls = 0;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((plugin = cp_load_plugin_descriptor(ctx, "tmp/install/plugins/callbackcounter", &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check(cp_register_fork_handler(ctx, main_forked, &calls) == CP_OK);
+	check((counters = cp_resolve_symbol(ctx, "callbackcounter", "cbc_counters", &status)) != NULL && status == CP_OK);
+	check(counters->forked == 0);
+	cp_release_symbol(ctx, counters);
+	
+	// Handlers are invoked after forking, here in the same process
+	cp_prepare_fork(ctx);
+	cp_after_fork(ctx);
+	check(counters->forked == 1);
+	check(calls == 1);
+	
+	// Handlers of a stopped plug-in are unregistered
+	check(cp_stop_plugin(ctx, "callbackcounter") == CP_OK);
+	cp_after_fork(ctx);
+	check(counters->forked == 1);
+	check(calls == 2);
+	cp_unregister_fork_handler(ctx, main_forked);
+	cp_after_fork(ctx);
+	check(calls == 2);
+	
+	cp_destroy();
+	check(errors == 0);
+	
+	/* Free the counter data that was intentionally leaked by the plug-in */
+	free(counters);
+}
+
+/// A pool task submitted by the pooltasks test
+typedef struct pool_test_task_t {
+	
+	/// The context used for submitting nested tasks
+	cp_context_t *ctx;
+	
+	/// Set when the task has been executed
+	int done;
+	
+	/// A nested task to be submitted and waited for, or NULL
+	struct pool_test_task_t *nested;
+	
+	/// Whether the nested task was executed
+	int nested_executed;
+	
+} pool_test_task_t;
+
+static void pool_test_task(void *arg) {
+	pool_test_task_t *t = arg;
+	
+	if (t->nested != NULL) {
+		cp_task_t *task;
+		
+		if (cp_submit_task(t->ctx, pool_test_task, t->nested, &task) == CP_OK) {
+			t->nested_executed = cp_wait_task(t->ctx, task);
+		}
+	}
+	t->done = 1;
+}
+
+void pooltasks(void) {
+	cp_context_t *ctx;
+	pool_test_task_t tasks[16], nested[16];
+	cp_task_t *handles[16];
+	int errors;
+	int i;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	memset(tasks, 0, sizeof(tasks));
+	memset(nested, 0, sizeof(nested));
+	
+	// Tasks waited for individually, submitting nested tasks
+	for (i = 0; i < 16; i++) {
+		tasks[i].ctx = ctx;
+		tasks[i].nested = nested + i;
+		check(cp_submit_task(ctx, pool_test_task, tasks + i, handles + i) == CP_OK);
+	}
+	for (i = 0; i < 16; i++) {
+		check(cp_wait_task(ctx, handles[i]));
+		check(tasks[i].done && tasks[i].nested_executed && nested[i].done);
+	}
+	
+	// Tasks released automatically and waited for collectively
+	memset(tasks, 0, sizeof(tasks));
+	for (i = 0; i < 16; i++) {
+		check(cp_submit_task(ctx, pool_test_task, tasks + i, NULL) == CP_OK);
+	}
+	cp_wait_tasks(ctx);
+	for (i = 0; i < 16; i++) {
+		check(tasks[i].done);
+	}
+	
+	// Outstanding tasks are cancelled or completed when the context is destroyed
+	for (i = 0; i < 16; i++) {
+		check(cp_submit_task(ctx, pool_test_task, tasks + i, NULL) == CP_OK);
+	}
+	cp_destroy();
+	check(errors == 0);
+}
@@ -157,3 +157,268 @@ void plugindeploop(void) {
 
 	cp_destroy();	
 }
+
+void plugindepparallel(void) {
+	cp_context_t *ctx;
+	int errors;
+	const char * const ids_ok[] = { "chain1", "loop5" };
+	const char * const ids_fail[] = { "chainmissingdep", "sloop1" };
+	const char * const act_ok[] = { "chain1", "chain2", "chain3", "loop1", "loop2", "loop3", "loop4", "loop5", NULL };
+	const char * const act_fail[] = { "chain1", "chain2", "chain3", "loop1", "loop2", "loop3", "loop4", "loop5", "sloop1", "sloop2", NULL };
+	
+	ctx = init_context(CP_LOG_ERROR, NULL);
+	check((cp_register_pcollection(ctx, pcollectiondir("dependencies"))) == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	
+	// Start the chain and the extended loop
+	check(cp_start_plugins_parallel(ctx, ids_ok, 2, 4) == CP_OK);
+	check(active(ctx, act_ok));
+	
+	// Plug-ins with missing dependencies do not prevent starting others
+	check(cp_start_plugins_parallel(ctx, ids_fail, 2, 4) == CP_ERR_DEPENDENCY);
+	check(active(ctx, act_fail));
+	check(cp_start_plugins_parallel(ctx, ids_fail + 1, 1, 0) == CP_OK);
+	cp_destroy();
+	
+	// Start the plug-ins with runtimes using worker threads
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_pcollection(ctx, "tmp/install/plugins") == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_start_plugins_parallel(ctx, NULL, 0, 4) == CP_OK);
+	check(cp_get_plugin_state(ctx, "symuser") == CP_PLUGIN_ACTIVE);
+	check(cp_get_plugin_state(ctx, "symprovider") == CP_PLUGIN_ACTIVE);
+	check(cp_get_plugin_state(ctx, "callbackcounter") == CP_PLUGIN_ACTIVE);
+	cp_destroy();
+	check(errors == 0);
+}
+
+/// Messages counted when resolving all plug-ins
+typedef struct resolve_counts_t {
+	int errors;
+	int loops;
+	int resolved;
+	int batches;
+} resolve_counts_t;
+
+static void count_resolve_messages(cp_log_severity_t severity, const char *msg, const char *apid, void *user_data) {
+	resolve_counts_t *counts = user_data;
+	
+	if (severity >= CP_LOG_ERROR) {
+		counts->errors++;
+	} else if (strstr(msg, "dependency loop") != NULL) {
+		counts->loops++;
+	}
+}
+
+static void count_resolve_events(const cp_plugin_event_t *events, unsigned int num_events, void *user_data) {
+	resolve_counts_t *counts = user_data;
+	unsigned int i;
+	
+	counts->batches++;
+	for (i = 0; i < num_events; i++) {
+		if (events[i].new_state == CP_PLUGIN_RESOLVED) {
+			counts->resolved++;
+		}
+	}
+}
+
+void pluginresolveall(void) {
+	cp_context_t *ctx;
+	resolve_counts_t counts;
+	const char * const resolved[] = { "chain1", "chain2", "chain3", "loop1", "loop2", "loop3", "loop4", "loop5", "sloop1", "sloop2", NULL };
+	int i;
+	
+	memset(&counts, 0, sizeof(counts));
+	ctx = init_context(CP_LOG_ERROR + 1, NULL);
+	check(cp_register_pcollection(ctx, pcollectiondir("dependencies")) == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_register_logger(ctx, count_resolve_messages, &counts, CP_LOG_INFO) == CP_OK);
+	check(cp_register_batch_plistener(ctx, count_resolve_events, &counts) == CP_OK);
+	
+	// All plug-ins are resolved at once and all the loops are reported
+	check(cp_resolve_plugins(ctx) == CP_ERR_DEPENDENCY);
+	cp_flush_plugin_events(ctx);
+	for (i = 0; resolved[i] != NULL; i++) {
+		check(cp_get_plugin_state(ctx, resolved[i]) == CP_PLUGIN_RESOLVED);
+	}
+	check(cp_get_plugin_state(ctx, "missingdep") == CP_PLUGIN_INSTALLED);
+	check(cp_get_plugin_state(ctx, "chainmissingdep") == CP_PLUGIN_INSTALLED);
+	check(counts.errors == 2);
+	check(counts.loops == 2);
+	check(counts.resolved == 10);
+	check(counts.batches == 1);
+	
+	// The result is cached until plug-ins are installed or uninstalled
+	check(cp_resolve_plugins(ctx) == CP_ERR_DEPENDENCY);
+	cp_flush_plugin_events(ctx);
+	check(counts.errors == 2);
+	check(counts.resolved == 10);
+	
+	// Starting all plug-ins uses the resolution order
+	check(cp_start_plugins_parallel(ctx, NULL, 0, 0) == CP_ERR_DEPENDENCY);
+	check(active(ctx, resolved));
+	cp_stop_plugins(ctx);
+	
+	// Uninstalling a plug-in unresolves the plug-ins depending on it
+	check(cp_uninstall_plugin(ctx, "chain3") == CP_OK);
+	check(cp_get_plugin_state(ctx, "chain1") == CP_PLUGIN_INSTALLED);
+	check(cp_resolve_plugins(ctx) == CP_ERR_DEPENDENCY);
+	check(cp_get_plugin_state(ctx, "chain1") == CP_PLUGIN_INSTALLED);
+	check(cp_get_plugin_state(ctx, "chain2") == CP_PLUGIN_INSTALLED);
+	check(cp_get_plugin_state(ctx, "loop1") == CP_PLUGIN_RESOLVED);
+	check(counts.errors == 6);
+	cp_unregister_logger(ctx, count_resolve_messages);
+	cp_destroy();
+}
+
+static void count_preload_messages(cp_log_severity_t severity, const char *msg, const char *apid, void *user_data) {
+	resolve_counts_t *counts = user_data;
+	
+	if (severity >= CP_LOG_ERROR) {
+		counts->errors++;
+	} else if (strstr(msg, "was opened in") != NULL) {
+		counts->resolved++;
+	}
+}
+
+void pluginpreload(void) {
+	cp_context_t *ctx;
+	resolve_counts_t counts;
+	const char * const resolved[] = { "chain1", "chain2", "chain3", "loop1", "loop2", "loop3", "loop4", "loop5", "sloop1", "sloop2", NULL };
+	int i;
+	
+	// Dependencies are checked as without preloading
+	ctx = init_context(CP_LOG_ERROR + 1, NULL);
+	cp_set_runtime_preloading(ctx, 4, 0);
+	check(cp_register_pcollection(ctx, pcollectiondir("dependencies")) == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_resolve_plugins(ctx) == CP_ERR_DEPENDENCY);
+	for (i = 0; resolved[i] != NULL; i++) {
+		check(cp_get_plugin_state(ctx, resolved[i]) == CP_PLUGIN_RESOLVED);
+	}
+	check(cp_get_plugin_state(ctx, "missingdep") == CP_PLUGIN_INSTALLED);
+	check(cp_get_plugin_state(ctx, "chainmissingdep") == CP_PLUGIN_INSTALLED);
+	cp_destroy();
+	
+	// Runtime libraries are opened by worker threads and prebound
+	memset(&counts, 0, sizeof(counts));
+	ctx = init_context(CP_LOG_ERROR + 1, NULL);
+	cp_set_runtime_preloading(ctx, 4, 1);
+	check(cp_register_logger(ctx, count_preload_messages, &counts, CP_LOG_DEBUG) == CP_OK);
+	check(cp_register_pcollection(ctx, "tmp/install/plugins") == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_start_plugins_parallel(ctx, NULL, 0, 4) == CP_OK);
+	check(cp_get_plugin_state(ctx, "symuser") == CP_PLUGIN_ACTIVE);
+	check(cp_get_plugin_state(ctx, "symprovider") == CP_PLUGIN_ACTIVE);
+	check(cp_get_plugin_state(ctx, "callbackcounter") == CP_PLUGIN_ACTIVE);
+	check(counts.errors == 0);
+
+	// Load times are reported unless the platform lacks gettimeofday
+	check(counts.resolved == 3 || counts.resolved == 0);
+	cp_unregister_logger(ctx, count_preload_messages);
+	cp_destroy();
+}
+
+void pluginlazyruntime(void) {
+	cp_context_t *ctx;
+	cp_status_t status;
+	int errors;
+	
+	// Missing runtime libraries are detected when resolving by default
+	ctx = init_context(CP_LOG_ERROR + 1, &errors);
+	check(cp_register_pcollection(ctx, pcollectiondir("lazyruntime")) == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_resolve_plugins(ctx) == CP_ERR_RUNTIME);
+	check(cp_get_plugin_state(ctx, "brokenlib") == CP_PLUGIN_INSTALLED);
+	check(cp_get_plugin_state(ctx, "usesbroken") == CP_PLUGIN_INSTALLED);
+	cp_destroy();
+	check(errors == 2);
+	
+	// Lazily they are detected only when starting or resolving symbols
+	ctx = init_context(CP_LOG_ERROR + 1, &errors);
+	cp_set_lazy_runtime_loading(ctx, 1);
+	check(cp_register_pcollection(ctx, pcollectiondir("lazyruntime")) == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_resolve_plugins(ctx) == CP_OK);
+	check(cp_get_plugin_state(ctx, "brokenlib") == CP_PLUGIN_RESOLVED);
+	check(cp_get_plugin_state(ctx, "usesbroken") == CP_PLUGIN_RESOLVED);
+	check(errors == 0);
+	check(cp_start_plugin(ctx, "usesbroken") == CP_ERR_RUNTIME);
+	check(cp_get_plugin_state(ctx, "brokenlib") == CP_PLUGIN_RESOLVED);
+	check(cp_get_plugin_state(ctx, "usesbroken") == CP_PLUGIN_RESOLVED);
+	check(cp_resolve_symbol(ctx, "brokenlib", "funcs", &status) == NULL && status == CP_ERR_RUNTIME);
+	cp_destroy();
+	check(errors > 0);
+	
+	// Runtime libraries are loaded when the plug-ins are started
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	cp_set_lazy_runtime_loading(ctx, 1);
+	check(cp_register_pcollection(ctx, "tmp/install/plugins") == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_resolve_plugins(ctx) == CP_OK);
+	check(cp_get_plugin_state(ctx, "symuser") == CP_PLUGIN_RESOLVED);
+	check(cp_start_plugins_parallel(ctx, NULL, 0, 4) == CP_OK);
+	check(cp_get_plugin_state(ctx, "symuser") == CP_PLUGIN_ACTIVE);
+	check(cp_get_plugin_state(ctx, "symprovider") == CP_PLUGIN_ACTIVE);
+	check(cp_get_plugin_state(ctx, "callbackcounter") == CP_PLUGIN_ACTIVE);
+	cp_destroy();
+	check(errors == 0);
+}
+
+/// Stop order recorded by a plug-in listener
+typedef struct stop_order_t {
+	int num_stopped;
+	int chain1;
+	int chain2;
+	int chain3;
+} stop_order_t;
+
+static void record_stop_order(const char *plugin_id, cp_plugin_state_t old_state, cp_plugin_state_t new_state, void *user_data) {
+	stop_order_t *order = user_data;
+	
+	if (new_state != CP_PLUGIN_RESOLVED || old_state < CP_PLUGIN_STOPPING) {
+		return;
+	}
+	order->num_stopped++;
+	if (!strcmp(plugin_id, "chain1")) {
+		order->chain1 = order->num_stopped;
+	} else if (!strcmp(plugin_id, "chain2")) {
+		order->chain2 = order->num_stopped;
+	} else if (!strcmp(plugin_id, "chain3")) {
+		order->chain3 = order->num_stopped;
+	}
+}
+
+void pluginstopparallel(void) {
+	cp_context_t *ctx;
+	stop_order_t order;
+	const char * const act_none[] = { NULL };
+	int errors;
+	
+	// Importing plug-ins are stopped first, loops included
+	memset(&order, 0, sizeof(order));
+	ctx = init_context(CP_LOG_ERROR + 1, NULL);
+	check(cp_register_pcollection(ctx, pcollectiondir("dependencies")) == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_start_plugins_parallel(ctx, NULL, 0, 4) == CP_ERR_DEPENDENCY);
+	check(cp_register_plistener(ctx, record_stop_order, &order) == CP_OK);
+	cp_stop_plugins_parallel(ctx, 4);
+	check(active(ctx, act_none));
+	check(order.num_stopped == 10);
+	check(order.chain1 < order.chain2 && order.chain2 < order.chain3);
+	cp_destroy();
+	
+	// Plug-ins with runtimes are stopped by worker threads
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	cp_set_runtime_library_unloading(ctx, 0);
+	check(cp_register_pcollection(ctx, "tmp/install/plugins") == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_start_plugins_parallel(ctx, NULL, 0, 4) == CP_OK);
+	cp_stop_plugins_parallel(ctx, 4);
+	check(active(ctx, act_none));
+	check(cp_get_plugin_state(ctx, "symuser") == CP_PLUGIN_RESOLVED);
+	cp_uninstall_plugins(ctx);
+	check(cp_get_plugin_state(ctx, "symuser") == CP_PLUGIN_UNINSTALLED);
+	cp_destroy();
+	check(errors == 0);
+}
@@ -22,7 +22,15 @@
  *-----------------------------------------------------------------------*/
 
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <time.h>
+#include <utime.h>
 #include "test.h"
+#if defined(CP_THREADS) && !defined(_WIN32)
+#include <pthread.h>
+#endif
 
 void install(void) {
 	cp_context_t *ctx;
@@ -99,3 +107,863 @@ void uninstall(void) {
 	cp_destroy();
 	check(errors == 0);	
 }
+
+static int builtin_calls[3];
+
+static void *builtin_create(cp_context_t *ctx) {
+	builtin_calls[0]++;
+	return builtin_calls;
+}
+
+static int builtin_start(void *data) {
+	builtin_calls[1]++;
+	return CP_OK;
+}
+
+static void builtin_destroy(void *data) {
+	builtin_calls[2]++;
+}
+
+static int builtin_value = 42;
+
+void installbuiltin(void) {
+	static const char descriptor[] =
+		"<plugin id=\"builtin\"><runtime library=\"nonexisting\" funcs=\"nonexisting\"/></plugin>";
+	static cp_plugin_runtime_t runtime = { builtin_create, builtin_start, NULL, builtin_destroy };
+	static const cp_builtin_symbol_t symbols[] = {
+		{ "builtin_value", &builtin_value },
+		{ NULL, NULL }
+	};
+	cp_context_t *ctx;
+	cp_status_t status;
+	int *value;
+	int errors;
+	
+	// The declared runtime library is not needed for resolving or starting
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_install_builtin_plugin(ctx, descriptor, sizeof(descriptor) - 1, &runtime, symbols) == CP_OK);
+	check(cp_get_plugin_state(ctx, "builtin") == CP_PLUGIN_INSTALLED);
+	check((value = cp_resolve_symbol(ctx, "builtin", "builtin_value", &status)) != NULL && status == CP_OK);
+	check(value == &builtin_value);
+	check(builtin_calls[0] == 1 && builtin_calls[1] == 1);
+	check(cp_get_plugin_state(ctx, "builtin") == CP_PLUGIN_ACTIVE);
+	cp_release_symbol(ctx, value);
+	check(cp_uninstall_plugin(ctx, "builtin") == CP_OK);
+	check(builtin_calls[2] == 1);
+	cp_destroy();
+	check(errors == 0);
+}
+
+void changefeed(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_change_t *changes;
+	cp_status_t status;
+	unsigned long gen;
+	int errors;
+	int num;
+	int i;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_get_generation(ctx) == 0);
+	check((changes = cp_get_changes(ctx, 0, &status, &num)) != NULL && status == CP_OK && num == 0);
+	check(changes[0].generation == 0);
+	cp_release_info(ctx, changes);
+	
+	// Installation advances the generations
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	gen = cp_get_generation(ctx);
+	check(gen > 0);
+	check(cp_get_plugins_generation(ctx) > 0 && cp_get_plugins_generation(ctx) <= gen);
+	check(cp_get_extensions_generation(ctx, "maximal.extpt1") > 0);
+	check(cp_get_plugin_generation(ctx, "maximal") == gen);
+	check((changes = cp_get_changes(ctx, 0, &status, &num)) != NULL && status == CP_OK && num > 2);
+	check(changes[0].type == CP_CHANGE_PLUGINS && !strcmp(changes[0].id, "maximal"));
+	for (i = 1; i < num - 1; i++) {
+		check(changes[i].type == CP_CHANGE_EXTENSIONS);
+		check(changes[i].generation > changes[i - 1].generation);
+	}
+	check(changes[num - 1].type == CP_CHANGE_PLUGIN_STATE && changes[num - 1].generation == gen);
+	check(changes[num].generation == 0);
+	cp_release_info(ctx, changes);
+	
+	// Only the changes after the specified generation are returned
+	check(cp_uninstall_plugin(ctx, "maximal") == CP_OK);
+	check(cp_get_plugins_generation(ctx) > gen);
+	check((changes = cp_get_changes(ctx, gen, &status, &num)) != NULL && status == CP_OK && num > 2);
+	check(changes[0].type == CP_CHANGE_PLUGIN_STATE && changes[0].generation == gen + 1);
+	check(changes[1].type == CP_CHANGE_PLUGINS && !strcmp(changes[1].id, "maximal"));
+	check(changes[num - 1].generation == cp_get_generation(ctx));
+	cp_release_info(ctx, changes);
+	
+	// Discarded changes are reported as a reset
+	for (i = 0; i < 50; i++) {
+		check(cp_install_plugin(ctx, plugin) == CP_OK);
+		check(cp_uninstall_plugin(ctx, "maximal") == CP_OK);
+	}
+	cp_release_info(ctx, plugin);
+	check((changes = cp_get_changes(ctx, gen, &status, &num)) != NULL && status == CP_OK && num == 1);
+	check(changes[0].type == CP_CHANGE_RESET && changes[0].id == NULL);
+	check(changes[0].generation == cp_get_generation(ctx));
+	cp_release_info(ctx, changes);
+	
+	cp_destroy();
+	check(errors == 0);
+}
+
+void pluginhandle(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_plugin_handle_t *handle, *handle2;
+	cp_status_t status;
+	int errors;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_get_plugin_handle(ctx, "minimal", &status) == NULL && status == CP_ERR_UNKNOWN);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	
+	// The same handle is returned for the same installed plug-in
+	check((handle = cp_get_plugin_handle(ctx, "minimal", &status)) != NULL && status == CP_OK);
+	check((handle2 = cp_get_plugin_handle(ctx, "minimal", NULL)) == handle);
+	cp_release_info(ctx, handle2);
+	check(cp_get_handle_state(handle) == CP_PLUGIN_INSTALLED);
+	check((plugin = cp_get_handle_info(handle)) != NULL && !strcmp(plugin->identifier, "minimal"));
+	
+	// State changes are visible through the handle
+	check(cp_start_plugin(ctx, "minimal") == CP_OK);
+	check(cp_get_handle_state(handle) == CP_PLUGIN_ACTIVE);
+	check(cp_stop_plugin(ctx, "minimal") == CP_OK);
+	check(cp_get_handle_state(handle) == CP_PLUGIN_RESOLVED);
+	
+	// The handle remains valid after the plug-in has been uninstalled
+	check(cp_uninstall_plugin(ctx, "minimal") == CP_OK);
+	check(cp_get_handle_state(handle) == CP_PLUGIN_UNINSTALLED);
+	check(cp_get_handle_info(handle) == NULL);
+	cp_release_info(ctx, handle);
+	
+	cp_destroy();
+	check(errors == 0);
+}
+
+void extsnapshot(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_ext_snapshot_t *s1, *s2;
+	cp_extension_t * const *exts;
+	cp_status_t status;
+	int errors;
+	int num;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	
+	// Check the contents of the snapshot
+	check((s1 = cp_get_ext_snapshot(ctx, &status)) != NULL && status == CP_OK);
+	check(cp_get_snapshot_ext_points(s1, &num) != NULL && num == 4);
+	check((exts = cp_get_snapshot_extensions(s1, NULL, &num)) != NULL && num == 4 && exts[4] == NULL);
+	check((exts = cp_get_snapshot_extensions(s1, "maximal.extpt1", &num)) != NULL && num == 1);
+	check(!strcmp(exts[0]->name, "Extension 3"));
+	check((exts = cp_get_snapshot_extensions(s1, "nonexisting.extptA", &num)) != NULL && num == 1);
+	check(!strcmp(exts[0]->local_id, "ext1"));
+	check((exts = cp_get_snapshot_extensions(s1, "nonexisting", &num)) != NULL && num == 0 && exts[0] == NULL);
+	
+	// The published snapshot is shared until the registry changes
+	check((s2 = cp_get_ext_snapshot(ctx, NULL)) == s1);
+	cp_release_ext_snapshot(s2);
+	check(cp_uninstall_plugin(ctx, "maximal") == CP_OK);
+	check((s2 = cp_get_ext_snapshot(ctx, &status)) != NULL && status == CP_OK && s2 != s1);
+	check(cp_get_snapshot_ext_points(s2, &num) != NULL && num == 0);
+	check(cp_get_snapshot_extensions(s2, NULL, &num) != NULL && num == 0);
+	cp_release_ext_snapshot(s2);
+	
+	// The old snapshot remains valid until released
+	check((exts = cp_get_snapshot_extensions(s1, "maximal.extpt1", &num)) != NULL && num == 1);
+	check(!strcmp(exts[0]->name, "Extension 3"));
+	cp_release_ext_snapshot(s1);
+	
+	cp_destroy();
+	check(errors == 0);
+}
+
+/// Events recorded by the batch listener
+typedef struct recorded_events_t {
+	int num_events;
+	int num_batches;
+	char ids[8][16];
+	cp_plugin_state_t old_states[8];
+	cp_plugin_state_t new_states[8];
+} recorded_events_t;
+
+static void record_events(const cp_plugin_event_t *events, unsigned int num_events, void *user_data) {
+	recorded_events_t *rec = user_data;
+	unsigned int i;
+	
+	rec->num_batches++;
+	for (i = 0; i < num_events && rec->num_events < 8; i++) {
+		strncpy(rec->ids[rec->num_events], events[i].plugin_id, 15);
+		rec->old_states[rec->num_events] = events[i].old_state;
+		rec->new_states[rec->num_events] = events[i].new_state;
+		rec->num_events++;
+	}
+}
+
+static int count_plugin(const cp_plugin_info_t *plugin, void *user_data) {
+	(*((int *) user_data))++;
+	return 0;
+}
+
+static int count_extension(const cp_extension_t *extension, void *user_data) {
+	(*((int *) user_data))++;
+	return 0;
+}
+
+static int find_extension(const cp_extension_t *extension, void *user_data) {
+	return !strcmp(extension->ext_point_id, user_data) ? 7 : 0;
+}
+
+void extiteration(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_extension_iter_t iter;
+	const cp_extension_t *e;
+	cp_status_t status;
+	int errors;
+	int num;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	
+	// Visit all plug-ins and extensions
+	num = 0;
+	check(cp_for_each_plugin(ctx, count_plugin, &num) == 0 && num == 1);
+	num = 0;
+	check(cp_for_each_extension(ctx, NULL, count_extension, &num) == 0 && num == 4);
+	num = 0;
+	check(cp_for_each_extension(ctx, "nonexisting.extptA", count_extension, &num) == 0 && num == 1);
+	num = 0;
+	check(cp_for_each_extension(ctx, "nonexisting", count_extension, &num) == 0 && num == 0);
+	
+	// The value returned by the visitor stops the iteration
+	check(cp_for_each_extension(ctx, NULL, find_extension, "maximal.extpt1") == 7);
+	
+	// Iterate using a cursor
+	num = 0;
+	cp_begin_extensions(ctx, "maximal.extpt1", &iter);
+	while ((e = cp_next_extension(&iter)) != NULL) {
+		check(!strcmp(e->ext_point_id, "maximal.extpt1"));
+		num++;
+	}
+	check(cp_next_extension(&iter) == NULL);
+	cp_end_extensions(&iter);
+	check(num == 1);
+	cp_begin_extensions(ctx, "nonexisting", &iter);
+	check(cp_next_extension(&iter) == NULL);
+	cp_end_extensions(&iter);
+	
+	cp_destroy();
+	check(errors == 0);
+}
+
+void extorder(void) {
+	static const char remaining[] = { 0, 2, 4, 9 };
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_extension_t **exts;
+	cp_extension_iter_t iter;
+	const cp_extension_t *e;
+	cp_status_t status;
+	char buffer[128];
+	int errors, num, i, len;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	for (i = 0; i < 10; i++) {
+		len = sprintf(buffer, "<plugin id=\"p%d\"><extension point=\"common.extpt\" id=\"e\"/></plugin>", i);
+		check((plugin = cp_load_plugin_descriptor_from_memory(ctx, buffer, len, &status)) != NULL && status == CP_OK);
+		check(cp_install_plugin(ctx, plugin) == CP_OK);
+		cp_release_info(ctx, plugin);
+	}
+	
+	// Removing most of the extensions keeps the installation order of the rest
+	check(cp_uninstall_plugin(ctx, "p1") == CP_OK);
+	check(cp_uninstall_plugin(ctx, "p8") == CP_OK);
+	check(cp_uninstall_plugin(ctx, "p3") == CP_OK);
+	check(cp_uninstall_plugin(ctx, "p7") == CP_OK);
+	check(cp_uninstall_plugin(ctx, "p5") == CP_OK);
+	check(cp_uninstall_plugin(ctx, "p6") == CP_OK);
+	check((exts = cp_get_extensions_info(ctx, "common.extpt", &status, &num)) != NULL && status == CP_OK);
+	check(num == 4);
+	for (i = 0; i < num; i++) {
+		sprintf(buffer, "p%d.e", remaining[i]);
+		check(!strcmp(exts[i]->identifier, buffer));
+	}
+	cp_release_info(ctx, exts);
+	num = 0;
+	cp_begin_extensions(ctx, "common.extpt", &iter);
+	while ((e = cp_next_extension(&iter)) != NULL) {
+		sprintf(buffer, "p%d.e", remaining[num++]);
+		check(!strcmp(e->identifier, buffer));
+	}
+	cp_end_extensions(&iter);
+	check(num == 4);
+	
+	// A new extension is appended after the remaining ones
+	len = sprintf(buffer, "<plugin id=\"p1\"><extension point=\"common.extpt\" id=\"e\"/></plugin>");
+	check((plugin = cp_load_plugin_descriptor_from_memory(ctx, buffer, len, &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check((exts = cp_get_extensions_info(ctx, "common.extpt", &status, &num)) != NULL && status == CP_OK);
+	check(num == 5 && !strcmp(exts[0]->identifier, "p0.e") && !strcmp(exts[4]->identifier, "p1.e"));
+	cp_release_info(ctx, exts);
+	
+	cp_destroy();
+	check(errors == 0);
+}
+
+/// State of a visitor reading the context while a writer waits for it
+typedef struct read_recursion_t {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_status_t status;
+	int visited;
+	int writing;
+#if defined(CP_THREADS) && !defined(_WIN32)
+	pthread_t writer;
+#endif
+} read_recursion_t;
+
+#if defined(CP_THREADS) && !defined(_WIN32)
+static void *install_writer(void *arg) {
+	read_recursion_t *rr = arg;
+	
+	rr->status = cp_install_plugin(rr->ctx, rr->plugin);
+	return NULL;
+}
+#endif
+
+static int read_recursively(const cp_plugin_info_t *plugin, void *user_data) {
+	read_recursion_t *rr = user_data;
+	cp_plugin_info_t *info;
+	cp_status_t status;
+	
+#if defined(CP_THREADS) && !defined(_WIN32)
+	// Let a writer start waiting for the context
+	if (!rr->writing) {
+		check(pthread_create(&(rr->writer), NULL, install_writer, rr) == 0);
+		rr->writing = 1;
+		usleep(100000);
+	}
+#endif
+	
+	// Nested reads must not wait for the waiting writer
+	check(cp_get_plugin_state(rr->ctx, plugin->identifier) == CP_PLUGIN_INSTALLED);
+	check((info = cp_get_plugin_info(rr->ctx, plugin->identifier, &status)) != NULL && status == CP_OK);
+	cp_release_info(rr->ctx, info);
+	check(cp_get_plugin_state(rr->ctx, "minimal") == CP_PLUGIN_UNINSTALLED);
+	rr->visited++;
+	return 0;
+}
+
+void readrecursion(void) {
+	read_recursion_t rr;
+	cp_plugin_info_t *plugin;
+	cp_status_t status;
+	int errors;
+	
+	memset(&rr, 0, sizeof(rr));
+	rr.ctx = init_context(CP_LOG_ERROR, &errors);
+	rr.status = CP_ERR_UNKNOWN;
+	check((plugin = cp_load_plugin_descriptor(rr.ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(rr.ctx, plugin) == CP_OK);
+	cp_release_info(rr.ctx, plugin);
+	check((rr.plugin = cp_load_plugin_descriptor(rr.ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check(cp_for_each_plugin(rr.ctx, read_recursively, &rr) == 0 && rr.visited == 1);
+#if defined(CP_THREADS) && !defined(_WIN32)
+	check(pthread_join(rr.writer, NULL) == 0);
+#else
+	rr.status = cp_install_plugin(rr.ctx, rr.plugin);
+#endif
+	check(rr.status == CP_OK);
+	check(cp_get_plugin_state(rr.ctx, "minimal") == CP_PLUGIN_INSTALLED);
+	cp_release_info(rr.ctx, rr.plugin);
+	cp_destroy();
+	check(errors == 0);
+}
+
+void extprefix(void) {
+	static const char * const points[] = { "codec.video", "codecs", "codec.audio", "codec.audio.mp3", "codec.audio" };
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_extension_t **exts;
+	cp_status_t status;
+	char buffer[128];
+	int errors, num, i, len;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	for (i = 0; i < sizeof(points) / sizeof(points[0]); i++) {
+		len = sprintf(buffer, "<plugin id=\"c%d\"><extension point=\"%s\" id=\"e\"/></plugin>", i, points[i]);
+		check((plugin = cp_load_plugin_descriptor_from_memory(ctx, buffer, len, &status)) != NULL && status == CP_OK);
+		check(cp_install_plugin(ctx, plugin) == CP_OK);
+		cp_release_info(ctx, plugin);
+	}
+	
+	// Only the extension points matching the prefix are included, in order
+	check((exts = cp_get_extensions_info_prefix(ctx, "codec.", &status, &num)) != NULL && status == CP_OK);
+	check(num == 4);
+	check(!strcmp(exts[0]->identifier, "c2.e") && !strcmp(exts[1]->identifier, "c4.e"));
+	check(!strcmp(exts[2]->identifier, "c3.e") && !strcmp(exts[3]->identifier, "c0.e"));
+	check(exts[4] == NULL);
+	cp_release_info(ctx, exts);
+	check((exts = cp_get_extensions_info_prefix(ctx, "nonexisting.ext", &status, &num)) != NULL && status == CP_OK);
+	check(num == 2);
+	cp_release_info(ctx, exts);
+	check((exts = cp_get_extensions_info_prefix(ctx, "", &status, &num)) != NULL && status == CP_OK);
+	check(num == 9);
+	cp_release_info(ctx, exts);
+	check((exts = cp_get_extensions_info_prefix(ctx, "codex", &status, &num)) != NULL && status == CP_OK);
+	check(num == 0 && exts[0] == NULL);
+	cp_release_info(ctx, exts);
+	
+	// The index follows uninstallation
+	check(cp_uninstall_plugin(ctx, "c3") == CP_OK);
+	check(cp_uninstall_plugin(ctx, "c2") == CP_OK);
+	check((exts = cp_get_extensions_info_prefix(ctx, "codec.audio", &status, &num)) != NULL && status == CP_OK);
+	check(num == 1 && !strcmp(exts[0]->identifier, "c4.e"));
+	cp_release_info(ctx, exts);
+	cp_uninstall_plugins(ctx);
+	check((exts = cp_get_extensions_info_prefix(ctx, "", &status, &num)) != NULL && status == CP_OK);
+	check(num == 0);
+	cp_release_info(ctx, exts);
+	
+	cp_destroy();
+	check(errors == 0);
+}
+
+void installbatchlistener(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_status_t status;
+	recorded_events_t rec;
+	int errors;
+	
+	memset(&rec, 0, sizeof(rec));
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_batch_plistener(ctx, record_events, &rec) == CP_OK);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check(cp_uninstall_plugin(ctx, "minimal") == CP_OK);
+	cp_flush_plugin_events(ctx);
+	
+	// Events are delivered in order
+	check(rec.num_events == 3);
+	check(rec.num_batches >= 1 && rec.num_batches <= 3);
+	check(!strcmp(rec.ids[0], "minimal"));
+	check(rec.old_states[0] == CP_PLUGIN_UNINSTALLED && rec.new_states[0] == CP_PLUGIN_INSTALLED);
+	check(!strcmp(rec.ids[1], "maximal"));
+	check(rec.old_states[1] == CP_PLUGIN_UNINSTALLED && rec.new_states[1] == CP_PLUGIN_INSTALLED);
+	check(!strcmp(rec.ids[2], "minimal"));
+	check(rec.old_states[2] == CP_PLUGIN_INSTALLED && rec.new_states[2] == CP_PLUGIN_UNINSTALLED);
+	
+	// Events queued when the context is destroyed are still delivered
+	cp_destroy();
+	check(rec.num_events == 4);
+	check(!strcmp(rec.ids[3], "maximal"));
+	check(rec.old_states[3] == CP_PLUGIN_INSTALLED && rec.new_states[3] == CP_PLUGIN_UNINSTALLED);
+	check(errors == 0);
+	
+	// No events after unregistration
+	memset(&rec, 0, sizeof(rec));
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_batch_plistener(ctx, record_events, &rec) == CP_OK);
+	cp_unregister_batch_plistener(ctx, record_events);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	cp_flush_plugin_events(ctx);
+	cp_destroy();
+	check(rec.num_events == 0);
+	check(errors == 0);
+}
+
+static void count_exact(const char *plugin_id, cp_plugin_state_t old_state, cp_plugin_state_t new_state, void *user_data) {
+	check(!strcmp(plugin_id, "minimal") && new_state == CP_PLUGIN_INSTALLED);
+	(*((int *) user_data))++;
+}
+
+static void count_prefix(const char *plugin_id, cp_plugin_state_t old_state, cp_plugin_state_t new_state, void *user_data) {
+	check(!strncmp(plugin_id, "max", 3));
+	(*((int *) user_data))++;
+}
+
+static void count_uninstalls(const char *plugin_id, cp_plugin_state_t old_state, cp_plugin_state_t new_state, void *user_data) {
+	check(new_state == CP_PLUGIN_UNINSTALLED);
+	(*((int *) user_data))++;
+}
+
+void installfilteredlistener(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_status_t status;
+	int exact = 0, prefix = 0, uninstalls = 0;
+	int errors;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_plistener_filtered(ctx, count_exact, &exact, "minimal", 0, CP_STATE_MASK(CP_PLUGIN_INSTALLED)) == CP_OK);
+	check(cp_register_plistener_filtered(ctx, count_prefix, &prefix, "max", 1, CP_STATE_MASK_ALL) == CP_OK);
+	check(cp_register_plistener_filtered(ctx, count_uninstalls, &uninstalls, NULL, 0, CP_STATE_MASK(CP_PLUGIN_UNINSTALLED)) == CP_OK);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check(exact == 1);
+	check(prefix == 1);
+	check(uninstalls == 0);
+	check(cp_uninstall_plugin(ctx, "minimal") == CP_OK);
+	check(exact == 1);
+	check(prefix == 1);
+	check(uninstalls == 1);
+	
+	// Unregistered listeners are not called anymore
+	cp_unregister_plistener(ctx, count_prefix);
+	check(cp_uninstall_plugin(ctx, "maximal") == CP_OK);
+	check(prefix == 1);
+	check(uninstalls == 2);
+	cp_unregister_plistener(ctx, count_exact);
+	cp_destroy();
+	check(errors == 0);
+}
+
+void installimage(void) {
+	static const char * const names[] = { "m", "b", "x", "a", "b", "c", "z", "d", "b" };
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_extension_t **exts;
+	cp_cfg_element_t *ce;
+	char buffer[1024];
+	const char *str;
+	FILE *f;
+	int errors, num, i, len;
+	cp_status_t status;
+	
+	// Write an image of lazily parsed plug-ins
+	remove("tmp/plugins.cpi");
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	cp_set_lazy_ext_configuration(ctx, 1);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	len = sprintf(buffer, "<plugin id=\"indexed\"><extension point=\"maximal.extpt1\" id=\"ext\"><config");
+	for (i = 0; i < 10; i++) {
+		len += sprintf(buffer + len, " att%d=\"%d\"", 9 - i, 9 - i);
+	}
+	len += sprintf(buffer + len, ">");
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		len += sprintf(buffer + len, "<%s>%d</%s>", names[i], i, names[i]);
+	}
+	len += sprintf(buffer + len, "</config></extension></plugin>");
+	check((plugin = cp_load_plugin_descriptor_from_memory(ctx, buffer, len, &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	cp_release_info(ctx, plugin);
+	check(cp_write_plugin_image(ctx, "tmp/plugins.cpi") == CP_OK);
+	cp_destroy_context(ctx);
+	
+	// Install the image into a new context
+	ctx = init_context(CP_LOG_ERROR + 1, &errors);
+	check(cp_install_plugin_image(ctx, "tmp/plugins.cpi") == CP_OK);
+	check(cp_get_plugin_state(ctx, "minimal") == CP_PLUGIN_INSTALLED);
+	check((plugin = cp_get_plugin_info(ctx, "maximal", &status)) != NULL && status == CP_OK);
+	check(!strcmp(plugin->name, "Maximal"));
+	check(plugin->num_imports == 4 && !strcmp(plugin->imports[1].plugin_id, "dependency2"));
+	check(plugin->num_ext_points == 4 && plugin->ext_points[0].plugin == plugin);
+	check(plugin->num_extensions == 4 && plugin->extensions[3].plugin == plugin);
+	for (i = 0; i < plugin->num_extensions && strcmp(plugin->extensions[i].local_id != NULL ? plugin->extensions[i].local_id : "", "ext1"); i++);
+	check(i < plugin->num_extensions);
+	check((ce = cp_lookup_cfg_element(plugin->extensions[i].configuration, "structure/deeper/struct/is")) != NULL && !strcmp(ce->value, "here"));
+	check((str = cp_lookup_cfg_value(ce, "../../../../@name")) != NULL && !strcmp(str, "Extension 1"));
+	cp_release_info(ctx, plugin);
+	
+	// The indexes of the configuration are used
+	check((exts = cp_get_extensions_info(ctx, "maximal.extpt1", &status, &num)) != NULL && status == CP_OK);
+	for (i = 0; i < num && strcmp(exts[i]->plugin->identifier, "indexed"); i++);
+	check(i < num);
+	check((ce = cp_lookup_cfg_element(exts[i]->configuration, "config")) != NULL && ce->num_children == sizeof(names) / sizeof(names[0]));
+	check((str = cp_lookup_cfg_value(ce, "b")) != NULL && !strcmp(str, "1"));
+	check((str = cp_lookup_cfg_value(ce, "z")) != NULL && !strcmp(str, "6"));
+	check((str = cp_lookup_cfg_value(ce, "@att7")) != NULL && !strcmp(str, "7"));
+	check(cp_lookup_cfg_value(ce, "@att10") == NULL);
+	cp_release_info(ctx, exts);
+	
+	// Installing the same plug-ins again conflicts
+	check(cp_install_plugin_image(ctx, "tmp/plugins.cpi") == CP_ERR_CONFLICT);
+	check(errors == 3);
+	
+	// An invalid image is rejected
+	cp_uninstall_plugins(ctx);
+	check((f = fopen("tmp/plugins.cpi", "wb")) != NULL);
+	check(fwrite(buffer, 1, len, f) == len);
+	check(fclose(f) == 0);
+	check(cp_install_plugin_image(ctx, "tmp/plugins.cpi") == CP_ERR_MALFORMED);
+	check(errors == 4);
+	check(cp_get_plugin_state(ctx, "minimal") == CP_PLUGIN_UNINSTALLED);
+	cp_destroy();
+	remove("tmp/plugins.cpi");
+}
+
+void installbulk(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugins[3];
+	cp_status_t status;
+	recorded_events_t rec;
+	int exact = 0, prefix = 0;
+	int errors;
+	
+	// All plug-ins are installed and the events delivered as one batch
+	memset(&rec, 0, sizeof(rec));
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_batch_plistener(ctx, record_events, &rec) == CP_OK);
+	check(cp_register_plistener_filtered(ctx, count_exact, &exact, "minimal", 0, CP_STATE_MASK(CP_PLUGIN_INSTALLED)) == CP_OK);
+	check(cp_register_plistener_filtered(ctx, count_prefix, &prefix, "max", 1, CP_STATE_MASK_ALL) == CP_OK);
+	check((plugins[0] = cp_load_plugin_descriptor(ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check((plugins[1] = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugins(ctx, NULL, 0, 0) == CP_OK);
+	check(cp_install_plugins(ctx, plugins, 2, 0) == CP_OK);
+	cp_release_info(ctx, plugins[0]);
+	cp_release_info(ctx, plugins[1]);
+	check(cp_get_plugin_state(ctx, "minimal") == CP_PLUGIN_INSTALLED);
+	check(cp_get_plugin_state(ctx, "maximal") == CP_PLUGIN_INSTALLED);
+	check(exact == 1);
+	check(prefix == 1);
+	cp_flush_plugin_events(ctx);
+	check(rec.num_batches == 1);
+	check(rec.num_events == 2);
+	check(!strcmp(rec.ids[0], "minimal"));
+	check(rec.old_states[0] == CP_PLUGIN_UNINSTALLED && rec.new_states[0] == CP_PLUGIN_INSTALLED);
+	check(!strcmp(rec.ids[1], "maximal"));
+	check(rec.old_states[1] == CP_PLUGIN_UNINSTALLED && rec.new_states[1] == CP_PLUGIN_INSTALLED);
+	cp_unregister_plistener(ctx, count_exact);
+	cp_unregister_plistener(ctx, count_prefix);
+	cp_destroy();
+	check(errors == 0);
+	
+	// Conflicts between the plug-ins are detected before installing
+	ctx = init_context(CP_LOG_ERROR + 1, &errors);
+	check((plugins[0] = cp_load_plugin_descriptor(ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check((plugins[1] = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check((plugins[2] = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugins(ctx, plugins, 3, CP_IP_ALL_OR_NONE) == CP_ERR_CONFLICT);
+	check(cp_get_plugin_state(ctx, "minimal") == CP_PLUGIN_UNINSTALLED);
+	check(cp_get_plugin_state(ctx, "maximal") == CP_PLUGIN_UNINSTALLED);
+	
+	// Without all or none the conflicting plug-ins are skipped
+	check(cp_install_plugins(ctx, plugins, 3, 0) == CP_ERR_CONFLICT);
+	check(cp_get_plugin_state(ctx, "minimal") == CP_PLUGIN_INSTALLED);
+	check(cp_get_plugin_state(ctx, "maximal") == CP_PLUGIN_INSTALLED);
+	
+	// Conflicts with the installed plug-ins are detected as well
+	check(cp_install_plugins(ctx, plugins + 2, 1, 0) == CP_ERR_CONFLICT);
+	check(cp_uninstall_plugin(ctx, "maximal") == CP_OK);
+	check(cp_install_plugins(ctx, plugins + 1, 2, CP_IP_ALL_OR_NONE) == CP_ERR_CONFLICT);
+	check(cp_get_plugin_state(ctx, "maximal") == CP_PLUGIN_UNINSTALLED);
+	check(cp_install_plugins(ctx, plugins + 2, 1, CP_IP_ALL_OR_NONE) == CP_OK);
+	check(cp_get_plugin_state(ctx, "maximal") == CP_PLUGIN_INSTALLED);
+	cp_release_info(ctx, plugins[0]);
+	cp_release_info(ctx, plugins[1]);
+	cp_release_info(ctx, plugins[2]);
+	cp_destroy();
+	check(errors == 4);
+}
+
+static int usage_of_main(cp_context_t *ctx, unsigned long *bytes) {
+	cp_info_usage_t *usage;
+	cp_status_t status;
+	int i, n, num = 0;
+	
+	check((usage = cp_get_info_usage(ctx, &status, &n)) != NULL && status == CP_OK);
+	for (i = 0; i < n; i++) {
+		if (usage[i].plugin_id == NULL) {
+			num = usage[i].num_infos;
+			*bytes = usage[i].bytes;
+		}
+	}
+	cp_release_info(ctx, usage);
+	return num;
+}
+
+void installinfousage(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin;
+	cp_plugin_info_t **plugins;
+	cp_plugin_stats_t stats;
+	cp_status_t status;
+	unsigned long size, bytes = 0;
+	int errors;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(usage_of_main(ctx, &bytes) == 0);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check((size = cp_get_info_size(ctx, plugin)) > sizeof(cp_plugin_info_t));
+	check(usage_of_main(ctx, &bytes) == 1 && bytes == size);
+	check(cp_install_plugin(ctx, plugin) == CP_OK);
+	check(cp_get_plugin_stats(ctx, "maximal", &stats) == CP_OK);
+	check(stats.descriptor_bytes == size);
+	
+	// Arrays are accounted separately from the plug-in information
+	check((plugins = cp_get_plugins_info(ctx, &status, NULL)) != NULL && status == CP_OK);
+	check(cp_get_info_size(ctx, plugins) < size);
+	check(usage_of_main(ctx, &bytes) == 2 && bytes == size + cp_get_info_size(ctx, plugins));
+	cp_release_info(ctx, plugins);
+	
+	// The installed plug-in keeps its information registered
+	cp_release_info(ctx, plugin);
+	check(usage_of_main(ctx, &bytes) == 1 && bytes == size);
+	check(cp_uninstall_plugin(ctx, "maximal") == CP_OK);
+	check(usage_of_main(ctx, &bytes) == 0);
+	cp_destroy();
+	check(errors == 0);
+}
+
+static void write_snapshot_plugin(const char *id, const char *import, time_t mtime) {
+	struct utimbuf times;
+	char path[64];
+	FILE *f;
+	
+	sprintf(path, "tmp/snap/%s", id);
+	mkdir(path, 0777);
+	strcat(path, "/plugin.xml");
+	check((f = fopen(path, "w")) != NULL);
+	fprintf(f, "<plugin id=\"%s\" version=\"1\">", id);
+	if (import != NULL) {
+		fprintf(f, "<requires><import plugin=\"%s\"/></requires>", import);
+	}
+	fputs("</plugin>\n", f);
+	check(fclose(f) == 0);
+	
+	// Use times in the past so that the stamps are not racy
+	times.actime = times.modtime = mtime;
+	check(utime(path, &times) == 0);
+	check(utime("tmp/snap", &times) == 0);
+}
+
+static void order_plugin_events(const char *plugin_id, cp_plugin_state_t old_state, cp_plugin_state_t new_state, void *user_data) {
+	if (new_state == CP_PLUGIN_ACTIVE) {
+		strcat(user_data, plugin_id);
+	}
+}
+
+void restoreimage(void) {
+	cp_context_t *ctx;
+	char order[16];
+	int errors;
+	
+	// Write a snapshot of a started context
+	remove("tmp/snap.cpi");
+	mkdir("tmp/snap", 0777);
+	write_snapshot_plugin("b", NULL, 1000000000);
+	write_snapshot_plugin("a", "b", 1000000000);
+	write_snapshot_plugin("c", NULL, 1000000000);
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_pcollection(ctx, "tmp/snap") == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_start_plugin(ctx, "a") == CP_OK);
+	check(cp_write_plugin_image(ctx, "tmp/snap.cpi") == CP_OK);
+	cp_destroy_context(ctx);
+	
+	// Restoring starts the active plug-ins in the same order
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	order[0] = '\0';
+	check(cp_register_plistener(ctx, order_plugin_events, order) == CP_OK);
+	check(cp_restore_plugin_image(ctx, "tmp/snap.cpi") == CP_OK);
+	check(!strcmp(order, "ba"));
+	check(cp_get_plugin_state(ctx, "c") == CP_PLUGIN_INSTALLED);
+	check(cp_restore_plugin_image(ctx, "tmp/snap.cpi") == CP_ERR_CONFLICT);
+	cp_destroy_context(ctx);
+	check(errors == 3);
+	
+	// A modified descriptor makes the snapshot out of date
+	write_snapshot_plugin("c", "b", 1000000100);
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_restore_plugin_image(ctx, "tmp/snap.cpi") == CP_ERR_CONFLICT);
+	check(cp_get_plugin_state(ctx, "b") == CP_PLUGIN_UNINSTALLED);
+	cp_destroy();
+	check(errors == 0);
+	
+	remove("tmp/snap/a/plugin.xml");
+	remove("tmp/snap/b/plugin.xml");
+	remove("tmp/snap/c/plugin.xml");
+	rmdir("tmp/snap/a");
+	rmdir("tmp/snap/b");
+	rmdir("tmp/snap/c");
+	rmdir("tmp/snap");
+	remove("tmp/snap.cpi");
+}
+
+void createfromtemplate(void) {
+	cp_context_t *tmpl, *ctx1, *ctx2;
+	cp_plugin_info_t *plugin;
+	cp_extension_t **exts;
+	int errors, num, num_tmpl;
+	cp_status_t status;
+	
+	// Create two contexts from a template
+	tmpl = init_context(CP_LOG_ERROR, &errors);
+	cp_set_lazy_ext_configuration(tmpl, 1);
+	check((plugin = cp_load_plugin_descriptor(tmpl, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(tmpl, plugin) == CP_OK);
+	cp_release_info(tmpl, plugin);
+	check((plugin = cp_load_plugin_descriptor(tmpl, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+	check(cp_install_plugin(tmpl, plugin) == CP_OK);
+	cp_release_info(tmpl, plugin);
+	check((ctx1 = cp_create_context_from(tmpl, &status)) != NULL && status == CP_OK);
+	check((ctx2 = cp_create_context_from(tmpl, &status)) != NULL && status == CP_OK);
+	
+	// The plug-ins and extensions are installed in both
+	check(cp_get_plugin_state(ctx1, "minimal") == CP_PLUGIN_INSTALLED);
+	check((plugin = cp_get_plugin_info(ctx2, "maximal", &status)) != NULL && status == CP_OK);
+	check(!strcmp(plugin->name, "Maximal"));
+	check(plugin->num_ext_points == 4 && plugin->ext_points[0].plugin == plugin);
+	check(plugin->num_extensions == 4 && plugin->extensions[3].plugin == plugin);
+	cp_release_info(ctx2, plugin);
+	check((exts = cp_get_extensions_info(tmpl, "maximal.extpt1", &status, &num_tmpl)) != NULL && status == CP_OK);
+	cp_release_info(tmpl, exts);
+	check((exts = cp_get_extensions_info(ctx1, "maximal.extpt1", &status, &num)) != NULL && status == CP_OK);
+	check(num == num_tmpl && num > 0);
+	cp_release_info(ctx1, exts);
+	
+	// The contexts are independent
+	check(cp_uninstall_plugin(ctx1, "maximal") == CP_OK);
+	check(cp_get_plugin_state(tmpl, "maximal") == CP_PLUGIN_INSTALLED);
+	check(cp_get_plugin_state(ctx2, "maximal") == CP_PLUGIN_INSTALLED);
+	
+	// Changes in the template are reflected in new contexts
+	check(cp_uninstall_plugin(tmpl, "minimal") == CP_OK);
+	cp_destroy_context(ctx2);
+	check((ctx2 = cp_create_context_from(tmpl, &status)) != NULL && status == CP_OK);
+	check(cp_get_plugin_state(ctx2, "minimal") == CP_PLUGIN_UNINSTALLED);
+	check(cp_get_plugin_state(ctx2, "maximal") == CP_PLUGIN_INSTALLED);
+	
+	// The shared content outlives the template
+	cp_destroy_context(tmpl);
+	check((plugin = cp_get_plugin_info(ctx2, "maximal", &status)) != NULL && status == CP_OK);
+	check(!strcmp(plugin->name, "Maximal"));
+	cp_release_info(ctx2, plugin);
+	cp_destroy();
+	check(errors == 0);
+}
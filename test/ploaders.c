@@ -22,6 +22,13 @@
  *-----------------------------------------------------------------------*/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
 #include "test.h"
 
 void oneploader(void) {
@@ -163,3 +170,416 @@ void unregploader(void) {
 	cp_destroy();
 	check(errors == 0);
 }
+
+void ploaderparallel(void) {
+	cp_context_t *ctx;
+	cp_plugin_loader_t *loader;
+	cp_plugin_info_t *pi;
+	cp_status_t status;
+	int errors;
+
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	loader = cp_create_local_ploader(&status);
+	check(loader != NULL);
+	check(status == CP_OK);
+	cp_lpl_set_scan_threads(loader, 4);
+	check(cp_register_ploader(ctx, loader) == CP_OK);
+	check(cp_lpl_register_dir(loader, pcollectiondir("collection1v2")) == CP_OK);
+	check(cp_lpl_register_dir(loader, pcollectiondir("collection1v3")) == CP_OK);
+	check(cp_lpl_register_dir(loader, pcollectiondir("collection1")) == CP_OK);
+	check(cp_lpl_register_dir(loader, pcollectiondir("collection2")) == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check((pi = cp_get_plugin_info(ctx, "plugin1", &status)) != NULL && status == CP_OK);
+	check(pi->version != NULL && !strcmp(pi->version, "3"));
+	cp_release_info(ctx, pi);
+	check(cp_get_plugin_state(ctx, "plugin2a") == CP_PLUGIN_INSTALLED);
+	check(cp_get_plugin_state(ctx, "plugin2b") == CP_PLUGIN_INSTALLED);
+	cp_destroy();
+	check(errors == 0);
+}
+
+void ploaderwatch(void) {
+	cp_context_t *ctx;
+	cp_plugin_loader_t *loader;
+	cp_status_t status;
+	FILE *f;
+	int errors;
+	int i;
+
+	// Start with an empty plug-in collection
+	remove("tmp/watch/plugin2a/plugin.xml");
+	remove("tmp/watch/plugin2a/changing");
+	rmdir("tmp/watch/plugin2a");
+	remove("tmp/watch/plugin2b/plugin.xml");
+	rmdir("tmp/watch/plugin2b");
+	rmdir("tmp/watch");
+	check(mkdir("tmp/watch", 0777) == 0);
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	loader = cp_create_local_ploader(&status);
+	check(loader != NULL);
+	check(status == CP_OK);
+	check(cp_register_ploader(ctx, loader) == CP_OK);
+	check(cp_lpl_register_dir(loader, "tmp/watch") == CP_OK);
+	if (cp_lpl_watch_dirs(loader, ctx, 0, 50) != CP_OK) {
+		cp_destroy();
+		rmdir("tmp/watch");
+		exit(77);
+	}
+	
+	// Add a plug-in, moving the descriptor in place when complete
+	check((f = fopen("tmp/watch-plugin.xml", "w")) != NULL);
+	check(fputs("<?xml version=\"1.0\"?>\n<plugin id=\"plugin2a\"/>\n", f) >= 0);
+	check(fclose(f) == 0);
+	check(mkdir("tmp/watch/plugin2a", 0777) == 0);
+	check(rename("tmp/watch-plugin.xml", "tmp/watch/plugin2a/plugin.xml") == 0);
+	
+	// Wait for the plug-in to be installed
+	for (i = 0; i < 1000 && cp_get_plugin_state(ctx, "plugin2a") != CP_PLUGIN_INSTALLED; i++) {
+		struct timespec ts;
+		
+		ts.tv_sec = 0;
+		ts.tv_nsec = 10000000;
+		nanosleep(&ts, NULL);
+	}
+	check(cp_get_plugin_state(ctx, "plugin2a") == CP_PLUGIN_INSTALLED);
+	
+	// Add another plug-in while changes are reported continuously
+	check((f = fopen("tmp/watch-plugin.xml", "w")) != NULL);
+	check(fputs("<?xml version=\"1.0\"?>\n<plugin id=\"plugin2b\"/>\n", f) >= 0);
+	check(fclose(f) == 0);
+	check(mkdir("tmp/watch/plugin2b", 0777) == 0);
+	check(rename("tmp/watch-plugin.xml", "tmp/watch/plugin2b/plugin.xml") == 0);
+	for (i = 0; i < 1000 && cp_get_plugin_state(ctx, "plugin2b") != CP_PLUGIN_INSTALLED; i++) {
+		struct timespec ts;
+		
+		check((f = fopen("tmp/watch/plugin2a/changing", "w")) != NULL);
+		check(fclose(f) == 0);
+		ts.tv_sec = 0;
+		ts.tv_nsec = 10000000;
+		nanosleep(&ts, NULL);
+	}
+	check(cp_get_plugin_state(ctx, "plugin2b") == CP_PLUGIN_INSTALLED);
+	cp_lpl_unwatch_dirs(loader);
+	cp_unregister_ploader(ctx, loader);
+	cp_destroy_local_ploader(loader);
+	cp_destroy();
+	check(errors == 0);
+	
+	remove("tmp/watch/plugin2a/plugin.xml");
+	remove("tmp/watch/plugin2a/changing");
+	rmdir("tmp/watch/plugin2a");
+	remove("tmp/watch/plugin2b/plugin.xml");
+	rmdir("tmp/watch/plugin2b");
+	rmdir("tmp/watch");
+}
+
+/**
+ * Writes a 16-bit little-endian value.
+ * 
+ * @param f the file
+ * @param v the value
+ */
+static void put_u16(FILE *f, unsigned int v) {
+	check(fputc(v & 0xff, f) != EOF && fputc((v >> 8) & 0xff, f) != EOF);
+}
+
+/**
+ * Writes a 32-bit little-endian value.
+ * 
+ * @param f the file
+ * @param v the value
+ */
+static void put_u32(FILE *f, unsigned long v) {
+	put_u16(f, v & 0xffff);
+	put_u16(f, (v >> 16) & 0xffff);
+}
+
+/**
+ * Calculates the CRC-32 of a string.
+ * 
+ * @param s the string
+ * @return the CRC-32
+ */
+static unsigned long str_crc(const char *s) {
+	unsigned long c = 0xffffffffUL;
+	int i;
+	
+	for (; *s != '\0'; s++) {
+		c ^= (unsigned char) *s;
+		for (i = 0; i < 8; i++) {
+			c = (c & 1 ? 0xedb88320UL ^ (c >> 1) : c >> 1);
+		}
+	}
+	return c ^ 0xffffffffUL;
+}
+
+/**
+ * Writes a ZIP archive of stored members.
+ * 
+ * @param file the archive file
+ * @param members the member names and contents, alternating
+ * @param num the number of members
+ */
+static void write_zip(const char *file, const char * const *members, int num) {
+	unsigned long offsets[8];
+	unsigned long cd_offset, cd_end;
+	FILE *f;
+	int i;
+	
+	check(num <= 8);
+	check((f = fopen(file, "wb")) != NULL);
+	for (i = 0; i < num; i++) {
+		const char *name = members[2 * i], *data = members[2 * i + 1];
+		
+		offsets[i] = ftell(f);
+		put_u32(f, 0x04034b50UL);
+		put_u16(f, 10);
+		put_u16(f, 0);
+		put_u16(f, 0);
+		put_u32(f, 0);
+		put_u32(f, str_crc(data));
+		put_u32(f, strlen(data));
+		put_u32(f, strlen(data));
+		put_u16(f, strlen(name));
+		put_u16(f, 0);
+		check(fputs(name, f) >= 0 && fputs(data, f) >= 0);
+	}
+	cd_offset = ftell(f);
+	for (i = 0; i < num; i++) {
+		const char *name = members[2 * i], *data = members[2 * i + 1];
+		
+		put_u32(f, 0x02014b50UL);
+		put_u16(f, 10);
+		put_u16(f, 10);
+		put_u16(f, 0);
+		put_u16(f, 0);
+		put_u32(f, 0);
+		put_u32(f, str_crc(data));
+		put_u32(f, strlen(data));
+		put_u32(f, strlen(data));
+		put_u16(f, strlen(name));
+		put_u16(f, 0);
+		put_u16(f, 0);
+		put_u16(f, 0);
+		put_u16(f, 0);
+		put_u32(f, 0);
+		put_u32(f, offsets[i]);
+		check(fputs(name, f) >= 0);
+	}
+	cd_end = ftell(f);
+	put_u32(f, 0x06054b50UL);
+	put_u16(f, 0);
+	put_u16(f, 0);
+	put_u16(f, num);
+	put_u16(f, num);
+	put_u32(f, cd_end - cd_offset);
+	put_u32(f, cd_offset);
+	put_u16(f, 0);
+	check(fclose(f) == 0);
+}
+
+void archiveploader(void) {
+	static const char lib_member[] = "archived/archived" CP_SHREXT;
+	const char * const members[] = {
+		"other/readme.txt", "not a plug-in\n",
+		"archived/plugin.xml", "<?xml version=\"1.0\"?>\n<plugin id=\"archived\"><runtime library=\"archived\"/></plugin>\n",
+		lib_member, "not a library\n",
+		"archived/data/info.txt", "archived data\n"
+	};
+	cp_context_t *ctx;
+	cp_plugin_loader_t *loader;
+	cp_plugin_info_t *plugin;
+	cp_status_t status;
+	char buffer[64];
+	FILE *f;
+	int errors;
+	
+	remove("tmp/extracted/archived/archived" CP_SHREXT);
+	remove("tmp/extracted/archived/data/info.txt");
+	write_zip("tmp/plugins.zip", members, 4);
+	
+	// Descriptors are read from the archive without extracting files
+	ctx = init_context(CP_LOG_ERROR + 1, &errors);
+	loader = cp_create_archive_ploader("tmp/plugins.zip", "tmp/extracted", &status);
+	check(loader != NULL && status == CP_OK);
+	check(cp_register_ploader(ctx, loader) == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_get_plugin_state(ctx, "archived") == CP_PLUGIN_INSTALLED);
+	check(cp_get_plugin_state(ctx, "other") == CP_PLUGIN_UNINSTALLED);
+	check((plugin = cp_get_plugin_info(ctx, "archived", &status)) != NULL);
+	check(!strcmp(plugin->plugin_path, "tmp/extracted" CP_FNAMESEP_STR "archived"));
+	cp_release_info(ctx, plugin);
+	check(fopen("tmp/extracted/archived/data/info.txt", "r") == NULL);
+	check(errors == 0);
+	
+	// The files are extracted when the runtime library is needed
+	check(cp_start_plugin(ctx, "archived") == CP_ERR_RUNTIME);
+	check(errors > 0);
+	check((f = fopen("tmp/extracted/archived/data/info.txt", "r")) != NULL);
+	check(fgets(buffer, sizeof(buffer), f) != NULL);
+	check(!strcmp(buffer, "archived data\n"));
+	fclose(f);
+	check(fopen("tmp/extracted/other/readme.txt", "r") == NULL);
+	cp_unregister_ploader(ctx, loader);
+	cp_destroy_archive_ploader(loader);
+	cp_destroy();
+	
+	// Archives which are not ZIP archives are rejected
+	check((f = fopen("tmp/plugins.zip", "w")) != NULL);
+	check(fputs("not an archive\n", f) >= 0);
+	check(fclose(f) == 0);
+	check(cp_init() == CP_OK);
+	check(cp_create_archive_ploader("tmp/plugins.zip", "tmp/extracted", &status) == NULL);
+	check(status == CP_ERR_MALFORMED);
+	cp_destroy();
+	
+	remove("tmp/extracted/archived/archived" CP_SHREXT);
+	remove("tmp/extracted/archived/data/info.txt");
+	rmdir("tmp/extracted/archived/data");
+	rmdir("tmp/extracted/archived");
+	rmdir("tmp/extracted");
+	remove("tmp/plugins.zip");
+}
+
+/// The state of the test repository
+typedef struct test_repo_t {
+	
+	/// The number of fetched files
+	int fetched;
+	
+	/// Whether the repository is unreachable
+	int offline;
+} test_repo_t;
+
+/**
+ * Fetches a file from the test repository in tmp/repo, where the files are
+ * stored by digest.
+ */
+static int fetch_test_file(const char *path, const char *digest, const char *file, void *user_data) {
+	test_repo_t *repo = user_data;
+	char src[64];
+	char buffer[256];
+	FILE *in, *out;
+	size_t n;
+	
+	repo->fetched++;
+	if (repo->offline) {
+		return 0;
+	}
+	check(strlen(digest != NULL ? digest : path) < sizeof(src) - 9);
+	sprintf(src, "tmp/repo/%s", digest != NULL ? digest : path);
+	if ((in = fopen(src, "rb")) == NULL) {
+		return 0;
+	}
+	check((out = fopen(file, "wb")) != NULL);
+	while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+		check(fwrite(buffer, 1, n, out) == n);
+	}
+	fclose(in);
+	check(fclose(out) == 0);
+	return 1;
+}
+
+/**
+ * Writes a file with the specified contents.
+ * 
+ * @param file the file
+ * @param contents the contents
+ */
+static void write_test_file(const char *file, const char *contents) {
+	FILE *f;
+	
+	check((f = fopen(file, "w")) != NULL);
+	check(fputs(contents, f) >= 0);
+	check(fclose(f) == 0);
+}
+
+/**
+ * Removes a directory tree.
+ * 
+ * @param path the root of the tree
+ */
+static void remove_tree(const char *path) {
+	DIR *dir;
+	struct dirent *de;
+	
+	if ((dir = opendir(path)) == NULL) {
+		remove(path);
+		return;
+	}
+	while ((de = readdir(dir)) != NULL) {
+		char *p;
+		
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+			continue;
+		}
+		check((p = malloc(strlen(path) + strlen(de->d_name) + 2)) != NULL);
+		sprintf(p, "%s/%s", path, de->d_name);
+		remove_tree(p);
+		free(p);
+	}
+	closedir(dir);
+	rmdir(path);
+}
+
+void repositoryploader(void) {
+	cp_context_t *ctx;
+	cp_plugin_loader_t *loader;
+	cp_plugin_info_t *plugin;
+	cp_status_t status;
+	test_repo_t repo;
+	char *file;
+	int errors;
+	
+	remove_tree("tmp/repo");
+	remove_tree("tmp/rcache");
+	check(mkdir("tmp/repo", 0777) == 0);
+	write_test_file("tmp/repo/d1", "<?xml version=\"1.0\"?>\n<plugin id=\"remote\" version=\"1\"/>\n");
+	write_test_file("tmp/repo/d2", "<?xml version=\"1.0\"?>\n<plugin id=\"remote\" version=\"2\"/>\n");
+	write_test_file("tmp/repo/f1", "remote data\n");
+	write_test_file("tmp/repo/index", "# test repository\nd1 remote/plugin.xml\nf1 remote/data/info.txt\n");
+	memset(&repo, 0, sizeof(repo));
+	
+	// The first scan fetches the index and all the listed files
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	loader = cp_create_repository_ploader("tmp/rcache", fetch_test_file, &repo, &status);
+	check(loader != NULL && status == CP_OK);
+	cp_rpl_set_fetch_threads(loader, 4);
+	check(cp_register_ploader(ctx, loader) == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(repo.fetched == 3);
+	check(cp_get_plugin_state(ctx, "remote") == CP_PLUGIN_INSTALLED);
+	check((plugin = cp_get_plugin_info(ctx, "remote", &status)) != NULL);
+	check((file = malloc(strlen(plugin->plugin_path) + 16)) != NULL);
+	sprintf(file, "%s/data/info.txt", plugin->plugin_path);
+	check(access(file, R_OK) == 0);
+	free(file);
+	cp_release_info(ctx, plugin);
+	
+	// Unchanged files are not fetched again
+	check(cp_scan_plugins(ctx, CP_SP_INCREMENTAL) == CP_OK);
+	check(repo.fetched == 4);
+	check(cp_get_plugin_state(ctx, "remote") == CP_PLUGIN_INSTALLED);
+	
+	// Only the changed descriptor is fetched for an upgrade
+	write_test_file("tmp/repo/index", "d2 remote/plugin.xml\nf1 remote/data/info.txt\n");
+	check(cp_scan_plugins(ctx, CP_SP_INCREMENTAL | CP_SP_UPGRADE) == CP_OK);
+	check(repo.fetched == 6);
+	check((plugin = cp_get_plugin_info(ctx, "remote", &status)) != NULL);
+	check(!strcmp(plugin->version, "2"));
+	cp_release_info(ctx, plugin);
+	
+	// The cached index is used when the repository can not be reached
+	repo.offline = 1;
+	check(cp_scan_plugins(ctx, CP_SP_UPGRADE) == CP_OK);
+	check(repo.fetched == 7);
+	check(cp_get_plugin_state(ctx, "remote") == CP_PLUGIN_INSTALLED);
+	cp_unregister_ploader(ctx, loader);
+	cp_destroy_repository_ploader(loader);
+	cp_destroy();
+	check(errors == 0);
+	
+	remove_tree("tmp/repo");
+	remove_tree("tmp/rcache");
+}
@@ -90,3 +90,116 @@ void loadonlymaximalfrommemory(void) {
 	cp_destroy();
 	check(errors == 0);
 }
+
+static int same_str(const char *s1, const char *s2) {
+	return s1 == NULL ? s2 == NULL : (s2 != NULL && !strcmp(s1, s2));
+}
+
+static void check_same_cfg_element(const cp_cfg_element_t *ce1, const cp_cfg_element_t *ce2, const cp_cfg_element_t *parent2) {
+	unsigned int i;
+	
+	check(same_str(ce1->name, ce2->name));
+	check(ce1->num_atts == ce2->num_atts);
+	for (i = 0; i < 2 * ce1->num_atts; i++) {
+		check(same_str(ce1->atts[i], ce2->atts[i]));
+	}
+	check(same_str(ce1->value, ce2->value));
+	check(ce2->parent == parent2);
+	check(ce1->index == ce2->index);
+	check(ce1->num_children == ce2->num_children);
+	for (i = 0; i < ce1->num_children; i++) {
+		check_same_cfg_element(ce1->children + i, ce2->children + i, ce2);
+	}
+}
+
+static void check_same_plugin_info(const cp_plugin_info_t *p1, const cp_plugin_info_t *p2) {
+	unsigned int i;
+	
+	check(same_str(p1->identifier, p2->identifier));
+	check(same_str(p1->name, p2->name));
+	check(same_str(p1->version, p2->version));
+	check(same_str(p1->provider_name, p2->provider_name));
+	check(same_str(p1->plugin_path, p2->plugin_path));
+	check(same_str(p1->abi_bw_compatibility, p2->abi_bw_compatibility));
+	check(same_str(p1->api_bw_compatibility, p2->api_bw_compatibility));
+	check(same_str(p1->req_cpluff_version, p2->req_cpluff_version));
+	check(same_str(p1->runtime_lib_name, p2->runtime_lib_name));
+	check(same_str(p1->runtime_funcs_symbol, p2->runtime_funcs_symbol));
+	check(p1->num_imports == p2->num_imports);
+	for (i = 0; i < p1->num_imports; i++) {
+		check(same_str(p1->imports[i].plugin_id, p2->imports[i].plugin_id));
+		check(same_str(p1->imports[i].version, p2->imports[i].version));
+		check(p1->imports[i].optional == p2->imports[i].optional);
+	}
+	check(p1->num_ext_points == p2->num_ext_points);
+	for (i = 0; i < p1->num_ext_points; i++) {
+		check(p2->ext_points[i].plugin == p2);
+		check(same_str(p1->ext_points[i].local_id, p2->ext_points[i].local_id));
+		check(same_str(p1->ext_points[i].identifier, p2->ext_points[i].identifier));
+		check(same_str(p1->ext_points[i].name, p2->ext_points[i].name));
+		check(same_str(p1->ext_points[i].schema_path, p2->ext_points[i].schema_path));
+	}
+	check(p1->num_extensions == p2->num_extensions);
+	for (i = 0; i < p1->num_extensions; i++) {
+		check(p2->extensions[i].plugin == p2);
+		check(same_str(p1->extensions[i].ext_point_id, p2->extensions[i].ext_point_id));
+		check(same_str(p1->extensions[i].local_id, p2->extensions[i].local_id));
+		check(same_str(p1->extensions[i].identifier, p2->extensions[i].identifier));
+		check(same_str(p1->extensions[i].name, p2->extensions[i].name));
+		check((p1->extensions[i].configuration == NULL) == (p2->extensions[i].configuration == NULL));
+		if (p1->extensions[i].configuration != NULL) {
+			check_same_cfg_element(p1->extensions[i].configuration, p2->extensions[i].configuration, NULL);
+		}
+	}
+}
+
+void loadmaximalcached(void) {
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin, *plugin2;
+	cp_status_t status;
+	int errors;
+	int i;
+
+	ctx = init_context(CP_LOG_WARNING, &errors);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	
+	// The first load populates the cache and the second one uses it
+	check(cp_set_descriptor_cache_dir(ctx, "tmp") == CP_OK);
+	for (i = 0; i < 2; i++) {
+		check((plugin2 = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+		check_same_plugin_info(plugin, plugin2);
+		cp_release_info(ctx, plugin2);
+	}
+	cp_release_info(ctx, plugin);
+	
+	// A different root element must not use the cached descriptor
+	cp_set_plugin_descriptor_root_element(ctx, "addon");
+	check(cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status) == NULL && status == CP_ERR_MALFORMED);
+	errors = 0;
+	check(cp_set_descriptor_cache_dir(ctx, NULL) == CP_OK);
+	cp_destroy();
+	check(errors == 0);
+}
+
+void loadreuseparsers(void) {
+	static const char malformed[] = "<plugin id=\"malformed\"><requires></plugin>";
+	cp_context_t *ctx;
+	cp_plugin_info_t *plugin, *plugin2;
+	cp_status_t status;
+	int errors, i;
+	
+	// Parsers are reused after both successful and failed loads
+	ctx = init_context(CP_LOG_ERROR + 1, &errors);
+	check((plugin = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+	for (i = 0; i < 3; i++) {
+		check(cp_load_plugin_descriptor_from_memory(ctx, malformed, sizeof(malformed) - 1, &status) == NULL && status == CP_ERR_MALFORMED);
+		check((plugin2 = cp_load_plugin_descriptor(ctx, plugindir("minimal"), &status)) != NULL && status == CP_OK);
+		cp_release_info(ctx, plugin2);
+		check((plugin2 = cp_load_plugin_descriptor(ctx, plugindir("maximal"), &status)) != NULL && status == CP_OK);
+		check_same_plugin_info(plugin, plugin2);
+		cp_release_info(ctx, plugin2);
+	}
+	cp_release_info(ctx, plugin);
+	cp_destroy();
+	check(errors > 0);
+}
@@ -25,12 +25,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 #include <cpluff.h>
 #include "callbackcounter.h"
 
 struct runtime_data {
 	cp_context_t *ctx;
 	cbc_counters_t *counters;
+	int fd;
 };
 
 static void *create(cp_context_t *ctx) {
@@ -63,10 +67,24 @@ static void logger(cp_log_severity_t severity, const char *msg, const char *apid
 	data->counters->logger++;
 }
 
+static int task(void *d, void *task_data) {
+	struct runtime_data *data = task_data;
+	
+	data->counters->task++;
+	return CP_RUN_SUSPEND;
+}
+
+static void discard(void *task_data) {
+	struct runtime_data *data = task_data;
+	
+	data->counters->discard++;
+}
+
 static void listener(const char *plugin_id, cp_plugin_state_t old_state, cp_plugin_state_t new_state, void *user_data) {
 	struct runtime_data *data = user_data;
 	
 	data->counters->listener++;
+	cp_resume_task(data->ctx, task, data);
 }
 
 static int run(void *d) {
@@ -76,9 +94,50 @@ static int run(void *d) {
 	return (data->counters->run < 3);
 }
 
+static int timed_run(void *d) {
+	struct runtime_data *data = d;
+	
+	data->counters->timed++;
+	if (data->counters->timed < 3) {
+		return (cp_run_function_at(data->ctx, timed_run, 5) == CP_OK);
+	}
+	return 0;
+}
+
+static int batch_run(void *d) {
+	struct runtime_data *data = d;
+	
+	data->counters->batch++;
+	return (data->counters->batch < 10);
+}
+
+static int interactive_run(void *d) {
+	struct runtime_data *data = d;
+	
+	data->counters->interactive++;
+	return (data->counters->interactive < 10);
+}
+
+static void forked(void *user_data) {
+	struct runtime_data *data = user_data;
+	
+	data->counters->forked++;
+}
+
+#ifndef _WIN32
+static int fd_run(void *d) {
+	struct runtime_data *data = d;
+	char c;
+	
+	data->counters->fdrun++;
+	return (read(data->fd, &c, 1) != 1);
+}
+#endif
+
 static int start(void *d) {
 	struct runtime_data *data = d;
 	char **argv;
+	int status = CP_OK;
 	
 	data->counters->start++;
 	argv = cp_get_context_args(data->ctx, NULL);
@@ -90,11 +149,29 @@ static int start(void *d) {
 	if (cp_define_symbol(data->ctx, "cbc_counters", data->counters) != CP_OK
 		|| cp_register_logger(data->ctx, logger, data, CP_LOG_WARNING) != CP_OK
 		|| cp_register_plistener(data->ctx, listener, data) != CP_OK
-		|| cp_run_function(data->ctx, run) != CP_OK) {
+		|| cp_run_function(data->ctx, run) != CP_OK
+		|| cp_run_task(data->ctx, task, discard, data) != CP_OK
+		|| cp_register_fork_handler(data->ctx, forked, data) != CP_OK) {
 		return CP_ERR_RUNTIME;
-	} else {
-		return CP_OK;
-	}	
+	}
+	
+	/* The second context argument optionally requests scheduled runs */
+	if (argv != NULL && argv[0] != NULL && argv[1] != NULL) {
+		if (!strcmp(argv[1], "timed")) {
+			status = cp_run_function_at(data->ctx, timed_run, 20);
+		} else if (!strcmp(argv[1], "prio")) {
+			if ((status = cp_run_function_prio(data->ctx, batch_run, CP_RUN_PRIO_BATCH)) == CP_OK) {
+				status = cp_run_function_prio(data->ctx, interactive_run, CP_RUN_PRIO_INTERACTIVE);
+			}
+		}
+#ifndef _WIN32
+		else {
+			data->fd = atoi(argv[1]);
+			status = cp_run_function_on_fd(data->ctx, fd_run, data->fd);
+		}
+#endif
+	}
+	return (status == CP_OK ? CP_OK : CP_ERR_RUNTIME);
 }
 
 static void stop(void *d) {
@@ -49,6 +49,27 @@ struct cbc_counters_t {
 	/** Call counter for the run function */
 	int run;
 	
+	/** Call counter for the run task */
+	int task;
+	
+	/** Call counter for the run task discard function */
+	int discard;
+	
+	/** Call counter for the run function scheduled after a delay */
+	int timed;
+	
+	/** Call counter for the run function waiting for a file descriptor */
+	int fdrun;
+	
+	/** Call counter for the run function in the batch priority class */
+	int batch;
+	
+	/** Call counter for the run function in the interactive priority class */
+	int interactive;
+	
+	/** Call counter for the fork handler */
+	int forked;
+	
 	/** Call counter for the stop function */
 	int stop;
 	
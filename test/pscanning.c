@@ -23,6 +23,11 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <utime.h>
+#include <unistd.h>
 #include "test.h"
 
 /*
@@ -179,3 +184,161 @@ void scanrestart(void) {
 	cp_destroy();
 	check(errors == 0);
 }
+
+static void write_upgrade_plugin(const char *dir, const char *id, const char *version, const char *import) {
+	char path[64];
+	FILE *f;
+	
+	sprintf(path, "%s/%s", dir, id);
+	mkdir(path, 0777);
+	strcat(path, "/plugin.xml");
+	check((f = fopen(path, "w")) != NULL);
+	fprintf(f, "<plugin id=\"%s\" version=\"%s\">", id, version);
+	if (import != NULL) {
+		fprintf(f, "<requires><import plugin=\"%s\"/></requires>", import);
+	}
+	fputs("</plugin>\n", f);
+	check(fclose(f) == 0);
+}
+
+static void remove_upgrade_plugin(const char *dir, const char *id) {
+	char path[64];
+	
+	sprintf(path, "%s/%s/plugin.xml", dir, id);
+	remove(path);
+	sprintf(path, "%s/%s", dir, id);
+	rmdir(path);
+}
+
+static void count_upgrade_stops(const char *plugin_id, cp_plugin_state_t old_state, cp_plugin_state_t new_state, void *user_data) {
+	if (new_state == CP_PLUGIN_RESOLVED && old_state > CP_PLUGIN_RESOLVED) {
+		(*((int *) user_data))++;
+	}
+}
+
+void scanrestartupgraded(void) {
+	cp_context_t *ctx;
+	int errors;
+	int stops = 0;
+	
+	mkdir("tmp/upgrade1", 0777);
+	mkdir("tmp/upgrade2", 0777);
+	remove_upgrade_plugin("tmp/upgrade2", "base");
+	write_upgrade_plugin("tmp/upgrade1", "base", "1", NULL);
+	write_upgrade_plugin("tmp/upgrade1", "middle", "1", "base");
+	write_upgrade_plugin("tmp/upgrade1", "top", "1", "middle");
+	write_upgrade_plugin("tmp/upgrade1", "idle", "1", "base");
+	write_upgrade_plugin("tmp/upgrade1", "other", "1", NULL);
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_pcollection(ctx, "tmp/upgrade1") == CP_OK);
+	check(cp_register_pcollection(ctx, "tmp/upgrade2") == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_start_plugin(ctx, "other") == CP_OK);
+	check(cp_start_plugin(ctx, "top") == CP_OK);
+	check(cp_register_plistener(ctx, count_upgrade_stops, &stops) == CP_OK);
+	
+	// Only the active plug-ins depending on the upgraded plug-in are restarted
+	write_upgrade_plugin("tmp/upgrade2", "base", "2", NULL);
+	check(cp_scan_plugins(ctx, CP_SP_UPGRADE | CP_SP_RESTART_UPGRADED) == CP_OK);
+	scanupgrade_checkpver(ctx, "base", "2");
+	check(cp_get_plugin_state(ctx, "base") == CP_PLUGIN_ACTIVE);
+	check(cp_get_plugin_state(ctx, "middle") == CP_PLUGIN_ACTIVE);
+	check(cp_get_plugin_state(ctx, "top") == CP_PLUGIN_ACTIVE);
+	check(cp_get_plugin_state(ctx, "idle") != CP_PLUGIN_ACTIVE);
+	check(cp_get_plugin_state(ctx, "other") == CP_PLUGIN_ACTIVE);
+	check(stops == 3);
+	
+	cp_destroy();
+	check(errors == 0);
+	remove_upgrade_plugin("tmp/upgrade1", "base");
+	remove_upgrade_plugin("tmp/upgrade1", "middle");
+	remove_upgrade_plugin("tmp/upgrade1", "top");
+	remove_upgrade_plugin("tmp/upgrade1", "idle");
+	remove_upgrade_plugin("tmp/upgrade1", "other");
+	remove_upgrade_plugin("tmp/upgrade2", "base");
+	rmdir("tmp/upgrade1");
+	rmdir("tmp/upgrade2");
+}
+
+void scanincremental(void) {
+	cp_context_t *ctx;
+	int errors;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_pcollection(ctx, pcollectiondir("collection1")) == CP_OK);
+	check(cp_register_pcollection(ctx, pcollectiondir("collection2")) == CP_OK);
+	check(cp_scan_plugins(ctx, CP_SP_INCREMENTAL) == CP_OK);
+	check(cp_get_plugin_state(ctx, "plugin1") == CP_PLUGIN_INSTALLED);
+	check(cp_get_plugin_state(ctx, "plugin2a") == CP_PLUGIN_INSTALLED);
+	check(cp_get_plugin_state(ctx, "plugin2b") == CP_PLUGIN_INSTALLED);
+	
+	// Unchanged plug-ins are not installed again by an incremental scan
+	check(cp_uninstall_plugin(ctx, "plugin2a") == CP_OK);
+	check(cp_scan_plugins(ctx, CP_SP_INCREMENTAL) == CP_OK);
+	check(cp_get_plugin_state(ctx, "plugin2a") == CP_PLUGIN_UNINSTALLED);
+	
+	// New plug-in collections are picked up
+	check(cp_register_pcollection(ctx, pcollectiondir("collection1v2")) == CP_OK);
+	check(cp_scan_plugins(ctx, CP_SP_UPGRADE | CP_SP_INCREMENTAL) == CP_OK);
+	scanupgrade_checkpver(ctx, "plugin1", "2");
+	check(cp_get_plugin_state(ctx, "plugin2a") == CP_PLUGIN_UNINSTALLED);
+	
+	// A full scan loads all plug-ins
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_get_plugin_state(ctx, "plugin2a") == CP_PLUGIN_INSTALLED);
+	
+	cp_destroy();
+	check(errors == 0);
+}
+
+/**
+ * Sets the modification time of a file to the specified number of seconds
+ * in the past so that it is not considered possibly modified during the
+ * following scan.
+ */
+static void backdate(const char *file, int seconds) {
+	struct utimbuf times;
+	
+	times.actime = times.modtime = time(NULL) - seconds;
+	check(utime(file, &times) == 0);
+}
+
+void scanbundle(void) {
+	cp_context_t *ctx;
+	int errors;
+	
+	// Write a bundle of the plug-ins in two collections
+	remove("tmp/bundle.cpb");
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_pcollection(ctx, pcollectiondir("collection1")) == CP_OK);
+	check(cp_register_pcollection(ctx, pcollectiondir("collection2")) == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check(cp_write_plugin_image(ctx, "tmp/bundle.cpb") == CP_OK);
+	backdate("tmp/bundle.cpb", 10);
+	cp_destroy_context(ctx);
+	check(errors == 0);
+	
+	// The bundle is scanned like a plug-in collection
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_pcollection(ctx, "tmp/bundle.cpb") == CP_OK);
+	check(cp_register_pcollection(ctx, pcollectiondir("collection1v2")) == CP_OK);
+	check(cp_scan_plugins(ctx, CP_SP_INCREMENTAL) == CP_OK);
+	scanupgrade_checkpver(ctx, "plugin1", "2");
+	check(cp_get_plugin_state(ctx, "plugin2a") == CP_PLUGIN_INSTALLED);
+	check(cp_get_plugin_state(ctx, "plugin2b") == CP_PLUGIN_INSTALLED);
+	
+	// An unchanged bundle is not loaded again by an incremental scan
+	check(cp_uninstall_plugin(ctx, "plugin2a") == CP_OK);
+	check(cp_scan_plugins(ctx, CP_SP_INCREMENTAL) == CP_OK);
+	check(cp_get_plugin_state(ctx, "plugin2a") == CP_PLUGIN_UNINSTALLED);
+	
+	// A changed bundle is loaded again
+	backdate("tmp/bundle.cpb", 20);
+	check(cp_scan_plugins(ctx, CP_SP_INCREMENTAL) == CP_OK);
+	check(cp_get_plugin_state(ctx, "plugin2a") == CP_PLUGIN_INSTALLED);
+	scanupgrade_checkpver(ctx, "plugin1", "2");
+	
+	cp_destroy();
+	check(errors == 0);
+	remove("tmp/bundle.cpb");
+}
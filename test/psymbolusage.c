@@ -49,3 +49,129 @@ void symbolusage(void) {
 	cp_destroy();
 	check(errors == 0);
 }
+
+void symbolcache(void) {
+	cp_context_t *ctx;
+	cp_status_t status;
+	int errors;
+	const char *str, *str2;
+	const char *names[] = { "sp_string", "sp_runtime" };
+	const char *badnames[] = { "sp_runtime", "nonexisting" };
+	void *syms[2];
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_pcollection(ctx, "tmp/install/plugins") == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	
+	// Repeated resolutions return the same symbol
+	check((str = cp_resolve_symbol(ctx, "symuser", "used_string", &status)) != NULL && status == CP_OK);
+	check((str2 = cp_resolve_symbol(ctx, "symuser", "used_string", &status)) == str && status == CP_OK);
+	cp_release_symbol(ctx, str2);
+	check(strcmp(str, "Provided string") == 0);
+	cp_release_symbol(ctx, str);
+	
+	// Resolve several symbols at once
+	check(cp_resolve_symbols(ctx, "symprovider", names, syms, 2) == CP_OK);
+	check(syms[0] != NULL && syms[1] != NULL);
+	check(cp_resolve_symbol(ctx, "symprovider", "sp_string", NULL) == syms[0]);
+	cp_release_symbol(ctx, syms[0]);
+	cp_release_symbol(ctx, syms[0]);
+	cp_release_symbol(ctx, syms[1]);
+	
+	// Either all symbols are resolved or none
+	check(cp_resolve_symbols(ctx, "symprovider", badnames, syms, 2) == CP_ERR_UNKNOWN);
+	check(syms[0] == NULL && syms[1] == NULL);
+	check(cp_get_plugin_state(ctx, "symprovider") == CP_PLUGIN_ACTIVE);
+	
+	// Shutdown framework
+	cp_destroy();
+	check(errors == 0);
+}
+
+void symbolstopprovider(void) {
+	cp_context_t *ctx;
+	cp_status_t status;
+	const char *str;
+	int errors;
+	
+	// The user plug-in depends on the provider through a resolved symbol
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_register_pcollection(ctx, "tmp/install/plugins") == CP_OK);
+	check(cp_scan_plugins(ctx, 0) == CP_OK);
+	check((str = cp_resolve_symbol(ctx, "symuser", "used_string", &status)) != NULL && status == CP_OK);
+	cp_release_symbol(ctx, str);
+	
+	// Stopping the provider stops the user which releases the dependency
+	check(cp_stop_plugin(ctx, "symprovider") == CP_OK);
+	check(cp_get_plugin_state(ctx, "symprovider") == CP_PLUGIN_RESOLVED);
+	check(cp_get_plugin_state(ctx, "symuser") == CP_PLUGIN_RESOLVED);
+	cp_destroy();
+	check(errors == 0);
+}
+
+static int table_values[8];
+
+/* Laid out as generated by cpluff::make_symbol_table */
+static const cp_symbol_def_t hashed_symbols[] = {
+	{ "beta", &table_values[1], 1 },
+	{ "zeta", &table_values[5], 1 },
+	{ "delta", &table_values[3], 1 },
+	{ "epsilon", &table_values[4], 2 },
+	{ "gamma", &table_values[2], 6 },
+	{ "alpha", &table_values[0], 1 },
+	{ "eta", &table_values[6], 1 }
+};
+
+static const cp_symbol_def_t plain_symbols[] = {
+	{ "theta", &table_values[7], 0 }
+};
+
+static cp_context_t *table_ctx;
+
+static void *table_create(cp_context_t *ctx) {
+	table_ctx = ctx;
+	return table_values;
+}
+
+static int table_start(void *data) {
+	check(cp_define_symbols(table_ctx, hashed_symbols, sizeof(hashed_symbols) / sizeof(hashed_symbols[0])) == CP_OK);
+	check(cp_define_symbols(table_ctx, plain_symbols, 1) == CP_OK);
+	check(cp_define_symbol(table_ctx, "iota", table_values) == CP_OK);
+	return CP_OK;
+}
+
+static void table_destroy(void *data) {
+}
+
+void symboltables(void) {
+	static const char descriptor[] = "<plugin id=\"tables\"/>";
+	static cp_plugin_runtime_t runtime = { table_create, table_start, NULL, table_destroy };
+	static const char * const names[] = { "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta" };
+	cp_context_t *ctx;
+	cp_status_t status;
+	int *value;
+	int errors;
+	int i;
+	
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_install_builtin_plugin(ctx, descriptor, sizeof(descriptor) - 1, &runtime, NULL) == CP_OK);
+	for (i = 0; i < 8; i++) {
+		check((value = cp_resolve_symbol(ctx, "tables", names[i], &status)) != NULL && status == CP_OK);
+		check(value == table_values + i);
+		cp_release_symbol(ctx, value);
+	}
+	check((value = cp_resolve_symbol(ctx, "tables", "iota", &status)) == table_values && status == CP_OK);
+	cp_release_symbol(ctx, value);
+	
+	// Redefining a table fails
+	check(cp_define_symbols(table_ctx, plain_symbols, 1) == CP_ERR_CONFLICT);
+	check(errors == 1);
+	
+	// The tables are released when the plug-in stops
+	check(cp_stop_plugin(ctx, "tables") == CP_OK);
+	check(cp_start_plugin(ctx, "tables") == CP_OK);
+	check((value = cp_resolve_symbol(ctx, "tables", "gamma", &status)) == table_values + 2 && status == CP_OK);
+	cp_release_symbol(ctx, value);
+	cp_destroy();
+	check(errors == 1);
+}
@@ -0,0 +1,91 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+#include <stdexcept>
+#include <cpluffxx/symbols.h>
+#include "test_cxx.h"
+
+static int symbol_values[5];
+
+static cp_context_t *symbols_ctx;
+
+static void *symbols_create(cp_context_t *ctx) {
+	symbols_ctx = ctx;
+	return symbol_values;
+}
+
+static int symbols_start(void *data) {
+	static const cpluff::symbol_table<5> table = cpluff::make_symbol_table(
+		cpluff::symbol("alpha", symbol_values + 0),
+		cpluff::symbol("beta", symbol_values + 1),
+		cpluff::symbol("gamma", symbol_values + 2),
+		cpluff::symbol("delta", symbol_values + 3),
+		cpluff::symbol("epsilon", symbol_values + 4));
+
+	return table.define(symbols_ctx);
+}
+
+static void symbols_destroy(void *data) {
+}
+
+extern "C" void symboltable_cxx(void) {
+	static const char descriptor[] = "<plugin id=\"symbols\"/>";
+	static cp_plugin_runtime_t runtime = { symbols_create, symbols_start, NULL, symbols_destroy };
+	static const char * const names[] = { "alpha", "beta", "gamma", "delta", "epsilon" };
+	cp_context_t *ctx;
+	cp_status_t status;
+	int *value;
+	int errors;
+	bool thrown = false;
+
+	// The generated table is a minimal perfect hash table
+	cpluff::symbol_table<5> table = cpluff::make_symbol_table(
+		cpluff::symbol("alpha", symbol_values + 0),
+		cpluff::symbol("beta", symbol_values + 1),
+		cpluff::symbol("gamma", symbol_values + 2),
+		cpluff::symbol("delta", symbol_values + 3),
+		cpluff::symbol("epsilon", symbol_values + 4));
+	for (unsigned int i = 0; i < table.size(); i++) {
+		check(table.data()[i].name != NULL && table.data()[i].disp > 0);
+	}
+
+	// Names must be unique
+	try {
+		cpluff::make_symbol_table(cpluff::symbol("alpha", symbol_values), cpluff::symbol("alpha", symbol_values));
+	} catch (const std::invalid_argument&) {
+		thrown = true;
+	}
+	check(thrown);
+
+	// The symbols defined using the table can be resolved
+	ctx = init_context(CP_LOG_ERROR, &errors);
+	check(cp_install_builtin_plugin(ctx, descriptor, sizeof(descriptor) - 1, &runtime, NULL) == CP_OK);
+	for (int i = 0; i < 5; i++) {
+		check((value = static_cast<int *>(cp_resolve_symbol(ctx, "symbols", names[i], &status))) != NULL && status == CP_OK);
+		check(value == symbol_values + i);
+		cp_release_symbol(ctx, value);
+	}
+	check(cp_resolve_symbol(ctx, "symbols", "zeta", &status) == NULL && status == CP_ERR_UNKNOWN);
+	cp_destroy();
+	check(errors == 0);
+}
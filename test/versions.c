@@ -0,0 +1,100 @@
+/*-------------------------------------------------------------------------
+ * C-Pluff, a plug-in framework for C
+ * Copyright 2007 Johannes Lehtinen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *-----------------------------------------------------------------------*/
+
+/*
+ * These tests check internal functions and they are linked with the
+ * implementation of the functions instead of the C-Pluff library.
+ */
+
+#include <stddef.h>
+#include "test.h"
+#include "../libcpluff/util.h"
+
+/// Version strings compared against each other, without NULL
+static const char * const versions[] = {
+
+	// Empty and zero versions
+	"", "0", "00", "0.0",
+
+	// Leading zeros
+	"1", "01", "001", "1.01", "1.1", "1.001", "1.010", "1.10", "1.0100",
+
+	// Missing components
+	"1.0", "1.0.0", "1.0.0.0", "1.", "1..", ".1", "1a", "1.a", "a", "a1",
+
+	// Non-alphanumeric characters
+	"1.0~rc1", "1.0-rc1", "1.0_rc1", "1.0+rc1", "1-2", "1:2", "1/2", "1 2",
+	"1.0.max", "1.0.MAX", "~", "-", "\xe4", "1.\xe4", "1.0\x7f",
+
+	// Numbers longer than 15 digits
+	"123456789012345", "1234567890123456", "12345678901234567890",
+	"1.123456789012345678", "1.123456789012345679", "1.000000000000000000001",
+	"99999999999999999999.1", "99999999999999999999.2",
+};
+
+/// Number of versions
+#define NUM_VERSIONS (sizeof(versions) / sizeof(versions[0]))
+
+/**
+ * Returns the sign of a comparison result.
+ * 
+ * @param c the comparison result
+ * @return -1, 0 or 1
+ */
+static int sign(int c) {
+	return (c > 0) - (c < 0);
+}
+
+void vercmptokens(void) {
+	cpi_arena_t *arena;
+	cpi_version_t *tokens[NUM_VERSIONS];
+	unsigned int i, j;
+	
+	check((arena = cpi_create_arena(1024)) != NULL);
+	for (i = 0; i < NUM_VERSIONS; i++) {
+		check((tokens[i] = cpi_tokenize_version(arena, versions[i])) != NULL);
+	}
+	
+	// Tokenized versions compare like the version strings
+	for (i = 0; i < NUM_VERSIONS; i++) {
+		for (j = 0; j < NUM_VERSIONS; j++) {
+			check(sign(cpi_vercmp_tokens(tokens[i], tokens[j])) == sign(cpi_vercmp(versions[i], versions[j])));
+		}
+		
+		// A NULL version is earlier than any other version
+		check(cpi_vercmp(NULL, versions[i]) < 0 && cpi_vercmp_tokens(NULL, tokens[i]) < 0);
+		check(cpi_vercmp(versions[i], NULL) > 0 && cpi_vercmp_tokens(tokens[i], NULL) > 0);
+	}
+	check(cpi_vercmp(NULL, NULL) == 0 && cpi_vercmp_tokens(NULL, NULL) == 0);
+	
+	// Spot checks of the ordering
+	check(cpi_vercmp("1.01", "1.1") == 0);
+	check(cpi_vercmp("", "0") == 0);
+	check(cpi_vercmp("1", "1.0") < 0);
+	check(cpi_vercmp("1.0~rc1", "1.0") > 0);
+	check(cpi_vercmp("1.0.max", "1.0.MAX") > 0);
+	check(cpi_vercmp("1.a", "1.-") < 0);
+	check(cpi_vercmp("1.123456789012345678", "1.123456789012345679") == 0);
+	
+	cpi_destroy_arena(arena);
+}